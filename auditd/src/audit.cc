@@ -447,17 +447,34 @@ bool Audit::add_to_filleventqueue(const uint32_t event_id,
     //       in the correct fields.. if not we should add an
     //       event to the audit trail saying it is one in an illegal
     //       format (or missing fields)
+    return enqueue_event(new Event(event_id, payload, length));
+}
+
+bool Audit::add_to_filleventqueue(const uint32_t event_id,
+                                  unique_cJSON_ptr payload) {
+    return enqueue_event(new Event(event_id, std::move(payload)));
+}
+
+bool Audit::enqueue_event(Event* new_event) {
     bool res;
-    Event* new_event = new Event(event_id, payload, length);
     cb_mutex_enter(&producer_consumer_lock);
     if (filleventqueue->size() < max_audit_queue) {
+        // The consumer drains the entire queue every time it wakes up,
+        // so it only needs to be notified on the empty -> non-empty
+        // transition. Signalling on every event just adds another
+        // syscall to the producer (the front end worker threads).
+        const bool notify_consumer = filleventqueue->empty();
         filleventqueue->push(new_event);
-        cb_cond_broadcast(&events_arrived);
+        if (notify_consumer) {
+            cb_cond_broadcast(&events_arrived);
+        }
         res = true;
     } else {
         logger->log(EXTENSION_LOG_WARNING, NULL,
                     "Audit: Dropping audit event %u: %s",
-                    new_event->id, new_event->payload.c_str());
+                    new_event->id,
+                    new_event->json ? to_string(new_event->json, false).c_str()
+                                    : new_event->payload.c_str());
         dropped_events++;
         delete new_event;
         res = false;
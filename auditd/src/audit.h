@@ -24,6 +24,7 @@
 #include <atomic>
 
 #include <cJSON.h>
+#include <cJSON_utils.h>
 #include "memcached/audit_interface.h"
 #include "memcached/types.h"
 #include "auditconfig.h"
@@ -90,6 +91,14 @@ public:
                                      payload.length());
     }
 
+    /**
+     * Add an already built JSON payload to the queue. Ownership of the
+     * tree is transferred to the audit daemon, and serialization to disk
+     * format happens on the consumer thread instead of the caller.
+     */
+    bool add_to_filleventqueue(const uint32_t event_id,
+                               unique_cJSON_ptr payload);
+
     bool add_reconfigure_event(const char *configfile, const void *cookie);
     bool create_audit_event(uint32_t event_id, cJSON *payload);
     bool terminate_consumer_thread(void);
@@ -118,6 +127,13 @@ protected:
     } event_state_listener;
 
 private:
+    /**
+     * Add the event to the fill queue (or drop it if the queue is full),
+     * and wake the consumer thread if it may be waiting for events.
+     * Takes ownership of the event.
+     */
+    bool enqueue_event(Event* new_event);
+
     size_t max_audit_queue;
 };
 
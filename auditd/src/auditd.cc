@@ -21,7 +21,6 @@
 #include <cJSON.h>
 #include <cstring>
 #include <memcached/audit_interface.h>
-#include <memcached/isotime.h>
 #include <platform/strerror.h>
 #include <sstream>
 
@@ -179,15 +178,20 @@ AUDIT_ERROR_CODE put_audit_event(Audit* handle,
 MEMCACHED_PUBLIC_API
 AUDIT_ERROR_CODE put_json_audit_event(Audit* handle,
                                       uint32_t id,
-                                      cJSON* event) {
-    cJSON* ts = cJSON_GetObjectItem(event, "timestamp");
-    if (ts == nullptr) {
-        std::string timestamp = ISOTime::generatetimestamp();
-        cJSON_AddStringToObject(event, "timestamp", timestamp.c_str());
+                                      unique_cJSON_ptr event) {
+    if (handle == nullptr) {
+        throw std::invalid_argument(
+            "put_json_audit_event: handle can't be nullptr");
     }
-
-    auto text = to_string(event, false);
-    return put_audit_event(handle, id, text.data(), text.length());
+    if (handle->config.is_auditd_enabled()) {
+        // Serialization to the on-disk format (and insertion of the
+        // timestamp if the caller didn't provide one) happens on the
+        // consumer thread as part of processing the event.
+        if (!handle->add_to_filleventqueue(id, std::move(event))) {
+            return AUDIT_FAILED;
+        }
+    }
+    return AUDIT_SUCCESS;
 }
 
 MEMCACHED_PUBLIC_API
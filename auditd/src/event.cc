@@ -28,11 +28,20 @@ bool Event::process(Audit& audit) {
         return true;
     }
 
-    // convert the event.payload into JSON
-    cJSON *json_payload = cJSON_Parse(payload.c_str());
-    if (json_payload == NULL) {
-        Audit::log_error(AuditErrorCode::JSON_PARSING_ERROR, payload.c_str());
-        return false;
+    cJSON* json_payload;
+    unique_cJSON_ptr parsed;
+    if (json) {
+        // The producer handed over the JSON tree directly
+        json_payload = json.get();
+    } else {
+        // convert the event.payload into JSON
+        parsed.reset(cJSON_Parse(payload.c_str()));
+        if (!parsed) {
+            Audit::log_error(AuditErrorCode::JSON_PARSING_ERROR,
+                             payload.c_str());
+            return false;
+        }
+        json_payload = parsed.get();
     }
     cJSON *timestamp_ptr = cJSON_GetObjectItem(json_payload, "timestamp");
     if (timestamp_ptr == NULL) {
@@ -46,17 +55,14 @@ bool Event::process(Audit& audit) {
         std::ostringstream convert;
         convert << id;
         Audit::log_error(AuditErrorCode::UNKNOWN_EVENT_ERROR, convert.str().c_str());
-        cJSON_Delete(json_payload);
         return false;
     }
     if (!evt->second->isEnabled()) {
         // the event is not enabled so ignore event
-        cJSON_Delete(json_payload);
         return true;
     }
     if (!audit.auditfile.ensure_open()) {
         Audit::log_error(AuditErrorCode::OPEN_AUDITFILE_ERROR);
-        cJSON_Delete(json_payload);
         return false;
     }
     cJSON_AddNumberToObject(json_payload, "id", id);
@@ -65,9 +71,6 @@ bool Event::process(Audit& audit) {
 
     bool success = audit.auditfile.write_event_to_disk(json_payload);
 
-    // Release allocated resources
-    cJSON_Delete(json_payload);
-
     if (success) {
         return true;
     } else {
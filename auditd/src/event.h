@@ -17,6 +17,7 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <cJSON_utils.h>
 #include <inttypes.h>
 #include <string>
 
@@ -27,6 +28,12 @@ public:
     const uint32_t id;
     const std::string payload;
 
+    // A preformatted payload handed over by the producer. When set the
+    // consumer thread may use the JSON tree directly instead of parsing
+    // the textual payload (saving both the producer-side serialization
+    // and the consumer-side parse).
+    unique_cJSON_ptr json;
+
     // Constructor required for ConfigureEvent
     Event()
         : id(0) {}
@@ -36,6 +43,10 @@ public:
         : id(event_id),
           payload(p,length) {}
 
+    Event(const uint32_t event_id, unique_cJSON_ptr p)
+        : id(event_id),
+          json(std::move(p)) {}
+
     virtual bool process(Audit& audit);
 
     virtual ~Event() {}
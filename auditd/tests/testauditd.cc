@@ -170,6 +170,16 @@ TEST_F(AuditDaemonTest, StartupEnableCreateFile) {
     assertNumberOfFiles(1);
 }
 
+TEST_F(AuditDaemonTest, JsonEventSubmissionWhileDisabled) {
+    configure();
+    unique_cJSON_ptr payload(cJSON_CreateObject());
+    cJSON_AddStringToObject(payload.get(), "source", "internal");
+    // The event is accepted (and discarded) without touching the disk
+    EXPECT_EQ(AUDIT_SUCCESS,
+              put_json_audit_event(auditHandle, 4096, std::move(payload)));
+    assertNumberOfFiles(0);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     // required for gethostname(); normally called by memcached's main()
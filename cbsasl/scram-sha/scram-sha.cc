@@ -27,6 +27,7 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <platform/base64.h>
 #include <platform/random.h>
 #include <set>
@@ -35,6 +36,59 @@
 
 typedef std::map<char, std::string> AttributeMap;
 
+/**
+ * Cache of the "dummy" users we create for authentication attempts
+ * against unknown usernames.
+ *
+ * Creating a dummy user runs the full PBKDF2 key derivation (several
+ * thousand iterations) to generate the salted password, which is by
+ * far the most expensive part of the server side of a SCRAM exchange
+ * (for known users the salted password is stored in the password
+ * database). Without the cache a reconnect storm of clients with a
+ * stale/unknown username burns a core's worth of CPU on key
+ * derivation alone.
+ *
+ * Caching also means the salt presented for a given unknown username
+ * stays stable across attempts; generating a fresh random salt every
+ * time would tell the client that the user does not exist.
+ */
+class DummyUserCache {
+public:
+    cb::sasl::User get(const std::string& username, const Mechanism& mech) {
+        auto key = std::make_pair(mech, username);
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            auto iter = entries.find(key);
+            if (iter != entries.end()) {
+                return iter->second;
+            }
+        }
+
+        // Run the key derivation without holding the lock so that we
+        // don't serialize all other authentications behind it. Two
+        // threads may race and both generate the user; the one which
+        // gets inserted first wins.
+        auto user = cb::sasl::UserFactory::createDummy(username, mech);
+
+        std::lock_guard<std::mutex> guard(mutex);
+        if (entries.size() >= MaxEntries) {
+            // Bounded so that a flood of unique garbage usernames
+            // can't grow the cache without limits. Starting over
+            // beats tracking recency on the auth path.
+            entries.clear();
+        }
+        return entries.emplace(std::move(key), std::move(user)).first->second;
+    }
+
+private:
+    static const size_t MaxEntries = 8192;
+
+    std::mutex mutex;
+    std::map<std::pair<Mechanism, std::string>, cb::sasl::User> entries;
+};
+
+static DummyUserCache dummyUserCache;
+
 static std::string hex_encode_nonce(const std::array<char, 8>& nonce) {
     std::stringstream ss;
     ss << std::hex << std::setfill('0');
@@ -432,7 +486,7 @@ cbsasl_error_t ScramShaServerBackend::start(const char* input,
         logging::log(conn,
                      logging::Level::Debug,
                      "User [" + username + "] doesn't exist.. using dummy");
-        user = cb::sasl::UserFactory::createDummy(username, mechanism);
+        user = dummyUserCache.get(username, mechanism);
     }
 
     const auto& passwordMeta = user.getPassword(mechanism);
@@ -0,0 +1,197 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "admission.h"
+
+#include "memcached.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+std::array<AdmissionClass, 0x100>& get_admission_classes() {
+    static std::array<AdmissionClass, 0x100> classes;
+
+    classes[PROTOCOL_BINARY_CMD_STAT] = AdmissionClass::Heavy;
+    classes[PROTOCOL_BINARY_CMD_STAT_BULK] = AdmissionClass::Heavy;
+    classes[PROTOCOL_BINARY_CMD_DCP_STREAM_REQ] = AdmissionClass::Heavy;
+    classes[PROTOCOL_BINARY_CMD_COMPACT_DB] = AdmissionClass::Heavy;
+    classes[PROTOCOL_BINARY_CMD_FLUSH] = AdmissionClass::Heavy;
+    classes[PROTOCOL_BINARY_CMD_FLUSHQ] = AdmissionClass::Heavy;
+
+    classes[PROTOCOL_BINARY_CMD_CREATE_BUCKET] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_DELETE_BUCKET] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_LIST_BUCKETS] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_IOCTL_GET] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_IOCTL_SET] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_CONFIG_VALIDATE] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_CONFIG_RELOAD] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_AUDIT_CONFIG_RELOAD] =
+            AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_ISASL_REFRESH] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_SSL_CERTS_REFRESH] =
+            AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_RBAC_REFRESH] = AdmissionClass::Management;
+    classes[PROTOCOL_BINARY_CMD_SET_CLUSTER_CONFIG] =
+            AdmissionClass::Management;
+
+    return classes;
+}
+
+/**
+ * The book-keeping for one admission class. The default limits are
+ * deliberately conservative: the point of the classes is that a
+ * burst of expensive commands queues up behind a handful of running
+ * ones instead of occupying every worker thread.
+ */
+struct ClassState {
+    ClassState(int limit, size_t max_queue)
+        : limit(limit), max_queue(max_queue) {
+    }
+
+    /// Maximum number of commands of this class in flight
+    const int limit;
+    /// Maximum number of connections parked waiting for a slot
+    const size_t max_queue;
+
+    int in_flight = 0;
+    /// Cookies of the connections currently holding a slot
+    std::unordered_set<const void*> holders;
+    /// Cookies of the connections parked waiting for a slot, in
+    /// arrival order
+    std::deque<const void*> waiters;
+
+    uint64_t admitted = 0;
+    uint64_t queued = 0;
+    uint64_t rejected = 0;
+};
+
+static std::mutex admission_lock;
+static ClassState heavy_state{4, 64};
+static ClassState management_state{2, 16};
+
+static ClassState* get_class_state(AdmissionClass ac) {
+    switch (ac) {
+    case AdmissionClass::PointOp:
+        return nullptr;
+    case AdmissionClass::Heavy:
+        return &heavy_state;
+    case AdmissionClass::Management:
+        return &management_state;
+    }
+    throw std::invalid_argument(
+            "get_class_state: invalid admission class " +
+            std::to_string(int(ac)));
+}
+
+AdmissionVerdict admission_request(McbpConnection* c) {
+    auto* cs = get_class_state(
+            get_admission_classes()[c->binary_header.request.opcode]);
+    if (cs == nullptr) {
+        return AdmissionVerdict::Admit;
+    }
+
+    const void* cookie = c->getCookie();
+    std::lock_guard<std::mutex> lh(admission_lock);
+
+    if (cs->holders.count(cookie) != 0) {
+        // Re-entry for a command already holding a slot (it blocked
+        // in the engine, or was woken from the wait queue)
+        return AdmissionVerdict::Admit;
+    }
+
+    if (cs->in_flight < cs->limit) {
+        ++cs->in_flight;
+        cs->holders.insert(cookie);
+        ++cs->admitted;
+        return AdmissionVerdict::Admit;
+    }
+
+    if (cs->waiters.size() >= cs->max_queue) {
+        ++cs->rejected;
+        return AdmissionVerdict::Reject;
+    }
+
+    cs->waiters.push_back(cookie);
+    ++cs->queued;
+    return AdmissionVerdict::Queue;
+}
+
+void admission_release(McbpConnection* c) {
+    auto* cs = get_class_state(
+            get_admission_classes()[c->binary_header.request.opcode]);
+    if (cs == nullptr) {
+        return;
+    }
+
+    const void* cookie = c->getCookie();
+    const void* wake = nullptr;
+    bool unpark = false;
+
+    {
+        std::lock_guard<std::mutex> lh(admission_lock);
+
+        auto witer = std::find(cs->waiters.begin(), cs->waiters.end(), cookie);
+        if (witer != cs->waiters.end()) {
+            // The connection closed while parked on the wait queue.
+            // It is blocked on a notification which would otherwise
+            // never arrive, so wake it up (below) to let the close
+            // complete.
+            cs->waiters.erase(witer);
+            unpark = true;
+        }
+
+        if (cs->holders.erase(cookie) != 0) {
+            --cs->in_flight;
+            if (!cs->waiters.empty() && cs->in_flight < cs->limit) {
+                // Hand the freed slot to the longest waiter before
+                // waking it, so that a newly arriving command can't
+                // steal the slot and starve the queue
+                wake = cs->waiters.front();
+                cs->waiters.pop_front();
+                cs->holders.insert(wake);
+                ++cs->in_flight;
+                ++cs->admitted;
+            }
+        }
+    }
+
+    if (unpark) {
+        notify_io_complete(cookie, ENGINE_SUCCESS);
+    }
+    if (wake != nullptr) {
+        notify_io_complete(wake, ENGINE_SUCCESS);
+    }
+}
+
+AdmissionClassStats admission_get_stats(AdmissionClass ac) {
+    AdmissionClassStats ret{};
+    auto* cs = get_class_state(ac);
+    if (cs == nullptr) {
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> lh(admission_lock);
+    ret.admitted = cs->admitted;
+    ret.queued = cs->queued;
+    ret.rejected = cs->rejected;
+    ret.in_flight = cs->in_flight;
+    ret.limit = cs->limit;
+    ret.queue_depth = cs->waiters.size();
+    ret.max_queue = cs->max_queue;
+    return ret;
+}
@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/types.h>
+
+#include <array>
+#include <cstdint>
+
+class McbpConnection;
+
+/**
+ * Request admission control.
+ *
+ * All commands share the worker threads FIFO, so when the node
+ * saturates (stats scrapes against every bucket, bgfetch storms,
+ * backfilling DCP streams) the cheap point operations degrade together
+ * with the expensive commands which caused the saturation. This module
+ * sits in front of the executor dispatch in execute_request_packet()
+ * and classifies each command:
+ *
+ *  - point operations (the data path) are never throttled; the
+ *    admission check for them is a single table lookup
+ *  - heavy commands (stats, compaction, DCP stream requests) and
+ *    management commands (bucket create/delete, config reload, ...)
+ *    are limited to a small per-class number in flight
+ *
+ * A command arriving while its class is at its concurrency limit is
+ * parked on the class' wait queue using the regular EWOULDBLOCK
+ * machinery (the connection is notified when a slot frees up), and
+ * once the queue itself is full further arrivals are rejected
+ * immediately with a temporary failure rather than being allowed to
+ * pile up. The per-class counters are exposed by "stats admission".
+ */
+
+/**
+ * The admission class of an opcode
+ */
+enum class AdmissionClass : uint8_t {
+    /// Point operations; never throttled
+    PointOp = 0,
+    /// Commands which hold a worker (or engine background capacity)
+    /// for a long time, e.g. full stats scrapes and DCP stream
+    /// requests triggering backfills
+    Heavy = 1,
+    /// Administrative commands, e.g. bucket and config management
+    Management = 2
+};
+
+/// The number of admission classes above
+const size_t admission_num_classes = 3;
+
+/**
+ * Get the opcode -> admission class mapping (the same shape as
+ * get_mcbp_topkeys; every opcode not explicitly classified is a
+ * PointOp)
+ */
+std::array<AdmissionClass, 0x100>& get_admission_classes();
+
+/**
+ * The verdict for a command asking to be admitted
+ */
+enum class AdmissionVerdict : uint8_t {
+    /// Run the command now
+    Admit,
+    /// The class is at its concurrency limit; the caller must block
+    /// the connection (EWOULDBLOCK) and it'll be notified when a slot
+    /// frees up
+    Queue,
+    /// The class' wait queue is full as well; fail the command with a
+    /// temporary failure
+    Reject
+};
+
+/**
+ * Ask for a slot to run the current command on the connection.
+ *
+ * Safe to call multiple times for the same command (a command which
+ * blocks in the engine re-enters the dispatch path); the slot is held
+ * until admission_release().
+ */
+AdmissionVerdict admission_request(McbpConnection* c);
+
+/**
+ * Release the slot held by the connection (a no-op if it doesn't hold
+ * one) and remove it from any wait queue, waking the next waiter of
+ * the class. Called when a command completes and when the connection
+ * closes.
+ */
+void admission_release(McbpConnection* c);
+
+/**
+ * Counters for one admission class, as reported by "stats admission"
+ */
+struct AdmissionClassStats {
+    uint64_t admitted;
+    uint64_t queued;
+    uint64_t rejected;
+    int in_flight;
+    int limit;
+    size_t queue_depth;
+    size_t max_queue;
+};
+
+/**
+ * Get the current counters for the given class
+ */
+AdmissionClassStats admission_get_stats(AdmissionClass ac);
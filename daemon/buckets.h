@@ -29,8 +29,10 @@
 #include "cookie.h"
 #include "function_chain.h"
 #include "mcbp_validators.h"
+#include "slowops.h"
 #include "stats.h"
 #include "timings.h"
+#include "vbucket_timings.h"
 #include "topkeys.h"
 #include "task.h"
 
@@ -166,6 +168,13 @@ public:
      */
     Timings timings;
 
+    /**
+     * Per-vbucket coarse latency heatmap ("stats vbucket_timings").
+     * Not copied when the bucket slot is copied; a new bucket starts
+     * with an empty heatmap.
+     */
+    VBucketTimings vbucket_timings;
+
     /**
      *  Sub-document JSON parser (subjson) operation execution time histogram.
      */
@@ -176,6 +185,13 @@ public:
      */
     TopKeys *topkeys;
 
+    /**
+     * The most recent operations which exceeded their SLA threshold.
+     * Deliberately not copied when the bucket slot is copied; a new
+     * bucket starts with an empty ring.
+     */
+    SlowOpRing slowops;
+
     /**
      * The validator chains to use for this bucket when receiving MCBP commands.
      */
@@ -0,0 +1,231 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "buffer_pool.h"
+
+#include "memcached.h"
+
+#include <platform/cb_malloc.h>
+
+#include <new>
+#include <stdexcept>
+
+const size_t BufferPool::SEGMENT_SIZE;
+const size_t BufferPool::MIN_SCRATCH_SIZE;
+const size_t BufferPool::MAX_SCRATCH_SIZE;
+const size_t BufferPool::SCRATCH_PER_CLASS;
+const size_t BufferPool::NUM_SCRATCH_CLASSES;
+
+BufferPool::~BufferPool() {
+    for (auto* segment : segments) {
+        cb_free(segment);
+    }
+    for (auto& freelist : scratch) {
+        for (auto* buffer : freelist) {
+            cb_free(buffer);
+        }
+    }
+}
+
+/**
+ * Map an exact size class capacity to its index in the scratch array,
+ * or -1 if the capacity isn't one of our size classes (and the buffer
+ * can't be recycled)
+ */
+static int scratch_class_index(size_t capacity) {
+    size_t sz = BufferPool::MIN_SCRATCH_SIZE;
+    int index = 0;
+    while (sz <= BufferPool::MAX_SCRATCH_SIZE) {
+        if (sz == capacity) {
+            return index;
+        }
+        sz <<= 1;
+        ++index;
+    }
+    return -1;
+}
+
+std::unique_ptr<cb::Pipe> BufferPool::tryAcquire() {
+    if (buffers.empty()) {
+        return std::unique_ptr<cb::Pipe>{};
+    }
+
+    auto ret = std::move(buffers.back());
+    buffers.pop_back();
+    cached = buffers.size();
+    recycled++;
+    return ret;
+}
+
+void BufferPool::release(std::unique_ptr<cb::Pipe> buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    if (!buffer->empty()) {
+        throw std::logic_error(
+                "BufferPool::release: the buffer may not contain data");
+    }
+
+    // Reset the cursors so that the entire buffer is available again
+    buffer->clear();
+
+    // Only cache buffers of the size class we hand out. A connection may
+    // have grown its buffer to fit a big packet, and we don't want such
+    // buffers to pin memory while sitting idle in the pool.
+    if (buffers.size() < limit &&
+        buffer->wdata().size() <= READ_BUFFER_HIGHWAT) {
+        buffers.push_back(std::move(buffer));
+        cached = buffers.size();
+    } else {
+        discarded++;
+    }
+}
+
+char* BufferPool::tryAcquireSegment() {
+    if (segments.empty()) {
+        return nullptr;
+    }
+
+    auto* ret = segments.back();
+    segments.pop_back();
+    cachedSegments = segments.size();
+    recycledSegments++;
+    return ret;
+}
+
+void BufferPool::releaseSegment(char* segment) {
+    if (segment == nullptr) {
+        return;
+    }
+
+    if (segments.size() < limit) {
+        try {
+            segments.push_back(segment);
+            cachedSegments = segments.size();
+            return;
+        } catch (const std::bad_alloc&) {
+            // fall through and free the segment
+        }
+    }
+
+    cb_free(segment);
+    discardedSegments++;
+}
+
+size_t BufferPool::scratchCapacity(size_t size) {
+    if (size > MAX_SCRATCH_SIZE) {
+        return 0;
+    }
+
+    size_t capacity = MIN_SCRATCH_SIZE;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+char* BufferPool::tryAcquireScratch(size_t size, size_t& capacity) {
+    const auto wanted = scratchCapacity(size);
+    if (wanted == 0) {
+        // Too big for our size classes
+        return nullptr;
+    }
+
+    // Check the class the request rounds up to first, then the bigger
+    // ones (better to reuse an oversized buffer than to allocate)
+    size_t classSize = wanted;
+    for (int index = scratch_class_index(wanted);
+         index >= 0 && size_t(index) < NUM_SCRATCH_CLASSES;
+         ++index, classSize <<= 1) {
+        auto& freelist = scratch[index];
+        if (!freelist.empty()) {
+            auto* ret = freelist.back();
+            freelist.pop_back();
+            cachedScratch--;
+            recycledScratch++;
+            capacity = classSize;
+            return ret;
+        }
+    }
+
+    return nullptr;
+}
+
+void BufferPool::releaseScratch(char* buffer, size_t capacity) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    const int index = scratch_class_index(capacity);
+    if (index >= 0 && scratch[index].size() < SCRATCH_PER_CLASS) {
+        try {
+            scratch[index].push_back(buffer);
+            cachedScratch++;
+            return;
+        } catch (const std::bad_alloc&) {
+            // fall through and free the buffer
+        }
+    }
+
+    cb_free(buffer);
+    discardedScratch++;
+}
+
+void ScratchBuffer::resize(BufferPool* pool, size_t size) {
+    if (size <= capacity) {
+        len = size;
+        return;
+    }
+
+    reset();
+    this->pool = pool;
+
+    if (pool != nullptr) {
+        buf = pool->tryAcquireScratch(size, capacity);
+    }
+
+    if (buf == nullptr) {
+        capacity = BufferPool::scratchCapacity(size);
+        if (capacity == 0) {
+            // Bigger than the largest size class; allocate the exact
+            // size (releaseScratch will free it rather than cache it)
+            capacity = size;
+        }
+        buf = static_cast<char*>(cb_malloc(capacity));
+        if (buf == nullptr) {
+            capacity = 0;
+            throw std::bad_alloc();
+        }
+    }
+
+    len = size;
+}
+
+void ScratchBuffer::reset() {
+    if (buf != nullptr) {
+        if (pool != nullptr) {
+            pool->releaseScratch(buf, capacity);
+        } else {
+            cb_free(buf);
+        }
+    }
+
+    pool = nullptr;
+    buf = nullptr;
+    capacity = 0;
+    len = 0;
+}
@@ -0,0 +1,304 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/pipe.h>
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+/**
+ * The BufferPool is a cache of the network buffers used by the connections
+ * served by a worker thread. Instead of each connection allocating (and
+ * growing / freeing) its read and write buffers through the global
+ * allocator, idle buffers are handed back to the pool owned by the thread
+ * and recycled by the next connection which needs one.
+ *
+ * Buffers are only acquired and released by the thread owning the pool,
+ * so no locking is needed on those paths. The counters may be read from
+ * other threads (the stats command) and use relaxed atomics.
+ */
+class BufferPool {
+public:
+    /**
+     * The size of the response buffer segments cached by the pool (see
+     * DynamicBuffer). This is the only segment size class we recycle;
+     * the (rare) larger segments are allocated and freed through the
+     * allocator as before.
+     */
+    static const size_t SEGMENT_SIZE = 8 * 1024;
+
+    explicit BufferPool(size_t limit)
+        : limit(limit) {
+    }
+
+    ~BufferPool();
+
+    /**
+     * Try to acquire a buffer from the pool.
+     *
+     * @return a buffer ready for use, or an empty unique_ptr if the pool
+     *         is drained (and the caller needs to allocate a new buffer)
+     */
+    std::unique_ptr<cb::Pipe> tryAcquire();
+
+    /**
+     * Return a buffer to the pool. The buffer is cached for reuse unless
+     * the pool is full or the buffer has grown beyond the size class we
+     * want to keep around (in which case it is freed).
+     *
+     * @param buffer the buffer to return (may not contain any data)
+     * @throws std::logic_error if the buffer contains data
+     */
+    void release(std::unique_ptr<cb::Pipe> buffer);
+
+    /**
+     * Try to acquire a response buffer segment of SEGMENT_SIZE bytes
+     * from the pool.
+     *
+     * @return a segment ready for use, or nullptr if the pool is
+     *         drained (and the caller needs to allocate a new segment)
+     */
+    char* tryAcquireSegment();
+
+    /**
+     * Return a response buffer segment of SEGMENT_SIZE bytes to the
+     * pool. The segment is cached for reuse unless the pool is full
+     * (in which case it is freed).
+     *
+     * @param segment the segment to return (must be SEGMENT_SIZE bytes
+     *                allocated with cb_malloc)
+     */
+    void releaseSegment(char* segment);
+
+    /// The smallest scratch buffer size class we recycle
+    static const size_t MIN_SCRATCH_SIZE = 4 * 1024;
+
+    /// The largest scratch buffer size class we recycle; bigger
+    /// buffers are allocated and freed through the allocator as before
+    static const size_t MAX_SCRATCH_SIZE = 1024 * 1024;
+
+    /// The maximum number of idle scratch buffers cached per size class
+    static const size_t SCRATCH_PER_CLASS = 8;
+
+    /// The number of scratch size classes (MIN_SCRATCH_SIZE doubled up
+    /// to and including MAX_SCRATCH_SIZE)
+    static const size_t NUM_SCRATCH_CLASSES = 9;
+
+    /**
+     * Round a requested scratch buffer size up to the size class it
+     * would be recycled in (the next power of two, starting at
+     * MIN_SCRATCH_SIZE).
+     *
+     * @return the size class capacity, or 0 if the request exceeds
+     *         MAX_SCRATCH_SIZE (and the buffer won't be recycled)
+     */
+    static size_t scratchCapacity(size_t size);
+
+    /**
+     * Try to acquire a scratch buffer (used for e.g. inflating
+     * compressed values) with room for at least `size` bytes.
+     *
+     * @param size the number of bytes needed
+     * @param capacity set to the capacity of the returned buffer (its
+     *                 size class; pass it back to releaseScratch)
+     * @return a buffer ready for use, or nullptr if nothing suitable
+     *         is cached (and the caller needs to allocate)
+     */
+    char* tryAcquireScratch(size_t size, size_t& capacity);
+
+    /**
+     * Return a scratch buffer to the pool. The buffer is cached for
+     * reuse unless its size class is full or it is bigger than
+     * MAX_SCRATCH_SIZE (in which case it is freed).
+     *
+     * @param buffer the buffer to return (allocated with cb_malloc)
+     * @param capacity the capacity the buffer was acquired / allocated
+     *                 with
+     */
+    void releaseScratch(char* buffer, size_t capacity);
+
+    /** Get the maximum number of buffers the pool may cache */
+    size_t getLimit() const {
+        return limit;
+    }
+
+    /** Get the current number of idle buffers cached in the pool */
+    uint64_t getCached() const {
+        return cached;
+    }
+
+    /** Get the total number of buffers handed out from the cache */
+    uint64_t getRecycled() const {
+        return recycled;
+    }
+
+    /** Get the total number of returned buffers we had to free */
+    uint64_t getDiscarded() const {
+        return discarded;
+    }
+
+    /** Get the current number of idle segments cached in the pool */
+    uint64_t getCachedSegments() const {
+        return cachedSegments;
+    }
+
+    /** Get the total number of segments handed out from the cache */
+    uint64_t getRecycledSegments() const {
+        return recycledSegments;
+    }
+
+    /** Get the total number of returned segments we had to free */
+    uint64_t getDiscardedSegments() const {
+        return discardedSegments;
+    }
+
+    /** Get the current number of idle scratch buffers cached in the pool */
+    uint64_t getCachedScratch() const {
+        return cachedScratch;
+    }
+
+    /** Get the total number of scratch buffers handed out from the cache */
+    uint64_t getRecycledScratch() const {
+        return recycledScratch;
+    }
+
+    /** Get the total number of returned scratch buffers we had to free */
+    uint64_t getDiscardedScratch() const {
+        return discardedScratch;
+    }
+
+protected:
+    /** The maximum number of buffers to cache */
+    const size_t limit;
+
+    /** The idle buffers available for reuse */
+    std::vector<std::unique_ptr<cb::Pipe>> buffers;
+
+    /** The idle response buffer segments available for reuse */
+    std::vector<char*> segments;
+
+    /** The current number of idle buffers (mirrors buffers.size()) */
+    Couchbase::RelaxedAtomic<uint64_t> cached{0};
+
+    /** Total number of buffers handed out from the cache */
+    Couchbase::RelaxedAtomic<uint64_t> recycled{0};
+
+    /** Total number of returned buffers we had to free */
+    Couchbase::RelaxedAtomic<uint64_t> discarded{0};
+
+    /** The current number of idle segments (mirrors segments.size()) */
+    Couchbase::RelaxedAtomic<uint64_t> cachedSegments{0};
+
+    /** Total number of segments handed out from the cache */
+    Couchbase::RelaxedAtomic<uint64_t> recycledSegments{0};
+
+    /** Total number of returned segments we had to free */
+    Couchbase::RelaxedAtomic<uint64_t> discardedSegments{0};
+
+    /**
+     * The idle scratch buffers available for reuse, one freelist per
+     * size class
+     */
+    std::array<std::vector<char*>, NUM_SCRATCH_CLASSES> scratch;
+
+    /** The current number of idle scratch buffers (across all classes) */
+    Couchbase::RelaxedAtomic<uint64_t> cachedScratch{0};
+
+    /** Total number of scratch buffers handed out from the cache */
+    Couchbase::RelaxedAtomic<uint64_t> recycledScratch{0};
+
+    /** Total number of returned scratch buffers we had to free */
+    Couchbase::RelaxedAtomic<uint64_t> discardedScratch{0};
+};
+
+/**
+ * A ScratchBuffer is a temporary working buffer (inflating compressed
+ * values before shipping them to a client etc) which is backed by the
+ * worker thread's BufferPool instead of going through the global
+ * allocator for every use.
+ *
+ * The buffer is handed back to the pool when the ScratchBuffer is
+ * destroyed (typically along with the command context owning it), so
+ * it must not outlive the command it was acquired for (command
+ * contexts never do; they're released before the connection may be
+ * picked up by another worker).
+ */
+class ScratchBuffer {
+public:
+    ScratchBuffer() = default;
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+    ~ScratchBuffer() {
+        reset();
+    }
+
+    /**
+     * Make sure the buffer has room for (at least) the requested number
+     * of bytes, trying the provided pool before falling back to the
+     * allocator. The current content of the buffer is <em>not</em>
+     * preserved.
+     *
+     * @param pool the pool to acquire the buffer from (may be nullptr,
+     *             in which case the buffer is allocated directly)
+     * @param size the number of bytes needed
+     * @throws std::bad_alloc if memory allocation fails
+     */
+    void resize(BufferPool* pool, size_t size);
+
+    /** Hand the memory back to the pool (or free it) */
+    void reset();
+
+    char* data() {
+        return buf;
+    }
+
+    const char* data() const {
+        return buf;
+    }
+
+    /** Get the number of bytes of valid data in the buffer */
+    size_t size() const {
+        return len;
+    }
+
+    /** Set the number of bytes of valid data (must fit the capacity) */
+    void setSize(size_t size) {
+        len = size;
+    }
+
+    /** Get the usable capacity of the underlying buffer */
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    /** The pool the buffer was acquired from (and is returned to) */
+    BufferPool* pool = nullptr;
+
+    /** The underlying buffer (allocated with cb_malloc) */
+    char* buf = nullptr;
+
+    /** The capacity of the underlying buffer */
+    size_t capacity = 0;
+
+    /** The number of bytes of valid data in the buffer */
+    size_t len = 0;
+};
@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 #include "cccp_notification_task.h"
+#include "connections.h"
 #include "log_macros.h"
 #include "memcached.h"
 #include "server_event.h"
@@ -57,46 +58,67 @@ public:
         auto& conn = dynamic_cast<McbpConnection&>(connection);
 
         auto& bucket = connection.getBucket();
-        auto payload = bucket.clusterConfiguration.getConfiguration();
-        if (payload.first < conn.getClustermapRevno()) {
+        auto config = bucket.clusterConfiguration.getConfiguration();
+        if (config->revision < conn.getClustermapRevno()) {
             // Ignore.. we've already sent a newer cluster config
             return true;
         }
 
-        conn.setClustermapRevno(payload.first);
-        LOG_NOTICE(&conn,
-                   "%u: Sending Cluster map revision %u",
-                   conn.getId(),
-                   payload.first);
+        conn.setClustermapRevno(config->revision);
+        LOG_INFO(&conn,
+                 "%u: Sending Cluster map revision %u",
+                 conn.getId(),
+                 config->revision);
 
         std::string name = bucket.name;
 
+        // The map itself isn't copied into the send buffer; the message
+        // references the snapshot shared by all of the connections being
+        // pushed this revision (pre-deflated for the clients which
+        // negotiated snappy), and it is kept alive until the message has
+        // been transmitted.
+        const std::string* payload = &config->uncompressed;
+        auto datatype = cb::mcbp::Datatype::JSON;
+        if (conn.isSnappyEnabled() && !config->compressed.empty()) {
+            payload = &config->compressed;
+            datatype = cb::mcbp::Datatype(
+                    uint8_t(cb::mcbp::Datatype::JSON) |
+                    uint8_t(cb::mcbp::Datatype::Snappy));
+        }
+
         using namespace cb::mcbp;
-        size_t needed = sizeof(Request) + // packet header
-                        4 + // rev number in extdata
-                        name.size() + // the name of the bucket
-                        payload.second->size(); // The actual payload
+        const size_t needed = sizeof(Request) + // packet header
+                              4 + // rev number in extdata
+                              name.size(); // the name of the bucket
 
         conn.write->ensureCapacity(needed);
         FrameBuilder<Request> builder(conn.write->wdata());
         builder.setMagic(Magic::ServerRequest);
-        builder.setDatatype(cb::mcbp::Datatype::JSON);
+        builder.setDatatype(datatype);
         builder.setOpcode(ServerOpcode::ClustermapChangeNotification);
 
         // The extras contains the cluster revision number as an uint32_t
-        const uint32_t rev = htonl(payload.first);
+        const uint32_t rev = htonl(config->revision);
         builder.setExtras(
                 {reinterpret_cast<const uint8_t*>(&rev), sizeof(rev)});
         builder.setKey(
                 {reinterpret_cast<const uint8_t*>(name.data()), name.size()});
-        builder.setValue(
-                {reinterpret_cast<const uint8_t*>(payload.second->data()),
-                 payload.second->size()});
+
+        // The value is sent as its own iovec entry referencing the shared
+        // snapshot; account for it in the body length.
+        builder.getFrame()->setBodylen(
+                uint32_t(sizeof(rev) + name.size() + payload->size()));
 
         // Inject our packet into the stream!
         conn.addMsgHdr(true);
         conn.addIov(conn.write->wdata().data(), needed);
         conn.write->produced(needed);
+        conn.addIov(payload->data(), payload->size());
+        if (!conn.pinSharedBuffer(
+                    std::shared_ptr<const std::string>(config, payload))) {
+            conn.setState(McbpStateMachine::State::closing);
+            return true;
+        }
 
         conn.setState(McbpStateMachine::State::send_data);
         conn.setWriteAndGo(McbpStateMachine::State::new_cmd);
@@ -121,43 +143,62 @@ Task::Status CccpNotificationTask::execute() {
     // thread.
     // No one is using this task so we can safely release the lock
     getMutex().unlock();
+    size_t enqueued = 0;
     try {
-        iterate_all_connections([rev](Connection& c) -> void {
-            if (!c.isClustermapChangeNotificationSupported()) {
-                // The client hasn't asked to be notified
-                return;
-            }
-
-            auto* connection = dynamic_cast<McbpConnection*>(&c);
-            if (connection == nullptr) {
-                // Ignore listening connection objects
-                return;
+        // Walk the workers one at a time and batch the wakeup per worker:
+        // the interested connections are enlisted in the thread's
+        // pending-io list and the thread notified once, instead of
+        // raising a separate libevent event for every single connection.
+        for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+            auto* thr = get_worker_thread(ii);
+            if (thr == nullptr) {
+                continue;
             }
 
-            if (rev <= connection->getClustermapRevno()) {
-                LOG_NOTICE(connection,
-                           "%u: Client is using %u, no need to push %u",
-                           c.getId(),
-                           connection->getClustermapRevno(),
-                           rev);
-                return;
+            int notify = 0;
+            LOCK_THREAD(thr);
+            iterate_thread_connections(
+                    thr, [rev, &notify, &enqueued](Connection& c) -> void {
+                        if (!c.isClustermapChangeNotificationSupported()) {
+                            // The client hasn't asked to be notified
+                            return;
+                        }
+
+                        auto* connection = dynamic_cast<McbpConnection*>(&c);
+                        if (connection == nullptr) {
+                            // Ignore listening connection objects
+                            return;
+                        }
+
+                        if (rev <= connection->getClustermapRevno()) {
+                            // The client already got this (or a newer) map
+                            return;
+                        }
+
+                        connection->enqueueServerEvent(
+                                std::make_unique<
+                                        CccpPushNotificationServerEvent>());
+                        ++enqueued;
+                        if (connection->isIdle()) {
+                            notify |= add_conn_to_pending_io_list(connection);
+                        }
+                    });
+            UNLOCK_THREAD(thr);
+            if (notify) {
+                notify_thread(thr);
             }
-
-            LOG_NOTICE(connection,
-                       "%u: Client is using %u. Push %u",
-                       c.getId(),
-                       connection->getClustermapRevno(),
-                       rev);
-
-            connection->enqueueServerEvent(
-                    std::make_unique<CccpPushNotificationServerEvent>());
-            connection->signalIfIdle(false, 0);
-        });
+        }
     } catch (const std::exception& e) {
         LOG_WARNING(nullptr,
                     "CccpNotificationTask::execute: received exception: %s",
                     e.what());
     }
+    LOG_NOTICE(nullptr,
+               "Queued cluster config revision:[%u] push for bucket:[%s] to "
+               "%u clients",
+               revision,
+               bucket.name,
+               unsigned(enqueued));
     getMutex().lock();
 
     return Status::Finished;
@@ -16,11 +16,36 @@
  */
 #include "cluster_config.h"
 
+#include <platform/compress.h>
 #include <subdoc/operations.h>
 
 #include <cstdlib>
 #include <stdexcept>
 
+/**
+ * Deflate the configuration with snappy; returns an empty string if the
+ * compression failed or didn't shrink the map (in which case we'll send
+ * the uncompressed variant to everyone).
+ */
+static std::string deflateConfiguration(cb::const_char_buffer buffer) {
+    cb::compression::Buffer deflated;
+    if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                 buffer.data(),
+                                 buffer.size(),
+                                 deflated) &&
+        deflated.len < buffer.size()) {
+        return std::string{deflated.data.get(), deflated.len};
+    }
+    return {};
+}
+
+ClusterConfiguration::Configuration::Configuration(int revision,
+                                                   cb::const_char_buffer buffer)
+    : revision(revision),
+      uncompressed(buffer.begin(), buffer.end()),
+      compressed(deflateConfiguration(buffer)) {
+}
+
 void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer) {
     int rev = getRevisionNumber(buffer);
     if (rev == -1) {
@@ -29,9 +54,12 @@ void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer) {
                 "revision");
     }
 
+    // Build the snapshot (including the deflated copy) before grabbing
+    // the mutex; it only needs to be held for the pointer swap.
+    auto next = std::make_shared<Configuration>(rev, buffer);
+
     std::lock_guard<std::mutex> guard(mutex);
-    revision = rev;
-    config = std::make_shared<std::string>(buffer.begin(), buffer.end());
+    config = next;
 }
 
 int ClusterConfiguration::getRevisionNumber(cb::const_char_buffer buffer) {
@@ -32,21 +32,52 @@
  */
 class ClusterConfiguration {
 public:
-    ClusterConfiguration()
-        : config(std::make_shared<std::string>()), revision(-1) {
+    /**
+     * An immutable snapshot of a cluster configuration.
+     *
+     * The same snapshot is shared by every connection sending this
+     * revision of the configuration to a client (the message just
+     * references the snapshot, see McbpConnection::pinSharedBuffer), and
+     * it carries a pre-deflated variant so that the map is compressed
+     * once per revision rather than once per client.
+     */
+    class Configuration {
+    public:
+        Configuration() : revision(-1) {
+        }
+
+        Configuration(int revision, cb::const_char_buffer buffer);
+
+        /**
+         * The revision of the configuration (-1 if no configuration has
+         * been set)
+         */
+        const int revision;
+
+        /**
+         * The configuration as provided by ns_server
+         */
+        const std::string uncompressed;
+
+        /**
+         * Snappy-deflated variant for clients which negotiated snappy.
+         * Empty if deflating failed or did not shrink the map.
+         */
+        const std::string compressed;
+    };
+
+    ClusterConfiguration() : config(std::make_shared<Configuration>()) {
     }
 
     void setConfiguration(cb::const_char_buffer buffer);
 
     /**
-     * Get the current configuration.
-     *
-     * @return a pair where the first element is the revision number, and
-     *         the second element is (a copy) of the configuration.
+     * Get the current configuration snapshot (shared with everyone else
+     * sending this revision of the configuration).
      */
-    std::pair<int, std::shared_ptr<std::string>> getConfiguration() const {
+    std::shared_ptr<Configuration> getConfiguration() const {
         std::lock_guard<std::mutex> guard(mutex);
-        return std::make_pair(revision, config);
+        return config;
     };
 
     /**
@@ -59,21 +90,14 @@ public:
 
 private:
     /**
-     * We use a mutex so that we can get a consistent copy of the revision
-     * number and the configuration. (we cache the revision number to avoid
-     * parsing the JSON every time we have to handle a not my vbucket reply
-     * because we want to be able to avoid sending duplicates of the cluster
-     * configuration map to the clients).
+     * The mutex only guards the pointer to the current snapshot; the
+     * snapshot itself is immutable so readers operate on their reference
+     * without any locking.
      */
     mutable std::mutex mutex;
 
     /**
-     * The actual config
-     */
-    std::shared_ptr<std::string> config;
-
-    /**
-     * Cached revision so we don't have to parse it every time
+     * The current snapshot of the config
      */
-    int revision;
+    std::shared_ptr<Configuration> config;
 };
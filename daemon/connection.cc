@@ -66,6 +66,7 @@ Connection::Connection(SOCKET sfd, event_base* b)
       refcount(0),
       engine_storage(nullptr),
       next(nullptr),
+      enlisted_in_pending_io(false),
       thread(nullptr),
       parent_port(0),
       bucketEngine(nullptr),
@@ -209,6 +210,33 @@ bool Connection::setTcpNoDelay(bool enable) {
     return true;
 }
 
+bool Connection::setTcpCork(bool enable) {
+#if defined(TCP_CORK)
+    if (socketDescriptor == INVALID_SOCKET || corked == enable) {
+        return false;
+    }
+
+    int flags = enable ? 1 : 0;
+    int error = setsockopt(socketDescriptor,
+                           IPPROTO_TCP,
+                           TCP_CORK,
+                           reinterpret_cast<void*>(&flags),
+                           sizeof(flags));
+
+    if (error != 0) {
+        std::string errmsg = cb_strerror(GetLastNetworkError());
+        LOG_WARNING(this, "setsockopt(TCP_CORK): %s", errmsg.c_str());
+        return false;
+    }
+
+    corked = enable;
+    return true;
+#else
+    (void)enable;
+    return false;
+#endif
+}
+
 std::string to_string(Protocol protocol) {
     switch (protocol) {
     case Protocol::Memcached:
@@ -285,6 +313,7 @@ void Connection::restartAuthentication() {
 
 cb::engine_errc Connection::dropPrivilege(cb::rbac::Privilege privilege) {
     if (privilegeContext.dropPrivilege(privilege)) {
+        invalidatePrivilegeVerdictCache();
         return cb::engine_errc::success;
     }
 
@@ -301,6 +330,7 @@ cb::rbac::PrivilegeAccess Connection::checkPrivilege(
                    cb::rbac::PrivilegeAccess::Stale &&
            retries < max_retries) {
         ++retries;
+        invalidatePrivilegeVerdictCache();
         std::string command;
         auto* mcbp = dynamic_cast<McbpConnection*>(this);
         if (mcbp != nullptr) {
@@ -545,6 +575,8 @@ void Connection::setBucketIndex(int bucketIndex) {
         privilegeContext.setBucketPrivileges();
     }
 
+    invalidatePrivilegeVerdictCache();
+
     LOG_DEBUG(nullptr, "RBAC: %u %s switch privilege context %s",
               getId(), getDescription().c_str(),
               privilegeContext.to_string().c_str());
@@ -24,6 +24,7 @@
 #include <cJSON.h>
 #include <cbsasl/cbsasl.h>
 #include <memcached/rbac.h>
+#include <array>
 #include <chrono>
 #include <queue>
 #include <string>
@@ -163,6 +164,7 @@ public:
             resetUsernameCache();
             privilegeContext = cb::rbac::PrivilegeContext{};
         }
+        invalidatePrivilegeVerdictCache();
     }
 
     const Priority& getPriority() const {
@@ -187,6 +189,17 @@ public:
      */
     bool setTcpNoDelay(bool enable);
 
+    /**
+     * Cork or uncork the underlying socket (TCP_CORK). While corked the
+     * kernel coalesces our writes into full sized segments instead of
+     * sending each one right away (we run with TCP NoDelay enabled);
+     * uncorking flushes whatever partial segment remains. This is a
+     * no-op on platforms without TCP_CORK.
+     *
+     * @return true if the setting was changed, false otherwise
+     */
+    bool setTcpCork(bool enable);
+
     /**
      * Get the username this connection is authenticated as
      *
@@ -230,6 +243,20 @@ public:
         Connection::next = next;
     }
 
+    /**
+     * Is the connection currently enlisted in its thread's pending io
+     * list? The flag makes enqueueing O(1); the tail of the list can't
+     * be told apart from an unlinked connection by looking at next.
+     * Protected by the thread mutex, just like the list itself.
+     */
+    bool isEnlistedInPendingIo() const {
+        return enlisted_in_pending_io;
+    }
+
+    void setEnlistedInPendingIo(bool enlisted) {
+        enlisted_in_pending_io = enlisted;
+    }
+
     LIBEVENT_THREAD* getThread() const {
         return thread.load(std::memory_order_relaxed);
     }
@@ -269,6 +296,55 @@ public:
     cb::rbac::PrivilegeAccess checkPrivilege(cb::rbac::Privilege privilege,
                                              Cookie& cookie);
 
+    /**
+     * Look up the cached verdict of the per-opcode privilege chain for
+     * the given opcode.
+     *
+     * The verdict of the chain only depends on the opcode and the
+     * connection's privilege context, so it may be reused for the
+     * millions of consecutive identical commands a connection
+     * typically executes. A cached entry is only valid as long as the
+     * privilege context is unchanged (tracked with a connection-local
+     * version, as dropPrivilege modifies the context without changing
+     * its generation) and the privilege database hasn't been replaced.
+     *
+     * @param opcode the opcode to look up
+     * @param[out] verdict the cached verdict (only set on a hit)
+     * @return true if a valid cached verdict existed
+     */
+    bool lookupPrivilegeVerdict(uint8_t opcode,
+                                cb::rbac::PrivilegeAccess& verdict) const {
+        const auto& entry = privilegeVerdictCache[opcode];
+        if (entry.version == privilegeVerdictVersion &&
+            privilegeContext.getGeneration() == cb::rbac::getGeneration()) {
+            verdict = entry.verdict;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Cache the verdict of the per-opcode privilege chain for the
+     * given opcode (Stale verdicts should not be cached)
+     */
+    void cachePrivilegeVerdict(uint8_t opcode,
+                               cb::rbac::PrivilegeAccess verdict) {
+        auto& entry = privilegeVerdictCache[opcode];
+        entry.version = privilegeVerdictVersion;
+        entry.verdict = verdict;
+    }
+
+    /**
+     * Throw away all cached privilege verdicts. Must be called
+     * whenever the privilege context is replaced or modified.
+     */
+    void invalidatePrivilegeVerdictCache() {
+        if (++privilegeVerdictVersion == 0) {
+            // 0 marks a slot which was never filled
+            ++privilegeVerdictVersion;
+        }
+    }
+
     /**
      * Try to drop the specified privilege from the current context
      *
@@ -445,6 +521,29 @@ protected:
      */
     cb::rbac::PrivilegeContext privilegeContext;
 
+    /**
+     * A cached verdict of the per-opcode privilege chain. An entry is
+     * valid if its version matches privilegeVerdictVersion (and the
+     * privilege context still maps to the installed privilege
+     * database; see lookupPrivilegeVerdict)
+     */
+    struct PrivilegeVerdictEntry {
+        uint32_t version = 0;
+        cb::rbac::PrivilegeAccess verdict = cb::rbac::PrivilegeAccess::Fail;
+    };
+
+    /**
+     * Cached per-opcode privilege chain verdicts. Only accessed by
+     * the thread currently serving the connection.
+     */
+    std::array<PrivilegeVerdictEntry, 0x100> privilegeVerdictCache;
+
+    /**
+     * Bumped every time the privilege context changes in order to
+     * invalidate all entries in privilegeVerdictCache
+     */
+    uint32_t privilegeVerdictVersion = 1;
+
     /**
      * The SASL object used to do sasl authentication
      */
@@ -468,6 +567,9 @@ protected:
     /** Is tcp nodelay enabled or not? */
     bool nodelay;
 
+    /** Is the socket currently corked (TCP_CORK)? */
+    bool corked = false;
+
     /** number of references to the object */
     uint8_t refcount;
 
@@ -481,6 +583,10 @@ protected:
     /* Used for generating a list of Connection structures */
     Connection* next;
 
+    /* Set while the connection is a member of the thread's pending io
+     * list (see isEnlistedInPendingIo) */
+    bool enlisted_in_pending_io;
+
     /** Pointer to the thread object serving this connection */
     std::atomic<LIBEVENT_THREAD*> thread;
 
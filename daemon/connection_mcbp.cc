@@ -15,11 +15,14 @@
  *   limitations under the License.
  */
 #include "config.h"
+#include "buffer_pool.h"
 #include "connections.h"
 #include "mc_time.h"
+#include "mcbp_capture.h"
 #include "memcached.h"
 #include "runtime.h"
 #include "server_event.h"
+#include "ssl_handshake_task.h"
 #include "statemachine_mcbp.h"
 
 #include <mcbp/mcbp.h>
@@ -29,6 +32,7 @@
 #include <platform/strerror.h>
 #include <platform/timeutils.h>
 #include <utilities/protocol2text.h>
+#include <algorithm>
 #include <cctype>
 #include <exception>
 
@@ -165,6 +169,119 @@ bool McbpConnection::reapplyEventmask() {
     return updateEvent(ev_flags);
 }
 
+bool McbpConnection::isMigratable() {
+    // A command context (even a completed one awaiting the next
+    // command) may hold resources tied to the current worker thread
+    // (scratch buffers from its BufferPool etc).
+    if (!registered_in_libevent || isDCP() || isInternal() ||
+        isEwouldblock() || getRefcount() > 1 || hasBlockedCommands() ||
+        sslHandshakeTask || commandContext ||
+        !batchedCommandContexts.empty()) {
+        return false;
+    }
+
+    switch (getState()) {
+    case McbpStateMachine::State::new_cmd:
+    case McbpStateMachine::State::waiting:
+    case McbpStateMachine::State::read_packet_header:
+        break;
+    default:
+        // Mid-command (or closing); the current thread has to keep
+        // driving the connection.
+        return false;
+    }
+
+    // Nothing may be buffered in either direction: pending input means
+    // there's a (pipelined) request to execute, pending output still
+    // has to be transmitted from here.
+    if ((read && !read->empty()) || (write && !write->empty()) ||
+        msgcurr != msglist.size()) {
+        return false;
+    }
+
+    if (ssl.isEnabled() &&
+        (ssl.havePendingInputData() || ssl.morePendingOutput())) {
+        return false;
+    }
+
+    return true;
+}
+
+bool McbpConnection::isParkable() {
+    // Only connections sitting between commands (or a DCP stream with
+    // nothing to ship) may be parked; anything else is still being
+    // driven and needs its buffers where they are.
+    switch (getState()) {
+    case McbpStateMachine::State::new_cmd:
+    case McbpStateMachine::State::waiting:
+    case McbpStateMachine::State::read_packet_header:
+    case McbpStateMachine::State::ship_log:
+        break;
+    default:
+        return false;
+    }
+
+    if (sslHandshakeTask) {
+        return false;
+    }
+
+    // Nothing may be buffered in either direction: pending input is a
+    // (partial) request yet to execute, pending output still has to be
+    // transmitted.
+    if ((read && !read->empty()) || (write && !write->empty()) ||
+        msgcurr != msglist.size()) {
+        return false;
+    }
+
+    if (ssl.isEnabled() &&
+        (ssl.havePendingInputData() || ssl.morePendingOutput())) {
+        return false;
+    }
+
+    return true;
+}
+
+bool McbpConnection::park(BufferPool& pool) {
+    // Ordinary connections give their buffers back after every event
+    // loop run, so this mostly reclaims the buffers DCP connections
+    // hold on to. The next runEventLoop() re-loans buffers before the
+    // state machinery runs, so a parked connection is simply an armed
+    // libevent entry until the next byte (or engine notification)
+    // arrives.
+    bool reclaimed = false;
+    if (read && read->empty()) {
+        pool.release(std::move(read));
+        reclaimed = true;
+    }
+    if (write && write->empty()) {
+        pool.release(std::move(write));
+        reclaimed = true;
+    }
+    return reclaimed;
+}
+
+bool McbpConnection::prepareForMigration(LIBEVENT_THREAD* target) {
+    if (!unregisterEvent()) {
+        return false;
+    }
+
+    auto* oldBase = base;
+    base = target->base;
+    if (event_assign(&event, base, socketDescriptor, ev_flags, event_handler,
+                     reinterpret_cast<void*>(this)) == -1) {
+        // Roll back onto the old base; we're still owned by the
+        // current thread.
+        base = oldBase;
+        event_assign(&event, base, socketDescriptor, ev_flags, event_handler,
+                     reinterpret_cast<void*>(this));
+        registerEvent();
+        return false;
+    }
+
+    setThread(target);
+    return true;
+}
+
 bool McbpConnection::initializeEvent() {
     short event_flags = (EV_READ | EV_PERSIST);
 
@@ -238,7 +355,37 @@ bool McbpConnection::tryAuthFromSslCert(const std::string& userName) {
 }
 
 int McbpConnection::sslPreConnection() {
-    int r = ssl.accept();
+    int r;
+
+    if (sslHandshakeTask) {
+        // A handshake attempt has been dispatched to the executor
+        // pool; pick up its result (or keep the connection parked if
+        // the crypto is still being computed - we may have been woken
+        // by a network event).
+        auto* task =
+                reinterpret_cast<SslHandshakeTask*>(sslHandshakeTask.get());
+        {
+            std::lock_guard<std::mutex> guard(sslHandshakeTask->getMutex());
+            if (!task->isFinished()) {
+                set_ewouldblock();
+                return -1;
+            }
+        }
+        r = task->getResult();
+        sslHandshakeTask.reset();
+    } else {
+        // The handshake crypto (the RSA / ECDHE computation inside
+        // SSL_accept) is expensive enough that a storm of reconnecting
+        // TLS clients would pin this worker thread for seconds;
+        // dispatch it to the executor pool and park the connection
+        // until the result is ready.
+        sslHandshakeTask = std::make_shared<SslHandshakeTask>(*this, ssl);
+        std::lock_guard<std::mutex> guard(sslHandshakeTask->getMutex());
+        executorPool->schedule(sslHandshakeTask, true);
+        set_ewouldblock();
+        return -1;
+    }
+
     if (r == 1) {
         ssl.drainBioSendPipe(socketDescriptor);
         ssl.setConnected();
@@ -310,11 +457,16 @@ int McbpConnection::recv(char* dest, size_t nbytes) {
 
     int res;
     if (ssl.isEnabled()) {
-        ssl.drainBioRecvPipe(socketDescriptor);
+        // While a handshake is being computed in the executor pool the
+        // task owns the SSL structures; don't feed the BIOs until it
+        // has completed (sslPreConnection picks up the result)
+        if (!sslHandshakeTask) {
+            ssl.drainBioRecvPipe(socketDescriptor);
 
-        if (ssl.hasError()) {
-            set_econnreset();
-            return -1;
+            if (ssl.hasError()) {
+                set_econnreset();
+                return -1;
+            }
         }
 
         if (!ssl.isConnected()) {
@@ -426,6 +578,17 @@ McbpConnection::TransmitResult McbpConnection::transmit() {
         msgcurr++;
     }
 
+    // When several responses are pending (a batch of responses, or a
+    // single response spanning multiple message headers) cork the
+    // socket so that the kernel coalesces the individual sendmsg()
+    // calls into full sized segments. We run with TCP NoDelay enabled,
+    // so without corking each call may generate its own (partial)
+    // segment on the wire. The socket is uncorked when the batch is
+    // complete, flushing whatever remains.
+    if (msglist.size() - msgcurr > 1) {
+        setTcpCork(true);
+    }
+
     if (msgcurr < msglist.size()) {
         ssize_t res;
         struct msghdr* m = &msglist[msgcurr];
@@ -451,6 +614,7 @@ McbpConnection::TransmitResult McbpConnection::transmit() {
                         }
                         return TransmitResult::SoftError;
                     }
+                    setTcpCork(false);
                     return TransmitResult::Complete;
                 }
             }
@@ -494,10 +658,59 @@ McbpConnection::TransmitResult McbpConnection::transmit() {
         setState(McbpStateMachine::State::closing);
         return TransmitResult::HardError;
     } else {
+        setTcpCork(false);
         return TransmitResult::Complete;
     }
 }
 
+bool McbpConnection::maybeBatchResponse() {
+    // Only the plain request/response pattern may have its transmission
+    // deferred. DCP operates in full duplex mode, and the other targets
+    // for write_and_go depend on the write hitting the socket.
+    if (isDCP() || write_and_go != McbpStateMachine::State::new_cmd) {
+        return false;
+    }
+
+    // The next request must already be complete in the input buffer;
+    // if it isn't we should flush what we've got while waiting for the
+    // client to send us more data.
+    if (!isPacketAvailable()) {
+        return false;
+    }
+
+    // Error responses may reference memory owned by the cookie, and the
+    // cookie is reset when we start executing the next command. Send
+    // them immediately (they're not on the hot path anyway).
+    if (!cookie.getErrorJson().empty()) {
+        return false;
+    }
+
+    // Bound the amount of data (and the number of iovector entries) we
+    // accumulate before flushing to the socket, and make sure there is
+    // room in the write buffer for the next response header.
+    if (batchedBytes + msgbytes >= BATCH_SEND_HIGHWAT ||
+        msglist.size() >= MSG_LIST_HIGHWAT ||
+        write->wdata().size() < sizeof(protocol_binary_response_header)) {
+        return false;
+    }
+
+    if (numEvents <= 0) {
+        // We've used up the timeslice for this connection; flush the
+        // batch before yielding to the other connections.
+        return false;
+    }
+
+    // The response may reference memory owned by the command context
+    // (the item's value, inflate buffers etc), so keep the context
+    // alive until the batched write completes.
+    if (commandContext) {
+        batchedCommandContexts.emplace_back(std::move(commandContext));
+    }
+    ++batchedResponses;
+    batchedBytes += msgbytes;
+    return true;
+}
+
 /**
  * To protect us from someone flooding a connection with bogus data causing
  * the connection to eat up all available memory, break out and start
@@ -515,20 +728,53 @@ McbpConnection::TryReadResult McbpConnection::tryReadNetwork() {
                 "contain a partial header");
     }
 
-    // Make sure we can fit the header into the input buffer
+    // Make sure we can fit the header into the input buffer, and try
+    // to drain an entire burst of pipelined requests off the socket in
+    // as few recv() calls as possible by reading ahead.
+    const auto readahead = std::max(
+            size_t(settings.getReadaheadBufferSize()),
+            sizeof(cb::mcbp::Request));
     try {
-        read->ensureCapacity(sizeof(cb::mcbp::Request) - read->rsize());
+        read->ensureCapacity(readahead - read->rsize());
     } catch (const std::bad_alloc&) {
         return TryReadResult::MemoryError;
     }
 
     McbpConnection* c = this;
-    const auto res = read->produce([c](cb::byte_buffer buffer) -> ssize_t {
-        return c->recv(reinterpret_cast<char*>(buffer.data()), buffer.size());
-    });
-
-    if (res > 0) {
-        get_thread_stats(this)->bytes_read += res;
+    ssize_t total = 0;
+    ssize_t res;
+    bool full = false;
+    do {
+        if (full) {
+            // The last recv() filled the entire buffer; grow it and
+            // keep draining (bounded below) so that the whole burst is
+            // picked up in this pass.
+            try {
+                read->ensureCapacity(readahead);
+            } catch (const std::bad_alloc&) {
+                break;
+            }
+        }
+        full = false;
+        res = read->produce([c, &full](cb::byte_buffer buffer) -> ssize_t {
+            const auto nr = c->recv(reinterpret_cast<char*>(buffer.data()),
+                                    buffer.size());
+            full = (nr == ssize_t(buffer.size()));
+            return nr;
+        });
+        if (res > 0) {
+            total += res;
+        }
+    } while (res > 0 && full && total < ssize_t(readahead * 3));
+
+    if (total > 0) {
+        get_thread_stats(this)->bytes_read += total;
+        if (mcbp_capture_enabled()) {
+            // Feed the spooled input to the workload capture. The
+            // precondition above guarantees every complete frame in the
+            // buffer arrived in this pass, so no frame is seen twice.
+            mcbp_capture_frames(read->rdata());
+        }
         return TryReadResult::DataReceived;
     }
 
@@ -668,7 +914,9 @@ int McbpConnection::sslWrite(const char* src, size_t nbytes) {
 }
 
 void McbpConnection::addMsgHdr(bool reset) {
-    if (reset) {
+    // If we've got batched responses queued up we must keep appending
+    // to the message list; it'll be reset when the batch is flushed.
+    if (reset && !isResponseBatchPending()) {
         msgcurr = 0;
         msglist.clear();
         iovused = 0;
@@ -709,6 +957,7 @@ void McbpConnection::addIov(const void* buf, size_t len) {
     m->msg_iov[m->msg_iovlen].iov_len = len;
 
     msgbytes += len;
+    chargeEventBytes(len);
     ++iovused;
     STATS_MAX(this, iovused_high_watermark, getIovUsed());
     m->msg_iovlen++;
@@ -763,6 +1012,28 @@ McbpConnection::~McbpConnection() {
     for (auto* ptr : temp_alloc) {
         cb_free(ptr);
     }
+    // The destructor may run after the worker threads (and their buffer
+    // pools) are gone; free the segments rather than trying to recycle
+    // them.
+    for (auto* ptr : temp_segments) {
+        cb_free(ptr);
+    }
+}
+
+void McbpConnection::releaseTempSegments() {
+    if (temp_segments.empty()) {
+        return;
+    }
+
+    auto* pool = (getThread() != nullptr) ? getThread()->buffer_pool : nullptr;
+    for (auto* ptr : temp_segments) {
+        if (pool != nullptr) {
+            pool->releaseSegment(ptr);
+        } else {
+            cb_free(ptr);
+        }
+    }
+    temp_segments.resize(0);
 }
 
 void McbpConnection::setState(McbpStateMachine::State next_state) {
@@ -828,6 +1099,8 @@ unique_cJSON_ptr McbpConnection::toJSON() const {
         cJSON_AddBoolToObject(obj, "dcp_no_value", isDcpNoValue());
         cJSON_AddNumberToObject(obj, "max_reqs_per_event",
                                 max_reqs_per_event);
+        cJSON_AddNumberToObject(obj, "max_bytes_per_event",
+                                max_bytes_per_event);
         cJSON_AddNumberToObject(obj, "nevents", numEvents);
         cJSON_AddStringToObject(obj, "state", getStateName());
 
@@ -913,6 +1186,22 @@ unique_cJSON_ptr McbpConnection::toJSON() const {
         cJSON_AddUintPtrToObject(obj, "cas", cas);
         cJSON_AddNumberToObject(obj, "aiostat", aiostat);
         cJSON_AddBoolToObject(obj, "ewouldblock", ewouldblock);
+        {
+            size_t parked = 0;
+            size_t ready = 0;
+            for (const auto& slot : blockedCommands) {
+                if (slot->parked) {
+                    ++parked;
+                } else if (slot->ready) {
+                    ++ready;
+                }
+            }
+            cJSON* blocked = cJSON_CreateObject();
+            cJSON_AddNumberToObject(blocked, "slots", blockedCommands.size());
+            cJSON_AddNumberToObject(blocked, "parked", parked);
+            cJSON_AddNumberToObject(blocked, "ready", ready);
+            cJSON_AddItemToObject(obj, "blocked_commands", blocked);
+        }
         cJSON_AddItemToObject(obj, "ssl", ssl.toJSON());
         cJSON_AddNumberToObject(obj, "total_recv", totalRecv);
         cJSON_AddNumberToObject(obj, "total_send", totalSend);
@@ -929,6 +1218,235 @@ const Protocol McbpConnection::getProtocol() const {
     return Protocol::Memcached;
 }
 
+bool McbpConnection::isBlockedCommandEligible(uint8_t opcode) {
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_GET:
+    case PROTOCOL_BINARY_CMD_GETQ:
+    case PROTOCOL_BINARY_CMD_GETK:
+    case PROTOCOL_BINARY_CMD_GETKQ:
+    case PROTOCOL_BINARY_CMD_GAT:
+    case PROTOCOL_BINARY_CMD_GATQ:
+    case PROTOCOL_BINARY_CMD_TOUCH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool McbpConnection::isReorderSafe(uint8_t opcode) {
+    if (isBlockedCommandEligible(opcode)) {
+        return true;
+    }
+
+    // The key operations: they only touch the selected bucket and their
+    // responses are correlated by opaque, so a client which asked for
+    // unordered execution accepts them completing in any order.
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_SET:
+    case PROTOCOL_BINARY_CMD_SETQ:
+    case PROTOCOL_BINARY_CMD_ADD:
+    case PROTOCOL_BINARY_CMD_ADDQ:
+    case PROTOCOL_BINARY_CMD_REPLACE:
+    case PROTOCOL_BINARY_CMD_REPLACEQ:
+    case PROTOCOL_BINARY_CMD_APPEND:
+    case PROTOCOL_BINARY_CMD_APPENDQ:
+    case PROTOCOL_BINARY_CMD_PREPEND:
+    case PROTOCOL_BINARY_CMD_PREPENDQ:
+    case PROTOCOL_BINARY_CMD_DELETE:
+    case PROTOCOL_BINARY_CMD_DELETEQ:
+    case PROTOCOL_BINARY_CMD_INCREMENT:
+    case PROTOCOL_BINARY_CMD_INCREMENTQ:
+    case PROTOCOL_BINARY_CMD_DECREMENT:
+    case PROTOCOL_BINARY_CMD_DECREMENTQ:
+        return true;
+    default:
+        // Everything else (NOOP, HELLO, SELECT_BUCKET, SASL, DCP, stats,
+        // management, ...) is a barrier
+        return false;
+    }
+}
+
+BlockedCommand* McbpConnection::findBlockedCommandSlot(const Cookie* ck) {
+    for (auto& slot : blockedCommands) {
+        if (&slot->cookie == ck) {
+            return slot.get();
+        }
+    }
+    return nullptr;
+}
+
+void McbpConnection::selectCookieForCommand(uint8_t magic, uint8_t opcode) {
+    currentCookie = &cookie;
+
+    if (magic != PROTOCOL_BINARY_REQ || !allowUnorderedExecution() ||
+        isDCP() || !isBlockedCommandEligible(opcode)) {
+        return;
+    }
+
+    for (auto& slot : blockedCommands) {
+        if (!slot->inUse) {
+            slot->inUse = true;
+            slot->parked = false;
+            slot->ready = false;
+            slot->cookie.reset();
+            currentCookie = &slot->cookie;
+            return;
+        }
+    }
+
+    if (blockedCommands.size() < MAX_BLOCKED_COMMANDS) {
+        blockedCommands.emplace_back(std::make_unique<BlockedCommand>(*this));
+        auto& slot = *blockedCommands.back();
+        slot.inUse = true;
+        currentCookie = &slot.cookie;
+    }
+    // else: the window is exhausted; execute with ordered semantics on
+    // the embedded cookie
+}
+
+void McbpConnection::maybeCopyBlockedCommandPacket() {
+    if (currentCookie == &cookie) {
+        return;
+    }
+
+    auto* slot = findBlockedCommandSlot(currentCookie);
+    auto buffer = currentCookie->getPacket();
+    slot->packet.assign(buffer.begin(), buffer.end());
+    currentCookie->setPacket(
+            Cookie::PacketContent::Full,
+            cb::const_byte_buffer{slot->packet.data(), slot->packet.size()});
+}
+
+bool McbpConnection::parkBlockedCommand() {
+    if (currentCookie == &cookie) {
+        return false;
+    }
+
+    auto* slot = findBlockedCommandSlot(currentCookie);
+    slot->header = binary_header;
+    slot->start = start;
+    slot->executeStart = executeStart;
+    slot->commandContext = std::move(commandContext);
+    slot->parked = true;
+    slot->ready = false;
+
+    currentCookie = &cookie;
+    reExecuting = nullptr;
+    setEwouldblock(false);
+    setAiostat(ENGINE_SUCCESS);
+    return true;
+}
+
+bool McbpConnection::completeBlockedCommand(const Cookie& ck,
+                                            ENGINE_ERROR_CODE status) {
+    auto* slot = findBlockedCommandSlot(&ck);
+    if (slot == nullptr) {
+        return false;
+    }
+
+    if (slot->parked) {
+        slot->parked = false;
+        slot->ready = true;
+        slot->aiostat = status;
+    }
+    // A notification for a slot which isn't parked (e.g. a duplicate
+    // notification racing with the re-execution) is simply dropped; it
+    // must not leak into the connection level aiostat.
+    return true;
+}
+
+void McbpConnection::setupBlockedCommandReexecution() {
+    // Finish off the previous command (mirrors reset_cmd_handler)
+    getCookieObject().reset();
+    releaseBlockedCommandSlot();
+    resetCommandContext();
+    clearDirectResponseBuilt();
+
+    BlockedCommand* slot = nullptr;
+    for (auto& candidate : blockedCommands) {
+        if (candidate->ready) {
+            slot = candidate.get();
+            break;
+        }
+    }
+    if (slot == nullptr) {
+        throw std::logic_error(
+                "McbpConnection::setupBlockedCommandReexecution: no "
+                "completed blocked command");
+    }
+
+    binary_header = slot->header;
+    setCmd(binary_header.request.opcode);
+    setCAS(0);
+    setNoReply(false);
+    setStart(slot->start);
+    setExecuteStart(slot->executeStart);
+    commandContext = std::move(slot->commandContext);
+    setAiostat(slot->aiostat);
+    setEwouldblock(false);
+    addMsgHdr(true);
+
+    slot->ready = false;
+    currentCookie = &slot->cookie;
+    reExecuting = slot;
+}
+
+void McbpConnection::releaseBlockedCommandSlot() {
+    if (currentCookie == &cookie) {
+        return;
+    }
+
+    auto* slot = findBlockedCommandSlot(currentCookie);
+    if (!slot->parked && !slot->ready) {
+        slot->inUse = false;
+        slot->packet.clear();
+    }
+    currentCookie = &cookie;
+    reExecuting = nullptr;
+}
+
+void McbpConnection::abandonBlockedCommands() {
+    currentCookie = &cookie;
+    reExecuting = nullptr;
+    for (auto& slot : blockedCommands) {
+        if (!slot->parked) {
+            // The engine is done with the slot; the response (if any)
+            // will never be sent
+            slot->inUse = false;
+            slot->ready = false;
+            slot->commandContext.reset();
+            slot->packet.clear();
+        }
+    }
+}
+
+bool McbpConnection::hasBlockedCommands() const {
+    for (const auto& slot : blockedCommands) {
+        if (slot->parked || slot->ready) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool McbpConnection::hasReadyBlockedCommand() const {
+    for (const auto& slot : blockedCommands) {
+        if (slot->ready) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool McbpConnection::hasPendingBlockedCommands() const {
+    for (const auto& slot : blockedCommands) {
+        if (slot->parked) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void McbpConnection::maybeLogSlowCommand(
     const std::chrono::milliseconds& elapsed) const {
     auto opcode = cb::mcbp::ClientOpcode(cmd);
@@ -999,9 +1517,11 @@ bool McbpConnection::processServerEvents() {
 }
 
 void McbpConnection::runEventLoop(short which) {
+    lastUsedTime = mc_time_get_current_time();
     conn_loan_buffers(this);
     currentEvent = which;
     numEvents = max_reqs_per_event;
+    eventBytes = 0;
 
     try {
         runStateMachinery();
@@ -1080,7 +1600,7 @@ protocol_binary_response_status McbpConnection::validateCommand(protocol_binary_
 }
 
 void McbpConnection::logCommand() const {
-    if (settings.getVerbose() == 0) {
+    if (settings.getDataPathSnapshot().getVerbose() == 0) {
         // Info is not enabled.. we don't want to try to format
         // output
         return;
@@ -1103,7 +1623,7 @@ void McbpConnection::logResponse(const char* reason) const {
 }
 
 void McbpConnection::logResponse(ENGINE_ERROR_CODE code) const {
-    if (settings.getVerbose() == 0) {
+    if (settings.getDataPathSnapshot().getVerbose() == 0) {
         // Info is not enabled.. we don't want to try to format
         // output
         return;
@@ -1131,9 +1651,10 @@ std::string McbpConnection::getPrintableKey() const {
 }
 
 bool McbpConnection::selectedBucketIsXattrEnabled() const {
+    const auto& snapshot = settings.getDataPathSnapshot();
     if (bucketEngine) {
-        return settings.isXattrEnabled() &&
+        return snapshot.isXattrEnabled() &&
                bucketEngine->isXattrEnabled(getBucketEngineAsV0());
     }
-    return settings.isXattrEnabled();
+    return snapshot.isXattrEnabled();
 }
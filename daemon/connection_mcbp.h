@@ -47,6 +47,8 @@
 #include "ssl_context.h"
 #include "task.h"
 
+class BufferPool;
+
 /**
  * Adjust a message header structure by "consuming" nbytes of data.
  *
@@ -65,6 +67,47 @@
  */
 size_t adjust_msghdr(cb::Pipe& pipe, struct msghdr* m, ssize_t nbytes);
 
+/**
+ * A command parked while the engine works on it (EWOULDBLOCK) so that a
+ * connection which negotiated unordered execution can carry on with the
+ * commands pipelined behind it.
+ *
+ * The command gets a cookie of its own (instead of the connection's
+ * embedded one) so that the engine's completion notification identifies
+ * which command finished, and a copy of its request packet (the input
+ * pipe moves on to the next command while this one is parked). The rest
+ * of the members snapshot the per-command state the executors keep on
+ * the connection.
+ */
+class BlockedCommand {
+public:
+    explicit BlockedCommand(McbpConnection& c) : cookie(c) {
+    }
+
+    Cookie cookie;
+
+    /// Owned copy of the request packet the cookie points into
+    std::vector<uint8_t> packet;
+
+    /// Host-local-byte-order copy of the request header
+    protocol_binary_request_header header = {};
+
+    ProcessClock::time_point start;
+    ProcessClock::time_point executeStart;
+
+    std::unique_ptr<CommandContext> commandContext;
+
+    /// The status the engine completed the command with
+    ENGINE_ERROR_CODE aiostat = ENGINE_SUCCESS;
+
+    /// Slot assigned to a command (executing, parked or ready)
+    bool inUse = false;
+    /// The engine is still working on the command
+    bool parked = false;
+    /// The engine completed the command; awaiting re-execution
+    bool ready = false;
+};
+
 class McbpConnection : public Connection {
 protected:
     /**
@@ -82,6 +125,15 @@ public:
 
     void signalIfIdle(bool logbusy, int workerthread) override;
 
+    /**
+     * @return true if the connection is idle (and not waiting for the
+     *         engine) so that it is safe to wake its event loop in order
+     *         to deliver a server event.
+     */
+    bool isIdle() const {
+        return !isEwouldblock() && stateMachine.isIdleState();
+    }
+
     void setPriority(const Priority& priority) override;
 
     void setState(McbpStateMachine::State next_state);
@@ -222,6 +274,26 @@ public:
         return max_reqs_per_event;
     }
 
+    /**
+     * Charge request / response traffic against this timeslice's byte
+     * budget. Once the configured limit is exceeded the remaining
+     * operation budget is cancelled, so the connection yields to its
+     * siblings through the normal conn_new_cmd path even if it has more
+     * pipelined commands ready. Prevents a few large-document operations
+     * from occupying the worker thread for as long as a whole timeslice
+     * of small ones would.
+     *
+     * DCP connections are exempt; they budget their own shipping.
+     */
+    void chargeEventBytes(size_t nbytes) {
+        if (max_bytes_per_event != 0 && !isDCP()) {
+            eventBytes += nbytes;
+            if (eventBytes >= max_bytes_per_event) {
+                numEvents = 0;
+            }
+        }
+    }
+
     /**
      * Update the settings in libevent for this connection
      *
@@ -251,6 +323,59 @@ public:
         return registered_in_libevent;
     }
 
+    /**
+     * Is the connection completely quiescent, so that it may be handed
+     * over to another worker thread? That requires that nothing (the
+     * engine, the executor pool, buffered input/output) may try to
+     * drive the connection while it is in transit. May only be called
+     * by the owning thread, while holding the thread mutex.
+     */
+    bool isMigratable();
+
+    /**
+     * Detach the connection from the current thread's event base and
+     * re-point it at the target thread's. The caller must have
+     * verified isMigratable() and is responsible for enlisting the
+     * connection with the new thread afterwards; until then the
+     * connection is not registered in any event base.
+     *
+     * @param target the thread taking over the connection
+     * @return true on success; false if the connection could not be
+     *         detached (it is left registered with the current thread)
+     */
+    bool prepareForMigration(LIBEVENT_THREAD* target);
+
+    /**
+     * May the connection's buffers be parked (handed back to the worker
+     * thread's buffer pool)? That requires the connection to be sitting
+     * idle between commands with nothing buffered in either direction.
+     * Unlike migration the connection stays with its thread, so DCP
+     * connections and lingering command contexts are fine. May only be
+     * called by the owning thread, while holding the thread mutex.
+     */
+    bool isParkable();
+
+    /**
+     * Park the connection: return its (empty) network buffers to the
+     * given pool, leaving just the armed libevent state behind. The
+     * buffers are re-loaned by the next event loop run, so this is
+     * invisible to the client apart from the reclaimed memory. The
+     * caller must have verified isParkable().
+     *
+     * @param pool the buffer pool to return the buffers to
+     * @return true if any buffer was actually reclaimed
+     */
+    bool park(BufferPool& pool);
+
+    /**
+     * Get the last time (in rel_time_t terms) the event loop ran for
+     * this connection; used to find connections quiet long enough to
+     * park.
+     */
+    rel_time_t getLastUsedTime() const {
+        return lastUsedTime;
+    }
+
     short getEventFlags() const {
         return ev_flags;
     }
@@ -345,6 +470,39 @@ public:
      */
     TryReadResult tryReadNetwork();
 
+    /**
+     * Check if we may defer the transmission of the response we've just
+     * built up and continue executing the next request from the input
+     * buffer (pipelined by the client), so that all of the responses may
+     * be flushed to the socket in a single write.
+     *
+     * If we decide to defer the transmission the command context for the
+     * current command is kept alive (the response may reference memory
+     * owned by the context) until the batched write completes.
+     *
+     * @return true if the response was batched and we may proceed with
+     *              the next command, false if the caller should transmit
+     */
+    bool maybeBatchResponse();
+
+    /**
+     * Do we have responses queued up in the message list which belongs
+     * to an earlier command than the one being executed?
+     */
+    bool isResponseBatchPending() const {
+        return batchedResponses > 0;
+    }
+
+    /**
+     * Release all resources pinned by batched responses (called when
+     * the batched write completes (or the connection is being torn down))
+     */
+    void clearBatchedResponses() {
+        batchedCommandContexts.clear();
+        batchedResponses = 0;
+        batchedBytes = 0;
+    }
+
     const McbpStateMachine::State getWriteAndGo() const {
         return write_and_go;
     }
@@ -410,6 +568,108 @@ public:
         temp_alloc.resize(0);
     }
 
+    /**
+     * Take ownership of a standard sized response buffer segment (see
+     * DynamicBuffer) referenced by the response being built up, and
+     * keep it alive until the response has been transmitted.
+     *
+     * @return true if success, false otherwise
+     */
+    bool pushTempSegment(char* ptr) {
+        try {
+            temp_segments.push_back(ptr);
+            return true;
+        } catch (std::bad_alloc) {
+            LOG_WARNING(this,
+                        "%u: FATAL: failed to allocate space to keep "
+                        "response buffer segment",
+                        getId());
+            return false;
+        }
+    }
+
+    /**
+     * Release the response buffer segments held by the responses we've
+     * transmitted to the client, recycling them through the worker
+     * thread's buffer pool
+     */
+    void releaseTempSegments();
+
+    /**
+     * Take ownership of a buffer referenced by the response being
+     * built up, and keep it alive until the response has been
+     * transmitted to the client.
+     *
+     * @return true if success, false otherwise
+     */
+    bool pinBuffer(std::unique_ptr<char[]> buf) {
+        try {
+            pinnedBuffers.emplace_back(std::move(buf));
+            return true;
+        } catch (const std::bad_alloc&) {
+            LOG_WARNING(this,
+                        "%u: FATAL: failed to allocate space to pin buffer",
+                        getId());
+            return false;
+        }
+    }
+
+    /**
+     * Keep a reference to a shared (refcounted) buffer which is
+     * referenced by the response being built up, so that it stays
+     * alive until the response has been transmitted to the client.
+     *
+     * @return true if success, false otherwise
+     */
+    bool pinSharedBuffer(std::shared_ptr<const std::string> buf) {
+        try {
+            pinnedSharedBuffers.emplace_back(std::move(buf));
+            return true;
+        } catch (const std::bad_alloc&) {
+            LOG_WARNING(this,
+                        "%u: FATAL: failed to allocate space to pin buffer",
+                        getId());
+            return false;
+        }
+    }
+
+    /**
+     * Release all of the buffers pinned by the response(s) we've
+     * transmitted to the client
+     */
+    void releasePinnedBuffers() {
+        pinnedBuffers.clear();
+        pinnedSharedBuffers.clear();
+    }
+
+    /**
+     * Did (part of) the response for the current command get built up
+     * directly in the message list (rather than in the dynamic buffer)?
+     */
+    bool isDirectResponseBuilt() const {
+        return directResponse;
+    }
+
+    void setDirectResponseBuilt() {
+        directResponse = true;
+    }
+
+    void clearDirectResponseBuilt() {
+        directResponse = false;
+    }
+
+    /**
+     * Get the number of packets in the read buffer whose fixed header
+     * has already passed the batch pre-validation
+     */
+    size_t getPrevalidatedPackets() const {
+        return prevalidatedPackets;
+    }
+
+    void setPrevalidatedPackets(size_t num) {
+        prevalidatedPackets = num;
+    }
+
     bool pushTempAlloc(char* ptr) {
         try {
             temp_alloc.push_back(ptr);
@@ -528,6 +788,25 @@ public:
 
     void setStart(ProcessClock::time_point start) {
         McbpConnection::start = start;
+        // The intra-command timestamps belong to the previous command
+        executeStart = ProcessClock::time_point();
+        notifyTime = ProcessClock::time_point();
+    }
+
+    ProcessClock::time_point getExecuteStart() const {
+        return executeStart;
+    }
+
+    void setExecuteStart(ProcessClock::time_point executeStart) {
+        McbpConnection::executeStart = executeStart;
+    }
+
+    ProcessClock::time_point getNotifyTime() const {
+        return notifyTime;
+    }
+
+    void setNotifyTime(ProcessClock::time_point notifyTime) {
+        McbpConnection::notifyTime = notifyTime;
     }
 
     uint64_t getCAS() const {
@@ -555,6 +834,97 @@ public:
         McbpConnection::ewouldblock = ewouldblock;
     }
 
+    /**
+     * Can a blocked command of this opcode be parked so that execution
+     * continues with the next pipelined command? Restricted to the
+     * retrieval family: they're the commands which block on cache misses
+     * (the head-of-line blocking we're out to kill), their packets are
+     * small enough that the copy into the slot is free, and their
+     * executors keep no state in the engine keyed on the connection.
+     */
+    static bool isBlockedCommandEligible(uint8_t opcode);
+
+    /**
+     * May this opcode execute (and respond) ahead of the commands
+     * currently parked on the connection? Anything not listed acts as
+     * an execution barrier and waits for the parked commands to drain;
+     * notably NOOP, giving clients a pipeline sync primitive.
+     */
+    static bool isReorderSafe(uint8_t opcode);
+
+    /**
+     * Select the cookie representing the next command to execute: a
+     * blocked-command slot if unordered execution is negotiated and the
+     * opcode is eligible (and the window isn't exhausted), otherwise
+     * the connection's embedded cookie.
+     */
+    void selectCookieForCommand(uint8_t magic, uint8_t opcode);
+
+    /**
+     * If the current command executes from a blocked-command slot, copy
+     * its packet out of the input pipe into the slot and re-point the
+     * cookie at the copy, so that every pointer captured during
+     * execution stays valid if the command gets parked.
+     */
+    void maybeCopyBlockedCommandPacket();
+
+    /**
+     * Park the current command (which returned EWOULDBLOCK) in its slot
+     * and make the connection ready to execute the next command.
+     *
+     * @return true if the command was parked; false if it executes from
+     *         the embedded cookie and the connection must block as usual
+     */
+    bool parkBlockedCommand();
+
+    /**
+     * Mark the parked command owning the given cookie as completed by
+     * the engine. Called from notify_io_complete with the thread lock
+     * held.
+     *
+     * @return true if the cookie belonged to a blocked-command slot (the
+     *         status has been recorded); false for the embedded cookie
+     */
+    bool completeBlockedCommand(const Cookie& ck, ENGINE_ERROR_CODE status);
+
+    /**
+     * Restore a completed blocked command as the current
+     * command so the execute state can re-run it. Finishes off the
+     * previous command like reset_cmd_handler does.
+     */
+    void setupBlockedCommandReexecution();
+
+    /**
+     * If the current cookie is a blocked-command slot which is neither
+     * parked nor ready (i.e. the command completed), return the slot to
+     * the pool and revert to the embedded cookie.
+     */
+    void releaseBlockedCommandSlot();
+
+    /**
+     * The connection is closing: revert to the embedded cookie and free
+     * the slots the engine is done with. Slots still parked are kept
+     * (and gate the close) until the engine notifies them.
+     */
+    void abandonBlockedCommands();
+
+    /// @return true if any command is parked or awaiting re-execution
+    bool hasBlockedCommands() const;
+
+    /// @return true if any parked command has completed and may re-run
+    bool hasReadyBlockedCommand() const;
+
+    /// @return true if the engine still works on any parked command
+    bool hasPendingBlockedCommands() const;
+
+    bool isReExecutingBlockedCommand() const {
+        return reExecuting != nullptr;
+    }
+
+    void clearReExecutingBlockedCommand() {
+        reExecuting = nullptr;
+    }
+
     /**
      *  Get the command context stored for this command
      */
@@ -707,11 +1077,11 @@ public:
     std::unique_ptr<cb::Pipe> write;
 
     const void* getCookie() const {
-        return &cookie;
+        return currentCookie;
     }
 
     Cookie& getCookieObject() {
-        return cookie;
+        return *currentCookie;
     }
 
     /**
@@ -800,6 +1170,15 @@ protected:
      */
     int numEvents = 0;
 
+    /**
+     * The maximum request / response bytes we may process in a worker
+     * thread timeslice (0 == no byte limit; see chargeEventBytes)
+     */
+    size_t max_bytes_per_event = settings.getBytesPerEventNotification();
+
+    /** bytes charged against the current timeslice's byte budget */
+    size_t eventBytes = 0;
+
     /** current command being processed */
     uint8_t cmd = PROTOCOL_BINARY_CMD_INVALID;
 
@@ -815,6 +1194,8 @@ protected:
     short currentEvent = 0;
     /** When we inserted the object in libevent */
     rel_time_t ev_insert_time;
+    /** The last time the event loop ran for this connection */
+    rel_time_t lastUsedTime = 0;
     /** Do we have an event timeout or not */
     bool ev_timeout_enabled = false;
     /** If ev_timeout_enabled is true, the current timeout in libevent */
@@ -849,6 +1230,45 @@ protected:
      */
     std::vector<char*> temp_alloc;
 
+    /**
+     * Standard sized response buffer segments (see DynamicBuffer) that
+     * should be returned to the worker thread's buffer pool when the
+     * connection is done sending all of the data. Use pushTempSegment
+     * to push a pointer to this list.
+     */
+    std::vector<char*> temp_segments;
+
+    /**
+     * Buffers owned by the connection which are referenced by iovec
+     * entries in the response being sent (see pinBuffer). Released when
+     * the transmission completes.
+     */
+    std::vector<std::unique_ptr<char[]>> pinnedBuffers;
+
+    /**
+     * Shared buffers referenced by iovec entries in the response being
+     * sent (see pinSharedBuffer). The reference is dropped when the
+     * transmission completes; the buffer itself is owned jointly with
+     * whoever else is sending it.
+     */
+    std::vector<std::shared_ptr<const std::string>> pinnedSharedBuffers;
+
+    /**
+     * Set to true when (a part of) the response for the current command
+     * has been built up directly in the message list instead of in the
+     * dynamic buffer. Reset when we start executing the next command.
+     */
+    bool directResponse = false;
+
+    /**
+     * The number of packets in the read buffer whose fixed header has
+     * already passed the batch pre-validation (see
+     * mcbp_prevalidate_headers). One entry is consumed every time we
+     * start parsing a command; when it drops to zero the (remaining)
+     * spooled input is scanned again.
+     */
+    size_t prevalidatedPackets = 0;
+
     /** True if the reply should not be sent (unless there is an error) */
     bool noreply = false;
 
@@ -871,6 +1291,19 @@ protected:
      */
     ProcessClock::time_point start;
 
+    /**
+     * When execution of the current command began (the first entry to
+     * conn_execute); used by the operation trace (optrace.h)
+     */
+    ProcessClock::time_point executeStart;
+
+    /**
+     * When the engine last notified the current command as complete
+     * after blocking; remains at the epoch if the command never
+     * blocked
+     */
+    ProcessClock::time_point notifyTime;
+
     /** the cas to return */
     uint64_t cas = 0;
 
@@ -894,11 +1327,32 @@ protected:
      */
     std::unique_ptr<CommandContext> commandContext;
 
+    /**
+     * Command contexts whose responses have been batched (see
+     * maybeBatchResponse()). The response iovecs may reference memory
+     * owned by the contexts, so they must stay alive until the batched
+     * write completes.
+     */
+    std::vector<std::unique_ptr<CommandContext>> batchedCommandContexts;
+
+    /** Number of responses currently batched up in the message list */
+    size_t batchedResponses = 0;
+
+    /** Number of bytes queued up in the batched responses */
+    size_t batchedBytes = 0;
+
     /**
      * The SSL context used by this connection (if enabled)
      */
     SslContext ssl;
 
+    /**
+     * Set while the TLS handshake (SSL_accept) for this connection is
+     * being computed in the executor pool. While it is in flight the
+     * worker thread must not touch the SSL structures.
+     */
+    std::shared_ptr<Task> sslHandshakeTask;
+
     /**
      * Ensures that there is room for another struct iovec in a connection's
      * iov list.
@@ -938,6 +1392,36 @@ protected:
 
     Cookie cookie;
 
+    /**
+     * The cookie representing the command currently being executed -
+     * either the embedded cookie above or a blocked-command slot (for
+     * connections which negotiated unordered execution).
+     */
+    Cookie* currentCookie = &cookie;
+
+    /**
+     * Maximum number of commands which may be parked waiting for the
+     * engine at the same time - the unordered execution window. A
+     * command arriving while every slot is busy simply executes with
+     * ordered semantics (the connection blocks if it would).
+     */
+    static const size_t MAX_BLOCKED_COMMANDS = 8;
+
+    /**
+     * The blocked-command slots; allocated on demand (connections which
+     * never negotiate unordered execution, or never miss, pay nothing).
+     */
+    std::vector<std::unique_ptr<BlockedCommand>> blockedCommands;
+
+    /**
+     * Set while re-executing a completed blocked command (whose packet
+     * lives in its slot rather than in the input pipe).
+     */
+    BlockedCommand* reExecuting = nullptr;
+
+    /// Find the slot owning the given cookie (nullptr for the embedded one)
+    BlockedCommand* findBlockedCommandSlot(const Cookie* ck);
+
     Datatype datatype;
 
     /**
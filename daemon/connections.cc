@@ -16,6 +16,8 @@
  */
 
 #include "connections.h"
+#include "buffer_pool.h"
+#include "mc_time.h"
 #include "runtime.h"
 #include "utilities/protocol2text.h"
 #include "settings.h"
@@ -24,15 +26,50 @@
 #include <cJSON.h>
 #include <list>
 #include <algorithm>
+#include <vector>
 #include <platform/cb_malloc.h>
 
 /*
- * Free list management for connections.
+ * Connection registry.
+ *
+ * The registry is sharded per worker thread: each worker owns the list
+ * holding the connections assigned to it, so the accept and close paths
+ * (and the idle-client scans a worker runs over its own clients) never
+ * meet a process wide lock. Listening connections aren't assigned to a
+ * worker and live in a shard of their own. Cross-thread consumers
+ * (stats, config push, shutdown) visit the shards one at a time and
+ * therefore only ever stall a single worker's accept/close path, not
+ * all of them.
  */
-struct connections {
+struct ConnectionShard {
     std::mutex mutex;
     std::list<Connection*> conns;
-} connections;
+};
+
+class ConnectionRegistry {
+public:
+    ConnectionRegistry() : shards(settings.getNumWorkerThreads() + 1) {
+    }
+
+    /**
+     * Get the shard holding the connections owned by the provided
+     * thread. The final shard holds the listening connections, which
+     * aren't owned by any worker.
+     */
+    ConnectionShard& getShard(const LIBEVENT_THREAD* thread) {
+        if (thread == nullptr) {
+            return shards.back();
+        }
+        return shards.at(thread->index);
+    }
+
+    std::vector<ConnectionShard> shards;
+};
+
+static ConnectionRegistry& getRegistry() {
+    static ConnectionRegistry registry;
+    return registry;
+}
 
 
 /** Types ********************************************************************/
@@ -47,15 +84,15 @@ enum class BufferLoan {
 /** Function prototypes ******************************************************/
 
 static BufferLoan loan_single_buffer(McbpConnection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     BufferPool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf);
-static void maybe_return_single_buffer(McbpConnection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+static void maybe_return_single_buffer(BufferPool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf);
 static void conn_destructor(Connection *c);
 static Connection *allocate_connection(SOCKET sfd,
                                        event_base *base,
-                                       const ListeningPort &interface);
+                                       const ListeningPort &interface,
+                                       LIBEVENT_THREAD *thread);
 
 static ListenConnection* allocate_listen_connection(SOCKET sfd,
                                                     event_base* base,
@@ -74,8 +111,9 @@ int signal_idle_clients(LIBEVENT_THREAD *me, int bucket_idx, bool logging)
     logging = true;
 
     int connected = 0;
-    std::lock_guard<std::mutex> lock(connections.mutex);
-    for (auto* c : connections.conns) {
+    auto& shard = getRegistry().getShard(me);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto* c : shard.conns) {
         if (c->getThread() == me) {
             ++connected;
             if (bucket_idx == -1 || c->getBucketIndex() == bucket_idx) {
@@ -89,10 +127,11 @@ int signal_idle_clients(LIBEVENT_THREAD *me, int bucket_idx, bool logging)
 
 void iterate_thread_connections(LIBEVENT_THREAD* thread,
                                 std::function<void(Connection&)> callback) {
-    // Deny modifications to the connection map while we're iterating
+    // Deny modifications to the thread's shard while we're iterating
     // over it
-    std::lock_guard<std::mutex> lock(connections.mutex);
-    for (auto* c : connections.conns) {
+    auto& shard = getRegistry().getShard(thread);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto* c : shard.conns) {
         if (c->getThread() == thread) {
             callback(*c);
         }
@@ -101,20 +140,22 @@ void iterate_thread_connections(LIBEVENT_THREAD* thread,
 
 void destroy_connections(void)
 {
-    std::lock_guard<std::mutex> lock(connections.mutex);
-    /* traverse the list of connections. */
-    for (auto* c : connections.conns) {
-        conn_destructor(c);
+    for (auto& shard : getRegistry().shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        /* traverse the list of connections. */
+        for (auto* c : shard.conns) {
+            conn_destructor(c);
+        }
+        shard.conns.clear();
     }
-    connections.conns.clear();
 }
 
 void close_all_connections(void)
 {
     /* traverse the list of connections. */
-    {
-        std::lock_guard<std::mutex> lock(connections.mutex);
-        for (auto* c : connections.conns) {
+    for (auto& shard : getRegistry().shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto* c : shard.conns) {
             if (!c->isSocketClosed()) {
                 safe_close(c->getSocketDescriptor());
                 c->setSocketDescriptor(INVALID_SOCKET);
@@ -138,14 +179,17 @@ void close_all_connections(void)
     bool done;
     do {
         done = true;
-        {
-            std::lock_guard<std::mutex> lock(connections.mutex);
-            for (auto* c : connections.conns) {
+        for (auto& shard : getRegistry().shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto* c : shard.conns) {
                 if (c->getRefcount() > 1) {
                     done = false;
                     break;
                 }
             }
+            if (!done) {
+                break;
+            }
         }
 
         if (!done) {
@@ -166,6 +210,7 @@ void run_event_loop(Connection* c, short which) {
     auto* thread = c->getThread();
     if (thread != nullptr) {
         scheduler_info[thread->index].add(ns);
+        thread->event_runs.fetch_add(1, std::memory_order_relaxed);
     }
 
     if (c->shouldDelete()) {
@@ -206,7 +251,7 @@ Connection* conn_new(const SOCKET sfd, in_port_t parent_port,
             return nullptr;
         }
 
-        c = allocate_connection(sfd, base, *interface);
+        c = allocate_connection(sfd, base, *interface, thread);
     }
 
     if (c == nullptr) {
@@ -226,6 +271,7 @@ Connection* conn_new(const SOCKET sfd, in_port_t parent_port,
     associate_initial_bucket(c);
 
     c->setThread(thread);
+    thread->conn_count.fetch_add(1, std::memory_order_relaxed);
     MEMCACHED_CONN_ALLOCATE(c->getId());
 
     if (settings.getVerbose() > 1) {
@@ -248,8 +294,11 @@ static void conn_cleanup(Connection *c) {
     auto* mcbpc = dynamic_cast<McbpConnection*>(c);
     if (mcbpc != nullptr) {
         mcbpc->releaseTempAlloc();
+        mcbpc->releaseTempSegments();
+        mcbpc->releasePinnedBuffers();
         mcbpc->read->clear();
         mcbpc->write->clear();
+        mcbpc->setPrevalidatedPackets(0);
         /* Return any buffers back to the thread; before we disassociate the
          * connection from the thread. Note we clear DCP status first, so
          * conn_return_buffers() will actually free the buffers.
@@ -294,7 +343,20 @@ void conn_close(McbpConnection *c) {
                     "Current connection was in the pending-io list.. Nuking it");
     }
     thread->pending_io = list_remove(thread->pending_io, c);
+    c->setEnlistedInPendingIo(false);
 
+    /* Remove the connection from the owner's shard of the registry before
+     * conn_cleanup() drops the thread association. */
+    {
+        auto& shard = getRegistry().getShard(thread);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = std::find(shard.conns.begin(), shard.conns.end(), c);
+        // I should assert
+        cb_assert(iter != shard.conns.end());
+        shard.conns.erase(iter);
+    }
+
+    thread->conn_count.fetch_sub(1, std::memory_order_relaxed);
     conn_cleanup(c);
 
     if (c->getThread() != nullptr) {
@@ -303,6 +365,109 @@ void conn_close(McbpConnection *c) {
     c->setState(McbpStateMachine::State::destroyed);
 }
 
+Connection* migrate_idle_connection(LIBEVENT_THREAD* from,
+                                    LIBEVENT_THREAD* to) {
+    McbpConnection* victim = nullptr;
+
+    // Pick (and unhook) a quiescent connection. The thread mutex keeps
+    // notify_io_complete style enlistment out while we inspect the
+    // candidates; it must be acquired before the shard mutex (the same
+    // order as signal_idle_clients).
+    LOCK_THREAD(from);
+    auto& src = getRegistry().getShard(from);
+    {
+        std::lock_guard<std::mutex> lock(src.mutex);
+        for (auto* c : src.conns) {
+            if (c->getThread() != from || c->isEnlistedInPendingIo()) {
+                continue;
+            }
+            auto* mcbp = dynamic_cast<McbpConnection*>(c);
+            if (mcbp != nullptr && mcbp->isMigratable()) {
+                victim = mcbp;
+                break;
+            }
+        }
+        if (victim != nullptr) {
+            src.conns.remove(victim);
+        }
+    }
+
+    if (victim == nullptr) {
+        UNLOCK_THREAD(from);
+        return nullptr;
+    }
+
+    if (!victim->prepareForMigration(to)) {
+        // Couldn't detach; the connection stays where it was.
+        std::lock_guard<std::mutex> lock(src.mutex);
+        src.conns.push_back(victim);
+        UNLOCK_THREAD(from);
+        return nullptr;
+    }
+
+    from->conn_count.fetch_sub(1, std::memory_order_relaxed);
+    UNLOCK_THREAD(from);
+
+    to->conn_count.fetch_add(1, std::memory_order_relaxed);
+    {
+        auto& dst = getRegistry().getShard(to);
+        std::lock_guard<std::mutex> lock(dst.mutex);
+        dst.conns.push_back(victim);
+    }
+
+    // Hand the connection to the new owner; it'll (re)register the
+    // event in its base when it processes its pending io list.
+    int notify;
+    LOCK_THREAD(to);
+    notify = add_conn_to_pending_io_list(victim);
+    UNLOCK_THREAD(to);
+    if (notify) {
+        notify_thread(to);
+    }
+
+    LOG_DEBUG(victim,
+              "%u: Migrated connection from worker %d to worker %d",
+              victim->getId(),
+              from->index,
+              to->index);
+
+    return victim;
+}
+
+void park_idle_connections(LIBEVENT_THREAD* me) {
+    const size_t quiet = settings.getConnectionParkTime();
+    if (quiet == 0) {
+        // Parking disabled
+        return;
+    }
+
+    const rel_time_t now = mc_time_get_current_time();
+
+    // The thread mutex keeps notify_io_complete style enlistment out
+    // while we inspect the candidates; it must be acquired before the
+    // shard mutex (the same order as signal_idle_clients).
+    LOCK_THREAD(me);
+    auto& shard = getRegistry().getShard(me);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto* c : shard.conns) {
+            if (c->getThread() != me || c->isEnlistedInPendingIo()) {
+                continue;
+            }
+            auto* mcbp = dynamic_cast<McbpConnection*>(c);
+            if (mcbp == nullptr ||
+                now - mcbp->getLastUsedTime() < quiet ||
+                !mcbp->isParkable()) {
+                continue;
+            }
+            if (mcbp->park(*me->buffer_pool)) {
+                get_thread_stats(mcbp)->conns_parked++;
+            }
+        }
+    }
+    UNLOCK_THREAD(me);
+}
+
 ListeningPort *get_listening_port_instance(const in_port_t port) {
     for (auto &instance : stats.listening_ports) {
         if (instance.port == port) {
@@ -314,14 +479,23 @@ ListeningPort *get_listening_port_instance(const in_port_t port) {
 }
 
 void connection_stats(ADD_STAT add_stats, const void* cookie, const int64_t fd) {
-    std::lock_guard<std::mutex> lock(connections.mutex);
-    for (auto *c : connections.conns) {
-        if (c->getSocketDescriptor() == fd || fd == -1) {
-            auto stats = c->toJSON();
-            // no key, JSON value contains all properties of the connection.
-            auto stats_str = to_string(stats, false);
-            add_stats(nullptr, 0, stats_str.data(), uint32_t(stats_str.size()),
-                      cookie);
+    // Visit the workers' shards one at a time so that formatting all of
+    // the connections only ever blocks the accept/close path of a single
+    // worker, not the whole process.
+    for (auto& shard : getRegistry().shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto* c : shard.conns) {
+            if (c->getSocketDescriptor() == fd || fd == -1) {
+                auto stats = c->toJSON();
+                // no key, JSON value contains all properties of the
+                // connection.
+                auto stats_str = to_string(stats, false);
+                add_stats(nullptr,
+                          0,
+                          stats_str.data(),
+                          uint32_t(stats_str.size()),
+                          cookie);
+            }
         }
     }
 }
@@ -334,15 +508,18 @@ void connection_stats(ADD_STAT add_stats, const void* cookie, const int64_t fd)
  * for a bug.
  */
 void dump_connection_stat_signal_handler(evutil_socket_t, short, void *) {
-    std::lock_guard<std::mutex> lock(connections.mutex);
-    for (auto *c : connections.conns) {
-        try {
-            auto json = c->toJSON();
-            auto info = to_string(json, false);
-            LOG_NOTICE(c, "Connection: %s", info.c_str());
-        } catch (const std::bad_alloc&) {
-            LOG_NOTICE(c, "Failed to allocate memory to dump info for %u",
-                       c->getId());
+    for (auto& shard : getRegistry().shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto* c : shard.conns) {
+            try {
+                auto json = c->toJSON();
+                auto info = to_string(json, false);
+                LOG_NOTICE(c, "Connection: %s", info.c_str());
+            } catch (const std::bad_alloc&) {
+                LOG_NOTICE(c,
+                           "Failed to allocate memory to dump info for %u",
+                           c->getId());
+            }
         }
     }
 }
@@ -356,7 +533,13 @@ void conn_loan_buffers(Connection *connection) {
     }
 
     auto* ts = get_thread_stats(c);
-    switch (loan_single_buffer(*c, c->getThread()->read, c->read)) {
+    auto& pool = *c->getThread()->buffer_pool;
+
+    // Let the response buffer recycle its standard sized segments
+    // through the pool as well.
+    c->getDynamicBuffer().setPool(&pool);
+
+    switch (loan_single_buffer(*c, pool, c->read)) {
     case BufferLoan::Existing:
         ts->rbufs_existing++;
         break;
@@ -368,7 +551,7 @@ void conn_loan_buffers(Connection *connection) {
         break;
     }
 
-    switch (loan_single_buffer(*c, c->getThread()->write, c->write)) {
+    switch (loan_single_buffer(*c, pool, c->write)) {
     case BufferLoan::Existing:
         ts->wbufs_existing++;
         break;
@@ -399,8 +582,8 @@ void conn_return_buffers(Connection *connection) {
         return;
     }
 
-    maybe_return_single_buffer(*c, thread->read, c->read);
-    maybe_return_single_buffer(*c, thread->write, c->write);
+    maybe_return_single_buffer(*thread->buffer_pool, c->read);
+    maybe_return_single_buffer(*thread->buffer_pool, c->write);
 }
 
 /** Internal functions *******************************************************/
@@ -413,19 +596,21 @@ static void conn_destructor(Connection *c) {
     stats.conn_structs--;
 }
 
-/** Allocate a connection, creating memory and adding it to the conections
- *  list. Returns a pointer to the newly-allocated connection if successful,
- *  else NULL.
+/** Allocate a connection, creating memory and adding it to the shard of
+ *  the worker thread which will own it. Returns a pointer to the
+ *  newly-allocated connection if successful, else NULL.
  */
 static Connection *allocate_connection(SOCKET sfd,
                                        event_base *base,
-                                       const ListeningPort &interface) {
+                                       const ListeningPort &interface,
+                                       LIBEVENT_THREAD *thread) {
     Connection *ret = nullptr;
 
     try {
         ret = new McbpConnection(sfd, base, interface);
-        std::lock_guard<std::mutex> lock(connections.mutex);
-        connections.conns.push_back(ret);
+        auto& shard = getRegistry().getShard(thread);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.conns.push_back(ret);
         stats.conn_structs++;
         return ret;
     } catch (const std::bad_alloc&) {
@@ -449,8 +634,10 @@ static ListenConnection* allocate_listen_connection(SOCKET sfd,
 
     try {
         ret = new ListenConnection(sfd, base, port, family, interf);
-        std::lock_guard<std::mutex> lock(connections.mutex);
-        connections.conns.push_back(ret);
+        // Listening connections aren't owned by a worker thread
+        auto& shard = getRegistry().getShard(nullptr);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.conns.push_back(ret);
         stats.conn_structs++;
         return ret;
     } catch (const std::bad_alloc&) {
@@ -465,38 +652,28 @@ static ListenConnection* allocate_listen_connection(SOCKET sfd,
     return NULL;
 }
 
-/** Release a connection; removing it from the connection list management
- *  and freeing the Connection object.
+/** Release a connection and free the Connection object. The connection
+ *  was already removed from its owner's registry shard by conn_close().
  */
 static void release_connection(Connection *c) {
-    {
-        std::lock_guard<std::mutex> lock(connections.mutex);
-        auto iter = std::find(connections.conns.begin(), connections.conns.end(), c);
-        // I should assert
-        cb_assert(iter != connections.conns.end());
-        connections.conns.erase(iter);
-    }
-
-    // Finally free it
     conn_destructor(c);
 }
 
 /**
  * If the connection doesn't already have a populated conn_buff, ensure that
- * it does by either loaning out the threads, or allocating a new one if
- * necessary.
+ * it does by either recycling a buffer from the thread's pool, or
+ * allocating a new one if necessary.
  */
 static BufferLoan loan_single_buffer(McbpConnection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     BufferPool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf) {
     /* Already have a (partial) buffer - nothing to do. */
     if (conn_buf) {
         return BufferLoan::Existing;
     }
 
-    // If the thread has a buffer, let's loan that to the connection
-    if (thread_buf) {
-        thread_buf.swap(conn_buf);
+    // If the pool has an idle buffer, let's loan that to the connection
+    if ((conn_buf = pool.tryAcquire())) {
         return BufferLoan::Loaned;
     }
 
@@ -519,17 +696,11 @@ static BufferLoan loan_single_buffer(McbpConnection& c,
     return BufferLoan::Allocated;
 }
 
-static void maybe_return_single_buffer(McbpConnection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+static void maybe_return_single_buffer(BufferPool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf) {
     if (conn_buf && conn_buf->empty()) {
-        // Buffer clean, dispose of it
-        if (thread_buf) {
-            // Already got a thread buffer.. release this one
-            conn_buf.reset();
-        } else {
-            conn_buf.swap(thread_buf);
-        }
+        // Buffer clean; hand it back to the thread's pool
+        pool.release(std::move(conn_buf));
     }
 }
 
@@ -545,11 +716,11 @@ ENGINE_ERROR_CODE apply_connection_trace_mask(const std::string& connid,
     bool enable = mask != "0";
     bool found = false;
 
-    {
-        // Lock the connection array to avoid race conditions with
-        // connections being added / removed / destroyed
-        std::unique_lock<std::mutex> lock(connections.mutex);
-        for (auto* c : connections.conns) {
+    // Lock each shard to avoid race conditions with connections being
+    // added / removed / destroyed
+    for (auto& shard : getRegistry().shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto* c : shard.conns) {
             if (c->getId() == id) {
                 c->setTraceEnabled(enable);
                 found = true;
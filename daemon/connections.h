@@ -123,6 +123,37 @@ void conn_cleanup_engine_allocations(McbpConnection * c);
  */
 int signal_idle_clients(LIBEVENT_THREAD *me, int bucket_idx, bool logging);
 
+/**
+ * Try to move one completely idle client connection from one worker
+ * thread to another (to balance the load between the workers). The
+ * connection is unhooked from the source thread's event base and
+ * enlisted in the target thread's pending io list; the target picks it
+ * up from there and registers it in its own base.
+ *
+ * May only be called by the thread owning `from`, without holding the
+ * thread mutex.
+ *
+ * @param from the overloaded thread to take a connection from
+ * @param to the thread to hand the connection to
+ * @return the migrated connection, or nullptr if no connection was
+ *         quiescent enough to move
+ */
+Connection* migrate_idle_connection(LIBEVENT_THREAD* from,
+                                    LIBEVENT_THREAD* to);
+
+/**
+ * Park the connections owned by the given worker which have been quiet
+ * for at least the configured quiet period (connection_park_time):
+ * their (empty) network buffers are handed back to the worker's buffer
+ * pool, leaving just the armed libevent state behind until the next
+ * byte arrives. Connections which are mid-command, or have anything
+ * buffered in either direction, are left alone.
+ *
+ * May only be called by the thread owning `me`, without holding the
+ * thread mutex.
+ */
+void park_idle_connections(LIBEVENT_THREAD* me);
+
 #ifndef WIN32
 /**
  * Signal handler for SIGUSR1 to dump the connection states
@@ -43,6 +43,20 @@ bool Datatype::isSupported(cb::mcbp::Feature feature) {
     return false;
 }
 
+bool Datatype::isCompressed(protocol_binary_datatype_t datatype) {
+    return mcbp::datatype::is_snappy(datatype);
+}
+
+cb::compression::Algorithm Datatype::toAlgorithm(
+        protocol_binary_datatype_t datatype) {
+    if (mcbp::datatype::is_snappy(datatype)) {
+        return cb::compression::Algorithm::Snappy;
+    }
+    throw std::invalid_argument(
+            "Datatype::toAlgorithm: datatype carries no compression bit: " +
+            std::to_string(int(datatype)));
+}
+
 void Datatype::enable(cb::mcbp::Feature feature) {
     switch (feature) {
     case cb::mcbp::Feature::XATTR:
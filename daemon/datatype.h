@@ -18,6 +18,7 @@
 #pragma once
 
 #include <mcbp/protocol/feature.h>
+#include <platform/compress.h>
 #include <bitset>
 
 #include <memcached/protocol_binary.h>
@@ -29,6 +30,28 @@ public:
      */
     static bool isSupported(cb::mcbp::Feature datatype);
 
+    /**
+     * Does the datatype flag the value as compressed?
+     *
+     * Equivalent to checking the snappy bit today, but callers which
+     * really ask "is the value compressed" (rather than "is it snappy")
+     * should use this so that teaching the protocol a second, negotiated
+     * compression algorithm is a local change.
+     */
+    static bool isCompressed(protocol_binary_datatype_t datatype);
+
+    /**
+     * Map the compression flagged by the datatype onto the algorithm to
+     * inflate it with. Snappy is the only algorithm the datatype byte
+     * can currently carry; a new one gets its own feature code, datatype
+     * bit and an entry here (plus support in cb::compression).
+     *
+     * @throws std::invalid_argument if the datatype carries no
+     *         compression bit
+     */
+    static cb::compression::Algorithm toAlgorithm(
+            protocol_binary_datatype_t datatype);
+
     /**
      * Translate the mcbp::Feature:: input into the corresponding mcbp datatype
      * bit.
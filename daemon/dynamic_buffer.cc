@@ -16,42 +16,69 @@
  */
 #include "config.h"
 #include "dynamic_buffer.h"
+#include "buffer_pool.h"
 
 #include <platform/cb_malloc.h>
 
 bool DynamicBuffer::grow(size_t needed) {
-    size_t nsize = size;
-    size_t available = nsize - offset;
-    bool rv = true;
-
-    /* Special case: No buffer -- need to allocate fresh */
-    if (buffer == NULL) {
-        nsize = 1024;
-        available = size = offset = 0;
+    if (!segments.empty()) {
+        const auto& current = segments.back();
+        if (current.capacity - current.used >= needed) {
+            return true;
+        }
     }
 
-    while (needed > available) {
-        cb_assert(nsize > 0);
-        nsize = nsize << 1;
-        available = nsize - offset;
+    /* The current segment (if any) can't fit the insertion; open a new
+     * one. The data already written stays where it is. Segment sizes
+     * double so that the number of segments (and iovecs) stays small
+     * for big responses. */
+    size_t nsize;
+    char* ptr = nullptr;
+
+    if (segments.empty()) {
+        nsize = BufferPool::SEGMENT_SIZE;
+        if (needed <= nsize && pool != nullptr) {
+            ptr = pool->tryAcquireSegment();
+        }
+    } else {
+        nsize = segments.back().capacity << 1;
     }
 
-    if (nsize != size) {
-        char* ptr = reinterpret_cast<char*>(cb_realloc(buffer, nsize));
-        if (ptr) {
-            buffer = ptr;
-            size = nsize;
+    if (nsize < needed) {
+        nsize = needed;
+    }
+
+    if (ptr == nullptr) {
+        ptr = reinterpret_cast<char*>(cb_malloc(nsize));
+        if (ptr == nullptr) {
+            return false;
+        }
+    }
+
+    try {
+        segments.push_back({ptr, 0, nsize});
+    } catch (const std::bad_alloc&) {
+        if (pool != nullptr && nsize == BufferPool::SEGMENT_SIZE) {
+            pool->releaseSegment(ptr);
         } else {
-            rv = false;
+            cb_free(ptr);
         }
+        return false;
     }
 
-    return rv;
+    size += nsize;
+    return true;
 }
 
 void DynamicBuffer::clear() {
-    cb_free(buffer);
-    buffer = nullptr;
-    size = 0;
+    for (auto& segment : segments) {
+        if (pool != nullptr && segment.capacity == BufferPool::SEGMENT_SIZE) {
+            pool->releaseSegment(segment.data);
+        } else {
+            cb_free(segment.data);
+        }
+    }
+    segments.clear();
     offset = 0;
+    size = 0;
 }
@@ -19,24 +19,60 @@
 #include <cstdlib>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
+class BufferPool;
+
+/**
+ * A growable buffer used to build up responses (stats, error messages,
+ * responses routed through the engine's response handler).
+ *
+ * The buffer is made up of a chain of independently allocated segments
+ * which are transmitted as separate iovecs, rather than a single
+ * contiguous allocation which is realloc'ed (and copied) every time it
+ * fills up. Growing the buffer never moves data which has already been
+ * inserted, so pointers handed out for earlier insertions stay valid
+ * for the lifetime of the buffer.
+ *
+ * The first segment (the only one needed by the vast majority of the
+ * responses) is recycled through the worker thread's BufferPool when
+ * one is associated with the buffer. Later segments double in size so
+ * that the number of segments (and iovecs) needed by a multi-megabyte
+ * response stays logarithmic in its size.
+ */
 class DynamicBuffer {
 public:
+    /** A single contiguous chunk of the buffer */
+    struct Segment {
+        /** Start of the allocated chunk */
+        char* data;
+        /** Number of bytes inserted into the chunk */
+        size_t used;
+        /** Total allocated size of the chunk */
+        size_t capacity;
+    };
+
     DynamicBuffer()
-        : buffer(nullptr),
-          offset(0),
-          size(0) {
+        : offset(0),
+          size(0),
+          pool(nullptr) {
         // empty
     }
 
     DynamicBuffer(const DynamicBuffer&) = delete;
 
     ~DynamicBuffer() {
+        // The destructor may run after the worker threads (and their
+        // buffer pools) are gone; free the segments rather than trying
+        // to recycle them.
+        pool = nullptr;
         clear();
     }
 
     /**
-     * Grow the buffer to have at least <em>needed</em> bytes
+     * Grow the buffer so that the next insertion of <em>needed</em>
+     * contiguous bytes fits. If the current segment can't hold it a new
+     * segment is opened; the data already inserted is never moved.
      *
      * @param needed the number of bytes needed in the buffer
      * @return true if success, false otherwise
@@ -49,21 +85,35 @@ public:
     void clear();
 
     /**
-     * Get the root of the buffer
+     * Set the pool used to recycle standard sized segments. May be
+     * nullptr, in which case all segments are allocated (and freed)
+     * through the allocator.
+     */
+    void setPool(BufferPool* pool) {
+        DynamicBuffer::pool = pool;
+    }
+
+    /**
+     * Get the root of the buffer (the first segment). Used to tell if
+     * anything has been inserted into the buffer.
      */
     char *getRoot() const {
-        return buffer;
+        return segments.empty() ? nullptr : segments.front().data;
     }
 
     /**
-     * Get the "current" pointer (root + offset)
+     * Get the "current" pointer (where the next insertion goes)
      */
     char *getCurrent() const {
-        return buffer + offset;
+        if (segments.empty()) {
+            return nullptr;
+        }
+        const auto& current = segments.back();
+        return current.data + current.used;
     }
 
     /**
-     * Get the current offset in the buffer
+     * Get the total number of bytes inserted into the buffer
      */
     size_t getOffset() const {
         return offset;
@@ -74,38 +124,49 @@ public:
      * the buffer)
      */
     void moveOffset(size_t num) {
+        if (segments.empty()) {
+            throw std::out_of_range(
+                "DynamicBuffer::moveOffset: no segment allocated");
+        }
+        auto& current = segments.back();
+        current.used += num;
         offset += num;
-        // Validate that we've not run over the buffer size
-        if (offset > size) {
-            throw std::out_of_range("DynamicBuffer::moveOffset: offset (" +
-                                    std::to_string(offset) + ") > size (" +
-                                    std::to_string(size) + ")");
+        // Validate that we've not run over the segment size
+        if (current.used > current.capacity) {
+            throw std::out_of_range("DynamicBuffer::moveOffset: used (" +
+                                    std::to_string(current.used) +
+                                    ") > capacity (" +
+                                    std::to_string(current.capacity) + ")");
         }
     }
 
     /**
-     * Transfer the ownership of the underlying buffer. The caller is
-     * responsible for freeing the underlying data
+     * Transfer the ownership of the underlying segments. The caller is
+     * responsible for freeing (or recycling) the chunks
      */
-    void takeOwnership() {
-        buffer = nullptr;
-        size = 0;
+    std::vector<Segment> releaseSegments() {
+        auto ret = std::move(segments);
+        segments.clear();
         offset = 0;
+        size = 0;
+        return ret;
     }
 
     /**
-     * Get the total size of the allocated buffer. Note that the bytes in
-     * the range [offset, size> is not initialized or used.
+     * Get the total size of the allocated segments. Note that this may
+     * be bigger than the number of bytes inserted (getOffset()).
      */
     size_t getSize() const {
         return size;
     }
 
 private:
-    /** Start of the allocated buffer */
-    char* buffer;
-    /** How much of the buffer has been used so far. */
+    /** The segments making up the buffer */
+    std::vector<Segment> segments;
+    /** Total number of bytes inserted so far. */
     size_t offset;
     /** Total allocated size */
     size_t size;
+    /** The pool used to recycle standard sized segments (may be null) */
+    BufferPool* pool;
 };
@@ -18,12 +18,13 @@
 #pragma once
 
 #include <algorithm>
-#include <functional>
 #include <vector>
 
 /*
- * A Function class stores a function pointer for later storage in
- * a FunctionChain.
+ * A Function class stores a plain function pointer for later storage in
+ * a FunctionChain. A raw pointer (rather than std::function) keeps the
+ * per-entry cost down to a single indirect call, which matters given
+ * that the chains sit on the front-end dispatch path for every packet.
  *
  * ReturnType must be the function's return type.
  * ReturnType Success must be a value to be returned when the function is
@@ -34,10 +35,12 @@
 template<typename ReturnType, ReturnType Success, typename... arguments>
 class Function {
 public:
+    typedef ReturnType (*FunctionPointer)(arguments...);
+
     /*
      * Construct a Function that stores 'f'
      */
-    Function (std::function<ReturnType(arguments...)> f)
+    Function (FunctionPointer f)
       : func(f) {}
 
     /*
@@ -51,12 +54,11 @@ public:
      * Expose the stored function's address (required for == operator)
      */
     uintptr_t getAddress() const {
-        typedef ReturnType(fnType)(arguments...);
-        return reinterpret_cast<uintptr_t>(*func.template target<fnType*>());
+        return reinterpret_cast<uintptr_t>(func);
     }
 
 private:
-    std::function<ReturnType(arguments...)> func;
+    FunctionPointer func;
 };
 
 /*
@@ -0,0 +1,220 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "hotness.h"
+
+#include "memcached.h"
+
+#include "utilities/protocol2text.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+std::atomic<uint32_t> HotnessSampler::sample_every{
+        HotnessSampler::default_sample_every};
+
+void HotnessSampler::sample(const char* key,
+                            size_t nkey,
+                            uint16_t vbucket,
+                            uint8_t opcode) {
+    if (++opcount < sample_every.load(std::memory_order_relaxed)) {
+        return;
+    }
+    opcount = 0;
+
+    HotnessSample s;
+    s.key_len = uint8_t(std::min(nkey, sizeof(s.key)));
+    std::memcpy(s.key, key, s.key_len);
+    s.vbucket = vbucket;
+    s.opcode = opcode;
+
+    const auto idx = head.load(std::memory_order_relaxed);
+    samples[idx % capacity] = s;
+    // Publish the slot after it has been fully written so that a
+    // reader which observes the new head also observes the sample.
+    head.store(idx + 1, std::memory_order_release);
+}
+
+std::vector<HotnessSample> HotnessSampler::snapshot() const {
+    const auto end = head.load(std::memory_order_acquire);
+    const auto num = std::min(end, uint64_t(capacity));
+
+    std::vector<HotnessSample> ret;
+    ret.reserve(num);
+    for (uint64_t idx = end - num; idx < end; ++idx) {
+        ret.push_back(samples[idx % capacity]);
+    }
+    return ret;
+}
+
+void HotnessSampler::reset() {
+    // Dropping the head back to zero makes snapshot() consider the
+    // reservoir empty; the stale slots are simply overwritten again.
+    head.store(0, std::memory_order_release);
+}
+
+/**
+ * Add "count" and "share" to the object and append it to the array
+ */
+static void addRankedEntry(cJSON* array,
+                           cJSON* obj,
+                           uint64_t count,
+                           uint64_t total) {
+    cJSON_AddNumberToObject(obj, "count", double(count));
+    cJSON_AddNumberToObject(obj, "share", double(count) / double(total));
+    cJSON_AddItemToArray(array, obj);
+}
+
+unique_cJSON_ptr hotness_report() {
+    std::unordered_map<std::string, uint64_t> keys;
+    std::map<uint16_t, uint64_t> vbuckets;
+    std::array<uint64_t, 0x100> opcodes{};
+    uint64_t total = 0;
+
+    for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        auto* thread = get_worker_thread(ii);
+        if (thread == nullptr || thread->hotness == nullptr) {
+            continue;
+        }
+        for (const auto& s : thread->hotness->snapshot()) {
+            ++keys[std::string{s.key, s.key_len}];
+            ++vbuckets[s.vbucket];
+            ++opcodes[s.opcode];
+            ++total;
+        }
+    }
+
+    unique_cJSON_ptr json(cJSON_CreateObject());
+    if (!json) {
+        return json;
+    }
+    cJSON_AddNumberToObject(json.get(), "total_samples", double(total));
+    cJSON_AddNumberToObject(json.get(),
+                            "sample_every",
+                            HotnessSampler::sample_every.load());
+
+    cJSON* key_array = cJSON_CreateArray();
+    cJSON* vb_array = cJSON_CreateArray();
+    cJSON* op_array = cJSON_CreateArray();
+    cJSON_AddItemToObject(json.get(), "keys", key_array);
+    cJSON_AddItemToObject(json.get(), "vbuckets", vb_array);
+    cJSON_AddItemToObject(json.get(), "opcodes", op_array);
+
+    if (total == 0) {
+        return json;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> ranked_keys(keys.begin(),
+                                                              keys.end());
+    std::sort(ranked_keys.begin(),
+              ranked_keys.end(),
+              [](const std::pair<std::string, uint64_t>& a,
+                 const std::pair<std::string, uint64_t>& b) {
+                  return a.second > b.second;
+              });
+    for (const auto& entry : ranked_keys) {
+        cJSON* obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "key", entry.first.c_str());
+        addRankedEntry(key_array, obj, entry.second, total);
+    }
+
+    std::vector<std::pair<uint16_t, uint64_t>> ranked_vbs(vbuckets.begin(),
+                                                          vbuckets.end());
+    std::sort(ranked_vbs.begin(),
+              ranked_vbs.end(),
+              [](const std::pair<uint16_t, uint64_t>& a,
+                 const std::pair<uint16_t, uint64_t>& b) {
+                  return a.second > b.second;
+              });
+    for (const auto& entry : ranked_vbs) {
+        cJSON* obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "vbucket", entry.first);
+        addRankedEntry(vb_array, obj, entry.second, total);
+    }
+
+    std::vector<std::pair<uint8_t, uint64_t>> ranked_ops;
+    for (int opcode = 0; opcode < 0x100; ++opcode) {
+        if (opcodes[opcode] > 0) {
+            ranked_ops.emplace_back(uint8_t(opcode), opcodes[opcode]);
+        }
+    }
+    std::sort(ranked_ops.begin(),
+              ranked_ops.end(),
+              [](const std::pair<uint8_t, uint64_t>& a,
+                 const std::pair<uint8_t, uint64_t>& b) {
+                  return a.second > b.second;
+              });
+    for (const auto& entry : ranked_ops) {
+        cJSON* obj = cJSON_CreateObject();
+        const char* name = memcached_opcode_2_text(entry.first);
+        if (name == nullptr) {
+            cJSON_AddNumberToObject(obj, "opcode", entry.first);
+        } else {
+            cJSON_AddStringToObject(obj, "opcode", name);
+        }
+        addRankedEntry(op_array, obj, entry.second, total);
+    }
+
+    return json;
+}
+
+ENGINE_ERROR_CODE ioctlGetHotnessReport(Connection*,
+                                        const StrToStrMap&,
+                                        std::string& value) {
+    auto json = hotness_report();
+    if (!json) {
+        return ENGINE_ENOMEM;
+    }
+
+    char* ptr = cJSON_PrintUnformatted(json.get());
+    if (ptr == nullptr) {
+        return ENGINE_ENOMEM;
+    }
+    value.assign(ptr);
+    cJSON_Free(ptr);
+
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlSetHotnessReset(Connection*,
+                                       const StrToStrMap&,
+                                       const std::string&) {
+    for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        auto* thread = get_worker_thread(ii);
+        if (thread != nullptr && thread->hotness != nullptr) {
+            thread->hotness->reset();
+        }
+    }
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlSetHotnessSampleEvery(Connection*,
+                                             const StrToStrMap&,
+                                             const std::string& value) {
+    uint32_t rate;
+    try {
+        rate = uint32_t(std::stoul(value));
+    } catch (const std::exception&) {
+        return ENGINE_EINVAL;
+    }
+    if (rate == 0) {
+        return ENGINE_EINVAL;
+    }
+    HotnessSampler::sample_every.store(rate);
+    return ENGINE_SUCCESS;
+}
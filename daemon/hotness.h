@@ -0,0 +1,156 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cJSON_utils.h>
+#include <memcached/types.h>
+
+#include "utilities/string_utilities.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Connection;
+
+/**
+ * Always-on sampled load profiling ("hotness").
+ *
+ * TopKeys counts accesses exactly but only for the opcodes it is
+ * taught about, per bucket, and it says nothing about vbucket or
+ * opcode skew. This module instead samples one in every N completed
+ * commands into a small per-worker-thread reservoir (key, vbucket and
+ * opcode), so the live load distribution of the node can be ranked at
+ * any time: which keys, vbuckets and opcodes carry which share of the
+ * traffic right now. The cost on the op path is a counter increment,
+ * and a struct store once every N ops.
+ *
+ * The merged ranking is available through "stats hotness" and
+ * "ioctl_get hotness.report"; "ioctl_set hotness.sample_every" tunes
+ * the sampling rate and "ioctl_set hotness.reset" discards the
+ * current reservoirs.
+ */
+
+/**
+ * A single sampled operation. The key is truncated to what fits in
+ * the record; ranking cares about hot keys, and keys hot enough to
+ * matter collide on their full prefix rarely enough to not distort
+ * the picture.
+ */
+struct HotnessSample {
+    /// Leading bytes of the document key
+    char key[32];
+    /// Number of bytes of key which are valid
+    uint8_t key_len;
+    /// The opcode of the command
+    uint8_t opcode;
+    /// The vbucket the command addressed
+    uint16_t vbucket;
+};
+
+/**
+ * A reservoir of sampled operations owned by a single worker thread.
+ *
+ * Only the owning thread writes to the reservoir; readers (the stats
+ * or ioctl handler running on some other worker thread) may take a
+ * snapshot at any time without stopping the writer. As with
+ * OpTraceRing the snapshot is intentionally lock free and lossy: a
+ * sample being overwritten while the snapshot copies it may be torn,
+ * which for a statistical facility is an acceptable trade for keeping
+ * the op path free of synchronization.
+ */
+class HotnessSampler {
+public:
+    /// The number of samples each worker thread keeps
+    static const size_t capacity = 1024;
+
+    /// The default sampling rate (one sample per this many ops)
+    static const uint32_t default_sample_every = 100;
+
+    /**
+     * Account for a completed command, recording it if it falls on
+     * the sampling grid. May only be called by the owning thread.
+     */
+    void sample(const char* key,
+                size_t nkey,
+                uint16_t vbucket,
+                uint8_t opcode);
+
+    /**
+     * Copy out the current content of the reservoir. Safe to call
+     * from any thread.
+     */
+    std::vector<HotnessSample> snapshot() const;
+
+    /// Discard all recorded samples. Safe to call from any thread.
+    void reset();
+
+    /**
+     * The sampling rate shared by all of the samplers (one sample per
+     * this many ops); tunable through "ioctl_set hotness.sample_every"
+     */
+    static std::atomic<uint32_t> sample_every;
+
+private:
+    std::array<HotnessSample, capacity> samples;
+
+    // Total number of samples ever recorded; the next slot to write
+    // is (head % capacity). Published with release ordering after the
+    // slot is written.
+    std::atomic<uint64_t> head{0};
+
+    // Commands seen since the last recorded sample; only touched by
+    // the owning thread.
+    uint64_t opcount = 0;
+};
+
+/**
+ * Merge the reservoirs of all worker threads and rank keys, vbuckets
+ * and opcodes by their share of the samples.
+ *
+ * @return JSON of the form
+ *         {"total_samples":N, "sample_every":N,
+ *          "keys":[{"key":..,"count":..,"share":..},..],
+ *          "vbuckets":[{"vbucket":..,"count":..,"share":..},..],
+ *          "opcodes":[{"opcode":..,"count":..,"share":..},..]}
+ *         with each array ordered by descending count
+ */
+unique_cJSON_ptr hotness_report();
+
+/**
+ * IOCTL Get callback returning hotness_report() as a string
+ */
+ENGINE_ERROR_CODE ioctlGetHotnessReport(Connection* c,
+                                        const StrToStrMap& arguments,
+                                        std::string& value);
+
+/**
+ * IOCTL Set callback discarding the current reservoirs
+ */
+ENGINE_ERROR_CODE ioctlSetHotnessReset(Connection* c,
+                                       const StrToStrMap& arguments,
+                                       const std::string& value);
+
+/**
+ * IOCTL Set callback updating the sampling rate. The value must be a
+ * positive integer.
+ */
+ENGINE_ERROR_CODE ioctlSetHotnessSampleEvery(Connection* c,
+                                             const StrToStrMap& arguments,
+                                             const std::string& value);
@@ -20,6 +20,8 @@
 #include "config.h"
 #include "alloc_hooks.h"
 #include "connections.h"
+#include "hotness.h"
+#include "optrace.h"
 #include "utilities/string_utilities.h"
 #include "tracing.h"
 
@@ -122,6 +124,8 @@ static const std::unordered_map<std::string, GetCallbackFunc> ioctl_get_map{
         {"trace.status", ioctlGetTracingStatus},
         {"trace.dump.begin", ioctlGetTracingBeginDump},
         {"trace.dump.chunk", ioctlGetTracingDumpChunk},
+        {"optrace.dump", ioctlGetOpTraceDump},
+        {"hotness.report", ioctlGetHotnessReport},
         {"sla", ioctlGetMcbpSla}};
 
 ENGINE_ERROR_CODE ioctl_get_property(Connection* c,
@@ -176,6 +180,8 @@ static const std::unordered_map<std::string, SetCallbackFunc> ioctl_set_map{
         {"trace.start", ioctlSetTracingStart},
         {"trace.stop", ioctlSetTracingStop},
         {"trace.dump.clear", ioctlSetTracingClearDump},
+        {"hotness.reset", ioctlSetHotnessReset},
+        {"hotness.sample_every", ioctlSetHotnessSampleEvery},
         {"sla", ioctlSetMcbpSla}};
 
 ENGINE_ERROR_CODE ioctl_set_property(Connection* c,
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "memcached.h"
 #include "mc_time.h"
+#include "stats_shm.h"
 
 #include <atomic>
 
@@ -51,6 +52,7 @@ const time_t memcached_check_system_time = 60;
 const time_t memcached_maximum_relative_time = 60*60*24*30;
 
 static std::atomic<rel_time_t> memcached_uptime(0);
+static std::atomic<ProcessClock::duration::rep> memcached_coarse_steady_time(0);
 static volatile time_t memcached_epoch = 0;
 static volatile uint64_t memcached_monotonic_start = 0;
 static struct event_base* main_ev_base = NULL;
@@ -96,6 +98,14 @@ rel_time_t mc_time_get_current_time(void) {
     return memcached_uptime;
 }
 
+/*
+ * Return the steady clock value cached by the last clock tick.
+ */
+ProcessClock::time_point mc_time_get_coarse_steady_time(void) {
+    return ProcessClock::time_point(
+            ProcessClock::duration(memcached_coarse_steady_time.load()));
+}
+
 /*
  * Given a timestamp (timestamp follows the rules of mc store protocol)
  * return the seconds from "now" it is expected to expire.
@@ -172,9 +182,16 @@ void mc_time_clock_tick(void) {
     /* calculate our monotonic uptime */
     memcached_uptime = (rel_time_t)(cb_get_monotonic_seconds() - memcached_monotonic_start + cb_get_uptime_offset());
 
+    /* refresh the coarse steady clock */
+    memcached_coarse_steady_time =
+            ProcessClock::now().time_since_epoch().count();
+
     /* Collect samples */
     mc_gather_timing_samples();
 
+    /* Refresh the shared-memory stats export (if enabled) */
+    stats_shm_update();
+
     /*
       every 'memcached_check_system_time' seconds, keep an eye on the
       system clock.
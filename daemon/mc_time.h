@@ -47,4 +47,19 @@ rel_time_t mc_time_convert_to_real_time(const time_t t);
 #ifdef __cplusplus
 }
 #endif
+
+#ifdef __cplusplus
+#include <platform/processclock.h>
+
+/*
+ * Return a coarse view of ProcessClock::now().
+ *
+ * The value is refreshed by mc_time_clock_tick() (i.e. once per
+ * memcached_clock_tick_seconds) rather than read from the clock, making
+ * it cheap enough for timestamping where second granularity suffices.
+ * Paths feeding the operation timing histograms or trace events must
+ * keep using ProcessClock::now() directly.
+ */
+ProcessClock::time_point mc_time_get_coarse_steady_time(void);
+#endif
 #endif
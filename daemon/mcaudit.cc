@@ -97,7 +97,9 @@ static unique_cJSON_ptr create_memcached_audit_object(const Connection *c) {
 }
 
 /**
- * Convert the JSON object to text and send it to the audit framework
+ * Hand the JSON object over to the audit framework. The conversion to
+ * text happens on the audit daemon's own thread so that the worker
+ * thread doesn't have to pay for the serialization.
  *
  * @param c the connection object requesting the call
  * @param id the audit identifier
@@ -108,12 +110,12 @@ static void do_audit(const Connection* c,
                      uint32_t id,
                      unique_cJSON_ptr& event,
                      const char* warn) {
-    auto text = to_string(event, false);
-    auto status = put_audit_event(get_audit_handle(), id, text.data(),
-                                  text.length());
+    auto status = put_json_audit_event(get_audit_handle(), id,
+                                       std::move(event));
 
     if (status != AUDIT_SUCCESS) {
-        LOG_WARNING(c, "%s: %s", warn, text.c_str());
+        // The audit daemon logs the payload of the events it drops
+        LOG_WARNING(c, "%s", warn);
     }
 }
 
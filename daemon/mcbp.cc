@@ -16,14 +16,24 @@
  */
 #include "mcbp.h"
 
+#include "buckets.h"
+#include "buffer_pool.h"
 #include "debug_helpers.h"
 #include "memcached.h"
+#include "hotness.h"
+#include "optrace.h"
 #include "protocol/mcbp/engine_wrapper.h"
 #include "utilities/protocol2text.h"
 #include "xattr/utils.h"
 
 #include <include/memcached/protocol_binary.h>
+#include <mcbp/mcbp.h>
+#include <platform/cb_malloc.h>
 #include <platform/compress.h>
+#include <snappy-c.h>
+
+#include <algorithm>
+#include <functional>
 
 /**
  * Send a not my vbucket response to the client. It should piggyback the
@@ -34,9 +44,10 @@
  * @return true if success, false if memory allocation fails.
  */
 static bool send_not_my_vbucket(McbpConnection& c) {
-    auto pair = c.getBucket().clusterConfiguration.getConfiguration();
-    if (pair.first == -1 ||
-        (pair.first == c.getClustermapRevno() && settings.isDedupeNmvbMaps())) {
+    auto config = c.getBucket().clusterConfiguration.getConfiguration();
+    if (config->revision == -1 ||
+        (config->revision == c.getClustermapRevno() &&
+         settings.getDataPathSnapshot().isDedupeNmvbMaps())) {
         // We don't have a vbucket map, or we've already sent it to the
         // client
         mcbp_add_header(&c,
@@ -50,33 +61,25 @@ static bool send_not_my_vbucket(McbpConnection& c) {
         return true;
     }
 
-    protocol_binary_response_header* header;
-    const size_t needed = sizeof(*header) + pair.second->size();
-
-    if (!c.growDynamicBuffer(needed)) {
-        LOG_WARNING(&c,
-                    "<%d ERROR: Failed to allocate memory for response",
-                    c.getId());
+    // The map is shared with every other connection sending this revision;
+    // reference it from the message rather than formatting a copy into the
+    // dynamic buffer, and keep the snapshot alive until the response has
+    // been transmitted.
+    const std::string* payload = &config->uncompressed;
+    mcbp_add_header(&c,
+                    PROTOCOL_BINARY_RESPONSE_NOT_MY_VBUCKET,
+                    0,
+                    0,
+                    uint32_t(payload->size()),
+                    PROTOCOL_BINARY_RAW_BYTES);
+    c.addIov(payload->data(), payload->size());
+    if (!c.pinSharedBuffer(std::shared_ptr<const std::string>(config,
+                                                              payload))) {
         return false;
     }
-
-    auto& buffer = c.getDynamicBuffer();
-    auto* buf = buffer.getCurrent();
-    header = reinterpret_cast<protocol_binary_response_header*>(buf);
-    memset(header, 0, sizeof(*header));
-
-    header->response.magic = (uint8_t)PROTOCOL_BINARY_RES;
-    header->response.opcode = c.binary_header.request.opcode;
-    header->response.status =
-            (uint16_t)htons(PROTOCOL_BINARY_RESPONSE_NOT_MY_VBUCKET);
-    header->response.bodylen = htonl((uint32_t)pair.second->size());
-    header->response.opaque = c.getOpaque();
-    buf += sizeof(*header);
-    std::copy(pair.second->begin(), pair.second->end(), buf);
-    buffer.moveOffset(needed);
-
-    mcbp_write_and_free(&c, &c.getDynamicBuffer());
-    c.setClustermapRevno(pair.first);
+    c.setState(McbpStateMachine::State::send_data);
+    c.setWriteAndGo(McbpStateMachine::State::new_cmd);
+    c.setClustermapRevno(config->revision);
     return true;
 }
 
@@ -112,17 +115,59 @@ void mcbp_write_response(McbpConnection* c,
 void mcbp_write_and_free(McbpConnection* c, DynamicBuffer* buf) {
     if (buf->getRoot() == nullptr) {
         c->setState(McbpStateMachine::State::closing);
-    } else {
-        if (!c->pushTempAlloc(buf->getRoot())) {
+        return;
+    }
+
+    // Move the ownership of the segments over to the connection; they
+    // must stay alive until the response has been transmitted (the
+    // buffer itself may be reused for the next pipelined command).
+    auto segments = buf->releaseSegments();
+    for (size_t ii = 0; ii < segments.size(); ++ii) {
+        auto& segment = segments[ii];
+        const bool pushed =
+                (segment.capacity == BufferPool::SEGMENT_SIZE)
+                        ? c->pushTempSegment(segment.data)
+                        : c->pushTempAlloc(segment.data);
+        if (!pushed) {
+            // The segments pushed so far are owned by the connection
+            // and released with it; free the ones we didn't get to.
+            for (size_t jj = ii; jj < segments.size(); ++jj) {
+                cb_free(segments[jj].data);
+            }
             c->setState(McbpStateMachine::State::closing);
             return;
         }
-        c->addIov(buf->getRoot(), buf->getOffset());
-        c->setState(McbpStateMachine::State::send_data);
-        c->setWriteAndGo(McbpStateMachine::State::new_cmd);
 
-        buf->takeOwnership();
+        if (segment.used > 0) {
+            c->addIov(segment.data, segment.used);
+        }
     }
+
+    c->setState(McbpStateMachine::State::send_data);
+    c->setWriteAndGo(McbpStateMachine::State::new_cmd);
+}
+
+bool mcbp_inflate_snappy(McbpConnection& c,
+                         cb::const_char_buffer input,
+                         ScratchBuffer& output) {
+    size_t inflated_length;
+    if (snappy_uncompressed_length(input.buf, input.len, &inflated_length) !=
+        SNAPPY_OK) {
+        return false;
+    }
+
+    auto* thread = c.getThread();
+    output.resize(thread == nullptr ? nullptr : thread->buffer_pool,
+                  inflated_length);
+
+    size_t outlen = output.getCapacity();
+    if (snappy_uncompress(input.buf, input.len, output.data(), &outlen) !=
+        SNAPPY_OK) {
+        return false;
+    }
+
+    output.setSize(outlen);
+    return true;
 }
 
 void mcbp_write_packet(McbpConnection* c, protocol_binary_response_status err) {
@@ -205,7 +250,7 @@ void mcbp_add_header(McbpConnection* c,
                                       c->getOpaque(),
                                       c->getCAS());
 
-    if (settings.getVerbose() > 1) {
+    if (settings.getDataPathSnapshot().getVerbose() > 1) {
         char buffer[1024];
         if (bytes_to_output_string(buffer,
                                    sizeof(buffer),
@@ -236,10 +281,10 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
     cb::compression::Buffer buffer;
     cb::const_char_buffer payload(static_cast<const char*>(body), bodylen);
 
-    if (!c->isSnappyEnabled() && mcbp::datatype::is_snappy(datatype)) {
+    if (!c->isSnappyEnabled() && Datatype::isCompressed(datatype)) {
         // The client is not snappy-aware, and the content contains
         // snappy encoded data.. We need to inflate it!
-        if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+        if (!cb::compression::inflate(Datatype::toAlgorithm(datatype),
                                       payload.buf, payload.len, buffer)) {
             std::string mykey(reinterpret_cast<const char*>(key), keylen);
             LOG_WARNING(c,
@@ -284,13 +329,6 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
     const size_t needed = payload.len + keylen + extlen +
                           sizeof(protocol_binary_response_header);
 
-    auto &dbuf = c->getDynamicBuffer();
-    if (!dbuf.grow(needed)) {
-        LOG_WARNING(c, "<%u ERROR: Failed to allocate memory for response",
-                    c->getId());
-        return false;
-    }
-
     protocol_binary_response_header header = {};
     header.response.magic = (uint8_t)PROTOCOL_BINARY_RES;
     header.response.opcode = c->binary_header.request.opcode;
@@ -302,6 +340,69 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
     header.response.opaque = c->getOpaque();
     header.response.cas = htonll(cas);
 
+    // For large values we build the response as scatter/gather iovec
+    // entries instead of copying everything into a contiguous dynamic
+    // buffer: the header (and extras / key) goes into the write pipe,
+    // and the value is referenced by its own iovec entry. If we had to
+    // inflate the value we hand the inflated buffer over to the
+    // connection, so the body is never copied at all.
+    if (payload.len >= DIRECT_VALUE_MIN_SIZE &&
+        c->getDynamicBuffer().getRoot() == nullptr &&
+        !c->isResponseBatchPending() &&
+        c->write->wdata().size() >=
+                sizeof(protocol_binary_response_header) + extlen + keylen) {
+        std::unique_ptr<char[]> body;
+        if (buffer.data && payload.buf == buffer.data.get()) {
+            // We own the (inflated) copy of the value
+            body = std::move(buffer.data);
+        } else {
+            // The value is owned by the engine and is only guaranteed
+            // to be valid for the duration of this call; take a copy.
+            try {
+                body.reset(new char[payload.len]);
+            } catch (const std::bad_alloc&) {
+                LOG_WARNING(c,
+                            "<%u ERROR: Failed to allocate memory for response",
+                            c->getId());
+                return false;
+            }
+            std::copy(payload.buf, payload.buf + payload.len, body.get());
+        }
+
+        c->addMsgHdr(!c->isDirectResponseBuilt());
+        c->write->produce([c, &header, ext, extlen, key, keylen](
+                                  cb::byte_buffer wbuf) -> size_t {
+            size_t offset = 0;
+            memcpy(wbuf.data(), header.bytes, sizeof(header.bytes));
+            offset += sizeof(header.bytes);
+            if (extlen > 0) {
+                memcpy(wbuf.data() + offset, ext, extlen);
+                offset += extlen;
+            }
+            if (keylen > 0) {
+                memcpy(wbuf.data() + offset, key, keylen);
+                offset += keylen;
+            }
+            c->addIov(wbuf.data(), offset);
+            return offset;
+        });
+
+        c->addIov(body.get(), payload.len);
+        if (!c->pinBuffer(std::move(body))) {
+            return false;
+        }
+        c->setDirectResponseBuilt();
+        ++c->getBucket().responseCounters[status];
+        return true;
+    }
+
+    auto &dbuf = c->getDynamicBuffer();
+    if (!dbuf.grow(needed)) {
+        LOG_WARNING(c, "<%u ERROR: Failed to allocate memory for response",
+                    c->getId());
+        return false;
+    }
+
     ++c->getBucket().responseCounters[status];
 
     char *buf = dbuf.getCurrent();
@@ -328,8 +429,11 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
 
 void mcbp_collect_timings(const McbpConnection* c) {
     const auto elapsed_ns = ProcessClock::now() - c->getStart();
+    const auto* thread = c->getThread();
+    const int thread_index = (thread == nullptr) ? -1 : thread->index;
+
     // aggregated timing for all buckets
-    all_buckets[0].timings.collect(c->getCmd(), elapsed_ns);
+    all_buckets[0].timings.collect(thread_index, c->getCmd(), elapsed_ns);
 
     // timing for current bucket
     bucket_id_t bucketid = get_bucket_id(c->getCookie());
@@ -338,11 +442,80 @@ void mcbp_collect_timings(const McbpConnection* c) {
      * to delete the bucket you're associated with and your're idle.
      */
     if (bucketid != 0) {
-        all_buckets[bucketid].timings.collect(c->getCmd(), elapsed_ns);
+        all_buckets[bucketid].timings.collect(
+                thread_index, c->getCmd(), elapsed_ns);
+        // .. and in the bucket's per-vbucket latency heatmap (sampled;
+        // ignores opcodes the heatmap doesn't track)
+        all_buckets[bucketid].vbucket_timings.collect(
+                thread_index,
+                c->getCmd(),
+                c->getBinaryHeader().request.vbucket,
+                elapsed_ns);
     }
 
     // Log operations taking longer than 0.5s
     const auto elapsed_ms =
             std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_ns);
     c->maybeLogSlowCommand(elapsed_ms);
+
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    const auto start = c->getStart();
+    auto offset_from_start = [start](ProcessClock::time_point tp) {
+        if (tp == ProcessClock::time_point()) {
+            return uint32_t(0);
+        }
+        const auto ns = duration_cast<nanoseconds>(tp - start).count();
+        if (ns < 0) {
+            return uint32_t(0);
+        }
+        return uint32_t(std::min<uint64_t>(ns, UINT32_MAX));
+    };
+    const auto start_ns = uint64_t(
+            duration_cast<nanoseconds>(start.time_since_epoch()).count());
+    const auto total_ns = uint32_t(std::min<uint64_t>(
+            duration_cast<nanoseconds>(elapsed_ns).count(), UINT32_MAX));
+
+    // Record the command in the worker thread's operation trace ring
+    if (thread != nullptr && thread->optrace != nullptr) {
+        OpTraceEvent event;
+        event.start_ns = start_ns;
+        event.execute_ns = offset_from_start(c->getExecuteStart());
+        event.notify_ns = offset_from_start(c->getNotifyTime());
+        event.total_ns = total_ns;
+        event.connection_id = c->getId();
+        event.opcode = c->getCmd();
+        thread->optrace->record(event);
+    }
+
+    // Account the command in the thread's hotness reservoir (records
+    // one in every N ops; see hotness.h)
+    if (thread != nullptr && thread->hotness != nullptr) {
+        const auto key = c->getKey();
+        thread->hotness->sample(key.buf,
+                                key.len,
+                                c->getBinaryHeader().request.vbucket,
+                                c->getCmd());
+    }
+
+    // Capture commands which exceeded their SLA threshold in the
+    // bucket's slow operation ring (with more context than the slow
+    // command log line above can carry)
+    if (bucketid != 0 &&
+        elapsed_ns > cb::mcbp::sla::getSlowOpThreshold(
+                             cb::mcbp::ClientOpcode(c->getCmd()))) {
+        SlowOpEvent event;
+        event.start_ns = start_ns;
+        event.execute_ns = offset_from_start(c->getExecuteStart());
+        event.notify_ns = offset_from_start(c->getNotifyTime());
+        event.total_ns = total_ns;
+        event.connection_id = c->getId();
+        const auto key = c->getKey();
+        event.key_hash = uint32_t(
+                std::hash<std::string>()(std::string{key.buf, key.len}));
+        event.vbucket = c->getBinaryHeader().request.vbucket;
+        event.opcode = c->getCmd();
+        all_buckets[bucketid].slowops.record(event);
+    }
 }
@@ -22,6 +22,7 @@
  */
 
 #include <memcached/protocol_binary.h>
+#include "buffer_pool.h"
 #include "connection_mcbp.h"
 #include "protocol/mcbp/engine_errc_2_mcbp.h"
 
@@ -94,3 +95,22 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
 
 /* set up a connection to write a DynamicBuffer then free it once sent. */
 void mcbp_write_and_free(McbpConnection* c, DynamicBuffer* buf);
+
+/**
+ * Inflate a snappy-compressed payload into a scratch buffer backed by
+ * the worker thread's BufferPool (instead of allocating a fresh
+ * destination buffer for every value we have to inflate for a client
+ * which didn't negotiate snappy).
+ *
+ * @param c the connection the payload is inflated on behalf of (its
+ *          worker thread provides the scratch buffer)
+ * @param input the compressed payload
+ * @param output the scratch buffer to inflate into (resized as needed;
+ *               the inflated data is valid until the buffer is reused
+ *               or destroyed)
+ * @return true on success, false if the payload can't be inflated
+ * @throws std::bad_alloc if memory allocation fails
+ */
+bool mcbp_inflate_snappy(McbpConnection& c,
+                         cb::const_char_buffer input,
+                         ScratchBuffer& output);
@@ -17,7 +17,24 @@
 
 #include "mcbp.h"
 
+#include "connection_mcbp.h"
+#include "mcbp_validators.h"
+#include "settings.h"
+
 #include <benchmark/benchmark.h>
+#include <platform/processclock.h>
+#include <utilities/protocol2text.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 // Benchmark trying to format into the net_buf structure
 
@@ -140,4 +157,213 @@ void AdjustMsgHeaderBenchmark(benchmark::State& state) {
 }
 BENCHMARK(AdjustMsgHeaderBenchmark);
 
-BENCHMARK_MAIN()
+// ---------------------------------------------------------------------
+// Workload replay
+//
+// In addition to the micro benchmarks above, the harness can replay one
+// or more workload files captured with MEMCACHED_MCBP_CAPTURE (see
+// mcbp_capture.h) through the header prevalidation and per-opcode
+// validator chains - the full front-end parsing path - reporting overall
+// ops/sec and the per-opcode cost, so that parsing changes can be
+// measured against a representative opcode mix without standing up a
+// cluster. Dispatching the commands into a bucket is out of scope here;
+// that requires an engine instance and is covered by the testapps.
+// ---------------------------------------------------------------------
+
+namespace {
+
+class BenchmarkConnection : public McbpConnection {
+public:
+    BenchmarkConnection() : McbpConnection() {
+    }
+};
+
+/**
+ * Cookie which allows the packet to be set directly from the replay
+ * buffer instead of going through the connection's read pipe.
+ */
+class BenchmarkCookie : public Cookie {
+public:
+    BenchmarkCookie(McbpConnection& connection) : Cookie(connection) {
+    }
+
+    void setFrame(cb::const_byte_buffer buffer) {
+        setPacket(PacketContent::Full, buffer);
+    }
+};
+
+struct OpcodeCost {
+    uint64_t count = 0;
+    uint64_t ns = 0;
+};
+
+/**
+ * Split the capture file content into complete frames. Throws if the
+ * content doesn't look like captured request traffic; a truncated
+ * trailing frame is silently dropped.
+ */
+std::vector<cb::const_byte_buffer> splitFrames(
+        const std::vector<uint8_t>& data) {
+    std::vector<cb::const_byte_buffer> frames;
+    size_t offset = 0;
+    while (data.size() - offset >= sizeof(protocol_binary_request_header)) {
+        const auto* req =
+                reinterpret_cast<const protocol_binary_request_header*>(
+                        data.data() + offset);
+        if (req->request.magic != PROTOCOL_BINARY_REQ) {
+            throw std::runtime_error(
+                    "splitFrames: invalid magic at offset " +
+                    std::to_string(offset));
+        }
+        const size_t frame = sizeof(*req) + ntohl(req->request.bodylen);
+        if (offset + frame > data.size()) {
+            break;
+        }
+        frames.push_back({data.data() + offset, frame});
+        offset += frame;
+    }
+    return frames;
+}
+
+/**
+ * Fill in the connection's cached (byte swapped) copy of the header the
+ * same way the state machine does before running the validators.
+ */
+void setupHeader(McbpConnection& connection, cb::const_byte_buffer frame) {
+    const auto* req =
+            reinterpret_cast<const protocol_binary_request_header*>(
+                    frame.data());
+    connection.binary_header = *req;
+    connection.binary_header.request.keylen = ntohs(req->request.keylen);
+    connection.binary_header.request.bodylen = ntohl(req->request.bodylen);
+    connection.binary_header.request.vbucket = ntohs(req->request.vbucket);
+    connection.binary_header.request.cas = ntohll(req->request.cas);
+}
+
+int replayWorkload(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open workload file: %s\n",
+                filename.c_str());
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+
+    std::vector<cb::const_byte_buffer> frames;
+    try {
+        frames = splitFrames(data);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s: %s\n", filename.c_str(), e.what());
+        return EXIT_FAILURE;
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "%s contains no complete frames\n", filename.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // The number of bytes covered by the complete frames (a truncated
+    // trailing frame would otherwise trip the header prevalidation).
+    const size_t valid_bytes =
+            frames.back().data() + frames.back().size() - data.data();
+
+    settings.setXattrEnabled(true);
+    McbpValidatorChains chains;
+    McbpValidatorChains::initializeMcbpValidatorChains(chains);
+
+    BenchmarkConnection connection;
+    connection.enableDatatype(cb::mcbp::Feature::XATTR);
+    BenchmarkCookie cookie(connection);
+
+    // Replay the workload enough times for a stable measurement.
+    const size_t target_ops = 2000000;
+    const size_t passes = std::max(size_t(1), target_ops / frames.size());
+
+    // First measure the throughput of the full parsing path (one header
+    // prevalidation scan over the buffer, then the per-opcode validator
+    // for each frame), timed in bulk.
+    const auto start = ProcessClock::now();
+    for (size_t pass = 0; pass < passes; pass++) {
+        bool invalid = false;
+        auto prevalidated =
+                mcbp_prevalidate_headers({data.data(), valid_bytes}, invalid);
+        benchmark::DoNotOptimize(prevalidated);
+        for (const auto& frame : frames) {
+            setupHeader(connection, frame);
+            cookie.setFrame(frame);
+            auto status = chains.invoke(
+                    protocol_binary_command(frame.data()[1]), cookie);
+            benchmark::DoNotOptimize(status);
+        }
+    }
+    const auto duration = ProcessClock::now() - start;
+
+    // Then time each validator invocation individually to attribute the
+    // cost to the opcodes.
+    std::array<OpcodeCost, 0x100> costs{};
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (const auto& frame : frames) {
+            const uint8_t opcode = frame.data()[1];
+            setupHeader(connection, frame);
+            cookie.setFrame(frame);
+            const auto op_start = ProcessClock::now();
+            auto status = chains.invoke(protocol_binary_command(opcode),
+                                        cookie);
+            const auto op_end = ProcessClock::now();
+            benchmark::DoNotOptimize(status);
+            costs[opcode].count++;
+            costs[opcode].ns += (op_end - op_start).count();
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(duration).count();
+    const uint64_t total_ops = frames.size() * passes;
+    uint64_t total_ns = 0;
+    for (const auto& cost : costs) {
+        total_ns += cost.ns;
+    }
+
+    printf("Replayed %s: %zu frames x %zu passes\n",
+           filename.c_str(), frames.size(), passes);
+    printf("Parse+validate: %" PRIu64 " ops in %.3f s (%.0f ops/sec)\n\n",
+           total_ops, seconds, total_ops / seconds);
+    printf("%-32s %10s %12s %8s\n", "Opcode", "Count", "Avg cost", "Share");
+    for (int ii = 0; ii < 0x100; ++ii) {
+        if (costs[ii].count == 0) {
+            continue;
+        }
+        char unknown[16];
+        const char* name = memcached_opcode_2_text(uint8_t(ii));
+        if (name == nullptr) {
+            snprintf(unknown, sizeof(unknown), "0x%02x", ii);
+            name = unknown;
+        }
+        printf("%-32s %10" PRIu64 " %9.0f ns %7.2f%%\n",
+               name,
+               costs[ii].count,
+               double(costs[ii].ns) / costs[ii].count,
+               total_ns ? double(costs[ii].ns) * 100.0 / total_ns : 0.0);
+    }
+    printf("\n");
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+
+    if (argc > 1) {
+        // Positional arguments are captured workload files to replay.
+        int exitcode = EXIT_SUCCESS;
+        for (int ii = 1; ii < argc; ++ii) {
+            if (replayWorkload(argv[ii]) != EXIT_SUCCESS) {
+                exitcode = EXIT_FAILURE;
+            }
+        }
+        return exitcode;
+    }
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "mcbp_capture.h"
+
+#include <mcbp/protocol/parser.h>
+#include <memcached/protocol_binary.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace {
+
+struct CaptureState {
+    CaptureState() {
+        const char* env = getenv("MEMCACHED_MCBP_CAPTURE");
+        if (env == nullptr) {
+            return;
+        }
+
+        std::string value(env);
+        const auto comma = value.rfind(',');
+        if (comma != std::string::npos) {
+            try {
+                rate = std::stoul(value.substr(comma + 1));
+                value.resize(comma);
+            } catch (const std::exception&) {
+                // No (valid) rate suffix; treat the entire value as the
+                // filename and keep the default rate.
+            }
+        }
+        if (rate == 0) {
+            rate = 1;
+        }
+
+        file.open(value, std::ios::binary | std::ios::app);
+        enabled = file.is_open();
+    }
+
+    bool enabled = false;
+    size_t rate = 100;
+    size_t seen = 0;
+    std::ofstream file;
+    std::mutex mutex;
+};
+
+CaptureState& instance() {
+    static CaptureState state;
+    return state;
+}
+
+} // namespace
+
+bool mcbp_capture_enabled() {
+    return instance().enabled;
+}
+
+void mcbp_capture_frames(cb::const_byte_buffer buffer) {
+    auto& state = instance();
+    if (!state.enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(state.mutex);
+    cb::mcbp::Parser parser;
+    parser.feed(buffer);
+    cb::mcbp::FrameView frame;
+    try {
+        while (parser.next(frame)) {
+            if (frame.getMagic() != cb::mcbp::Magic::ClientRequest) {
+                // Not a request frame; we can't trust the length field
+                // so stop scanning.
+                return;
+            }
+
+            if (++state.seen % state.rate == 0) {
+                state.file.write(reinterpret_cast<const char*>(frame.header),
+                                 sizeof(cb::mcbp::Request));
+                for (const auto& segment : frame.body) {
+                    state.file.write(
+                            reinterpret_cast<const char*>(segment.data()),
+                            segment.size());
+                }
+                state.file.flush();
+            }
+        }
+    } catch (const std::runtime_error&) {
+        // Illegal magic: garbage which the validators will reject; we
+        // can't trust the length fields so stop scanning.
+    }
+    // Any partial trailing frame is read by the packet completion path,
+    // not another spool, so it simply isn't sampled.
+}
@@ -0,0 +1,45 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Sampled capture of the binary protocol workload.
+ *
+ * When enabled (by pointing the MEMCACHED_MCBP_CAPTURE environment variable
+ * at a file, with an optional ",<rate>" suffix to set the sampling rate;
+ * the default is every 100th frame) the network read path feeds every
+ * complete request frame it spools to the capture, which appends every
+ * <rate>'th frame verbatim to the file. The resulting file is simply a
+ * concatenation of raw MCBP request frames and can be replayed through the
+ * validator path by mcbp_benchmark to measure front-end parsing cost with
+ * a representative opcode mix.
+ */
+#pragma once
+
+#include <platform/sized_buffer.h>
+
+/**
+ * @return true if workload capture is enabled for this process
+ */
+bool mcbp_capture_enabled();
+
+/**
+ * Scan the provided buffer (freshly spooled input, starting at a frame
+ * boundary) for complete request frames and append the sampled ones to
+ * the capture file. Frames with an unknown magic and trailing partial
+ * frames are ignored.
+ */
+void mcbp_capture_frames(cb::const_byte_buffer buffer);
@@ -17,6 +17,7 @@
 
 #include "mcbp_executors.h"
 
+#include "admission.h"
 #include "buckets.h"
 #include "config_parse.h"
 #include "connections.h"
@@ -81,9 +82,12 @@ void update_topkeys(const DocKey& key, McbpConnection* c) {
 
     if (topkey_commands[c->binary_header.request.opcode]) {
         if (all_buckets[c->getBucketIndex()].topkeys != nullptr) {
-            all_buckets[c->getBucketIndex()].topkeys->updateKey(key.data(),
-                                                                key.size(),
-                                                                mc_time_get_current_time());
+            const auto* thread = c->getThread();
+            all_buckets[c->getBucketIndex()].topkeys->updateKey(
+                    key.data(),
+                    key.size(),
+                    mc_time_get_current_time(),
+                    thread == nullptr ? 0 : thread->index);
         }
     }
 }
@@ -173,6 +177,10 @@ static void process_bin_unknown_packet(McbpConnection* c, void* packet) {
             // it is sending a success to the client.
             ++c->getBucket().responseCounters[PROTOCOL_BINARY_RESPONSE_SUCCESS];
             mcbp_write_and_free(c, &c->getDynamicBuffer());
+        } else if (c->isDirectResponseBuilt()) {
+            // The response was built directly in the message list
+            c->setState(McbpStateMachine::State::send_data);
+            c->setWriteAndGo(McbpStateMachine::State::new_cmd);
         } else {
             c->setState(McbpStateMachine::State::new_cmd);
         }
@@ -641,6 +649,11 @@ static void stat_executor(McbpConnection* c, void* packet) {
     c->obtainContext<StatsCommandContext>(*c, *req).drive();
 }
 
+static void stat_bulk_executor(McbpConnection* c, void* packet) {
+    auto* req = reinterpret_cast<protocol_binary_request_stats*>(packet);
+    c->obtainContext<StatsBulkCommandContext>(*c, *req).drive();
+}
+
 static void isasl_refresh_executor(McbpConnection* c, void* packet) {
     c->obtainContext<SaslRefreshCommandContext>(*c).drive();
 }
@@ -1026,6 +1039,7 @@ std::array<mcbp_package_execute, 0x100>& get_mcbp_executors(void) {
     executors[PROTOCOL_BINARY_CMD_DELETE] = delete_executor;
     executors[PROTOCOL_BINARY_CMD_DELETEQ] = delete_executor;
     executors[PROTOCOL_BINARY_CMD_STAT] = stat_executor;
+    executors[PROTOCOL_BINARY_CMD_STAT_BULK] = stat_bulk_executor;
     executors[PROTOCOL_BINARY_CMD_INCREMENT] = arithmetic_executor;
     executors[PROTOCOL_BINARY_CMD_INCREMENTQ] = arithmeticq_executor;
     executors[PROTOCOL_BINARY_CMD_DECREMENT] = arithmetic_executor;
@@ -1082,6 +1096,15 @@ std::array<mcbp_package_execute, 0x100>& get_mcbp_executors(void) {
     executors[PROTOCOL_BINARY_CMD_TAP_CHECKPOINT_START] = no_support_executor;
     executors[PROTOCOL_BINARY_CMD_TAP_CHECKPOINT_END] = no_support_executor;
 
+    // Fill the remaining slots with the unknown command handler so that
+    // the dispatch may call the executor unconditionally (instead of
+    // testing for null on the hot path)
+    for (auto& executor : executors) {
+        if (executor == nullptr) {
+            executor = process_bin_unknown_packet;
+        }
+    }
+
     return executors;
 }
 
@@ -1169,7 +1192,17 @@ static void execute_request_packet(McbpConnection* c) {
     auto opcode = static_cast<protocol_binary_command>(c->binary_header.request.opcode);
     auto executor = executors[opcode];
 
-    const auto res = privilegeChains.invoke(opcode, c->getCookieObject());
+    // The verdict of the privilege chain only depends on the opcode
+    // and the connection's privilege context, so consult the
+    // per-connection cache before walking the chain. Stale verdicts
+    // are never cached (they trigger a rebuild of the context).
+    cb::rbac::PrivilegeAccess res;
+    if (!c->lookupPrivilegeVerdict(opcode, res)) {
+        res = privilegeChains.invoke(opcode, c->getCookieObject());
+        if (res != cb::rbac::PrivilegeAccess::Stale) {
+            c->cachePrivilegeVerdict(opcode, res);
+        }
+    }
     switch (res) {
     case cb::rbac::PrivilegeAccess::Fail:
         LOG_WARNING(c,
@@ -1203,11 +1236,27 @@ static void execute_request_packet(McbpConnection* c) {
             return;
         }
 
-        if (executor != NULL) {
-            executor(c, packet);
-        } else {
-            process_bin_unknown_packet(c, packet);
+        switch (admission_request(c)) {
+        case AdmissionVerdict::Admit:
+            break;
+        case AdmissionVerdict::Queue:
+            // The admission class is at its concurrency limit; park
+            // the connection (it is notified when a slot frees up and
+            // the command re-enters here)
+            c->setEwouldblock(true);
+            return;
+        case AdmissionVerdict::Reject:
+            if (c->remapErrorCode(ENGINE_TMPFAIL) == ENGINE_DISCONNECT) {
+                c->setState(McbpStateMachine::State::closing);
+            } else {
+                mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_ETMPFAIL);
+            }
+            return;
         }
+
+        // Every slot in the executor table is populated (unhandled
+        // opcodes point at process_bin_unknown_packet)
+        executor(c, packet);
         return;
     case cb::rbac::PrivilegeAccess::Stale:
         if (c->remapErrorCode(ENGINE_AUTH_STALE) == ENGINE_DISCONNECT) {
@@ -1260,7 +1309,8 @@ static cb::mcbp::Status validate_packet_execusion_constraints(
      * Protect ourself from someone trying to kill us by sending insanely
      * large packets.
      */
-    if (c->binary_header.request.bodylen > settings.getMaxPacketSize()) {
+    if (c->binary_header.request.bodylen >
+        settings.getDataPathSnapshot().getMaxPacketSize()) {
         c->getCookieObject().setErrorContext("Packet is too big");
         return cb::mcbp::Status::Einval;
     }
@@ -1292,12 +1342,44 @@ void try_read_mcbp_command(McbpConnection* c) {
                 std::to_string(c->read->rsize()) + " of " +
                 std::to_string(sizeof(cb::mcbp::Request)) + ")");
     }
+    // Pre-validate the fixed header invariants for the entire spooled
+    // pipeline in one pass instead of discovering a broken header when
+    // we eventually parse our way to it packet by packet.
+    if (c->getPrevalidatedPackets() > 0) {
+        c->setPrevalidatedPackets(c->getPrevalidatedPackets() - 1);
+    } else {
+        bool invalid = false;
+        const auto num = mcbp_prevalidate_headers(input, invalid);
+        if (num == 0 && invalid) {
+            LOG_WARNING(c,
+                        "%u: Invalid packet header received, closing "
+                        "connection",
+                        c->getId());
+            c->setState(McbpStateMachine::State::closing);
+            return;
+        }
+        c->setPrevalidatedPackets(num > 0 ? num - 1 : 0);
+    }
+
+    if (c->hasBlockedCommands() && input.data()[0] == PROTOCOL_BINARY_REQ &&
+        !McbpConnection::isReorderSafe(input.data()[1])) {
+        // The next command isn't safe to reorder past the blocked ones;
+        // leave it in the input pipe and wait for the window to drain
+        c->setState(McbpStateMachine::State::waiting);
+        return;
+    }
+
+    // If this is an eligible command on a connection with unordered
+    // execution negotiated, run it on its own cookie so it may be
+    // parked should the engine block
+    c->selectCookieForCommand(input.data()[0], input.data()[1]);
+
     auto& cookie = c->getCookieObject();
     cookie.setPacket(
             Cookie::PacketContent::Header,
             cb::const_byte_buffer{input.data(), sizeof(cb::mcbp::Request)});
 
-    if (settings.getVerbose() > 1) {
+    if (settings.getDataPathSnapshot().getVerbose() > 1) {
         /* Dump the packet before we convert it to host order */
         char buffer[1024];
         ssize_t nw;
@@ -1366,6 +1448,7 @@ void try_read_mcbp_command(McbpConnection* c) {
                          cb::const_byte_buffer{
                                  input.data(),
                                  sizeof(cb::mcbp::Request) + req.getBodylen()});
+        c->maybeCopyBlockedCommandPacket();
         c->setState(McbpStateMachine::State::execute);
     } else {
         // we need to allocate more memory!!
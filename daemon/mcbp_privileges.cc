@@ -72,6 +72,7 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
     setup(PROTOCOL_BINARY_CMD_NOOP, empty);
     setup(PROTOCOL_BINARY_CMD_VERSION, empty);
     setup(PROTOCOL_BINARY_CMD_STAT, require<Privilege::SimpleStats>);
+    setup(PROTOCOL_BINARY_CMD_STAT_BULK, require<Privilege::SimpleStats>);
     setup(PROTOCOL_BINARY_CMD_VERBOSITY, require<Privilege::NodeManagement>);
     setup(PROTOCOL_BINARY_CMD_TOUCH, require<Privilege::Upsert>);
     setup(PROTOCOL_BINARY_CMD_GAT, require<Privilege::Read>);
@@ -180,6 +181,8 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
     setup(PROTOCOL_BINARY_CMD_ADDQ_WITH_META, require<Privilege::MetaWrite>);
     setup(PROTOCOL_BINARY_CMD_SNAPSHOT_VB_STATES, require<Privilege::MetaWrite>);
     setup(PROTOCOL_BINARY_CMD_VBUCKET_BATCH_COUNT, require<Privilege::MetaWrite>);
+    setup(PROTOCOL_BINARY_CMD_MULTI_SET_WITH_META,
+          require<Privilege::MetaWrite>);
     setup(PROTOCOL_BINARY_CMD_DEL_WITH_META, require<Privilege::MetaWrite>);
     setup(PROTOCOL_BINARY_CMD_DELQ_WITH_META, require<Privilege::MetaWrite>);
 
@@ -221,6 +224,7 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
     setup(PROTOCOL_BINARY_CMD_GET_CLUSTER_CONFIG, empty);
 
     setup(PROTOCOL_BINARY_CMD_GET_RANDOM_KEY, require<Privilege::Read>);
+    setup(PROTOCOL_BINARY_CMD_MULTI_GET, require<Privilege::Read>);
     /**
      * Command to wait for the dcp sequence number persistence
      */
@@ -17,6 +17,7 @@
 
 #include "config.h"
 #include "mcbp_validators.h"
+#include <mcbp/protocol/request.h>
 #include <memcached/protocol_binary.h>
 #include <include/memcached/protocol_binary.h>
 
@@ -1279,6 +1280,34 @@ static protocol_binary_response_status collections_set_manifest_validator(
     return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+size_t mcbp_prevalidate_headers(cb::const_byte_buffer buffer, bool& invalid) {
+    size_t num = 0;
+    size_t offset = 0;
+    invalid = false;
+
+    while (offset + sizeof(cb::mcbp::Request) <= buffer.size()) {
+        const auto& req = *reinterpret_cast<const cb::mcbp::Request*>(
+                buffer.data() + offset);
+
+        if (req.magic != uint8_t(PROTOCOL_BINARY_REQ) &&
+            req.magic != uint8_t(PROTOCOL_BINARY_RES)) {
+            invalid = true;
+            break;
+        }
+
+        const auto bodylen = req.getBodylen();
+        if (size_t(req.extlen) + req.getKeylen() > bodylen) {
+            invalid = true;
+            break;
+        }
+
+        ++num;
+        offset += sizeof(cb::mcbp::Request) + bodylen;
+    }
+
+    return num;
+}
+
 void McbpValidatorChains::initializeMcbpValidatorChains(McbpValidatorChains& chains) {
     chains.push_unique(PROTOCOL_BINARY_CMD_DCP_OPEN, dcp_open_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_DCP_ADD_STREAM, dcp_add_stream_validator);
@@ -1319,6 +1348,7 @@ void McbpValidatorChains::initializeMcbpValidatorChains(McbpValidatorChains& cha
     chains.push_unique(PROTOCOL_BINARY_CMD_DELETE, delete_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_DELETEQ, delete_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_STAT, stat_validator);
+    chains.push_unique(PROTOCOL_BINARY_CMD_STAT_BULK, stat_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_INCREMENT, arithmetic_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_INCREMENTQ, arithmetic_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_DECREMENT, arithmetic_validator);
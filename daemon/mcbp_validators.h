@@ -63,4 +63,20 @@ private:
     std::array<FunctionChain<protocol_binary_response_status,
                              PROTOCOL_BINARY_RESPONSE_SUCCESS,
                              const Cookie&>, 0x100> commandChains;
-};
\ No newline at end of file
+};
+
+/**
+ * Check the fixed 24 byte header invariants (magic and length field
+ * consistency) for all of the packets currently spooled in the buffer
+ * in a single pass, before the opcode specific validators get to look
+ * at them one by one. This way a pipeline full of garbage is detected
+ * up front, and the headers are warm in the cache when they're parsed
+ * for real.
+ *
+ * @param buffer the spooled input to scan
+ * @param invalid set to true if a malformed header was found (the scan
+ *                stops at the first broken header)
+ * @return the number of packets (with at least a complete header) which
+ *         passed the check
+ */
+size_t mcbp_prevalidate_headers(cb::const_byte_buffer buffer, bool& invalid);
\ No newline at end of file
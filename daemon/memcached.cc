@@ -42,6 +42,7 @@
 #include "session_cas.h"
 #include "settings.h"
 #include "stats.h"
+#include "stats_shm.h"
 #include "subdocument.h"
 #include "timings.h"
 #include "topkeys.h"
@@ -75,6 +76,8 @@
 #include <engines/default_engine.h>
 #include <vector>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <cJSON_utils.h>
 
 // MB-14649: log crashing on windows..
@@ -547,9 +550,12 @@ static void settings_init(void) {
     settings.addInterface(default_interface);
 
     settings.setBioDrainBufferSize(8192);
+    settings.setReadaheadBufferSize(8192);
+    settings.setBufferPoolSize(32);
 
     settings.setVerbose(0);
     settings.setConnectionIdleTime(0); // Connection idle time disabled
+    settings.setConnectionParkTime(30); // Park buffers after 30s quiet
     settings.setNumWorkerThreads(get_number_of_worker_threads());
     settings.extensions.logger = get_stderr_logger();
     settings.setDatatypeJsonEnabled(false);
@@ -962,7 +968,24 @@ bool conn_listening(ListenConnection *c)
         return false;
     }
 
-    dispatch_conn_new(sfd, c->getParentPort());
+    auto* thread = c->getThread();
+    if (thread != nullptr) {
+        // This listener is owned by a worker thread (SO_REUSEPORT);
+        // set up the connection right here instead of bouncing it
+        // through the dispatcher thread.
+        if (conn_new(sfd, c->getParentPort(), thread->base, thread) ==
+            nullptr) {
+            LOG_WARNING(c, "Failed to dispatch event for socket %ld",
+                        long(sfd));
+            {
+                std::lock_guard<std::mutex> guard(stats_mutex);
+                --port_instance->curr_conns;
+            }
+            safe_close(sfd);
+        }
+    } else {
+        dispatch_conn_new(sfd, c->getParentPort());
+    }
 
     return false;
 }
@@ -1023,6 +1046,7 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
      * callback for the worker thread is executed.
      */
     thr->pending_io = list_remove(thr->pending_io, c);
+    c->setEnlistedInPendingIo(false);
 
     /* sanity */
     cb_assert(fd == c->getSocketDescriptor());
@@ -1082,6 +1106,13 @@ void listen_event_handler(evutil_socket_t, short which, void *arg) {
     }
 
     if (memcached_shutdown) {
+        if (c->getThread() != nullptr) {
+            // This listener lives on a worker thread's event base; the
+            // worker handles its own shutdown (after draining clients),
+            // so just stop accepting new connections.
+            c->disable();
+            return;
+        }
         // Someone requested memcached to shut down. The listen thread should
         // be stopped immediately.
         LOG_NOTICE(NULL, "Stopping listen thread");
@@ -1213,6 +1244,18 @@ static SOCKET new_server_socket(struct addrinfo *ai, bool tcp_nodelay) {
 #endif
 
     setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, flags_ptr, sizeof(flags));
+#ifdef SO_REUSEPORT
+    /*
+     * Allow multiple listening sockets to bind to the same port so that
+     * each worker thread may own its own socket for the interface and
+     * accept connections without funneling through a single accept path.
+     */
+    error = setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, flags_ptr,
+                       sizeof(flags));
+    if (error != 0) {
+        LOG_WARNING(NULL, "setsockopt(SO_REUSEPORT): %s", strerror(errno));
+    }
+#endif
     error = setsockopt(sfd, SOL_SOCKET, SO_KEEPALIVE, flags_ptr,
                        sizeof(flags));
     if (error != 0) {
@@ -1289,6 +1332,84 @@ static void add_listening_port(const struct interface *interf, in_port_t port, s
     }
 }
 
+#ifdef SO_REUSEPORT
+/**
+ * Create an additional listening socket per worker thread, bound to the
+ * same address as the "main" listener (which is possible as all of the
+ * sockets are created with SO_REUSEPORT), and registered on the worker
+ * thread's own event base. The kernel spreads incoming connections over
+ * all of the sockets bound to the port, and connections accepted on a
+ * worker-owned socket are set up directly on that thread without
+ * bouncing through the dispatcher thread.
+ *
+ * Failures are not fatal; we fall back to just using the main listener.
+ *
+ * @param interf the interface description used to create the port
+ * @param ai the resolved address the main listener was bound to
+ * @param listenport the (resolved) port number in use
+ */
+static void create_worker_listeners(const struct interface* interf,
+                                    struct addrinfo* ai,
+                                    in_port_t listenport) {
+    // If the interface was configured with an ephemeral port we must
+    // bind the port number the main listener ended up with
+    union {
+        struct sockaddr_storage storage;
+        struct sockaddr_in in;
+        struct sockaddr_in6 in6;
+    } addr = {};
+    memcpy(&addr, ai->ai_addr, ai->ai_addrlen);
+    if (addr.storage.ss_family == AF_INET) {
+        addr.in.sin_port = htons(listenport);
+    } else if (addr.storage.ss_family == AF_INET6) {
+        addr.in6.sin6_port = htons(listenport);
+    }
+
+    for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        SOCKET sfd = new_server_socket(ai, interf->tcp_nodelay);
+        if (sfd == INVALID_SOCKET) {
+            LOG_WARNING(NULL,
+                        "Failed to create worker listener socket for port %u",
+                        listenport);
+            return;
+        }
+
+        if (bind(sfd,
+                 reinterpret_cast<struct sockaddr*>(&addr),
+                 (socklen_t)ai->ai_addrlen) == SOCKET_ERROR) {
+            log_errcode_error(EXTENSION_LOG_WARNING,
+                              nullptr,
+                              "Failed to bind worker listener: %s",
+                              GetLastNetworkError());
+            safe_close(sfd);
+            return;
+        }
+
+        auto* thread = get_worker_thread(ii);
+        auto* lconn = conn_new_server(sfd,
+                                      listenport,
+                                      addr.storage.ss_family,
+                                      *interf,
+                                      thread->base);
+        if (lconn == nullptr) {
+            LOG_WARNING(NULL,
+                        "Failed to create worker listen connection for "
+                        "port %u",
+                        listenport);
+            safe_close(sfd);
+            return;
+        }
+        lconn->setThread(thread);
+        lconn->setNext(listen_conn);
+        listen_conn = lconn;
+
+        stats.daemon_conns++;
+        stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+        add_listening_port(interf, listenport, addr.storage.ss_family);
+    }
+}
+#endif
+
 /**
  * Create a socket and bind it to a specific port number
  * @param interface the interface to bind to
@@ -1386,6 +1507,10 @@ static int server_socket(const struct interface *interf) {
         stats.daemon_conns++;
         stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
         add_listening_port(interf, listenport, next->ai_addr->sa_family);
+
+#ifdef SO_REUSEPORT
+        create_worker_listeners(interf, next, listenport);
+#endif
     }
 
     freeaddrinfo(ai);
@@ -1449,6 +1574,11 @@ static void create_listen_sockets(bool management) {
                                            " illegal objects: " +
                                        to_string(c->toJSON(), false));
             }
+            if (lc->getThread() != nullptr) {
+                // Don't report the per-worker-thread listeners; they
+                // are duplicates of the main listener for the port
+                continue;
+            }
             cJSON_AddItemToArray(array.get(), lc->getDetails().release());
         }
 
@@ -2159,6 +2289,106 @@ void notify_thread_bucket_deletion(LIBEVENT_THREAD *me) {
     }
 }
 
+/**
+ * The BucketCleanupQueue decouples the expensive part of bucket deletion
+ * (tearing down the engine instance with all of its hashtables, checkpoints
+ * and on-disk files) from the management operation itself. Once all clients
+ * are disconnected the bucket slot is released so that the name may be
+ * reused immediately, and the engine handle is passed over to a dedicated
+ * cleanup thread which performs the final destroy in the background.
+ *
+ * During shutdown we must wait for the queue to drain before unloading the
+ * engine shared objects (the destroy callback lives inside them).
+ */
+class BucketCleanupQueue {
+public:
+    /**
+     * Hand over an engine instance for background destruction.
+     *
+     * @param name the name of the bucket (used for logging only; the
+     *             bucket slot no longer owns the name at this point)
+     * @param engine the engine handle to destroy
+     * @param force whether to skip flushing dirty items to disk
+     * @return true if the engine was queued, false if the cleanup thread
+     *         could not be created (the caller must destroy it inline)
+     */
+    bool schedule(const std::string& name,
+                  ENGINE_HANDLE_V1* engine,
+                  bool force) {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!running) {
+            cb_thread_t tid;
+            int err = cb_create_named_thread(&tid, worker_main, this, 1,
+                                             "mc:bucket_del");
+            if (err != 0) {
+                LOG_WARNING(nullptr,
+                            "Failed to create bucket cleanup thread: %s",
+                            strerror(err));
+                return false;
+            }
+            running = true;
+        }
+        queue.emplace_back(Entry{name, engine, force});
+        ++outstanding;
+        cond.notify_one();
+        return true;
+    }
+
+    /**
+     * Block until all queued engine instances have been destroyed.
+     */
+    void waitForCompletion() {
+        std::unique_lock<std::mutex> guard(mutex);
+        drained.wait(guard, [this] { return outstanding == 0; });
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        ENGINE_HANDLE_V1* engine;
+        bool force;
+    };
+
+    static void worker_main(void* arg) {
+        static_cast<BucketCleanupQueue*>(arg)->run();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(mutex);
+        while (true) {
+            cond.wait(guard, [this] { return !queue.empty(); });
+            Entry entry = queue.front();
+            queue.pop_front();
+            guard.unlock();
+
+            LOG_NOTICE(nullptr,
+                       "Delete bucket [%s]. Shutting down the bucket in the "
+                       "background", entry.name.c_str());
+            entry.engine->destroy(v1_handle_2_handle(entry.engine),
+                                  entry.force);
+            LOG_NOTICE(nullptr, "Delete bucket [%s]. Background shutdown "
+                       "complete", entry.name.c_str());
+
+            guard.lock();
+            --outstanding;
+            drained.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    /** Signalled when work is added to the queue */
+    std::condition_variable cond;
+    /** Signalled when an engine instance has been destroyed */
+    std::condition_variable drained;
+    std::deque<Entry> queue;
+    /** True once the (detached) cleanup thread has been created */
+    bool running = false;
+    /** Number of engine instances queued but not yet destroyed */
+    size_t outstanding = 0;
+};
+
+static BucketCleanupQueue bucket_cleanup_queue;
+
 void DestroyBucketThread::destroy() {
     ENGINE_ERROR_CODE ret = ENGINE_KEY_ENOENT;
     std::unique_lock<std::mutex> all_bucket_lock(buckets_lock);
@@ -2258,14 +2488,18 @@ void DestroyBucketThread::destroy() {
      * BucketState != Ready.  See associate_bucket() for more details.
      */
 
-    LOG_NOTICE(connection, "%s Delete bucket [%s]. Shut down the bucket",
-               connection_id.c_str(), name.c_str());
-
-    bucket.engine->destroy(v1_handle_2_handle(bucket.engine), force);
-
     LOG_NOTICE(connection, "%s Delete bucket [%s]. Clean up allocated resources ",
                connection_id.c_str(), name.c_str());
 
+    /*
+     * Release the bucket slot before tearing down the engine instance so
+     * that the bucket name becomes available for reuse immediately. The
+     * engine destruction (which may involve releasing gigabytes of memory
+     * and deleting the on-disk files) is handed over to the background
+     * cleanup queue.
+     */
+    auto* engine_handle = bucket.engine;
+
     /* Clean up the stats... */
     threadlocal_stats_reset(bucket.stats);
 
@@ -2286,6 +2520,13 @@ void DestroyBucketThread::destroy() {
     // don't need lock because all timing data uses atomics
     bucket.timings.reset();
 
+    if (!bucket_cleanup_queue.schedule(name, engine_handle, force)) {
+        /* Could not spawn the cleanup thread; destroy inline instead */
+        LOG_NOTICE(connection, "%s Delete bucket [%s]. Shut down the bucket",
+                   connection_id.c_str(), name.c_str());
+        engine_handle->destroy(v1_handle_2_handle(engine_handle), force);
+    }
+
     LOG_NOTICE(connection, "%s Delete bucket [%s] complete",
                connection_id.c_str(), name.c_str());
     result = ENGINE_SUCCESS;
@@ -2349,6 +2590,13 @@ static void cleanup_buckets(void) {
             delete bucket.topkeys;
         }
     }
+
+    /*
+     * Wait for the background cleanup queue to drain before we return;
+     * the engine shared objects are about to be unloaded and the destroy
+     * callbacks live inside them.
+     */
+    bucket_cleanup_queue.waitForCompletion();
 }
 
 void delete_all_buckets() {
@@ -2788,6 +3036,10 @@ extern "C" int memcached_main(int argc, char **argv) {
      */
     enable_shutdown();
 
+    /* Map the shared-memory stats export segment (if configured) so
+     * it is refreshed from the very first clock tick */
+    stats_shm_init();
+
     /* Initialise memcached time keeping */
     mc_time_init(main_base);
 
@@ -2839,6 +3091,9 @@ extern "C" int memcached_main(int argc, char **argv) {
     LOG_NOTICE(nullptr, "Shutting down executor pool");
     delete executorPool.release();
 
+    LOG_NOTICE(NULL, "Unmapping shared stats segment");
+    stats_shm_shutdown();
+
     LOG_NOTICE(NULL, "Releasing signal handlers");
     release_signal_handlers();
 
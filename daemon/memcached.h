@@ -2,6 +2,7 @@
 #ifndef MEMCACHED_H
 #define MEMCACHED_H
 
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <vector>
@@ -53,6 +54,18 @@
 #define IOV_LIST_HIGHWAT 50
 #define MSG_LIST_HIGHWAT 20
 
+/**
+ * Maximum number of response bytes to accumulate for a pipelined
+ * connection before flushing them to the socket in a single write
+ */
+#define BATCH_SEND_HIGHWAT 65536
+
+/**
+ * Response values of at least this size are sent as their own iovec
+ * entry instead of being copied into the dynamic buffer
+ */
+#define DIRECT_VALUE_MIN_SIZE 1024
+
 /* Maximum length of config which can be validated */
 #define CONFIG_VALIDATE_MAX_LENGTH (64 * 1024)
 
@@ -69,8 +82,11 @@ enum class ThreadType {
     DISPATCHER = 15
 };
 
+class BufferPool;
 class Connection;
 class ConnectionQueue;
+class OpTraceRing;
+class HotnessSampler;
 
 struct LIBEVENT_THREAD {
     cb_thread_t thread_id;      /* unique ID of this thread */
@@ -84,11 +100,23 @@ struct LIBEVENT_THREAD {
     int index;                  /* index of this thread in the threads array */
     ThreadType type;      /* Type of IO this thread processes */
 
-    /** Shared read buffer for all connections serviced by this thread. */
-    std::unique_ptr<cb::Pipe> read;
+    /**
+     * Pool of idle network buffers recycled across all connections
+     * serviced by this thread.
+     */
+    BufferPool* buffer_pool;
+
+    /**
+     * Ring of trace events for the most recent operations executed
+     * by this thread. See optrace.h.
+     */
+    OpTraceRing* optrace;
 
-    /** Shared write buffer for all connections serviced by this thread. */
-    std::unique_ptr<cb::Pipe> write;
+    /**
+     * Reservoir of sampled operations executed by this thread, used
+     * to rank keys/vbuckets/opcodes by load share. See hotness.h.
+     */
+    HotnessSampler* hotness;
 
     subdoc_OPERATION* subdoc_op; /** Shared sub-document operation for all
                                      connections serviced by this thread. */
@@ -105,6 +133,33 @@ struct LIBEVENT_THREAD {
     int deleting_buckets;
 
     JSON_checker::Validator *validator;
+
+    /**
+     * Number of client connections currently owned by this thread.
+     * Used (together with the activity rate below) by the dispatcher
+     * to place new connections on the least loaded worker.
+     */
+    std::atomic<int32_t> conn_count;
+
+    /**
+     * Cumulative number of event loop runs performed by this thread;
+     * a cheap proxy for how busy the thread is.
+     */
+    std::atomic<uint64_t> event_runs;
+
+    /**
+     * Event loop runs per second over the most recently measured
+     * window, refreshed by the owning thread (see refresh_run_rate()).
+     * Readers must treat a stale rate_time as "idle": a thread which
+     * hasn't refreshed its rate lately hasn't been running.
+     */
+    std::atomic<uint32_t> run_rate;
+
+    /** When run_rate was last refreshed (mc_time clock) */
+    std::atomic<rel_time_t> rate_time;
+
+    /** Owner-private snapshot of event_runs backing run_rate */
+    uint64_t runs_snapshot;
 };
 
 #define LOCK_THREAD(t) \
@@ -158,6 +213,14 @@ void threads_cleanup(void);
 
 void dispatch_conn_new(SOCKET sfd, int parent_port);
 
+/**
+ * Get the descriptor for one of the worker threads
+ *
+ * @param index the index of the worker thread [0, num worker threads)
+ * @throws std::out_of_range for an illegal index
+ */
+LIBEVENT_THREAD* get_worker_thread(int index);
+
 /* Lock wrappers for cache functions that are called from main loop. */
 int is_listen_thread(void);
 
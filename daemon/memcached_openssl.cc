@@ -20,12 +20,19 @@
 #include <memcached/openssl.h>
 #include <openssl/engine.h>
 #include <openssl/conf.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <ctime>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+
 static std::vector<std::mutex> openssl_lock_cs;
 
 static unsigned long get_thread_id() {
@@ -42,6 +49,204 @@ static void openssl_locking_callback(int mode, int type, const char *, int)
 }
 #endif
 
+/*
+ * TLS session resumption support.
+ *
+ * Session tickets are encrypted with a process-wide key so that the
+ * ticket a client received on one connection can be decrypted when it
+ * reconnects (on a brand new SSL_CTX). The key rotates periodically;
+ * the previous key is kept around so tickets issued just before a
+ * rotation still resume (the client gets a fresh ticket under the new
+ * key in that case).
+ */
+struct SslTicketKey {
+    uint8_t name[16];
+    uint8_t hmacKey[16];
+    uint8_t aesKey[16];
+    time_t created;
+};
+
+/// Rotate the encryption key used for new session tickets every hour
+static const time_t TicketKeyLifetime = 3600;
+
+static std::mutex ticket_key_mutex;
+static SslTicketKey ticket_keys[2]; // [0] is current, [1] is previous
+static int num_ticket_keys = 0;
+
+static bool generate_ticket_key(SslTicketKey& key) {
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+        RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) != 1 ||
+        RAND_bytes(key.aesKey, sizeof(key.aesKey)) != 1) {
+        return false;
+    }
+    key.created = time(nullptr);
+    return true;
+}
+
+/// The caller must hold ticket_key_mutex
+static void maybe_rotate_ticket_keys() {
+    if (num_ticket_keys == 0 ||
+        time(nullptr) - ticket_keys[0].created > TicketKeyLifetime) {
+        SslTicketKey fresh;
+        if (generate_ticket_key(fresh)) {
+            ticket_keys[1] = ticket_keys[0];
+            ticket_keys[0] = fresh;
+            num_ticket_keys = std::min(num_ticket_keys + 1, 2);
+        }
+    }
+}
+
+static int ssl_ticket_key_callback(SSL*,
+                                   unsigned char* key_name,
+                                   unsigned char* iv,
+                                   EVP_CIPHER_CTX* ctx,
+                                   HMAC_CTX* hctx,
+                                   int enc) {
+    std::lock_guard<std::mutex> guard(ticket_key_mutex);
+
+    if (enc) {
+        maybe_rotate_ticket_keys();
+        if (num_ticket_keys == 0) {
+            // We've got no key material (the RNG failed); don't issue
+            // a ticket, but let the handshake proceed.
+            return 0;
+        }
+        const auto& key = ticket_keys[0];
+        memcpy(key_name, key.name, sizeof(key.name));
+        if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+            EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr,
+                               key.aesKey, iv) != 1 ||
+            HMAC_Init_ex(hctx, key.hmacKey, sizeof(key.hmacKey),
+                         EVP_sha256(), nullptr) != 1) {
+            return -1;
+        }
+        return 1;
+    }
+
+    for (int ii = 0; ii < num_ticket_keys; ++ii) {
+        const auto& key = ticket_keys[ii];
+        if (memcmp(key_name, key.name, sizeof(key.name)) == 0) {
+            if (HMAC_Init_ex(hctx, key.hmacKey, sizeof(key.hmacKey),
+                             EVP_sha256(), nullptr) != 1 ||
+                EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr,
+                                   key.aesKey, iv) != 1) {
+                return -1;
+            }
+            // Tickets under the previous key are accepted, but the
+            // client is handed a fresh ticket under the current key.
+            return (ii == 0) ? 1 : 2;
+        }
+    }
+
+    // Unknown key (we rotated twice since the ticket was issued, or we
+    // restarted); fall back to a full handshake.
+    return 0;
+}
+
+/*
+ * Shared session (id) cache for clients which don't support session
+ * tickets. The sessions are stored in their DER encoding keyed by the
+ * session id, spread over a number of independently locked shards to
+ * keep the contention between worker threads down. OpenSSL validates
+ * the expiry time of a resurrected session (and calls the remove
+ * callback for expired ones) so we only need to bound the size: a
+ * shard which grows beyond its capacity is simply flushed.
+ */
+struct SslSessionCacheShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<uint8_t>> sessions;
+};
+
+static std::array<SslSessionCacheShard, 8> session_cache;
+static const size_t SessionCacheShardCapacity = 2048;
+
+/// Session ids are random, so the first byte spreads evenly
+static SslSessionCacheShard& get_session_cache_shard(
+        const unsigned char* id, unsigned int len) {
+    return session_cache[(len > 0 ? id[0] : 0) % session_cache.size()];
+}
+
+static int ssl_session_new_callback(SSL*, SSL_SESSION* session) {
+    unsigned int idlen;
+    const unsigned char* id = SSL_SESSION_get_id(session, &idlen);
+    if (idlen == 0) {
+        return 0;
+    }
+
+    const int size = i2d_SSL_SESSION(session, nullptr);
+    if (size <= 0) {
+        return 0;
+    }
+    std::vector<uint8_t> der(size);
+    auto* ptr = der.data();
+    i2d_SSL_SESSION(session, &ptr);
+
+    auto& shard = get_session_cache_shard(id, idlen);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (shard.sessions.size() >= SessionCacheShardCapacity) {
+        shard.sessions.clear();
+    }
+    shard.sessions[std::string(reinterpret_cast<const char*>(id), idlen)] =
+            std::move(der);
+
+    // We stored a copy; no need for OpenSSL to keep a reference
+    return 0;
+}
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static SSL_SESSION* ssl_session_get_callback(SSL*,
+                                             unsigned char* id,
+                                             int len,
+                                             int* copy) {
+#else
+static SSL_SESSION* ssl_session_get_callback(SSL*,
+                                             const unsigned char* id,
+                                             int len,
+                                             int* copy) {
+#endif
+    *copy = 0;
+
+    auto& shard = get_session_cache_shard(id, len);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto iter = shard.sessions.find(
+            std::string(reinterpret_cast<const char*>(id), len));
+    if (iter == shard.sessions.end()) {
+        return nullptr;
+    }
+
+    const unsigned char* ptr = iter->second.data();
+    return d2i_SSL_SESSION(nullptr, &ptr, iter->second.size());
+}
+
+static void ssl_session_remove_callback(SSL_CTX*, SSL_SESSION* session) {
+    unsigned int idlen;
+    const unsigned char* id = SSL_SESSION_get_id(session, &idlen);
+    if (idlen == 0) {
+        return;
+    }
+
+    auto& shard = get_session_cache_shard(id, idlen);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.sessions.erase(
+            std::string(reinterpret_cast<const char*>(id), idlen));
+}
+
+void ssl_configure_session_resumption(SSL_CTX* ctx) {
+    static const unsigned char session_id_context[] = "memcached";
+    SSL_CTX_set_session_id_context(ctx,
+                                   session_id_context,
+                                   sizeof(session_id_context) - 1);
+    // Use only our external cache; the internal per-SSL_CTX cache is
+    // useless (and would just burn memory) with a context per
+    // connection.
+    SSL_CTX_set_session_cache_mode(
+            ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(ctx, ssl_session_new_callback);
+    SSL_CTX_sess_set_get_cb(ctx, ssl_session_get_callback);
+    SSL_CTX_sess_set_remove_cb(ctx, ssl_session_remove_callback);
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ssl_ticket_key_callback);
+}
+
 void initialize_openssl() {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
     CRYPTO_malloc_init();
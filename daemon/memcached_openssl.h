@@ -16,5 +16,19 @@
  */
 #pragma once
 
+#include <memcached/openssl.h>
+
 void initialize_openssl();
 void shutdown_openssl();
+
+/**
+ * Enable TLS session resumption for the provided SSL_CTX.
+ *
+ * Each connection owns its own SSL_CTX, so resumption state has to live
+ * outside the context: this installs the process-wide session ticket
+ * key callback (stateless resumption; the keys rotate periodically) and
+ * hooks the context up to the shared (sharded) session cache used for
+ * clients which don't support session tickets. Reconnecting clients may
+ * then perform the abbreviated handshake instead of a full key exchange.
+ */
+void ssl_configure_session_resumption(SSL_CTX* ctx);
@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "optrace.h"
+
+#include "memcached.h"
+
+#include <cJSON_utils.h>
+
+#include <algorithm>
+
+void OpTraceRing::record(const OpTraceEvent& event) {
+    const auto idx = head.load(std::memory_order_relaxed);
+    events[idx % capacity] = event;
+    // Publish the slot after it has been fully written so that a
+    // reader which observes the new head also observes the event.
+    head.store(idx + 1, std::memory_order_release);
+}
+
+std::vector<OpTraceEvent> OpTraceRing::snapshot() const {
+    const auto end = head.load(std::memory_order_acquire);
+    const auto num = std::min(end, uint64_t(capacity));
+
+    std::vector<OpTraceEvent> ret;
+    ret.reserve(num);
+    for (uint64_t idx = end - num; idx < end; ++idx) {
+        ret.push_back(events[idx % capacity]);
+    }
+    return ret;
+}
+
+static void addEventToArray(cJSON* array, const OpTraceEvent& event) {
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "conn", event.connection_id);
+    cJSON_AddNumberToObject(obj, "opcode", event.opcode);
+    cJSON_AddNumberToObject(obj, "start_ns", double(event.start_ns));
+    cJSON_AddNumberToObject(obj, "execute_ns", event.execute_ns);
+    cJSON_AddNumberToObject(obj, "notify_ns", event.notify_ns);
+    cJSON_AddNumberToObject(obj, "total_ns", event.total_ns);
+    cJSON_AddItemToArray(array, obj);
+}
+
+ENGINE_ERROR_CODE ioctlGetOpTraceDump(Connection*,
+                                      const StrToStrMap& arguments,
+                                      std::string& value) {
+    int first = 0;
+    int last = settings.getNumWorkerThreads();
+
+    auto thread_arg = arguments.find("thread");
+    if (thread_arg != arguments.end()) {
+        try {
+            first = std::stoi(thread_arg->second);
+        } catch (const std::exception&) {
+            return ENGINE_EINVAL;
+        }
+        if (first < 0 || first >= last) {
+            return ENGINE_EINVAL;
+        }
+        last = first + 1;
+    }
+
+    std::vector<OpTraceEvent> merged;
+    for (int ii = first; ii < last; ++ii) {
+        auto* thread = get_worker_thread(ii);
+        if (thread != nullptr && thread->optrace != nullptr) {
+            auto events = thread->optrace->snapshot();
+            merged.insert(merged.end(), events.begin(), events.end());
+        }
+    }
+
+    std::sort(merged.begin(),
+              merged.end(),
+              [](const OpTraceEvent& a, const OpTraceEvent& b) {
+                  return a.start_ns < b.start_ns;
+              });
+
+    unique_cJSON_ptr json(cJSON_CreateObject());
+    if (!json) {
+        return ENGINE_ENOMEM;
+    }
+    cJSON* array = cJSON_CreateArray();
+    for (const auto& event : merged) {
+        addEventToArray(array, event);
+    }
+    cJSON_AddItemToObject(json.get(), "events", array);
+
+    char* ptr = cJSON_PrintUnformatted(json.get());
+    if (ptr == nullptr) {
+        return ENGINE_ENOMEM;
+    }
+    value.assign(ptr);
+    cJSON_Free(ptr);
+
+    return ENGINE_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/types.h>
+
+#include "utilities/string_utilities.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Connection;
+
+/**
+ * Always-on operation tracing.
+ *
+ * Unlike the phosphor-based tracing in tracing.h (which has to be
+ * armed, captures everything and is too heavy to leave running in
+ * production), this module records a single fixed-size event per
+ * completed command into a per-worker-thread ring buffer. The cost on
+ * the op path is one struct store, so it is always enabled and the
+ * most recent operations can be inspected after the fact - e.g. to
+ * see where inside the daemon the time went for the commands behind a
+ * latency spike which is long gone by the time anyone looks.
+ *
+ * The rings are dumped through "ioctl_get optrace.dump".
+ */
+
+/**
+ * A single traced operation. The timestamps within the command are
+ * stored as nanosecond offsets from the start of the command to keep
+ * the record small.
+ */
+struct OpTraceEvent {
+    /// When the command was received (parsed off the network);
+    /// nanoseconds since the epoch of ProcessClock
+    uint64_t start_ns;
+    /// Offset from start when execution of the command began
+    uint32_t execute_ns;
+    /// Offset from start when the engine completed a blocked command
+    /// (io notification); 0 if the command never blocked
+    uint32_t notify_ns;
+    /// Offset from start when the response was ready to transmit
+    uint32_t total_ns;
+    /// The id of the connection the command arrived on
+    uint32_t connection_id;
+    /// The opcode of the command
+    uint8_t opcode;
+};
+
+/**
+ * A fixed-size ring of trace events owned by a single worker thread.
+ *
+ * Only the owning thread writes to the ring; readers (the ioctl
+ * handler running on some other worker thread) may take a snapshot at
+ * any time without stopping the writer. The snapshot is intentionally
+ * lock free and lossy: a record which is being overwritten while the
+ * snapshot copies it may be torn, and the writer never waits. For a
+ * diagnostic facility that is an acceptable trade for having zero
+ * synchronization on the op path.
+ */
+class OpTraceRing {
+public:
+    /// The number of events each worker thread keeps
+    static const size_t capacity = 2048;
+
+    /**
+     * Append an event to the ring, overwriting the oldest entry when
+     * full. May only be called by the owning thread.
+     */
+    void record(const OpTraceEvent& event);
+
+    /**
+     * Copy out the current content of the ring, ordered from oldest
+     * to newest. Safe to call from any thread.
+     */
+    std::vector<OpTraceEvent> snapshot() const;
+
+private:
+    std::array<OpTraceEvent, capacity> events;
+
+    // Total number of events ever recorded; the next slot to write is
+    // (head % capacity). Published with release ordering after the
+    // slot is written.
+    std::atomic<uint64_t> head{0};
+};
+
+/**
+ * IOCTL Get callback to dump the operation trace rings as JSON.
+ * @param arguments an optional 'thread' argument limits the dump to
+ *        the given worker thread's ring
+ * @param[out] value JSON object with an "events" array ordered by
+ *        command start time
+ */
+ENGINE_ERROR_CODE ioctlGetOpTraceDump(Connection* c,
+                                      const StrToStrMap& arguments,
+                                      std::string& value);
@@ -16,6 +16,7 @@
  */
 #include "appendprepend_context.h"
 #include "engine_wrapper.h"
+#include <daemon/datatype.h>
 #include "../../mcbp.h"
 #include <xattr/blob.h>
 #include <xattr/utils.h>
@@ -94,9 +95,10 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::getItem() {
             return ENGINE_LOCKED;
         }
 
-        if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
+        if (Datatype::isCompressed(oldItemInfo.datatype)) {
             try {
-                if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                if (!cb::compression::inflate(Datatype::toAlgorithm(
+                                                      oldItemInfo.datatype),
                                               (const char*)oldItemInfo.value[0].iov_base,
                                               oldItemInfo.value[0].iov_len,
                                               buffer)) {
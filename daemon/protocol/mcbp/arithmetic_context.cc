@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 #include "arithmetic_context.h"
+#include <daemon/datatype.h>
 #include <daemon/mc_time.h>
 #include <xattr/blob.h>
 #include <xattr/utils.h>
@@ -36,10 +37,10 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::getItem() {
             return ENGINE_KEY_EEXISTS;
         }
 
-        if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
+        if (Datatype::isCompressed(oldItemInfo.datatype)) {
             try {
                 if (!cb::compression::inflate(
-                    cb::compression::Algorithm::Snappy,
+                    Datatype::toAlgorithm(oldItemInfo.datatype),
                     (const char*)oldItemInfo.value[0].iov_base,
                     oldItemInfo.value[0].iov_len,
                     buffer)) {
@@ -40,22 +40,36 @@ void get_cluster_config_executor(McbpConnection* c, void*) {
         return;
     }
 
-    auto pair = c->getBucket().clusterConfiguration.getConfiguration();
-    if (pair.first == -1) {
+    auto config = c->getBucket().clusterConfiguration.getConfiguration();
+    if (config->revision == -1) {
         mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT);
     } else {
-        mcbp_response_handler(nullptr,
-                              0,
-                              nullptr,
-                              0,
-                              pair.second->data(),
-                              uint32_t(pair.second->size()),
-                              PROTOCOL_BINARY_RAW_BYTES,
-                              PROTOCOL_BINARY_RESPONSE_SUCCESS,
-                              0,
-                              c->getCookie());
-        mcbp_write_and_free(c, &c->getDynamicBuffer());
-        c->setClustermapRevno(pair.first);
+        // The snapshot is shared with every other connection fetching
+        // this revision; send the pre-deflated variant if the client
+        // negotiated snappy, and reference the payload from the message
+        // rather than formatting a copy into the dynamic buffer.
+        const std::string* payload = &config->uncompressed;
+        uint8_t datatype = PROTOCOL_BINARY_RAW_BYTES;
+        if (c->isSnappyEnabled() && !config->compressed.empty()) {
+            payload = &config->compressed;
+            datatype = PROTOCOL_BINARY_DATATYPE_SNAPPY;
+        }
+
+        mcbp_add_header(c,
+                        PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                        0,
+                        0,
+                        uint32_t(payload->size()),
+                        datatype);
+        c->addIov(payload->data(), payload->size());
+        if (!c->pinSharedBuffer(
+                    std::shared_ptr<const std::string>(config, payload))) {
+            c->setState(McbpStateMachine::State::closing);
+            return;
+        }
+        c->setState(McbpStateMachine::State::send_data);
+        c->setWriteAndGo(McbpStateMachine::State::new_cmd);
+        c->setClustermapRevno(config->revision);
     }
 }
 
@@ -95,7 +109,7 @@ void set_cluster_config_executor(McbpConnection* c, void* packet) {
         mcbp_write_packet(c, cb::mcbp::Status::Success);
 
         const long revision =
-                bucket.clusterConfiguration.getConfiguration().first;
+                bucket.clusterConfiguration.getConfiguration()->revision;
 
         LOG_NOTICE(c,
                    "%u: %s Updated cluster configuration for bucket [%s]. New "
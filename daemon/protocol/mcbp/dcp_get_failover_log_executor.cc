@@ -38,6 +38,10 @@ void dcp_get_failover_log_executor(McbpConnection* c, void* packet) {
     case ENGINE_SUCCESS:
         if (c->getDynamicBuffer().getRoot() != nullptr) {
             mcbp_write_and_free(c, &c->getDynamicBuffer());
+        } else if (c->isDirectResponseBuilt()) {
+            // The response was built directly in the message list
+            c->setState(McbpStateMachine::State::send_data);
+            c->setWriteAndGo(McbpStateMachine::State::new_cmd);
         } else {
             mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_SUCCESS);
         }
@@ -56,14 +56,13 @@ ENGINE_ERROR_CODE GetCommandContext::getItem() {
 
 ENGINE_ERROR_CODE GetCommandContext::inflateItem() {
     try {
-        if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
-                                      payload.buf, payload.len, buffer)) {
+        if (!mcbp_inflate_snappy(connection, payload, buffer)) {
             LOG_WARNING(&connection, "%u: Failed to inflate item",
                         connection.getId());
             return ENGINE_FAILED;
         }
-        payload.buf = buffer.data.get();
-        payload.len = buffer.len;
+        payload.buf = buffer.data();
+        payload.len = buffer.size();
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -16,7 +16,7 @@
  */
 #pragma once
 
-#include <platform/compress.h>
+#include "../../buffer_pool.h"
 #include "../../memcached.h"
 #include "steppable_command_context.h"
 
@@ -129,6 +129,6 @@ private:
     item_info info;
 
     cb::const_char_buffer payload;
-    cb::compression::Buffer buffer;
+    ScratchBuffer buffer;
     State state;
 };
@@ -16,8 +16,8 @@
  */
 #pragma once
 
-#include <platform/compress.h>
 #include <include/memcached/protocol_binary.h>
+#include "daemon/buffer_pool.h"
 #include "daemon/memcached.h"
 #include "steppable_command_context.h"
 
@@ -126,6 +126,6 @@ private:
     item_info info;
 
     cb::const_char_buffer payload;
-    cb::compression::Buffer buffer;
+    ScratchBuffer buffer;
     State state;
 };
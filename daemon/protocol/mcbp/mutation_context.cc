@@ -97,12 +97,32 @@ ENGINE_ERROR_CODE MutationCommandContext::step() {
     return ret;
 }
 
+/**
+ * A JSON document can only start with one of a small set of characters,
+ * so look at the first non-whitespace byte before handing the value to
+ * the full validator. This rejects binary payloads (and most non-JSON
+ * text) by inspecting a single byte instead of scanning the entire
+ * value.
+ */
+static bool may_be_json(const cb::const_char_buffer& value) {
+    for (size_t ii = 0; ii < value.len; ++ii) {
+        const auto ch = value.buf[ii];
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+            continue;
+        }
+        return ch == '{' || ch == '[' || ch == '"' || ch == '-' ||
+               ch == 't' || ch == 'f' || ch == 'n' ||
+               (ch >= '0' && ch <= '9');
+    }
+    return false;
+}
+
 ENGINE_ERROR_CODE MutationCommandContext::validateInput() {
     if (!connection.isDatatypeEnabled(datatype)) {
         return ENGINE_EINVAL;
     }
 
-    if (!connection.isJsonEnabled()) {
+    if (!connection.isJsonEnabled() && may_be_json(value)) {
         auto* validator = connection.getThread()->validator;
         try {
             auto* ptr = reinterpret_cast<const uint8_t*>(value.buf);
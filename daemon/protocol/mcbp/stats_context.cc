@@ -20,11 +20,17 @@
 #include "stats_context.h"
 #include "utilities.h"
 
+#include <cJSON_utils.h>
+#include <daemon/admission.h>
+#include <daemon/buffer_pool.h>
+#include <daemon/stats_tasks.h>
 #include <daemon/connections.h>
 #include <daemon/debug_helpers.h>
+#include <daemon/hotness.h>
 #include <daemon/mc_time.h>
 #include <daemon/mcbp.h>
 #include <daemon/runtime.h>
+#include <daemon/slowops.h>
 #include <memcached/audit_interface.h>
 #include <phosphor/stats_callback.h>
 #include <phosphor/trace_log.h>
@@ -216,6 +222,65 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  add_stat_callback,
                  "wbufs_existing",
                  thread_stats.wbufs_existing);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "conns_parked",
+                 thread_stats.conns_parked);
+
+        // Aggregate the network buffer pool stats over the worker threads
+        uint64_t bufpool_cached = 0;
+        uint64_t bufpool_recycled = 0;
+        uint64_t bufpool_discarded = 0;
+        uint64_t bufpool_segments_cached = 0;
+        uint64_t bufpool_segments_recycled = 0;
+        uint64_t bufpool_segments_discarded = 0;
+        uint64_t bufpool_scratch_cached = 0;
+        uint64_t bufpool_scratch_recycled = 0;
+        uint64_t bufpool_scratch_discarded = 0;
+        for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+            auto* pool = get_worker_thread(ii)->buffer_pool;
+            if (pool != nullptr) {
+                bufpool_cached += pool->getCached();
+                bufpool_recycled += pool->getRecycled();
+                bufpool_discarded += pool->getDiscarded();
+                bufpool_segments_cached += pool->getCachedSegments();
+                bufpool_segments_recycled += pool->getRecycledSegments();
+                bufpool_segments_discarded += pool->getDiscardedSegments();
+                bufpool_scratch_cached += pool->getCachedScratch();
+                bufpool_scratch_recycled += pool->getRecycledScratch();
+                bufpool_scratch_discarded += pool->getDiscardedScratch();
+            }
+        }
+        add_stat(cookie, add_stat_callback, "bufpool_cached", bufpool_cached);
+        add_stat(cookie, add_stat_callback, "bufpool_recycled",
+                 bufpool_recycled);
+        add_stat(cookie, add_stat_callback, "bufpool_discarded",
+                 bufpool_discarded);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_segments_cached",
+                 bufpool_segments_cached);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_segments_recycled",
+                 bufpool_segments_recycled);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_segments_discarded",
+                 bufpool_segments_discarded);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_scratch_cached",
+                 bufpool_scratch_cached);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_scratch_recycled",
+                 bufpool_scratch_recycled);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "bufpool_scratch_discarded",
+                 bufpool_scratch_discarded);
+
         add_stat(cookie, add_stat_callback, "iovused_high_watermark",
                  thread_stats.iovused_high_watermark);
         add_stat(cookie, add_stat_callback, "msgused_high_watermark",
@@ -329,6 +394,8 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
              settings.getRequestsPerEventNotification(EventPriority::Low));
     add_stat(cookie, add_stat_callback, "reqs_per_event_def_priority",
              settings.getRequestsPerEventNotification(EventPriority::Default));
+    add_stat(cookie, add_stat_callback, "default_bytes_per_event",
+             settings.getBytesPerEventNotification());
     add_stat(cookie, add_stat_callback, "auth_enabled_sasl", "yes");
     add_stat(cookie, add_stat_callback, "auth_sasl_engine", "cbsasl");
 
@@ -359,6 +426,8 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
 
     add_stat(cookie, add_stat_callback, "connection_idle_time",
              std::to_string(settings.getConnectionIdleTime()).c_str());
+    add_stat(cookie, add_stat_callback, "connection_park_time",
+             std::to_string(settings.getConnectionParkTime()).c_str());
     add_stat(cookie,
              add_stat_callback,
              "datatype_json",
@@ -434,13 +503,33 @@ static void append_stats(const char* key, const uint16_t klen,
     append_bin_stats(key, klen, val, vlen, &cookie->getConnection());
 }
 
+/**
+ * Bulk variant of append_stats used by the STAT_BULK command. Instead of
+ * writing one response packet per stat it accumulates length-prefixed
+ * records in the command context, which are sent as a single response
+ * once the entire group has been collected.
+ */
+static void append_stats_bulk(const char* key, const uint16_t klen,
+                              const char* val, const uint32_t vlen,
+                              const void* void_cookie) {
+    auto* cookie = reinterpret_cast<const Cookie*>(void_cookie);
+    auto* context = dynamic_cast<StatsBulkCommandContext*>(
+            cookie->getConnection().getCommandContext());
+    if (context == nullptr) {
+        throw std::logic_error("append_stats_bulk: the connection's command "
+                               "context is not a StatsBulkCommandContext");
+    }
+    context->append(key, klen, val, vlen);
+}
 
 /**
  * This is a very slow thing that you shouldn't use in production ;-)
  *
  * @param c the connection to return the details for
+ * @param add_stat_callback the callback to use to add the statistic
  */
-static void process_bucket_details(McbpConnection* c) {
+static void process_bucket_details(McbpConnection* c,
+                                   ADD_STAT add_stat_callback) {
     cJSON* obj = cJSON_CreateObject();
 
     cJSON* array = cJSON_CreateArray();
@@ -453,8 +542,8 @@ static void process_bucket_details(McbpConnection* c) {
     cJSON_AddItemToObject(obj, "buckets", array);
 
     char* stats_str = cJSON_PrintUnformatted(obj);
-    append_stats("bucket details", 14, stats_str, uint32_t(strlen(stats_str)),
-                 c->getCookie());
+    add_stat_callback("bucket details", 14, stats_str,
+                      uint32_t(strlen(stats_str)), c->getCookie());
     cJSON_Free(stats_str);
     cJSON_Delete(obj);
 }
@@ -477,12 +566,14 @@ static void process_bucket_details(McbpConnection* c) {
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_reset_executor(const std::string& arg,
-                                             McbpConnection& connection) {
+                                             McbpConnection& connection,
+                                             ADD_STAT add_stat_callback) {
     if (arg.empty()) {
         stats_reset(connection.getCookie());
         bucket_reset_stats(&connection);
         all_buckets[0].timings.reset();
         all_buckets[connection.getBucketIndex()].timings.reset();
+        all_buckets[connection.getBucketIndex()].vbucket_timings.reset();
         return ENGINE_SUCCESS;
     } else if (arg == "timings") {
         // Nuke the command timings section for the connected bucket
@@ -501,14 +592,15 @@ static ENGINE_ERROR_CODE stat_reset_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
-                                             McbpConnection& connection) {
+                                             McbpConnection& connection,
+                                             ADD_STAT add_stat_callback) {
 
     if (arg.empty()) {
         for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
             auto hist = scheduler_info[ii].to_string();
             std::string key = std::to_string(ii);
-            append_stats(key.data(), key.size(), hist.data(), hist.size(),
-                         connection.getCookie());
+            add_stat_callback(key.data(), key.size(), hist.data(), hist.size(),
+                              connection.getCookie());
         }
         return ENGINE_SUCCESS;
     } else if (arg == "aggregate") {
@@ -519,8 +611,8 @@ static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
         }
         // Add the stat
         auto hist = histogram.to_string();
-        append_stats(key.data(), key.size(), hist.data(), hist.size(),
-                     connection.getCookie());
+        add_stat_callback(key.data(), key.size(), hist.data(), hist.size(),
+                          connection.getCookie());
         return ENGINE_SUCCESS;
     } else {
         return ENGINE_EINVAL;
@@ -535,10 +627,11 @@ static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_settings_executor(const std::string& arg,
-                                                McbpConnection& connection) {
+                                                McbpConnection& connection,
+                                                ADD_STAT add_stat_callback) {
 
     if (arg.empty()) {
-        process_stat_settings(&append_stats, &connection);
+        process_stat_settings(add_stat_callback, &connection);
         return ENGINE_SUCCESS;
     } else {
         return ENGINE_EINVAL;
@@ -553,10 +646,11 @@ static ENGINE_ERROR_CODE stat_settings_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_audit_executor(const std::string& arg,
-                                             McbpConnection& connection) {
+                                             McbpConnection& connection,
+                                             ADD_STAT add_stat_callback) {
     if (arg.empty()) {
         process_auditd_stats(get_audit_handle(),
-                             &append_stats,
+                             add_stat_callback,
                              const_cast<void*>(connection.getCookie()));
         return ENGINE_SUCCESS;
     } else {
@@ -573,9 +667,10 @@ static ENGINE_ERROR_CODE stat_audit_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_bucket_details_executor(const std::string& arg,
-                                                      McbpConnection& connection) {
+                                                      McbpConnection& connection,
+                                                      ADD_STAT add_stat_callback) {
     if (arg.empty()) {
-        process_bucket_details(&connection);
+        process_bucket_details(&connection, add_stat_callback);
         return ENGINE_SUCCESS;
     } else {
         return ENGINE_EINVAL;
@@ -590,9 +685,10 @@ static ENGINE_ERROR_CODE stat_bucket_details_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_aggregate_executor(const std::string& arg,
-                                                 McbpConnection& connection) {
+                                                 McbpConnection& connection,
+                                                 ADD_STAT add_stat_callback) {
     if (arg.empty()) {
-        return server_stats(&append_stats, &connection);
+        return server_stats(add_stat_callback, &connection);
     } else {
         return ENGINE_EINVAL;
     }
@@ -607,7 +703,8 @@ static ENGINE_ERROR_CODE stat_aggregate_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_connections_executor(const std::string& arg,
-                                                   McbpConnection& connection) {
+                                                   McbpConnection& connection,
+                                                   ADD_STAT add_stat_callback) {
     int64_t fd = -1;
 
     if (!arg.empty()) {
@@ -618,7 +715,7 @@ static ENGINE_ERROR_CODE stat_connections_executor(const std::string& arg,
         }
     }
 
-    connection_stats(&append_stats, connection.getCookie(), fd);
+    connection_stats(add_stat_callback, connection.getCookie(), fd);
     return ENGINE_SUCCESS;
 }
 
@@ -630,7 +727,8 @@ static ENGINE_ERROR_CODE stat_connections_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_topkeys_executor(const std::string& arg,
-                                               McbpConnection& connection) {
+                                               McbpConnection& connection,
+                                               ADD_STAT add_stat_callback) {
     if (arg.empty()) {
         auto& bucket = all_buckets[connection.getBucketIndex()];
         if (bucket.topkeys == nullptr) {
@@ -638,7 +736,7 @@ static ENGINE_ERROR_CODE stat_topkeys_executor(const std::string& arg,
         }
         return bucket.topkeys->stats(connection.getCookie(),
                                      mc_time_get_current_time(),
-                                     append_stats);
+                                     add_stat_callback);
     } else {
         return ENGINE_EINVAL;
     }
@@ -652,7 +750,8 @@ static ENGINE_ERROR_CODE stat_topkeys_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_topkeys_json_executor(const std::string& arg,
-                                                    McbpConnection& connection) {
+                                                    McbpConnection& connection,
+                                                    ADD_STAT add_stat_callback) {
     if (arg.empty()) {
         ENGINE_ERROR_CODE ret;
 
@@ -671,9 +770,10 @@ static ENGINE_ERROR_CODE stat_topkeys_json_executor(const std::string& arg,
                 char key[] = "topkeys_json";
                 char* topkeys_str = cJSON_PrintUnformatted(topkeys_doc);
                 if (topkeys_str != nullptr) {
-                    append_stats(key, (uint16_t)strlen(key),
-                                 topkeys_str, (uint32_t)strlen(topkeys_str),
-                                 connection.getCookie());
+                    add_stat_callback(key, (uint16_t)strlen(key),
+                                      topkeys_str,
+                                      (uint32_t)strlen(topkeys_str),
+                                      connection.getCookie());
                     cJSON_Free(topkeys_str);
                 } else {
                     ret = ENGINE_ENOMEM;
@@ -687,6 +787,144 @@ static ENGINE_ERROR_CODE stat_topkeys_json_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats slow_ops</code> command used to retrieve
+ * a JSON document containing the most recently captured slow operations
+ * for the attached bucket (commands which exceeded their SLA threshold;
+ * see slowops.h).
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_slow_ops_executor(const std::string& arg,
+                                                McbpConnection& connection,
+                                                ADD_STAT add_stat_callback) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    auto& bucket = all_buckets[connection.getBucketIndex()];
+    unique_cJSON_ptr doc(cJSON_CreateObject());
+    if (doc.get() == nullptr) {
+        return ENGINE_ENOMEM;
+    }
+
+    cJSON* ops = cJSON_CreateArray();
+    for (const auto& event : bucket.slowops.snapshot()) {
+        cJSON* obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "conn", event.connection_id);
+        cJSON_AddNumberToObject(obj, "opcode", event.opcode);
+        cJSON_AddNumberToObject(obj, "vbucket", event.vbucket);
+        cJSON_AddNumberToObject(obj, "key_hash", event.key_hash);
+        cJSON_AddNumberToObject(obj, "start_ns", double(event.start_ns));
+        cJSON_AddNumberToObject(obj, "execute_ns", event.execute_ns);
+        cJSON_AddNumberToObject(obj, "notify_ns", event.notify_ns);
+        cJSON_AddNumberToObject(obj, "total_ns", event.total_ns);
+        cJSON_AddItemToArray(ops, obj);
+    }
+    cJSON_AddItemToObject(doc.get(), "slow_ops", ops);
+
+    static const std::string key = {"slow_ops"};
+    const auto stats_str = to_string(doc, false);
+    add_stat_callback(key.data(), key.size(), stats_str.data(),
+                      stats_str.size(), connection.getCookie());
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats hotness</code> command used to get the
+ * sampled ranking of keys, vbuckets and opcodes by load share.
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_hotness_executor(const std::string& arg,
+                                               McbpConnection& connection,
+                                               ADD_STAT add_stat_callback) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    auto doc = hotness_report();
+    if (doc.get() == nullptr) {
+        return ENGINE_ENOMEM;
+    }
+
+    static const std::string key = {"hotness"};
+    const auto stats_str = to_string(doc, false);
+    add_stat_callback(key.data(), key.size(), stats_str.data(),
+                      stats_str.size(), connection.getCookie());
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats admission</code> command used to get the
+ * per-class counters from the request admission control (admission.h).
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_admission_executor(const std::string& arg,
+                                                 McbpConnection& connection,
+                                                 ADD_STAT add_stat_callback) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto* cookie = connection.getCookie();
+    for (const auto& entry :
+         {std::make_pair("heavy", AdmissionClass::Heavy),
+          std::make_pair("management", AdmissionClass::Management)}) {
+        const auto stats = admission_get_stats(entry.second);
+        const std::string prefix(entry.first);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":admitted").c_str(), stats.admitted);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":queued").c_str(), stats.queued);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":rejected").c_str(), stats.rejected);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":in_flight").c_str(), stats.in_flight);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":limit").c_str(), stats.limit);
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":queue_depth").c_str(),
+                 uint64_t(stats.queue_depth));
+        add_stat(cookie, add_stat_callback,
+                 (prefix + ":max_queue").c_str(), uint64_t(stats.max_queue));
+    }
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats vbucket_timings</code> command used to get
+ * the per-vbucket latency heatmap of the connected bucket
+ * (vbucket_timings.h).
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_vbucket_timings_executor(
+        const std::string& arg,
+        McbpConnection& connection,
+        ADD_STAT add_stat_callback) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    auto& bucket = all_buckets[connection.getBucketIndex()];
+    auto doc = bucket.vbucket_timings.report();
+    if (doc.get() == nullptr) {
+        return ENGINE_ENOMEM;
+    }
+
+    static const std::string key = {"vbucket_timings"};
+    const auto stats_str = to_string(doc, false);
+    add_stat_callback(key.data(), key.size(), stats_str.data(),
+                      stats_str.size(), connection.getCookie());
+    return ENGINE_SUCCESS;
+}
+
 /**
  * Handler for the <code>stats subdoc_execute</code> command used to retrieve
  * information from the subdoc subsystem.
@@ -695,7 +933,8 @@ static ENGINE_ERROR_CODE stat_topkeys_json_executor(const std::string& arg,
  * @param connection the connection that requested the operation
  */
 static ENGINE_ERROR_CODE stat_subdoc_execute_executor(const std::string& arg,
-                                                      McbpConnection& connection) {
+                                                      McbpConnection& connection,
+                                                      ADD_STAT add_stat_callback) {
     if (arg.empty()) {
         const auto index = connection.getBucketIndex();
         std::string json_str;
@@ -711,8 +950,8 @@ static ENGINE_ERROR_CODE stat_subdoc_execute_executor(const std::string& arg,
             auto& bucket = all_buckets[connection.getBucketIndex()];
             json_str = bucket.subjson_operation_times.to_string();
         }
-        append_stats(nullptr, 0, json_str.c_str(), json_str.size(),
-                     connection.getCookie());
+        add_stat_callback(nullptr, 0, json_str.c_str(), json_str.size(),
+                          connection.getCookie());
         return ENGINE_SUCCESS;
     } else {
         return ENGINE_EINVAL;
@@ -720,7 +959,9 @@ static ENGINE_ERROR_CODE stat_subdoc_execute_executor(const std::string& arg,
 }
 
 static ENGINE_ERROR_CODE stat_responses_json_executor(
-        const std::string& arg, McbpConnection& connection) {
+        const std::string& arg,
+        McbpConnection& connection,
+        ADD_STAT add_stat_callback) {
     try {
         auto& respCounters = connection.getBucket().responseCounters;
         unique_cJSON_ptr jsonPtr(cJSON_CreateObject());
@@ -736,11 +977,11 @@ static ENGINE_ERROR_CODE stat_responses_json_executor(
         std::string json_str(ptr);
         cJSON_Free(ptr);
         const std::string stat_name = "responses";
-        append_stats(stat_name.c_str(),
-                     stat_name.size(),
-                     json_str.c_str(),
-                     json_str.size(),
-                     connection.getCookie());
+        add_stat_callback(stat_name.c_str(),
+                          stat_name.size(),
+                          json_str.c_str(),
+                          json_str.size(),
+                          connection.getCookie());
         return ENGINE_SUCCESS;
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
@@ -748,64 +989,67 @@ static ENGINE_ERROR_CODE stat_responses_json_executor(
 }
 
 static ENGINE_ERROR_CODE stat_tracing_executor(const std::string& arg,
-                                               McbpConnection& connection) {
+                                               McbpConnection& connection,
+                                               ADD_STAT add_stat_callback) {
     class MemcachedCallback : public phosphor::StatsCallback {
     public:
-        MemcachedCallback(McbpConnection& connection) : c(connection) {
+        MemcachedCallback(McbpConnection& connection, ADD_STAT callback)
+            : c(connection), add_stat_callback(callback) {
         }
 
         void operator()(gsl_p::cstring_span key,
                         gsl_p::cstring_span value) override {
-            append_stats(key.data(),
-                         key.size(),
-                         value.data(),
-                         value.size(),
-                         c.getCookie());
+            add_stat_callback(key.data(),
+                              key.size(),
+                              value.data(),
+                              value.size(),
+                              c.getCookie());
         }
 
         void operator()(gsl_p::cstring_span key, bool value) override {
             const auto svalue = value ? "true"_ccb : "false"_ccb;
-            append_stats(key.data(),
-                         key.size(),
-                         svalue.data(),
-                         svalue.size(),
-                         c.getCookie());
+            add_stat_callback(key.data(),
+                              key.size(),
+                              svalue.data(),
+                              svalue.size(),
+                              c.getCookie());
         }
 
         void operator()(gsl_p::cstring_span key, size_t value) override {
             const auto svalue = std::to_string(value);
-            append_stats(key.data(),
-                         key.size(),
-                         svalue.data(),
-                         svalue.size(),
-                         c.getCookie());
+            add_stat_callback(key.data(),
+                              key.size(),
+                              svalue.data(),
+                              svalue.size(),
+                              c.getCookie());
         }
 
         void operator()(gsl_p::cstring_span key,
                         phosphor::ssize_t value) override {
             const auto svalue = std::to_string(value);
-            append_stats(key.data(),
-                         key.size(),
-                         svalue.data(),
-                         svalue.size(),
-                         c.getCookie());
+            add_stat_callback(key.data(),
+                              key.size(),
+                              svalue.data(),
+                              svalue.size(),
+                              c.getCookie());
         }
 
         void operator()(gsl_p::cstring_span key, double value) override {
             const auto svalue = std::to_string(value);
-            append_stats(key.data(),
-                         key.size(),
-                         svalue.data(),
-                         svalue.size(),
-                         c.getCookie());
+            add_stat_callback(key.data(),
+                              key.size(),
+                              svalue.data(),
+                              svalue.size(),
+                              c.getCookie());
         }
 
     private:
         McbpConnection& c;
+        ADD_STAT add_stat_callback;
     };
 
     if (arg.empty()) {
-        MemcachedCallback cb{connection};
+        MemcachedCallback cb{connection, add_stat_callback};
         phosphor::TraceLog::getInstance().getStats(cb);
         return ENGINE_SUCCESS;
     } else {
@@ -813,7 +1057,62 @@ static ENGINE_ERROR_CODE stat_tracing_executor(const std::string& arg,
     }
 }
 
-ENGINE_ERROR_CODE StatsCommandContext::step() {
+/**
+ * Helper method to call into the engine API with the appropriate
+ * parameters.
+ *
+ * @param conn the connection performing the stat request
+ * @param k The key to pass on to the underlying engine
+ * @param add_stat_callback the callback to use to add the statistics
+ * @return the return code from the engine
+ */
+static ENGINE_ERROR_CODE engine_get_stats(McbpConnection& conn,
+                                          const cb::const_char_buffer& k,
+                                          ADD_STAT add_stat_callback) {
+    if (k.empty()) {
+        // Some backeds rely on key being nullptr if klen = 0
+        return conn.getBucketEngine()->get_stats(conn.getBucketEngineAsV0(),
+                                                 conn.getCookie(),
+                                                 nullptr, 0,
+                                                 add_stat_callback);
+    } else {
+        return conn.getBucketEngine()->get_stats(conn.getBucketEngineAsV0(),
+                                                 conn.getCookie(),
+                                                 k.data(),
+                                                 int(k.size()),
+                                                 add_stat_callback);
+
+    }
+}
+
+/**
+ * Should this stat group be collected by the executor pool instead of
+ * on the libevent worker thread? These groups walk every vbucket (or
+ * the entire hash table) in the underlying engine and may take long
+ * enough that a monitoring scrape would add visible latency to every
+ * other connection bound to the same worker thread.
+ *
+ * ("checkpoint" is not listed; the engine offloads that group to its
+ * own task pool already.)
+ */
+static bool is_heavy_stat_group(const cb::const_byte_buffer& key) {
+    const std::string statkey{reinterpret_cast<const char*>(key.data()),
+                              key.size()};
+    const auto command = statkey.substr(0, statkey.find(' '));
+
+    return command == "hash" || command == "vbucket" ||
+           command == "vbucket-details" || command == "vbucket-seqno" ||
+           command == "dcp" || command == "dcpagg";
+}
+
+/*
+ * Shared by the STAT and STAT_BULK commands, which only differ in how
+ * the individual stats are framed on the wire (see the header for the
+ * full documentation).
+ */
+ENGINE_ERROR_CODE process_stat_request(const cb::const_byte_buffer& key,
+                                       McbpConnection& connection,
+                                       ADD_STAT add_stat_callback) {
     struct stat_handler {
         /**
          * Is this a privileged stat or may it be requested by anyone
@@ -823,7 +1122,8 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
          * The callback function to handle the stat request
          */
         ENGINE_ERROR_CODE (*handler)(const std::string &arg,
-                                     McbpConnection& connection);
+                                     McbpConnection& connection,
+                                     ADD_STAT add_stat_callback);
     };
 
     /**
@@ -840,6 +1140,10 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
             {"connections", {false, stat_connections_executor}},
             {"topkeys", {false, stat_topkeys_executor}},
             {"topkeys_json", {false, stat_topkeys_json_executor}},
+            {"slow_ops", {false, stat_slow_ops_executor}},
+            {"vbucket_timings", {false, stat_vbucket_timings_executor}},
+            {"hotness", {false, stat_hotness_executor}},
+            {"admission", {false, stat_admission_executor}},
             {"subdoc_execute", {false, stat_subdoc_execute_executor}},
             {"responses", {false, stat_responses_json_executor}},
             {"tracing", {true, stat_tracing_executor}}};
@@ -848,9 +1152,12 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
 
     if (key.empty()) {
         /* request all statistics */
-        ret = get_stats({reinterpret_cast<const char*>(key.data()), key.size()});
+        ret = engine_get_stats(connection,
+                               {reinterpret_cast<const char*>(key.data()),
+                                key.size()},
+                               add_stat_callback);
         if (ret == ENGINE_SUCCESS) {
-            ret = server_stats(&append_stats, &connection);
+            ret = server_stats(add_stat_callback, &connection);
         }
     } else {
         // The raw representing the key
@@ -872,8 +1179,10 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
         auto iter = handlers.find(command);
         if (iter == handlers.end()) {
             // This may be specific to the underlying engine
-            ret = get_stats({reinterpret_cast<const char*>(key.data()),
-                             key.size()});
+            ret = engine_get_stats(connection,
+                                   {reinterpret_cast<const char*>(key.data()),
+                                    key.size()},
+                                   add_stat_callback);
         } else {
             if (iter->second.privileged) {
                 ret = mcbp::checkPrivilege(connection,
@@ -881,11 +1190,64 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
             }
 
             if (ret == ENGINE_SUCCESS) {
-                ret = iter->second.handler(argument, connection);
+                ret = iter->second.handler(argument, connection,
+                                           add_stat_callback);
             }
         }
     }
 
+    return ret;
+}
+
+/**
+ * Bump the response counter for an unsuccessful stat request (the
+ * responses we don't send back aren't counted at all)
+ */
+static void update_stat_error_counter(McbpConnection& connection,
+                                      ENGINE_ERROR_CODE ret) {
+    switch (ret) {
+    case ENGINE_DISCONNECT:
+    case ENGINE_EWOULDBLOCK:
+    case ENGINE_WANT_MORE:
+        // We don't send these responses back so we will not store
+        // stats for these.
+        break;
+    default:
+        ++connection.getBucket()
+                  .responseCounters[engine_error_2_mcbp_protocol_error(ret)];
+        break;
+    }
+}
+
+ENGINE_ERROR_CODE StatsCommandContext::step() {
+    ENGINE_ERROR_CODE ret;
+
+    if (task) {
+        // The executor pool collected the group while this connection
+        // was blocked; pick up the result.
+        ret = reinterpret_cast<StatsTask*>(task.get())->getResult();
+        task.reset();
+        if (ret == ENGINE_EWOULDBLOCK) {
+            // The engine blocked inside the background collection and
+            // notified us itself; complete the request on this thread
+            // (the second pass is cheap - the engine hands over the
+            // data it gathered while we were blocked).
+            ret = process_stat_request(key, connection, &append_stats);
+        }
+    } else if (is_heavy_stat_group(key)) {
+        task = std::make_shared<StatsTask>(
+                connection.getCookieObject(),
+                connection,
+                std::string{reinterpret_cast<const char*>(key.data()),
+                            key.size()},
+                &append_stats);
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorPool->schedule(task, true);
+        return ENGINE_EWOULDBLOCK;
+    } else {
+        ret = process_stat_request(key, connection, &append_stats);
+    }
+
     if (ret == ENGINE_SUCCESS) {
         append_stats(nullptr, 0, nullptr, 0, connection.getCookie());
 
@@ -895,38 +1257,87 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
         mcbp_write_and_free(&connection, &connection.getDynamicBuffer());
 
     } else {
-        switch (ret) {
-        case ENGINE_DISCONNECT:
-        case ENGINE_EWOULDBLOCK:
-        case ENGINE_WANT_MORE:
-            // We don't send these responses back so we will not store
-            // stats for these.
-            break;
-        default:
-            ++connection.getBucket()
-                      .responseCounters[engine_error_2_mcbp_protocol_error(
-                              ret)];
-            break;
-        }
+        update_stat_error_counter(connection, ret);
     }
 
     return ret;
 }
 
-ENGINE_ERROR_CODE StatsCommandContext::get_stats(const cb::const_char_buffer& k) {
-    // Use a shorter name to avoid line wrapping..
-    auto& conn = connection;
-    if (k.empty()) {
-        // Some backeds rely on key being nullptr if klen = 0
-        return conn.getBucketEngine()->get_stats(conn.getBucketEngineAsV0(),
-                                                 conn.getCookie(),
-                                                 nullptr, 0, append_stats);
+void StatsBulkCommandContext::append(const char* k, uint16_t klen,
+                                     const char* v, uint32_t vlen) {
+    const uint16_t encoded_klen = htons(klen);
+    const uint32_t encoded_vlen = htonl(vlen);
+
+    body.append(reinterpret_cast<const char*>(&encoded_klen),
+                sizeof(encoded_klen));
+    if (klen > 0) {
+        body.append(k, klen);
+    }
+    body.append(reinterpret_cast<const char*>(&encoded_vlen),
+                sizeof(encoded_vlen));
+    if (vlen > 0) {
+        body.append(v, vlen);
+    }
+}
+
+ENGINE_ERROR_CODE StatsBulkCommandContext::step() {
+    ENGINE_ERROR_CODE ret;
+
+    if (task) {
+        // The executor pool collected the group (into our body buffer)
+        // while this connection was blocked; pick up the result.
+        ret = reinterpret_cast<StatsTask*>(task.get())->getResult();
+        task.reset();
+        if (ret == ENGINE_EWOULDBLOCK) {
+            // The engine blocked inside the background collection and
+            // notified us itself; regenerate the entire group on this
+            // thread (the second pass is cheap - the engine hands over
+            // the data it gathered while we were blocked).
+            body.clear();
+            ret = process_stat_request(key, connection, &append_stats_bulk);
+        }
+    } else if (is_heavy_stat_group(key)) {
+        task = std::make_shared<StatsTask>(
+                connection.getCookieObject(),
+                connection,
+                std::string{reinterpret_cast<const char*>(key.data()),
+                            key.size()},
+                &append_stats_bulk);
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorPool->schedule(task, true);
+        return ENGINE_EWOULDBLOCK;
     } else {
-        return conn.getBucketEngine()->get_stats(conn.getBucketEngineAsV0(),
-                                                 conn.getCookie(),
-                                                 k.data(),
-                                                 int(k.size()),
-                                                 append_stats);
+        // The engine may have returned EWOULDBLOCK halfway through the
+        // collection; the entire group is regenerated so throw away
+        // anything gathered by the previous invocation.
+        body.clear();
+        ret = process_stat_request(key, connection, &append_stats_bulk);
+    }
 
+    if (ret == ENGINE_SUCCESS) {
+        // mcbp_response_handler bumps the response counter and takes a
+        // copy of the body, so it is safe to let it go away with this
+        // context object.
+        if (mcbp_response_handler(nullptr, 0, nullptr, 0,
+                                  body.data(), uint32_t(body.size()),
+                                  PROTOCOL_BINARY_RAW_BYTES,
+                                  PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
+                                  connection.getCookie())) {
+            if (connection.getDynamicBuffer().getRoot() != nullptr) {
+                mcbp_write_and_free(&connection,
+                                    &connection.getDynamicBuffer());
+            } else {
+                // The response was built directly in the message list
+                connection.setState(McbpStateMachine::State::send_data);
+                connection.setWriteAndGo(McbpStateMachine::State::new_cmd);
+            }
+        } else {
+            ret = ENGINE_ENOMEM;
+            update_stat_error_counter(connection, ret);
+        }
+    } else {
+        update_stat_error_counter(connection, ret);
     }
+
+    return ret;
 }
@@ -19,8 +19,27 @@
 #include <memcached/protocol_binary.h>
 #include <platform/sized_buffer.h>
 
+#include <memory>
+
 #include "steppable_command_context.h"
 
+class Task;
+
+/**
+ * Look up the requested stat group and invoke its handler (or forward
+ * the request to the underlying engine), adding every stat through the
+ * provided callback. Exposed so that the StatsTask can run the
+ * collection of expensive groups from the executor pool.
+ *
+ * @param key the requested stat group (may contain a sub command)
+ * @param connection the connection performing the stat request
+ * @param add_stat_callback the callback to use to add the statistics
+ * @return ENGINE_SUCCESS if the group was collected successfully
+ */
+ENGINE_ERROR_CODE process_stat_request(const cb::const_byte_buffer& key,
+                                       McbpConnection& connection,
+                                       ADD_STAT add_stat_callback);
+
 /**
  * The StatsCommandContext is responsible for implementing all of the
  * various stats commands (including the sub commands).
@@ -50,16 +69,57 @@ protected:
 
 private:
     /**
-     * Helper method to call into the engine API with the appropriate
-     * parameters.
-     *
-     * @param k The key to pass on to the underlying engine
-     * @return the return code from the engine
+     * The key as specified in the input buffer (it may contain a sub command)
+     */
+    const cb::const_byte_buffer key;
+
+    /**
+     * Expensive stat groups are collected by the executor pool while
+     * the connection is blocked; set while such a collection is running
+     */
+    std::shared_ptr<Task> task;
+};
+
+/**
+ * The StatsBulkCommandContext implements the STAT_BULK command. It runs
+ * the exact same set of stat handlers as StatsCommandContext, but instead
+ * of sending one response packet per stat it accumulates all of them and
+ * returns the entire group as a single response whose body is a sequence
+ * of (uint16_t keylen, key, uint32_t vallen, value) records with the
+ * lengths in network byte order.
+ */
+class StatsBulkCommandContext : public SteppableCommandContext {
+public:
+    StatsBulkCommandContext(McbpConnection& c,
+                            const protocol_binary_request_stats& req)
+        : SteppableCommandContext(c),
+          key{req.bytes + sizeof(req.bytes) + req.message.header.request.extlen,
+              ntohs(req.message.header.request.keylen)} {
+    }
+
+    /**
+     * Append a single stat to the response body (called by the bulk
+     * variant of the stats callback)
      */
-    ENGINE_ERROR_CODE get_stats(const cb::const_char_buffer& k);
+    void append(const char* k, uint16_t klen, const char* v, uint32_t vlen);
 
+protected:
+    ENGINE_ERROR_CODE step() override;
+
+private:
     /**
      * The key as specified in the input buffer (it may contain a sub command)
      */
     const cb::const_byte_buffer key;
+
+    /**
+     * Expensive stat groups are collected by the executor pool while
+     * the connection is blocked; set while such a collection is running
+     */
+    std::shared_ptr<Task> task;
+
+    /**
+     * The accumulated response body
+     */
+    std::string body;
 };
@@ -15,55 +15,97 @@
  *   limitations under the License.
  */
 #include "session_cas.h"
+
 #include <stdexcept>
+#include <thread>
 
 SessionCas session_cas;
 
+/*
+ * The mutation/validation race is resolved Dekker-style with seq_cst
+ * operations on counter and epoch:
+ *
+ * - A mutator may only change value when no operation is registered
+ *   (counter == 0). It announces the update by bumping epoch to odd,
+ *   re-checks the counter for validators which slipped in after the
+ *   first check, stores the new value and bumps epoch back to even.
+ *
+ * - A validator registers by incrementing counter and then re-reading
+ *   epoch; if the epoch moved the verdict may have been reached against
+ *   a stale value, so it de-registers and re-validates.
+ *
+ * In the seq_cst total order either the mutator's counter re-check sees
+ * the validator's increment (mutation fails EBUSY), or the increment came
+ * later and the validator's epoch re-read sees the odd/advanced epoch
+ * (validation retries against the new value). Neither side can complete
+ * against the other's stale state.
+ */
+
 ENGINE_ERROR_CODE SessionCas::cas(uint64_t newValue, uint64_t casval,
                                   uint64_t& currentValue) {
-    ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
-    {
-        std::lock_guard<std::mutex> lock(mutex);
+    // Serialise mutators; validators don't take the mutex.
+    std::lock_guard<std::mutex> lock(mutex);
 
-        if (session_cas.counter > 0) {
-            ret = ENGINE_EBUSY;
-        } else {
-            if (casval == 0 || casval == value) {
-                value = newValue;
-            } else {
-                ret = ENGINE_KEY_EEXISTS;
-            }
-        }
-        currentValue = value;
+    if (counter.load(std::memory_order_seq_cst) != 0) {
+        currentValue = value.load(std::memory_order_seq_cst);
+        return ENGINE_EBUSY;
+    }
+
+    if (casval != 0 && casval != value.load(std::memory_order_seq_cst)) {
+        currentValue = value.load(std::memory_order_seq_cst);
+        return ENGINE_KEY_EEXISTS;
     }
 
-    return ret;
+    // Announce the update (epoch becomes odd).
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    // Re-check for validators which registered between the counter check
+    // and the epoch bump; they validated against the current value so the
+    // mutation must fail.
+    if (counter.load(std::memory_order_seq_cst) != 0) {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        currentValue = value.load(std::memory_order_seq_cst);
+        return ENGINE_EBUSY;
+    }
+
+    value.store(newValue, std::memory_order_seq_cst);
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    currentValue = newValue;
+    return ENGINE_SUCCESS;
 }
 
 uint64_t SessionCas::getCasValue() {
-    std::lock_guard<std::mutex> lock(mutex);
-    return value;
+    return value.load(std::memory_order_seq_cst);
 }
 
 void SessionCas::decrement_session_counter()  {
-    std::lock_guard<std::mutex> lock(mutex);
-    if (counter == 0) {
+    if (counter.fetch_sub(1, std::memory_order_seq_cst) == 0) {
+        counter.fetch_add(1, std::memory_order_seq_cst);
         throw std::logic_error("session counter can't be 0");
     }
-    --counter;
 }
 
 bool SessionCas::increment_session_counter(const uint64_t cas)  {
-    std::lock_guard<std::mutex> lock(mutex);
-    bool ret = true;
-    if (cas != 0) {
-        if (value != cas) {
-            ret = false;
-        } else {
-            counter++;
+    while (true) {
+        const uint64_t e = epoch.load(std::memory_order_seq_cst);
+        if (e & 1) {
+            // A token update is in progress; it is brief, wait it out.
+            std::this_thread::yield();
+            continue;
         }
-    } else {
-        counter++;
+
+        if (cas != 0 && value.load(std::memory_order_seq_cst) != cas) {
+            return false;
+        }
+
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        if (epoch.load(std::memory_order_seq_cst) == e) {
+            // No token update raced the validation; we are registered.
+            return true;
+        }
+
+        // A token update began after the value was examined, so the
+        // verdict may be stale: de-register and re-validate.
+        counter.fetch_sub(1, std::memory_order_seq_cst);
     }
-    return ret;
 }
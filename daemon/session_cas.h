@@ -16,18 +16,27 @@
  */
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 #include <memcached/types.h>
 
 /**
  * Structure to save ns_server's session cas token.
+ *
+ * The validation path (increment/decrement of the session counter) runs for
+ * every operation carrying a session cas (e.g. SET_WITH_META inflow) and is
+ * lock-free; it negotiates with the rare mutation path (ns_server setting
+ * a new token) via an epoch word which is odd whilst an update is in
+ * progress. Only the mutation path takes the mutex, and only to serialise
+ * concurrent mutators.
  */
 class SessionCas {
 public:
     SessionCas()
         : value(0xdeadbeef),
-          counter(0) {
+          counter(0),
+          epoch(0) {
         // empty
     }
 
@@ -73,7 +82,7 @@ private:
      * use <code>cas</code> to update (it may not be modified unless
      * counter == 0)
      */
-    uint64_t value;
+    std::atomic<uint64_t> value;
 
     /**
      * Whenever we need to perform a potentially long-lived operation
@@ -81,10 +90,19 @@ private:
      * change the CAS value until we're done (used to protect ourself from
      * race conditions)
      */
-    uint64_t counter;
+    std::atomic<uint64_t> counter;
+
+    /**
+     * Stamp of the value's generation; bumped to odd when a mutation of
+     * value begins and back to even when it completes. A validator which
+     * observes the epoch change whilst registering must back out and
+     * re-validate, its verdict may be against a stale value.
+     */
+    std::atomic<uint64_t> epoch;
 
     /**
-     * All members in the class is protected with this mutex
+     * Serialises mutators (the cas method); the validation path does not
+     * take this mutex.
      */
     std::mutex mutex;
 };
@@ -21,6 +21,7 @@
 #include <platform/strerror.h>
 
 #include <algorithm>
+#include <cinttypes>
 #include <cstring>
 #include <fstream>
 #include <system_error>
@@ -42,18 +43,22 @@ Settings settings;
 Settings::Settings()
     : num_threads(0),
       bio_drain_buffer_sz(0),
+      readahead_buffer_sz(0),
+      buffer_pool_size(0),
       datatype_json(false),
       datatype_snappy(false),
       reqs_per_event_high_priority(0),
       reqs_per_event_med_priority(0),
       reqs_per_event_low_priority(0),
       default_reqs_per_event(00),
+      default_bytes_per_event(0),
       max_packet_size(0),
       topkeys_size(0),
       maxconns(0) {
 
     verbose.store(0);
     connection_idle_time.reset();
+    connection_park_time.reset();
     dedupe_nmvb_maps.store(false);
     xattr_enabled.store(false);
     privilege_debug.store(false);
@@ -61,6 +66,29 @@ Settings::Settings()
 
     memset(&has, 0, sizeof(has));
     memset(&extensions, 0, sizeof(extensions));
+
+    publishDataPathSnapshot();
+}
+
+Settings::DataPathSnapshot::DataPathSnapshot(const Settings& settings)
+    : verbose(settings.getVerbose()),
+      maxPacketSize(settings.getMaxPacketSize()),
+      datatypeJson(settings.isDatatypeJsonEnabled()),
+      datatypeSnappy(settings.isDatatypeSnappyEnabled()),
+      xattrEnabled(settings.isXattrEnabled()),
+      dedupeNmvbMaps(settings.isDedupeNmvbMaps()),
+      collectionsPrototype(settings.isCollectionsPrototypeEnabled()),
+      privilegeDebug(settings.isPrivilegeDebug()) {
+}
+
+void Settings::publishDataPathSnapshot() {
+    auto snapshot = std::make_unique<const DataPathSnapshot>(*this);
+    const auto* ptr = snapshot.get();
+    {
+        std::lock_guard<std::mutex> guard(dataPathSnapshotsMutex);
+        dataPathSnapshots.emplace_back(std::move(snapshot));
+    }
+    dataPathSnapshot.store(ptr, std::memory_order_release);
 }
 
 Settings::Settings(const unique_cJSON_ptr& json)
@@ -174,6 +202,24 @@ static void handle_audit_file(Settings& s, cJSON* obj) {
     s.setAuditFile(obj->valuestring);
 }
 
+/**
+ * Handle the "stats_shm_path" tag in the settings
+ *
+ *  The value must be a string naming the file to map as the
+ *  shared-memory stats export segment (it is created if it doesn't
+ *  exist)
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_stats_shm_path(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_String) {
+        throw std::invalid_argument("\"stats_shm_path\" must be a string");
+    }
+
+    s.setStatsShmPath(obj->valuestring);
+}
+
 static void handle_error_maps_dir(Settings& s, cJSON* obj) {
     if (obj->type != cJSON_String) {
         throw std::invalid_argument("\"error_maps_dir\" must be a string");
@@ -249,6 +295,23 @@ static void handle_reqs_event(Settings& s, cJSON* obj) {
     s.setRequestsPerEventNotification(obj->valueint, priority);
 }
 
+/**
+ * Handle the "default_bytes_per_event" tag in the settings
+ *
+ *  The value must be an integer value (0 == no byte limit)
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_bytes_event(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+                "\"default_bytes_per_event\" must be an integer");
+    }
+
+    s.setBytesPerEventNotification(size_t(obj->valueint));
+}
+
 /**
  * Handle the "verbosity" tag in the settings
  *
@@ -280,6 +343,22 @@ static void handle_connection_idle_time(Settings& s, cJSON* obj) {
     s.setConnectionIdleTime(obj->valueint);
 }
 
+/**
+ * Handle the "connection_park_time" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_connection_park_time(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"connection_park_time\" must be an integer");
+    }
+    s.setConnectionParkTime(obj->valueint);
+}
+
 /**
  * Handle the "bio_drain_buffer_sz" tag in the settings
  *
@@ -296,6 +375,38 @@ static void handle_bio_drain_buffer_sz(Settings& s, cJSON* obj) {
     s.setBioDrainBufferSize(obj->valueint);
 }
 
+/**
+ * Handle the "readahead_buffer_sz" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_readahead_buffer_sz(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"readahead_buffer_sz\" must be an integer");
+    }
+    s.setReadaheadBufferSize(obj->valueint);
+}
+
+/**
+ * Handle the "buffer_pool_size" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_buffer_pool_size(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"buffer_pool_size\" must be an integer");
+    }
+    s.setBufferPoolSize(obj->valueint);
+}
+
 /**
  * Handle the "datatype_snappy" tag in the settings
  *
@@ -631,6 +742,7 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
             {"rbac_file", handle_rbac_file},
             {"privilege_debug", handle_privilege_debug},
             {"audit_file", handle_audit_file},
+            {"stats_shm_path", handle_stats_shm_path},
             {"error_maps_dir", handle_error_maps_dir},
             {"threads", handle_threads},
             {"interfaces", handle_interfaces},
@@ -639,9 +751,13 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
             {"reqs_per_event_high_priority", handle_reqs_event},
             {"reqs_per_event_med_priority", handle_reqs_event},
             {"reqs_per_event_low_priority", handle_reqs_event},
+            {"default_bytes_per_event", handle_bytes_event},
             {"verbosity", handle_verbosity},
             {"connection_idle_time", handle_connection_idle_time},
+            {"connection_park_time", handle_connection_park_time},
             {"bio_drain_buffer_sz", handle_bio_drain_buffer_sz},
+            {"readahead_buffer_sz", handle_readahead_buffer_sz},
+            {"buffer_pool_size", handle_buffer_pool_size},
             {"datatype_json", handle_datatype_json},
             {"datatype_snappy", handle_datatype_snappy},
             {"root", handle_root},
@@ -895,12 +1011,33 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             throw std::invalid_argument("audit can't be changed dynamically");
         }
     }
+    if (other.has.stats_shm_path) {
+        if (other.stats_shm_path != stats_shm_path) {
+            throw std::invalid_argument(
+                "stats_shm_path can't be changed dynamically");
+        }
+    }
     if (other.has.bio_drain_buffer_sz) {
         if (other.bio_drain_buffer_sz != bio_drain_buffer_sz) {
             throw std::invalid_argument(
                 "bio_drain_buffer_sz can't be changed dynamically");
         }
     }
+    if (other.has.readahead_buffer_sz) {
+        if (other.readahead_buffer_sz != readahead_buffer_sz) {
+            LOG_NOTICE(nullptr,
+                       "Change readahead buffer size from %u to %u",
+                       readahead_buffer_sz,
+                       other.readahead_buffer_sz);
+            setReadaheadBufferSize(other.readahead_buffer_sz);
+        }
+    }
+    if (other.has.buffer_pool_size) {
+        if (other.buffer_pool_size != buffer_pool_size) {
+            throw std::invalid_argument(
+                "buffer_pool_size can't be changed dynamically");
+        }
+    }
     if (other.has.datatype_json) {
         if (other.datatype_json != datatype_json) {
             throw std::invalid_argument(
@@ -1049,6 +1186,15 @@ void Settings::updateSettings(const Settings& other, bool apply) {
                                             EventPriority::Default);
         }
     }
+    if (other.has.default_bytes_per_event) {
+        if (other.default_bytes_per_event != default_bytes_per_event) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change default bytes per event from %" PRIu64 " to %" PRIu64,
+                  uint64_t(default_bytes_per_event),
+                  uint64_t(other.default_bytes_per_event));
+            setBytesPerEventNotification(other.default_bytes_per_event);
+        }
+    }
     if (other.has.connection_idle_time) {
         if (other.connection_idle_time != connection_idle_time) {
             logit(EXTENSION_LOG_NOTICE,
@@ -1058,6 +1204,15 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setConnectionIdleTime(other.connection_idle_time);
         }
     }
+    if (other.has.connection_park_time) {
+        if (other.connection_park_time != connection_park_time) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change connection park time from %u to %u",
+                  connection_park_time.load(),
+                  other.connection_park_time.load());
+            setConnectionParkTime(other.connection_park_time);
+        }
+    }
     if (other.has.max_packet_size) {
         if (other.max_packet_size != max_packet_size) {
             logit(EXTENSION_LOG_NOTICE,
@@ -1392,6 +1547,10 @@ const std::string& Settings::getErrorMap(size_t version) const {
 
 
 void Settings::notify_changed(const std::string& key) {
+    // Republish the data path snapshot first so that the listeners (and
+    // anyone they wake up) observe the new value through it.
+    publishDataPathSnapshot();
+
     auto iter = change_listeners.find(key);
     if (iter != change_listeners.end()) {
         for (auto& listener : iter->second) {
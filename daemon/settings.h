@@ -28,6 +28,7 @@
 #include <cstdarg>
 #include <deque>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -269,6 +270,76 @@ public:
 
     Settings(const Settings&) = delete;
 
+    /**
+     * An immutable snapshot of the subset of the settings consulted on
+     * the data path (datatype support, limits, debug flags).
+     *
+     * A new snapshot is published every time a setting changes
+     * (notify_changed is the funnel all of the setters run through), so
+     * a reader pays a single acquire-load for the whole subset instead
+     * of one synchronized read per value, and a new dynamic tunable
+     * only has to be added to the snapshot to become readable for free
+     * on the data path.
+     */
+    class DataPathSnapshot {
+    public:
+        DataPathSnapshot() = default;
+
+        explicit DataPathSnapshot(const Settings& settings);
+
+        int getVerbose() const {
+            return verbose;
+        }
+
+        uint32_t getMaxPacketSize() const {
+            return maxPacketSize;
+        }
+
+        bool isDatatypeJsonEnabled() const {
+            return datatypeJson;
+        }
+
+        bool isDatatypeSnappyEnabled() const {
+            return datatypeSnappy;
+        }
+
+        bool isXattrEnabled() const {
+            return xattrEnabled;
+        }
+
+        bool isDedupeNmvbMaps() const {
+            return dedupeNmvbMaps;
+        }
+
+        bool isCollectionsPrototypeEnabled() const {
+            return collectionsPrototype;
+        }
+
+        bool isPrivilegeDebug() const {
+            return privilegeDebug;
+        }
+
+    private:
+        int verbose = 0;
+        uint32_t maxPacketSize = 0;
+        bool datatypeJson = false;
+        bool datatypeSnappy = false;
+        bool xattrEnabled = false;
+        bool dedupeNmvbMaps = false;
+        bool collectionsPrototype = false;
+        bool privilegeDebug = false;
+    };
+
+    /**
+     * Get the published snapshot of the data path settings. The returned
+     * reference stays valid for the lifetime of the process (superseded
+     * snapshots are retained, see publishDataPathSnapshot), so readers
+     * don't have to take a reference on it.
+     */
+    const DataPathSnapshot& getDataPathSnapshot() const {
+        return *dataPathSnapshot.load(std::memory_order_acquire);
+    }
+
 
     /**
      * Allow the global settings instance to be changed by loading the
@@ -402,6 +473,26 @@ public:
         notify_changed("audit_file");
     }
 
+    /**
+     * Get the name of the file to map as the shared-memory stats
+     * export segment (empty == disabled)
+     */
+    const std::string& getStatsShmPath() const {
+        return stats_shm_path;
+    }
+
+    /**
+     * Set the name of the file to map as the shared-memory stats
+     * export segment
+     *
+     * @param stats_shm_path the new name of the file to map
+     */
+    void setStatsShmPath(const std::string& stats_shm_path) {
+        has.stats_shm_path = true;
+        Settings::stats_shm_path = stats_shm_path;
+        notify_changed("stats_shm_path");
+    }
+
     const std::string& getErrorMapsDir() const {
         return Settings::error_maps_dir;
     }
@@ -470,6 +561,27 @@ public:
         notify_changed("connection_idle_time");
     }
 
+    /**
+     * Get the quiet period after which an idle connection's network
+     * buffers are parked (returned to the worker thread's buffer pool).
+     *
+     * @return the quiet period in seconds (0 means parking is disabled)
+     */
+    const size_t getConnectionParkTime() const {
+        return connection_park_time;
+    }
+
+    /**
+     * Set the quiet period after which idle connections are parked
+     *
+     * @param value the number of seconds a connection must stay quiet
+     */
+    void setConnectionParkTime(size_t value) {
+        Settings::connection_park_time = value;
+        has.connection_park_time = true;
+        notify_changed("connection_park_time");
+    }
+
     /**
      * Get the root directory of the couchbase installation
      *
@@ -569,6 +681,26 @@ public:
             "setRequestsPerEventNotification: Unknown priority");
     }
 
+    /**
+     * Set the number of request and response bytes to handle per
+     * notification from the event library (0 == no byte limit)
+     *
+     * @param num the number of bytes to handle
+     */
+    void setBytesPerEventNotification(size_t num) {
+        default_bytes_per_event = num;
+        has.default_bytes_per_event = true;
+        notify_changed("default_bytes_per_event");
+    }
+
+    /**
+     * Get the number of request and response bytes to handle per
+     * callback from the event library (0 == no byte limit)
+     */
+    size_t getBytesPerEventNotification() const {
+        return default_bytes_per_event;
+    }
+
     /**
      * Is PROTOCOL_BINARY_DATATYPE_JSON supported or not
      *
@@ -630,6 +762,50 @@ public:
         notify_changed("bio_drain_buffer_sz");
     }
 
+    /**
+     * Get the amount of data we try to drain off the socket in one go
+     * for a connection (bigger values reduce the number of recv() calls
+     * needed to pick up a burst of pipelined requests)
+     *
+     * @return the readahead size in bytes
+     */
+    unsigned int getReadaheadBufferSize() const {
+        return readahead_buffer_sz;
+    }
+
+    /**
+     * Set the amount of data to try to drain off the socket in one go
+     *
+     * @param readahead_buffer_sz the new size in bytes
+     */
+    void setReadaheadBufferSize(unsigned int readahead_buffer_sz) {
+        Settings::readahead_buffer_sz = readahead_buffer_sz;
+        has.readahead_buffer_sz = true;
+        notify_changed("readahead_buffer_sz");
+    }
+
+    /**
+     * Get the number of idle network buffers each worker thread may
+     * cache for reuse by its connections
+     *
+     * @return the maximum number of buffers to cache per worker thread
+     */
+    unsigned int getBufferPoolSize() const {
+        return buffer_pool_size;
+    }
+
+    /**
+     * Set the number of idle network buffers each worker thread may
+     * cache for reuse by its connections
+     *
+     * @param buffer_pool_size the maximum number of buffers to cache
+     */
+    void setBufferPoolSize(unsigned int buffer_pool_size) {
+        Settings::buffer_pool_size = buffer_pool_size;
+        has.buffer_pool_size = true;
+        notify_changed("buffer_pool_size");
+    }
+
     /**
      * Get the maximum size of a packet the system should try to inspect.
      * Packets exceeding this limit will cause the client to be disconnected
@@ -969,6 +1145,12 @@ protected:
      */
     std::string audit_file;
 
+    /**
+     * The file mapped as the shared-memory stats export segment
+     * (empty == disabled)
+     */
+    std::string stats_shm_path;
+
     /**
      * Location of error maps sent to the client
      */
@@ -984,6 +1166,12 @@ protected:
      */
     Couchbase::RelaxedAtomic<size_t> connection_idle_time;
 
+    /**
+     * The number of seconds a connection must stay quiet before its
+     * network buffers are parked (0 disables parking)
+     */
+    Couchbase::RelaxedAtomic<size_t> connection_park_time;
+
     /**
      * The root directory of the installation
      */
@@ -994,6 +1182,18 @@ protected:
      */
     unsigned int bio_drain_buffer_sz;
 
+    /**
+     * Amount of data to try to drain off the socket in one go for a
+     * connection
+     */
+    unsigned int readahead_buffer_sz;
+
+    /**
+     * Number of idle network buffers each worker thread may cache for
+     * reuse by its connections
+     */
+    unsigned int buffer_pool_size;
+
     /**
      * is datatype json/snappy enabled?
      */
@@ -1009,6 +1209,15 @@ protected:
     int reqs_per_event_low_priority;
     int default_reqs_per_event;
 
+    /**
+     * Request and response bytes a connection may process per event
+     * notification before it must yield to the other connections on its
+     * worker thread (0 == no byte limit). Complements
+     * default_reqs_per_event for workloads with large documents, where
+     * a small number of operations can represent a lot of work.
+     */
+    size_t default_bytes_per_event;
+
     /**
      * Breakpad crash catcher settings
      */
@@ -1107,14 +1316,19 @@ public:
         bool interfaces;
         bool extensions;
         bool audit;
+        bool stats_shm_path;
         bool saslauthd_socketpath;
         bool reqs_per_event_high_priority;
         bool reqs_per_event_med_priority;
         bool reqs_per_event_low_priority;
         bool default_reqs_per_event;
+        bool default_bytes_per_event;
         bool verbose;
         bool connection_idle_time;
+        bool connection_park_time;
         bool bio_drain_buffer_sz;
+        bool readahead_buffer_sz;
+        bool buffer_pool_size;
         bool datatype_json;
         bool datatype_snappy;
         bool root;
@@ -1146,6 +1360,28 @@ protected:
 
     void notify_changed(const std::string& key);
 
+    /**
+     * Build a new data path snapshot from the current values and swap it
+     * in. Superseded snapshots are retained until the process dies so
+     * that readers never have to take a reference on the snapshot; a
+     * setting only changes a handful of times over a process lifetime so
+     * the retained memory is negligible.
+     */
+    void publishDataPathSnapshot();
+
+    /**
+     * The currently published data path snapshot (owned by
+     * dataPathSnapshots).
+     */
+    std::atomic<const DataPathSnapshot*> dataPathSnapshot{nullptr};
+
+    /**
+     * All of the data path snapshots published so far (guarded by
+     * dataPathSnapshotsMutex; the mutation path is rare).
+     */
+    std::mutex dataPathSnapshotsMutex;
+    std::vector<std::unique_ptr<const DataPathSnapshot>> dataPathSnapshots;
+
     /*************************************************************************
      * These settings are not exposed to the user, and are either derived from
      * the above, or not directly configurable:
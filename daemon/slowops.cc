@@ -0,0 +1,41 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "slowops.h"
+
+#include <algorithm>
+
+void SlowOpRing::record(const SlowOpEvent& event) {
+    // Claim a slot. Unlike OpTraceRing there may be multiple writers
+    // (all worker threads record into the bucket's ring), so the slot
+    // is claimed with an atomic increment and filled in afterwards; a
+    // concurrent snapshot may observe the slot before (or while) it is
+    // written, which we accept (see the class comment).
+    const auto idx = head.fetch_add(1, std::memory_order_relaxed);
+    events[idx % capacity] = event;
+}
+
+std::vector<SlowOpEvent> SlowOpRing::snapshot() const {
+    const auto end = head.load(std::memory_order_acquire);
+    const auto num = std::min(end, uint64_t(capacity));
+
+    std::vector<SlowOpEvent> ret;
+    ret.reserve(num);
+    for (uint64_t idx = end - num; idx < end; ++idx) {
+        ret.push_back(events[idx % capacity]);
+    }
+    return ret;
+}
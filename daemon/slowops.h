@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Slow operation capture.
+ *
+ * Commands which exceed their SLA threshold (see cb::mcbp::sla, tunable
+ * through the "opcode_attributes_override" setting) already produce a
+ * log line, but the log line is all that remains of them. This module
+ * additionally records a fixed-size event with the command context and
+ * the intra-command timestamps into a per-bucket ring buffer, so the
+ * most recent slow operations can be pulled off a node after the fact.
+ *
+ * The ring is dumped with "stats slow_ops".
+ */
+
+/**
+ * A single captured slow operation. As with OpTraceEvent the
+ * timestamps within the command are stored as nanosecond offsets from
+ * the start of the command to keep the record small.
+ */
+struct SlowOpEvent {
+    /// When the command was received (parsed off the network);
+    /// nanoseconds since the epoch of ProcessClock
+    uint64_t start_ns;
+    /// Offset from start when execution of the command began
+    uint32_t execute_ns;
+    /// Offset from start when the engine completed a blocked command
+    /// (io notification); 0 if the command never blocked
+    uint32_t notify_ns;
+    /// Offset from start when the response was ready to transmit
+    uint32_t total_ns;
+    /// The id of the connection the command arrived on
+    uint32_t connection_id;
+    /// Hash of the document key (the key itself may be sensitive and
+    /// is not retained)
+    uint32_t key_hash;
+    /// The vbucket the command addressed
+    uint16_t vbucket;
+    /// The opcode of the command
+    uint8_t opcode;
+};
+
+/**
+ * A fixed-size ring of the most recently captured slow operations.
+ *
+ * record() may be called concurrently from all of the worker threads;
+ * producers claim a slot with an atomic increment and then fill it in
+ * without further synchronization. Just like the timing histograms we
+ * don't care THAT much about accuracy of the dump: a snapshot taken
+ * while a slot is being (re)written may observe a torn event, which is
+ * an acceptable price for keeping the capture path to an increment and
+ * a struct store.
+ */
+class SlowOpRing {
+public:
+    /// Append an event to the ring (overwriting the oldest entry once
+    /// the ring is full)
+    void record(const SlowOpEvent& event);
+
+    /**
+     * Get a copy of the events currently in the ring, oldest first.
+     */
+    std::vector<SlowOpEvent> snapshot() const;
+
+    /// The (fixed) number of events the ring may hold
+    static const size_t capacity = 512;
+
+    SlowOpRing() = default;
+    SlowOpRing(const SlowOpRing&) = delete;
+    SlowOpRing& operator=(const SlowOpRing&) = delete;
+
+private:
+    std::array<SlowOpEvent, capacity> events;
+
+    /// Total number of events ever recorded; the next event goes into
+    /// slot (head % capacity)
+    std::atomic<uint64_t> head{0};
+};
@@ -124,7 +124,8 @@ public:
     }
 
     bool morePendingOutput() const {
-        return !outputPipe.empty();
+        return !outputPipe.empty() ||
+               (network != nullptr && BIO_ctrl_pending(network) > 0);
     }
 
     /**
@@ -162,10 +163,13 @@ protected:
     SSL* client = nullptr;
 
     // The pipe used to buffer data between the socket and the SSL library
-    // (data being read)
+    // (data being read). On the hot path we try to receive directly into
+    // the memory BIO, so this pipe only holds readahead data when the
+    // BIO is full.
     cb::Pipe inputPipe;
     // The pipe used to buffer data between the SSL library and the socket
-    // (data being written)
+    // (data being written). On the hot path we send directly from the
+    // memory BIO, so this pipe is normally empty.
     cb::Pipe outputPipe;
 
     // Total number of bytes received on the network
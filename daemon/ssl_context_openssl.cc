@@ -17,6 +17,7 @@
 #include "ssl_context.h"
 
 #include "memcached.h"
+#include "memcached_openssl.h"
 #include "runtime.h"
 
 SslContext::~SslContext() {
@@ -65,6 +66,7 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
     }
 
     set_ssl_ctx_cipher_list(ctx);
+    ssl_configure_session_resumption(ctx);
     int ssl_flags = 0;
     switch (settings.getClientCertAuth()) {
     case ClientCertAuth::Mode::Mandatory:
@@ -164,9 +166,26 @@ void SslContext::drainBioRecvPipe(SOCKET sfd) {
         // Try to move data from our internal buffer to the SSL pipe
         stop = !drainInputSocketBuf();
 
-        // If there is room in the input pipe (the internal buffer for read)
-        // try to read out as much as possible from the socket
-        if (!inputPipe.full()) {
+        // Try to receive directly into the memory BIO to avoid staging
+        // the data in the input pipe first. We may only do that when the
+        // input pipe is empty (the staged data has to enter the BIO in
+        // order).
+        char* ptr = nullptr;
+        const int avail = BIO_nwrite0(network, &ptr);
+        if (avail > 0 && inputPipe.empty()) {
+            auto nr = ::recv(sfd, ptr, avail, 0);
+            if (nr > 0) {
+                BIO_nwrite(network, &ptr, int(nr));
+                totalRecv += nr;
+                stop = false;
+            } else if (nr == 0) {
+                error = true; /* read end shutdown */
+            } else if (!is_blocking(GetLastNetworkError())) {
+                error = true;
+            }
+        } else if (!inputPipe.full()) {
+            // The BIO is full. Read ahead into the input pipe so that we
+            // drain the socket buffer, and feed the BIO as it gets room.
             auto n = inputPipe.produce([sfd](cb::byte_buffer data) -> ssize_t {
                 return ::recv(sfd,
                               reinterpret_cast<char*>(data.data()),
@@ -188,9 +207,9 @@ void SslContext::drainBioRecvPipe(SOCKET sfd) {
             }
         }
 
-        // As long as we moved some data (from the socket to our internal buffer
-        // or from our internal buffer to the BIO) we should keep on moving
-        // data.
+        // As long as we moved some data (from the socket into the BIO,
+        // or between our internal buffer and the BIO) we should keep on
+        // moving data.
     } while (!stop);
 
     // At this time there is:
@@ -234,20 +253,30 @@ void SslContext::drainBioSendPipe(SOCKET sfd) {
             }
         }
 
-        if (!outputPipe.full()) {
-            auto* bio = network;
-            auto n = outputPipe.produce([bio](cb::byte_buffer data) -> ssize_t {
-                return BIO_read(bio, data.data(), data.size());
-            });
-
+        // Send directly from the memory BIO to avoid staging the data in
+        // the output pipe first. If the socket buffer fills up the data
+        // just stays in the BIO (morePendingOutput reflects that).
+        char* ptr = nullptr;
+        const int pending = BIO_nread0(network, &ptr);
+        if (pending > 0) {
+            auto n = ::send(sfd, ptr, pending, 0);
             if (n > 0) {
-                // We did move data
+                BIO_nread(network, &ptr, int(n));
+                totalSend += n;
                 stop = false;
+            } else if (n == -1) {
+                if (!is_blocking(GetLastNetworkError())) {
+                    log_socket_error(
+                            EXTENSION_LOG_WARNING,
+                            this,
+                            "Failed to write, and not due to blocking: %s");
+                    error = true;
+                }
+                return;
             }
         }
-        // As long as we moved some data (from the internal buffer to the
-        // socket or from the BIO to our internal buffer) we should keep on
-        // moving data.
+        // As long as we moved some data (from the internal buffer or the
+        // BIO to the socket) we should keep on moving data.
     } while (!stop);
 
     // At this time there is:
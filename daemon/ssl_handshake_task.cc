@@ -0,0 +1,38 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "ssl_handshake_task.h"
+#include "memcached.h"
+
+SslHandshakeTask::SslHandshakeTask(McbpConnection& connection_,
+                                   SslContext& ssl_)
+    : connection(connection_), ssl(ssl_) {
+    // no more init needed
+}
+
+Task::Status SslHandshakeTask::execute() {
+    // The executor holds the task mutex while calling execute(), so
+    // setting finished here is properly synchronized with the worker
+    // thread inspecting it.
+    result = ssl.accept();
+    finished = true;
+    return Status::Finished;
+}
+
+void SslHandshakeTask::notifyExecutionComplete() {
+    notify_io_complete(connection.getCookie(), ENGINE_SUCCESS);
+}
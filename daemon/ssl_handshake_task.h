@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "task.h"
+
+class McbpConnection;
+class SslContext;
+
+/**
+ * The SslHandshakeTask runs the expensive part of accepting a TLS
+ * connection - the SSL_accept() call performing the RSA / ECDHE
+ * computation - in the executor pool, so that a storm of (re)connecting
+ * TLS clients doesn't pin the worker threads in crypto while the
+ * established connections starve.
+ *
+ * The SSL engine operates on memory BIOs (the worker thread moves the
+ * data between the BIOs and the socket), so SSL_accept() never touches
+ * the network and is safe to run on another thread. While the task is
+ * in flight the connection stays parked and the worker must not touch
+ * the SSL structures; the worker picks up the result (under the task
+ * mutex) the next time the connection is driven.
+ */
+class SslHandshakeTask : public Task {
+public:
+    SslHandshakeTask() = delete;
+
+    SslHandshakeTask(const SslHandshakeTask&) = delete;
+
+    SslHandshakeTask(McbpConnection& connection_, SslContext& ssl_);
+
+    Status execute() override;
+
+    void notifyExecutionComplete() override;
+
+    /// Did the task complete? The caller must hold the task mutex.
+    bool isFinished() const {
+        return finished;
+    }
+
+    /// The return value from SSL_accept()
+    int getResult() const {
+        return result;
+    }
+
+protected:
+    McbpConnection& connection;
+    SslContext& ssl;
+
+    /// The return value from SSL_accept()
+    int result = -1;
+
+    /// Set (under the task mutex) when the handshake attempt completed
+    bool finished = false;
+};
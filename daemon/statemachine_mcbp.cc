@@ -17,6 +17,7 @@
 #include "config.h"
 #include "statemachine_mcbp.h"
 
+#include "admission.h"
 #include "protocol/mcbp/engine_wrapper.h"
 #include "memcached.h"
 #include "mcbp.h"
@@ -98,7 +99,8 @@ void McbpStateMachine::setCurrentState(State task) {
         }
     }
 
-    if (settings.getVerbose() > 2 || task == State::closing) {
+    if (settings.getDataPathSnapshot().getVerbose() > 2 ||
+        task == State::closing) {
         LOG_DETAIL(this,
                    "%u: going from %s to %s",
                    connection.getId(),
@@ -107,6 +109,9 @@ void McbpStateMachine::setCurrentState(State task) {
     }
 
     if (task == State::send_data) {
+        // The command holding an admission slot (if any) is done with
+        // the engine once its response is being sent
+        admission_release(&connection);
         if (connection.getStart() != ProcessClock::time_point()) {
             mcbp_collect_timings(&connection);
             connection.setStart(ProcessClock::time_point());
@@ -175,9 +180,15 @@ static void reset_cmd_handler(McbpConnection *c) {
     c->setCmd(-1);
 
     c->getCookieObject().reset();
+    c->releaseBlockedCommandSlot();
     c->resetCommandContext();
+    c->clearDirectResponseBuilt();
 
-    c->shrinkBuffers();
+    // Shrinking the buffers would wipe the queued output, so defer it
+    // until the batched responses have been flushed to the socket.
+    if (!c->isResponseBatchPending()) {
+        c->shrinkBuffers();
+    }
     if (c->read->rsize() >= sizeof(c->binary_header)) {
         c->setState(McbpStateMachine::State::parse_cmd);
     } else if (c->isSslEnabled()) {
@@ -258,6 +269,13 @@ bool conn_waiting(McbpConnection& connection) {
         return true;
     }
 
+    if (c->hasReadyBlockedCommand()) {
+        // A parked command completed while we were idle (or waiting on
+        // an execution barrier); go re-execute it
+        c->setState(McbpStateMachine::State::new_cmd);
+        return true;
+    }
+
     if (!c->updateEvent(EV_READ | EV_PERSIST)) {
         LOG_WARNING(c, "%u: conn_waiting - Unable to update libevent "
                     "settings with (EV_READ | EV_PERSIST), closing connection "
@@ -313,7 +331,7 @@ bool conn_new_cmd(McbpConnection& connection) {
 
     c->setStart(ProcessClock::time_point());
 
-    if (!c->write->empty()) {
+    if (!c->write->empty() && !c->isResponseBatchPending()) {
         LOG_WARNING(
                 c,
                 "%u: Expected write buffer to be empty.. It's not! (%" PRIu64
@@ -328,7 +346,14 @@ bool conn_new_cmd(McbpConnection& connection) {
      * before they will back off.
      */
     if (c->decrementNumEvents() >= 0) {
-        reset_cmd_handler(c);
+        if (c->hasReadyBlockedCommand()) {
+            // Re-execute a completed parked command before picking up
+            // anything new from the input pipe
+            c->setupBlockedCommandReexecution();
+            c->setState(McbpStateMachine::State::execute);
+        } else {
+            reset_cmd_handler(c);
+        }
     } else {
         get_thread_stats(c)->conn_yields++;
 
@@ -344,7 +369,8 @@ bool conn_new_cmd(McbpConnection& connection) {
          * connections in the way that they may not even get data from
          * the other end so that they'll _have_ to wait for a write event.
          */
-        if (c->havePendingInputData() || c->isDCP()) {
+        if (c->havePendingInputData() || c->hasReadyBlockedCommand() ||
+            c->isDCP()) {
             short flags = EV_WRITE | EV_PERSIST;
             if (!c->updateEvent(flags)) {
                 LOG_WARNING(c, "%u: conn_new_cmd - Unable to update "
@@ -367,7 +393,11 @@ bool conn_execute(McbpConnection& connection) {
         return true;
     }
 
-    if (!c->isPacketAvailable()) {
+    // A re-executed blocked command runs from the packet copy held in
+    // its slot; only commands coming off the wire live in the input pipe
+    const bool reExecution = c->isReExecutingBlockedCommand();
+
+    if (!reExecution && !c->isPacketAvailable()) {
         throw std::logic_error(
                 "conn_execute: Internal error.. the input packet is not "
                 "completely in memory");
@@ -375,11 +405,38 @@ bool conn_execute(McbpConnection& connection) {
 
     c->setEwouldblock(false);
 
+    if (c->getExecuteStart() == ProcessClock::time_point()) {
+        // First entry for this command (we get back here after an
+        // io notification as well)
+        c->setExecuteStart(ProcessClock::now());
+    }
+
     mcbp_execute_packet(c);
 
     if (c->isEwouldblock()) {
-        c->unregisterEvent();
-        return false;
+        if (!c->parkBlockedCommand()) {
+            c->unregisterEvent();
+            return false;
+        }
+
+        // The command has been parked in its slot awaiting the engine;
+        // consume its packet (the slot owns a copy) and carry on with
+        // the next pipelined command
+        if (!reExecution) {
+            c->read->consume([c](cb::const_byte_buffer buffer) -> ssize_t {
+                size_t size = sizeof(c->binary_header) +
+                              c->binary_header.request.bodylen;
+                if (size > buffer.size()) {
+                    throw std::logic_error(
+                            "conn_execute: Not enough data in input buffer");
+                }
+                return size;
+            });
+            c->chargeEventBytes(sizeof(c->binary_header) +
+                                c->binary_header.request.bodylen);
+        }
+        c->setState(McbpStateMachine::State::new_cmd);
+        return true;
     }
 
     // We've executed the packet, and given that we're not blocking we
@@ -390,6 +447,11 @@ bool conn_execute(McbpConnection& connection) {
                 "conn_execute: Should leave conn_execute for !EWOULDBLOCK");
     }
 
+    if (reExecution) {
+        c->clearReExecutingBlockedCommand();
+        return true;
+    }
+
     // Consume the packet we just executed from the input buffer
     c->read->consume([c](cb::const_byte_buffer buffer) -> ssize_t {
         size_t size =
@@ -400,6 +462,8 @@ bool conn_execute(McbpConnection& connection) {
         }
         return size;
     });
+    c->chargeEventBytes(sizeof(c->binary_header) +
+                        c->binary_header.request.bodylen);
 
     return true;
 }
@@ -433,6 +497,7 @@ bool conn_read_packet_body(McbpConnection& connection) {
                              cb::const_byte_buffer{input.data(),
                                                    sizeof(cb::mcbp::Request) +
                                                            req->getBodylen()});
+            c->maybeCopyBlockedCommandPacket();
             c->setState(McbpStateMachine::State::execute);
         }
 
@@ -480,11 +545,22 @@ bool conn_send_data(McbpConnection& connection) {
     auto* c = &connection;
     bool ret = true;
 
+    // If the client pipelines requests we may defer the transmission
+    // and execute the next request from the input buffer right away,
+    // accumulating all of the responses into a single write.
+    if (c->maybeBatchResponse()) {
+        c->setState(c->getWriteAndGo());
+        return true;
+    }
+
     switch (c->transmit()) {
     case McbpConnection::TransmitResult::Complete:
         // Release all allocated resources
         c->releaseTempAlloc();
+        c->releaseTempSegments();
         c->releaseReservedItems();
+        c->releasePinnedBuffers();
+        c->clearBatchedResponses();
 
         // We're done sending the response to the client. Enter the next
         // state in the state machine
@@ -525,7 +601,7 @@ bool conn_pending_close(McbpConnection& connection) {
      */
     perform_callbacks(ON_DISCONNECT, NULL, c->getCookie());
 
-    if (c->getRefcount() > 1) {
+    if (c->getRefcount() > 1 || c->hasPendingBlockedCommands()) {
         return false;
     }
 
@@ -560,8 +636,15 @@ bool conn_immediate_close(McbpConnection& connection) {
 
 bool conn_closing(McbpConnection& connection) {
     auto* c = &connection;
-    // Delete any attached command context
+    // Delete any attached command context (and any command contexts
+    // kept alive by batched responses we'll never get to send)
     c->resetCommandContext();
+    c->clearBatchedResponses();
+    c->abandonBlockedCommands();
+
+    // Give back any admission slot (or wait queue entry) held by the
+    // command being executed when the connection went down
+    admission_release(c);
 
     /* We don't want any network notifications anymore.. */
     c->unregisterEvent();
@@ -571,7 +654,8 @@ bool conn_closing(McbpConnection& connection) {
     /* engine::release any allocated state */
     conn_cleanup_engine_allocations(c);
 
-    if (c->getRefcount() > 1 || c->isEwouldblock()) {
+    if (c->getRefcount() > 1 || c->isEwouldblock() ||
+        c->hasPendingBlockedCommands()) {
         c->setState(McbpStateMachine::State::pending_close);
     } else {
         c->setState(McbpStateMachine::State::immediate_close);
@@ -66,6 +66,7 @@ struct thread_stats {
         wbufs_allocated = 0;
         wbufs_loaned = 0;
         wbufs_existing = 0;
+        conns_parked = 0;
 
         iovused_high_watermark = 0;
         msgused_high_watermark = 0;
@@ -108,6 +109,7 @@ struct thread_stats {
         wbufs_allocated += other.wbufs_allocated;
         wbufs_loaned += other.wbufs_loaned;
         wbufs_existing += other.wbufs_existing;
+        conns_parked += other.conns_parked;
 
         iovused_high_watermark.setIfGreater(other.iovused_high_watermark);
         msgused_high_watermark.setIfGreater(other.msgused_high_watermark);
@@ -179,6 +181,9 @@ struct thread_stats {
     /* # of write buffers which already existed (with partial data) on the
         connection (and hence didn't need to be allocated). */
     Couchbase::RelaxedAtomic<uint64_t> wbufs_existing;
+    /* # of times an idle connection had its buffers parked (returned to
+       the worker's pool after the configured quiet period). */
+    Couchbase::RelaxedAtomic<uint64_t> conns_parked;
 
     /* Highest value iovsize has got to */
     Couchbase::RelaxedAtomic<int> iovused_high_watermark;
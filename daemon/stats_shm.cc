@@ -0,0 +1,192 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+
+#include "stats_shm.h"
+
+#include "buckets.h"
+#include "mc_time.h"
+#include "memcached.h"
+#include "settings.h"
+#include "stats.h"
+#include "timings.h"
+
+#include <cstring>
+#include <system_error>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// The mapped segment, or nullptr if the export isn't enabled
+static stats_shm_layout* segment = nullptr;
+
+#ifdef WIN32
+static HANDLE segment_file = INVALID_HANDLE_VALUE;
+static HANDLE segment_mapping = NULL;
+#else
+static int segment_fd = -1;
+#endif
+
+void stats_shm_init() {
+    const auto& path = settings.getStatsShmPath();
+    if (path.empty()) {
+        return;
+    }
+
+#ifdef WIN32
+    segment_file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (segment_file == INVALID_HANDLE_VALUE) {
+        throw std::system_error(GetLastError(), std::system_category(),
+                                "stats_shm_init: failed to create " + path);
+    }
+    segment_mapping = CreateFileMapping(segment_file, NULL, PAGE_READWRITE, 0,
+                                        sizeof(stats_shm_layout), NULL);
+    if (segment_mapping == NULL) {
+        throw std::system_error(GetLastError(), std::system_category(),
+                                "stats_shm_init: failed to map " + path);
+    }
+    segment = reinterpret_cast<stats_shm_layout*>(
+            MapViewOfFile(segment_mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+                          sizeof(stats_shm_layout)));
+    if (segment == nullptr) {
+        throw std::system_error(GetLastError(), std::system_category(),
+                                "stats_shm_init: failed to map " + path);
+    }
+#else
+    segment_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (segment_fd == -1) {
+        throw std::system_error(errno, std::system_category(),
+                                "stats_shm_init: failed to create " + path);
+    }
+    if (ftruncate(segment_fd, sizeof(stats_shm_layout)) == -1) {
+        throw std::system_error(errno, std::system_category(),
+                                "stats_shm_init: failed to size " + path);
+    }
+    auto* ptr = mmap(nullptr, sizeof(stats_shm_layout),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, segment_fd, 0);
+    if (ptr == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(),
+                                "stats_shm_init: failed to map " + path);
+    }
+    segment = reinterpret_cast<stats_shm_layout*>(ptr);
+#endif
+
+    /* Publish the header last so that a reader mapping the file while
+     * we initialize it won't see the magic before the rest is zeroed. */
+    std::memset(segment, 0, sizeof(*segment));
+    segment->layout_version = stats_shm_layout_version;
+    segment->segment_size = sizeof(stats_shm_layout);
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = stats_shm_magic;
+}
+
+void stats_shm_update() {
+    if (segment == nullptr) {
+        return;
+    }
+
+    /* Gather everything into a local copy first so that the window
+     * where the seqlock is held odd is just a memcpy. */
+    static stats_shm_layout snapshot;
+
+    struct thread_stats aggregated;
+    bucketsForEach([](Bucket& bucket, void* ctx) -> bool {
+        reinterpret_cast<struct thread_stats*>(ctx)->aggregate(bucket.stats);
+        return true;
+    }, &aggregated);
+
+    std::memset(snapshot.opcode_ops, 0, sizeof(snapshot.opcode_ops));
+    bucketsForEach([](Bucket& bucket, void* ctx) -> bool {
+        auto* ops = reinterpret_cast<uint64_t*>(ctx);
+        for (int ii = 0; ii < MAX_NUM_OPCODES; ++ii) {
+            ops[ii] += bucket.timings.get_total(uint8_t(ii));
+        }
+        return true;
+    }, snapshot.opcode_ops);
+
+    struct timeval now;
+    cb_get_timeofday(&now);
+    snapshot.uptime = mc_time_get_current_time();
+    snapshot.updated_at = uint64_t(now.tv_sec);
+
+    snapshot.daemon_conns = stats.daemon_conns;
+    snapshot.curr_conns = stats.curr_conns;
+    snapshot.total_conns = stats.total_conns;
+    snapshot.conn_structs = stats.conn_structs;
+    snapshot.rejected_conns = stats.rejected_conns;
+
+    snapshot.cmd_get = aggregated.cmd_get;
+    snapshot.get_hits = aggregated.get_hits;
+    snapshot.get_misses = aggregated.get_misses;
+    snapshot.cmd_set = aggregated.cmd_set;
+    snapshot.cmd_flush = aggregated.cmd_flush;
+    snapshot.cmd_subdoc_lookup = aggregated.cmd_subdoc_lookup;
+    snapshot.cmd_subdoc_mutation = aggregated.cmd_subdoc_mutation;
+    snapshot.cmd_lock = aggregated.cmd_lock;
+    snapshot.lock_errors = aggregated.lock_errors;
+    snapshot.delete_hits = aggregated.delete_hits;
+    snapshot.delete_misses = aggregated.delete_misses;
+    snapshot.auth_cmds = aggregated.auth_cmds;
+    snapshot.auth_errors = aggregated.auth_errors;
+    snapshot.bytes_read = aggregated.bytes_read;
+    snapshot.bytes_written = aggregated.bytes_written;
+    snapshot.conn_yields = aggregated.conn_yields;
+
+    /* Seqlock write side. We're the only writer (the clock tick runs on
+     * the main thread), so a plain increment to odd, copy, increment to
+     * even suffices; the fences keep the body stores inside the odd
+     * window for the out-of-process readers. */
+    const auto seq = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    segment->uptime = snapshot.uptime;
+    segment->updated_at = snapshot.updated_at;
+    std::memcpy(&segment->daemon_conns, &snapshot.daemon_conns,
+                sizeof(stats_shm_layout) -
+                        offsetof(stats_shm_layout, daemon_conns));
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    segment->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void stats_shm_shutdown() {
+    if (segment == nullptr) {
+        return;
+    }
+
+#ifdef WIN32
+    UnmapViewOfFile(segment);
+    CloseHandle(segment_mapping);
+    CloseHandle(segment_file);
+    segment_mapping = NULL;
+    segment_file = INVALID_HANDLE_VALUE;
+#else
+    munmap(segment, sizeof(stats_shm_layout));
+    close(segment_fd);
+    segment_fd = -1;
+#endif
+    segment = nullptr;
+}
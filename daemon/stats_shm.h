@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+/**
+ * Optional shared-memory stats export.
+ *
+ * When the "stats_shm_path" setting is specified, the daemon maps a
+ * file of that name into memory and mirrors the high frequency numeric
+ * stats into it once per clock tick: the global connection gauges, the
+ * aggregated per-thread counters and the per-opcode operation counts
+ * from the command timings. A node-local monitoring agent can then map
+ * the same file read-only and scrape the node without generating any
+ * protocol traffic or occupying a worker thread.
+ *
+ * The segment uses a seqlock: the writer increments "sequence" to an
+ * odd value before updating the body and to an even value afterwards.
+ * A reader snapshots the sequence, copies the body, and retries if the
+ * sequence was odd or changed during the copy. A crashed writer at
+ * worst leaves the sequence odd, which readers treat as "no consistent
+ * snapshot available" rather than consuming torn data.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+/// Expected value of stats_shm_layout::magic ("MCSTSHM\0" little endian)
+const uint64_t stats_shm_magic = 0x004d485354534d43ULL;
+
+/// Bumped whenever the layout of stats_shm_layout changes
+const uint32_t stats_shm_layout_version = 1;
+
+/**
+ * The on-disk (well, in-memory) layout of the stats segment. All
+ * multi-byte values are stored in host byte order; the segment is only
+ * intended to be consumed on the node which produced it.
+ */
+struct stats_shm_layout {
+    /// Must contain stats_shm_magic for the segment to be valid
+    uint64_t magic;
+    /// Must contain stats_shm_layout_version
+    uint32_t layout_version;
+    /// sizeof(stats_shm_layout) as a belt-and-braces layout check
+    uint32_t segment_size;
+
+    /// Seqlock sequence; odd while an update is in progress
+    std::atomic<uint64_t> sequence;
+
+    /// Seconds since the daemon started (at the last update)
+    uint64_t uptime;
+    /// System clock (seconds since the epoch) at the last update
+    uint64_t updated_at;
+
+    /* Global connection gauges (struct stats) */
+    uint64_t daemon_conns;
+    uint64_t curr_conns;
+    uint64_t total_conns;
+    uint64_t conn_structs;
+    uint64_t rejected_conns;
+
+    /* Aggregated per-thread counters across all buckets */
+    uint64_t cmd_get;
+    uint64_t get_hits;
+    uint64_t get_misses;
+    uint64_t cmd_set;
+    uint64_t cmd_flush;
+    uint64_t cmd_subdoc_lookup;
+    uint64_t cmd_subdoc_mutation;
+    uint64_t cmd_lock;
+    uint64_t lock_errors;
+    uint64_t delete_hits;
+    uint64_t delete_misses;
+    uint64_t auth_cmds;
+    uint64_t auth_errors;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t conn_yields;
+
+    /**
+     * Total number of timing samples recorded per opcode, aggregated
+     * across all buckets (index == protocol opcode).
+     */
+    uint64_t opcode_ops[0x100];
+};
+
+/**
+ * Map the stats segment if settings.getStatsShmPath() is set (no-op
+ * otherwise). Called once during startup after the settings have been
+ * parsed.
+ *
+ * @throws std::system_error if the file can't be created or mapped
+ */
+void stats_shm_init();
+
+/**
+ * Refresh the stats segment with the current values. Called from the
+ * clock tick handler; a no-op unless the segment is mapped.
+ */
+void stats_shm_update();
+
+/// Unmap the stats segment (no-op unless the segment is mapped)
+void stats_shm_shutdown();
@@ -0,0 +1,64 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "stats_tasks.h"
+#include "memcached.h"
+#include "protocol/mcbp/stats_context.h"
+
+StatsTask::StatsTask(Cookie& cookie_,
+                     McbpConnection& connection_,
+                     const std::string& key_,
+                     ADD_STAT add_stat_callback_)
+    : cookie(cookie_),
+      connection(connection_),
+      key(key_),
+      add_stat_callback(add_stat_callback_) {
+    // no more init needed
+}
+
+Task::Status StatsTask::execute() {
+    try {
+        result = process_stat_request(
+                {reinterpret_cast<const uint8_t*>(key.data()), key.size()},
+                connection,
+                add_stat_callback);
+    } catch (const std::bad_alloc&) {
+        LOG_WARNING(nullptr,
+                    "%u: StatsTask::execute(): std::bad_alloc",
+                    connection.getId());
+        result = ENGINE_ENOMEM;
+    } catch (const std::exception& exception) {
+        LOG_WARNING(nullptr,
+                    "%u: StatsTask::execute(): An exception occurred: %s",
+                    connection.getId(),
+                    exception.what());
+        result = ENGINE_FAILED;
+    }
+
+    return Status::Finished;
+}
+
+void StatsTask::notifyExecutionComplete() {
+    if (result == ENGINE_EWOULDBLOCK) {
+        // The engine blocked during the collection and will notify the
+        // cookie itself when it is done; the command context retries
+        // the request on the worker thread at that point.
+        return;
+    }
+
+    notify_io_complete(&cookie, ENGINE_SUCCESS);
+}
@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "task.h"
+#include <memcached/engine.h>
+#include <string>
+
+class Cookie;
+class McbpConnection;
+
+/**
+ * The StatsTask collects an expensive stat group (a full vbucket walk,
+ * hash table dump etc) in the executor pool while the requesting
+ * connection is blocked, so that the collection doesn't freeze the other
+ * connections bound to the same worker thread.
+ *
+ * The connection is "parked" with EWOULDBLOCK while the task runs, so
+ * the task may safely add the stats through the normal callbacks (which
+ * write to the connection's buffers).
+ */
+class StatsTask : public Task {
+public:
+    StatsTask() = delete;
+
+    StatsTask(const StatsTask&) = delete;
+
+    StatsTask(Cookie& cookie_,
+              McbpConnection& connection_,
+              const std::string& key_,
+              ADD_STAT add_stat_callback_);
+
+    Status execute() override;
+
+    void notifyExecutionComplete() override;
+
+    ENGINE_ERROR_CODE getResult() const {
+        return result;
+    }
+
+protected:
+    Cookie& cookie;
+    McbpConnection& connection;
+
+    /// The requested stat group (may contain a sub command)
+    const std::string key;
+
+    /// The callback used to add each individual stat
+    ADD_STAT add_stat_callback;
+
+    /// The result of the collection
+    ENGINE_ERROR_CODE result = ENGINE_FAILED;
+};
@@ -697,6 +697,16 @@ static bool operate_single_doc(SubdocCmdContext& context,
     modified = false;
     auto& operations = context.getOperations();
 
+    // Scratch buffer used when rebuilding the document between
+    // mutations. The result iovecs may point into the buffer currently
+    // backing the document, so the rebuild can't happen in place;
+    // instead of allocating a fresh buffer for every spec of a
+    // multi-mutation we ping-pong between this buffer and temp_buffer,
+    // reusing whichever is large enough.
+    std::unique_ptr<char[]> spare_buffer;
+    size_t spare_capacity = 0;
+    size_t temp_capacity = 0;
+
     // 2. Perform each of the operations on document.
     for (auto op = operations.begin(); op != operations.end(); op++) {
         switch (op->traits.scope) {
@@ -731,24 +741,30 @@ static bool operate_single_doc(SubdocCmdContext& context,
                 // storage for iovecs from the result. Ideally we'd
                 // either permit subjson to take an iovec as input, or
                 // permit subjson to take all the multipaths at once.
-                // For now we make a contiguous region in a temporary
-                // std::vector, and point in_doc at that.
+                // For now we make a contiguous region in the spare
+                // scratch buffer, and point in_doc at that.
 
                 // Allocate an extra byte to make sure we can zero term it
                 // (in case we want to use cJSON_Parse() ;-)
-                std::unique_ptr<char[]> temp(new char[new_doc_len + 1]);
+                if (spare_capacity < new_doc_len + 1) {
+                    spare_buffer.reset(new char[new_doc_len + 1]);
+                    spare_capacity = new_doc_len + 1;
+                }
+                char* temp = spare_buffer.get();
                 temp[new_doc_len] = '\0';
 
                 size_t offset = 0;
                 for (auto& loc : op->result.newdoc()) {
-                    std::memcpy(temp.get() + offset, loc.at, loc.length);
+                    std::memcpy(temp + offset, loc.at, loc.length);
                     offset += loc.length;
                 }
 
-                // Copying complete - safe to delete the old temp_doc
-                // (even if it was the source of some of the newdoc
-                // iovecs).
-                temp_buffer.swap(temp);
+                // Copying complete - the buffer previously backing the
+                // document (even if it was the source of some of the
+                // newdoc iovecs) becomes the spare for the next
+                // mutation.
+                temp_buffer.swap(spare_buffer);
+                std::swap(temp_capacity, spare_capacity);
                 doc.buf = temp_buffer.get();
                 doc.len = new_doc_len;
             } else { // lookup
@@ -1265,6 +1281,11 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
         // Copy the new document into the item.
         char* write_ptr = static_cast<char*>(new_doc_info.value[0].iov_base);
         std::memcpy(write_ptr, context.in_doc.buf, context.in_doc.len);
+
+        // The document is final now; locate the padded macros so the
+        // pre-link callback can patch the real CAS / seqno in place
+        // instead of re-parsing the xattr blob under the engine's locks.
+        context.record_macro_offsets();
     }
 
     // And finally, store the new document.
@@ -17,6 +17,7 @@
 
 #include "config.h"
 #include "subdocument_context.h"
+#include "datatype.h"
 #include "debug_helpers.h"
 #include "mc_time.h"
 #include "protocol/mcbp/engine_wrapper.h"
@@ -76,71 +77,76 @@ std::string SubdocCmdContext::macroToString(T macroValue) {
 }
 
 ENGINE_ERROR_CODE SubdocCmdContext::pre_link_document(item_info& info) {
-    if (do_macro_expansion) {
-        auto bodyoffset = cb::xattr::get_body_offset(
-            {static_cast<const char*>(info.value[0].iov_base),
-             info.value[0].iov_len});
-
-        cb::byte_buffer blob_buffer{
-            static_cast<uint8_t*>(info.value[0].iov_base),
-            bodyoffset};
-
-        cb::xattr::Blob xattr_blob(blob_buffer);
-        auto value = xattr_blob.get(xattr_key);
-        if (value.len == 0) {
-            // The segment is no longer there (we may have had another
-            // subdoc command which rewrote the segment where we injected
-            // the macro.
-            return ENGINE_SUCCESS;
-        }
+    if (!do_macro_expansion || macroOffsets.empty()) {
+        return ENGINE_SUCCESS;
+    }
 
-        // Replace the CAS
-        if (std::any_of(std::begin(paddedMacros),
-                        std::end(paddedMacros),
-                        [](const MacroPair& m) {
-                            return m.first == cb::xattr::macros::CAS;
-                        })) {
-            substituteMacro(cb::xattr::macros::CAS,
-                            macroToString(htonll(info.cas)),
-                            value);
+    // record_macro_offsets() located the padded macros in the document
+    // we handed to the engine, and the padded string is the same length
+    // as the value it stands in for, so we can substitute the real
+    // values in place at the recorded offsets. This runs while the
+    // engine is linking the item, so keep it cheap.
+    auto* base = static_cast<char*>(info.value[0].iov_base);
+    std::string cas;
+    std::string seqno;
+    for (const auto& macro : macroOffsets) {
+        const std::string* replacement;
+        if (macro.first == cb::xattr::macros::CAS) {
+            if (cas.empty()) {
+                cas = macroToString(htonll(info.cas));
+            }
+            replacement = &cas;
+        } else {
+            if (seqno.empty()) {
+                seqno = macroToString(info.seqno);
+            }
+            replacement = &seqno;
         }
 
-        // Replace the Seqno
-        if (std::any_of(std::begin(paddedMacros),
-                        std::end(paddedMacros),
-                        [](const MacroPair& m) {
-                            return m.first == cb::xattr::macros::SEQNO;
-                        })) {
-            substituteMacro(
-                    cb::xattr::macros::SEQNO, macroToString(info.seqno), value);
+        if (macro.second + replacement->length() > info.value[0].iov_len) {
+            throw std::logic_error(
+                    "SubdocCmdContext::pre_link_document: macro offset "
+                    "out of range");
         }
+        std::copy(replacement->begin(), replacement->end(),
+                  base + macro.second);
     }
 
     return ENGINE_SUCCESS;
 }
 
-void SubdocCmdContext::substituteMacro(cb::const_char_buffer macroName,
-                                       const std::string& macroValue,
-                                       cb::byte_buffer& value) {
-    // Do an in-place substitution of the real macro value where we
-    // wrote the padded macro string.
-    uint8_t* root = value.buf;
-    uint8_t* end = value.buf + value.len;
-    auto& macro = std::find_if(std::begin(paddedMacros),
-                               std::end(paddedMacros),
-                               [macroName](const MacroPair& m) {
-                                   return m.first == macroName;
-                               })
-                          ->second;
-    auto* needle = macro.data();
-    auto* needle_end = macro.data() + macro.length();
-
-    // This replaces ALL instances of the padded string
-    while ((root = std::search(root, end, needle, needle_end)) != end) {
-        std::copy(macroValue.data(),
-                  macroValue.data() + macroValue.length(),
-                  root);
-        root += macroValue.length();
+void SubdocCmdContext::record_macro_offsets() {
+    macroOffsets.clear();
+    if (!do_macro_expansion || !mcbp::datatype::is_xattr(in_datatype)) {
+        return;
+    }
+
+    auto bodyoffset = cb::xattr::get_body_offset(in_doc);
+    cb::byte_buffer blob_buffer{(uint8_t*)in_doc.buf, bodyoffset};
+
+    cb::xattr::Blob xattr_blob(blob_buffer);
+    auto value = xattr_blob.get(xattr_key);
+    if (value.len == 0) {
+        // The segment is no longer there (we may have had another
+        // subdoc command which rewrote the segment where we injected
+        // the macro).
+        return;
+    }
+
+    // Record ALL instances of each padded string within the segment
+    for (const auto& macro : paddedMacros) {
+        auto* needle = macro.second.data();
+        auto* needle_end = macro.second.data() + macro.second.length();
+        uint8_t* root = value.buf;
+        uint8_t* end = value.buf + value.len;
+
+        while ((root = std::search(root, end, needle, needle_end)) != end) {
+            macroOffsets.emplace_back(
+                    macro.first,
+                    size_t(root - reinterpret_cast<const uint8_t*>(
+                                          in_doc.buf)));
+            root += macro.second.length();
+        }
     }
 }
 
@@ -340,11 +346,11 @@ protocol_binary_response_status SubdocCmdContext::get_document_for_searching(
     in_datatype = info.datatype;
     in_document_state = info.document_state;
 
-    if (mcbp::datatype::is_snappy(info.datatype)) {
+    if (Datatype::isCompressed(info.datatype)) {
         // Need to expand before attempting to extract from it.
         try {
             using namespace cb::compression;
-            if (!inflate(Algorithm::Snappy,
+            if (!inflate(Datatype::toAlgorithm(info.datatype),
                          in_doc.buf,
                          in_doc.len,
                          inflated_doc_buffer)) {
@@ -94,6 +94,20 @@ public:
 
     ENGINE_ERROR_CODE pre_link_document(item_info& info) override;
 
+    /**
+     * Locate the padded macros in the (now final) document and record
+     * their byte offsets from the start of the document.
+     *
+     * This must be called after all mutations have been applied and the
+     * document has been copied into the item handed to the engine; the
+     * engine stores those exact bytes, so pre_link_document() can later
+     * substitute the real CAS and seqno values straight in at the
+     * recorded offsets without re-parsing the xattr blob. That matters
+     * as pre_link_document() runs while the engine is linking the item
+     * (under its hash bucket lock in ep-engine).
+     */
+    void record_macro_offsets();
+
     /**
      * Get the padded value we want to use for values with macro expansion.
      * Note that the macro name must be evaluated elsewhere as this method
@@ -127,8 +141,8 @@ public:
      * mutations in a multiop, so that you could move the stuff around;
      * replace it; delete it. That means that you would have to go
      * through and relocate all of these offsets after each mutation.
-     * Not impossible, but I don't think it would simplify the logic
-     * that much ;-)
+     * Instead the offsets are located once the document is final, by
+     * record_macro_offsets().
      *
      * @param payload the JSON value for the xattr to perform macro
      *                substitution in
@@ -374,16 +388,18 @@ private:
     template <typename T>
     std::string macroToString(T macroValue);
 
-    void substituteMacro(cb::const_char_buffer macroName,
-                         const std::string& macroValue,
-                         cb::byte_buffer& value);
-
     // The xattr key being accessed in this command
     cb::const_byte_buffer xattr_key;
 
     using MacroPair = std::pair<cb::const_char_buffer, std::string>;
     std::vector<MacroPair> paddedMacros;
 
+    // The offsets (from the start of the document) where the padded
+    // macros were written, recorded by record_macro_offsets() and
+    // patched in place by pre_link_document().
+    using MacroOffset = std::pair<cb::const_char_buffer, size_t>;
+    std::vector<MacroOffset> macroOffsets;
+
     std::string document_vattr;
     std::string xtoc_vattr;
 }; // class SubdocCmdContext
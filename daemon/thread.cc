@@ -4,9 +4,15 @@
  */
 #include "config.h"
 #include "memcached.h"
+#include "buffer_pool.h"
 #include "connections.h"
+#include "hotness.h"
+#include "mc_time.h"
+#include "optrace.h"
 
 #include <atomic>
+#include <limits>
+#include <stdexcept>
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -212,6 +218,27 @@ static void setup_thread(LIBEVENT_THREAD *me) {
     } catch (const std::bad_alloc&) {
         FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for JSON validator");
     }
+
+    try {
+        me->buffer_pool = new BufferPool(settings.getBufferPoolSize());
+    } catch (const std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE,
+                    "Failed to allocate memory for network buffer pool");
+    }
+
+    try {
+        me->optrace = new OpTraceRing();
+    } catch (const std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE,
+                    "Failed to allocate memory for operation trace ring");
+    }
+
+    try {
+        me->hotness = new HotnessSampler();
+    } catch (const std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE,
+                    "Failed to allocate memory for hotness sampler");
+    }
 }
 
 /*
@@ -235,16 +262,6 @@ static void worker_libevent(void *arg) {
     ERR_remove_state(0);
 }
 
-static int number_of_pending(Connection *c, Connection *list) {
-    int rv = 0;
-    for (; list; list = list->getNext()) {
-        if (list == c) {
-            rv ++;
-        }
-    }
-    return rv;
-}
-
 static void drain_notification_channel(evutil_socket_t fd)
 {
     /* Every time we want to notify a thread, we send 1 byte to its
@@ -280,6 +297,90 @@ void dispatch_new_connections(LIBEVENT_THREAD* me) {
     }
 }
 
+/**
+ * Refresh this thread's published activity rate (event loop runs per
+ * second). Cheap enough to call on every wakeup; the rate is rotated at
+ * most once per second.
+ *
+ * @return true if a new measurement window was published
+ */
+static bool refresh_run_rate(LIBEVENT_THREAD* me) {
+    const rel_time_t now = mc_time_get_current_time();
+    const rel_time_t then = me->rate_time.load(std::memory_order_relaxed);
+    if (now == then) {
+        return false;
+    }
+
+    const uint64_t runs = me->event_runs.load(std::memory_order_relaxed);
+    me->run_rate.store(uint32_t((runs - me->runs_snapshot) / (now - then)),
+                       std::memory_order_relaxed);
+    me->runs_snapshot = runs;
+    me->rate_time.store(now, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Get another thread's activity rate; a thread which hasn't refreshed
+ * its rate lately hasn't been woken up, i.e. it is idle.
+ */
+static uint32_t effective_run_rate(LIBEVENT_THREAD* thr, rel_time_t now) {
+    if (now - thr->rate_time.load(std::memory_order_relaxed) > 2) {
+        return 0;
+    }
+    return thr->run_rate.load(std::memory_order_relaxed);
+}
+
+/**
+ * Don't consider shedding connections unless we're running at least
+ * this many event loop runs per second; below that the "imbalance" is
+ * noise.
+ */
+static const uint32_t MINIMUM_MIGRATION_RATE = 100;
+
+/**
+ * If this worker is running at least twice as hot as the calmest
+ * worker, hand one of its idle connections over (placement only acts
+ * on new connections, so a shift in the behavior of long-lived clients
+ * can only be corrected by moving some of them). Called at most once
+ * per second per worker, and each call moves at most one connection,
+ * so a persistent imbalance drains off gradually instead of
+ * oscillating.
+ */
+static void maybe_migrate_connection(LIBEVENT_THREAD* me) {
+    if (nthreads < 2 || memcached_shutdown) {
+        return;
+    }
+
+    const uint32_t myRate = me->run_rate.load(std::memory_order_relaxed);
+    if (myRate < MINIMUM_MIGRATION_RATE) {
+        return;
+    }
+
+    const rel_time_t now = mc_time_get_current_time();
+    LIBEVENT_THREAD* target = nullptr;
+    uint32_t targetRate = 0;
+    for (int ii = 0; ii < nthreads; ++ii) {
+        LIBEVENT_THREAD* thr = &threads[ii];
+        if (thr == me) {
+            continue;
+        }
+        const uint32_t rate = effective_run_rate(thr, now);
+        if (target == nullptr || rate < targetRate ||
+            (rate == targetRate &&
+             thr->conn_count.load(std::memory_order_relaxed) <
+                     target->conn_count.load(std::memory_order_relaxed))) {
+            target = thr;
+            targetRate = rate;
+        }
+    }
+
+    if (target == nullptr || myRate < 2 * targetRate) {
+        return;
+    }
+
+    migrate_idle_connection(me, target);
+}
+
 /*
  * Processes an incoming "handle a new connection" item. This is called when
  * input arrives on the libevent wakeup pipe.
@@ -321,9 +422,11 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
         cb_assert(me == c->getThread());
         pending = pending->getNext();
         c->setNext(nullptr);
+        c->setEnlistedInPendingIo(false);
 
         auto *mcbp = dynamic_cast<McbpConnection*>(c);
         if (mcbp != nullptr) {
+            mcbp->setNotifyTime(ProcessClock::now());
             if (c->getSocketDescriptor() != INVALID_SOCKET &&
                 !mcbp->isRegisteredInLibevent()) {
                 /* The socket may have been shut down while we're looping */
@@ -364,27 +467,15 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
     }
 
     UNLOCK_THREAD(me);
-}
-
-extern volatile rel_time_t current_time;
-
-static bool has_cycle(Connection *c) {
-    Connection *slowNode, *fastNode1, *fastNode2;
 
-    if (!c) {
-        return false;
+    if (refresh_run_rate(me)) {
+        maybe_migrate_connection(me);
+        park_idle_connections(me);
     }
-
-    slowNode = fastNode1 = fastNode2 = c;
-    while (slowNode && (fastNode1 = fastNode2->getNext()) && (fastNode2 = fastNode1->getNext())) {
-        if (slowNode == fastNode1 || slowNode == fastNode2) {
-            return true;
-        }
-        slowNode = slowNode->getNext();
-    }
-    return false;
 }
 
+extern volatile rel_time_t current_time;
+
 bool list_contains(Connection *haystack, Connection *needle) {
     for (; haystack; haystack = haystack->getNext()) {
         if (needle == haystack) {
@@ -413,12 +504,11 @@ Connection * list_remove(Connection *haystack, Connection *needle) {
 static void enlist_conn(Connection *c, Connection **list) {
     LIBEVENT_THREAD *thr = c->getThread();
     cb_assert(list == &thr->pending_io);
-    cb_assert(!list_contains(thr->pending_io, c));
+    cb_assert(!c->isEnlistedInPendingIo());
     cb_assert(c->getNext() == nullptr);
     c->setNext(*list);
+    c->setEnlistedInPendingIo(true);
     *list = c;
-    cb_assert(list_contains(*list, c));
-    cb_assert(!has_cycle(*list));
 }
 
 void notify_io_complete(const void *void_cookie, ENGINE_ERROR_CODE status)
@@ -445,8 +535,13 @@ void notify_io_complete(const void *void_cookie, ENGINE_ERROR_CODE status)
               status);
 
     LOCK_THREAD(thr);
-    cookie->getConnection().setAiostat(status);
-    notify = add_conn_to_pending_io_list(&cookie->getConnection());
+    auto& connection = cookie->getConnection();
+    if (!connection.completeBlockedCommand(*cookie, status)) {
+        // Not a blocked command cookie; the status belongs to the
+        // command the connection is currently executing
+        connection.setAiostat(status);
+    }
+    notify = add_conn_to_pending_io_list(&connection);
     UNLOCK_THREAD(thr);
 
     /* kick the thread in the butt */
@@ -458,12 +553,49 @@ void notify_io_complete(const void *void_cookie, ENGINE_ERROR_CODE status)
 /* Which thread we assigned a connection to most recently. */
 static int last_thread = -1;
 
+/*
+ * Pick the worker thread for a new connection.
+ *
+ * A plain round-robin deal can leave one worker owning several of the
+ * heaviest pipelined clients while another idles, so score each worker
+ * by how busy it has been since the last placement (event loop runs)
+ * plus the number of connections it already owns, and pick the lowest.
+ * The scan starts after the previously chosen thread so that ties
+ * (e.g. an idle system) still degenerate to round-robin. Only ever
+ * called from the dispatcher thread.
+ */
+static int select_thread_for_new_connection() {
+    const int num = settings.getNumWorkerThreads();
+    static std::vector<uint64_t> placement_snapshot;
+    if (placement_snapshot.size() != size_t(num)) {
+        placement_snapshot.resize(num);
+    }
+
+    int best = (last_thread + 1) % num;
+    uint64_t best_score = std::numeric_limits<uint64_t>::max();
+    for (int ii = 0; ii < num; ++ii) {
+        const int tid = (last_thread + 1 + ii) % num;
+        const uint64_t runs =
+                threads[tid].event_runs.load(std::memory_order_relaxed);
+        const uint64_t score =
+                (runs - placement_snapshot[tid]) +
+                threads[tid].conn_count.load(std::memory_order_relaxed);
+        placement_snapshot[tid] = runs;
+        if (score < best_score) {
+            best_score = score;
+            best = tid;
+        }
+    }
+
+    return best;
+}
+
 /*
  * Dispatches a new connection to another thread. This is only ever called
  * from the main thread, or because of an incoming connection.
  */
 void dispatch_conn_new(SOCKET sfd, int parent_port) {
-    int tid = (last_thread + 1) % settings.getNumWorkerThreads();
+    int tid = select_thread_for_new_connection();
     LIBEVENT_THREAD* thread = threads + tid;
     last_thread = tid;
 
@@ -483,6 +615,13 @@ void dispatch_conn_new(SOCKET sfd, int parent_port) {
     notify_thread(thread);
 }
 
+LIBEVENT_THREAD* get_worker_thread(int index) {
+    if (index < 0 || index >= nthreads) {
+        throw std::out_of_range("get_worker_thread: illegal index");
+    }
+    return &threads[index];
+}
+
 /*
  * Returns true if this is the thread that listens for new TCP connections.
  */
@@ -571,8 +710,9 @@ void threads_cleanup(void)
         safe_close(threads[ii].notify[0]);
         safe_close(threads[ii].notify[1]);
         event_base_free(threads[ii].base);
-        threads[ii].read.reset();
-        threads[ii].write.reset();
+        delete threads[ii].buffer_pool;
+        delete threads[ii].optrace;
+        delete threads[ii].hotness;
         subdoc_op_free(threads[ii].subdoc_op);
         delete threads[ii].validator;
         delete threads[ii].new_conn_queue;
@@ -621,7 +761,10 @@ void notify_thread(LIBEVENT_THREAD *thread) {
 int add_conn_to_pending_io_list(Connection *c) {
     int notify = 0;
     auto thread = c->getThread();
-    if (number_of_pending(c, thread->pending_io) == 0) {
+    if (!c->isEnlistedInPendingIo()) {
+        // Only ask for a wakeup if the list was empty; the thread drains
+        // the entire list per wakeup so everyone enqueued behind the
+        // first entry gets picked up by the same notification.
         if (thread->pending_io == NULL) {
             notify = 1;
         }
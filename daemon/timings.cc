@@ -20,11 +20,39 @@
 #include "timing_histogram.h"
 
 Timings::Timings() {
+    for (auto& shard : shards) {
+        shard = nullptr;
+    }
     reset();
 }
 
+Timings::~Timings() {
+    for (auto& shard : shards) {
+        delete shard.load();
+    }
+}
+
 Timings& Timings::operator=(const Timings& other) {
+    // Fold the source's shards into our shared histograms so that the
+    // copy represents the same merged view, and drop anything our own
+    // shards may contain (the source is the authoritative state).
     timings = other.timings;
+    for (const auto& shard : other.shards) {
+        auto* histograms = shard.load(std::memory_order_acquire);
+        if (histograms != nullptr) {
+            for (int ii = 0; ii < MAX_NUM_OPCODES; ++ii) {
+                timings[ii] += (*histograms)[ii];
+            }
+        }
+    }
+    for (auto& shard : shards) {
+        auto* histograms = shard.load(std::memory_order_acquire);
+        if (histograms != nullptr) {
+            for (auto& hist : *histograms) {
+                hist.reset();
+            }
+        }
+    }
     interval_latency_lookups = other.interval_latency_lookups;
     interval_latency_mutations = other.interval_latency_mutations;
     return *this;
@@ -35,6 +63,15 @@ void Timings::reset(void) {
         timings[ii].reset();
     }
 
+    for (auto& shard : shards) {
+        auto* histograms = shard.load(std::memory_order_acquire);
+        if (histograms != nullptr) {
+            for (auto& hist : *histograms) {
+                hist.reset();
+            }
+        }
+    }
+
     {
         std::lock_guard<std::mutex> lg(lock);
         interval_latency_lookups.reset();
@@ -42,16 +79,53 @@ void Timings::reset(void) {
     }
 }
 
-void Timings::collect(const uint8_t opcode,
+TimingHistogram& Timings::get_timings(int thread_index, uint8_t opcode) {
+    if (thread_index < 0) {
+        return timings[opcode];
+    }
+
+    auto& slot = shards[thread_index % TIMINGS_MAX_SHARDS];
+    auto* histograms = slot.load(std::memory_order_acquire);
+    if (histograms == nullptr) {
+        std::lock_guard<std::mutex> lg(shard_allocation_lock);
+        histograms = slot.load(std::memory_order_acquire);
+        if (histograms == nullptr) {
+            histograms = new TimingHistogramArray();
+            slot.store(histograms, std::memory_order_release);
+        }
+    }
+    return (*histograms)[opcode];
+}
+
+void Timings::collect(const int thread_index,
+                      const uint8_t opcode,
                       const std::chrono::nanoseconds nsec) {
-    timings[opcode].add(nsec.count());
+    get_timings(thread_index, opcode).add(nsec.count());
     auto& interval = interval_counters[opcode];
     interval.count++;
     interval.duration_ns += nsec.count();
 }
 
 std::string Timings::generate(const uint8_t opcode) {
-    return timings[opcode].to_string();
+    TimingHistogram merged(timings[opcode]);
+    for (const auto& shard : shards) {
+        auto* histograms = shard.load(std::memory_order_acquire);
+        if (histograms != nullptr) {
+            merged += (*histograms)[opcode];
+        }
+    }
+    return merged.to_string();
+}
+
+uint64_t Timings::get_total(uint8_t opcode) {
+    uint64_t ret = timings[opcode].get_total();
+    for (const auto& shard : shards) {
+        auto* histograms = shard.load(std::memory_order_acquire);
+        if (histograms != nullptr) {
+            ret += (*histograms)[opcode].get_total();
+        }
+    }
+    return ret;
 }
 
 static const uint8_t timings_mutations[] = {
@@ -105,7 +179,7 @@ uint64_t Timings::get_aggregated_mutation_stats() {
 
     uint64_t ret = 0;
     for (auto cmd : timings_mutations) {
-        ret += timings[cmd].get_total();
+        ret += get_total(cmd);
     }
     return ret;
 }
@@ -114,7 +188,7 @@ uint64_t Timings::get_aggregated_retrival_stats() {
 
     uint64_t ret = 0;
     for (auto cmd : timings_retrievals) {
-        ret += timings[cmd].get_total();
+        ret += get_total(cmd);
     }
     return ret;
 }
@@ -18,6 +18,7 @@
 
 #include <platform/platform.h>
 #include <array>
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <cstdint>
@@ -27,17 +28,45 @@
 
 #define MAX_NUM_OPCODES 0x100
 
+/**
+ * The number of histogram shards. Worker threads map onto a shard with
+ * a simple modulo of their thread index, so with more worker threads
+ * than shards a shard may be updated by more than one thread. That is
+ * safe (the histogram counters are relaxed atomics), it just means the
+ * cache lines are shared between a few threads instead of all of them.
+ */
+#define TIMINGS_MAX_SHARDS 64
+
 /** Records timings for each memcached opcode. Each opcode has a histogram of
  * times.
+ *
+ * To avoid all of the worker threads bouncing the histogram cache lines
+ * between the cores on every completed command, the histograms are
+ * sharded by the worker thread index. A shard is allocated the first
+ * time a thread records a timing, and the shards are merged on demand
+ * when someone asks for the data ("stats timings" / mctimings).
  */
 class Timings {
 public:
     Timings(void);
+    ~Timings();
     Timings& operator=(const Timings& other);
     Timings(const Timings&) = delete;
 
     void reset(void);
-    void collect(const uint8_t opcode, const std::chrono::nanoseconds nsec);
+
+    /**
+     * Record a timing sample for the given opcode.
+     *
+     * @param thread_index the index of the worker thread recording the
+     *                     sample (used to pick the histogram shard), or
+     *                     -1 if not running on a worker thread
+     * @param opcode the opcode the timing is for
+     * @param nsec the duration of the operation
+     */
+    void collect(const int thread_index,
+                 const uint8_t opcode,
+                 const std::chrono::nanoseconds nsec);
     void sample(std::chrono::seconds sample_interval);
     std::string generate(const uint8_t opcode);
     uint64_t get_aggregated_mutation_stats();
@@ -46,7 +75,20 @@ public:
     cb::sampling::Interval get_interval_mutation_latency();
     cb::sampling::Interval get_interval_lookup_latency();
 
+    /** Get the total number of samples for the opcode across all shards */
+    uint64_t get_total(uint8_t opcode);
+
 private:
+    using TimingHistogramArray = std::array<TimingHistogram, MAX_NUM_OPCODES>;
+
+    /**
+     * Get the histogram a sample for the given opcode should be added
+     * to, allocating the calling thread's shard if this is the first
+     * sample it records. Samples from non-worker threads (negative
+     * thread index) go into the shared fallback histogram.
+     */
+    TimingHistogram& get_timings(int thread_index, uint8_t opcode);
+
     // This lock is only held by sample() and some blocks within generate().
     // It guards the various IntervalSeries variables which internally
     // contain cb::RingBuffer objects which are not thread safe.
@@ -54,6 +96,18 @@ private:
 
     cb::sampling::IntervalSeries interval_latency_lookups;
     cb::sampling::IntervalSeries interval_latency_mutations;
+
+    // Fallback histograms for samples recorded off the worker threads,
+    // and the destination when another Timings object is assigned to us
     std::array<TimingHistogram, MAX_NUM_OPCODES> timings;
+
+    // Per-worker-thread histogram shards, allocated on first use. The
+    // slots are only ever set (never cleared) while the object is
+    // shared, so readers may traverse the array without the lock.
+    std::array<std::atomic<TimingHistogramArray*>, TIMINGS_MAX_SHARDS> shards;
+
+    // Serializes allocation of the histogram shards
+    std::mutex shard_allocation_lock;
+
     std::array<cb::sampling::Interval, MAX_NUM_OPCODES> interval_counters;
 };
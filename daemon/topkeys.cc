@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <unordered_map>
 #include <sys/types.h>
 #include <stdlib.h>
 #include <inttypes.h>
@@ -31,60 +32,55 @@
  *
  * === TopKeys ===
  *
- * The TopKeys class is split into NUM_SHARDS shards, each which owns
- * 1/NUM_SHARDS of the keyspace. This is to allow some level of
- * concurrent access - each shard has a mutex guarding all access.
- * Other than that the TopKeys class is pretty uninteresting - it
- * simply passes on requests to the correct Shard, and when statistics
- * are requested it aggregates information from each shard.
+ * The TopKeys class is split into NUM_SHARDS shards, each being a
+ * small Space-Saving summary. Unlike the original implementation the
+ * shards are *not* slices of the keyspace - each worker thread
+ * updates its own shard (selected by the thread index), so on the op
+ * path a thread only ever touches its own summary and the per-shard
+ * mutex is effectively uncontended. The price is paid when the
+ * statistics are requested: the same key may be present in several
+ * shards, so the stats functions merge the summaries (summing the
+ * access counts for matching keys) before reporting.
  *
  * === TopKeys::Shard ===
  *
- * This is where the action happens. Each Shard maintains an ordered
- * list of key names and related statistics, orded by when they were
- * last accessed. There is a fixed number of keys each Shard tracks.
-
+ * This is where the action happens. Each Shard maintains a fixed
+ * number of keys and an estimated access count for each of them,
+ * using the Space-Saving algorithm.
+ *
  * Given we generally track only a small number of keys per shard (10
  * by default), it's highly likely that any one key access will 'miss'
  * - i.e. not find an existing topkey. Therefore this class is
  * optimized for that case, attempting to minimise memory allocation
  * in steady-state.
  *
- * Internally Shard consists of a vector of topkey_t, storing the
- * current max_keys top_keys, and a list of topkey_t pointers, used to
- * main the current most -> least recently used ordering:
-
- * max_keys elements. Each element is a tuple of
- * {hash(key), key, topkey_stats}:
- *
+ * Internally Shard consists of a vector of topkey_t of up to max_keys
+ * elements. Each element is a tuple of {hash(key), key, topkey_stats}:
  *
  *       vector<topkey_t>
  *   +----------+-------------+---------------+
  *   | size_t   | std::string | topkey_item_t |
  *   +----------+-------------+---------------+
- *   | <hash 1> | <key 1>     | stats 1       | <--- Node1
- *   | <hash 2> | <key 2>     | stats 2       | <--- Node2
- *   | <hash 3> | <key 3>     | stats 3       | <--- Node3
+ *   | <hash 1> | <key 1>     | stats 1       |
+ *   | <hash 2> | <key 2>     | stats 2       |
  *   . ....                                   .
- *   | <hash N> | <key N>     | stats N       | <--- NodeN
+ *   | <hash N> | <key N>     | stats N       |
  *   +----------------------------------------+
  *
- *   Node3 <---> Node1 <---> ... <---> Node2
- *   ^^^                               ^^^
- *   MRU                               LRU
- *
- *
  * Upon a key 'hit', TopKeys::updateKey() is called. That hashes the
- * key, and finds the Shard responsible for that
- * key. TopKeys::Shard::updateKey() is then called.
+ * key, and selects the Shard belonging to the calling worker
+ * thread. TopKeys::Shard::updateKey() is then called.
  *
  * Shard::updateKey() iterates over the vector, searching for a hash
  * match with an existing element, using the actual key string to
  * validate (in case of a hash collision). If it is found, then the
- * stats are simply updated.  If it is not found, then the
- * least-recently-used element is selected as a 'victim' and it's
- * contents is replaced by the incoming key.  Finally the linked-list
- * is updated to move the updated element to the head of the list.
+ * access count is simply incremented. If it is not found, then the
+ * element with the smallest estimated count is selected as a 'victim'
+ * and it's contents is replaced by the incoming key, which inherits
+ * the victim's count (recorded in ti_error as the maximum
+ * overestimate). This is the Space-Saving scheme: frequently accessed
+ * keys are guaranteed to be retained, while one-off accesses just
+ * cycle through the victim slot.
  */
 
 
@@ -97,11 +93,13 @@ TopKeys::TopKeys(int mkeys) {
 TopKeys::~TopKeys() {
 }
 
-TopKeys::Shard& TopKeys::getShard(size_t key_hash) {
-    /* This is special-cased for 8 */
-    static_assert(NUM_SHARDS == 8,
-                  "Topkeys::getShard() special-cased for SHARDS==8");
-    return shards[key_hash & 0x7];
+TopKeys::Shard& TopKeys::getShard(int thread_index) {
+    static_assert((NUM_SHARDS & (NUM_SHARDS - 1)) == 0,
+                  "Topkeys::getShard() assumes NUM_SHARDS is a power of two");
+    if (thread_index < 0) {
+        thread_index = 0;
+    }
+    return shards[thread_index & (NUM_SHARDS - 1)];
 }
 
 TopKeys::Shard::topkey_t*
@@ -132,16 +130,24 @@ bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
         if (found_key == NULL) {
             // Key not found.
             if (storage.size() == max_keys) {
-                // Re-use the lowest keys' storage.
-                found_key = list.back();
+                // Evict the entry with the smallest estimated count
+                // and let the new key inherit its count
+                // (Space-Saving). The inherited count is recorded as
+                // the error so the true count is known to be in
+                // [count - error, count].
+                found_key = &storage.front();
+                for (auto& topkey : storage) {
+                    if (topkey.second.ti_access_count <
+                        found_key->second.ti_access_count) {
+                        found_key = &topkey;
+                    }
+                }
+                const int min_count = found_key->second.ti_access_count;
                 found_key->first.hash = key_hash;
                 found_key->first.key.assign(key.buf, key.len);
                 found_key->second = topkey_item_t(ct);
-
-                // Move back element to the front, shuffling down the
-                // rest.
-                list.splice(list.begin(), list, --list.end());
-
+                found_key->second.ti_access_count = min_count;
+                found_key->second.ti_error = min_count;
             } else {
                 // add a new element to the storage array.
 
@@ -150,15 +156,7 @@ bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
                                          std::string(key.buf, key.len)},
                                    topkey_item_t(ct)));
                 found_key = &storage.back();
-
-                // Insert the new item to the front of the list
-                list.push_front(found_key);
             }
-        } else {
-            // Found - shuffle to the front.
-            auto it = std::find(list.begin(), list.end(),
-                                found_key);
-            list.splice(list.begin(), list, it);
         }
 
         // Increment access count.
@@ -173,7 +171,8 @@ bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
 
 void TopKeys::doUpdateKey(const void* key,
                           size_t nkey,
-                          rel_time_t operation_time) {
+                          rel_time_t operation_time,
+                          int thread_index) {
     cb_assert(key);
     cb_assert(nkey > 0);
 
@@ -182,7 +181,7 @@ void TopKeys::doUpdateKey(const void* key,
         std::hash<cb::const_char_buffer > hash_fn;
         const size_t key_hash = hash_fn(key_buf);
 
-        getShard(key_hash).updateKey(key_buf, key_hash, operation_time);
+        getShard(thread_index).updateKey(key_buf, key_hash, operation_time);
     } catch (const std::bad_alloc&) {
         // Failed to increment topkeys, continue...
     }
@@ -246,14 +245,56 @@ static void tk_jsonfunc(const std::string& key, const topkey_item_t& it,
     cJSON_AddItemToArray(c->array, obj);
 }
 
+/**
+ * Merge visitor; accumulates the entries from all of the per-thread
+ * summaries into a single map, summing the access counts (and error
+ * bounds) for keys present in more than one summary. The creation
+ * time is taken from the oldest entry.
+ */
+static void tk_mergefunc(const std::string& key, const topkey_item_t& it,
+                         void* arg) {
+    auto& merged =
+            *static_cast<std::unordered_map<std::string, topkey_item_t>*>(arg);
+    auto result = merged.emplace(key, it);
+    if (!result.second) {
+        auto& existing = result.first->second;
+        existing.ti_access_count += it.ti_access_count;
+        existing.ti_error += it.ti_error;
+        existing.ti_ctime = std::min(existing.ti_ctime, it.ti_ctime);
+    }
+}
+
+void TopKeys::visit_merged(Shard::iterfunc_t visitor_func, void* visitor_ctx) {
+    std::unordered_map<std::string, topkey_item_t> merged;
+    for (auto& shard : shards) {
+        shard.accept_visitor(tk_mergefunc, &merged);
+    }
+
+    // Report the keys ordered by descending (estimated) access count.
+    std::vector<const std::pair<const std::string, topkey_item_t>*> sorted;
+    sorted.reserve(merged.size());
+    for (const auto& entry : merged) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(),
+              sorted.end(),
+              [](const std::pair<const std::string, topkey_item_t>* a,
+                 const std::pair<const std::string, topkey_item_t>* b) {
+                  return a->second.ti_access_count >
+                         b->second.ti_access_count;
+              });
+
+    for (const auto* entry : sorted) {
+        visitor_func(entry->first, entry->second, visitor_ctx);
+    }
+}
+
 ENGINE_ERROR_CODE TopKeys::doStats(const void* cookie,
                                    rel_time_t current_time,
                                    ADD_STAT add_stat) {
     struct tk_context context(cookie, add_stat, current_time, nullptr);
 
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_iterfunc, &context);
-    }
+    visit_merged(tk_iterfunc, &context);
 
     return ENGINE_SUCCESS;
 }
@@ -274,9 +315,7 @@ ENGINE_ERROR_CODE TopKeys::do_json_stats(cJSON* object,
     struct tk_context context(nullptr, nullptr, current_time, topkeys);
 
     /* Collate the topkeys JSON object */
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_jsonfunc, &context);
-    }
+    visit_merged(tk_jsonfunc, &context);
 
     cJSON_AddItemToObject(object, "topkeys", topkeys);
     return ENGINE_SUCCESS;
@@ -285,7 +324,7 @@ ENGINE_ERROR_CODE TopKeys::do_json_stats(cJSON* object,
 void TopKeys::Shard::accept_visitor(iterfunc_t visitor_func,
                                     void* visitor_ctx) {
     std::lock_guard<std::mutex> lock(mutex);
-    for (const auto key : list) {
-        visitor_func(key->first.key, key->second, visitor_ctx);
+    for (const auto& key : storage) {
+        visitor_func(key.first.key, key.second, visitor_ctx);
     }
 }
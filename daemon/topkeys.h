@@ -25,14 +25,13 @@
 #include <cJSON.h>
 
 #include <mutex>
-#include <list>
 #include <string>
 #include <vector>
 
 /*
  * TopKeys
  *
- * Tracks the top N most recently accessed keys. The details are
+ * Tracks the most frequently accessed keys. The details are
  * accessible by a stats call, which is used by ns_server to print the
  * top keys list in the GUI.
  */
@@ -40,10 +39,13 @@
 struct topkey_item_t {
     topkey_item_t(rel_time_t create_time)
         : ti_ctime(create_time),
-          ti_access_count(0) { }
+          ti_access_count(0),
+          ti_error(0) { }
 
     rel_time_t ti_ctime; /* Time this item was created */
     int ti_access_count; /* Int count for number of times key has been accessed */
+    int ti_error; /* Maximum overestimate of ti_access_count (the count the
+                     evicted entry had when this key took over its slot) */
 };
 
 /* Class to track the "top" keys in a bucket.
@@ -51,15 +53,25 @@ struct topkey_item_t {
 class TopKeys {
 public:
     /* Constructor.
-     * @param mkeys Number of keys stored in each shard (i.e. up to
-     * mkeys * SHARDS will be tracked).
+     * @param mkeys Number of keys stored in each per-thread summary
+     * (i.e. up to mkeys * number of worker threads will be tracked).
      */
     explicit TopKeys(int mkeys);
     ~TopKeys();
 
-    void updateKey(const void* key, size_t nkey, rel_time_t operation_time) {
+    /**
+     * Record an access of the given key.
+     *
+     * @param thread_index index of the worker thread performing the
+     *        operation; used to select the thread-private summary so
+     *        that the op path never contends with other threads.
+     */
+    void updateKey(const void* key,
+                   size_t nkey,
+                   rel_time_t operation_time,
+                   int thread_index = 0) {
         if (settings.isTopkeysEnabled()) {
-            doUpdateKey(key, nkey, operation_time);
+            doUpdateKey(key, nkey, operation_time, thread_index);
         }
     }
 
@@ -96,7 +108,10 @@ public:
     }
 
 protected:
-    void doUpdateKey(const void* key, size_t nkey, rel_time_t operation_time);
+    void doUpdateKey(const void* key,
+                     size_t nkey,
+                     rel_time_t operation_time,
+                     int thread_index);
 
     ENGINE_ERROR_CODE doStats(const void* cookie,
                               rel_time_t current_time,
@@ -105,31 +120,34 @@ protected:
     ENGINE_ERROR_CODE do_json_stats(cJSON* object, rel_time_t current_time);
 
 private:
-    // Number of shards the keyspace is broken into. Permits some level of
-    // concurrent update (there is one mutex per shard).
-    static const int NUM_SHARDS = 8;
+    // Number of Space-Saving summaries. Worker threads map onto a
+    // summary with a simple modulo of their thread index, so each
+    // thread normally has its own summary and its mutex is
+    // uncontended on the op path (the mutex is only shared with the
+    // stats reader, and with other threads if there are more than
+    // NUM_SHARDS worker threads).
+    static const int NUM_SHARDS = 64;
 
     class Shard;
 
-    Shard& getShard(size_t key_hash);
+    Shard& getShard(int thread_index);
 
-    // One of N Shards which the keyspace has been broken
-    // into.
-    // Responsible for tracking the top {mkeys} within it's keyspace.
+    // A Space-Saving summary of the keys accessed by (normally) one
+    // worker thread. Tracks the (approximately) {mkeys} most
+    // frequently accessed keys within it's slice of the traffic.
     class Shard {
     public:
 
         void setMaxKeys(int mkeys) {
             max_keys = mkeys;
             storage.reserve(max_keys);
-            // reallocating storage invalidates the LRU list.
-            list.clear();
         }
 
         // Updates the topkey 'ranking' for the specified key.
-        // If the item does not exist it will be created (with it's creation
-        // time set to operation_time), otherwise the existing item will be
-        // updated.
+        // If the item is not tracked and the summary is full, the
+        // entry with the smallest estimated count is evicted and its
+        // count inherited (Space-Saving), so a newly hot key can't be
+        // starved out by stale entries.
         // On success returns true, If insufficient memory to create a
         // new item, returns false.
         bool updateKey(const cb::const_char_buffer& key,
@@ -154,9 +172,6 @@ private:
         // Pair of the key's string and the statistics related to it.
         typedef std::pair<KeyId, topkey_item_t> topkey_t;
 
-        // An ordered list of topkey_t*, used for LRU.
-        typedef std::list<topkey_t*> key_history_t;
-
         // Vector topket_t, used for actual topke storage.
         typedef std::vector<topkey_t> key_storage_t;
 
@@ -170,14 +185,16 @@ private:
         // mutex to serial access to this shard.
         std::mutex mutex;
 
-        // list of keys, ordered from most-recently used (front) to least recently
-        // used (back).
-        key_history_t list;
-
         // Underlying topkey storage.
         key_storage_t storage;
     };
 
-    // array of topkey shards.
+    // The same key may be tracked by several of the per-thread
+    // summaries, so the stats functions merge the summaries (summing
+    // the counts for matching keys) before invoking the visitor,
+    // ordered by descending access count.
+    void visit_merged(Shard::iterfunc_t visitor_func, void* visitor_ctx);
+
+    // array of per-thread topkey summaries.
     std::array<Shard, NUM_SHARDS> shards;
 };
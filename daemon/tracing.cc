@@ -56,7 +56,7 @@ void erase_if(ContainerT& items, const PredicateT& predicate) {
 
 Task::Status StaleTraceDumpRemover::periodicExecute() {
     {
-        const auto now = ProcessClock::now();
+        const auto now = mc_time_get_coarse_steady_time();
         std::lock_guard<std::mutex> lh(traceDumps.mutex);
 
         using value_type = decltype(TraceDumps::dumps)::value_type;
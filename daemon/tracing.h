@@ -24,6 +24,7 @@
 #include <phosphor/tools/export.h>
 #include <stddef.h>
 
+#include "mc_time.h"
 #include "memcached.h"
 #include "utilities/string_utilities.h"
 
@@ -45,7 +46,7 @@ struct DumpContext {
     DumpContext(phosphor::TraceContext&& _context)
         : context(std::move(_context)),
           json_export(context),
-          last_touch(ProcessClock::now()) {
+          last_touch(mc_time_get_coarse_steady_time()) {
     }
 
     // Moving is dangerous as json_export contains a reference to
@@ -0,0 +1,176 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "vbucket_timings.h"
+
+#include <memcached/protocol_binary.h>
+
+#include <string>
+
+const std::array<uint32_t, VBucketTimings::num_bands - 1>
+        VBucketTimings::band_upper_us = {
+                {100, 250, 500, 1000, 5000, 25000, 100000}};
+
+/**
+ * Map an opcode onto the operation class it is tracked under, or
+ * return false for the (many) opcodes the heatmap does not track.
+ */
+static bool classify(uint8_t opcode, VBucketTimings::OpClass& oc) {
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_GET:
+    case PROTOCOL_BINARY_CMD_GETQ:
+    case PROTOCOL_BINARY_CMD_GETK:
+    case PROTOCOL_BINARY_CMD_GETKQ:
+    case PROTOCOL_BINARY_CMD_GAT:
+    case PROTOCOL_BINARY_CMD_GATQ:
+    case PROTOCOL_BINARY_CMD_GET_LOCKED:
+    case PROTOCOL_BINARY_CMD_GET_REPLICA:
+    case PROTOCOL_BINARY_CMD_SUBDOC_GET:
+    case PROTOCOL_BINARY_CMD_SUBDOC_EXISTS:
+    case PROTOCOL_BINARY_CMD_SUBDOC_MULTI_LOOKUP:
+        oc = VBucketTimings::OpClass::Lookup;
+        return true;
+    case PROTOCOL_BINARY_CMD_SET:
+    case PROTOCOL_BINARY_CMD_SETQ:
+    case PROTOCOL_BINARY_CMD_ADD:
+    case PROTOCOL_BINARY_CMD_ADDQ:
+    case PROTOCOL_BINARY_CMD_REPLACE:
+    case PROTOCOL_BINARY_CMD_REPLACEQ:
+    case PROTOCOL_BINARY_CMD_APPEND:
+    case PROTOCOL_BINARY_CMD_APPENDQ:
+    case PROTOCOL_BINARY_CMD_PREPEND:
+    case PROTOCOL_BINARY_CMD_PREPENDQ:
+    case PROTOCOL_BINARY_CMD_DELETE:
+    case PROTOCOL_BINARY_CMD_DELETEQ:
+    case PROTOCOL_BINARY_CMD_INCREMENT:
+    case PROTOCOL_BINARY_CMD_INCREMENTQ:
+    case PROTOCOL_BINARY_CMD_DECREMENT:
+    case PROTOCOL_BINARY_CMD_DECREMENTQ:
+    case PROTOCOL_BINARY_CMD_TOUCH:
+    case PROTOCOL_BINARY_CMD_SUBDOC_DICT_ADD:
+    case PROTOCOL_BINARY_CMD_SUBDOC_DICT_UPSERT:
+    case PROTOCOL_BINARY_CMD_SUBDOC_DELETE:
+    case PROTOCOL_BINARY_CMD_SUBDOC_REPLACE:
+    case PROTOCOL_BINARY_CMD_SUBDOC_COUNTER:
+    case PROTOCOL_BINARY_CMD_SUBDOC_MULTI_MUTATION:
+        oc = VBucketTimings::OpClass::Mutation;
+        return true;
+    default:
+        return false;
+    }
+}
+
+VBucketTimings::~VBucketTimings() {
+    delete table.load(std::memory_order_acquire);
+}
+
+VBucketTimings::Table* VBucketTimings::getTable() {
+    auto* ret = table.load(std::memory_order_acquire);
+    if (ret == nullptr) {
+        std::lock_guard<std::mutex> guard(allocation_lock);
+        ret = table.load(std::memory_order_acquire);
+        if (ret == nullptr) {
+            ret = new Table();
+            table.store(ret, std::memory_order_release);
+        }
+    }
+    return ret;
+}
+
+void VBucketTimings::collect(int thread_index,
+                             uint8_t opcode,
+                             uint16_t vbucket,
+                             std::chrono::nanoseconds nsec) {
+    OpClass oc;
+    if (vbucket >= max_vbuckets || !classify(opcode, oc)) {
+        return;
+    }
+
+    // The cost of the common path is this increment of a (mostly)
+    // thread-private counter
+    auto& opcount = opcounts[(thread_index < 0 ? 0 : thread_index) %
+                             opcounts.size()];
+    if (++opcount % sample_one_in != 0) {
+        return;
+    }
+
+    const auto usec = uint64_t(
+            std::chrono::duration_cast<std::chrono::microseconds>(nsec)
+                    .count());
+    size_t band = 0;
+    while (band < band_upper_us.size() && usec >= band_upper_us[band]) {
+        ++band;
+    }
+
+    getTable()->counts[size_t(oc)][vbucket][band] += 1;
+}
+
+unique_cJSON_ptr VBucketTimings::report() const {
+    unique_cJSON_ptr ret(cJSON_CreateObject());
+    if (ret.get() == nullptr) {
+        return ret;
+    }
+
+    cJSON_AddNumberToObject(ret.get(), "sample_one_in", sample_one_in);
+    cJSON* bands = cJSON_CreateArray();
+    for (const auto upper : band_upper_us) {
+        cJSON_AddItemToArray(bands, cJSON_CreateNumber(upper));
+    }
+    cJSON_AddItemToObject(ret.get(), "band_upper_us", bands);
+
+    const auto* tbl = table.load(std::memory_order_acquire);
+    static const char* class_names[2] = {"lookup", "mutation"};
+    for (size_t oc = 0; oc < 2; ++oc) {
+        cJSON* heatmap = cJSON_CreateObject();
+        if (tbl != nullptr) {
+            for (size_t vb = 0; vb < max_vbuckets; ++vb) {
+                const auto& counters = tbl->counts[oc][vb];
+                uint64_t total = 0;
+                for (const auto& counter : counters) {
+                    total += counter.load();
+                }
+                if (total == 0) {
+                    continue;
+                }
+                cJSON* row = cJSON_CreateArray();
+                for (const auto& counter : counters) {
+                    cJSON_AddItemToArray(row,
+                                         cJSON_CreateNumber(counter.load()));
+                }
+                cJSON_AddItemToObject(heatmap,
+                                      std::to_string(vb).c_str(),
+                                      row);
+            }
+        }
+        cJSON_AddItemToObject(ret.get(), class_names[oc], heatmap);
+    }
+
+    return ret;
+}
+
+void VBucketTimings::reset() {
+    auto* tbl = table.load(std::memory_order_acquire);
+    if (tbl == nullptr) {
+        return;
+    }
+    for (auto& perclass : tbl->counts) {
+        for (auto& pervb : perclass) {
+            for (auto& counter : pervb) {
+                counter.reset();
+            }
+        }
+    }
+}
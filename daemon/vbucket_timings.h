@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <relaxed_atomic.h>
+
+#include <cJSON_utils.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Per-vbucket operation latency heatmap.
+ *
+ * Timings aggregates latency per opcode per bucket, so a latency event
+ * cannot be localized any further than "the bucket": one sick vbucket
+ * (compaction, a hot key, a slow disk on its shard) and a uniform
+ * slowdown look the same. This class additionally keeps a handful of
+ * coarse latency bands per vbucket for the basic lookup and mutation
+ * opcodes, sampled one in every N commands to bound the cost, so the
+ * distribution can be dumped as a compact heatmap ("stats
+ * vbucket_timings") and a spike immediately attributed to a
+ * vbucket/shard.
+ *
+ * The counter table (two op classes x 1024 vbuckets x a few bands) is
+ * allocated on the first sample, so buckets which never see traffic
+ * don't pay for it. The counters are relaxed atomics and, as with the
+ * timing histograms, a reader may observe a heatmap which is being
+ * updated; for a statistical facility that is fine.
+ */
+class VBucketTimings {
+public:
+    /// Operation classes tracked per vbucket
+    enum class OpClass : uint8_t { Lookup = 0, Mutation = 1 };
+
+    /// The number of latency bands in the heatmap
+    static const size_t num_bands = 8;
+
+    /// The number of vbuckets tracked (vbuckets above this are ignored)
+    static const size_t max_vbuckets = 1024;
+
+    /// Record one in every this many classified commands
+    static const uint32_t sample_one_in = 16;
+
+    /**
+     * Upper bound (in microseconds) of each band except the last,
+     * which is unbounded
+     */
+    static const std::array<uint32_t, num_bands - 1> band_upper_us;
+
+    VBucketTimings() {
+    }
+    ~VBucketTimings();
+
+    VBucketTimings(const VBucketTimings&) = delete;
+    VBucketTimings& operator=(const VBucketTimings&) = delete;
+
+    /**
+     * Account for a completed command, recording it in the heatmap if
+     * it is a tracked opcode and falls on the sampling grid.
+     *
+     * @param thread_index the index of the worker thread (used to pick
+     *                     the sampling counter), or -1
+     * @param opcode the opcode of the command
+     * @param vbucket the vbucket the command addressed
+     * @param nsec the duration of the command
+     */
+    void collect(int thread_index,
+                 uint8_t opcode,
+                 uint16_t vbucket,
+                 std::chrono::nanoseconds nsec);
+
+    /**
+     * Generate the heatmap.
+     *
+     * @return JSON of the form
+     *         {"sample_one_in":N, "band_upper_us":[...],
+     *          "lookup":{"<vbid>":[<count per band>],...},
+     *          "mutation":{"<vbid>":[<count per band>],...}}
+     *         where only vbuckets with at least one sample appear
+     */
+    unique_cJSON_ptr report() const;
+
+    /// Discard all recorded samples
+    void reset();
+
+private:
+    using BandCounters =
+            std::array<Couchbase::RelaxedAtomic<uint32_t>, num_bands>;
+
+    struct Table {
+        std::array<std::array<BandCounters, max_vbuckets>, 2> counts;
+    };
+
+    /**
+     * Get the counter table, allocating it if this is the first sample
+     * recorded
+     */
+    Table* getTable();
+
+    // Allocated on first use; only ever set (never cleared) so readers
+    // may use an acquire load without the lock
+    std::atomic<Table*> table{nullptr};
+
+    // Serializes allocation of the counter table
+    std::mutex allocation_lock;
+
+    // Sampling counters, sharded by worker thread index to keep the
+    // common (not sampled) path from bouncing a shared cache line
+    std::array<Couchbase::RelaxedAtomic<uint32_t>, 64> opcounts;
+};
@@ -44,6 +44,13 @@ struct Assoc {
     /* Flag: Are we in the middle of expanding now? */
     bool expanding{false};
 
+    /*
+     * Flag: an expansion has been handed to the maintenance thread, but the
+     * new (larger) table hasn't been installed yet. Suppresses further
+     * expansion requests while the thread allocates the new bucket array.
+     */
+    bool expansion_scheduled{false};
+
     /*
      * During expansion we migrate values with bucket granularity; this is how
      * far we've gotten so far. Ranges from 0 .. hashsize(hashpower - 1) - 1.
@@ -85,7 +92,7 @@ ENGINE_ERROR_CODE assoc_init(struct default_engine *engine) {
 
 void assoc_destroy() {
     if (global_assoc != nullptr) {
-        while (global_assoc->expanding) {
+        while (global_assoc->expanding || global_assoc->expansion_scheduled) {
             usleep(250);
         }
         delete global_assoc;
@@ -158,26 +165,17 @@ static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
 static void assoc_maintenance_thread(void *arg);
 
 /*
-    grows the hashtable to the next power of 2.
+    schedules growing of the hashtable to the next power of 2.
+    The allocation of the new bucket array and the migration both happen on
+    the maintenance thread (with front-end operations chipping in), so no
+    single operation pays for the whole expansion.
     assoc->lock is assumed to be held by the caller.
 */
 static void assoc_expand() {
-    global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
-
-    try {
-        global_assoc->primary_hashtable.resize(hashsize(global_assoc->hashpower + 1));
-    } catch (const std::bad_alloc&) {
-        global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
-        /* Bad news, but we can keep running. */
-        return;
-    }
-
     int ret = 0;
     cb_thread_t tid;
 
-    global_assoc->hashpower++;
-    global_assoc->expanding = true;
-    global_assoc->expand_bucket = 0;
+    global_assoc->expansion_scheduled = true;
 
     /* start a thread to do the expansion */
     if ((ret = cb_create_named_thread(&tid, assoc_maintenance_thread,
@@ -187,11 +185,60 @@ static void assoc_expand() {
             logger->log(EXTENSION_LOG_WARNING, NULL,
                         "Can't create thread: %s", cb_strerror().c_str());
         }
-        global_assoc->hashpower--;
+        global_assoc->expansion_scheduled = false;
+    }
+}
+
+/*
+    migrates one bucket of items from the old to the primary hashtable.
+    assoc->lock is assumed to be held by the caller, and an expansion must
+    be in progress.
+*/
+static void assoc_migrate_bucket() {
+    hash_item *it, *next;
+    int bucket;
+
+    for (it = global_assoc->old_hashtable[global_assoc->expand_bucket];
+         NULL != it; it = next) {
+        next = it->h_next;
+        const hash_key* key = item_get_key(it);
+        bucket = crc32c(hash_key_get_key(key),
+                        hash_key_get_key_len(key),
+                        0) & hashmask(global_assoc->hashpower);
+        it->h_next = global_assoc->primary_hashtable[bucket];
+        global_assoc->primary_hashtable[bucket] = it;
+    }
+
+    global_assoc->old_hashtable[global_assoc->expand_bucket] = NULL;
+    global_assoc->expand_bucket++;
+    if (global_assoc->expand_bucket == hashsize(global_assoc->hashpower - 1)) {
         global_assoc->expanding = false;
-        global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
         global_assoc->old_hashtable.resize(0);
         global_assoc->old_hashtable.shrink_to_fit();
+        if (logger != nullptr) {
+            logger->log(EXTENSION_LOG_INFO, NULL,
+                        "Hash table expansion done");
+        }
+    }
+}
+
+/*
+ * How many buckets a mutating front-end operation migrates when an
+ * expansion is in progress. This bounds the time an expansion can take to
+ * complete even if the maintenance thread is starved, at a small and
+ * constant cost per operation.
+ */
+#define DEFAULT_HASH_FOREGROUND_MOVE 2
+int hash_foreground_move = DEFAULT_HASH_FOREGROUND_MOVE;
+
+/*
+    helps an in-progress expansion along from a front-end operation.
+    assoc->lock is assumed to be held by the caller.
+*/
+static void assoc_help_expansion() {
+    int ii;
+    for (ii = 0; ii < hash_foreground_move && global_assoc->expanding; ++ii) {
+        assoc_migrate_bucket();
     }
 }
 
@@ -202,6 +249,7 @@ int assoc_insert(uint32_t hash, hash_item *it) {
     cb_assert(assoc_find(hash, item_get_key(it)) == 0);  /* shouldn't have duplicately named things defined */
 
     std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    assoc_help_expansion();
     if (global_assoc->expanding &&
         (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
     {
@@ -213,7 +261,8 @@ int assoc_insert(uint32_t hash, hash_item *it) {
     }
 
     global_assoc->hash_items++;
-    if (! global_assoc->expanding && global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2) {
+    if (! global_assoc->expanding && ! global_assoc->expansion_scheduled &&
+        global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2) {
         assoc_expand();
     }
     MEMCACHED_ASSOC_INSERT(hash_key_get_key(item_get_key(it)), hash_key_get_key_len(item_get_key(it)), global_assoc->hash_items);
@@ -222,6 +271,7 @@ int assoc_insert(uint32_t hash, hash_item *it) {
 
 void assoc_delete(uint32_t hash, const hash_key *key) {
     std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    assoc_help_expansion();
     hash_item **before = _hashitem_before(hash, key);
 
     if (*before) {
@@ -249,39 +299,46 @@ void assoc_delete(uint32_t hash, const hash_key *key) {
 int hash_bulk_move = DEFAULT_HASH_BULK_MOVE;
 
 static void assoc_maintenance_thread(void *arg) {
+    /*
+     * Allocate (and zero) the new bucket array without holding the lock;
+     * at a large hashpower this is by far the most expensive part of an
+     * expansion and used to stall every front-end operation.
+     */
+    unsigned int new_hashpower;
+    {
+        std::lock_guard<std::mutex> guard(global_assoc->mutex);
+        new_hashpower = global_assoc->hashpower + 1;
+    }
+
+    std::vector<hash_item*> new_hashtable;
+    try {
+        new_hashtable.resize(hashsize(new_hashpower));
+    } catch (const std::bad_alloc&) {
+        /* Bad news, but we can keep running with the table we have. */
+        std::lock_guard<std::mutex> guard(global_assoc->mutex);
+        global_assoc->expansion_scheduled = false;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(global_assoc->mutex);
+        global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
+        global_assoc->primary_hashtable.swap(new_hashtable);
+        global_assoc->hashpower = new_hashpower;
+        global_assoc->expanding = true;
+        global_assoc->expand_bucket = 0;
+    }
+
     bool done = false;
     do {
         int ii;
         std::lock_guard<std::mutex> guard(global_assoc->mutex);
 
         for (ii = 0; ii < hash_bulk_move && global_assoc->expanding; ++ii) {
-            hash_item *it, *next;
-            int bucket;
-
-            for (it = global_assoc->old_hashtable[global_assoc->expand_bucket];
-                 NULL != it; it = next) {
-                next = it->h_next;
-                const hash_key* key = item_get_key(it);
-                bucket = crc32c(hash_key_get_key(key),
-                                hash_key_get_key_len(key),
-                                0) & hashmask(global_assoc->hashpower);
-                it->h_next = global_assoc->primary_hashtable[bucket];
-                global_assoc->primary_hashtable[bucket] = it;
-            }
-
-            global_assoc->old_hashtable[global_assoc->expand_bucket] = NULL;
-            global_assoc->expand_bucket++;
-            if (global_assoc->expand_bucket == hashsize(global_assoc->hashpower - 1)) {
-                global_assoc->expanding = false;
-                global_assoc->old_hashtable.resize(0);
-                global_assoc->old_hashtable.shrink_to_fit();
-                if (logger != nullptr) {
-                    logger->log(EXTENSION_LOG_INFO, NULL,
-                                "Hash table expansion done");
-                }
-            }
+            assoc_migrate_bucket();
         }
         if (!global_assoc->expanding) {
+            global_assoc->expansion_scheduled = false;
             done = true;
         }
     } while (!done);
@@ -289,5 +346,5 @@ static void assoc_maintenance_thread(void *arg) {
 
 bool assoc_expanding() {
     std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    return global_assoc->expanding;
+    return global_assoc->expanding || global_assoc->expansion_scheduled;
 }
@@ -47,6 +47,12 @@ struct default_engine;
 /** The item is deleted (may only be accessed if explicitly asked for) */
 #define ITEM_ZOMBIE (4)
 
+/** The item has been referenced since it was last linked into the LRU.
+    Set lazily on access instead of splicing the item to the head of its
+    queue; honoured by the eviction scan in do_item_alloc() which gives
+    marked items a second chance. */
+#define ITEM_ACCESSED (8)
+
 struct config {
    size_t verbose;
    rel_time_t oldest_live;
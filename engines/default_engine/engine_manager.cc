@@ -78,6 +78,13 @@ void EngineManager::scrubEngine(struct default_engine* engine) {
     }
 }
 
+void EngineManager::rebalanceEngine(struct default_engine* engine) {
+    std::lock_guard<std::mutex> lck(lock);
+    if (!shuttingdown) {
+        scrubberTask.placeOnRebalanceQueue(engine);
+    }
+}
+
 void EngineManager::waitForScrubberToBeIdle(std::unique_lock<std::mutex>& lck) {
     if (!lck.owns_lock()) {
         throw std::logic_error("EngineManager::waitForScrubberToBeIdle: Lock must be held");
@@ -182,6 +189,10 @@ void engine_manager_scrub_engine(struct default_engine* engine) {
     getEngineManager().scrubEngine(engine);
 }
 
+void engine_manager_rebalance_engine(struct default_engine* engine) {
+    getEngineManager().rebalanceEngine(engine);
+}
+
 void engine_manager_shutdown() {
     // will block waiting for scrubber to finish
     // Note that it would be tempting to just call reset on the unique_ptr,
@@ -53,6 +53,13 @@ public:
      */
     void scrubEngine(struct default_engine* engine);
 
+    /**
+     *  Request that the engine's slab pages are rebalanced between size
+     *  classes. The rebalance runs on the same background thread as the
+     *  scrubber.
+     */
+    void rebalanceEngine(struct default_engine* engine);
+
     /**
      * Set the shutdown flag so that we can clean up
      *    1) no new engine's can be created.
@@ -121,6 +128,12 @@ void engine_manager_delete_engine(struct default_engine* engine);
  */
 void engine_manager_scrub_engine(struct default_engine* engine);
 
+/*
+ * Request that the engine's slab pages are rebalanced.
+ * Rebalance is performed by a background thread.
+ */
+void engine_manager_rebalance_engine(struct default_engine* engine);
+
 /*
  * Perform global shutdown in prepration for unloading of the shared object.
  * This method will block until background threads are joined.
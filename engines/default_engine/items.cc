@@ -61,6 +61,13 @@ static void hash_key_copy_to_item(hash_item* dst, const hash_key* src);
  */
 static const int search_items = 50;
 
+/*
+ * When a slab class has suffered this many evictions since the last slab
+ * rebalance pass we ask the background thread to try to move a page over
+ * to it from a class with idle memory.
+ */
+#define REBALANCE_EVICTION_THRESHOLD 1000
+
 void item_stats_reset(struct default_engine *engine) {
     cb_mutex_enter(&engine->items.lock);
     memset(engine->items.itemstats, 0, sizeof(engine->items.itemstats));
@@ -172,8 +179,26 @@ hash_item *do_item_alloc(struct default_engine *engine,
             return NULL;
         }
 
-        for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
+        hash_item *prev;
+        for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=prev) {
+            prev = search->prev;
             if (search->refcount == 0 && search->locktime <= current_time) {
+                if ((search->iflag & ITEM_ACCESSED) != 0 &&
+                    (search->exptime == 0 || search->exptime > current_time) &&
+                    !(oldest_live != 0 && oldest_live <= current_time &&
+                      search->time <= oldest_live)) {
+                    /* Referenced since it was linked (and still live); give
+                     * it a second chance rather than evicting it. Clear the
+                     * mark and move it to the head so it has to earn another
+                     * reference before the scan comes around again.
+                     */
+                    search->iflag &= ~ITEM_ACCESSED;
+                    item_unlink_q(engine, search);
+                    search->time = current_time;
+                    item_link_q(engine, search);
+                    engine->items.itemstats[id].second_chance++;
+                    continue;
+                }
                 if (search->exptime == 0 || search->exptime > current_time) {
                     engine->items.itemstats[id].evicted++;
                     engine->items.itemstats[id].evicted_time = current_time - search->time;
@@ -187,6 +212,17 @@ hash_item *do_item_alloc(struct default_engine *engine,
                     engine->server.stat->evicting(cookie,
                                                   hash_key_get_client_key(search_key),
                                                   hash_key_get_client_key_len(search_key));
+                    /* Sustained eviction pressure in one class while
+                       another sits on idle memory means the pages are
+                       in the wrong place; ask the background thread to
+                       rebalance them. */
+                    engine->items.rebalance_evicted[id]++;
+                    if (engine->items.rebalance_evicted[id] >=
+                            REBALANCE_EVICTION_THRESHOLD &&
+                        !engine->items.rebalance_requested) {
+                        engine->items.rebalance_requested = true;
+                        engine_manager_rebalance_engine(engine);
+                    }
                 } else {
                     engine->items.itemstats[id].reclaimed++;
                     cb_mutex_enter(&engine->stats.lock);
@@ -421,10 +457,15 @@ void do_item_update(struct default_engine *engine, hash_item *it) {
     if (it->time < current_time - ITEM_UPDATE_INTERVAL) {
         cb_assert((it->iflag & ITEM_SLABBED) == 0);
 
-        if ((it->iflag & ITEM_LINKED) != 0) {
-            item_unlink_q(engine, it);
-            it->time = current_time;
-            item_link_q(engine, it);
+        if ((it->iflag & ITEM_LINKED) != 0 &&
+            (it->iflag & ITEM_ACCESSED) == 0) {
+            /* Don't splice the item to the head of its queue (six pointer
+             * updates on the hottest path in the cache); just mark it as
+             * referenced. The eviction scan in do_item_alloc() honours the
+             * mark by relinking such items at the head instead of evicting
+             * them, so frequently used items still survive memory pressure.
+             */
+            it->iflag |= ITEM_ACCESSED;
         }
     }
 }
@@ -488,6 +529,10 @@ static void do_item_stats(struct default_engine *engine,
                            "%u", engine->items.itemstats[i].tailrepairs);;
             add_statistics(c, add_stats, prefix, i, "reclaimed",
                            "%u", engine->items.itemstats[i].reclaimed);;
+            add_statistics(c, add_stats, prefix, i, "second_chance",
+                           "%u", engine->items.itemstats[i].second_chance);;
+            add_statistics(c, add_stats, prefix, i, "evacuated",
+                           "%u", engine->items.itemstats[i].evacuated);;
         }
     }
 }
@@ -1273,6 +1318,96 @@ bool item_start_scrub(struct default_engine *engine)
     return ret;
 }
 
+void item_rebalance_slabs(struct default_engine *engine)
+{
+    unsigned int i;
+    unsigned int src = 0;
+    unsigned int dst = 0;
+    unsigned int worst = 0;
+    size_t best_idle = 0;
+    size_t length;
+    void *page;
+    rel_time_t current_time = engine->server.core->get_current_time();
+
+    cb_mutex_enter(&engine->items.lock);
+    engine->items.rebalance_requested = false;
+
+    /* recipient: the class with the most eviction pressure */
+    for (i = POWER_SMALLEST; i < POWER_LARGEST; i++) {
+        if (engine->items.rebalance_evicted[i] > worst) {
+            worst = engine->items.rebalance_evicted[i];
+            dst = i;
+        }
+    }
+
+    if (dst == 0 || worst < REBALANCE_EVICTION_THRESHOLD) {
+        cb_mutex_exit(&engine->items.lock);
+        return;
+    }
+
+    /* donor: a quiet class hoarding the most idle memory. It must have at
+       least a page worth of free chunks, so losing one page doesn't just
+       move the eviction pressure over to it. */
+    for (i = POWER_SMALLEST; i < POWER_LARGEST; i++) {
+        slabclass_t *p = &engine->slabs.slabclass[i];
+        unsigned int idle;
+        if (i == dst || p->size == 0 ||
+            engine->items.rebalance_evicted[i] != 0) {
+            continue;
+        }
+        idle = slabs_idle_chunks(engine, i);
+        if (idle >= p->perslab && (size_t)idle * p->size > best_idle) {
+            best_idle = (size_t)idle * p->size;
+            src = i;
+        }
+    }
+
+    if (src != 0 &&
+        (page = slabs_rebalance_select_page(engine, src, &length)) != NULL &&
+        engine->slabs.slabclass[dst].size <= length) {
+        /* Evacuate the page through the ordinary unlink machinery. A busy
+           chunk (an in-flight item or a locked document) aborts the
+           attempt; anything already unlinked by then was evictable
+           anyway. */
+        unsigned int size = engine->slabs.slabclass[src].size;
+        unsigned int evacuated = 0;
+        bool busy = false;
+        char *ptr;
+
+        for (ptr = static_cast<char*>(page);
+             ptr + size <= static_cast<char*>(page) + length;
+             ptr += size) {
+            hash_item *it = reinterpret_cast<hash_item*>(ptr);
+            if ((it->iflag & ITEM_SLABBED) != 0) {
+                /* already on the freelist */
+                continue;
+            }
+            if (it->refcount != 0 ||
+                ((it->iflag & ITEM_LINKED) != 0 &&
+                 it->locktime > current_time)) {
+                busy = true;
+                break;
+            }
+            if ((it->iflag & ITEM_LINKED) == 0) {
+                /* zeroed chunk which was never handed out */
+                continue;
+            }
+            do_item_unlink(engine, it);
+            evacuated++;
+        }
+
+        if (!busy &&
+            slabs_rebalance_move_page(engine, src, dst, page, length)) {
+            engine->items.itemstats[src].evacuated += evacuated;
+        }
+    }
+
+    /* start a fresh observation window whether or not a page moved */
+    memset(engine->items.rebalance_evicted, 0,
+           sizeof(engine->items.rebalance_evicted));
+    cb_mutex_exit(&engine->items.lock);
+}
+
 static bool hash_key_create(hash_key* hkey,
                             const void* key,
                             const size_t nkey,
@@ -146,6 +146,8 @@ typedef struct {
     unsigned int outofmemory;
     unsigned int tailrepairs;
     unsigned int reclaimed;
+    unsigned int second_chance;
+    unsigned int evacuated;
 } itemstats_t;
 
 struct items {
@@ -153,6 +155,11 @@ struct items {
    hash_item *tails[POWER_LARGEST];
    itemstats_t itemstats[POWER_LARGEST];
    unsigned int sizes[POWER_LARGEST];
+   /* evictions per class since the last slab rebalance pass */
+   unsigned int rebalance_evicted[POWER_LARGEST];
+   /* set when a rebalance request has been handed to the background
+      thread and hasn't run yet; avoids flooding its work queue */
+   bool rebalance_requested;
    /*
     * serialise access to the items data
    */
@@ -352,4 +359,13 @@ void item_scrubber_main(struct default_engine *engine);
  */
 bool item_start_scrub(struct default_engine *engine);
 
+/**
+ * Run a single slab rebalance pass for the engine: if one slab class has
+ * suffered heavy eviction pressure while another sits on idle memory,
+ * evacuate a page from the idle class and donate it to the pressured one.
+ * Called from the background (scrubber) thread.
+ * @param engine handle to the storage engine
+ */
+void item_rebalance_slabs(struct default_engine *engine);
+
 #endif
@@ -51,7 +51,17 @@ void ScrubberTask::placeOnWorkQueue(struct default_engine* engine,
     std::lock_guard<std::mutex> lck(lock);
     if (!shuttingdown) {
         engine->scrubber.force_delete = destroy;
-        workQueue.push_back(std::make_pair(engine, destroy));
+        workQueue.push_back(std::make_pair(engine,
+                                           destroy ? Work::Destroy
+                                                   : Work::Scrub));
+        cvar.notify_one();
+    }
+}
+
+void ScrubberTask::placeOnRebalanceQueue(struct default_engine* engine) {
+    std::lock_guard<std::mutex> lck(lock);
+    if (!shuttingdown) {
+        workQueue.push_back(std::make_pair(engine, Work::Rebalance));
         cvar.notify_one();
     }
 }
@@ -65,8 +75,13 @@ void ScrubberTask::run() {
             state = State::Scrubbing;
             lck.unlock();
             // Run the task without holding the lock
-            item_scrubber_main(engine.first);
-            engineManager.notifyScrubComplete(engine.first, engine.second);
+            if (engine.second == Work::Rebalance) {
+                item_rebalance_slabs(engine.first);
+            } else {
+                item_scrubber_main(engine.first);
+            }
+            engineManager.notifyScrubComplete(engine.first,
+                                              engine.second == Work::Destroy);
 
             // relock so lck can safely unlock when destroyed at loop end.
             lck.lock();
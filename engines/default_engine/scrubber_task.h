@@ -54,6 +54,13 @@ public:
      */
     void placeOnWorkQueue(struct default_engine* engine, bool destroy);
 
+    /**
+     *  Place the engine on the threads work queue for slab rebalancing.
+     *  Requests are coalesced by the engine itself; it won't issue a new
+     *  one before the queued one has run.
+     */
+    void placeOnRebalanceQueue(struct default_engine* engine);
+
     /**
      * Task's run loop method. This is not a public function and should only
      * be called from the tasks constructor.
@@ -83,11 +90,21 @@ private:
     /** What is the scrubber currently doing */
     State state;
 
+    /** The kind of background work queued for an engine */
+    enum class Work {
+        /// Scrub the engine's items
+        Scrub,
+        /// Scrub the engine's items, then delete the engine
+        Destroy,
+        /// Rebalance the engine's slab pages
+        Rebalance
+    };
+
     /*
      * A queue of engine's to work on.
-     * The second bool indicates if the engine is to be deleted when done.
+     * The second member is the kind of work to perform on the engine.
      */
-    std::deque<std::pair<struct default_engine*, bool> > workQueue;
+    std::deque<std::pair<struct default_engine*, Work> > workQueue;
 
     /** Is the task being requested to shut down? */
     bool shuttingdown;
@@ -189,8 +189,12 @@ static int grow_slab_list (struct default_engine *engine, const unsigned int id)
         void** new_list = static_cast<void**>
             (cb_realloc(p->slab_list, new_size * sizeof(void *)));
         if (new_list == 0) return 0;
-        p->list_size = new_size;
         p->slab_list = new_list;
+        size_t* new_lengths = static_cast<size_t*>
+            (cb_realloc(p->page_lengths, new_size * sizeof(size_t)));
+        if (new_lengths == 0) return 0;
+        p->page_lengths = new_lengths;
+        p->list_size = new_size;
     }
     return 1;
 }
@@ -212,7 +216,9 @@ static int do_slabs_newslab(struct default_engine *engine, const unsigned int id
     p->end_page_ptr = ptr;
     p->end_page_free = p->perslab;
 
-    p->slab_list[p->slabs++] = ptr;
+    p->slab_list[p->slabs] = ptr;
+    p->page_lengths[p->slabs] = (size_t)len;
+    p->slabs++;
     engine->slabs.mem_malloced += len;
     MEMCACHED_SLABS_SLABCLASS_ALLOCATE(id);
 
@@ -377,6 +383,8 @@ static void do_slabs_stats(struct default_engine *engine, ADD_STAT add_stats, co
             add_statistics(cookie, add_stats, NULL, i, "mem_requested",
                            "%" PRIu64,
                            (uint64_t)p->requested);
+            add_statistics(cookie, add_stats, NULL, i, "pages_rebalanced",
+                           "%u", p->rebalanced);
             total++;
         }
     }
@@ -456,6 +464,153 @@ void slabs_adjust_mem_requested(struct default_engine *engine, unsigned int id,
     cb_mutex_exit(&engine->slabs.lock);
 }
 
+unsigned int slabs_idle_chunks(struct default_engine *engine, unsigned int id)
+{
+    unsigned int ret = 0;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    if (id >= POWER_SMALLEST && id <= engine->slabs.power_largest) {
+        slabclass_t *p = &engine->slabs.slabclass[id];
+        ret = p->sl_curr + p->end_page_free;
+    }
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
+void *slabs_rebalance_select_page(struct default_engine *engine,
+                                  unsigned int id,
+                                  size_t *length)
+{
+    void *page = NULL;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    if (id >= POWER_SMALLEST && id <= engine->slabs.power_largest) {
+        slabclass_t *p = &engine->slabs.slabclass[id];
+        if (p->slabs > 1) {
+            unsigned int ii;
+            for (ii = 0; ii < p->slabs; ii++) {
+                char *ptr = static_cast<char*>(p->slab_list[ii]);
+                if (p->end_page_ptr != NULL &&
+                    static_cast<char*>(p->end_page_ptr) >= ptr &&
+                    static_cast<char*>(p->end_page_ptr) <
+                        ptr + p->page_lengths[ii]) {
+                    /* still being carved up for new allocations */
+                    continue;
+                }
+                page = ptr;
+                *length = p->page_lengths[ii];
+                break;
+            }
+        }
+    }
+    cb_mutex_exit(&engine->slabs.lock);
+    return page;
+}
+
+int slabs_rebalance_move_page(struct default_engine *engine,
+                              unsigned int srcid,
+                              unsigned int dstid,
+                              void *page,
+                              size_t length)
+{
+    slabclass_t *src, *dst;
+    unsigned int expected, found, ii, idx;
+    char *pstart = static_cast<char*>(page);
+    char *pend = pstart + length;
+
+    if (srcid < POWER_SMALLEST || srcid > engine->slabs.power_largest ||
+        dstid < POWER_SMALLEST || dstid > engine->slabs.power_largest) {
+        return 0;
+    }
+
+    cb_mutex_enter(&engine->slabs.lock);
+    src = &engine->slabs.slabclass[srcid];
+    dst = &engine->slabs.slabclass[dstid];
+
+    /* Locate the page in the source class */
+    idx = src->slabs;
+    for (ii = 0; ii < src->slabs; ii++) {
+        if (src->slab_list[ii] == page) {
+            idx = ii;
+            break;
+        }
+    }
+
+    /* Every chunk in the page must be sitting on the source freelist */
+    expected = (unsigned int)(length / src->size);
+    found = 0;
+    for (ii = 0; ii < src->sl_curr; ii++) {
+        char *c = static_cast<char*>(src->slots[ii]);
+        if (c >= pstart && c < pend) {
+            found++;
+        }
+    }
+
+    if (idx == src->slabs || found != expected ||
+        grow_slab_list(engine, dstid) == 0) {
+        cb_mutex_exit(&engine->slabs.lock);
+        return 0;
+    }
+
+    /* Flush the remainder of the destination's current end page onto its
+       freelist before we replace it, growing the freelist up front so we
+       can't fail halfway through */
+    if (dst->end_page_free != 0) {
+        unsigned int needed = dst->sl_curr + dst->end_page_free;
+        if (needed > dst->sl_total) {
+            unsigned int new_size = (dst->sl_total != 0) ? dst->sl_total * 2 : 16;
+            void **new_slots;
+            while (new_size < needed) {
+                new_size *= 2;
+            }
+            new_slots = static_cast<void**>(cb_realloc(dst->slots,
+                                            new_size * sizeof(void *)));
+            if (new_slots == 0) {
+                cb_mutex_exit(&engine->slabs.lock);
+                return 0;
+            }
+            dst->slots = new_slots;
+            dst->sl_total = new_size;
+        }
+        while (dst->end_page_free != 0) {
+            dst->slots[dst->sl_curr++] = dst->end_page_ptr;
+            dst->end_page_ptr = ((unsigned char *)dst->end_page_ptr) + dst->size;
+            dst->end_page_free--;
+        }
+        dst->end_page_ptr = 0;
+    }
+
+    /* Strip the evacuated chunks from the source freelist */
+    found = 0;
+    for (ii = 0; ii < src->sl_curr; ii++) {
+        char *c = static_cast<char*>(src->slots[ii]);
+        if (c >= pstart && c < pend) {
+            continue;
+        }
+        src->slots[found++] = src->slots[ii];
+    }
+    src->sl_curr = found;
+
+    /* Detach the page from the source class... */
+    src->slabs--;
+    src->slab_list[idx] = src->slab_list[src->slabs];
+    src->page_lengths[idx] = src->page_lengths[src->slabs];
+
+    /* ...and hand it to the destination as a fresh end page. The chunk
+       boundaries shift with the new chunk size, so zero the page just as
+       do_slabs_newslab() would */
+    memset(page, 0, length);
+    dst->slab_list[dst->slabs] = page;
+    dst->page_lengths[dst->slabs] = length;
+    dst->slabs++;
+    dst->end_page_ptr = page;
+    dst->end_page_free = (unsigned int)(length / dst->size);
+    dst->rebalanced++;
+
+    cb_mutex_exit(&engine->slabs.lock);
+    return 1;
+}
+
 void slabs_destroy(struct default_engine *e)
 {
     /* Release the allocated backing store */
@@ -472,5 +627,6 @@ void slabs_destroy(struct default_engine *e)
         slabclass_t *p = &e->slabs.slabclass[jj];
         cb_free(p->slots);
         cb_free(p->slab_list);
+        cb_free(p->page_lengths);
     }
 }
@@ -20,10 +20,14 @@ typedef struct {
     unsigned int slabs;     /* how many slabs were allocated for this class */
 
     void **slab_list;       /* array of slab pointers */
+    size_t *page_lengths;   /* length of each page in slab_list; pages moved
+                               in from another class keep their original
+                               length, so this may vary per page */
     unsigned int list_size; /* size of prev array */
 
     unsigned int killing;  /* index+1 of dying slab, or zero if none */
     size_t requested; /* The number of requested bytes */
+    unsigned int rebalanced; /* number of pages moved into this class */
 } slabclass_t;
 
 struct slabs {
@@ -80,6 +84,34 @@ void slabs_free(struct default_engine *engine, void *ptr, size_t size, unsigned
 /** Adjust the stats for memory requested */
 void slabs_adjust_mem_requested(struct default_engine *engine, unsigned int id, size_t old, size_t ntotal);
 
+/** Number of idle (free) chunks in the given slab class */
+unsigned int slabs_idle_chunks(struct default_engine *engine, unsigned int id);
+
+/**
+ * Select a page in the given slab class which may be donated to another
+ * class. The page currently being carved up for new allocations (the end
+ * page) is never selected, and a class never gives away its last page.
+ * Returns the page pointer and its length, or NULL if the class has no
+ * page to spare. The caller must hold the items lock so that no chunk in
+ * the page can be allocated or freed until the migration is complete.
+ */
+void *slabs_rebalance_select_page(struct default_engine *engine,
+                                  unsigned int id,
+                                  size_t *length);
+
+/**
+ * Move a fully evacuated page (every chunk free) from class srcid to class
+ * dstid. The caller must hold the items lock and have evacuated every item
+ * in the page. Returns 1 on success; 0 if the page could not be accounted
+ * for or memory for the bookkeeping could not be allocated, in which case
+ * the page stays with the source class.
+ */
+int slabs_rebalance_move_page(struct default_engine *engine,
+                              unsigned int srcid,
+                              unsigned int dstid,
+                              void *page,
+                              size_t length);
+
 /** Fill buffer with stats */ /*@null@*/
 void slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *c);
 
@@ -0,0 +1,44 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Main function for the ep_engine_benchmarks program. Sets up the mock
+ * server environment shared by all the benchmark fixtures and then hands
+ * over to Google Benchmark.
+ *
+ * Pass --benchmark_format=json (or --benchmark_out=<file>
+ * --benchmark_out_format=json) to get output suitable for trending.
+ */
+
+#include <benchmark/benchmark.h>
+#include <gtest/gtest.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include "ep_time.h"
+
+static char allow_no_stats_env[] = "ALLOW_NO_STATS_UPDATE=yeah";
+
+int main(int argc, char** argv) {
+    putenv(allow_no_stats_env);
+    mock_init_alloc_hooks();
+    init_mock_server(true);
+    initialize_time_functions(get_mock_server_api()->core);
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
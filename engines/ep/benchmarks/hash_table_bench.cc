@@ -0,0 +1,138 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks for the HashTable - the cost of find / set at different
+ * load factors (items per hash bucket), as seen by every front-end
+ * operation.
+ */
+
+#include "hash_table.h"
+#include "item.h"
+#include "stats.h"
+#include "stored_value_factories.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <benchmark/benchmark.h>
+
+class HashTableBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) {
+        // range(0) is the load factor - the number of items stored per
+        // hash bucket. The table is sized once up-front (no incremental
+        // resizing) so we measure chain-walk cost at the given factor.
+        ht = std::make_unique<HashTable>(
+                stats,
+                std::make_unique<StoredValueFactory>(stats),
+                numBuckets,
+                numLocks);
+
+        const size_t numItems = numBuckets * state.range(0);
+        keys.reserve(numItems);
+        items.reserve(numItems);
+        std::string value(64, 'x');
+        for (size_t i = 0; i < numItems; i++) {
+            keys.emplace_back(makeStoredDocKey("key_" + std::to_string(i)));
+            items.emplace_back(
+                    keys.back(), 0, 0, value.data(), value.size());
+        }
+    }
+
+    void TearDown(benchmark::State& state) {
+        ht.reset();
+        keys.clear();
+        items.clear();
+    }
+
+protected:
+    /// Store all the pre-generated items in the HashTable.
+    void populate() {
+        for (auto& item : items) {
+            ht->set(item);
+        }
+    }
+
+    // Fixed bucket count; load factor is varied via the benchmark
+    // argument instead.
+    const size_t numBuckets = 4099;
+    const size_t numLocks = 47;
+
+    EPStats stats;
+    std::unique_ptr<HashTable> ht;
+    std::vector<StoredDocKey> keys;
+    std::vector<Item> items;
+};
+
+BENCHMARK_DEFINE_F(HashTableBench, FindHit)(benchmark::State& state) {
+    populate();
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(ht->find(keys[ii++ % keys.size()],
+                                          TrackReference::No,
+                                          WantsDeleted::No));
+    }
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, FindMiss)(benchmark::State& state) {
+    populate();
+    // Look up keys which don't exist in the table; these walk the whole
+    // chain for their bucket.
+    std::vector<StoredDocKey> missingKeys;
+    missingKeys.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        missingKeys.emplace_back(
+                makeStoredDocKey("missing_" + std::to_string(i)));
+    }
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(ht->find(missingKeys[ii++ % keys.size()],
+                                          TrackReference::No,
+                                          WantsDeleted::No));
+    }
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, Insert)(benchmark::State& state) {
+    // Insert fresh keys; when the pre-generated set is exhausted empty
+    // the table again (outside of the timed region).
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        if (ii == items.size()) {
+            state.PauseTiming();
+            ht->clear();
+            ii = 0;
+            state.ResumeTiming();
+        }
+        ht->set(items[ii++]);
+    }
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, Replace)(benchmark::State& state) {
+    populate();
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        ht->set(items[ii++ % items.size()]);
+    }
+}
+
+BENCHMARK_REGISTER_F(HashTableBench, FindHit)
+        ->RangeMultiplier(4)
+        ->Range(1, 16);
+BENCHMARK_REGISTER_F(HashTableBench, FindMiss)
+        ->RangeMultiplier(4)
+        ->Range(1, 16);
+BENCHMARK_REGISTER_F(HashTableBench, Insert)->RangeMultiplier(4)->Range(1, 16);
+BENCHMARK_REGISTER_F(HashTableBench, Replace)->RangeMultiplier(4)->Range(1, 16);
@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks for Item / key / value primitives - the per-document costs
+ * paid on every front-end operation.
+ */
+
+#include "item.h"
+#include "storeddockey.h"
+
+#include <benchmark/benchmark.h>
+
+/**
+ * Cost of hashing a StoredDocKey, as done when selecting the HashTable
+ * bucket for every lookup and mutation. range(0) is the key length.
+ */
+static void BM_StoredDocKeyHash(benchmark::State& state) {
+    const std::string key(state.range(0), 'k');
+    StoredDocKey docKey(key, DocNamespace::DefaultCollection);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(docKey.hash());
+    }
+}
+
+/**
+ * Cost of allocating (and releasing) a Blob of the given size, as done
+ * for the value of every stored document. range(0) is the value length.
+ */
+static void BM_BlobAllocate(benchmark::State& state) {
+    const std::string data(state.range(0), 'x');
+    while (state.KeepRunning()) {
+        value_t blob(Blob::New(data.data(), data.size()));
+        benchmark::DoNotOptimize(blob.get());
+    }
+}
+
+BENCHMARK(BM_StoredDocKeyHash)->RangeMultiplier(4)->Range(16, 256);
+BENCHMARK(BM_BlobAllocate)->RangeMultiplier(4)->Range(64, 16384);
@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks for VBucket-level hot paths - checkpoint queueing under
+ * differing numbers of cursors, and VBucketMap lookup.
+ */
+
+#include "engine_fixture.h"
+
+#include "checkpoint.h"
+#include "item.h"
+#include "kv_bucket.h"
+#include "tests/module_tests/test_helpers.h"
+
+class VBucketBench : public EngineFixture {};
+
+/**
+ * Benchmark queueing an item into the CheckpointManager with the given
+ * number of cursors registered - every queueDirty has to check each
+ * cursor when items are de-duplicated. range(0) is the cursor count.
+ *
+ * The same key is queued on every iteration so the open checkpoint
+ * de-duplicates and stays a constant size regardless of how many
+ * iterations the benchmark runs for.
+ */
+BENCHMARK_DEFINE_F(VBucketBench, QueueDirty)(benchmark::State& state) {
+    engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active, false);
+    auto vb = engine->getKVBucket()->getVBucket(vbid);
+    auto& ckptMgr = *vb->checkpointManager;
+
+    for (int ii = 0; ii < state.range(0); ii++) {
+        ckptMgr.registerCursorBySeqno("cursor_" + std::to_string(ii),
+                                      0,
+                                      MustSendCheckpointEnd::NO);
+    }
+
+    while (state.KeepRunning()) {
+        queued_item qi{new Item(makeStoredDocKey("key"),
+                                vb->getId(),
+                                queue_op::mutation,
+                                /*revSeq*/ 0,
+                                /*bySeq*/ 0)};
+        ckptMgr.queueDirty(*vb,
+                           qi,
+                           GenerateBySeqno::Yes,
+                           GenerateCas::Yes,
+                           /*preLinkDocCtx*/ nullptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Benchmark fetching a vbucket from the VBucketMap (including taking a
+ * reference on it), as done at the start of every front-end operation.
+ */
+BENCHMARK_DEFINE_F(VBucketBench, GetVBucket)(benchmark::State& state) {
+    engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active, false);
+    auto* kvBucket = engine->getKVBucket();
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(kvBucket->getVBucket(vbid));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(VBucketBench, QueueDirty)
+        ->RangeMultiplier(4)
+        ->Range(1, 64);
+BENCHMARK_REGISTER_F(VBucketBench, GetVBucket);
@@ -17,6 +17,7 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <phosphor/phosphor.h>
@@ -25,6 +26,7 @@
 #include "access_scanner.h"
 #include "ep_time.h"
 #include "hash_table.h"
+#include "item.h"
 #include "kv_bucket.h"
 #include "mutation_log.h"
 #include "stats.h"
@@ -40,7 +42,8 @@ public:
                       uint16_t sh,
                       std::atomic<bool>& sfin,
                       AccessScanner& aS,
-                      uint64_t items_to_scan)
+                      uint64_t items_to_scan,
+                      bool rewrite)
         : VBucketVisitor(VBucketFilter(
                   _store.getVBuckets().getShard(sh)->getVBuckets())),
           store(_store),
@@ -51,7 +54,9 @@ public:
           stateFinalizer(sfin),
           as(aS),
           items_scanned(0),
-          items_to_scan(items_to_scan) {
+          items_to_scan(items_to_scan),
+          items_since_yield(0),
+          rewrite(rewrite) {
         name = conf.getAlogPath();
         std::stringstream s;
         s << shardID;
@@ -59,15 +64,26 @@ public:
         prev = name + ".old";
         next = name + ".next";
 
-        log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
+        if (rewrite) {
+            log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
+        } else {
+            // Incremental sweep - append delta records to the existing
+            // shard log rather than rewriting it from scratch. Warmup
+            // de-duplicates keys when it harvests the log, so appending
+            // an already-present key is harmless.
+            log = std::make_unique<MutationLog>(name, conf.getAlogBlockSize());
+        }
         log->open();
         if (!log->isOpen()) {
             LOG(EXTENSION_LOG_WARNING, "Failed to open access log: '%s'",
-                next.c_str());
+                rewrite ? next.c_str() : name.c_str());
             log.reset();
-        } else {
+        } else if (rewrite) {
             LOG(EXTENSION_LOG_NOTICE, "Attempting to generate new access file "
                 "'%s'", next.c_str());
+        } else {
+            LOG(EXTENSION_LOG_NOTICE, "Appending access deltas to file '%s'",
+                name.c_str());
         }
     }
 
@@ -77,18 +93,49 @@ public:
                 LOG(EXTENSION_LOG_INFO,
                     "INFO: Skipping expired/deleted item: %" PRIu64,
                     v.getBySeqno());
-            } else {
-                accessed.push_back(StoredDocKey(v.getKey()));
+            } else if (rewrite || v.getNRUValue() < INITIAL_NRU_VALUE) {
+                // A delta sweep only appends keys which have been
+                // referenced since they were stored (their NRU has been
+                // driven below the initial value); everything else is
+                // already covered by the last full rewrite.
+                // Record the NRU value alongside the key - it is the
+                // approximate access frequency we have for the item and
+                // decides where in the batch the key is written.
+                accessed.push_back({v.getNRUValue(), StoredDocKey(v.getKey())});
+                ++items_since_yield;
                 return ++items_scanned < items_to_scan;
             }
         }
         return true;
     }
 
+    bool pauseVisitor() override {
+        // Yield the visitor task between vBuckets once a batch worth of
+        // items has been recorded, so a sweep over a large shard
+        // interleaves with other tasks instead of monopolising its
+        // executor thread.
+        if (items_since_yield >= items_to_scan) {
+            items_since_yield = 0;
+            return true;
+        }
+        return false;
+    }
+
     void update() {
         if (log != nullptr) {
-            for (auto it = accessed.begin(); it != accessed.end(); ++it) {
-                log->newItem(currentBucket->getId(), *it);
+            // Write each batch hottest-first (a lower NRU value means more
+            // recently referenced). Warmup replays the log in file order
+            // and may enable traffic part way through (see
+            // warmup_min_items_threshold), so the most valuable keys must
+            // appear earliest in the file.
+            std::stable_sort(accessed.begin(),
+                             accessed.end(),
+                             [](const std::pair<uint8_t, StoredDocKey>& a,
+                                const std::pair<uint8_t, StoredDocKey>& b) {
+                                 return a.first < b.first;
+                             });
+            for (const auto& entry : accessed) {
+                log->newItem(currentBucket->getId(), entry.second);
             }
         }
         accessed.clear();
@@ -128,6 +175,16 @@ public:
                     std::chrono::duration_cast<std::chrono::microseconds>(
                             ProcessClock::now() - taskStart));
 
+            if (!rewrite) {
+                // Delta sweep - the records were appended to the live log
+                // in place, so there is nothing to rotate.
+                LOG(EXTENSION_LOG_NOTICE, "Appended %" PRIu64 " keys to "
+                    "access log file '%s'", static_cast<uint64_t>(num_items),
+                    name.c_str());
+                updateStateFinalizer(true);
+                return;
+            }
+
             if (num_items == 0) {
                 LOG(EXTENSION_LOG_NOTICE, "The new access log file is empty. "
                     "Delete it without replacing the current access log...");
@@ -202,7 +259,9 @@ private:
     std::string name;
     uint16_t shardID;
 
-    std::vector<StoredDocKey> accessed;
+    /// Batch of keys pending a log write, tagged with the NRU value they
+    /// were observed with (the heat ranking used to order the batch).
+    std::vector<std::pair<uint8_t, StoredDocKey>> accessed;
 
     std::unique_ptr<MutationLog> log;
     std::atomic<bool> &stateFinalizer;
@@ -212,6 +271,12 @@ private:
     uint64_t items_scanned;
     // The number of items to scan before we pause
     const uint64_t items_to_scan;
+    // Items recorded since the visitor task last yielded (see
+    // pauseVisitor).
+    uint64_t items_since_yield;
+    // True for a full log rewrite; false for an incremental sweep which
+    // appends recently referenced keys to the existing log.
+    const bool rewrite;
 
     VBucketPtr currentBucket;
 };
@@ -231,7 +296,12 @@ AccessScanner::AccessScanner(KVBucket& _store,
       conf(conf),
       stats(st),
       sleepTime(sleeptime),
-      available(true) {
+      available(true),
+      maxDeltaRuns(conf.getAlogDeltaRuns()),
+      deltaRunsLeft(0),
+      adaptiveSleepTime(sleeptime),
+      prevOps(0),
+      prevOpsValid(false) {
     residentRatioThreshold = conf.getAlogResidentRatioThreshold();
     alogPath = conf.getAlogPath();
     maxStoredItems = conf.getAlogMaxStoredItems();
@@ -289,6 +359,13 @@ bool AccessScanner::run() {
 
         store.visit(aggregator);
 
+        const size_t curOps = activeCountVisitor.getOpsCreate() +
+                              activeCountVisitor.getOpsUpdate() +
+                              activeCountVisitor.getOpsDelete() +
+                              replicaCountVisitor.getOpsCreate() +
+                              replicaCountVisitor.getOpsUpdate() +
+                              replicaCountVisitor.getOpsDelete();
+
         /* If the resident ratio is greater than 95% we do not want to generate
          access log and also we want to delete previously existing access log
          files*/
@@ -296,10 +373,22 @@ bool AccessScanner::run() {
             (replicaCountVisitor.getMemResidentPer() > residentRatioThreshold))
         {
             deleteAccessLogFiles = true;
+            // Whenever logs come back (residency drops again) the first
+            // sweep must be a full rewrite.
+            deltaRunsLeft = 0;
         }
+
+        // Decide whether this sweep is a full rewrite of the per-shard
+        // logs or an incremental one appending deltas to them.
+        bool rewrite = true;
+        if (!deleteAccessLogFiles) {
+            rewrite = (deltaRunsLeft == 0);
+            deltaRunsLeft = rewrite ? maxDeltaRuns : deltaRunsLeft - 1;
+        }
+
         for (size_t i = 0; i < store.getVBuckets().getNumShards(); i++) {
+            std::string name(alogPath + "." + std::to_string(i));
             if (deleteAccessLogFiles) {
-                std::string name(alogPath + "." + std::to_string(i));
                 std::string prev(name + ".old");
 
                 LOG(EXTENSION_LOG_NOTICE, "Deleting access log files '%s' and "
@@ -312,19 +401,24 @@ bool AccessScanner::run() {
                 deleteAlogFile(name);
                 stats.accessScannerSkips++;
             } else {
+                // There is nothing to append to if this shard has no log
+                // yet; fall back to a full rewrite for it.
+                const bool shardRewrite =
+                        rewrite || access(name.c_str(), F_OK) != 0;
                 auto pv = std::make_unique<ItemAccessVisitor>(store,
                                                               conf,
                                                               stats,
                                                               i,
                                                               available,
                                                               *this,
-                                                              maxStoredItems);
+                                                              maxStoredItems,
+                                                              shardRewrite);
                 auto task = std::make_shared<VBCBAdaptor>(
                         &store,
                         TaskId::AccessScannerVisitor,
                         std::move(pv),
                         "Item Access Scanner",
-                        sleepTime,
+                        /*sleepTime between yields*/ 0,
                         true);
 
                 // p99.9 is typically ~200ms
@@ -332,13 +426,35 @@ bool AccessScanner::run() {
                 ExecutorPool::get()->schedule(task);
             }
         }
+
+        adaptiveSleepTime =
+                adaptSleepTime(curOps, activeCountVisitor.getNumItems());
     }
-    snooze(sleepTime);
-    updateAlogTime(sleepTime);
+    snooze(adaptiveSleepTime);
+    updateAlogTime(adaptiveSleepTime);
 
     return true;
 }
 
+double AccessScanner::adaptSleepTime(size_t curOps, size_t numItems) {
+    double next = adaptiveSleepTime;
+    if (prevOpsValid && curOps >= prevOps) {
+        const double churn = static_cast<double>(curOps - prevOps) /
+                             std::max(numItems, size_t(1));
+        if (churn > 0.1) {
+            // More than 10% of the bucket mutated since the last sweep -
+            // scan more often so the log tracks the working set.
+            next = std::max(sleepTime / 4, adaptiveSleepTime / 2);
+        } else if (churn < 0.01) {
+            // Stable bucket - back off.
+            next = std::min(sleepTime * 4, adaptiveSleepTime * 2);
+        }
+    }
+    prevOps = curOps;
+    prevOpsValid = true;
+    return next;
+}
+
 void AccessScanner::updateAlogTime(double sleepSecs) {
     struct timeval _waketime;
     gettimeofday(&_waketime, NULL);
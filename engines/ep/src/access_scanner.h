@@ -50,6 +50,18 @@ private:
     void updateAlogTime(double sleepSecs);
     void deleteAlogFile(const std::string& fileName);
 
+    /**
+     * Calculate how long to snooze before the next sweep, scaling the
+     * configured interval by the mutation churn observed since the last
+     * run. Buckets which saw many mutations relative to their item count
+     * are rescanned sooner (down to 1/4 of alog_sleep_time); quiet ones
+     * back off (up to 4x alog_sleep_time).
+     *
+     * @param curOps Aggregated create+update+delete count at this run.
+     * @param numItems Current number of items across active vbuckets.
+     */
+    double adaptSleepTime(size_t curOps, size_t numItems);
+
     KVBucket& store;
     Configuration& conf;
     EPStats& stats;
@@ -58,6 +70,21 @@ private:
     std::atomic<bool> available;
     uint8_t residentRatioThreshold;
     uint64_t maxStoredItems;
+
+    // Number of incremental (delta append) sweeps to run before the next
+    // full log rewrite; see alog_delta_runs.
+    const uint64_t maxDeltaRuns;
+    // Delta sweeps remaining until the next full rewrite. Starts at zero
+    // so the very first sweep writes a complete log.
+    uint64_t deltaRunsLeft;
+
+    // Interval actually used for the last snooze; adapted around the
+    // configured sleepTime by adaptSleepTime().
+    double adaptiveSleepTime;
+    // Aggregated mutation count observed at the previous run (invalid
+    // until the first run has sampled it).
+    size_t prevOps;
+    bool prevOpsValid;
 };
 
 #endif  // SRC_ACCESS_SCANNER_H_
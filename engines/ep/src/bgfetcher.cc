@@ -86,6 +86,11 @@ size_t BgFetcher::doFetch(VBucket::id_type vbId,
         auto& key = fetch.first;
         const vb_bgfetch_item_ctx_t& bg_item_ctx = fetch.second;
 
+        // Track how many cookies piled up on this key while it was
+        // being fetched; a long tail here is the thundering herd on a
+        // hot non-resident key.
+        stats.bgHerdSizeHisto.add(bg_item_ctx.bgfetched_list.size());
+
         for (const auto& itm : bg_item_ctx.bgfetched_list) {
             // We don't want to transfer ownership of itm here as we clean it
             // up at the end of this method in clearItems()
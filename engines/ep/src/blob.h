@@ -31,6 +31,14 @@ public:
     /**
      * Create a new Blob holding the given data.
      *
+     * Note: deliberately allocated with (global) operator new rather
+     * than any private pooling scheme. The underlying allocator already
+     * services small allocations from size-classed, thread-cached bins,
+     * and going through operator new keeps Blobs visible to the
+     * new/delete hooks which feed mem_used (see MemoryTracker) and to
+     * the allocation-size callback used for the blob overhead stats and
+     * by the defragmenter. A private freelist would hide both.
+     *
      * @param start the beginning of the data to copy into this blob
      * @param len the amount of data to copy in
      *
@@ -22,6 +22,8 @@
 #include "murmurhash3.h"
 
 #include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 #if __x86_64__ || __ppc64__
 #define MURMURHASH_3 MurmurHash3_x64_128
@@ -29,14 +31,77 @@
 #define MURMURHASH_3 MurmurHash3_x86_128
 #endif
 
+/* Bits per block: one 64-byte cache line, so a whole lookup touches a
+   single line */
+static const size_t bloomFilterBlockBits = 512;
+static const size_t bitsPerWord = 64;
+
 BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
                          bfilter_status_t new_status) {
 
     status = new_status;
+    // Round the estimate up to a whole number of blocks
     filterSize = estimateFilterSize(key_count, false_positive_prob);
+    filterSize = ((filterSize + bloomFilterBlockBits - 1) /
+                  bloomFilterBlockBits) * bloomFilterBlockBits;
     noOfHashes = estimateNoOfHashes(key_count);
     keyCounter = 0;
-    bitArray.assign(filterSize, false);
+    bitArray.assign(filterSize / bitsPerWord, 0);
+}
+
+/* Version byte prefixed to a serialized filter. Bump if the layout or the
+   hash function changes; readers discard versions they do not know.
+   Version 2: cache line blocked layout. */
+static const uint8_t bloomFilterSerialVersion = 2;
+
+/* Serialized layout: version byte, then filterSize, noOfHashes and
+   keyCounter as native-endian uint64_t, then the bit vector as raw
+   native-endian words. */
+static const size_t bloomFilterSerialHeaderSize = 1 + 3 * sizeof(uint64_t);
+
+BloomFilter::BloomFilter(const std::string& serialized) {
+    if (serialized.size() < bloomFilterSerialHeaderSize ||
+        static_cast<uint8_t>(serialized[0]) != bloomFilterSerialVersion) {
+        throw std::invalid_argument(
+                "BloomFilter(serialized): unknown version or truncated "
+                "header, size:" + std::to_string(serialized.size()));
+    }
+
+    uint64_t params[3];
+    memcpy(params, serialized.data() + 1, sizeof(params));
+    filterSize = params[0];
+    noOfHashes = params[1];
+    keyCounter = params[2];
+
+    if (filterSize == 0 || noOfHashes == 0 ||
+        (filterSize % bloomFilterBlockBits) != 0 ||
+        serialized.size() !=
+                bloomFilterSerialHeaderSize + (filterSize / 8)) {
+        throw std::invalid_argument(
+                "BloomFilter(serialized): inconsistent parameters, "
+                "filterSize:" + std::to_string(filterSize) +
+                ", noOfHashes:" + std::to_string(noOfHashes) +
+                ", size:" + std::to_string(serialized.size()));
+    }
+
+    status = BFILTER_ENABLED;
+    bitArray.resize(filterSize / bitsPerWord);
+    memcpy(bitArray.data(),
+           serialized.data() + bloomFilterSerialHeaderSize,
+           filterSize / 8);
+}
+
+std::string BloomFilter::serialize() const {
+    std::string out;
+    out.reserve(bloomFilterSerialHeaderSize + (filterSize / 8));
+    out.push_back(static_cast<char>(bloomFilterSerialVersion));
+
+    uint64_t params[3] = {filterSize, noOfHashes, keyCounter};
+    out.append(reinterpret_cast<const char*>(params), sizeof(params));
+
+    out.append(reinterpret_cast<const char*>(bitArray.data()),
+               bitArray.size() * sizeof(uint64_t));
+    return out;
 }
 
 BloomFilter::~BloomFilter() {
@@ -115,13 +180,24 @@ std::string BloomFilter::getStatusString() {
 
 void BloomFilter::addKey(const DocKey& key) {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        const uint64_t h1 = hashDocKey(key, 0);
+        const uint64_t h2 = hashDocKey(key, 1);
+        uint64_t* block = &bitArray[(h1 % (filterSize / bloomFilterBlockBits)) *
+                                    (bloomFilterBlockBits / bitsPerWord)];
+        // Derive the probe positions within the block from the second
+        // hash (the first chose the block), stepped by the first hash's
+        // upper bits forced odd so the positions do not collapse onto
+        // each other.
+        const uint64_t step = (h1 >> 32) | 1;
         bool overlap = true;
         for (uint32_t i = 0; i < noOfHashes; i++) {
-            uint64_t result = hashDocKey(key, i);
-            if (overlap && bitArray[result % filterSize] == 0) {
+            const uint64_t bit = (h2 + i * step) % bloomFilterBlockBits;
+            const uint64_t mask = uint64_t(1) << (bit % bitsPerWord);
+            uint64_t& word = block[bit / bitsPerWord];
+            if (overlap && (word & mask) == 0) {
                 overlap = false;
             }
-            bitArray[result % filterSize] = 1;
+            word |= mask;
         }
         if (!overlap) {
             keyCounter++;
@@ -131,9 +207,16 @@ void BloomFilter::addKey(const DocKey& key) {
 
 bool BloomFilter::maybeKeyExists(const DocKey& key) {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        const uint64_t h1 = hashDocKey(key, 0);
+        const uint64_t h2 = hashDocKey(key, 1);
+        const uint64_t* block =
+                &bitArray[(h1 % (filterSize / bloomFilterBlockBits)) *
+                          (bloomFilterBlockBits / bitsPerWord)];
+        const uint64_t step = (h1 >> 32) | 1;
         for (uint32_t i = 0; i < noOfHashes; i++) {
-            uint64_t result = hashDocKey(key, i);
-            if (bitArray[result % filterSize] == 0) {
+            const uint64_t bit = (h2 + i * step) % bloomFilterBlockBits;
+            if ((block[bit / bitsPerWord] &
+                 (uint64_t(1) << (bit % bitsPerWord))) == 0) {
                 // The key does NOT exist.
                 return false;
             }
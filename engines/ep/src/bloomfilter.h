@@ -37,13 +37,37 @@ enum bfilter_status_t {
  * We are to maintain the vbucket-number of these instances.
  *
  * Each vbucket will hold one such object.
+ *
+ * The bit vector is organised as 64-byte (cache line sized) blocks: one
+ * hash of the key selects a block and all noOfHashes probes are made
+ * within it, so a lookup - on the front-end path for full eviction
+ * buckets - touches a single cache line instead of scattering probes
+ * across the whole vector. The blocked layout costs a small amount of
+ * false-positive rate for the same size, which the sizing estimate
+ * absorbs.
  */
 class BloomFilter {
 public:
     BloomFilter(size_t key_count, double false_positive_prob,
                 bfilter_status_t newStatus = BFILTER_DISABLED);
+
+    /**
+     * Construct a filter from the serialized form produced by serialize().
+     * The restored filter starts out ENABLED.
+     *
+     * @throws std::invalid_argument if the data is malformed.
+     */
+    explicit BloomFilter(const std::string& serialized);
+
     ~BloomFilter();
 
+    /**
+     * Serialize the filter (its parameters plus the packed bit array) for
+     * persistence. The format is native-endian and versioned; it is only
+     * intended to be read back by the node that wrote it.
+     */
+    std::string serialize() const;
+
     void setStatus(bfilter_status_t to);
     bfilter_status_t getStatus();
     std::string getStatusString();
@@ -60,13 +84,16 @@ protected:
 
     uint64_t hashDocKey(const DocKey& key, uint32_t iteration);
 
+    /* Total size of the filter in bits; always a whole number of blocks */
     size_t filterSize;
     size_t noOfHashes;
 
     size_t keyCounter;
 
     bfilter_status_t status;
-    std::vector<bool> bitArray;
+    /* The bit vector, as 64-bit words grouped into cache line sized
+       blocks */
+    std::vector<uint64_t> bitArray;
 };
 
 #endif // SRC_BLOOMFILTER_H_
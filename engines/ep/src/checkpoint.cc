@@ -17,7 +17,9 @@
 
 #include "config.h"
 
+#include <cJSON_utils.h>
 #include <platform/checked_snprintf.h>
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -79,7 +81,8 @@ Checkpoint::Checkpoint(EPStats& st,
                        uint64_t id,
                        uint64_t snapStart,
                        uint64_t snapEnd,
-                       uint16_t vbid)
+                       uint16_t vbid,
+                       size_t expectedNumItems)
     : stats(st),
       checkpointId(id),
       snapStartSeqno(snapStart),
@@ -90,7 +93,11 @@ Checkpoint::Checkpoint(EPStats& st,
       numItems(0),
       numMetaItems(0),
       memOverhead(0),
-      effectiveMemUsage(0) {
+      effectiveMemUsage(0),
+      highestExpelledSeqno(0) {
+    if (expectedNumItems > 0) {
+        keyIndex.reserve(expectedNumItems);
+    }
     stats.memOverhead->fetch_add(memorySize());
     if (stats.memOverhead->load() >= GIGANTOR) {
         LOG(EXTENSION_LOG_WARNING,
@@ -134,6 +141,20 @@ bool Checkpoint::keyExists(const DocKey& key) {
     return keyIndex.find(key) != keyIndex.end();
 }
 
+CheckpointQueue::iterator Checkpoint::insertInSeqnoOrder(
+        const queued_item& qi) {
+    auto pos = toWrite.end();
+    while (pos != toWrite.begin()) {
+        auto prev = std::prev(pos);
+        if ((*prev)->isCheckPointMetaItem() ||
+            (*prev)->getBySeqno() <= qi->getBySeqno()) {
+            break;
+        }
+        pos = prev;
+    }
+    return toWrite.insert(pos, qi);
+}
+
 queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                                      CheckpointManager *checkpointManager) {
     if (checkpointState != CHECKPOINT_OPEN) {
@@ -142,7 +163,7 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                         ") is not OPEN");
     }
     queue_dirty_t rv;
-    checkpoint_index::iterator it = keyIndex.find(qi->getKey());
+    CheckpointQueue::iterator insertedAt;
     // Check if the item is a meta item
     if (qi->isCheckPointMetaItem()) {
         // empty items act only as a dummy element for the start of the
@@ -152,9 +173,15 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
             ++numMetaItems;
         }
         rv = NEW_ITEM;
+        // Meta items are only queued while no reservations are in flight,
+        // so a plain append keeps them in order.
         toWrite.push_back(qi);
+        insertedAt = --toWrite.end();
     } else {
-        // Check if this checkpoint already had an item for the same key
+        // Check if this checkpoint already had an item for the same key.
+        // Meta items never live in keyIndex so the lookup is only performed
+        // for normal mutations.
+        checkpoint_index::iterator it = keyIndex.find(qi->getKey());
         if (it != keyIndex.end()) {
             rv = EXISTING_ITEM;
             CheckpointQueue::iterator currPos = it->second.position;
@@ -214,21 +241,19 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                 }
             }
 
-            toWrite.push_back(qi);
+            insertedAt = insertInSeqnoOrder(qi);
             // Remove the existing item for the same key from the list.
             toWrite.erase(currPos);
         } else {
             ++numItems;
             rv = NEW_ITEM;
-            // Push the new item into the list
-            toWrite.push_back(qi);
+            // Link the new item into the list
+            insertedAt = insertInSeqnoOrder(qi);
         }
     }
 
     if (qi->getKey().size() > 0) {
-        CheckpointQueue::iterator last = toWrite.end();
-        // --last is okay as the list is not empty now.
-        index_entry entry = {--last, qi->getBySeqno()};
+        index_entry entry = {insertedAt, qi->getBySeqno()};
         // Set the index of the key to the new item that is pushed back into
         // the list.
         if (qi->isCheckPointMetaItem()) {
@@ -403,6 +428,48 @@ bool Checkpoint::isEligibleToBeUnreferenced() {
     return true;
 }
 
+size_t Checkpoint::expelItems(
+        const std::vector<CheckpointQueue::iterator>& cursorPositions) {
+    size_t expelled = 0;
+    size_t expelledMemOverhead = 0;
+
+    // Start after the initial dummy item; stop as soon as the position of
+    // any cursor is reached - everything from that point onwards has yet to
+    // be processed by that cursor.
+    auto it = toWrite.begin();
+    ++it;
+    while (it != toWrite.end()) {
+        if (std::find(cursorPositions.begin(), cursorPositions.end(), it) !=
+            cursorPositions.end()) {
+            break;
+        }
+        if ((*it)->isCheckPointMetaItem()) {
+            // Meta items are retained so that the checkpoint keeps its
+            // framing (checkpoint_start / checkpoint_end) and meta key index.
+            ++it;
+            continue;
+        }
+        const queued_item& qi = *it;
+        highestExpelledSeqno = std::max(
+                highestExpelledSeqno, static_cast<uint64_t>(qi->getBySeqno()));
+        if (qi->getKey().size() > 0) {
+            keyIndex.erase(qi->getKey());
+            expelledMemOverhead += qi->getKey().size() + sizeof(index_entry) +
+                                   sizeof(queued_item);
+        }
+        decrementMemConsumption(qi->size());
+        --numItems;
+        it = toWrite.erase(it);
+        ++expelled;
+    }
+
+    if (expelledMemOverhead > 0) {
+        memOverhead -= expelledMemOverhead;
+        stats.memOverhead->fetch_sub(expelledMemOverhead);
+    }
+    return expelled;
+}
+
 std::ostream& operator <<(std::ostream& os, const Checkpoint& c) {
     os << "Checkpoint[" << &c << "] with"
        << " seqno:{" << c.getLowSeqno() << "," << c.getHighSeqno() << "}"
@@ -429,6 +496,7 @@ CheckpointManager::CheckpointManager(EPStats& st,
       vbucketId(vbucket),
       numItems(0),
       lastBySeqno(lastSeqno),
+      adaptiveCheckpointMaxItems(config.getCheckpointMaxItems()),
       isCollapsedCheckpoint(false),
       pCursorPreCheckpointId(0),
       flusherCB(cb) {
@@ -519,8 +587,12 @@ bool CheckpointManager::addNewCheckpoint_UNLOCKED(uint64_t id,
         id, vbucketId, snapStartSeqno);
 
     bool was_empty = checkpointList.empty() ? true : false;
-    auto checkpoint = std::make_unique<Checkpoint>(stats, id, snapStartSeqno,
-                                            snapEndSeqno, vbucketId);
+    auto checkpoint = std::make_unique<Checkpoint>(stats,
+                                                   id,
+                                                   snapStartSeqno,
+                                                   snapEndSeqno,
+                                                   vbucketId,
+                                                   adaptiveCheckpointMaxItems);
     // Add a dummy item into the new checkpoint, so that any cursor referring
     // to the actual first
     // item in this new checkpoint can be safely shifted left by 1 if the
@@ -679,6 +751,14 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
                 --iitr;
             }
 
+            // A mutation with a lower reserved seqno may still be in
+            // flight; once queued it will be linked behind the cursor's
+            // position, so the lowest seqno the cursor can actually yield
+            // next is bounded by the visibility horizon.
+            result.first = std::min(
+                    result.first,
+                    static_cast<uint64_t>(getHighestVisibleSeqno()) + 1);
+
             connCursors[name] = CheckpointCursor(name, itr, iitr, skipped,
                                                  ckpt_meta_skipped, false,
                                                  needsCheckPointEndMetaItem);
@@ -704,6 +784,14 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
                 "CheckpointManager::registerCursorBySeqno the sequences number "
                 "is higher than anything currently assigned");
     }
+
+    if ((*itr)->getHighestExpelledSeqno() > startBySeqno) {
+        // Items the cursor would otherwise have picked up from this
+        // checkpoint have been expelled; the caller must backfill the gap,
+        // just as if the containing checkpoint had been removed outright.
+        result.second = true;
+    }
+
     return result;
 }
 
@@ -878,6 +966,85 @@ checkpointCursorInfoList CheckpointManager::getAllCursors() {
     return cursorInfo;
 }
 
+std::string CheckpointManager::getConnCursorSeqnosJSON() {
+    LockHolder lh(queueLock);
+    if (connCursors.size() <= 1) {
+        // Nothing beyond the persistence cursor - nothing to persist.
+        return "";
+    }
+    unique_cJSON_ptr json(cJSON_CreateObject());
+    for (const auto& cur_it : connCursors) {
+        const CheckpointCursor& cursor = cur_it.second;
+        if (cursor.name == pCursorName) {
+            continue;
+        }
+        // Meta items (e.g. the open checkpoint_start) carry a seqno one
+        // above the last real item; clamp so the persisted position never
+        // exceeds the high seqno.
+        int64_t seqno = (*cursor.currentPos)->getBySeqno();
+        seqno = std::max(int64_t(0), std::min(seqno, int64_t(lastBySeqno)));
+        cJSON_AddStringToObject(json.get(),
+                                cursor.name.c_str(),
+                                std::to_string(seqno).c_str());
+    }
+    char* ptr = cJSON_PrintUnformatted(json.get());
+    std::string result(ptr);
+    cJSON_Free(ptr);
+    return result;
+}
+
+size_t CheckpointManager::restoreItemsFromWarmup(
+        const std::vector<queued_item>& items) {
+    LockHolder lh(queueLock);
+
+    // Only valid straight after warmup: a single open checkpoint with no
+    // items queued and nothing but the persistence cursor registered, and
+    // the supplied window must reach up to the high seqno.
+    if (items.empty() || checkpointList.size() != 1 ||
+        checkpointList.back()->getState() != CHECKPOINT_OPEN ||
+        checkpointList.back()->getNumItems() != 0 ||
+        connCursors.size() != 1 || connCursors.count(pCursorName) == 0 ||
+        items.back()->getBySeqno() != lastBySeqno) {
+        return 0;
+    }
+
+    Checkpoint& openCkpt = *checkpointList.back();
+
+    // Re-point the checkpoint_start meta item and the snapshot range at
+    // the start of the restored window (setOpenCheckpointId_UNLOCKED set
+    // them for an empty checkpoint beginning at the high seqno).
+    const int64_t firstSeqno = items.front()->getBySeqno();
+    auto ckpt_start = ++(openCkpt.begin());
+    (*ckpt_start)->setBySeqno(firstSeqno);
+    openCkpt.setSnapshotStartSeqno(firstSeqno);
+    openCkpt.setSnapshotEndSeqno(lastBySeqno);
+
+    for (const auto& qi : items) {
+        if (openCkpt.queueDirty(qi, this) != NEW_ITEM) {
+            throw std::logic_error(
+                    "CheckpointManager::restoreItemsFromWarmup: restored "
+                    "items must be unique by key. vb:" +
+                    std::to_string(vbucketId) +
+                    " seqno:" + std::to_string(qi->getBySeqno()));
+        }
+        ++numItems;
+        openCkpt.incrementMemConsumption(qi->size());
+    }
+
+    // The restored items are already persisted; place the persistence
+    // cursor after them so the flusher does not write them again. The
+    // offset mirrors what registerCursorBySeqno would compute for a
+    // cursor at the end of the checkpoint: all restored items plus the
+    // checkpoint_start meta item.
+    CheckpointCursor& pcursor = connCursors[pCursorName];
+    pcursor.currentCheckpoint = checkpointList.begin();
+    pcursor.currentPos = --(openCkpt.end());
+    pcursor.offset = items.size() + 1;
+    pcursor.setMetaItemOffset(1);
+
+    return items.size();
+}
+
 bool CheckpointManager::isCheckpointCreationForHighMemUsage(
         const VBucket& vbucket) {
     bool forceCreation = false;
@@ -990,6 +1157,58 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
     return numUnrefItems;
 }
 
+size_t CheckpointManager::expelUnreferencedCheckpointItems() {
+    LockHolder lh(queueLock);
+    if (checkpointList.empty()) {
+        return 0;
+    }
+
+    // Only expel from the oldest checkpoint, and only once it is closed -
+    // expelling from the open checkpoint would invalidate the
+    // de-duplication performed by Checkpoint::queueDirty. Checkpoint
+    // collapsing re-inserts the items of closed checkpoints, so expelling
+    // is disabled when checkpoint merging is in use.
+    Checkpoint* const oldestCheckpoint = checkpointList.front().get();
+    if (oldestCheckpoint->getState() != CHECKPOINT_CLOSED ||
+        checkpointConfig.isCheckpointMergeSupported()) {
+        return 0;
+    }
+    if (oldestCheckpoint->getNumberOfCursors() == 0) {
+        // Wholly unreferenced - leave it to removeClosedUnrefCheckpoints.
+        return 0;
+    }
+
+    std::vector<CheckpointQueue::iterator> cursorPositions;
+    for (const auto& cursor : connCursors) {
+        if ((*(cursor.second.currentCheckpoint)).get() == oldestCheckpoint) {
+            auto pos = cursor.second.currentPos;
+            if (pos == oldestCheckpoint->begin()) {
+                // Cursor is still on the initial dummy item and has
+                // processed nothing in this checkpoint; the expel walk
+                // starts one past the dummy, so stop it there.
+                ++pos;
+            }
+            cursorPositions.push_back(pos);
+        }
+    }
+    if (cursorPositions.empty()) {
+        // The checkpoint's cursor name list and connCursors disagree; don't
+        // expel anything based on stale information.
+        return 0;
+    }
+
+    size_t expelled = oldestCheckpoint->expelItems(cursorPositions);
+    if (expelled > 0) {
+        numItems.fetch_sub(expelled);
+        // Every cursor is positioned at or after the last expelled item, so
+        // all of their offsets include the expelled items.
+        for (auto& cursor : connCursors) {
+            cursor.second.decrOffset(expelled);
+        }
+    }
+    return expelled;
+}
+
 void CheckpointManager::removeInvalidCursorsOnCheckpoint(
                                                      Checkpoint *pCheckpoint) {
     std::list<std::string> invalidCursorNames;
@@ -1129,78 +1348,154 @@ void CheckpointManager::updateStatsForNewQueuedItem_UNLOCKED(const LockHolder&,
     checkpointList.back()->incrementMemConsumption(qi->size());
 }
 
-bool CheckpointManager::queueDirty(
+int64_t CheckpointManager::reserveBySeqno(
         VBucket& vb,
         queued_item& qi,
-        const GenerateBySeqno generateBySeqno,
         const GenerateCas generateCas,
         PreLinkDocumentContext* preLinkDocumentContext) {
-    LockHolder lh(queueLock);
-
-    bool canCreateNewCheckpoint = false;
-    if (checkpointList.size() < checkpointConfig.getMaxCheckpoints() ||
-        (checkpointList.size() == checkpointConfig.getMaxCheckpoints() &&
-         checkpointList.front()->getNumberOfCursors() == 0)) {
-        canCreateNewCheckpoint = true;
+    LockHolder sl(seqnoLock);
+    const int64_t seqno = ++lastBySeqno;
+    inFlightSeqnos.insert(seqno);
+    qi->setBySeqno(seqno);
+
+    // MB-20798: Generate the HLC under the same (leaf) lock, so the CAS
+    // is still created 'atomically' with the seqno - CAS ordering must
+    // match seqno ordering or XDCR may drop the newer mutation.
+    if (GenerateCas::Yes == generateCas) {
+        auto cas = vb.nextHLCCas();
+        qi->setCas(cas);
+        if (preLinkDocumentContext != nullptr) {
+            preLinkDocumentContext->preLink(cas, seqno);
+        }
     }
+    return seqno;
+}
 
-    if (vb.getState() == vbucket_state_active && canCreateNewCheckpoint) {
-        // Only the master active vbucket can create a next open checkpoint.
-        checkOpenCheckpoint_UNLOCKED(false, true);
-    }
+void CheckpointManager::completeBySeqno(int64_t seqno) {
+    LockHolder sl(seqnoLock);
+    inFlightSeqnos.erase(seqno);
+}
 
-    if (checkpointList.back()->getState() == CHECKPOINT_CLOSED) {
-        if (vb.getState() == vbucket_state_active) {
-            addNewCheckpoint_UNLOCKED(checkpointList.back()->getId() + 1);
-        } else {
-            throw std::logic_error("CheckpointManager::queueDirty: vBucket "
-                    "state (which is " +
-                    std::string(VBucket::toString(vb.getState())) +
-                    ") is not active. This is not expected. vb:" +
-                    std::to_string(vb.getId()) +
-                    " lastBySeqno:" + std::to_string(lastBySeqno) +
-                    " genSeqno:" + to_string(generateBySeqno));
-        }
+int64_t CheckpointManager::getHighestVisibleSeqno() const {
+    LockHolder sl(seqnoLock);
+    if (inFlightSeqnos.empty()) {
+        return lastBySeqno;
     }
+    return *inFlightSeqnos.begin() - 1;
+}
 
-    if (checkpointList.back()->getState() != CHECKPOINT_OPEN) {
-        throw std::logic_error(
-                "Checkpoint::queueDirty: current checkpointState (which is" +
-                std::to_string(checkpointList.back()->getState()) +
-                ") is not OPEN");
+int64_t CheckpointManager::getLowestInFlightSeqno() const {
+    LockHolder sl(seqnoLock);
+    if (inFlightSeqnos.empty()) {
+        return lastBySeqno;
     }
+    return *inFlightSeqnos.begin();
+}
 
+bool CheckpointManager::reservationsInFlight() const {
+    LockHolder sl(seqnoLock);
+    return !inFlightSeqnos.empty();
+}
+
+bool CheckpointManager::queueDirty(
+        VBucket& vb,
+        queued_item& qi,
+        const GenerateBySeqno generateBySeqno,
+        const GenerateCas generateCas,
+        PreLinkDocumentContext* preLinkDocumentContext) {
+    // Reserve the seqno (and CAS) before acquiring queueLock; the
+    // serialized section of sequence generation is then just the
+    // increment (plus in-flight bookkeeping) under seqnoLock. The
+    // checkpoint insertion below accepts reservations completing out of
+    // their reserved order; cursors are prevented from observing the
+    // resulting transient gaps by incrCursor().
+    int64_t reservedSeqno{0};
     if (GenerateBySeqno::Yes == generateBySeqno) {
-        qi->setBySeqno(++lastBySeqno);
-        checkpointList.back()->setSnapshotEndSeqno(lastBySeqno);
-    } else {
-        lastBySeqno = qi->getBySeqno();
+        reservedSeqno =
+                reserveBySeqno(vb, qi, generateCas, preLinkDocumentContext);
     }
 
-    // MB-20798: Allow the HLC to be created 'atomically' with the seqno as
-    // we're holding the ::queueLock.
-    if (GenerateCas::Yes == generateCas) {
-        auto cas = vb.nextHLCCas();
-        qi->setCas(cas);
-        if (preLinkDocumentContext != nullptr) {
-            preLinkDocumentContext->preLink(cas, lastBySeqno);
+    LockHolder lh(queueLock);
+
+    queue_dirty_t result;
+    try {
+        if (checkpointList.back()->getState() == CHECKPOINT_CLOSED) {
+            if (vb.getState() == vbucket_state_active) {
+                // Any reservations still in flight must land inside the
+                // new open checkpoint, so start its snapshot at the lowest
+                // of them.
+                addNewCheckpoint_UNLOCKED(checkpointList.back()->getId() + 1,
+                                          getLowestInFlightSeqno(),
+                                          lastBySeqno);
+            } else {
+                throw std::logic_error("CheckpointManager::queueDirty: "
+                        "vBucket state (which is " +
+                        std::string(VBucket::toString(vb.getState())) +
+                        ") is not active. This is not expected. vb:" +
+                        std::to_string(vb.getId()) +
+                        " lastBySeqno:" + std::to_string(lastBySeqno) +
+                        " genSeqno:" + to_string(generateBySeqno));
+            }
+        }
+
+        if (checkpointList.back()->getState() != CHECKPOINT_OPEN) {
+            throw std::logic_error(
+                    "Checkpoint::queueDirty: current checkpointState (which "
+                    "is" +
+                    std::to_string(checkpointList.back()->getState()) +
+                    ") is not OPEN");
+        }
+
+        if (GenerateBySeqno::Yes == generateBySeqno) {
+            // Reservations may complete out of order; only ever extend the
+            // open snapshot.
+            checkpointList.back()->setSnapshotEndSeqno(
+                    std::max(checkpointList.back()->getSnapshotEndSeqno(),
+                             static_cast<uint64_t>(reservedSeqno)));
+        } else {
+            lastBySeqno = qi->getBySeqno();
+
+            // MB-20798: No seqno was reserved, so the HLC couldn't be
+            // generated at reservation time; create it here 'atomically'
+            // with the seqno as we're holding the ::queueLock.
+            if (GenerateCas::Yes == generateCas) {
+                auto cas = vb.nextHLCCas();
+                qi->setCas(cas);
+                if (preLinkDocumentContext != nullptr) {
+                    preLinkDocumentContext->preLink(cas, lastBySeqno);
+                }
+            }
+        }
+
+        uint64_t st = checkpointList.back()->getSnapshotStartSeqno();
+        uint64_t en = checkpointList.back()->getSnapshotEndSeqno();
+        const uint64_t itemSeqno = static_cast<uint64_t>(qi->getBySeqno());
+        if (!(st <= itemSeqno && itemSeqno <= en)) {
+            throw std::logic_error("CheckpointManager::queueDirty: seqno "
+                    "not in snapshot range. vb:" + std::to_string(vb.getId()) +
+                    " state:" + std::string(VBucket::toString(vb.getState())) +
+                    " snapshotStart:" + std::to_string(st) +
+                    " seqno:" + std::to_string(itemSeqno) +
+                    " snapshotEnd:" + std::to_string(en) +
+                    " genSeqno:" + to_string(generateBySeqno));
         }
-    }
 
-    uint64_t st = checkpointList.back()->getSnapshotStartSeqno();
-    uint64_t en = checkpointList.back()->getSnapshotEndSeqno();
-    if (!(st <= static_cast<uint64_t>(lastBySeqno) &&
-          static_cast<uint64_t>(lastBySeqno) <= en)) {
-        throw std::logic_error("CheckpointManager::queueDirty: lastBySeqno "
-                "not in snapshot range. vb:" + std::to_string(vb.getId()) +
-                " state:" + std::string(VBucket::toString(vb.getState())) +
-                " snapshotStart:" + std::to_string(st) +
-                " lastBySeqno:" + std::to_string(lastBySeqno) +
-                " snapshotEnd:" + std::to_string(en) +
-                " genSeqno:" + to_string(generateBySeqno));
+        result = checkpointList.back()->queueDirty(qi, this);
+    } catch (...) {
+        // Retire the reservation even on failure, otherwise the
+        // visibility horizon would never advance past it.
+        if (reservedSeqno != 0) {
+            completeBySeqno(reservedSeqno);
+        }
+        throw;
     }
 
-    queue_dirty_t result = checkpointList.back()->queueDirty(qi, this);
+    if (reservedSeqno != 0) {
+        // The item is now linked into the open checkpoint; retire the
+        // reservation so that cursors may advance onto it. Performed
+        // while still holding queueLock so no cursor can run in between.
+        completeBySeqno(reservedSeqno);
+    }
 
     if (result == NEW_ITEM) {
         ++numItems;
@@ -1210,6 +1505,25 @@ bool CheckpointManager::queueDirty(
         updateStatsForNewQueuedItem_UNLOCKED(lh, vb, qi);
     }
 
+    // Consider creating a new open checkpoint. Performed after queueing
+    // (rather than before, as previously) and only while no reservations
+    // are in flight, so that the boundary seqnos which
+    // addNewCheckpoint_UNLOCKED derives from lastBySeqno only ever cover
+    // fully-queued mutations. If the window isn't quiescent right now a
+    // later mutation will perform the rotation instead.
+    bool canCreateNewCheckpoint = false;
+    if (checkpointList.size() < checkpointConfig.getMaxCheckpoints() ||
+        (checkpointList.size() == checkpointConfig.getMaxCheckpoints() &&
+         checkpointList.front()->getNumberOfCursors() == 0)) {
+        canCreateNewCheckpoint = true;
+    }
+
+    if (vb.getState() == vbucket_state_active && canCreateNewCheckpoint &&
+        !reservationsInFlight()) {
+        // Only the master active vbucket can create a next open checkpoint.
+        checkOpenCheckpoint_UNLOCKED(false, true);
+    }
+
     return result != EXISTING_ITEM;
 }
 
@@ -1245,6 +1559,14 @@ snapshot_range_t CheckpointManager::getAllItemsForCursor(
         return range;
     }
 
+    // Reserve space for the items to be copied out up-front; growing the
+    // vector incrementally would pay for reallocations (and the refcount
+    // churn of re-copying the queued_items) while holding queueLock.
+    const size_t offset = it->second.offset.load();
+    if (numItems > offset) {
+        items.reserve(items.size() + (numItems - offset));
+    }
+
     bool moreItems;
     range.start = (*it->second.currentCheckpoint)->getSnapshotStartSeqno();
     range.end = (*it->second.currentCheckpoint)->getSnapshotEndSeqno();
@@ -1306,17 +1628,31 @@ queued_item CheckpointManager::nextItem(const std::string &name,
 }
 
 bool CheckpointManager::incrCursor(CheckpointCursor &cursor) {
-    if (++(cursor.currentPos) != (*(cursor.currentCheckpoint))->end()) {
+    return incrCursor(cursor, getHighestVisibleSeqno());
+}
+
+bool CheckpointManager::incrCursor(CheckpointCursor& cursor,
+                                   int64_t visibleSeqno) {
+    auto next = std::next(cursor.currentPos);
+    if (next != (*(cursor.currentCheckpoint))->end()) {
+        if ((*next)->getBySeqno() > visibleSeqno) {
+            // The next item is beyond the highest seqno which is safe to
+            // expose: a mutation with a lower reserved seqno is still in
+            // flight and will be linked in front of it (see
+            // reserveBySeqno). Leave the cursor where it is; it will pick
+            // the items up once the reservation completes.
+            return false;
+        }
+        cursor.currentPos = next;
         ++(cursor.offset);
         if ((*cursor.currentPos)->isNonEmptyCheckpointMetaItem()) {
             cursor.incrMetaItemOffset(1);
         }
         return true;
     } else if (!moveCursorToNextCheckpoint(cursor)) {
-        --(cursor.currentPos);
         return false;
     }
-    return incrCursor(cursor);
+    return incrCursor(cursor, visibleSeqno);
 }
 
 void CheckpointManager::dump() const {
@@ -1324,19 +1660,30 @@ void CheckpointManager::dump() const {
 }
 
 void CheckpointManager::clear(VBucket& vb, uint64_t seqno) {
-    LockHolder lh(queueLock);
-    clear_UNLOCKED(vb.getState(), seqno);
-
-    // Reset the disk write queue size stat for the vbucket
-    if (checkpointConfig.isPersistenceEnabled()) {
-        size_t currentDqSize = vb.dirtyQueueSize.load();
-        vb.dirtyQueueSize.fetch_sub(currentDqSize);
-        stats.diskQueueSize.fetch_sub(currentDqSize);
+    // Destroyed after queueLock is released (see clear_UNLOCKED).
+    CheckpointList removed;
+    {
+        LockHolder lh(queueLock);
+        removed = clear_UNLOCKED(vb.getState(), seqno);
+
+        // Reset the disk write queue size stat for the vbucket
+        if (checkpointConfig.isPersistenceEnabled()) {
+            size_t currentDqSize = vb.dirtyQueueSize.load();
+            vb.dirtyQueueSize.fetch_sub(currentDqSize);
+            stats.diskQueueSize.fetch_sub(currentDqSize);
+        }
     }
 }
 
-void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno) {
-    checkpointList.clear();
+CheckpointList CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState,
+                                                 uint64_t seqno) {
+    // Detach the entire checkpoint list rather than clearing it in place;
+    // the caller destroys the returned list once queueLock has been
+    // released. Tearing down a large series of checkpoints releases every
+    // queued item individually, which is far too much work to perform
+    // while holding the lock front-end writers need.
+    CheckpointList removed;
+    removed.swap(checkpointList);
     numItems = 0;
     lastBySeqno.reset(seqno);
     pCursorPreCheckpointId = 0;
@@ -1345,6 +1692,8 @@ void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno)
     // Add a new open checkpoint.
     addNewCheckpoint_UNLOCKED(checkpointId);
     resetCursors();
+
+    return removed;
 }
 
 void CheckpointManager::resetCursors(bool resetPersistenceCursor) {
@@ -1410,27 +1759,59 @@ uint64_t CheckpointManager::checkOpenCheckpoint_UNLOCKED(bool forceCreation,
                                                          bool timeBound) {
     int checkpoint_id = 0;
 
-    timeBound = timeBound &&
-                (ep_real_time() - checkpointList.back()->getCreationTime()) >=
-                checkpointConfig.getCheckpointPeriod();
+    const rel_time_t age =
+            ep_real_time() - checkpointList.back()->getCreationTime();
+    timeBound = timeBound && age >= checkpointConfig.getCheckpointPeriod();
+
+    const bool filledByItemCount =
+            checkpointConfig.isItemNumBasedNewCheckpoint() &&
+            checkpointList.back()->getNumItems() >=
+                    adaptiveCheckpointMaxItems;
+
     // Create the new open checkpoint if any of the following conditions is
     // satisfied:
     // (1) force creation due to online update or high memory usage
     // (2) current checkpoint is reached to the max number of items allowed.
     // (3) time elapsed since the creation of the current checkpoint is greater
     //     than the threshold
-    if (forceCreation ||
-        (checkpointConfig.isItemNumBasedNewCheckpoint() &&
-         checkpointList.back()->getNumItems() >=
-         checkpointConfig.getCheckpointMaxItems()) ||
+    if (forceCreation || filledByItemCount ||
         (checkpointList.back()->getNumItems() > 0 && timeBound)) {
 
+        if (!forceCreation) {
+            adaptCheckpointMaxItems_UNLOCKED(filledByItemCount, age);
+        }
         checkpoint_id = checkpointList.back()->getId();
         addNewCheckpoint_UNLOCKED(checkpoint_id + 1);
     }
     return checkpoint_id;
 }
 
+void CheckpointManager::adaptCheckpointMaxItems_UNLOCKED(
+        bool filledByItemCount, rel_time_t age) {
+    if (!checkpointConfig.isItemNumBasedNewCheckpoint()) {
+        return;
+    }
+    const size_t base = checkpointConfig.getCheckpointMaxItems();
+    if (filledByItemCount &&
+        (age * 4) < checkpointConfig.getCheckpointPeriod() &&
+        checkpointList.size() == 1) {
+        // Mutations are arriving much faster than one checkpoint per period
+        // and every cursor has kept pace (no closed checkpoints remain):
+        // run larger checkpoints to reduce per-checkpoint overhead while
+        // the bulk load lasts.
+        adaptiveCheckpointMaxItems =
+                std::min(adaptiveCheckpointMaxItems.load() * 2,
+                         size_t(MAX_CHECKPOINT_ITEMS));
+    } else if (!filledByItemCount || checkpointList.size() > 1) {
+        // The mutation rate has dropped back, or closed checkpoints are
+        // accumulating behind slow cursors: decay towards the configured
+        // size so replicas and the flusher see new checkpoints - and can
+        // acknowledge them - sooner.
+        adaptiveCheckpointMaxItems =
+                std::max(adaptiveCheckpointMaxItems.load() / 2, base);
+    }
+}
+
 size_t CheckpointManager::getNumItemsForCursor(const std::string &name) const {
     LockHolder lh(queueLock);
     return getNumItemsForCursor_UNLOCKED(name);
@@ -1846,7 +2227,6 @@ uint64_t CheckpointManager::createNewCheckpoint() {
 }
 
 uint64_t CheckpointManager::getPersistenceCursorPreChkId() {
-    LockHolder lh(queueLock);
     return pCursorPreCheckpointId;
 }
 
@@ -1916,6 +2296,9 @@ void CheckpointManager::addStats(ADD_STAT add_stat, const void *cookie) {
         add_casted_stat(buf, checkpointList.empty() ? 0 :
                              checkpointList.back()->getNumItems(),
                         add_stat, cookie);
+        checked_snprintf(buf, sizeof(buf), "vb_%d:open_checkpoint_max_items",
+                         vbucketId);
+        add_casted_stat(buf, adaptiveCheckpointMaxItems, add_stat, cookie);
         checked_snprintf(buf, sizeof(buf), "vb_%d:num_checkpoints", vbucketId);
         add_casted_stat(buf, checkpointList.size(), add_stat, cookie);
         checked_snprintf(buf, sizeof(buf), "vb_%d:num_items_for_persistence",
@@ -27,6 +27,7 @@
 #include "locks.h"
 #include "stats.h"
 
+#include <algorithm>
 #include <atomic>
 #include <list>
 #include <map>
@@ -344,11 +345,18 @@ enum queue_dirty_t {
  */
 class Checkpoint {
 public:
+    /**
+     * @param expectedNumItems the number of items this checkpoint is
+     *        expected to hold (typically the configured maximum before a
+     *        new checkpoint is created). Used to size the key index
+     *        up-front so it does not rehash while the checkpoint fills.
+     */
     Checkpoint(EPStats& st,
                uint64_t id,
                uint64_t snapStart,
                uint64_t snapEnd,
-               uint16_t vbid);
+               uint16_t vbid,
+               size_t expectedNumItems = 0);
 
     ~Checkpoint();
 
@@ -533,6 +541,31 @@ public:
      */
     bool isEligibleToBeUnreferenced();
 
+    /**
+     * Expel from this checkpoint all non-meta items which precede every one
+     * of the given cursor positions - i.e. items which every cursor in this
+     * checkpoint has already processed. Meta items are retained so that the
+     * checkpoint keeps its framing (checkpoint_start / checkpoint_end) and
+     * its meta key index intact.
+     *
+     * The key index entries of the expelled items are removed and the
+     * checkpoint's memory accounting is adjusted accordingly.
+     *
+     * @param cursorPositions positions of all the cursors currently in this
+     *        checkpoint; expelling stops at the first of them encountered.
+     * @return the number of items expelled.
+     */
+    size_t expelItems(
+            const std::vector<CheckpointQueue::iterator>& cursorPositions);
+
+    /**
+     * Return the highest seqno of any item that has been expelled from this
+     * checkpoint, or 0 if no items have been expelled.
+     */
+    uint64_t getHighestExpelledSeqno() const {
+        return highestExpelledSeqno;
+    }
+
     /**
      * Invoked by the checkpoint manager whenever an item is queued
      * into the given checkpoint.
@@ -542,6 +575,14 @@ public:
         effectiveMemUsage += by;
     }
 
+    /**
+     * Invoked whenever an item is expelled from the given checkpoint.
+     * @param Amount of memory being removed from current usage
+     */
+    void decrementMemConsumption(size_t by) {
+        effectiveMemUsage -= std::min(effectiveMemUsage, by);
+    }
+
     /**
      * Returns the memory held by all the queued items which includes
      * key, metadata and the blob.
@@ -556,6 +597,17 @@ public:
     static const StoredDocKey SetVBucketStateKey;
 
 private:
+    /**
+     * Link a non-meta item into toWrite, maintaining seqno order. Seqno
+     * reservation is decoupled from queueing (see
+     * CheckpointManager::reserveBySeqno), so a mutation may arrive here
+     * after one with a later reserved seqno; walk back past any such
+     * items. The reorder window is only the gap between reserving a
+     * seqno and acquiring queueLock, so this scan is almost always zero
+     * steps.
+     */
+    CheckpointQueue::iterator insertInSeqnoOrder(const queued_item& qi);
+
     EPStats                       &stats;
     uint64_t                       checkpointId;
     uint64_t                       snapStartSeqno;
@@ -578,6 +630,11 @@ private:
     // the queued items in the given checkpoint.
     size_t                         effectiveMemUsage;
 
+    // Highest seqno of any item expelled from this checkpoint (0 if none).
+    // Used to inform cursor registration that a backfill is required for
+    // seqnos which can no longer be read from this checkpoint.
+    uint64_t                       highestExpelledSeqno;
+
     friend std::ostream& operator <<(std::ostream& os, const Checkpoint& m);
 };
 
@@ -626,6 +683,16 @@ public:
     size_t removeClosedUnrefCheckpoints(VBucket& vbucket,
                                         bool& newOpenCheckpointCreated);
 
+    /**
+     * Expel from the oldest (closed) checkpoint those items which every
+     * cursor in that checkpoint has already processed, without having to
+     * wait for all the cursors to leave the checkpoint so it can be removed
+     * outright. A cursor subsequently re-registered at a seqno covered by
+     * the expelled items is flagged to backfill (see registerCursorBySeqno).
+     * @return the number of items expelled.
+     */
+    size_t expelUnreferencedCheckpointItems();
+
     /**
      * Register the cursor for getting items whose bySeqno values are between
      * startBySeqno and endBySeqno, and close the open checkpoint if endBySeqno
@@ -685,6 +752,35 @@ public:
      */
     checkpointCursorInfoList getAllCursors();
 
+    /**
+     * Return a JSON object mapping the name of every connection cursor
+     * (excluding the persistence cursor) to the seqno it has reached, or
+     * an empty string if no connection cursors are registered. The result
+     * is persisted as part of the vbucket state so that
+     * restoreItemsFromWarmup() can rebuild a checkpoint covering the
+     * window reconnecting clients will ask for.
+     */
+    std::string getConnCursorSeqnosJSON();
+
+    /**
+     * Re-populate the open checkpoint with items loaded from disk at
+     * warmup, covering the seqno window between the lowest persisted
+     * connection cursor and the high seqno. Reconnecting DCP clients whose
+     * start seqno lies inside the window can then resume from memory
+     * instead of triggering a disk backfill.
+     *
+     * The items must be sorted by seqno, unique by key and end at the high
+     * seqno this manager was created with, and the manager must still be
+     * in its post-warmup state (a single empty open checkpoint with only
+     * the persistence cursor registered). The persistence cursor is moved
+     * past the restored items as they are already on disk.
+     *
+     * @param items the items to restore, in seqno order.
+     * @return the number of items restored; 0 if the preconditions do not
+     *         hold (in which case nothing is changed).
+     */
+    size_t restoreItemsFromWarmup(const std::vector<queued_item>& items);
+
     /**
      * Queue an item to be written to persistent layer.
      * @param vb the vbucket that a new item is pushed into.
@@ -743,8 +839,12 @@ public:
     size_t getNumItemsForCursor(const std::string &name) const;
 
     void clear(vbucket_state_t vbState) {
-        LockHolder lh(queueLock);
-        clear_UNLOCKED(vbState, lastBySeqno);
+        // Destroyed after queueLock is released (see clear_UNLOCKED).
+        CheckpointList removed;
+        {
+            LockHolder lh(queueLock);
+            removed = clear_UNLOCKED(vbState, lastBySeqno);
+        }
     }
 
     /**
@@ -766,6 +866,16 @@ public:
         return checkpointConfig;
     }
 
+    /**
+     * Return the item-count limit currently applied to the open checkpoint.
+     * Starts at the configured checkpoint_max_items and adapts between that
+     * base and MAX_CHECKPOINT_ITEMS depending on the observed fill and
+     * drain rates (see adaptCheckpointMaxItems_UNLOCKED).
+     */
+    size_t getOpenCheckpointMaxItems() const {
+        return adaptiveCheckpointMaxItems;
+    }
+
     void addStats(ADD_STAT add_stat, const void *cookie);
 
     /**
@@ -841,17 +951,14 @@ public:
     }
 
     void setBySeqno(int64_t seqno) {
-        LockHolder lh(queueLock);
         lastBySeqno = seqno;
     }
 
     int64_t getHighSeqno() const {
-        LockHolder lh(queueLock);
         return lastBySeqno;
     }
 
     int64_t nextBySeqno() {
-        LockHolder lh(queueLock);
         return ++lastBySeqno;
     }
 
@@ -894,6 +1001,45 @@ private:
     // when collapsing checkpoints.
     using CursorIdToPositionMap = std::map<std::string, CursorPosition>;
 
+    /**
+     * Reserve the next seqno for the given item - an atomic increment of
+     * lastBySeqno plus in-flight bookkeeping under seqnoLock, performed
+     * /without/ holding queueLock. If requested, the CAS is generated
+     * under the same lock so it remains ordered with the seqno
+     * (MB-20798); the small serialized section here replaces holding
+     * queueLock across sequence generation.
+     *
+     * The reservation is "in flight" until completeBySeqno() is called;
+     * cursors will not advance past an in-flight seqno (see incrCursor).
+     *
+     * @return the reserved seqno.
+     */
+    int64_t reserveBySeqno(VBucket& vb,
+                           queued_item& qi,
+                           const GenerateCas generateCas,
+                           PreLinkDocumentContext* preLinkDocumentContext);
+
+    /// Retire a reservation made by reserveBySeqno, allowing cursors to
+    /// advance past it.
+    void completeBySeqno(int64_t seqno);
+
+    /**
+     * Highest seqno which cursors may safely advance to. Seqnos above it
+     * have been reserved by mutations which are not yet linked into the
+     * open checkpoint; exposing them would let a cursor observe a seqno
+     * gap.
+     */
+    int64_t getHighestVisibleSeqno() const;
+
+    /// Lowest reserved-but-not-yet-queued seqno; lastBySeqno if none.
+    int64_t getLowestInFlightSeqno() const;
+
+    /// Whether any seqno reservations are currently in flight.
+    bool reservationsInFlight() const;
+
+    /// incrCursor() against a previously-sampled visibility horizon.
+    bool incrCursor(CheckpointCursor& cursor, int64_t visibleSeqno);
+
     bool removeCursor_UNLOCKED(const std::string &name);
 
     bool registerCursor_UNLOCKED(
@@ -904,7 +1050,13 @@ private:
 
     size_t getNumItemsForCursor_UNLOCKED(const std::string &name) const;
 
-    void clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno);
+    /**
+     * Replace all checkpoints with a single new open checkpoint and reset
+     * the cursors onto it. Returns the removed checkpoints; the caller must
+     * destroy them after releasing queueLock (teardown of a large
+     * checkpoint series is too expensive to perform under the lock).
+     */
+    CheckpointList clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno);
 
     /**
      * Create a new open checkpoint and add it to the checkpoint list.
@@ -932,6 +1084,24 @@ private:
      */
     uint64_t checkOpenCheckpoint_UNLOCKED(bool forceCreation, bool timeBound);
 
+    /**
+     * Adapt the item-count limit applied to the next open checkpoint, based
+     * on how the one just being closed behaved. If it filled well within the
+     * checkpoint period and every cursor kept pace (no closed checkpoints
+     * remain), the limit is doubled so bulk loads run large checkpoints with
+     * less per-checkpoint overhead. If it was closed by the time bound, or
+     * closed checkpoints are accumulating behind slow cursors, the limit
+     * decays back towards the configured checkpoint_max_items so replicas
+     * and the flusher see new checkpoints - and can acknowledge them -
+     * sooner.
+     *
+     * @param filledByItemCount true if the checkpoint is being closed because
+     *        it reached the current item-count limit.
+     * @param age time in seconds since the closing checkpoint was created.
+     */
+    void adaptCheckpointMaxItems_UNLOCKED(bool filledByItemCount,
+                                          rel_time_t age);
+
     uint64_t checkOpenCheckpoint(bool forceCreation, bool timeBound) {
         LockHolder lh(queueLock);
         return checkOpenCheckpoint_UNLOCKED(forceCreation, timeBound);
@@ -968,11 +1138,27 @@ private:
     // Total number of items (including meta items) in /all/ checkpoints managed
     // by this object.
     std::atomic<size_t>      numItems;
-    Monotonic<int64_t>       lastBySeqno;
+    // Atomic so the highest assigned seqno can be read (and the next seqno
+    // generated) without taking queueLock; mutations which also modify the
+    // checkpoint list still serialize on queueLock.
+    AtomicMonotonic<int64_t> lastBySeqno;
+    // Guards seqno/CAS reservation and the in-flight reservation set. A
+    // leaf lock: may be acquired while holding queueLock, never the other
+    // way around.
+    mutable std::mutex       seqnoLock;
+    // Seqnos which have been reserved for a mutation (see reserveBySeqno)
+    // but whose items are not yet linked into the open checkpoint.
+    // Guarded by seqnoLock.
+    std::set<int64_t>        inFlightSeqnos;
     CheckpointList checkpointList;
+    // Adaptive item-count limit for the open checkpoint (see
+    // adaptCheckpointMaxItems_UNLOCKED). Only written under queueLock.
+    std::atomic<size_t>      adaptiveCheckpointMaxItems;
     bool                     isCollapsedCheckpoint;
     uint64_t                 lastClosedCheckpointId;
-    uint64_t                 pCursorPreCheckpointId;
+    // Atomic so the flusher can read it without taking queueLock; only
+    // updated while queueLock is held.
+    std::atomic<uint64_t>    pCursorPreCheckpointId;
     cursor_index             connCursors;
 
     FlusherCallback          flusherCB;
@@ -23,26 +23,36 @@
 #include "dcp/dcpconnmap.h"
 #include "ep_engine.h"
 #include "kv_bucket_iface.h"
+#include "kvshard.h"
 #include "vbucket.h"
 
 #include <phosphor/phosphor.h>
 #include <platform/make_unique.h>
 
 /**
- * Remove all the closed unreferenced checkpoints for each vbucket.
+ * Remove all the closed unreferenced checkpoints for the vbuckets of one
+ * shard. One visitor is scheduled per shard so that checkpoint memory
+ * recovery scales with the NonIO pool during mutation bursts.
  */
 class CheckpointVisitor : public VBucketVisitor {
 public:
 
     /**
-     * Construct a CheckpointVisitor.
+     * Construct a CheckpointVisitor for the vbuckets of the given shard.
      */
-    CheckpointVisitor(KVBucketIface* s, EPStats& st, std::atomic<bool>& sfin)
-        : store(s),
+    CheckpointVisitor(KVBucketIface* s,
+                      EPStats& st,
+                      uint16_t shard,
+                      std::atomic<size_t>& completedCount,
+                      std::atomic<bool>& sfin)
+        : VBucketVisitor(
+                  VBucketFilter(s->getVBuckets().getShard(shard)->getVBuckets())),
+          store(s),
           stats(st),
           removed(0),
           taskStart(ProcessClock::now()),
           wasHighMemoryUsage(s->isMemoryUsageTooHigh()),
+          completedCount(completedCount),
           stateFinalizer(sfin) {
     }
 
@@ -64,11 +74,30 @@ public:
                 removed, vb->getId());
         }
         removed = 0;
+
+        // If memory usage is still above the high watermark, additionally
+        // expel individual items that every cursor has already processed
+        // from the vbucket's oldest referenced checkpoint.
+        if (store->isMemoryUsageTooHigh()) {
+            size_t expelled =
+                    vb->checkpointManager->expelUnreferencedCheckpointItems();
+            stats.itemsExpelledFromCheckpoints.fetch_add(expelled);
+            if (expelled > 0) {
+                LOG(EXTENSION_LOG_INFO,
+                    "Expelled %ld already-processed items from referenced "
+                    "checkpoints of VBucket %d",
+                    expelled, vb->getId());
+            }
+        }
     }
 
     void complete() override {
-        bool inverse = false;
-        stateFinalizer.compare_exchange_strong(inverse, true);
+        // Only the last of the per-shard visitors to finish makes the
+        // remover task available for another run.
+        if (++completedCount == store->getVBuckets().getNumShards()) {
+            bool inverse = false;
+            stateFinalizer.compare_exchange_strong(inverse, true);
+        }
 
         stats.checkpointRemoverHisto.add(
                 std::chrono::duration_cast<std::chrono::microseconds>(
@@ -87,6 +116,7 @@ private:
     size_t                     removed;
     ProcessClock::time_point   taskStart;
     bool                       wasHighMemoryUsage;
+    std::atomic<size_t>       &completedCount;
     std::atomic<bool>         &stateFinalizer;
 };
 
@@ -145,16 +175,24 @@ bool ClosedUnrefCheckpointRemoverTask::run(void) {
     bool inverse = true;
     if (available.compare_exchange_strong(inverse, false)) {
         cursorDroppingIfNeeded();
+        completedCount = 0;
         KVBucketIface* kvBucket = engine->getKVBucket();
-        auto pv =
-                std::make_unique<CheckpointVisitor>(kvBucket, stats, available);
-        // p99.999 is 10ms
-        auto maxExpectedDuration = std::chrono::milliseconds(10);
-        kvBucket->visit(std::move(pv),
-                        "Checkpoint Remover",
-                        TaskId::ClosedUnrefCheckpointRemoverVisitorTask,
-                        /*sleepTime*/ 0,
-                        maxExpectedDuration);
+        // Fan checkpoint removal out across the NonIO pool with one visitor
+        // per shard, so that memory recovery rate scales with cores. The
+        // visitors share the global memory usage checks, so they all stop
+        // expelling once usage has dropped sufficiently.
+        const size_t numShards = kvBucket->getVBuckets().getNumShards();
+        for (size_t shard = 0; shard < numShards; ++shard) {
+            auto pv = std::make_unique<CheckpointVisitor>(
+                    kvBucket, stats, shard, completedCount, available);
+            // p99.999 is 10ms
+            auto maxExpectedDuration = std::chrono::milliseconds(10);
+            kvBucket->visit(std::move(pv),
+                            "Checkpoint Remover",
+                            TaskId::ClosedUnrefCheckpointRemoverVisitorTask,
+                            /*sleepTime*/ 0,
+                            maxExpectedDuration);
+        }
     }
     snooze(sleepTime);
     return true;
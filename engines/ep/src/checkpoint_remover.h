@@ -40,6 +40,7 @@ public:
     ClosedUnrefCheckpointRemoverTask(EventuallyPersistentEngine *e,
                                      EPStats &st, size_t interval) :
         GlobalTask(e, TaskId::ClosedUnrefCheckpointRemoverTask, interval, false),
+        completedCount(0),
         engine(e), stats(st), sleepTime(interval), available(true) {}
 
     void cursorDroppingIfNeeded(void);
@@ -56,6 +57,10 @@ public:
         return std::chrono::milliseconds(25);
     }
 
+    /// Number of per-shard visitors which have completed their run; the
+    /// last one to finish makes the task available again.
+    std::atomic<size_t> completedCount;
+
 private:
     EventuallyPersistentEngine *engine;
     EPStats                   &stats;
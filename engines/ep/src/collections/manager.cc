@@ -98,6 +98,17 @@ void Collections::Manager::logAll(KVBucket& bucket) const {
     }
 }
 
+void Collections::Manager::addStats(KVBucket& bucket,
+                                    const void* cookie,
+                                    ADD_STAT add_stat) const {
+    for (int i = 0; i < bucket.getVBuckets().getSize(); i++) {
+        auto vb = bucket.getVBuckets().getBucket(i);
+        if (vb) {
+            vb->lockCollections().addStats(vb->getId(), cookie, add_stat);
+        }
+    }
+}
+
 void Collections::Manager::dump() const {
     std::cerr << *this;
 }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <memcached/engine_common.h>
 #include <memcached/engine_error.h>
 
 #include <memory>
@@ -69,6 +70,18 @@ public:
      */
     void logAll(KVBucket& bucket) const;
 
+    /**
+     * Add the per-collection statistics of every vbucket in the bucket,
+     * e.g. the incrementally maintained on-disk item counts.
+     *
+     * @param bucket The bucket whose vbuckets are visited.
+     * @param cookie The stats connection's cookie.
+     * @param add_stat The callback each stat is written to.
+     */
+    void addStats(KVBucket& bucket,
+                  const void* cookie,
+                  ADD_STAT add_stat) const;
+
     /**
      * Write to std::cerr this
      */
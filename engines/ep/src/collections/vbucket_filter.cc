@@ -25,22 +25,29 @@
 #include <platform/checked_snprintf.h>
 #include <platform/make_unique.h>
 
+#include <cstring>
+
 Collections::VB::Filter::Filter(const Collections::Filter& filter,
                                 const Collections::VB::Manifest& manifest)
     : defaultAllowed(false),
       passthrough(filter.isPassthrough()),
-      systemEventsAllowed(filter.allowSystemEvents()) {
+      systemEventsAllowed(filter.allowSystemEvents()),
+      lastAllowed(false),
+      lastVerdictValid(false) {
     // Don't build a filter if all documents are allowed
     if (passthrough) {
         defaultAllowed = true;
         return;
     }
 
-    // Lock for reading and create a VB filter
-    auto rh = manifest.lock();
-    separator = rh.getSeparator();
+    // Build the VB filter against the manifest's published snapshot; the
+    // snapshot is internally consistent so no lock is required (and a
+    // concurrent update is no different to the update occurring just after
+    // stream creation - the filter learns of it via the system event).
+    auto snapshot = manifest.snapshot();
+    separator = snapshot->getSeparator();
     if (filter.allowDefaultCollection()) {
-        if (rh.doesDefaultCollectionExist()) {
+        if (snapshot->doesDefaultCollectionExist()) {
             defaultAllowed = true;
         } else {
             // The VB::Manifest no longer has $default so don't filter it
@@ -51,7 +58,7 @@ Collections::VB::Filter::Filter(const Collections::Filter& filter,
     }
 
     for (const auto& c : filter.getFilter()) {
-        if (rh.isCollectionOpen({c.data(), c.size()})) {
+        if (snapshot->isCollectionOpen({c.data(), c.size()})) {
             auto m = std::make_unique<std::string>(c);
             cb::const_char_buffer b{m->data(), m->size()};
             this->filter.emplace(b, std::move(m));
@@ -82,10 +89,23 @@ bool Collections::VB::Filter::allow(::DocKey key) const {
         return true;
     } else if (key.getDocNamespace() == DocNamespace::Collections &&
                !filter.empty()) {
-        // Collections require a look up in the filter
+        // Collections require a look up in the filter. Streams commonly send
+        // runs of keys from one collection, so check the memoised verdict of
+        // the last collection before hitting the map.
         const auto cKey = Collections::DocKey::make(key, separator);
-        return filter.count({reinterpret_cast<const char*>(cKey.data()),
-                             cKey.getCollectionLen()}) > 0;
+        cb::const_char_buffer collection{
+                reinterpret_cast<const char*>(cKey.data()),
+                cKey.getCollectionLen()};
+        if (lastVerdictValid && collection.size() == lastCollection.size() &&
+            std::memcmp(collection.data(),
+                        lastCollection.data(),
+                        collection.size()) == 0) {
+            return lastAllowed;
+        }
+        lastCollection.assign(collection.data(), collection.size());
+        lastAllowed = filter.count(collection) > 0;
+        lastVerdictValid = true;
+        return lastAllowed;
     } else if (key.getDocNamespace() == DocNamespace::System) {
         // ::allow should only be called for the Default or Collection namespace
         throw std::invalid_argument(
@@ -105,6 +125,8 @@ bool Collections::VB::Filter::remove(cb::const_char_buffer collection) {
         defaultAllowed = false;
     } else {
         filter.erase(collection);
+        // The removed collection may be the memoised one
+        lastVerdictValid = false;
     }
 
     // If the map is empty and the defaultCollection isn't present, we're empty
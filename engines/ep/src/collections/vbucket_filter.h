@@ -45,8 +45,9 @@ class Manifest;
  * ::VB::Filter becomes the intersection of the producer's filter and the
  * open collections within the manifest.
  *
- * Note: There is no locking on a VB::Filter as at the moment it is constructed
- * and then is not mutable.
+ * Note: There is no locking on a VB::Filter; the stream serialises all calls
+ * (remove already mutates the filter). The memoisation of the last checked
+ * collection in allow relies on this.
  */
 class Filter {
 public:
@@ -73,6 +74,15 @@ public:
      */
     bool allow(::DocKey key) const;
 
+    /**
+     * @returns true if the filter lets every key through. passthrough is
+     * immutable so this is safe to call without serialising against allow
+     * or remove.
+     */
+    bool isPassthrough() const {
+        return passthrough;
+    }
+
     /**
      * Attempt to remove the collection from the filter, no-op if the filter
      * does include the collection.
@@ -113,6 +123,15 @@ private:
     bool systemEventsAllowed;
     std::string separator;
 
+    /**
+     * DCP streams commonly send long runs of keys from the same collection, so
+     * allow memoises the last collection checked and its verdict, saving the
+     * map lookup for each key. Invalidated by remove.
+     */
+    mutable std::string lastCollection;
+    mutable bool lastAllowed;
+    mutable bool lastVerdictValid;
+
     friend std::ostream& operator<<(std::ostream& os, const Filter& filter);
 };
 
@@ -20,11 +20,13 @@
 #include "collections/manifest.h"
 #include "collections/vbucket_serialised_manifest_entry.h"
 #include "item.h"
+#include "statwriter.h"
 #include "vbucket.h"
 
 #include <JSON_checker.h>
 #include <cJSON.h>
 #include <cJSON_utils.h>
+#include <platform/checked_snprintf.h>
 #include <platform/make_unique.h>
 
 namespace Collections {
@@ -41,6 +43,7 @@ Manifest::Manifest(const std::string& manifest)
                               0,
                               StoredValue::state_collection_open);
         defaultCollectionExists = true;
+        publishSnapshot();
         return;
     }
 
@@ -85,6 +88,8 @@ Manifest::Manifest(const std::string& manifest)
             defaultCollectionExists = entry.isOpen();
         }
     }
+
+    publishSnapshot();
 }
 
 void Manifest::update(::VBucket& vb, const Collections::Manifest& manifest) {
@@ -140,6 +145,8 @@ void Manifest::addCollection(::VBucket& vb,
     //    of the manifest taken at step 1 gets the correct seqno when the system
     //    event is flushed.
     entry.setStartSeqno(seqno);
+
+    publishSnapshot();
 }
 
 ManifestEntry& Manifest::addCollectionEntry(Identifier identifier) {
@@ -213,6 +220,8 @@ void Manifest::beginCollectionDelete(::VBucket& vb,
     entry.setEndSeqno(seqno);
 
     trackEndSeqno(seqno);
+
+    publishSnapshot();
 }
 
 ManifestEntry& Manifest::beginDeleteCollectionEntry(Identifier identifier) {
@@ -259,6 +268,8 @@ void Manifest::completeDeletion(::VBucket& vb,
                      {collection, uid},
                      false /*delete*/,
                      OptionalSeqno{/*none*/});
+
+    publishSnapshot();
 }
 
 void Manifest::changeSeparator(::VBucket& vb,
@@ -287,6 +298,8 @@ void Manifest::changeSeparator(::VBucket& vb,
         // Queue an event so that the manifest is flushed and DCP can
         // replicate the change.
         (void)queueSeparatorChanged(vb, optionalSeqno);
+
+        publishSnapshot();
     }
 }
 
@@ -333,6 +346,100 @@ bool Manifest::doesKeyContainValidCollection(const ::DocKey& key) const {
     return false;
 }
 
+Manifest::Snapshot::Snapshot(const Manifest& manifest)
+    : separator(manifest.separator),
+      defaultCollectionExists(manifest.defaultCollectionExists) {
+    for (const auto& entry : manifest.map) {
+        if (entry.second->isOpen()) {
+            auto name = std::make_unique<std::string>(
+                    entry.second->getCollectionName());
+            cb::const_char_buffer key{name->data(), name->size()};
+            openCollections.emplace(key, std::move(name));
+        }
+    }
+}
+
+bool Manifest::Snapshot::doesKeyContainValidCollection(
+        const ::DocKey& key) const {
+    if (defaultCollectionExists &&
+        key.getDocNamespace() == DocNamespace::DefaultCollection) {
+        return true;
+    } else if (key.getDocNamespace() == DocNamespace::Collections) {
+        const auto cKey = Collections::DocKey::make(key, separator);
+        return openCollections.count(
+                       {reinterpret_cast<const char*>(cKey.data()),
+                        cKey.getCollectionLen()}) > 0;
+    }
+    return false;
+}
+
+void Manifest::publishSnapshot() {
+    std::shared_ptr<const Snapshot> newSnapshot =
+            std::make_shared<Snapshot>(*this);
+    std::atomic_store_explicit(
+            &currentSnapshot, newSnapshot, std::memory_order_release);
+}
+
+Manifest::container::const_iterator Manifest::getManifestEntry(
+        const ::DocKey& key) const {
+    switch (key.getDocNamespace()) {
+    case DocNamespace::DefaultCollection:
+        return map.find(DefaultCollectionIdentifier);
+    case DocNamespace::Collections: {
+        const auto cKey = Collections::DocKey::make(key, separator);
+        return map.find(cKey.getCollection());
+    }
+    case DocNamespace::System:
+        break;
+    }
+    return map.end();
+}
+
+void Manifest::incrementDiskCount(const ::DocKey& key) const {
+    auto itr = getManifestEntry(key);
+    if (itr != map.end()) {
+        itr->second->incrementDiskCount();
+    }
+}
+
+void Manifest::decrementDiskCount(const ::DocKey& key) const {
+    auto itr = getManifestEntry(key);
+    if (itr != map.end()) {
+        itr->second->decrementDiskCount();
+    }
+}
+
+uint64_t Manifest::getDiskCount(const ::DocKey& key) const {
+    auto itr = getManifestEntry(key);
+    if (itr != map.end()) {
+        return itr->second->getDiskCount();
+    }
+    return 0;
+}
+
+void Manifest::addStats(uint16_t vb,
+                        const void* cookie,
+                        ADD_STAT add_stat) const {
+    try {
+        const int bsize = 512;
+        char buffer[bsize];
+        for (const auto& entry : map) {
+            checked_snprintf(buffer,
+                             bsize,
+                             "vb_%" PRIu16 ":%s:items",
+                             vb,
+                             entry.second->getCollectionName().c_str());
+            add_casted_stat(buffer, entry.second->getDiskCount(), add_stat,
+                            cookie);
+        }
+    } catch (std::exception& error) {
+        LOG(EXTENSION_LOG_WARNING,
+            "VB::Manifest::addStats: vb:%" PRIu16 " exception.what:%s",
+            vb,
+            error.what());
+    }
+}
+
 bool Manifest::isLogicallyDeleted(const ::DocKey& key, int64_t seqno) const {
     // Only do the searching/scanning work for keys in the deleted range.
     if (seqno <= greatestEndSeqno) {
@@ -23,10 +23,13 @@
 #include "collections/vbucket_manifest_entry.h"
 #include "systemevent.h"
 
+#include <memcached/engine_common.h>
+
 #include <platform/non_negative_counter.h>
 #include <platform/rwlock.h>
 #include <platform/sized_buffer.h>
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
@@ -148,6 +151,42 @@ public:
             return manifest.exists(collection);
         }
 
+        /**
+         * An item of the key's collection has been persisted, increment the
+         * collection's on-disk item count. No-op if the key's collection is
+         * not in the manifest (e.g. the collection was completely deleted
+         * whilst the item was in-flight to disk).
+         */
+        void incrementDiskCount(const ::DocKey& key) const {
+            manifest.incrementDiskCount(key);
+        }
+
+        /**
+         * An item of the key's collection has been deleted from disk,
+         * decrement the collection's on-disk item count. No-op if the key's
+         * collection is not in the manifest.
+         */
+        void decrementDiskCount(const ::DocKey& key) const {
+            manifest.decrementDiskCount(key);
+        }
+
+        /**
+         * @returns the on-disk item count of the key's collection, 0 if the
+         *          collection is not in the manifest.
+         */
+        uint64_t getDiskCount(const ::DocKey& key) const {
+            return manifest.getDiskCount(key);
+        }
+
+        /**
+         * Add per-collection stats for every collection in the manifest.
+         */
+        void addStats(uint16_t vb,
+                      const void* cookie,
+                      ADD_STAT add_stat) const {
+            manifest.addStats(vb, cookie, add_stat);
+        }
+
         /**
          * Dump the manifest to std::cerr
          */
@@ -268,6 +307,68 @@ public:
     friend ReadHandle;
     friend WriteHandle;
 
+    /**
+     * An immutable snapshot of the manifest's collection membership.
+     *
+     * A new snapshot is published RCU-style whenever the manifest changes:
+     * the updater (under the manifest's write lock) builds a fresh copy and
+     * swaps it in with an atomic pointer store, whilst readers obtain the
+     * current snapshot via Manifest::snapshot() and query it with no
+     * locking at all. Readers holding an older snapshot simply keep it
+     * alive until they drop their shared_ptr.
+     *
+     * A snapshot may be marginally stale with respect to a concurrent
+     * manifest update - for the reader this is indistinguishable from
+     * having performed its check just before the update. It is therefore
+     * only suitable for consumers which do not queue items into the
+     * checkpoint (e.g. building a DCP filter). Any path which queues items
+     * must hold a ReadHandle for its full scope, so the queued item cannot
+     * interleave with a collection's create/delete system events (see the
+     * class comment) - note this includes the apparently read-only
+     * front-end paths, which can queue deletions for expired items.
+     */
+    class Snapshot {
+    public:
+        /**
+         * Build a snapshot of the given manifest. Must only be called
+         * whilst the manifest cannot change (under the write lock, or from
+         * the manifest's constructor).
+         */
+        Snapshot(const Manifest& manifest);
+
+        /**
+         * Does the key contain a valid collection? Lock-free equivalent of
+         * ReadHandle::doesKeyContainValidCollection.
+         */
+        bool doesKeyContainValidCollection(const ::DocKey& key) const;
+
+        /// @returns the separator at the time the snapshot was taken
+        const std::string& getSeparator() const {
+            return separator;
+        }
+
+        /// @returns true/false if $default was open in the snapshot
+        bool doesDefaultCollectionExist() const {
+            return defaultCollectionExists;
+        }
+
+        /// @returns true if the collection was open in the snapshot
+        bool isCollectionOpen(cb::const_char_buffer collection) const {
+            return openCollections.count(collection) > 0;
+        }
+
+    private:
+        /**
+         * The open collections' names; as per Manifest::container the keys
+         * point at data stored in the values so look-ups need not allocate.
+         */
+        using NameContainer = ::std::unordered_map<cb::const_char_buffer,
+                                                   std::unique_ptr<std::string>>;
+        NameContainer openCollections;
+        std::string separator;
+        bool defaultCollectionExists;
+    };
+
     /**
      * Map from a 'string_view' to an entry.
      * The key points to data stored in the value (which is actually a pointer
@@ -304,6 +405,16 @@ public:
         return {*this, rwlock};
     }
 
+    /**
+     * @returns the currently published Snapshot of the manifest, without
+     *          taking the manifest's lock. See Snapshot for the staleness
+     *          semantics and permitted uses.
+     */
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load_explicit(&currentSnapshot,
+                                         std::memory_order_acquire);
+    }
+
     /**
      * Return a std::string containing a JSON representation of a
      * VBucket::Manifest. The input is an Item previously created for an event
@@ -490,6 +601,39 @@ private:
         return map.count(collection) > 0;
     }
 
+    /**
+     * Increment the on-disk item count of the key's collection, no-op if
+     * the key's collection is not in the map.
+     */
+    void incrementDiskCount(const ::DocKey& key) const;
+
+    /**
+     * Decrement the on-disk item count of the key's collection, no-op if
+     * the key's collection is not in the map.
+     */
+    void decrementDiskCount(const ::DocKey& key) const;
+
+    /**
+     * @returns the on-disk item count of the key's collection, 0 if the
+     *          collection is not in the map.
+     */
+    uint64_t getDiskCount(const ::DocKey& key) const;
+
+    /**
+     * Add a stat for each collection in the map, e.g.
+     *   vb_0:vegetable:items
+     */
+    void addStats(uint16_t vb, const void* cookie, ADD_STAT add_stat) const;
+
+    /**
+     * Lookup the ManifestEntry of the key's collection.
+     *
+     * @returns iterator to the entry or map.end() if the key's collection is
+     *          not in the map (keys in the System namespace always return
+     *          end, system events are not collection items).
+     */
+    container::const_iterator getManifestEntry(const ::DocKey& key) const;
+
 protected:
     /**
      * Add a collection entry to the manifest specifing the revision that it was
@@ -658,6 +802,14 @@ protected:
      */
     void trackEndSeqno(int64_t seqno);
 
+    /**
+     * Build a new Snapshot reflecting the current state and atomically
+     * publish it, replacing the previous one. Must be called after any
+     * change to the collection membership or the separator, with the write
+     * lock held (or from the constructor).
+     */
+    void publishSnapshot();
+
     /**
      * Return a string for use in throwException, returns:
      *   "VB::Manifest::<thrower>:<error>, this:<ostream *this>"
@@ -718,6 +870,13 @@ protected:
      */
     mutable cb::RWLock rwlock;
 
+    /**
+     * The currently published Snapshot. Swapped by publishSnapshot() and
+     * read by snapshot(); both sides use the std::atomic_... shared_ptr
+     * operations so no lock is required to read it.
+     */
+    std::shared_ptr<const Snapshot> currentSnapshot;
+
     friend std::ostream& operator<<(std::ostream& os, const Manifest& manifest);
 };
 
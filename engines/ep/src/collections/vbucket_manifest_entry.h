@@ -24,6 +24,7 @@
 #include <platform/make_unique.h>
 #include <platform/sized_buffer.h>
 
+#include <atomic>
 #include <memory>
 
 namespace Collections {
@@ -48,7 +49,8 @@ public:
                   identifier.getName().data(), identifier.getName().size())),
           uid(identifier.getUid()),
           startSeqno(-1),
-          endSeqno(-1) {
+          endSeqno(-1),
+          diskCount(0) {
         // Setters validate the start/end range is valid
         setStartSeqno(_startSeqno);
         setEndSeqno(_endSeqno);
@@ -59,14 +61,16 @@ public:
                   std::make_unique<std::string>(rhs.collectionName->c_str())),
           uid(rhs.uid),
           startSeqno(rhs.startSeqno),
-          endSeqno(rhs.endSeqno) {
+          endSeqno(rhs.endSeqno),
+          diskCount(rhs.getDiskCount()) {
     }
 
     ManifestEntry(ManifestEntry&& rhs)
         : collectionName(std::move(rhs.collectionName)),
           uid(rhs.uid),
           startSeqno(rhs.startSeqno),
-          endSeqno(rhs.endSeqno) {
+          endSeqno(rhs.endSeqno),
+          diskCount(rhs.getDiskCount()) {
     }
 
     ManifestEntry& operator=(ManifestEntry&& rhs) {
@@ -74,6 +78,7 @@ public:
         uid = rhs.uid;
         startSeqno = rhs.startSeqno;
         endSeqno = rhs.endSeqno;
+        diskCount.store(rhs.getDiskCount(), std::memory_order_relaxed);
         return *this;
     }
 
@@ -82,6 +87,7 @@ public:
         uid = rhs.uid;
         startSeqno = rhs.startSeqno;
         endSeqno = rhs.endSeqno;
+        diskCount.store(rhs.getDiskCount(), std::memory_order_relaxed);
         return *this;
     }
 
@@ -192,6 +198,23 @@ public:
         return !isOpen() && isDeleting();
     }
 
+    /**
+     * @returns the number of items of the collection stored on disk
+     */
+    uint64_t getDiskCount() const {
+        return diskCount.load(std::memory_order_relaxed);
+    }
+
+    /// Increment the on-disk item count (an item of the collection persisted)
+    void incrementDiskCount() const {
+        diskCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Decrement the on-disk item count (an item of the collection deleted)
+    void decrementDiskCount() const {
+        diskCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+
     /**
      * Inform the collection that all items of the collection up to endSeqno
      * have been deleted.
@@ -247,6 +270,15 @@ private:
      */
     int64_t startSeqno;
     int64_t endSeqno;
+
+    /**
+     * The number of items of this collection stored on disk. Updated from
+     * the flusher's persistence callbacks whilst the manifest is read
+     * locked, hence atomic (and mutable, the updaters only hold read
+     * access). Counts from zero at warmup; persisting the count with the
+     * serialised manifest is a later change.
+     */
+    mutable std::atomic<uint64_t> diskCount;
 };
 
 std::ostream& operator<<(std::ostream& os, const ManifestEntry& manifestEntry);
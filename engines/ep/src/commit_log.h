@@ -0,0 +1,185 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Commit Log
+ *
+ * A write-ahead log which decouples the durability of a flush batch
+ * from the per-vbucket storage commit. Records carry the complete
+ * document (metadata and value, unlike the key-only MutationLog), so a
+ * batch is durable once its records have been appended and the log
+ * fsync'd - one sequential fsync per batch, regardless of how many
+ * vbucket files the batch's storage commits will eventually touch. The
+ * storage layer may then batch its own (random, per-file) fsyncs much
+ * more coarsely, replaying the log tail over the files after a crash.
+ *
+ * The log is a simple stream of CRC-32C protected records following a
+ * fixed header; it has no notion of generations beyond reset(), which
+ * the owner calls once every file holding data newer than the log has
+ * been made durable. A torn record terminates replay: records are
+ * buffered and written front-to-back by sync(), so nothing beyond a
+ * tear was ever acknowledged.
+ */
+
+#include "config.h"
+
+#include "item.h"
+#include "utility.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+typedef HANDLE file_handle_t;
+#ifndef INVALID_FILE_VALUE
+#define INVALID_FILE_VALUE INVALID_HANDLE_VALUE
+#endif
+#else
+typedef int file_handle_t;
+#ifndef INVALID_FILE_VALUE
+#define INVALID_FILE_VALUE -1
+#endif
+#endif
+
+class CommitLog {
+public:
+    CommitLog(const std::string& path);
+
+    ~CommitLog();
+
+    /**
+     * Open (creating and writing the header if new or empty) the log.
+     */
+    void open(bool _readOnly = false);
+
+    void close();
+
+    bool isOpen() const {
+        return file != INVALID_FILE_VALUE;
+    }
+
+    bool exists() const;
+
+    const std::string& getLogFile() const {
+        return logPath;
+    }
+
+    /**
+     * Buffer a record for the given item (mutation or deletion - the
+     * record type is taken from Item::isDeleted()). The record is not
+     * on disk until sync().
+     */
+    void newMutation(const Item& item);
+
+    /**
+     * Drop any records buffered since the last sync() - used when the
+     * storage write they covered failed and the batch will be retried.
+     */
+    void discard();
+
+    /**
+     * Write the buffered records and fsync the log. On return the
+     * records are durable.
+     */
+    void sync();
+
+    /**
+     * Truncate the log back to an empty header. Only valid once all
+     * data covered by the log has been made durable by the storage
+     * layer itself.
+     *
+     * @return true if the log was successfully reset
+     */
+    bool reset();
+
+    /// Bytes of records in the log (excluding the header).
+    size_t getLogSize() const {
+        return logSize;
+    }
+
+    /**
+     * Replay visitor: vbucket id and the reconstructed item. Items are
+     * delivered in log (i.e. append) order, which is seqno order within
+     * each vbucket.
+     */
+    using ReplayVisitor = std::function<void(uint16_t vbid, queued_item itm)>;
+
+    /**
+     * Read the log front-to-back, handing each record to the visitor.
+     * The log must be open.
+     *
+     * @return true if the log terminated cleanly; false if a torn or
+     *         corrupt record ended the replay early (expected after a
+     *         crash - the tail sync never completed, so nothing beyond
+     *         it was acknowledged).
+     */
+    bool replay(ReplayVisitor visitor) const;
+
+    /**
+     * Exception thrown upon failure to write the commit log.
+     */
+    class WriteException : public std::runtime_error {
+    public:
+        WriteException(const std::string& s) : std::runtime_error(s) {
+        }
+    };
+
+    /**
+     * Exception thrown upon failure to read the commit log.
+     */
+    class ReadException : public std::runtime_error {
+    public:
+        ReadException(const std::string& s) : std::runtime_error(s) {
+        }
+    };
+
+private:
+    static const uint32_t HeaderMagic = 0x434c4f47; // 'CLOG'
+    static const uint32_t LogVersion = 1;
+    static const size_t HeaderSize = 16;
+
+    /* Fixed (pre key/value) portion of a record's payload:
+       type, namespace, datatype, vbid, seqno, revSeqno, cas, flags,
+       exptime, keylen, vallen */
+    static const size_t FixedPayloadSize =
+            3 * sizeof(uint8_t) + 2 * sizeof(uint16_t) + 3 * sizeof(uint64_t) +
+            3 * sizeof(uint32_t);
+
+    enum class RecordType : uint8_t { Mutation = 1, Deletion = 2 };
+
+    void needWriteAccess(void) {
+        if (readOnly) {
+            throw WriteException("Invalid access (file opened read only)");
+        }
+    }
+
+    bool writeHeader();
+    void readHeader();
+
+    const std::string logPath;
+    file_handle_t file;
+    bool readOnly;
+    /// Bytes of records on disk (excluding header and unsynced buffer).
+    size_t logSize;
+    /// Records appended since the last sync().
+    std::vector<uint8_t> buffer;
+
+    DISALLOW_COPY_AND_ASSIGN(CommitLog);
+};
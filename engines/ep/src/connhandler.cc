@@ -33,7 +33,8 @@ ConnHandler::ConnHandler(EventuallyPersistentEngine& e, const void* c,
     reserved(false),
     created(ep_current_time()),
     disconnect(false),
-    paused(false) {}
+    paused(false),
+    notificationScheduled(false) {}
 
 ENGINE_ERROR_CODE ConnHandler::addStream(uint32_t opaque, uint16_t,
                                          uint32_t flags) {
@@ -276,6 +276,21 @@ public:
         paused.store(false);
     }
 
+    /**
+     * Flag the connection as having (or no longer having) a pending
+     * notification queued in the ConnMap. The per-mutation path uses
+     * this to avoid re-enqueueing a connection which is already
+     * waiting to be notified.
+     *
+     * @param scheduled the new state of the flag
+     * @return true if the flag was changed by this call
+     */
+    bool setNotificationScheduled(bool scheduled) {
+        bool inverse = !scheduled;
+        return notificationScheduled.compare_exchange_strong(inverse,
+                                                             scheduled);
+    }
+
 protected:
     EventuallyPersistentEngine &engine_;
     EPStats &stats;
@@ -306,6 +321,9 @@ private:
     //! Connection is temporarily paused?
     std::atomic<bool> paused;
 
+    //! Is a notification for this connection queued in the ConnMap?
+    std::atomic<bool> notificationScheduled;
+
     //! Description of why the connection is paused.
     struct pausedReason {
         mutable std::mutex mutex;
@@ -167,6 +167,10 @@ ConnMap::ConnMap(EventuallyPersistentEngine &theEngine)
     for (size_t i = 0; i < max_vbs; ++i) {
         vbConns.push_back(std::list<connection_t>());
     }
+    vbConnCounts = std::vector<std::atomic<size_t>>(max_vbs);
+    for (auto& count : vbConnCounts) {
+        count.store(0);
+    }
 }
 
 void ConnMap::initialize() {
@@ -189,8 +193,13 @@ void ConnMap::notifyPausedConnection(connection_t conn, bool schedule) {
     }
 
     if (schedule) {
-        if (conn.get() && conn->isPaused() && conn->isReserved()) {
-            pendingNotifications.push(conn);
+        if (conn.get() && conn->isPaused() && conn->isReserved() &&
+            conn->setNotificationScheduled(true)) {
+            // The connection wasn't already pending; queue it
+            {
+                std::lock_guard<std::mutex> lh(pendingNotificationsLock);
+                pendingNotifications.push_back(conn);
+            }
             if (connNotifier_) {
                 // Wake up the connection notifier so that
                 // it can notify the event to a given paused connection.
@@ -206,16 +215,23 @@ void ConnMap::notifyPausedConnection(connection_t conn, bool schedule) {
 }
 
 void ConnMap::notifyAllPausedConnections() {
-    std::queue<connection_t> queue;
-    pendingNotifications.getAll(queue);
+    std::vector<connection_t> queue;
+    {
+        std::lock_guard<std::mutex> lh(pendingNotificationsLock);
+        queue.swap(pendingNotifications);
+    }
 
     LockHolder rlh(releaseLock);
-    while (!queue.empty()) {
-        connection_t &conn = queue.front();
-        if (conn.get() && conn->isPaused() && conn->isReserved()) {
-            engine.notifyIOComplete(conn->getCookie(), ENGINE_SUCCESS);
+    for (auto& conn : queue) {
+        if (conn.get()) {
+            // Clear the flag before the notification so that a
+            // mutation arriving while we're notifying re-queues the
+            // connection instead of being missed.
+            conn->setNotificationScheduled(false);
+            if (conn->isPaused() && conn->isReserved()) {
+                engine.notifyIOComplete(conn->getCookie(), ENGINE_SUCCESS);
+            }
         }
-        queue.pop();
     }
 }
 
@@ -228,6 +244,7 @@ void ConnMap::addVBConnByVBId(connection_t &conn, int16_t vbid) {
     std::lock_guard<SpinLock> lh(vbConnLocks[lock_num]);
     std::list<connection_t> &vb_conns = vbConns[vbid];
     vb_conns.push_back(conn);
+    vbConnCounts[vbid]++;
 }
 
 void ConnMap::removeVBConnByVBId_UNLOCKED(connection_t &conn, int16_t vbid) {
@@ -240,6 +257,7 @@ void ConnMap::removeVBConnByVBId_UNLOCKED(connection_t &conn, int16_t vbid) {
     for (; itr != vb_conns.end(); ++itr) {
         if (conn->getCookie() == (*itr)->getCookie()) {
             vb_conns.erase(itr);
+            vbConnCounts[vbid]--;
             break;
         }
     }
@@ -20,13 +20,13 @@
 #include "config.h"
 
 #include "atomic.h"
-#include "atomicqueue.h"
 #include "dcp/dcp-types.h"
 
 #include <climits>
 #include <iterator>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -104,10 +104,24 @@ protected:
     std::vector<SpinLock> vbConnLocks;
     std::vector<std::list<connection_t> > vbConns;
 
+    /* Mirror of vbConns[vbid].size(), maintained under the matching
+       vbConnLock. Allows the per-mutation notification path to skip the
+       lock (and the list walk) entirely with a single relaxed load when
+       no connection is streaming the vbucket. */
+    std::vector<std::atomic<size_t> > vbConnCounts;
+
     /* Handle to the engine who owns us */
     EventuallyPersistentEngine &engine;
 
-    AtomicQueue<connection_t> pendingNotifications;
+    /* Connections with a pending notification. Deduplicated by the
+       notificationScheduled flag on the connection (a connection is in
+       here at most once), so the queue is bounded by the number of
+       connections and a mutation for an already-pending connection is
+       a single CAS. Drained in one batch (vector swap) by the notifier
+       task. */
+    std::mutex pendingNotificationsLock;
+    std::vector<connection_t> pendingNotifications;
+
     ConnNotifier *connNotifier_;
 
     static size_t vbConnLockNum;
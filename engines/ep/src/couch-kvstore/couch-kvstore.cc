@@ -38,6 +38,8 @@
 #include <platform/cb_malloc.h>
 #include <platform/checked_snprintf.h>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <cJSON.h>
@@ -181,14 +183,21 @@ public:
 };
 
 struct AllKeysCtx {
-    AllKeysCtx(std::shared_ptr<Callback<const DocKey&>> callback, uint32_t cnt)
-        : cb(callback), count(cnt) { }
+    AllKeysCtx(std::shared_ptr<Callback<const DocKey&>> callback,
+               uint32_t cnt,
+               sized_buf endKey)
+        : cb(callback), count(cnt), endKey(endKey) {
+    }
 
     std::shared_ptr<Callback<const DocKey&>> cb;
     uint32_t count;
+    // If non-empty, the (inclusive) key at which the by-ID walk stops;
+    // see KVStore::getAllKeys.
+    sized_buf endKey;
 };
 
-couchstore_content_meta_flags CouchRequest::getContentMeta(const Item& it) {
+couchstore_content_meta_flags CouchRequest::getContentMeta(
+        const Item& it, bool compressAtRest) {
     couchstore_content_meta_flags rval;
 
     if (mcbp::datatype::is_json(it.getDataType())) {
@@ -197,7 +206,8 @@ couchstore_content_meta_flags CouchRequest::getContentMeta(const Item& it) {
         rval = COUCH_DOC_NON_JSON_MODE;
     }
 
-    if (it.getNBytes() > 0 && !mcbp::datatype::is_snappy(it.getDataType())) {
+    if (compressAtRest && it.getNBytes() > 0 &&
+        !mcbp::datatype::is_snappy(it.getDataType())) {
         //Compress only if a value exists and is not already compressed
         rval |= COUCH_DOC_IS_COMPRESSED;
     }
@@ -209,7 +219,8 @@ CouchRequest::CouchRequest(const Item& it,
                            uint64_t rev,
                            MutationRequestCallback& cb,
                            bool del,
-                           bool persistDocNamespace)
+                           bool persistDocNamespace,
+                           bool compressAtRest)
     : IORequest(it.getVBucketId(), cb, del, it.getKey()),
       value(it.getValue()),
       fileRevNum(rev) {
@@ -254,7 +265,7 @@ CouchRequest::CouchRequest(const Item& it,
         dbDocInfo.deleted = 0;
     }
     dbDocInfo.id = dbDoc.id;
-    dbDocInfo.content_meta = getContentMeta(it);
+    dbDocInfo.content_meta = getContentMeta(it, compressAtRest);
 }
 
 CouchKVStore::CouchKVStore(KVStoreConfig& config)
@@ -275,7 +286,29 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
       logger(config.getLogger()),
       base_ops(ops) {
     createDataDir(dbname);
-    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
+
+    // Optionally serve reads through a memory mapping of the couch file,
+    // layered under the stats ops so accounting is unchanged. Compaction
+    // keeps plain file ops: it reads the source sequentially exactly
+    // once, which a long-lived mapping cannot improve on.
+    if (configuration.shouldUseMmapReads()) {
+        mmapFileOps = getCouchstoreMmapOps(base_ops);
+    }
+
+    // Optionally absorb couchstore's per-commit fsyncs: flush batches
+    // then get their durability from the commit log (created below,
+    // after initialize()) and LazySyncOps defers the per-file fsyncs
+    // until the log is checkpointed. Only the writing store needs this;
+    // the read-only sibling never syncs and compaction keeps real
+    // syncs.
+    if (!readOnly && configuration.isCommitLogEnabled()) {
+        lazySyncFileOps = std::make_unique<LazySyncOps>(
+                mmapFileOps ? *mmapFileOps : base_ops);
+    }
+    statCollectingFileOps = getCouchstoreStatsOps(
+            st.fsStats,
+            lazySyncFileOps ? *lazySyncFileOps
+                            : (mmapFileOps ? *mmapFileOps : base_ops));
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
         st.fsStatsCompaction, base_ops);
 
@@ -291,6 +324,15 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
     cachedVBStates.resize(numDbFiles);
 
     initialize();
+
+    // The commit log comes after initialize(): its replay needs the
+    // file revision map and cached vbucket states populated.
+    if (lazySyncFileOps) {
+        commitLog = std::make_unique<CommitLog>(
+                dbname + "/commitlog." +
+                std::to_string(configuration.getShardId()));
+        replayCommitLog();
+    }
 }
 
 CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
@@ -373,6 +415,10 @@ void CouchKVStore::reset(uint16_t vbucketId) {
         cachedFileSize[vbucketId] = 0;
         cachedSpaceUsed[vbucketId] = 0;
 
+        // The commit log may hold records for this vbucket; checkpoint
+        // so recovery cannot replay them over the file's successor.
+        checkpointCommitLog();
+
         // Unlink the current revision and then increment it to ensure any
         // pending delete doesn't delete us. Note that the expectation is that
         // some higher level per VB lock is required to prevent data-races here.
@@ -409,15 +455,19 @@ void CouchKVStore::set(const Item &itm, Callback<mutation_result> &cb) {
                              fileRev,
                              requestcb,
                              deleteItem,
-                             configuration.shouldPersistDocNamespace());
+                             configuration.shouldPersistDocNamespace(),
+                             configuration.shouldCompressAtRest());
     pendingReqsQ.push_back(req);
+
+    if (commitLog) {
+        std::lock_guard<std::mutex> lh(commitLogLock);
+        commitLog->newMutation(itm);
+    }
 }
 
 GetValue CouchKVStore::get(const DocKey& key, uint16_t vb, bool fetchDelete) {
-    Db *db = NULL;
-    uint64_t fileRev = dbFileRevMap[vb];
-    couchstore_error_t errCode = openDB(vb, fileRev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    CachedDbHandle db;
+    couchstore_error_t errCode = openDBCached(vb, db);
     if (errCode != COUCHSTORE_SUCCESS) {
         ++st.numGetFailure;
         logger.log(EXTENSION_LOG_WARNING,
@@ -426,8 +476,8 @@ GetValue CouchKVStore::get(const DocKey& key, uint16_t vb, bool fetchDelete) {
         return GetValue(nullptr, couchErr2EngineErr(errCode));
     }
 
-    GetValue gv = getWithHeader(db, key, vb, GetMetaOnly::No, fetchDelete);
-    closeDatabaseHandle(db);
+    GetValue gv = getWithHeader(db.db, key, vb, GetMetaOnly::No, fetchDelete);
+    returnDbHandle(vb, db);
     return gv;
 }
 
@@ -495,11 +545,9 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         return;
     }
     int numItems = itms.size();
-    uint64_t fileRev = dbFileRevMap[vb];
 
-    Db *db = NULL;
-    couchstore_error_t errCode = openDB(vb, fileRev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    CachedDbHandle cdb;
+    couchstore_error_t errCode = openDBCached(vb, cdb);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.log(EXTENSION_LOG_WARNING,
                    "CouchKVStore::getMulti: openDB error:%s, "
@@ -511,6 +559,7 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         }
         return;
     }
+    Db* db = cdb.db;
 
     size_t idx = 0;
     std::vector<sized_buf> ids(itms.size());
@@ -528,8 +577,35 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         ++idx;
     }
 
+    // The ids are in hash-table order; sort them so that adjacent keys
+    // land in the same (or neighbouring) by-ID B-tree nodes and the bulk
+    // lookup below can share node reads between them, instead of paying
+    // an independent root-to-leaf descent per document. This matters most
+    // during cache-cold miss storms where the batch spans much of the
+    // keyspace.
+    std::sort(ids.begin(), ids.end(),
+              [](const sized_buf& a, const sized_buf& b) {
+                  const int cmp = memcmp(a.buf, b.buf,
+                                         std::min(a.size, b.size));
+                  if (cmp != 0) {
+                      return cmp < 0;
+                  }
+                  return a.size < b.size;
+              });
+
     GetMultiCbCtx ctx(*this, vb, itms);
 
+    // With a cached (re-used) handle the per-file read counter
+    // accumulates across operations; sample it around the lookup so the
+    // per-getMulti histograms below stay meaningful.
+    size_t readCountStart = 0;
+    {
+        auto* stats = couchstore_get_db_filestats(db);
+        if (stats != nullptr) {
+            readCountStart = stats->getReadCount();
+        }
+    }
+
     errCode = couchstore_docinfos_by_id(db, ids.data(), itms.size(),
                                         0, getMultiCbC, &ctx);
     if (errCode != COUCHSTORE_SUCCESS) {
@@ -547,13 +623,13 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
     // and the average reads per document.
     auto* stats = couchstore_get_db_filestats(db);
     if (stats != nullptr) {
-        const auto readCount = stats->getReadCount();
+        const auto readCount = stats->getReadCount() - readCountStart;
         st.getMultiFsReadCount += readCount;
         st.getMultiFsReadHisto.add(readCount);
         st.getMultiFsReadPerDocHisto.add(readCount / itms.size());
     }
 
-    closeDatabaseHandle(db);
+    returnDbHandle(vb, cdb);
 }
 
 void CouchKVStore::del(const Item &itm,
@@ -575,8 +651,14 @@ void CouchKVStore::del(const Item &itm,
                              fileRev,
                              requestcb,
                              true,
-                             configuration.shouldPersistDocNamespace());
+                             configuration.shouldPersistDocNamespace(),
+                             configuration.shouldCompressAtRest());
     pendingReqsQ.push_back(req);
+
+    if (commitLog) {
+        std::lock_guard<std::mutex> lh(commitLogLock);
+        commitLog->newMutation(itm);
+    }
 }
 
 void CouchKVStore::delVBucket(uint16_t vbucket, uint64_t fileRev) {
@@ -585,6 +667,10 @@ void CouchKVStore::delVBucket(uint16_t vbucket, uint64_t fileRev) {
                         "read-only object.");
     }
 
+    // The commit log may hold records for this vbucket; checkpoint so
+    // recovery cannot resurrect them into a recreated file.
+    checkpointCommitLog();
+
     unlinkCouchFile(vbucket, fileRev);
 }
 
@@ -656,6 +742,31 @@ static std::string getDBFileName(const std::string &dbname,
            std::to_string(rev);
 }
 
+/* Size and inode of the given file; size is -1 if it cannot be stat'ed.
+   The inode is 0 where the filesystem doesn't provide one. */
+struct FileIdentity {
+    int64_t size = -1;
+    uint64_t inode = 0;
+};
+
+static FileIdentity getFileIdentity(const std::string& fname) {
+    FileIdentity id;
+#ifdef WIN32
+    struct _stati64 sb;
+    if (_stati64(fname.c_str(), &sb) != 0) {
+        return id;
+    }
+#else
+    struct stat sb;
+    if (stat(fname.c_str(), &sb) != 0) {
+        return id;
+    }
+    id.inode = uint64_t(sb.st_ino);
+#endif
+    id.size = int64_t(sb.st_size);
+    return id;
+}
+
 static int edit_docinfo_hook(DocInfo **info, const sized_buf *item) {
     // Examine the metadata of the doc
     auto documentMetaData = MetaDataFactory::createMetaData((*info)->rev_meta);
@@ -786,6 +897,43 @@ static int notify_expired_item(DocInfo& info,
     return COUCHSTORE_SUCCESS;
 }
 
+/**
+ * Bytes of document data copied between throttle evaluations. Small enough
+ * that a throttled compaction yields the disk every few tens of
+ * milliseconds, large enough that an unthrottled one is not slowed by the
+ * clock reads.
+ */
+static const uint64_t compactionThrottleChunkBytes = 4 * 1024 * 1024;
+
+/**
+ * Pace the compaction's copy phase to the configured disk-bandwidth
+ * budget. Couchstore's compact API is a single blocking call, so this
+ * hook-level pause is the only interruption point available: after each
+ * chunk of document data, if the chunk completed faster than the budget
+ * allows, sleep off the difference before copying the next one. The gaps
+ * let concurrent reads and backfill scans get at the disk.
+ */
+static void throttle_compaction(compaction_ctx* ctx, uint64_t bytes) {
+    const uint64_t rate = ctx->config->getCompactionThrottleBytesPerSec();
+    if (rate == 0) {
+        ctx->throttle_bytes = 0;
+        return;
+    }
+    ctx->throttle_bytes += bytes;
+    if (ctx->throttle_bytes < compactionThrottleChunkBytes) {
+        return;
+    }
+    const auto budget =
+            std::chrono::microseconds((ctx->throttle_bytes * 1000000) / rate);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            ProcessClock::now() - ctx->throttle_chunk_start);
+    if (elapsed < budget) {
+        std::this_thread::sleep_for(budget - elapsed);
+    }
+    ctx->throttle_bytes = 0;
+    ctx->throttle_chunk_start = ProcessClock::now();
+}
+
 static int time_purge_hook(Db* d, DocInfo* info, sized_buf item, void* ctx_p) {
     compaction_ctx* ctx = static_cast<compaction_ctx*>(ctx_p);
     const uint16_t vbid = ctx->db_file_id;
@@ -795,6 +943,8 @@ static int time_purge_hook(Db* d, DocInfo* info, sized_buf item, void* ctx_p) {
         return couchstore_set_purge_seq(d, ctx->max_purged_seq[vbid]);
     }
 
+    throttle_compaction(ctx, info->size + item.size);
+
     DbInfo infoDb;
     auto err = couchstore_db_info(d, &infoDb);
     if (err != COUCHSTORE_SUCCESS) {
@@ -900,9 +1050,16 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     uint64_t                   fileRev = dbFileRevMap[vbid];
     uint64_t                   new_rev = fileRev + 1;
     hook_ctx->config = &configuration;
+    hook_ctx->throttle_chunk_start = ProcessClock::now();
 
     TRACE_EVENT1("CouchKVStore", "compactDB", "vbid", vbid);
 
+    // Compaction rewrites the file (with real syncs) and unlinks the
+    // old revision; checkpoint so the commit log holds nothing for this
+    // vbucket. The vbucket lock our caller holds keeps the flusher away
+    // from it until we are done.
+    checkpointCommitLog();
+
     // Open the source VBucket database file ...
     errCode = openDB(vbid,
                      fileRev,
@@ -992,6 +1149,13 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
 
     couchstore_db_info(targetDb, &info);
 
+    if (configuration.shouldDropWriteCache()) {
+        // The compacted file was written (and fsync'd) wholesale just now;
+        // drop it from the page cache so the compaction burst does not
+        // evict hot read data. Subsequent reads re-fault pages on demand.
+        dropWrittenPageCache(new_file, 0, info.file_size);
+    }
+
     cachedFileSize[vbid] = info.file_size;
     cachedSpaceUsed[vbid] = info.space_used;
 
@@ -1071,6 +1235,11 @@ bool CouchKVStore::setVBucketState(uint16_t vbucketId,
                 closeDatabaseHandle(db);
                 return false;
             }
+
+            // A state-only commit isn't covered by the commit log and
+            // doesn't advance the header's seqno, so recovery couldn't
+            // tell its header from a durable one; sync it for real now.
+            checkpointCommitLog();
         }
 
         DbInfo info;
@@ -1207,7 +1376,8 @@ ScanContext* CouchKVStore::initScanContext(std::shared_ptr<Callback<GetValue> >
                                            std::shared_ptr<Callback<CacheLookup> > cl,
                                            uint16_t vbid, uint64_t startSeqno,
                                            DocumentFilter options,
-                                           ValueFilter valOptions) {
+                                           ValueFilter valOptions,
+                                           ScanOrder scanOrder) {
     Db *db = NULL;
     uint64_t rev = dbFileRevMap[vbid];
     couchstore_error_t errorCode = openDB(vbid, rev, &db,
@@ -1257,9 +1427,22 @@ ScanContext* CouchKVStore::initScanContext(std::shared_ptr<Callback<GetValue> >
 
     size_t scanId = scanCounter++;
 
+    ScanHandle handle;
+    handle.db = db;
+#if defined(POSIX_FADV_WILLNEED)
+    // A backfill reads the file in (roughly) append order; open a raw
+    // descriptor on it so scan() can ask the kernel to prefetch blocks ahead
+    // of the scan position, overlapping the disk reads with the delivery of
+    // already-read documents. Purely advisory - failure leaves rawFd at -1
+    // and the scan simply runs without readahead.
+    handle.rawFd = ::open(getDBFileName(dbname, vbid, rev).c_str(), O_RDONLY);
+    handle.fileSize = info.file_size;
+    adviseScanReadahead(handle, 0);
+#endif
+
     {
         LockHolder lh(scanLock);
-        scans[scanId] = db;
+        scans[scanId] = handle;
     }
 
     ScanContext* sctx = new ScanContext(cb,
@@ -1271,7 +1454,8 @@ ScanContext* CouchKVStore::initScanContext(std::shared_ptr<Callback<GetValue> >
                                         options,
                                         valOptions,
                                         count,
-                                        configuration);
+                                        configuration,
+                                        scanOrder);
     sctx->logger = &logger;
     return sctx;
 }
@@ -1289,12 +1473,66 @@ static couchstore_docinfos_options getDocFilter(const DocumentFilter& filter) {
     throw std::runtime_error(err);
 }
 
+/**
+ * Bytes of file data requested ahead of the scan position. Large enough to
+ * keep the device busy while a batch of documents is delivered to the
+ * stream, small enough not to churn the page cache.
+ */
+static const uint64_t scanReadaheadWindowBytes = 16 * 1024 * 1024;
+
+void CouchKVStore::adviseScanReadahead(ScanHandle& handle,
+                                       uint64_t estimatedOffset) {
+#if defined(POSIX_FADV_WILLNEED)
+    if (handle.rawFd < 0 || handle.advisedOffset >= handle.fileSize) {
+        return;
+    }
+    uint64_t target = std::min(estimatedOffset + scanReadaheadWindowBytes,
+                               handle.fileSize);
+    if (target <= handle.advisedOffset) {
+        return;
+    }
+    // Advisory only; a failure just means no readahead.
+    posix_fadvise(handle.rawFd,
+                  handle.advisedOffset,
+                  target - handle.advisedOffset,
+                  POSIX_FADV_WILLNEED);
+    handle.advisedOffset = target;
+#else
+    (void)handle;
+    (void)estimatedOffset;
+#endif
+}
+
+void CouchKVStore::dropWrittenPageCache(const std::string& filename,
+                                        uint64_t offset,
+                                        uint64_t length) {
+#if defined(POSIX_FADV_DONTNEED)
+    if (length == 0) {
+        return;
+    }
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    // Advisory only; a failure just means the pages stay cached.
+    posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+    ::close(fd);
+#else
+    (void)filename;
+    (void)offset;
+    (void)length;
+#endif
+}
+
 scan_error_t CouchKVStore::scan(ScanContext* ctx) {
     if (!ctx) {
         return scan_failed;
     }
 
-    if (ctx->lastReadSeqno == ctx->maxSeqno) {
+    // A by-ID scan tracks its position by key, not seqno; its completion is
+    // signalled by couchstore_all_docs returning without a cancel.
+    if (ctx->scanOrder == ScanOrder::BY_SEQNO &&
+        ctx->lastReadSeqno == ctx->maxSeqno) {
         return scan_success;
     }
 
@@ -1306,6 +1544,7 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
                        ctx->startSeqno);
 
     Db* db;
+    ScanHandle* handle;
     {
         LockHolder lh(scanLock);
         auto itr = scans.find(ctx->scanId);
@@ -1313,7 +1552,10 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
             return scan_failed;
         }
 
-        db = itr->second;
+        // Safe to use outside the lock; only the owning backfill mutates or
+        // erases its scan entry, and std::map nodes are otherwise stable.
+        handle = &itr->second;
+        db = handle->db;
     }
 
     uint64_t start = ctx->startSeqno;
@@ -1321,12 +1563,44 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
         start = ctx->lastReadSeqno + 1;
     }
 
+    // Estimate how far through the file the scan has progressed from its
+    // seqno position and ask the kernel to prefetch the window beyond it,
+    // so the next batch's disk reads overlap with delivering this one.
+    // (For a by-ID scan the seqno position says nothing about the file
+    // offset, so only the initial window requested at init applies.)
+    if (ctx->scanOrder == ScanOrder::BY_SEQNO &&
+        ctx->maxSeqno > ctx->startSeqno) {
+        uint64_t done = start - ctx->startSeqno;
+        uint64_t total = ctx->maxSeqno - ctx->startSeqno + 1;
+        adviseScanReadahead(*handle, (handle->fileSize / total) * done);
+    }
+
     couchstore_error_t errorCode;
-    errorCode = couchstore_changes_since(db,
-                                         start,
-                                         getDocFilter(ctx->docFilter),
-                                         recordDbDumpC,
-                                         static_cast<void*>(ctx));
+    if (ctx->scanOrder == ScanOrder::BY_ID) {
+        // Walk the by-ID index in key order. The scan resumes from the last
+        // delivered key (couchstore_all_docs' start key is inclusive, so
+        // recordDbDump skips it). Copy the key first: recordDbDump updates
+        // lastReadKey whilst couchstore may still reference the start key.
+        const std::string startKey = ctx->lastReadKey;
+        sized_buf ref{nullptr, 0};
+        sized_buf* refPtr = nullptr;
+        if (!startKey.empty()) {
+            ref.buf = const_cast<char*>(startKey.data());
+            ref.size = startKey.size();
+            refPtr = &ref;
+        }
+        errorCode = couchstore_all_docs(db,
+                                        refPtr,
+                                        getDocFilter(ctx->docFilter),
+                                        recordDbDumpC,
+                                        static_cast<void*>(ctx));
+    } else {
+        errorCode = couchstore_changes_since(db,
+                                             start,
+                                             getDocFilter(ctx->docFilter),
+                                             recordDbDumpC,
+                                             static_cast<void*>(ctx));
+    }
 
     TRACE_EVENT_END1(
             "CouchKVStore", "scan", "lastReadSeqno", ctx->lastReadSeqno);
@@ -1336,8 +1610,11 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
             return scan_again;
         } else {
             logger.log(EXTENSION_LOG_WARNING,
-                       "CouchKVStore::scan couchstore_changes_since "
-                       "error:%s [%s]", couchstore_strerror(errorCode),
+                       "CouchKVStore::scan couchstore_%s "
+                       "error:%s [%s]",
+                       ctx->scanOrder == ScanOrder::BY_ID ? "all_docs"
+                                                          : "changes_since",
+                       couchstore_strerror(errorCode),
                        couchkvstore_strerrno(db, errorCode).c_str());
             remVBucketFromDbFileMap(ctx->vbid);
             return scan_failed;
@@ -1354,7 +1631,12 @@ void CouchKVStore::destroyScanContext(ScanContext* ctx) {
     LockHolder lh(scanLock);
     auto itr = scans.find(ctx->scanId);
     if (itr != scans.end()) {
-        closeDatabaseHandle(itr->second);
+        closeDatabaseHandle(itr->second.db);
+#if defined(POSIX_FADV_WILLNEED)
+        if (itr->second.rawFd >= 0) {
+            ::close(itr->second.rawFd);
+        }
+#endif
         scans.erase(itr);
     }
     delete ctx;
@@ -1397,6 +1679,10 @@ DbInfo CouchKVStore::getDbInfo(uint16_t vbid) {
 
 void CouchKVStore::close() {
     intransaction = false;
+    // Clean shutdown: make everything the commit log covers durable so
+    // the next startup has nothing to replay.
+    checkpointCommitLog();
+    closeHandleCache();
 }
 
 uint64_t CouchKVStore::checkNewRevNum(std::string &dbFileName, bool newFile) {
@@ -1674,13 +1960,26 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
                         ") is greater than " + std::to_string(UINT16_MAX));
     }
 
+    if (sctx->scanOrder == ScanOrder::BY_ID &&
+        sctx->lastReadKey.size() == key.size &&
+        memcmp(sctx->lastReadKey.data(), key.buf, key.size) == 0) {
+        // A by-ID scan resumes from the last delivered key inclusive;
+        // this document was already delivered before the scan paused.
+        return COUCHSTORE_SUCCESS;
+    }
+
     // Collections: TODO: Permanently restore to stored namespace
     DocKey docKey = makeDocKey(
             docinfo->id, sctx->config.shouldPersistDocNamespace());
     CacheLookup lookup(docKey, byseqno, vbucketId);
     cl->callback(lookup);
     if (cl->getStatus() == ENGINE_KEY_EEXISTS) {
-        sctx->lastReadSeqno = byseqno;
+        if (sctx->scanOrder == ScanOrder::BY_ID) {
+            sctx->lastReadKey.assign(key.buf, key.size);
+            sctx->lastReadSeqno = std::max(sctx->lastReadSeqno, byseqno);
+        } else {
+            sctx->lastReadSeqno = byseqno;
+        }
         return COUCHSTORE_SUCCESS;
     } else if (cl->getStatus() == ENGINE_ENOMEM) {
         return COUCHSTORE_ERROR_CANCEL;
@@ -1767,7 +2066,14 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
         return COUCHSTORE_ERROR_CANCEL;
     }
 
-    sctx->lastReadSeqno = byseqno;
+    if (sctx->scanOrder == ScanOrder::BY_ID) {
+        // Seqnos arrive in key order; remember the highest seen (for
+        // logging) and the key itself (for resuming the scan).
+        sctx->lastReadKey.assign(key.buf, key.size);
+        sctx->lastReadSeqno = std::max(sctx->lastReadSeqno, byseqno);
+    } else {
+        sctx->lastReadSeqno = byseqno;
+    }
     return COUCHSTORE_SUCCESS;
 }
 
@@ -1837,6 +2143,42 @@ bool CouchKVStore::commit2couchstore(const Item* collectionsManifest) {
                    vbucket2flush, fileRev);
     }
 
+    if (commitLog) {
+        std::lock_guard<std::mutex> lh(commitLogLock);
+        if (errCode) {
+            // The batch failed and will be retried (and re-queued via
+            // set/del); its records must not land in the log.
+            commitLog->discard();
+        } else {
+            try {
+                // This is the batch's durability point: couchstore's own
+                // fsyncs were absorbed by LazySyncOps, so the documents
+                // are only in the page cache until the log is sync'd.
+                const size_t sizeBefore = commitLog->getLogSize();
+                commitLog->sync();
+                ++st.commitLogSyncs;
+                st.commitLogBytes += commitLog->getLogSize() - sizeBefore;
+            } catch (const std::exception& e) {
+                logger.log(EXTENSION_LOG_WARNING,
+                           "CouchKVStore::commit2couchstore: commit log sync "
+                           "failed (%s); falling back to syncing the couch "
+                           "files",
+                           e.what());
+                commitLog->discard();
+                checkpointCommitLog_UNLOCKED();
+            }
+
+            // The collections manifest isn't logged, so a commit carrying
+            // one must not be left rewindable; otherwise checkpoint only
+            // once the log has outgrown its budget.
+            if (collectionsManifest ||
+                commitLog->getLogSize() >=
+                        configuration.getCommitLogSyncBytes()) {
+                checkpointCommitLog_UNLOCKED();
+            }
+        }
+    }
+
     commitCallback(pendingReqsQ, kvctx, errCode);
 
     // clean up
@@ -1903,11 +2245,20 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
 
         uint64_t maxDBSeqno = 0;
 
+        // Snapshot the filesystem write counter so the flush's physical
+        // write volume (documents, index nodes, headers) can be compared
+        // against its logical document bytes below.
+        const size_t physWriteStart = st.fsStats.totalBytesWritten;
+        size_t logicalBytes = 0;
+
         // Only do a couchstore_save_documents if there are docs
         if (docs.size() > 0) {
             std::vector<sized_buf> ids(docs.size());
             for (size_t idx = 0; idx < docs.size(); idx++) {
                 ids[idx] = docinfos[idx]->id;
+                logicalBytes += docinfos[idx]->id.size +
+                                docinfos[idx]->rev_meta.size +
+                                docs[idx]->data.size;
                 maxDBSeqno = std::max(maxDBSeqno, docinfos[idx]->db_seq);
                 DocKey key = makeDocKey(
                         ids[idx], configuration.shouldPersistDocNamespace());
@@ -1974,11 +2325,47 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
 
         // retrieve storage system stats for file fragmentation computation
         couchstore_db_info(db.getDb(), &info);
+
+        const uint64_t priorFileSize = cachedFileSize[vbid];
+        const uint64_t priorSpaceUsed = cachedSpaceUsed[vbid];
+
+        if (configuration.shouldDropWriteCache() &&
+            info.file_size > priorFileSize) {
+            // Couch files are append-only, so everything this flush wrote
+            // (and the commit above fsync'd) lives between the old and new
+            // file size; drop it from the page cache so flusher traffic
+            // does not evict hot read data.
+            dropWrittenPageCache(getDBFileName(dbname, vbid, fileRev),
+                                 priorFileSize,
+                                 info.file_size - priorFileSize);
+        }
+
         cachedSpaceUsed[vbid] = info.space_used;
         cachedFileSize[vbid] = info.file_size;
         cachedDeleteCount[vbid] = info.deleted_count;
         cachedDocCount[vbid] = info.doc_count;
 
+        // Whatever this flush appended beyond the growth in live data is
+        // freshly created stale bytes - the rate at which we generate
+        // work for compaction. Skip the sample if the file shrank under
+        // us (compaction swapped the file in mid-flight).
+        if (info.file_size >= priorFileSize) {
+            const int64_t stale =
+                    int64_t(info.file_size - priorFileSize) -
+                    std::max(int64_t(0),
+                             int64_t(info.space_used) - int64_t(priorSpaceUsed));
+            if (stale > 0) {
+                st.staleWriteBytes += stale;
+            }
+        }
+
+        const size_t physWritten =
+                st.fsStats.totalBytesWritten - physWriteStart;
+        if (logicalBytes > 0 && physWritten > 0) {
+            // Percentage; 100 = no amplification.
+            st.flusherWriteAmpHisto.add((physWritten * 100) / logicalBytes);
+        }
+
         // Check seqno if we wrote documents
         if (docs.size() > 0 && maxDBSeqno != info.last_sequence) {
             logger.log(EXTENSION_LOG_WARNING,
@@ -2074,6 +2461,7 @@ ENGINE_ERROR_CODE CouchKVStore::readVBState(Db *db, uint16_t vbId) {
     uint64_t maxCas = 0;
     int64_t hlcCasEpochSeqno = HlcCasSeqnoUninitialised;
     bool mightContainXattrs = false;
+    std::string streamCursors;
 
     DbInfo info;
     errCode = couchstore_db_info(db, &info);
@@ -2180,6 +2568,14 @@ ENGINE_ERROR_CODE CouchKVStore::readVBState(Db *db, uint16_t vbId) {
                 failovers.assign(json);
                 cJSON_Free(json);
             }
+
+            cJSON* stream_cursors_json =
+                    cJSON_GetObjectItem(jsonObj, "stream_cursors");
+            if (stream_cursors_json) {
+                char* json = cJSON_PrintUnformatted(stream_cursors_json);
+                streamCursors.assign(json);
+                cJSON_Free(json);
+            }
         }
         cJSON_Delete(jsonObj);
         couchstore_free_local_document(ldoc);
@@ -2196,6 +2592,7 @@ ENGINE_ERROR_CODE CouchKVStore::readVBState(Db *db, uint16_t vbId) {
                                                            hlcCasEpochSeqno,
                                                            mightContainXattrs,
                                                            failovers);
+    cachedVBStates[vbId]->streamCursors = streamCursors;
 
     return couchErr2EngineErr(errCode);
 }
@@ -2221,6 +2618,10 @@ couchstore_error_t CouchKVStore::saveVBState(Db *db,
         jsonState << ",\"might_contain_xattrs\": false";
     }
 
+    if (!vbState.streamCursors.empty()) {
+        jsonState << ",\"stream_cursors\": " << vbState.streamCursors;
+    }
+
     jsonState << "}";
 
     LocalDoc lDoc;
@@ -2378,6 +2779,89 @@ void CouchKVStore::closeDatabaseHandle(Db *db) {
     st.numClose++;
 }
 
+couchstore_error_t CouchKVStore::openDBCached(uint16_t vbucketId,
+                                              CachedDbHandle& handle) {
+    const uint64_t fileRev = dbFileRevMap[vbucketId];
+    // Stat *before* opening/validating: if a commit lands in between,
+    // the recorded size is merely smaller than the file and the next
+    // acquisition re-opens unnecessarily - never the unsafe way around
+    // (a size which already includes data the handle's header predates).
+    const auto current =
+            getFileIdentity(getDBFileName(dbname, vbucketId, fileRev));
+
+    Db* stale = nullptr;
+    {
+        std::lock_guard<std::mutex> lh(handleCacheLock);
+        auto itr = handleCache.find(vbucketId);
+        if (itr != handleCache.end() && itr->second.db != nullptr) {
+            if (itr->second.fileRev == fileRev && current.size >= 0 &&
+                itr->second.fileSize == uint64_t(current.size) &&
+                itr->second.inode == current.inode) {
+                // Loan the cached handle out; the slot stays empty (and
+                // further readers open afresh) until it is returned.
+                handle = itr->second;
+                itr->second.db = nullptr;
+                ++st.numHandleCacheHits;
+                return COUCHSTORE_SUCCESS;
+            }
+            // The file was compacted/rolled back (revision), grew a new
+            // header (size) or was deleted and recreated at the same
+            // revision (inode); drop the stale handle and open afresh.
+            stale = itr->second.db;
+            itr->second.db = nullptr;
+        }
+    }
+    if (stale != nullptr) {
+        closeDatabaseHandle(stale);
+    }
+
+    ++st.numHandleCacheMisses;
+    handle.db = nullptr;
+    handle.fileRev = fileRev;
+    handle.fileSize = (current.size < 0) ? 0 : uint64_t(current.size);
+    handle.inode = current.inode;
+    return openDB(vbucketId, fileRev, &handle.db,
+                  COUCHSTORE_OPEN_FLAG_RDONLY);
+}
+
+void CouchKVStore::returnDbHandle(uint16_t vbucketId,
+                                  const CachedDbHandle& handle) {
+    if (handle.db == nullptr) {
+        return;
+    }
+
+    Db* toClose = handle.db;
+    {
+        std::lock_guard<std::mutex> lh(handleCacheLock);
+        if (dbFileRevMap[vbucketId] == handle.fileRev) {
+            auto& entry = handleCache[vbucketId];
+            if (entry.db == nullptr) {
+                entry = handle;
+                toClose = nullptr;
+            }
+        }
+    }
+    // Either the vbucket moved to a new file revision while the handle
+    // was out (don't pin the unlinked file) or another reader already
+    // re-populated the slot.
+    if (toClose != nullptr) {
+        closeDatabaseHandle(toClose);
+    }
+}
+
+void CouchKVStore::closeHandleCache() {
+    std::unordered_map<uint16_t, CachedDbHandle> dropped;
+    {
+        std::lock_guard<std::mutex> lh(handleCacheLock);
+        dropped.swap(handleCache);
+    }
+    for (auto& entry : dropped) {
+        if (entry.second.db != nullptr) {
+            closeDatabaseHandle(entry.second.db);
+        }
+    }
+}
+
 ENGINE_ERROR_CODE CouchKVStore::couchErr2EngineErr(couchstore_error_t errCode) {
     switch (errCode) {
     case COUCHSTORE_SUCCESS:
@@ -2499,6 +2983,12 @@ RollbackResult CouchKVStore::rollback(uint16_t vbid, uint64_t rollbackSeqno,
     dbFileName << dbname << "/" << vbid << ".couch." << fileRev;
     couchstore_error_t errCode;
 
+    // Rollback rewinds past headers the commit log may still cover;
+    // empty the log first so recovery cannot replay discarded seqnos
+    // back in (and checkpoint again after the commit below, which is
+    // itself not logged).
+    checkpointCommitLog();
+
     errCode = openDB(vbid, fileRev, db.getDbAddress(),
                      (uint64_t) COUCHSTORE_OPEN_FLAG_RDONLY);
 
@@ -2520,17 +3010,14 @@ RollbackResult CouchKVStore::rollback(uint16_t vbid, uint64_t rollbackSeqno,
 
     uint64_t latestSeqno = info.last_sequence;
 
-    //Count from latest seq no to 0
-    uint64_t totSeqCount = 0;
-    errCode = couchstore_changes_count(db.getDb(), 0, latestSeqno, &totSeqCount);
-    if (errCode != COUCHSTORE_SUCCESS) {
-        logger.log(EXTENSION_LOG_WARNING, "CouchKVStore::rollback: "
-                   "couchstore_changes_count(0, %" PRIu64 ") error:%s [%s], "
-                   "vb:%" PRIu16 ", rev:%" PRIu64, latestSeqno,
-                   couchstore_strerror(errCode), cb_strerror().c_str(), vbid,
-                   fileRev);
-        return RollbackResult(false, 0, 0, 0);
-    }
+    // The by-seqno index holds exactly one entry per key (at the seqno of
+    // its most recent mutation, alive or deleted), so the total number of
+    // entries is simply doc_count + deleted_count from the header. This
+    // used to be obtained with couchstore_changes_count(0, latestSeqno),
+    // which walked the entire index and made every rollback pay a cost
+    // proportional to the file before any repair work had started - even
+    // when the divergence was only a handful of seqnos.
+    const uint64_t totSeqCount = info.doc_count + info.deleted_count;
 
     DbHolder newdb(this);
     errCode = openDB(vbid, fileRev, newdb.getDbAddress(), 0);
@@ -2609,6 +3096,10 @@ RollbackResult CouchKVStore::rollback(uint16_t vbid, uint64_t rollbackSeqno,
         return RollbackResult(false, 0, 0, 0);
     }
 
+    // The rewound header must not be lost to a crash (the pre-rollback
+    // header would resurface); sync it for real now.
+    checkpointCommitLog();
+
     vbucket_state* vb_state = getVBucketState(vbid);
     return RollbackResult(true, vb_state->highSeqno,
                           vb_state->lastSnapStart, vb_state->lastSnapEnd);
@@ -2616,6 +3107,17 @@ RollbackResult CouchKVStore::rollback(uint16_t vbid, uint64_t rollbackSeqno,
 
 int populateAllKeys(Db *db, DocInfo *docinfo, void *ctx) {
     AllKeysCtx *allKeysCtx = (AllKeysCtx *)ctx;
+    if (allKeysCtx->endKey.size > 0) {
+        // Stop the walk at the first key past the (inclusive) end key;
+        // couchstore walks the by-ID tree in memcmp order with ties
+        // broken by length.
+        const sized_buf& end = allKeysCtx->endKey;
+        const int cmp = std::memcmp(docinfo->id.buf, end.buf,
+                                    std::min(docinfo->id.size, end.size));
+        if (cmp > 0 || (cmp == 0 && docinfo->id.size > end.size)) {
+            return COUCHSTORE_ERROR_CANCEL;
+        }
+    }
     // Collections: TODO: Restore to stored namespace
     DocKey key = makeDocKey(docinfo->id, false /*restore namespace*/);
     (allKeysCtx->cb)->callback(key);
@@ -2629,21 +3131,27 @@ int populateAllKeys(Db *db, DocInfo *docinfo, void *ctx) {
 ENGINE_ERROR_CODE
 CouchKVStore::getAllKeys(uint16_t vbid,
                          const DocKey start_key,
+                         const DocKey end_key,
                          uint32_t count,
                          std::shared_ptr<Callback<const DocKey&>> cb) {
-    Db *db = NULL;
-    uint64_t rev = dbFileRevMap[vbid];
-    couchstore_error_t errCode = openDB(vbid, rev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    // Use the cached read handle (if any) - a key enumeration job paging
+    // through a vbucket issues many consecutive calls against the same
+    // file, and reusing the handle means each page resumes against the
+    // same cached header rather than re-opening the file.
+    CachedDbHandle cdb;
+    couchstore_error_t errCode = openDBCached(vbid, cdb);
     if(errCode == COUCHSTORE_SUCCESS) {
         sized_buf ref = {NULL, 0};
         ref.buf = (char*) start_key.data();
         ref.size = start_key.size();
-        AllKeysCtx ctx(cb, count);
-        errCode = couchstore_all_docs(db, &ref, COUCHSTORE_NO_DELETES,
+        sized_buf end = {NULL, 0};
+        end.buf = (char*) end_key.data();
+        end.size = end_key.size();
+        AllKeysCtx ctx(cb, count, end);
+        errCode = couchstore_all_docs(cdb.db, &ref, COUCHSTORE_NO_DELETES,
                                       populateAllKeys,
                                       static_cast<void *>(&ctx));
-        closeDatabaseHandle(db);
+        returnDbHandle(vbid, cdb);
         if (errCode == COUCHSTORE_SUCCESS ||
                 errCode == COUCHSTORE_ERROR_CANCEL)  {
             return ENGINE_SUCCESS;
@@ -2652,12 +3160,12 @@ CouchKVStore::getAllKeys(uint16_t vbid,
                        "CouchKVStore::getAllKeys: couchstore_all_docs "
                        "error:%s [%s] vb:%" PRIu16 ", rev:%" PRIu64,
                        couchstore_strerror(errCode), cb_strerror().c_str(),
-                       vbid, rev);
+                       vbid, cdb.fileRev);
         }
     } else {
         logger.log(EXTENSION_LOG_WARNING,
-                   "CouchKVStore::getAllKeys: openDB error:%s, vb:%" PRIu16
-                   ", rev:%" PRIu64, couchstore_strerror(errCode), vbid, rev);
+                   "CouchKVStore::getAllKeys: openDB error:%s, vb:%" PRIu16,
+                   couchstore_strerror(errCode), vbid);
     }
     return ENGINE_FAILED;
 }
@@ -2760,6 +3268,10 @@ bool CouchKVStore::persistCollectionsManifestItem(uint16_t vbid,
         return false;
     }
 
+    // The manifest isn't covered by the commit log; its header must not
+    // be left rewindable.
+    checkpointCommitLog();
+
     return true;
 }
 
@@ -2778,6 +3290,81 @@ std::string CouchKVStore::getCollectionsManifest(uint16_t vbid) {
     return readCollectionsManifest(*db.getDb());
 }
 
+/* Local document under which a vbucket's serialized bloom filter lives */
+static const char bloomFilterLocalDocId[] = "_local/bloomfilter";
+
+void CouchKVStore::saveBloomFilter(uint16_t vbid, const std::string& data) {
+    if (isReadOnly()) {
+        throw std::logic_error("CouchKVStore::saveBloomFilter: Not valid on "
+                "a read-only object.");
+    }
+
+    DbHolder db(this);
+    // openDB logs error details
+    couchstore_error_t errCode = openDB(vbid,
+                                        dbFileRevMap[vbid],
+                                        db.getDbAddress(),
+                                        COUCHSTORE_OPEN_FLAG_CREATE);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        return;
+    }
+
+    LocalDoc lDoc;
+    lDoc.id.buf = const_cast<char*>(bloomFilterLocalDocId);
+    lDoc.id.size = sizeof(bloomFilterLocalDocId) - 1;
+    lDoc.json.buf = const_cast<char*>(data.data());
+    lDoc.json.size = data.size();
+    lDoc.deleted = 0;
+
+    errCode = couchstore_save_local_document(db.getDb(), &lDoc);
+    if (errCode == COUCHSTORE_SUCCESS) {
+        errCode = couchstore_commit(db.getDb());
+    }
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::saveBloomFilter: error:%s [%s], "
+                   "vb:%" PRIu16,
+                   couchstore_strerror(errCode),
+                   couchkvstore_strerrno(db.getDb(), errCode).c_str(),
+                   vbid);
+        return;
+    }
+
+    // The filter isn't covered by the commit log; its header must not
+    // be left rewindable. Rare (shutdown and compaction completion).
+    checkpointCommitLog();
+}
+
+std::string CouchKVStore::loadBloomFilter(uint16_t vbid) {
+    DbHolder db(this);
+    // openDB logs error details
+    couchstore_error_t errCode = openDB(vbid,
+                                        dbFileRevMap[vbid],
+                                        db.getDbAddress(),
+                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        return {};
+    }
+
+    LocalDocHolder lDoc;
+    errCode = couchstore_open_local_document(db.getDb(),
+                                             (void*)bloomFilterLocalDocId,
+                                             sizeof(bloomFilterLocalDocId) - 1,
+                                             lDoc.getLocalDocAddress());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        if (errCode != COUCHSTORE_ERROR_DOC_NOT_FOUND) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::loadBloomFilter: "
+                       "couchstore_open_local_document error:%s, vb:%" PRIu16,
+                       couchstore_strerror(errCode),
+                       vbid);
+        }
+        return {};
+    }
+
+    return {lDoc.getLocalDoc()->json.buf, lDoc.getLocalDoc()->json.size};
+}
+
 void CouchKVStore::incrementRevision(uint16_t vbid) {
     dbFileRevMap[vbid]++;
 }
@@ -2792,4 +3379,250 @@ uint64_t CouchKVStore::prepareToDelete(uint16_t vbid) {
     return dbFileRevMap[vbid];
 }
 
+void CouchKVStore::checkpointCommitLog() {
+    if (!commitLog) {
+        return;
+    }
+    std::lock_guard<std::mutex> lh(commitLogLock);
+    checkpointCommitLog_UNLOCKED();
+}
+
+void CouchKVStore::checkpointCommitLog_UNLOCKED() {
+    if (!commitLog) {
+        return;
+    }
+    if (!lazySyncFileOps->syncAll()) {
+        // A dirty file failed to fsync; the log must keep covering it.
+        // The file stays marked dirty and the next checkpoint retries.
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::checkpointCommitLog: fsync of a dirty "
+                   "couch file failed; keeping the commit log");
+        return;
+    }
+    if (commitLog->isOpen() && commitLog->reset()) {
+        ++st.commitLogCheckpoints;
+    }
+}
+
+void CouchKVStore::replayCommitLog() {
+    try {
+        commitLog->open();
+    } catch (const std::exception& e) {
+        // Without a usable log the lazy-sync window would have no
+        // durability at all; degrade to plain, eagerly-sync'd commits.
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::replayCommitLog: cannot open commit log "
+                   "'%s' (%s); reverting to eager couch file syncs",
+                   commitLog->getLogFile().c_str(),
+                   e.what());
+        commitLog.reset();
+        lazySyncFileOps.reset();
+        statCollectingFileOps = getCouchstoreStatsOps(
+                st.fsStats, mmapFileOps ? *mmapFileOps : base_ops);
+        return;
+    }
+
+    std::map<uint16_t, std::vector<queued_item>> logged;
+    bool clean = true;
+    if (commitLog->getLogSize() > 0) {
+        clean = commitLog->replay([&logged](uint16_t vbid, queued_item itm) {
+            logged[vbid].emplace_back(std::move(itm));
+        });
+    }
+
+    bool allReplayed = true;
+    if (!logged.empty()) {
+        logger.log(EXTENSION_LOG_NOTICE,
+                   "CouchKVStore::replayCommitLog: unclean shutdown; "
+                   "replaying %" PRIu64 " bytes over %" PRIu64
+                   " vbucket(s)%s, shard:%" PRIu16,
+                   uint64_t(commitLog->getLogSize()),
+                   uint64_t(logged.size()),
+                   clean ? "" : " (log has a torn tail)",
+                   configuration.getShardId());
+        for (const auto& vb : logged) {
+            if (!replayVBucket(vb.first, vb.second)) {
+                allReplayed = false;
+            }
+        }
+    }
+
+    if (allReplayed) {
+        // Everything the log covered (and whatever the replay itself
+        // committed) must really be on disk before the log is emptied.
+        std::lock_guard<std::mutex> lh(commitLogLock);
+        checkpointCommitLog_UNLOCKED();
+    } else {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::replayCommitLog: replay incomplete; "
+                   "keeping the commit log for the next startup");
+    }
+}
+
+bool CouchKVStore::replayVBucket(uint16_t vbid,
+                                 const std::vector<queued_item>& items) {
+    const uint64_t firstSeqno = uint64_t(items.front()->getBySeqno());
+    const uint64_t fileRev = dbFileRevMap[vbid];
+
+    DbHolder db(this);
+    couchstore_error_t errCode = openDB(
+            vbid, fileRev, db.getDbAddress(), COUCHSTORE_OPEN_FLAG_CREATE);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        // openDB logs the details
+        return false;
+    }
+
+    DbInfo info;
+    errCode = couchstore_db_info(db.getDb(), &info);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::replayVBucket: couchstore_db_info "
+                   "error:%s, vb:%" PRIu16,
+                   couchstore_strerror(errCode),
+                   vbid);
+        return false;
+    }
+
+    // A header committed at-or-after the first logged record may refer
+    // to data which was never fsync'd. Anything older is durable: the
+    // log only starts filling once a checkpoint has fsync'd everything
+    // before it. Rewind to the newest trusted header.
+    while (info.last_sequence >= firstSeqno) {
+        errCode = couchstore_rewind_db_header(db.getDb());
+        if (errCode != COUCHSTORE_SUCCESS) {
+            // rewind_db_header cleans up (frees DB) on error; so
+            // release db in DbHolder to prevent a double-free.
+            db.releaseDb();
+            break;
+        }
+        errCode = couchstore_db_info(db.getDb(), &info);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::replayVBucket: couchstore_db_info "
+                       "error:%s after rewind, vb:%" PRIu16,
+                       couchstore_strerror(errCode),
+                       vbid);
+            return false;
+        }
+    }
+
+    if (!db.getDb()) {
+        // Ran out of headers: the file was created inside the unsynced
+        // window. Start it afresh - the log holds everything the file
+        // ever acknowledged.
+        const std::string dbFileName = getDBFileName(dbname, vbid, fileRev);
+        if (remove(dbFileName.c_str()) != 0 && errno != ENOENT) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::replayVBucket: failed to remove "
+                       "'%s': %s",
+                       dbFileName.c_str(),
+                       cb_strerror().c_str());
+            return false;
+        }
+        errCode = openDB(
+                vbid, fileRev, db.getDbAddress(), COUCHSTORE_OPEN_FLAG_CREATE);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            return false;
+        }
+        errCode = couchstore_db_info(db.getDb(), &info);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            return false;
+        }
+    }
+
+    // A key may appear several times in the log (one record per flush
+    // batch which touched it); only the newest version needs saving.
+    // The seqno gaps this leaves match what flusher de-duplication
+    // produces anyway.
+    std::unordered_map<StoredDocKey, const Item*> newest;
+    for (const auto& itm : items) {
+        newest[itm->getKey()] = itm.get();
+    }
+
+    std::vector<std::unique_ptr<CouchRequest>> requests;
+    std::vector<Doc*> docs;
+    std::vector<DocInfo*> docinfos;
+    // The callback is never invoked during replay (there's no
+    // commitCallback); the requests only serve to build Doc/DocInfo.
+    MutationRequestCallback requestcb;
+    requestcb.setCb = nullptr;
+    for (const auto& itm : items) {
+        if (newest[itm->getKey()] != itm.get() ||
+            uint64_t(itm->getBySeqno()) <= info.last_sequence) {
+            // Superseded later in the log, or already in the trusted
+            // header.
+            continue;
+        }
+        requests.emplace_back(
+                new CouchRequest(*itm,
+                                 fileRev,
+                                 requestcb,
+                                 itm->isDeleted(),
+                                 configuration.shouldPersistDocNamespace(),
+                                 configuration.shouldCompressAtRest()));
+        docs.push_back(static_cast<Doc*>(requests.back()->getDbDoc()));
+        docinfos.push_back(requests.back()->getDbDocInfo());
+    }
+
+    if (!docs.empty()) {
+        errCode = couchstore_save_documents(
+                db.getDb(),
+                docs.data(),
+                docinfos.data(),
+                (unsigned)docs.size(),
+                COMPRESS_DOC_BODIES | COUCHSTORE_SEQUENCE_AS_IS);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::replayVBucket: "
+                       "couchstore_save_documents error:%s, vb:%" PRIu16,
+                       couchstore_strerror(errCode),
+                       vbid);
+            return false;
+        }
+    }
+
+    vbucket_state* state = getVBucketState(vbid);
+    if (state) {
+        errCode = saveVBState(db.getDb(), *state);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::replayVBucket: saveVBState error:%s, "
+                       "vb:%" PRIu16,
+                       couchstore_strerror(errCode),
+                       vbid);
+            return false;
+        }
+    }
+
+    errCode = couchstore_commit(db.getDb());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::replayVBucket: couchstore_commit "
+                   "error:%s, vb:%" PRIu16,
+                   couchstore_strerror(errCode),
+                   vbid);
+        return false;
+    }
+
+    // Refresh the cached state and stats from what is now the latest
+    // header (initialize() read them from the discarded one).
+    readVBState(db.getDb(), vbid);
+    if (couchstore_db_info(db.getDb(), &info) == COUCHSTORE_SUCCESS) {
+        cachedFileSize[vbid] = info.file_size;
+        cachedSpaceUsed[vbid] = info.space_used;
+        cachedDocCount[vbid] = info.doc_count;
+        cachedDeleteCount[vbid] = info.deleted_count;
+    }
+
+    logger.log(EXTENSION_LOG_NOTICE,
+               "CouchKVStore::replayVBucket: vb:%" PRIu16 " recovered; "
+               "%" PRIu64 " logged record(s), %" PRIu64 " re-saved, high "
+               "seqno now %" PRIu64,
+               vbid,
+               uint64_t(items.size()),
+               uint64_t(docs.size()),
+               info.last_sequence);
+    return true;
+}
+
 /* end of couch-kvstore.cc */
@@ -21,9 +21,12 @@
 #include "config.h"
 
 #include "atomicqueue.h"
+#include "commit_log.h"
 #include "configuration.h"
 #include "couch-kvstore/couch-fs-stats.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
+#include "couch-kvstore/couch-lazy-sync-ops.h"
+#include "couch-kvstore/couch-mmap-ops.h"
 #include "item.h"
 #include "kvstore.h"
 #include "kvstore_priv.h"
@@ -58,12 +61,15 @@ public:
      * @param cb persistence callback
      * @param del flag indicating if it is an item deletion or not
      * @param persistDocNamespace true if we should store the key's namespace
+     * @param compressAtRest true if a value the client didn't already
+     *        send compressed should be compressed when persisted
      */
     CouchRequest(const Item& it,
                  uint64_t rev,
                  MutationRequestCallback& cb,
                  bool del,
-                 bool persistDocNamespace);
+                 bool persistDocNamespace,
+                 bool compressAtRest);
 
     virtual ~CouchRequest() {}
 
@@ -137,7 +143,8 @@ public:
     }
 
 protected:
-    static couchstore_content_meta_flags getContentMeta(const Item& it);
+    static couchstore_content_meta_flags getContentMeta(const Item& it,
+                                                        bool compressAtRest);
 
     value_t value;
 
@@ -428,14 +435,16 @@ public:
      * Get all_docs API, to return the list of all keys in the store
      */
     ENGINE_ERROR_CODE getAllKeys(uint16_t vbid, const DocKey start_key,
-                                 uint32_t count,
+                                 const DocKey end_key, uint32_t count,
                                  std::shared_ptr<Callback<const DocKey&>> cb) override;
 
-    ScanContext* initScanContext(std::shared_ptr<Callback<GetValue> > cb,
-                                 std::shared_ptr<Callback<CacheLookup> > cl,
-                                 uint16_t vbid, uint64_t startSeqno,
-                                 DocumentFilter options,
-                                 ValueFilter valOptions) override;
+    ScanContext* initScanContext(
+            std::shared_ptr<Callback<GetValue> > cb,
+            std::shared_ptr<Callback<CacheLookup> > cl,
+            uint16_t vbid, uint64_t startSeqno,
+            DocumentFilter options,
+            ValueFilter valOptions,
+            ScanOrder scanOrder = ScanOrder::BY_SEQNO) override;
 
     scan_error_t scan(ScanContext* sctx) override;
 
@@ -456,6 +465,19 @@ public:
 
     std::string getCollectionsManifest(uint16_t vbid) override;
 
+    /**
+     * Write the serialized bloom filter into the vbucket file's local
+     * documents (and commit), so a warmup can restore it instead of
+     * serving filterless until the next compaction.
+     */
+    void saveBloomFilter(uint16_t vbid, const std::string& data) override;
+
+    /**
+     * Read the serialized bloom filter from the vbucket file's local
+     * documents; empty if never persisted.
+     */
+    std::string loadBloomFilter(uint16_t vbid) override;
+
     /**
      * Increment the revision number of the vbucket.
      * @param vbid ID of the vbucket to change.
@@ -553,6 +575,56 @@ protected:
     void setDocsCommitted(uint16_t docs);
     void closeDatabaseHandle(Db *db);
 
+    /**
+     * A couchstore handle cached between read operations on one vbucket,
+     * so repeated bgfetches/gets don't pay the file open, header scan
+     * and validation every time. See openDBCached().
+     */
+    struct CachedDbHandle {
+        Db* db = nullptr;
+        /* File revision the handle was opened against */
+        uint64_t fileRev = 0;
+        /* Size of the file just before the handle was opened */
+        uint64_t fileSize = 0;
+        /* Inode of the file (0 where unavailable); guards against a
+           vbucket being deleted and recreated at the same revision */
+        uint64_t inode = 0;
+    };
+
+    /**
+     * Open the vbucket's couch file read-only, re-using the handle cached
+     * by a previous openDBCached/returnDbHandle pair when the file is
+     * unchanged.
+     *
+     * A cached handle is re-used only while the file revision still
+     * matches (compaction, rollback and vbucket deletion move the
+     * vbucket to a new revision) and the file has not grown. couchstore
+     * files are append-only, so an unchanged size means no commit has
+     * landed since the handle was opened and its cached header is still
+     * the latest one; the freshness check is a single stat() instead of
+     * a full open. A stale cached handle is closed and replaced.
+     *
+     * @param vbucketId vbucket to open
+     * @param handle [out] the opened (or re-used) handle; give it back
+     *        via returnDbHandle()
+     * @return COUCHSTORE_SUCCESS or the error from the underlying open
+     */
+    couchstore_error_t openDBCached(uint16_t vbucketId,
+                                    CachedDbHandle& handle);
+
+    /**
+     * Return a handle obtained from openDBCached() to the cache, or
+     * close it if the file has moved to a new revision meanwhile (the
+     * old file may already be unlinked and shouldn't be kept open) or
+     * the vbucket's cache slot is already occupied.
+     */
+    void returnDbHandle(uint16_t vbucketId, const CachedDbHandle& handle);
+
+    /**
+     * Close every handle held by the handle cache.
+     */
+    void closeHandleCache();
+
     /**
      * Unlink selected couch file, which will be removed by the OS,
      * once all its references close.
@@ -580,6 +652,42 @@ protected:
     bool compactDBInternal(compaction_ctx* hook_ctx,
                            couchstore_docinfo_hook dhook);
 
+    /**
+     * Make everything the commit log covers durable in the couch files
+     * themselves (LazySyncOps::syncAll) and empty the log. Performed
+     * when the log grows past couchstore_commit_log_sync_bytes, and
+     * forced ahead of operations which rewrite, rewind or unlink couch
+     * files outside the logged flush path (compaction, rollback,
+     * vbucket delete/reset) and after commits the log doesn't cover
+     * (state-only snapshots, collection manifests, bloom filters), so
+     * crash recovery never has to reason about those. No-op when the
+     * commit log is disabled.
+     */
+    void checkpointCommitLog();
+
+    /// The body of checkpointCommitLog(); caller holds commitLogLock.
+    void checkpointCommitLog_UNLOCKED();
+
+    /**
+     * Replay the commit log over the couch files after an unclean
+     * shutdown. A couch header committed at-or-after the oldest logged
+     * record may refer to data which was never fsync'd, so each logged
+     * vbucket is rewound to its newest header predating the log and
+     * the logged documents are re-saved and committed on top; the
+     * files are then fsync'd for real and the log emptied. Called once
+     * from the read-write constructor, before the read-only sibling
+     * (or anything else) reads the files.
+     */
+    void replayCommitLog();
+
+    /**
+     * The rewind-and-resave step of replayCommitLog() for one vbucket;
+     * items are this vbucket's logged records in seqno order.
+     *
+     * @return true if the vbucket was recovered
+     */
+    bool replayVBucket(uint16_t vbid, const std::vector<queued_item>& items);
+
     const std::string dbname;
 
     /**
@@ -599,6 +707,38 @@ protected:
     std::vector<CouchRequest *> pendingReqsQ;
     bool intransaction;
 
+    /**
+     * Optional FileOpsInterface layer which serves reads from a memory
+     * mapping of the couch file (couchstore_mmap_reads). Sits between
+     * statCollectingFileOps and base_ops; null when disabled or
+     * unsupported on this platform.
+     */
+    std::unique_ptr<FileOpsInterface> mmapFileOps;
+
+    /**
+     * Optional FileOpsInterface layer which absorbs couchstore's
+     * per-commit fsyncs, recording dirty files for a later syncAll()
+     * (couchstore_commit_log_enabled). Sits between
+     * statCollectingFileOps and the mmap/base ops; only the read-write
+     * store has one - the read-only store and compaction keep real
+     * syncs.
+     */
+    std::unique_ptr<LazySyncOps> lazySyncFileOps;
+
+    /**
+     * Per-shard commit log providing flush durability while the couch
+     * file fsyncs are deferred (couchstore_commit_log_enabled); null
+     * when disabled or on the read-only store.
+     */
+    std::unique_ptr<CommitLog> commitLog;
+
+    /**
+     * Guards the commit log (append/sync/reset) and the checkpoint
+     * sequence: the flusher appends and syncs, while checkpoints may be
+     * forced from compaction and other background threads.
+     */
+    std::mutex commitLogLock;
+
     /**
      * FileOpsInterface implementation for couchstore which tracks
      * all bytes read/written by couchstore *except* compaction.
@@ -623,10 +763,60 @@ protected:
     /* pending file deletions */
     AtomicQueue<std::string> pendingFileDeletions;
 
+    /**
+     * Bookkeeping for an active backfill scan. Alongside the couchstore
+     * handle we keep a raw descriptor on the same file, used solely to issue
+     * readahead hints (posix_fadvise) ahead of the scan position so the
+     * kernel fetches upcoming blocks asynchronously while the scan is busy
+     * delivering already-read documents to its callbacks.
+     */
+    struct ScanHandle {
+        Db* db = nullptr;
+        /* Descriptor for readahead hints; -1 if unavailable (open failed or
+           platform lacks posix_fadvise). */
+        int rawFd = -1;
+        /* Size of the file when the scan started. */
+        uint64_t fileSize = 0;
+        /* File offset up to which readahead has already been requested. */
+        uint64_t advisedOffset = 0;
+    };
+
+    /**
+     * Request kernel readahead of the window following the scan's estimated
+     * file position; no-op where posix_fadvise is unavailable.
+     *
+     * @param handle the scan to advise for
+     * @param estimatedOffset estimate of the scan's current file offset
+     */
+    static void adviseScanReadahead(ScanHandle& handle,
+                                    uint64_t estimatedOffset);
+
+    /**
+     * Evict the given byte range of a couch file from the OS page cache.
+     * Used when couchstore_drop_write_cache is enabled so flusher and
+     * compaction write traffic does not evict hot read data. Callers must
+     * only pass ranges that have already been fsync'd (the pages are then
+     * clean and can be dropped immediately). Purely advisory; no-op where
+     * posix_fadvise is unavailable.
+     *
+     * @param filename path of the couch file
+     * @param offset start of the byte range to evict
+     * @param length length of the byte range to evict
+     */
+    static void dropWrittenPageCache(const std::string& filename,
+                                     uint64_t offset,
+                                     uint64_t length);
+
     std::atomic<size_t> scanCounter; //atomic counter for generating scan id
-    std::map<size_t, Db*> scans; //map holding active scans
+    std::map<size_t, ScanHandle> scans; //map holding active scans
     std::mutex scanLock; //lock guarding the scan map
 
+    /* One cached read handle per vbucket (see openDBCached). At most one
+       couch file (and hence descriptor) is held open per vbucket of the
+       shard. */
+    std::unordered_map<uint16_t, CachedDbHandle> handleCache;
+    std::mutex handleCacheLock; //lock guarding the handle cache
+
     Logger& logger;
 
     /**
@@ -0,0 +1,163 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-lazy-sync-ops.h"
+
+#ifndef WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Open the file at `path` and fsync it. Returns true on success, or if
+ * the file no longer exists (a deleted file needs no durability).
+ */
+static bool syncFileByPath(const std::string& path) {
+#ifdef WIN32
+    HANDLE handle = CreateFile(path.c_str(),
+                               GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                       FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL,
+                               NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+    bool synced = (FlushFileBuffers(handle) != 0);
+    CloseHandle(handle);
+    return synced;
+#else
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    bool synced = (fsync(fd) == 0);
+    ::close(fd);
+    return synced;
+#endif
+}
+
+couch_file_handle LazySyncOps::constructor(couchstore_error_info_t* errinfo) {
+    FileOpsInterface* orig_ops = &wrapped_ops;
+    LazyFile* lf = new LazyFile(orig_ops, orig_ops->constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(lf);
+}
+
+couchstore_error_t LazySyncOps::open(couchstore_error_info_t* errinfo,
+                                     couch_file_handle* h,
+                                     const char* path,
+                                     int flags) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(*h);
+    auto errCode = lf->orig_ops->open(errinfo, &lf->orig_handle, path, flags);
+    if (errCode == COUCHSTORE_SUCCESS) {
+        lf->path = path;
+    }
+    return errCode;
+}
+
+couchstore_error_t LazySyncOps::close(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    // The file stays in the dirty set (if present) - durability is per
+    // file, not per handle.
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->close(errinfo, lf->orig_handle);
+}
+
+couchstore_error_t LazySyncOps::set_periodic_sync(couch_file_handle h,
+                                                  uint64_t period_bytes) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->set_periodic_sync(lf->orig_handle, period_bytes);
+}
+
+ssize_t LazySyncOps::pread(couchstore_error_info_t* errinfo,
+                           couch_file_handle h,
+                           void* buf,
+                           size_t sz,
+                           cs_off_t off) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->pread(errinfo, lf->orig_handle, buf, sz, off);
+}
+
+ssize_t LazySyncOps::pwrite(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            const void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->pwrite(errinfo, lf->orig_handle, buf, sz, off);
+}
+
+cs_off_t LazySyncOps::goto_eof(couchstore_error_info_t* errinfo,
+                               couch_file_handle h) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->goto_eof(errinfo, lf->orig_handle);
+}
+
+couchstore_error_t LazySyncOps::sync(couchstore_error_info_t* errinfo,
+                                     couch_file_handle h) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    {
+        std::lock_guard<std::mutex> lh(dirtyLock);
+        dirtyFiles.insert(lf->path);
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t LazySyncOps::advise(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h,
+                                       cs_off_t offs,
+                                       cs_off_t len,
+                                       couchstore_file_advice_t adv) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->advise(errinfo, lf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* LazySyncOps::get_stats(couch_file_handle h) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    return lf->orig_ops->get_stats(lf->orig_handle);
+}
+
+void LazySyncOps::destructor(couch_file_handle h) {
+    LazyFile* lf = reinterpret_cast<LazyFile*>(h);
+    lf->orig_ops->destructor(lf->orig_handle);
+    delete lf;
+}
+
+bool LazySyncOps::syncAll() {
+    std::set<std::string> files;
+    {
+        std::lock_guard<std::mutex> lh(dirtyLock);
+        files.swap(dirtyFiles);
+    }
+
+    bool success = true;
+    for (const auto& path : files) {
+        if (!syncFileByPath(path)) {
+            // Keep it dirty so a later attempt retries; the caller must
+            // not discard whatever is providing interim durability.
+            std::lock_guard<std::mutex> lh(dirtyLock);
+            dirtyFiles.insert(path);
+            success = false;
+        }
+    }
+    return success;
+}
@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * FileOpsInterface implementation which absorbs couchstore's per-commit
+ * fsyncs: sync() merely records the file as dirty and reports success,
+ * so couchstore_commit() reduces to buffered (page cache) writes which
+ * remain fully visible to every reader of the same file. syncAll()
+ * later performs one real fsync per dirty file, letting the owner batch
+ * the expensive random-file syncs far more coarsely than one commit.
+ *
+ * Durability in the window between sync() and syncAll() must be
+ * provided by the owner through some other means (CouchKVStore uses its
+ * CommitLog); a crash inside the window can leave a couch file whose
+ * latest header refers to unsynced data, so the owner must also be
+ * prepared to rewind to an older header on recovery.
+ *
+ * All operations other than sync() are delegated untouched.
+ */
+class LazySyncOps : public FileOpsInterface {
+public:
+    LazySyncOps(FileOpsInterface& ops) : wrapped_ops(ops) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle, const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle, void* buf, size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle, const void* buf,
+                   size_t nbytes, cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle, cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FileOpsInterface::FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+    /**
+     * Fsync every file marked dirty by sync() since the last call.
+     * Files which no longer exist are skipped - a deleted file needs no
+     * durability. A file whose fsync fails stays dirty for the next
+     * attempt.
+     *
+     * @return true if every dirty file was synced (or gone)
+     */
+    bool syncAll();
+
+protected:
+    FileOpsInterface& wrapped_ops;
+
+    struct LazyFile {
+        LazyFile(FileOpsInterface* _orig_ops, couch_file_handle _orig_handle)
+            : orig_ops(_orig_ops), orig_handle(_orig_handle) {
+        }
+
+        FileOpsInterface* orig_ops;
+        couch_file_handle orig_handle;
+        std::string path;
+    };
+
+    /// Guards dirtyFiles - sync() is called from flusher threads while
+    /// syncAll() may run from compaction or shutdown.
+    std::mutex dirtyLock;
+
+    /// Paths with writes made "durable" to couchstore but not yet
+    /// fsync'd for real. Keyed by path (not handle) as the files
+    /// outlive any individual handle.
+    std::set<std::string> dirtyFiles;
+};
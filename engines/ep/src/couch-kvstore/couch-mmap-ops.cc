@@ -0,0 +1,198 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-mmap-ops.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+std::unique_ptr<FileOpsInterface> getCouchstoreMmapOps(
+        FileOpsInterface& base_ops) {
+    return std::unique_ptr<FileOpsInterface>(new MmapOps(base_ops));
+}
+
+MmapOps::MmapFile::MmapFile(FileOpsInterface* _orig_ops,
+                            couch_file_handle _orig_handle)
+    : orig_ops(_orig_ops),
+      orig_handle(_orig_handle),
+      fd(-1),
+      mapping(nullptr),
+      mappedSize(0) {
+}
+
+void MmapOps::MmapFile::remap() {
+    if (fd < 0) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) <= mappedSize) {
+        // Unable to stat, or the file hasn't grown - keep what we have.
+        return;
+    }
+
+    void* newMapping =
+            mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (newMapping == MAP_FAILED) {
+        // Keep any existing (smaller) mapping; reads past it simply fall
+        // back to pread.
+        return;
+    }
+
+    if (mapping) {
+        munmap(mapping, mappedSize);
+    }
+    mapping = newMapping;
+    mappedSize = st.st_size;
+
+    // Bgfetch point gets dominate accesses through the mapping; don't
+    // let them trigger large readaround. Sequential scans are read ahead
+    // by the explicit willneed-advice path, which fills the same page
+    // cache the mapping is backed by.
+    madvise(mapping, mappedSize, MADV_RANDOM);
+}
+
+void MmapOps::MmapFile::unmap() {
+    if (mapping) {
+        munmap(mapping, mappedSize);
+        mapping = nullptr;
+        mappedSize = 0;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+couch_file_handle MmapOps::constructor(couchstore_error_info_t* errinfo) {
+    FileOpsInterface* orig_ops = &wrapped_ops;
+    MmapFile* mf = new MmapFile(orig_ops, orig_ops->constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(mf);
+}
+
+couchstore_error_t MmapOps::open(couchstore_error_info_t* errinfo,
+                                 couch_file_handle* h,
+                                 const char* path,
+                                 int flags) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(*h);
+    auto errCode = mf->orig_ops->open(errinfo, &mf->orig_handle, path, flags);
+    if (errCode == COUCHSTORE_SUCCESS) {
+        mf->unmap();
+        mf->path = path;
+        mf->remap();
+    }
+    return errCode;
+}
+
+couchstore_error_t MmapOps::close(couchstore_error_info_t* errinfo,
+                                  couch_file_handle h) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    mf->unmap();
+    return mf->orig_ops->close(errinfo, mf->orig_handle);
+}
+
+couchstore_error_t MmapOps::set_periodic_sync(couch_file_handle h,
+                                              uint64_t period_bytes) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->set_periodic_sync(mf->orig_handle, period_bytes);
+}
+
+ssize_t MmapOps::pread(couchstore_error_info_t* errinfo,
+                       couch_file_handle h,
+                       void* buf,
+                       size_t sz,
+                       cs_off_t off) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+
+    if (mf->mapping && off >= 0 && size_t(off) + sz > mf->mappedSize) {
+        // The file has likely been appended to since it was mapped (we
+        // share the file with the writer); try to grow the mapping.
+        mf->remap();
+    }
+
+    if (mf->mapping && off >= 0 && size_t(off) + sz <= mf->mappedSize) {
+        // MAP_SHARED mappings are coherent with writes to the same file,
+        // so this sees everything pread would.
+        std::memcpy(buf, static_cast<const char*>(mf->mapping) + off, sz);
+        return sz;
+    }
+
+    return mf->orig_ops->pread(errinfo, mf->orig_handle, buf, sz, off);
+}
+
+ssize_t MmapOps::pwrite(couchstore_error_info_t* errinfo,
+                        couch_file_handle h,
+                        const void* buf,
+                        size_t sz,
+                        cs_off_t off) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->pwrite(errinfo, mf->orig_handle, buf, sz, off);
+}
+
+cs_off_t MmapOps::goto_eof(couchstore_error_info_t* errinfo,
+                           couch_file_handle h) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->goto_eof(errinfo, mf->orig_handle);
+}
+
+couchstore_error_t MmapOps::sync(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->sync(errinfo, mf->orig_handle);
+}
+
+couchstore_error_t MmapOps::advise(couchstore_error_info_t* errinfo,
+                                   couch_file_handle h,
+                                   cs_off_t offs,
+                                   cs_off_t len,
+                                   couchstore_file_advice_t adv) {
+    // Forwarded untouched; advice is applied to the underlying file and
+    // affects the page cache the mapping is backed by.
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->advise(errinfo, mf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* MmapOps::get_stats(couch_file_handle h) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    return mf->orig_ops->get_stats(mf->orig_handle);
+}
+
+void MmapOps::destructor(couch_file_handle h) {
+    MmapFile* mf = reinterpret_cast<MmapFile*>(h);
+    mf->unmap();
+    mf->orig_ops->destructor(mf->orig_handle);
+    delete mf;
+}
+
+#else // WIN32
+
+std::unique_ptr<FileOpsInterface> getCouchstoreMmapOps(FileOpsInterface&) {
+    // No mmap on this platform; the caller uses the base ops directly.
+    return nullptr;
+}
+
+#endif // WIN32
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <memory>
+#include <string>
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * Returns a FileOpsInterface which serves reads from a shared, read-only
+ * memory mapping of the couch file, wrapping the given base FileOps
+ * implementation for everything else. Returns nullptr on platforms
+ * without mmap support; the caller should then use the base ops
+ * directly.
+ */
+std::unique_ptr<FileOpsInterface> getCouchstoreMmapOps(
+        FileOpsInterface& base_ops);
+
+/**
+ * FileOpsInterface implementation which mmap()s the couch file at open
+ * and serves pread() from the mapping with a plain memcpy, eliminating
+ * the syscall per B-tree node touch on the read path. Reads which fall
+ * outside the mapping (the file has been appended to since it was
+ * mapped) first attempt to grow the mapping, then fall back to the
+ * wrapped ops' pread; writes and all other operations are always
+ * delegated.
+ *
+ * The mapping is advised MADV_RANDOM, matching the point-get pattern of
+ * bgfetches; sequential scans are already read ahead via the explicit
+ * willneed-advice path, which populates the same page cache the mapping
+ * is backed by.
+ */
+class MmapOps : public FileOpsInterface {
+public:
+    MmapOps(FileOpsInterface& ops) : wrapped_ops(ops) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle, const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle, void* buf, size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle, const void* buf,
+                   size_t nbytes, cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle, cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FileOpsInterface::FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    FileOpsInterface& wrapped_ops;
+
+    struct MmapFile {
+        MmapFile(FileOpsInterface* _orig_ops, couch_file_handle _orig_handle);
+
+        /// Map (or grow the mapping of) the file at `path`. No-op if the
+        /// file cannot be mapped; reads then use the wrapped ops.
+        void remap();
+
+        /// Release the mapping and our file descriptor, if any.
+        void unmap();
+
+        FileOpsInterface* orig_ops;
+        couch_file_handle orig_handle;
+
+        std::string path;
+        int fd;
+        void* mapping;
+        size_t mappedSize;
+    };
+};
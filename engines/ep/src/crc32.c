@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include <stdio.h>
+#include <string.h>
 #include "crc32.h"
 
 /**********************************************************************\
@@ -123,3 +124,95 @@ uint32_t crc32buf(uint8_t *buf, size_t len) {
 
     return ~oldcrc32;
 }
+
+/* CRC-32C (Castagnoli, polynomial 0x1EDC6F41, reflected 0x82f63b78).
+   This is the polynomial implemented by the SSE4.2 and ARMv8 CRC
+   instructions, which compute it eight bytes at a time; the table
+   fallback below covers CPUs without them. */
+
+static uint32_t crc_32c_tab[256];
+static int crc_32c_tab_ready = 0;
+
+/* Generate the table on first use. Racing initializers write identical
+   values, so the worst case of an unsynchronized first call is redundant
+   work, not a wrong table. */
+static void crc32c_init_table(void) {
+    uint32_t i, j, crc;
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+        crc_32c_tab[i] = crc;
+    }
+    crc_32c_tab_ready = 1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+/* -1 = not yet probed, 0 = no SSE4.2, 1 = SSE4.2 present. Same benign
+   race as the table init: every prober stores the same answer. */
+static int crc32c_hw_state = -1;
+
+/* Inline asm rather than the crc32 intrinsics so this file does not need
+   to be compiled with -msse4.2 (the instruction is only executed after
+   the cpuid probe). */
+static uint32_t crc32c_hw(const uint8_t *buf, size_t len, uint32_t crc_in) {
+    uint64_t crc = crc_in;
+    while (len >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, buf, sizeof(chunk));
+        __asm__("crc32q %1, %0" : "+r"(crc) : "rm"(chunk));
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) {
+        __asm__("crc32b %1, %0" : "+r"(crc) : "rm"(*buf));
+        ++buf;
+    }
+    return (uint32_t)crc;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+
+static uint32_t crc32c_hw(const uint8_t *buf, size_t len, uint32_t crc) {
+    while (len >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, buf, sizeof(chunk));
+        crc = __crc32cd(crc, chunk);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *buf);
+        ++buf;
+    }
+    return crc;
+}
+
+#endif
+
+uint32_t crc32cbuf(uint8_t *buf, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (crc32c_hw_state == -1) {
+        crc32c_hw_state = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    if (crc32c_hw_state) {
+        return ~crc32c_hw(buf, len, crc);
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return ~crc32c_hw(buf, len, crc);
+#endif
+
+    if (!crc_32c_tab_ready) {
+        crc32c_init_table();
+    }
+    for ( ; len; --len, ++buf) {
+        crc = crc_32c_tab[(crc ^ *buf) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -24,4 +24,14 @@
 
 uint32_t crc32buf(uint8_t *buf, size_t len);
 
+/**
+ * CRC-32C (Castagnoli polynomial). Computed with the dedicated CRC
+ * instructions (SSE4.2 / ARMv8) when the CPU has them, processing eight
+ * bytes per instruction, and falling back to a table implementation
+ * otherwise. Note the result is a different value than crc32buf() for
+ * the same input; callers persisting checksums must version their
+ * format.
+ */
+uint32_t crc32cbuf(uint8_t *buf, size_t len);
+
 #endif  /* SRC_CRC32_H_ */
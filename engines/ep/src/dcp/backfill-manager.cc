@@ -109,6 +109,27 @@ BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
     buffer.full = false;
 }
 
+void BackfillManager::setPriority(BackfillPriority priority) {
+    LockHolder lh(lock);
+    Configuration& config = engine.getConfiguration();
+    size_t scanBytes = config.getDcpScanByteLimit();
+    size_t bufferBytes = config.getDcpBackfillByteLimit();
+    switch (priority) {
+    case BackfillPriority::High:
+        scanBytes *= 2;
+        bufferBytes *= 2;
+        break;
+    case BackfillPriority::Medium:
+        break;
+    case BackfillPriority::Low:
+        scanBytes /= 2;
+        bufferBytes /= 2;
+        break;
+    }
+    scanBuffer.maxBytes = scanBytes;
+    buffer.maxBytes = bufferBytes;
+}
+
 void BackfillManager::addStats(DcpProducer& conn,
                                ADD_STAT add_stat,
                                const void* c) {
@@ -302,12 +323,29 @@ backfill_status_t BackfillManager::backfill() {
         return reschedule ? backfill_success : backfill_snooze;
     }
 
-    UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
-    activeBackfills.pop_front();
+    /* Prefer a backfill whose vbucket is being scanned by another connection
+       right now. Running overlapping scans back-to-back means the first pass
+       pulls the file through the page cache and the later ones are served
+       from memory, instead of each doing its own disk pass. Falls back to
+       the front of the queue (plain round-robin) when there is no overlap. */
+    auto chosen = activeBackfills.begin();
+    for (auto itr = activeBackfills.begin(); itr != activeBackfills.end();
+         ++itr) {
+        if (engine.getDcpConnMap().isBackfillScanActive(
+                    (*itr)->getVBucketId())) {
+            chosen = itr;
+            break;
+        }
+    }
+    UniqueDCPBackfillPtr backfill = std::move(*chosen);
+    activeBackfills.erase(chosen);
 
+    uint16_t backfillVb = backfill->getVBucketId();
+    engine.getDcpConnMap().backfillScanStarted(backfillVb);
     lh.unlock();
     backfill_status_t status = backfill->run();
     lh.lock();
+    engine.getDcpConnMap().backfillScanFinished(backfillVb);
 
     scanBuffer.bytesRead = 0;
     scanBuffer.itemsRead = 0;
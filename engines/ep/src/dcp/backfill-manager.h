@@ -52,6 +52,17 @@
 
 class EventuallyPersistentEngine;
 
+/**
+ * Priority class of a connection's backfills, derived from the connection's
+ * DCP priority (the "set_priority" control message). ns_server runs
+ * rebalance (takeover) connections at High, while replica repair and
+ * external consumers (views, XDCR, analytics) run at Medium or Low. The
+ * class scales the disk-byte budgets the connection's backfills may consume,
+ * so when several connections are backfilling concurrently the disk
+ * bandwidth is apportioned by importance instead of uniformly.
+ */
+enum class BackfillPriority { High, Medium, Low };
+
 class BackfillManager : public std::enable_shared_from_this<BackfillManager> {
 public:
     BackfillManager(EventuallyPersistentEngine& e);
@@ -65,6 +76,16 @@ public:
                   uint64_t start,
                   uint64_t end);
 
+    /**
+     * Scale this connection's backfill byte budgets by its priority class:
+     * High gets twice the configured scan/backfill byte limits, Medium the
+     * configured values and Low half of them. Called whenever the owning
+     * producer's priority changes.
+     *
+     * @param priority the class to apply
+     */
+    void setPriority(BackfillPriority priority);
+
     /**
      * Checks if the read size can fit into the backfill buffer and scan
      * buffer and reads only if the read can fit.
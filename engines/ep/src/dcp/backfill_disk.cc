@@ -50,6 +50,18 @@ CacheCallback::CacheCallback(EventuallyPersistentEngine& e, active_stream_t& s)
 }
 
 void CacheCallback::callback(CacheLookup& lookup) {
+    // If the stream is filtering by collection, drop this item before
+    // paying for the read of its value - the verdict is the same one
+    // queueResponse would reach after the fetch. A filtered stream of a
+    // small collection then only pays the metadata cost of the scan, not
+    // the disk cost of every document in the seqno range. System namespace
+    // keys take the normal path, system events have their own rules.
+    if (lookup.getKey().getDocNamespace() != DocNamespace::System &&
+        !stream_->filterAllowsKey(lookup.getKey())) {
+        setStatus(ENGINE_KEY_EEXISTS);
+        return;
+    }
+
     VBucketPtr vb =
             engine_.getKVBucket()->getVBucket(lookup.getVBucketId());
     if (!vb) {
@@ -169,11 +181,27 @@ backfill_status_t DCPBackfillDisk::create() {
         }
     }
 
+    ScanOrder scanOrder = ScanOrder::BY_SEQNO;
+    if (stream->isKeyOrderBackfill()) {
+        // Client opted in to key-order backfill; walk the by-ID index for
+        // sequential access to the whole keyspace rather than seqno order.
+        scanOrder = ScanOrder::BY_ID;
+        stream->getLogger().log(EXTENSION_LOG_NOTICE,
+                                "(vb %d) Backfill running in key order "
+                                "(by-ID index scan)",
+                                vbid);
+    }
+
     std::shared_ptr<Callback<GetValue> > cb(new DiskCallback(stream));
     std::shared_ptr<Callback<CacheLookup> > cl(
             new CacheCallback(engine, stream));
-    scanCtx = kvstore->initScanContext(
-            cb, cl, vbid, startSeqno, DocumentFilter::ALL_ITEMS, valFilter);
+    scanCtx = kvstore->initScanContext(cb,
+                                       cl,
+                                       vbid,
+                                       startSeqno,
+                                       DocumentFilter::ALL_ITEMS,
+                                       valFilter,
+                                       scanOrder);
 
     if (scanCtx) {
         stream->incrBackfillRemaining(scanCtx->documentCount);
@@ -46,7 +46,7 @@ backfill_status_t DCPBackfillMemory::run() {
     }
 
     /* Get vb state lock */
-    ReaderLockHolder rlh(evb->getStateLock());
+    StripedRWLock::ReadHolder rlh(evb->getStateLock());
     if (evb->getState() == vbucket_state_dead) {
         /* We don't have to close the stream here. Task doing vbucket state
            change should handle stream closure */
@@ -60,40 +60,79 @@ backfill_status_t DCPBackfillMemory::run() {
         return backfill_finished;
     }
 
-    /* Get sequence of items (backfill) from memory */
-    ENGINE_ERROR_CODE status;
-    std::vector<UniqueItemPtr> items;
-    seqno_t adjustedEndSeqno;
-    std::tie(status, items, adjustedEndSeqno) =
-            evb->inMemoryBackfill(startSeqno, endSeqno);
-
-    /* Handle any failures */
-    if (status != ENGINE_SUCCESS) {
+    /* Stream the range directly off the sequence list. The range iterator
+       pins the snapshot, and each streamed item shares the stored value's
+       Blob by reference, so the transient cost is a single Item shell at a
+       time rather than a materialised copy of the entire range. */
+    boost::optional<SequenceList::RangeIterator> rangeItrOptional;
+    try {
+        rangeItrOptional = evb->makeRangeIterator(true /*isBackfill*/);
+    } catch (const std::bad_alloc&) {
         LOG(EXTENSION_LOG_WARNING,
             "DCPBackfillMemory::run(): "
-            "(vb:%d) running backfill failed with error %d ; "
-            "start seqno:%" PRIi64 ", end seqno:%" PRIi64
-            ". "
-            "Hence closing the stream",
-            getVBucketId(),
-            status,
-            startSeqno,
-            endSeqno);
-        /* Close the stream, DCP clients can retry */
-        stream->setDead(END_STREAM_BACKFILL_FAIL);
+            "(vb:%d) alloc error when trying to create a range iterator "
+            "on the sequence list",
+            getVBucketId());
+        /* Try backfilling again later; here we snooze because system has
+           hit ENOMEM */
+        return backfill_snooze;
+    }
+    if (!rangeItrOptional) {
+        LOG(EXTENSION_LOG_INFO,
+            "DCPBackfillMemory::run(): "
+            "(vb:%d) deferring backfill as another range iterator is "
+            "already on the sequence list",
+            getVBucketId());
+        return backfill_snooze;
+    }
+    auto rangeItr = std::move(*rangeItrOptional);
+
+    /* Advance the iterator to the start of the requested range */
+    while (rangeItr.curr() != rangeItr.end() &&
+           static_cast<uint64_t>((*rangeItr).getBySeqno()) < startSeqno) {
+        ++rangeItr;
+    }
+
+    if (rangeItr.curr() == rangeItr.end()) {
+        /* Backfill is not needed as startSeqno > iterator end seqno */
+        stream->completeBackfill();
         return backfill_finished;
     }
 
-    /* Put items onto readyQ of the DCP stream */
-    stream->incrBackfillRemaining(items.size());
+    /* Determine the endSeqno of the snapshot; we want to send till the
+       requested endSeqno, but if that cannot constitute a snapshot then
+       send till the point which can be called a snapshot end */
+    uint64_t adjustedEndSeqno = std::max(
+            endSeqno, static_cast<uint64_t>(rangeItr.getEarlySnapShotEnd()));
+    adjustedEndSeqno = std::min(adjustedEndSeqno,
+                                static_cast<uint64_t>(rangeItr.back()));
+
+    stream->incrBackfillRemaining(rangeItr.count());
 
     /* Mark disk snapshot */
     stream->markDiskSnapshot(startSeqno, adjustedEndSeqno);
 
-    /* Move every item to the stream */
-    for (auto& item : items) {
+    /* Move every item in the range to the stream */
+    while (rangeItr.curr() != rangeItr.end() &&
+           static_cast<uint64_t>(rangeItr.curr()) <= adjustedEndSeqno) {
+        UniqueItemPtr item;
+        try {
+            item = (*rangeItr).toItem(false, getVBucketId());
+        } catch (const std::bad_alloc&) {
+            LOG(EXTENSION_LOG_WARNING,
+                "DCPBackfillMemory::run(): "
+                "(vb:%d) alloc error when trying to create an item copy "
+                "from the sequence list. Item seqno:%" PRIi64
+                ". Hence closing the stream",
+                getVBucketId(),
+                (*rangeItr).getBySeqno());
+            /* Close the stream, DCP clients can retry */
+            stream->setDead(END_STREAM_BACKFILL_FAIL);
+            return backfill_finished;
+        }
         stream->backfillReceived(
                 std::move(item), BACKFILL_FROM_MEMORY, /*force*/ true);
+        ++rangeItr;
     }
 
     /* Indicate completion to the stream */
@@ -113,7 +152,7 @@ DCPBackfillMemoryBuffered::DCPBackfillMemoryBuffered(EphemeralVBucketPtr evb,
 }
 
 backfill_status_t DCPBackfillMemoryBuffered::run() {
-    ReaderLockHolder rlh(evb->getStateLock());
+    StripedRWLock::ReadHolder rlh(evb->getStateLock());
     if (evb->getState() == vbucket_state_dead) {
         /* We don't have to close the stream here. Task doing vbucket state
            change should handle stream closure */
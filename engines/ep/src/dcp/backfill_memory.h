@@ -27,9 +27,10 @@
  * Concrete class that does backfill from in-memory ordered data strucuture and
  * informs the DCP stream of the backfill progress.
  *
- * This class calls one synchronous vBucket API to read items in the sequential
- * order from the in-memory ordered data structure and calls the DCP stream
- * for disk snapshot, backfill items and backfill completion.
+ * This class streams the whole requested range to the DCP stream in a single
+ * run() invocation (disk snapshot marker, backfill items, completion),
+ * reading the items one by one off a range iterator on the in-memory ordered
+ * data structure rather than materialising a copy of the range up front.
  */
 class DCPBackfillMemory : public DCPBackfill {
 public:
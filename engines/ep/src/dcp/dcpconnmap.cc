@@ -363,6 +363,7 @@ void DcpConnMap::removeVBConnections(connection_t &conn) {
         for (; itr != vb_conns.end(); ++itr) {
             if (conn->getCookie() == (*itr)->getCookie()) {
                 vb_conns.erase(itr);
+                vbConnCounts[vbid]--;
                 break;
             }
         }
@@ -370,13 +371,26 @@ void DcpConnMap::removeVBConnections(connection_t &conn) {
 }
 
 void DcpConnMap::notifyVBConnections(uint16_t vbid, uint64_t bySeqno) {
-    size_t lock_num = vbid % vbConnLockNum;
-    std::lock_guard<SpinLock> lh(vbConnLocks[lock_num]);
+    // Fast path - no DCP connection is streaming this vbucket, so there
+    // is nothing to wake and no need to touch the lock shard.
+    if (vbConnCounts[vbid].load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // Snapshot the connection list under the lock but deliver the
+    // notifications outside it; notifySeqnoAvailable performs a stream
+    // lookup per producer and holding the shard lock across that would
+    // serialise every front-end thread hashing to the same shard.
+    std::vector<connection_t> conns;
+    {
+        size_t lock_num = vbid % vbConnLockNum;
+        std::lock_guard<SpinLock> lh(vbConnLocks[lock_num]);
+        std::list<connection_t> &vb_conns = vbConns[vbid];
+        conns.assign(vb_conns.begin(), vb_conns.end());
+    }
 
-    std::list<connection_t> &conns = vbConns[vbid];
-    std::list<connection_t>::iterator it = conns.begin();
-    for (; it != conns.end(); ++it) {
-        DcpProducer *conn = static_cast<DcpProducer*>((*it).get());
+    for (const auto& c : conns) {
+        DcpProducer *conn = static_cast<DcpProducer*>(c.get());
         conn->notifySeqnoAvailable(vbid, bySeqno);
     }
 }
@@ -413,6 +427,27 @@ void DcpConnMap::decrNumActiveSnoozingBackfills()
     LOG(EXTENSION_LOG_WARNING, "ActiveSnoozingBackfills already zero!!!");
 }
 
+void DcpConnMap::backfillScanStarted(uint16_t vbid)
+{
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    ++backfills.runningScans[vbid];
+}
+
+void DcpConnMap::backfillScanFinished(uint16_t vbid)
+{
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    auto itr = backfills.runningScans.find(vbid);
+    if (itr != backfills.runningScans.end() && --(itr->second) == 0) {
+        backfills.runningScans.erase(itr);
+    }
+}
+
+bool DcpConnMap::isBackfillScanActive(uint16_t vbid)
+{
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    return backfills.runningScans.find(vbid) != backfills.runningScans.end();
+}
+
 void DcpConnMap::updateMaxActiveSnoozingBackfills(size_t maxDataSize)
 {
     double numBackfillsMemThresholdPercent =
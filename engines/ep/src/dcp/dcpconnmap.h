@@ -104,6 +104,25 @@ public:
 
     void decrNumActiveSnoozingBackfills();
 
+    /**
+     * Note that a disk backfill scan on the given vbucket has started
+     * running. Used by BackfillManagers to align concurrent scans of the
+     * same vbucket in time: when several connections backfill one vbucket
+     * (rebalance plus XDCR targets is routine), running their scans
+     * back-to-back lets the first pass pull the file through the page cache
+     * and the rest read from memory, instead of N independent disk passes.
+     */
+    void backfillScanStarted(uint16_t vbid);
+
+    /** Note that a disk backfill scan on the given vbucket has finished */
+    void backfillScanFinished(uint16_t vbid);
+
+    /**
+     * @return true if a disk backfill scan is currently running on the
+     *         given vbucket
+     */
+    bool isBackfillScanActive(uint16_t vbid);
+
     void updateMaxActiveSnoozingBackfills(size_t maxDataSize);
 
     uint16_t getNumActiveSnoozingBackfills () {
@@ -185,6 +204,8 @@ protected:
         std::mutex mutex;
         uint16_t numActiveSnoozing;
         uint16_t maxActiveSnoozing;
+        // Count of currently-running disk scans, per vbucket.
+        std::map<uint16_t, uint16_t> runningScans;
     } backfills;
 
     /* Max num of backfills we want to have irrespective of memory */
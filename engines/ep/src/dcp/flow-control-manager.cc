@@ -39,6 +39,15 @@ bool DcpFlowControlManager::isEnabled() const
     return false;
 }
 
+size_t DcpFlowControlManager::requestBufferSizeChange(DcpConsumer *,
+                                                      size_t currentSize,
+                                                      size_t)
+{
+    /* Policies whose buffer sizes are fixed (static) do not grant any
+       change */
+    return currentSize;
+}
+
 void DcpFlowControlManager::setBufSizeWithinBounds(DcpConsumer *consumerConn,
                                                    size_t &bufSize)
 {
@@ -133,6 +142,31 @@ bool DcpFlowControlManagerDynamic::isEnabled() const
     return true;
 }
 
+size_t DcpFlowControlManagerDynamic::requestBufferSizeChange(
+                                                    DcpConsumer *consumerConn,
+                                                    size_t currentSize,
+                                                    size_t desiredSize)
+{
+    setBufSizeWithinBounds(consumerConn, desiredSize);
+    if (desiredSize > currentSize) {
+        /* Growth must keep the aggregate flow control memory under the
+           threshold */
+        Configuration &config = engine_.getConfiguration();
+        double dcpConnBufferSizeThreshold = static_cast<double>
+                            (config.getDcpConnBufferSizeAggrMemThreshold())/100;
+        size_t delta = desiredSize - currentSize;
+        if ((aggrDcpConsumerBufferSize + delta)
+            > dcpConnBufferSizeThreshold * engine_.getEpStats().getMaxDataSize())
+        {
+            return currentSize;
+        }
+        aggrDcpConsumerBufferSize += delta;
+    } else {
+        aggrDcpConsumerBufferSize -= (currentSize - desiredSize);
+    }
+    return desiredSize;
+}
+
 DcpFlowControlManagerAggressive::DcpFlowControlManagerAggressive(
                                         EventuallyPersistentEngine &engine) :
     DcpFlowControlManager(engine)
@@ -208,6 +242,30 @@ bool DcpFlowControlManagerAggressive::isEnabled() const
     return true;
 }
 
+size_t DcpFlowControlManagerAggressive::requestBufferSizeChange(
+                                                    DcpConsumer *consumerConn,
+                                                    size_t currentSize,
+                                                    size_t desiredSize)
+{
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+
+    setBufSizeWithinBounds(consumerConn, desiredSize);
+    if (desiredSize > currentSize) {
+        /* Growth must keep the sum of all connections' buffers within the
+           aggregate fraction of the bucket quota */
+        size_t aggrBufferSize = 0;
+        for (const auto& iter : dcpConsumersMap) {
+            aggrBufferSize += iter.second->getFlowControlBufSize();
+        }
+        size_t aggrLimit = dcpConnBufferSizeAggrFrac *
+                           engine_.getEpStats().getMaxDataSize();
+        if ((aggrBufferSize - currentSize + desiredSize) > aggrLimit) {
+            return currentSize;
+        }
+    }
+    return desiredSize;
+}
+
 void DcpFlowControlManagerAggressive::resizeBuffers_UNLOCKED(size_t bufferSize)
 {
     /* Set buffer size of all existing connections to the new buf size */
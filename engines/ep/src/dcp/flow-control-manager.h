@@ -50,6 +50,22 @@ public:
     /* Will indicate if flow control is enabled */
     virtual bool isEnabled(void) const;
 
+    /**
+     * Request a new buffer size for an existing connection, as computed by
+     * the connection from its observed drain rate.
+     *
+     * @param consumerConn the requesting connection
+     * @param currentSize the connection's current buffer size
+     * @param desiredSize the size the connection would like
+     *
+     * @return the granted size, after applying the min/max bounds and any
+     *         policy specific limits. Policies whose sizes are fixed or
+     *         centrally managed return currentSize unchanged.
+     */
+    virtual size_t requestBufferSizeChange(DcpConsumer* consumerConn,
+                                           size_t currentSize,
+                                           size_t desiredSize);
+
 protected:
     void setBufSizeWithinBounds(DcpConsumer *consumerConn, size_t &bufSize);
 
@@ -92,6 +108,10 @@ public:
 
     bool isEnabled(void) const;
 
+    size_t requestBufferSizeChange(DcpConsumer* consumerConn,
+                                   size_t currentSize,
+                                   size_t desiredSize);
+
 private:
     /* Total memory used by all DCP consumer buffers */
     std::atomic_size_t aggrDcpConsumerBufferSize;
@@ -116,6 +136,10 @@ public:
 
     bool isEnabled(void) const;
 
+    size_t requestBufferSizeChange(DcpConsumer* consumerConn,
+                                   size_t currentSize,
+                                   size_t desiredSize);
+
 private:
     /**
      * Resize all flow control buffers in dcpConsumersMap.
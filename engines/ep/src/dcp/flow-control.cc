@@ -25,14 +25,30 @@
 #include "ep_time.h"
 #include "objectregistry.h"
 
+#include <algorithm>
+
+/* How often the flow control buffer size is re-evaluated against the
+   connection's observed drain rate */
+static const std::chrono::seconds bufSizeAdjustInterval(5);
+
+/* Base and maximum period (seconds) of the fallback buffer ack that
+   returns slowly-drained bytes to the producer. The period backs off
+   exponentially while the acks it sends are tiny (pure control chatter on
+   a quiet connection) and resets once a substantial ack goes out. */
+static const rel_time_t baseBufferAckPeriod = 5;
+static const rel_time_t maxBufferAckPeriod = 60;
+
 FlowControl::FlowControl(EventuallyPersistentEngine &engine,
                          DcpConsumer* consumer) :
     consumerConn(consumer),
     engine_(engine),
     pendingControl(true),
     lastBufferAck(ep_current_time()),
+    bufferAckPeriod(baseBufferAckPeriod),
     ackedBytes(0),
-    freedBytes(0)
+    freedBytes(0),
+    lastBufSizeAdjust(ProcessClock::now()),
+    drainedSinceAdjust(0)
 {
     enabled = engine.getDcpFlowControlManager().isEnabled();
     if (enabled) {
@@ -69,6 +85,7 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
             ObjectRegistry::onSwitchThread(epe);
             return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
         } else if (isBufferSufficientlyDrained_UNLOCKED(ackable_bytes)) {
+            bufferAckPeriod = baseBufferAckPeriod;
             lh.unlock();
             /* Send a buffer ack when at least 20% of the buffer is drained */
             uint64_t opaque = consumerConn->incrOpaqueCounter();
@@ -80,11 +97,21 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
             lastBufferAck = ep_current_time();
             ackedBytes.fetch_add(ackable_bytes);
             freedBytes.fetch_sub(ackable_bytes);
+            maybeAdjustBufSize(ackable_bytes);
             return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
         } else if (ackable_bytes > 0 &&
-                   (ep_current_time() - lastBufferAck) > 5) {
+                   (ep_current_time() - lastBufferAck) > bufferAckPeriod) {
+            /* Fallback periodic ack so slowly-drained bytes are eventually
+               returned to the producer. If the ack is tiny the connection
+               is quiet and the ack is pure chatter - back the period off;
+               a substantial ack resets it to the base period. */
+            if (ackable_bytes < bufferSize / 100) {
+                bufferAckPeriod =
+                        std::min(bufferAckPeriod * 2, maxBufferAckPeriod);
+            } else {
+                bufferAckPeriod = baseBufferAckPeriod;
+            }
             lh.unlock();
-            /* Ack at least every 5 seconds */
             uint64_t opaque = consumerConn->incrOpaqueCounter();
             EventuallyPersistentEngine *epe =
                                     ObjectRegistry::onSwitchThread(NULL, true);
@@ -94,6 +121,7 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
             lastBufferAck = ep_current_time();
             ackedBytes.fetch_add(ackable_bytes);
             freedBytes.fetch_sub(ackable_bytes);
+            maybeAdjustBufSize(ackable_bytes);
             return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
         } else {
             lh.unlock();
@@ -102,6 +130,54 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
     return ENGINE_FAILED;
 }
 
+void FlowControl::maybeAdjustBufSize(uint32_t justAcked)
+{
+    std::unique_lock<SpinLock> lh(bufferSizeLock);
+    drainedSinceAdjust += justAcked;
+
+    auto now = ProcessClock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - lastBufSizeAdjust);
+    if (elapsed < bufSizeAdjustInterval) {
+        return;
+    }
+
+    /* Window sized to hold one second of traffic at the observed drain
+       rate */
+    size_t desired = (drainedSinceAdjust * 1000) / elapsed.count();
+    drainedSinceAdjust = 0;
+    lastBufSizeAdjust = now;
+
+    /* Ignore changes of less than 25% to avoid flooding the producer with
+       control messages over measurement noise */
+    size_t current = bufferSize;
+    if (desired > (current * 3) / 4 && desired < (current * 5) / 4) {
+        return;
+    }
+
+    /* Drop the spinlock across the manager call; the aggressive policy
+       re-reads every connection's buffer size (including ours) while
+       arbitrating */
+    lh.unlock();
+    size_t granted = engine_.getDcpFlowControlManager().requestBufferSizeChange(
+            consumerConn, current, desired);
+    if (granted == current) {
+        return;
+    }
+
+    lh.lock();
+    if (bufferSize != current) {
+        /* A central resize (aggressive policy) raced with us; keep it */
+        return;
+    }
+    bufferSize = granted;
+    pendingControl = true;
+    lh.unlock();
+    LOG(EXTENSION_LOG_INFO, "%s Conn flow control buffer adjusted from "
+        "%zu to %zu (drain rate %zu bytes/s)",
+        consumerConn->logHeader(), current, granted, desired);
+}
+
 void FlowControl::incrFreedBytes(uint32_t bytes)
 {
     freedBytes.fetch_add(bytes);
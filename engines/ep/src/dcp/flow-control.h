@@ -23,6 +23,7 @@
 #include "atomic.h"
 #include "memcached/engine.h"
 
+#include <platform/processclock.h>
 #include <relaxed_atomic.h>
 
 class DcpConsumer;
@@ -58,6 +59,21 @@ private:
 
     bool isBufferSufficientlyDrained_UNLOCKED(uint32_t ackable_bytes);
 
+    /**
+     * Periodically re-size the flow control buffer from the observed drain
+     * rate. The producer may have up to bufferSize bytes un-acked on the
+     * wire, so the buffer bounds throughput at bufferSize / RTT; sizing it
+     * to hold one second of traffic at the rate this connection actually
+     * drains keeps it comfortably above the bandwidth-delay product of a
+     * high-latency link while shrinking idle connections back towards the
+     * configured minimum. Any change is granted (and bounded) by the
+     * DcpFlowControlManager so the aggregate memory quota still holds, and
+     * is advertised to the producer via a new control message.
+     *
+     * @param justAcked bytes acknowledged by the caller
+     */
+    void maybeAdjustBufSize(uint32_t justAcked);
+
     /* Associated consumer connection handler */
     DcpConsumer* consumerConn;
 
@@ -80,11 +96,24 @@ private:
     /* To keep track of when last buffer ack was sent */
     rel_time_t lastBufferAck;
 
+    /* Current period of the fallback buffer ack, in seconds. Backed off
+       exponentially while the periodic acks are tiny, reset when a
+       substantial ack is sent (guarded by bufferSizeLock) */
+    rel_time_t bufferAckPeriod;
+
     /* Total bytes acked by this connection. This is used to for stats */
     std::atomic<uint64_t> ackedBytes;
 
     /* Bytes processed from the flow control buffer */
     std::atomic<uint64_t> freedBytes;
+
+    /* When the buffer size was last re-evaluated (guarded by
+       bufferSizeLock) */
+    ProcessClock::time_point lastBufSizeAdjust;
+
+    /* Bytes acked since the last buffer size evaluation (guarded by
+       bufferSizeLock) */
+    uint64_t drainedSinceAdjust;
 };
 
 #endif  /* SRC_DCP_FLOW_CONTROL_H_ */
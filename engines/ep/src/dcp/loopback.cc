@@ -0,0 +1,421 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "dcp/loopback.h"
+
+#include "dcp/consumer.h"
+#include "dcp/producer.h"
+#include "item.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * Registry mapping connection cookies onto their loopback link. The
+ * transport callbacks only receive the cookie of the side being
+ * stepped, so this is how they find their way back to the link.
+ */
+static std::mutex linksLock;
+static std::map<const void*, DcpLoopbackLink*> links;
+
+DcpLoopbackLink::DcpLoopbackLink(dcp_producer_t producer,
+                                 dcp_consumer_t consumer)
+    : producer(producer), consumer(consumer) {
+    if (!producer || !consumer) {
+        throw std::invalid_argument(
+                "DcpLoopbackLink: producer and consumer must be non-null");
+    }
+
+    std::memset(&toConsumer, 0, sizeof(toConsumer));
+    toConsumer.stream_end = streamEnd;
+    toConsumer.marker = marker;
+    toConsumer.mutation = mutation;
+    toConsumer.deletion = deletion;
+    toConsumer.expiration = expiration;
+    toConsumer.flush = flush;
+    toConsumer.set_vbucket_state = setVBucketState;
+    toConsumer.noop = noop;
+    toConsumer.system_event = systemEvent;
+
+    std::memset(&toProducer, 0, sizeof(toProducer));
+    toProducer.stream_req = streamReq;
+    toProducer.add_stream_rsp = addStreamRsp;
+    toProducer.marker_rsp = markerRsp;
+    toProducer.set_vbucket_state_rsp = setVBucketStateRsp;
+    toProducer.buffer_acknowledgement = bufferAcknowledgement;
+    toProducer.control = control;
+
+    std::lock_guard<std::mutex> lh(linksLock);
+    if (links.count(producer->getCookie()) ||
+        links.count(consumer->getCookie())) {
+        throw std::invalid_argument(
+                "DcpLoopbackLink: a link is already registered for one "
+                "of the cookies");
+    }
+    links[producer->getCookie()] = this;
+    links[consumer->getCookie()] = this;
+}
+
+DcpLoopbackLink::~DcpLoopbackLink() {
+    std::lock_guard<std::mutex> lh(linksLock);
+    links.erase(producer->getCookie());
+    links.erase(consumer->getCookie());
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::step() {
+    ENGINE_ERROR_CODE cret = stepConsumer();
+    if (cret != ENGINE_SUCCESS && cret != ENGINE_WANT_MORE) {
+        return cret;
+    }
+    ENGINE_ERROR_CODE pret = stepProducer();
+    if (pret != ENGINE_SUCCESS && pret != ENGINE_WANT_MORE) {
+        return pret;
+    }
+    return (cret == ENGINE_WANT_MORE || pret == ENGINE_WANT_MORE)
+                   ? ENGINE_WANT_MORE
+                   : ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::stepProducer() {
+    return producer->step(&toConsumer);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::stepConsumer() {
+    return consumer->step(&toProducer);
+}
+
+DcpLoopbackLink* DcpLoopbackLink::getLink(const void* cookie) {
+    std::lock_guard<std::mutex> lh(linksLock);
+    auto itr = links.find(cookie);
+    if (itr == links.end()) {
+        throw std::logic_error(
+                "DcpLoopbackLink::getLink: no link registered for cookie");
+    }
+    return itr->second;
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::deliverResponse(ConnHandler& peer,
+                                                   uint8_t opcode,
+                                                   uint32_t opaque,
+                                                   uint16_t status,
+                                                   const void* body,
+                                                   uint32_t bodylen) {
+    std::vector<uint8_t> frame(sizeof(protocol_binary_response_header) +
+                               bodylen);
+    auto* header =
+            reinterpret_cast<protocol_binary_response_header*>(frame.data());
+    header->response.magic = uint8_t(PROTOCOL_BINARY_RES);
+    header->response.opcode = opcode;
+    header->response.datatype = PROTOCOL_BINARY_RAW_BYTES;
+    header->response.status = htons(status);
+    header->response.opaque = opaque;
+    header->response.bodylen = htonl(bodylen);
+    if (bodylen > 0) {
+        std::memcpy(frame.data() + sizeof(protocol_binary_response_header),
+                    body,
+                    bodylen);
+    }
+    return peer.handleResponse(header) ? ENGINE_SUCCESS : ENGINE_DISCONNECT;
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::streamEnd(const void* cookie,
+                                             uint32_t opaque,
+                                             uint16_t vbucket,
+                                             uint32_t flags) {
+    return getLink(cookie)->consumer->streamEnd(opaque, vbucket, flags);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::marker(const void* cookie,
+                                          uint32_t opaque,
+                                          uint16_t vbucket,
+                                          uint64_t start_seqno,
+                                          uint64_t end_seqno,
+                                          uint32_t flags) {
+    return getLink(cookie)->consumer->snapshotMarker(
+            opaque, vbucket, start_seqno, end_seqno, flags);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::mutation(const void* cookie,
+                                            uint32_t opaque,
+                                            item* itm,
+                                            uint16_t vbucket,
+                                            uint64_t by_seqno,
+                                            uint64_t rev_seqno,
+                                            uint32_t lock_time,
+                                            const void* meta,
+                                            uint16_t nmeta,
+                                            uint8_t nru,
+                                            uint8_t collection_len) {
+    std::unique_ptr<Item> item(reinterpret_cast<Item*>(itm));
+    return getLink(cookie)->consumer->mutation(
+            opaque,
+            item->getKey(),
+            {reinterpret_cast<const uint8_t*>(item->getData()),
+             item->getNBytes()},
+            0 /* priv_bytes */,
+            item->getDataType(),
+            item->getCas(),
+            vbucket,
+            item->getFlags(),
+            by_seqno,
+            rev_seqno,
+            uint32_t(item->getExptime()),
+            lock_time,
+            {reinterpret_cast<const uint8_t*>(meta), nmeta},
+            nru);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::deletion(const void* cookie,
+                                            uint32_t opaque,
+                                            item* itm,
+                                            uint16_t vbucket,
+                                            uint64_t by_seqno,
+                                            uint64_t rev_seqno,
+                                            const void* meta,
+                                            uint16_t nmeta,
+                                            uint8_t collection_len) {
+    std::unique_ptr<Item> item(reinterpret_cast<Item*>(itm));
+    return getLink(cookie)->consumer->deletion(
+            opaque,
+            item->getKey(),
+            {reinterpret_cast<const uint8_t*>(item->getData()),
+             item->getNBytes()},
+            0 /* priv_bytes */,
+            item->getDataType(),
+            item->getCas(),
+            vbucket,
+            by_seqno,
+            rev_seqno,
+            {reinterpret_cast<const uint8_t*>(meta), nmeta});
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::expiration(const void* cookie,
+                                              uint32_t opaque,
+                                              item* itm,
+                                              uint16_t vbucket,
+                                              uint64_t by_seqno,
+                                              uint64_t rev_seqno,
+                                              const void* meta,
+                                              uint16_t nmeta,
+                                              uint8_t collection_len) {
+    std::unique_ptr<Item> item(reinterpret_cast<Item*>(itm));
+    return getLink(cookie)->consumer->expiration(
+            opaque,
+            item->getKey(),
+            {reinterpret_cast<const uint8_t*>(item->getData()),
+             item->getNBytes()},
+            0 /* priv_bytes */,
+            item->getDataType(),
+            item->getCas(),
+            vbucket,
+            by_seqno,
+            rev_seqno,
+            {reinterpret_cast<const uint8_t*>(meta), nmeta});
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::flush(const void* cookie,
+                                         uint32_t opaque,
+                                         uint16_t vbucket) {
+    return getLink(cookie)->consumer->flush(opaque, vbucket);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::setVBucketState(const void* cookie,
+                                                   uint32_t opaque,
+                                                   uint16_t vbucket,
+                                                   vbucket_state_t state) {
+    return getLink(cookie)->consumer->setVBucketState(opaque, vbucket, state);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::noop(const void* cookie, uint32_t opaque) {
+    auto* link = getLink(cookie);
+    ENGINE_ERROR_CODE ret = link->consumer->noop(opaque);
+    if (ret != ENGINE_SUCCESS) {
+        return ret;
+    }
+    /* On the wire the consumer side acknowledges the noop with a
+     * response packet; deliver the equivalent ack so the producer's
+     * noop timeout logic keeps working. */
+    return deliverResponse(*link->producer,
+                           PROTOCOL_BINARY_CMD_DCP_NOOP,
+                           opaque,
+                           PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                           nullptr,
+                           0);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::systemEvent(const void* cookie,
+                                               uint32_t opaque,
+                                               uint16_t vbucket,
+                                               mcbp::systemevent::id event,
+                                               uint64_t bySeqno,
+                                               cb::const_byte_buffer key,
+                                               cb::const_byte_buffer eventData) {
+    return getLink(cookie)->consumer->systemEvent(
+            opaque, vbucket, event, bySeqno, key, eventData);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::streamReq(const void* cookie,
+                                             uint32_t opaque,
+                                             uint16_t vbucket,
+                                             uint32_t flags,
+                                             uint64_t start_seqno,
+                                             uint64_t end_seqno,
+                                             uint64_t vbucket_uuid,
+                                             uint64_t snap_start_seqno,
+                                             uint64_t snap_end_seqno) {
+    auto* link = getLink(cookie);
+    link->failoverBody.clear();
+
+    uint64_t rollbackSeqno = 0;
+    ENGINE_ERROR_CODE ret = link->producer->streamRequest(flags,
+                                                          opaque,
+                                                          vbucket,
+                                                          start_seqno,
+                                                          end_seqno,
+                                                          vbucket_uuid,
+                                                          snap_start_seqno,
+                                                          snap_end_seqno,
+                                                          &rollbackSeqno,
+                                                          addFailoverLog);
+
+    switch (ret) {
+    case ENGINE_SUCCESS:
+        return deliverResponse(*link->consumer,
+                               PROTOCOL_BINARY_CMD_DCP_STREAM_REQ,
+                               opaque,
+                               PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                               link->failoverBody.data(),
+                               uint32_t(link->failoverBody.size()));
+    case ENGINE_ROLLBACK: {
+        uint64_t seqno = htonll(rollbackSeqno);
+        return deliverResponse(*link->consumer,
+                               PROTOCOL_BINARY_CMD_DCP_STREAM_REQ,
+                               opaque,
+                               PROTOCOL_BINARY_RESPONSE_ROLLBACK,
+                               &seqno,
+                               sizeof(seqno));
+    }
+    case ENGINE_NOT_MY_VBUCKET:
+        return deliverResponse(*link->consumer,
+                               PROTOCOL_BINARY_CMD_DCP_STREAM_REQ,
+                               opaque,
+                               PROTOCOL_BINARY_RESPONSE_NOT_MY_VBUCKET,
+                               nullptr,
+                               0);
+    case ENGINE_KEY_ENOENT:
+        return deliverResponse(*link->consumer,
+                               PROTOCOL_BINARY_CMD_DCP_STREAM_REQ,
+                               opaque,
+                               PROTOCOL_BINARY_RESPONSE_KEY_ENOENT,
+                               nullptr,
+                               0);
+    default:
+        return deliverResponse(*link->consumer,
+                               PROTOCOL_BINARY_CMD_DCP_STREAM_REQ,
+                               opaque,
+                               PROTOCOL_BINARY_RESPONSE_EINTERNAL,
+                               nullptr,
+                               0);
+    }
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::addStreamRsp(const void* cookie,
+                                                uint32_t opaque,
+                                                uint32_t stream_opaque,
+                                                uint8_t status) {
+    /* The add-stream request arrived over the consumer's regular
+     * connection (from the cluster manager), not over the loopback, so
+     * there is no in-process peer to deliver this ack to. */
+    LOG(EXTENSION_LOG_DEBUG,
+        "%s Dropping add stream response (opaque %" PRIu32 ") on the "
+        "loopback transport",
+        getLink(cookie)->consumer->logHeader(),
+        opaque);
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::markerRsp(const void* cookie,
+                                             uint32_t opaque,
+                                             uint8_t status) {
+    auto* link = getLink(cookie);
+    return deliverResponse(*link->producer,
+                           PROTOCOL_BINARY_CMD_DCP_SNAPSHOT_MARKER,
+                           opaque,
+                           status,
+                           nullptr,
+                           0);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::setVBucketStateRsp(const void* cookie,
+                                                      uint32_t opaque,
+                                                      uint8_t status) {
+    auto* link = getLink(cookie);
+    return deliverResponse(*link->producer,
+                           PROTOCOL_BINARY_CMD_DCP_SET_VBUCKET_STATE,
+                           opaque,
+                           status,
+                           nullptr,
+                           0);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::bufferAcknowledgement(const void* cookie,
+                                                         uint32_t opaque,
+                                                         uint16_t vbucket,
+                                                         uint32_t buffer_bytes) {
+    return getLink(cookie)->producer->bufferAcknowledgement(
+            opaque, vbucket, buffer_bytes);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::control(const void* cookie,
+                                           uint32_t opaque,
+                                           const void* key,
+                                           uint16_t nkey,
+                                           const void* value,
+                                           uint32_t nvalue) {
+    auto* link = getLink(cookie);
+    ENGINE_ERROR_CODE ret =
+            link->producer->control(opaque, key, nkey, value, nvalue);
+    return deliverResponse(*link->consumer,
+                           PROTOCOL_BINARY_CMD_DCP_CONTROL,
+                           opaque,
+                           (ret == ENGINE_SUCCESS)
+                                   ? PROTOCOL_BINARY_RESPONSE_SUCCESS
+                                   : PROTOCOL_BINARY_RESPONSE_EINVAL,
+                           nullptr,
+                           0);
+}
+
+ENGINE_ERROR_CODE DcpLoopbackLink::addFailoverLog(vbucket_failover_t* entry,
+                                                  size_t nentries,
+                                                  const void* cookie) {
+    auto* link = getLink(cookie);
+    link->failoverBody.reserve(nentries * sizeof(vbucket_failover_t));
+    for (size_t ii = 0; ii < nentries; ++ii) {
+        uint64_t uuid = htonll(entry[ii].uuid);
+        uint64_t seqno = htonll(entry[ii].seqno);
+        const auto* ubytes = reinterpret_cast<const uint8_t*>(&uuid);
+        const auto* sbytes = reinterpret_cast<const uint8_t*>(&seqno);
+        link->failoverBody.insert(
+                link->failoverBody.end(), ubytes, ubytes + sizeof(uuid));
+        link->failoverBody.insert(
+                link->failoverBody.end(), sbytes, sbytes + sizeof(seqno));
+    }
+    return ENGINE_SUCCESS;
+}
@@ -0,0 +1,214 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include "atomic.h"
+#include "dcp/dcp-types.h"
+
+#include <memcached/engine.h>
+
+#include <vector>
+
+/**
+ * An in-process DCP transport for replication links whose producer and
+ * consumer live in the same process (e.g. a replica vbucket hosted on
+ * the node which also hosts the active copy).
+ *
+ * The normal path for such a link serializes every message through the
+ * MCBP framing in the daemon, a loopback TCP connection and the
+ * corresponding deframing on the consumer side. DcpLoopbackLink skips
+ * all of that: it provides a dcp_message_producers implementation whose
+ * callbacks hand each message straight to the peer's handlers, so a
+ * mutation travels from DcpProducer::getNextItem() to
+ * DcpConsumer::mutation() as an Item pointer and a handful of integers.
+ *
+ * Responses which on the wire would flow back as MCBP response packets
+ * (stream-request failover logs, snapshot marker and set-vbucket-state
+ * acks, noop acks) are synthesized in memory and delivered through the
+ * peer's handleResponse(), so both connections observe the same
+ * protocol they would over TCP.
+ *
+ * The link must be driven by calling step() (typically from the same
+ * notification mechanism which drives regular DCP connections); each
+ * call steps the consumer (stream requests, flow control, control
+ * negotiation) and then the producer (the data path).
+ */
+class DcpLoopbackLink {
+public:
+    /**
+     * Create a link and register both connections' cookies so that the
+     * transport callbacks can find it.
+     *
+     * @param producer the producing end (must outlive the link)
+     * @param consumer the consuming end (must outlive the link)
+     * @throws std::invalid_argument if either connection is null or a
+     *         link is already registered for one of the cookies
+     */
+    DcpLoopbackLink(dcp_producer_t producer, dcp_consumer_t consumer);
+
+    ~DcpLoopbackLink();
+
+    DcpLoopbackLink(const DcpLoopbackLink&) = delete;
+    DcpLoopbackLink& operator=(const DcpLoopbackLink&) = delete;
+
+    /**
+     * Step the consumer and then the producer once.
+     *
+     * @return ENGINE_WANT_MORE if either side has more work queued,
+     *         ENGINE_SUCCESS if both sides are idle, otherwise the
+     *         first error encountered
+     */
+    ENGINE_ERROR_CODE step();
+
+    /// Step just the producing end (data path)
+    ENGINE_ERROR_CODE stepProducer();
+
+    /// Step just the consuming end (control path)
+    ENGINE_ERROR_CODE stepConsumer();
+
+private:
+    /**
+     * Find the link registered for the given connection cookie
+     *
+     * @throws std::logic_error if no link is registered for the cookie
+     */
+    static DcpLoopbackLink* getLink(const void* cookie);
+
+    /**
+     * Synthesize an MCBP response frame and deliver it to the handler,
+     * as the remote peer's acknowledgement would arrive over the wire.
+     *
+     * @return ENGINE_SUCCESS if the handler accepted the response,
+     *         ENGINE_DISCONNECT otherwise
+     */
+    static ENGINE_ERROR_CODE deliverResponse(ConnHandler& peer,
+                                             uint8_t opcode,
+                                             uint32_t opaque,
+                                             uint16_t status,
+                                             const void* body,
+                                             uint32_t bodylen);
+
+    /* Producer -> consumer (invoked by DcpProducer::step) */
+    static ENGINE_ERROR_CODE streamEnd(const void* cookie,
+                                       uint32_t opaque,
+                                       uint16_t vbucket,
+                                       uint32_t flags);
+    static ENGINE_ERROR_CODE marker(const void* cookie,
+                                    uint32_t opaque,
+                                    uint16_t vbucket,
+                                    uint64_t start_seqno,
+                                    uint64_t end_seqno,
+                                    uint32_t flags);
+    static ENGINE_ERROR_CODE mutation(const void* cookie,
+                                      uint32_t opaque,
+                                      item* itm,
+                                      uint16_t vbucket,
+                                      uint64_t by_seqno,
+                                      uint64_t rev_seqno,
+                                      uint32_t lock_time,
+                                      const void* meta,
+                                      uint16_t nmeta,
+                                      uint8_t nru,
+                                      uint8_t collection_len);
+    static ENGINE_ERROR_CODE deletion(const void* cookie,
+                                      uint32_t opaque,
+                                      item* itm,
+                                      uint16_t vbucket,
+                                      uint64_t by_seqno,
+                                      uint64_t rev_seqno,
+                                      const void* meta,
+                                      uint16_t nmeta,
+                                      uint8_t collection_len);
+    static ENGINE_ERROR_CODE expiration(const void* cookie,
+                                        uint32_t opaque,
+                                        item* itm,
+                                        uint16_t vbucket,
+                                        uint64_t by_seqno,
+                                        uint64_t rev_seqno,
+                                        const void* meta,
+                                        uint16_t nmeta,
+                                        uint8_t collection_len);
+    static ENGINE_ERROR_CODE flush(const void* cookie,
+                                   uint32_t opaque,
+                                   uint16_t vbucket);
+    static ENGINE_ERROR_CODE setVBucketState(const void* cookie,
+                                             uint32_t opaque,
+                                             uint16_t vbucket,
+                                             vbucket_state_t state);
+    static ENGINE_ERROR_CODE noop(const void* cookie, uint32_t opaque);
+    static ENGINE_ERROR_CODE systemEvent(const void* cookie,
+                                         uint32_t opaque,
+                                         uint16_t vbucket,
+                                         mcbp::systemevent::id event,
+                                         uint64_t bySeqno,
+                                         cb::const_byte_buffer key,
+                                         cb::const_byte_buffer eventData);
+
+    /* Consumer -> producer (invoked by DcpConsumer::step) */
+    static ENGINE_ERROR_CODE streamReq(const void* cookie,
+                                       uint32_t opaque,
+                                       uint16_t vbucket,
+                                       uint32_t flags,
+                                       uint64_t start_seqno,
+                                       uint64_t end_seqno,
+                                       uint64_t vbucket_uuid,
+                                       uint64_t snap_start_seqno,
+                                       uint64_t snap_end_seqno);
+    static ENGINE_ERROR_CODE addStreamRsp(const void* cookie,
+                                          uint32_t opaque,
+                                          uint32_t stream_opaque,
+                                          uint8_t status);
+    static ENGINE_ERROR_CODE markerRsp(const void* cookie,
+                                       uint32_t opaque,
+                                       uint8_t status);
+    static ENGINE_ERROR_CODE setVBucketStateRsp(const void* cookie,
+                                                uint32_t opaque,
+                                                uint8_t status);
+    static ENGINE_ERROR_CODE bufferAcknowledgement(const void* cookie,
+                                                   uint32_t opaque,
+                                                   uint16_t vbucket,
+                                                   uint32_t buffer_bytes);
+    static ENGINE_ERROR_CODE control(const void* cookie,
+                                     uint32_t opaque,
+                                     const void* key,
+                                     uint16_t nkey,
+                                     const void* value,
+                                     uint32_t nvalue);
+
+    /**
+     * Collects the failover log the producer hands to streamRequest()
+     * into the link's failoverBody, in the network byte order layout
+     * the consumer's response handling expects.
+     */
+    static ENGINE_ERROR_CODE addFailoverLog(vbucket_failover_t* entry,
+                                            size_t nentries,
+                                            const void* cookie);
+
+    dcp_producer_t producer;
+    dcp_consumer_t consumer;
+
+    /// Failover log accumulated during a streamReq call
+    std::vector<uint8_t> failoverBody;
+
+    /// Callback table handed to DcpProducer::step
+    dcp_message_producers toConsumer;
+
+    /// Callback table handed to DcpConsumer::step
+    dcp_message_producers toProducer;
+};
@@ -30,10 +30,15 @@
 #include "snappy-c.h"
 
 #include <memcached/server_api.h>
+#include <algorithm>
 #include <vector>
 
 const std::chrono::seconds DcpProducer::defaultDcpNoopTxInterval(20);
 
+/* Number of items to stream between compression probes while the snappy
+   attempt is being skipped due to a poor running compression ratio */
+static const uint32_t compressionProbePeriod = 64;
+
 DcpProducer::BufferLog::State DcpProducer::BufferLog::getState_UNLOCKED() {
     if (isEnabled_UNLOCKED()) {
         if (isFull_UNLOCKED()) {
@@ -144,6 +149,8 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
       itemsSent(0),
       totalBytesSent(0),
       totalUncompressedDataSize(0),
+      avgCompressionRatio(0.0),
+      itemsSinceCompressionProbe(0),
       includeValue(((flags & DCP_OPEN_NO_VALUE) != 0) ?
               IncludeValue::No : IncludeValue::Yes),
       includeXattrs(((flags & DCP_OPEN_INCLUDE_XATTRS) != 0) ?
@@ -187,6 +194,7 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
     // accident due to the producer and the consumer having a different noop
     // interval.
     noopCtx.dcpNoopTxInterval = defaultDcpNoopTxInterval;
+    noopCtx.currentTxInterval = noopCtx.dcpNoopTxInterval;
     noopCtx.dcpIdleTimeout = std::chrono::seconds(
             engine_.getConfiguration().getDcpIdleTimeout());
     noopCtx.pendingRecv = false;
@@ -194,6 +202,7 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
 
     enableExtMetaData = false;
     enableValueCompression = false;
+    keyOrderBackfill = false;
 
     // Cursor dropping is disabled for replication connections by default,
     // but will be enabled through a control message to support backward
@@ -421,7 +430,7 @@ ENGINE_ERROR_CODE DcpProducer::streamRequest(uint32_t flags,
     }
 
     {
-        ReaderLockHolder rlh(vb->getStateLock());
+        StripedRWLock::ReadHolder rlh(vb->getStateLock());
         if (vb->getState() == vbucket_state_dead) {
             LOG(EXTENSION_LOG_WARNING, "%s (vb %d) Stream request failed because "
                     "this vbucket is in dead state", logHeader(), vbucket);
@@ -543,6 +552,19 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
             return ENGINE_ENOMEM;
         }
 
+        if (!valueProjection.empty()) {
+            /* Cut the value down to just the negotiated paths before any
+               compression is attempted; bytes saved are credited back to
+               the flow control buffer just as compression savings are. */
+            sizeBefore = itmCpy->getNBytes();
+            if (itmCpy->projectValue(valueProjection)) {
+                sizeAfter = itmCpy->getNBytes();
+                if (sizeAfter < sizeBefore) {
+                    log.acknowledge(sizeBefore - sizeAfter);
+                }
+            }
+        }
+
         if (enableValueCompression) {
             /**
              * If value compression is enabled, the producer will need
@@ -551,15 +573,37 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
              * indicates that the value isn't compressed already.
              */
             sizeBefore = itmCpy->getNBytes();
-            if (!itmCpy->compressValue()) {
-                LOG(EXTENSION_LOG_WARNING,
-                    "%s Failed to snappy compress an uncompressed value!",
-                    logHeader());
-            }
-            sizeAfter = itmCpy->getNBytes();
+            sizeAfter = sizeBefore;
+            const float maxUsefulRatio =
+                    engine_.getDcpConnMap().getMinCompressionRatio();
+
+            /* Skip the snappy attempt while this connection's recent values
+               have shown they don't compress below the configured ratio,
+               re-probing periodically in case the data changes shape. */
+            bool attempt = (avgCompressionRatio.load() <= maxUsefulRatio) ||
+                           (++itemsSinceCompressionProbe >=
+                            compressionProbePeriod);
+            if (attempt) {
+                itemsSinceCompressionProbe = 0;
+                if (!itmCpy->compressValue(maxUsefulRatio)) {
+                    LOG(EXTENSION_LOG_WARNING,
+                        "%s Failed to snappy compress an uncompressed value!",
+                        logHeader());
+                }
+                sizeAfter = itmCpy->getNBytes();
+
+                if (sizeAfter < sizeBefore) {
+                    log.acknowledge(sizeBefore - sizeAfter);
+                }
 
-            if (sizeAfter < sizeBefore) {
-                log.acknowledge(sizeBefore - sizeAfter);
+                /* Fold this sample into the running average (EWMA, gain
+                   1/16); an attempt that didn't keep the compressed form
+                   counts as ratio 1.0 */
+                float sample = (sizeBefore && sizeAfter < sizeBefore)
+                                       ? float(sizeAfter) / sizeBefore
+                                       : 1.0f;
+                avgCompressionRatio =
+                        (avgCompressionRatio.load() * 15 + sample) / 16;
             }
 
             if (mcbp::datatype::is_snappy(itmCpy->getDataType())) {
@@ -745,6 +789,38 @@ ENGINE_ERROR_CODE DcpProducer::control(uint32_t opaque, const void* key,
             enableValueCompression = false;
         }
         return ENGINE_SUCCESS;
+    } else if (strncmp(param, "value_projection", nkey) == 0) {
+        /* Comma-separated list of dotted JSON paths; mutation values
+           streamed on this connection are cut down to just those paths.
+           Array subscripts are not supported. */
+        std::vector<std::string> paths;
+        size_t begin = 0;
+        while (begin <= valueStr.size()) {
+            auto end = valueStr.find(',', begin);
+            if (end == std::string::npos) {
+                end = valueStr.size();
+            }
+            std::string path = valueStr.substr(begin, end - begin);
+            if (path.empty() ||
+                path.find_first_of("[]") != std::string::npos) {
+                paths.clear();
+                break;
+            }
+            paths.push_back(std::move(path));
+            begin = end + 1;
+        }
+        if (!paths.empty()) {
+            valueProjection = std::move(paths);
+            return ENGINE_SUCCESS;
+        }
+    } else if (strncmp(param, "backfill_order", nkey) == 0) {
+        if (valueStr == "by_id") {
+            keyOrderBackfill = true;
+            return ENGINE_SUCCESS;
+        } else if (valueStr == "by_seqno") {
+            keyOrderBackfill = false;
+            return ENGINE_SUCCESS;
+        }
     } else if (strncmp(param, "supports_cursor_dropping", nkey) == 0) {
         if (valueStr == "true") {
             supportsCursorDropping = true;
@@ -764,6 +840,7 @@ ENGINE_ERROR_CODE DcpProducer::control(uint32_t opaque, const void* key,
             if (noopInterval % engine_.getConfiguration().
                     getConnectionManagerInterval() == 0) {
                 noopCtx.dcpNoopTxInterval = std::chrono::seconds(noopInterval);
+                noopCtx.currentTxInterval = noopCtx.dcpNoopTxInterval;
                 return ENGINE_SUCCESS;
             } else {
                 LOG(EXTENSION_LOG_WARNING, "%s The ctrl parameter "
@@ -780,14 +857,23 @@ ENGINE_ERROR_CODE DcpProducer::control(uint32_t opaque, const void* key,
         if (valueStr == "high") {
             engine_.setDCPPriority(getCookie(), CONN_PRIORITY_HIGH);
             priority.assign("high");
+            if (backfillMgr) {
+                backfillMgr->setPriority(BackfillPriority::High);
+            }
             return ENGINE_SUCCESS;
         } else if (valueStr == "medium") {
             engine_.setDCPPriority(getCookie(), CONN_PRIORITY_MED);
             priority.assign("medium");
+            if (backfillMgr) {
+                backfillMgr->setPriority(BackfillPriority::Medium);
+            }
             return ENGINE_SUCCESS;
         } else if (valueStr == "low") {
             engine_.setDCPPriority(getCookie(), CONN_PRIORITY_LOW);
             priority.assign("low");
+            if (backfillMgr) {
+                backfillMgr->setPriority(BackfillPriority::Low);
+            }
             return ENGINE_SUCCESS;
         }
     }
@@ -929,9 +1015,15 @@ void DcpProducer::addStats(ADD_STAT add_stat, const void *c) {
     addStat("enable_value_compression",
             enableValueCompression ? "enabled" : "disabled",
             add_stat, c);
+    addStat("value_projection",
+            valueProjection.empty() ? "disabled" : "enabled",
+            add_stat, c);
     addStat("cursor_dropping",
             supportsCursorDropping ? "ELIGIBLE" : "NOT_ELIGIBLE",
             add_stat, c);
+    addStat("backfill_order",
+            keyOrderBackfill ? "by_id" : "by_seqno",
+            add_stat, c);
 
     // Possible that the producer has had its streams closed and hence doesn't
     // have a backfill manager anymore.
@@ -992,6 +1084,12 @@ void DcpProducer::aggregateQueueStats(ConnCounter& aggregator) {
 }
 
 void DcpProducer::notifySeqnoAvailable(uint16_t vbucket, uint64_t seqno) {
+    if (ready.exists(vbucket)) {
+        // The vbucket is already signalled and has not yet been drained by
+        // step(); the pending wakeup happens-after this mutation was queued
+        // so the stream will observe it - no need to signal again.
+        return;
+    }
     auto stream = findStream(vbucket);
     if (stream && stream->isActive()) {
         stream->notifySeqnoAvailable(seqno);
@@ -1186,11 +1284,20 @@ ENGINE_ERROR_CODE DcpProducer::maybeSendNoop(
         // without sending a noop
         return ENGINE_FAILED;
     }
-    std::chrono::seconds elapsedTime(ep_current_time() - noopCtx.sendTime);
+    const rel_time_t lastTx = std::max(noopCtx.sendTime,
+                                       rel_time_t(lastSendTime));
+    if (lastSendTime > noopCtx.sendTime) {
+        // Data has been sent since the last noop, so the connection is
+        // demonstrably alive to the consumer; reset any backoff. The noop
+        // timer is measured from the last send of any kind - data traffic
+        // refreshes the consumer's idle detection just as a noop would.
+        noopCtx.currentTxInterval = noopCtx.dcpNoopTxInterval;
+    }
+    std::chrono::seconds elapsedTime(ep_current_time() - lastTx);
 
     // Check to see if waiting for a noop reply.
     // If not try to send a noop to the consumer if the interval has passed
-    if (!noopCtx.pendingRecv && elapsedTime >= noopCtx.dcpNoopTxInterval) {
+    if (!noopCtx.pendingRecv && elapsedTime >= noopCtx.currentTxInterval) {
         EventuallyPersistentEngine *epe = ObjectRegistry::
                 onSwitchThread(NULL, true);
         ENGINE_ERROR_CODE ret = producers->noop(getCookie(), ++noopCtx.opaque);
@@ -1201,6 +1308,15 @@ ENGINE_ERROR_CODE DcpProducer::maybeSendNoop(
             noopCtx.pendingRecv = true;
             noopCtx.sendTime = ep_current_time();
             lastSendTime = noopCtx.sendTime;
+
+            // This noop fired because the connection was completely quiet
+            // for the whole interval; back the next one off exponentially,
+            // capped at half the idle timeout so neither end's liveness
+            // detection can trip on a healthy connection.
+            noopCtx.currentTxInterval =
+                    std::max(noopCtx.dcpNoopTxInterval,
+                             std::min(noopCtx.currentTxInterval * 2,
+                                      noopCtx.dcpIdleTimeout / 2));
         }
       return ret;
     }
@@ -25,6 +25,8 @@
 #include "connhandler.h"
 #include "dcp/dcp-types.h"
 
+#include <vector>
+
 namespace Collections {
 class Filter;
 }
@@ -146,6 +148,17 @@ public:
         return enableValueCompression;
     }
 
+    /**
+     * True if the client opted in (control "backfill_order=by_id") to
+     * disk backfills running in key order over the by-ID index rather
+     * than in seqno order. Only honoured for disk-only streams starting
+     * at seqno 0; having opted in, the client must not assume items
+     * within a disk snapshot arrive in seqno order.
+     */
+    bool isKeyOrderBackfillEnabled() {
+        return keyOrderBackfill;
+    }
+
     void notifyPaused(bool schedule);
 
     class BufferLog {
@@ -280,6 +293,14 @@ protected:
         uint32_t opaque;
         std::chrono::seconds dcpIdleTimeout;
         std::chrono::seconds dcpNoopTxInterval;
+
+        /* Effective noop interval. Starts at dcpNoopTxInterval and is
+           backed off exponentially (up to half the idle timeout) while
+           the connection stays completely quiet - each noop on a quiet
+           connection is pure control chatter. Reset to the base interval
+           as soon as any data is sent. */
+        std::chrono::seconds currentTxInterval;
+
         Couchbase::RelaxedAtomic<bool> pendingRecv;
         Couchbase::RelaxedAtomic<bool> enabled;
     } noopCtx;
@@ -301,6 +322,16 @@ protected:
     Couchbase::RelaxedAtomic<bool> enableExtMetaData;
     Couchbase::RelaxedAtomic<bool> enableValueCompression;
     Couchbase::RelaxedAtomic<bool> supportsCursorDropping;
+    Couchbase::RelaxedAtomic<bool> keyOrderBackfill;
+
+    /**
+     * Dotted JSON paths (control "value_projection") which mutation
+     * values streamed on this connection are cut down to before being
+     * sent; empty means values are streamed whole. Both the control
+     * message and step() are processed on the connection's thread, so
+     * no locking is required.
+     */
+    std::vector<std::string> valueProjection;
 
     Couchbase::RelaxedAtomic<rel_time_t> lastSendTime;
     BufferLog log;
@@ -321,6 +352,17 @@ protected:
     std::atomic<size_t> totalBytesSent;
     std::atomic<size_t> totalUncompressedDataSize;
 
+    /* Running average (EWMA) of the compression ratio (compressed size /
+       original size) achieved on values recently streamed by this
+       connection. While the average sits above the configured
+       dcp_min_compression_ratio the snappy attempt is skipped - the data
+       has shown it does not compress usefully - and re-probed periodically
+       in case the data changes shape. */
+    Couchbase::RelaxedAtomic<float> avgCompressionRatio;
+
+    /* Items streamed since compression was last attempted while skipping */
+    Couchbase::RelaxedAtomic<uint32_t> itemsSinceCompressionProbe;
+
     ExTask checkpointCreatorTask;
     static const std::chrono::seconds defaultDcpNoopTxInterval;
 
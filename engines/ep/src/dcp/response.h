@@ -369,7 +369,7 @@ public:
                      IncludeXattrs includeXattrs = IncludeXattrs::Yes,
                      ExtendedMetaData *e = NULL)
         : DcpResponse(item->isDeleted() ? Event::Deletion : Event::Mutation, opaque),
-          item_(item),
+          item_(std::move(item)),
           includeValue(includeVal),
           includeXattributes(includeXattrs),
           emd(e) {}
@@ -441,7 +441,7 @@ public:
                              IncludeXattrs includeXattrs,
                              uint8_t _collectionLen,
                              ExtendedMetaData* e = NULL)
-        : MutationResponse(item,
+        : MutationResponse(std::move(item),
                            opaque,
                            includeVal,
                            includeXattrs,
@@ -268,6 +268,9 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
       chkptItemsExtractionInProgress(false),
       includeValue(includeVal),
       includeXattributes(includeXattrs),
+      keyOrderBackfill(p->isKeyOrderBackfillEnabled() &&
+                       (flags & DCP_ADD_STREAM_FLAG_DISKONLY) &&
+                       st_seqno == 0),
       filter(std::move(filter)) {
     const char* type = "";
     if (flags_ & DCP_ADD_STREAM_FLAG_TAKEOVER) {
@@ -275,7 +278,7 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
         end_seqno_ = dcpMaxSeqno;
     }
 
-    ReaderLockHolder rlh(vbucket.getStateLock());
+    StripedRWLock::ReadHolder rlh(vbucket.getStateLock());
     if (vbucket.getState() == vbucket_state_replica) {
         snapshot_info_t info = vbucket.checkpointManager->getSnapshotInfo();
         if (info.range.end > en_seqno) {
@@ -461,6 +464,15 @@ void ActiveStream::markDiskSnapshot(uint64_t startSeqno, uint64_t endSeqno) {
     }
 }
 
+bool ActiveStream::filterAllowsKey(::DocKey key) {
+    if (filter->isPassthrough()) {
+        // Everything is allowed and the filter is immutable, no lock needed
+        return true;
+    }
+    LockHolder lh(streamMutex);
+    return filter->allow(key);
+}
+
 bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
                                     backfill_source_t backfill_source,
                                     bool force) {
@@ -472,7 +484,8 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
         std::unique_lock<std::mutex> lh(streamMutex);
         if (isBackfilling()) {
             queued_item qi(std::move(itm));
-            std::unique_ptr<DcpResponse> resp(makeResponseFromItem(qi));
+            std::unique_ptr<DcpResponse> resp(
+                    makeResponseFromItem(std::move(qi)));
             if (!producer->recordBackfillManagerBytesRead(
                         resp->getApproximateSize(), force)) {
                 // Deleting resp may also delete itm (which is owned by resp)
@@ -482,7 +495,16 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
 
             bufferedBackfill.bytes.fetch_add(resp->getApproximateSize());
             bufferedBackfill.items++;
-            lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
+            if (keyOrderBackfill) {
+                /* A key-order backfill delivers items out of seqno order;
+                   track the highest seqno seen rather than requiring a
+                   monotonic sequence. */
+                if (uint64_t(*resp->getBySeqno()) > lastReadSeqno.load()) {
+                    lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
+                }
+            } else {
+                lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
+            }
 
             pushToReadyQ(std::move(resp));
 
@@ -554,7 +576,7 @@ void ActiveStream::setVBucketStateAckRecieved() {
         /* Order in which the below 3 locks are acquired is important to avoid
            any potential lock inversion problems */
         std::unique_lock<std::mutex> epVbSetLh(engine->getKVBucket()->getVbSetMutexLock());
-        WriterLockHolder vbStateLh(vbucket->getStateLock());
+        StripedRWLock::WriteHolder vbStateLh(vbucket->getStateLock());
         std::unique_lock<std::mutex> lh(streamMutex);
         if (isTakeoverWait()) {
             if (takeoverState == vbucket_state_pending) {
@@ -966,11 +988,11 @@ void ActiveStream::getOutstandingItems(VBucketPtr &vb,
 }
 
 std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
-        queued_item& item) {
+        queued_item item) {
     if (item->getOperation() != queue_op::system_event) {
         auto cKey = Collections::DocKey::make(item->getKey(), currentSeparator);
         return std::make_unique<MutationProducerResponse>(
-                item,
+                std::move(item),
                 opaque_,
                 includeValue,
                 includeXattributes,
@@ -992,7 +1014,10 @@ void ActiveStream::processItems(std::vector<queued_item>& items) {
             if (SystemEventReplicate::process(*qi) == ProcessStatus::Continue) {
                 curChkSeqno = qi->getBySeqno();
                 lastReadSeqnoUnSnapshotted = qi->getBySeqno();
-                mutations.push_back(makeResponseFromItem(qi));
+                // The item is finished with here; move our reference into
+                // the response so each item is touched exactly once on its
+                // way from checkpoint to readyQ.
+                mutations.push_back(makeResponseFromItem(std::move(qi)));
             } else if (qi->getOperation() == queue_op::checkpoint_start) {
                 /* if there are already other mutations, then they belong to the
                    previous checkpoint and hence we must create a snapshot and
@@ -1986,26 +2011,44 @@ ENGINE_ERROR_CODE PassiveStream::messageReceived(std::unique_ptr<DcpResponse> dc
 process_items_error_t PassiveStream::processBufferedMessages(uint32_t& processed_bytes,
                                                              size_t batchSize) {
     std::unique_lock<std::mutex> lh(buffer.bufMutex);
-    uint32_t count = 0;
     uint32_t message_bytes = 0;
     uint32_t total_bytes_processed = 0;
     bool failed = false, noMem = false;
 
-    while (count < batchSize && !buffer.messages.empty()) {
+    // Drain up to batchSize messages from the buffer in one go, so the
+    // buffer lock is acquired once per batch rather than twice per message.
+    // The messages are processed outside the lock - a lock inversion exists
+    // with connManager if we hold it while processing.
+    std::deque<std::unique_ptr<DcpResponse>> batch;
+    while (batch.size() < batchSize && !buffer.messages.empty()) {
+        batch.push_back(buffer.pop_front(lh));
+    }
+    lh.unlock();
+
+    // Fold runs of small memory snapshots into one marker so the snapshot
+    // bookkeeping is updated once per run; the dropped markers' bytes
+    // still count as processed for flow control.
+    total_bytes_processed += coalesceSnapshotMarkers(batch);
+
+    while (!batch.empty()) {
         ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
         /* If the stream is in dead state we should not process any remaining
            items in the buffer, we should rather clear them */
         if (!isActive()) {
+            /* The batch was already removed from the buffer; its bytes have
+               been processed (dropped) as far as flow control is concerned */
+            for (const auto& message : batch) {
+                total_bytes_processed += message->getMessageSize();
+            }
+            batch.clear();
+            lh.lock();
             total_bytes_processed += clearBuffer_UNLOCKED();
             processed_bytes = total_bytes_processed;
             return all_processed;
         }
 
-        std::unique_ptr<DcpResponse> response = buffer.pop_front(lh);
-
-        // Release bufMutex whilst we attempt to process the message
-        // a lock inversion exists with connManager if we hold this.
-        lh.unlock();
+        std::unique_ptr<DcpResponse> response = std::move(batch.front());
+        batch.pop_front();
 
         message_bytes = response->getMessageSize();
 
@@ -2051,19 +2094,22 @@ process_items_error_t PassiveStream::processBufferedMessages(uint32_t& processed
             }
         }
 
-        // Re-acquire bufMutex so that
-        // 1) we can update the buffer
-        // 2) safely re-check the while conditional statement
-        lh.lock();
-
-        // If we failed and the stream is not dead, stash the DcpResponse at the
-        // front of the queue and break the loop.
+        // If we failed and the stream is not dead, stash the failed
+        // DcpResponse and the unprocessed remainder of the batch back at the
+        // front of the queue (in their original order, under a single lock
+        // hold) and break the loop.
         if (failed && isActive()) {
+            lh.lock();
+            while (!batch.empty()) {
+                std::unique_ptr<DcpResponse> message = std::move(batch.back());
+                batch.pop_back();
+                buffer.push_front(std::move(message), lh);
+            }
             buffer.push_front(std::move(response), lh);
+            lh.unlock();
             break;
         }
 
-        count++;
         if (ret != ENGINE_ERANGE) {
             total_bytes_processed += message_bytes;
         }
@@ -2317,6 +2363,66 @@ ENGINE_ERROR_CODE PassiveStream::processSeparatorChanged(
     return ENGINE_SUCCESS;
 }
 
+uint32_t PassiveStream::coalesceSnapshotMarkers(
+        std::deque<std::unique_ptr<DcpResponse>>& batch) {
+    uint32_t droppedBytes = 0;
+
+    for (size_t ii = 0; ii < batch.size(); ++ii) {
+        if (batch[ii]->getEvent() != DcpResponse::Event::SnapshotMarker) {
+            continue;
+        }
+        auto* first = static_cast<SnapshotMarker*>(batch[ii].get());
+        if (first->getFlags() & (MARKER_FLAG_ACK | MARKER_FLAG_DISK)) {
+            // Folding later snapshots into an ack-requesting marker would
+            // delay its acknowledgement, and folding memory snapshots
+            // into a disk one would mis-type their items; leave these
+            // alone.
+            continue;
+        }
+
+        // Scan forward over the items of this snapshot; a follow-on
+        // marker without CHK/DISK/ACK flags would only extend the open
+        // checkpoint's snapshot range, so fold its end seqno into this
+        // marker and drop it.
+        uint64_t mergedEnd = first->getEndSeqno();
+        bool merged = false;
+        size_t jj = ii + 1;
+        while (jj < batch.size()) {
+            const auto event = batch[jj]->getEvent();
+            if (event == DcpResponse::Event::Mutation ||
+                event == DcpResponse::Event::Deletion ||
+                event == DcpResponse::Event::Expiration) {
+                ++jj;
+                continue;
+            }
+            if (event != DcpResponse::Event::SnapshotMarker) {
+                break;
+            }
+            auto* next = static_cast<SnapshotMarker*>(batch[jj].get());
+            if (next->getFlags() &
+                (MARKER_FLAG_CHK | MARKER_FLAG_DISK | MARKER_FLAG_ACK)) {
+                break;
+            }
+            mergedEnd = next->getEndSeqno();
+            droppedBytes += batch[jj]->getMessageSize();
+            batch.erase(batch.begin() + jj);
+            merged = true;
+        }
+
+        if (merged) {
+            batch[ii] = std::make_unique<SnapshotMarker>(first->getOpaque(),
+                                                         vb_,
+                                                         first->getStartSeqno(),
+                                                         mergedEnd,
+                                                         first->getFlags());
+        }
+        // Continue the outer scan from the last item examined.
+        ii = jj - 1;
+    }
+
+    return droppedBytes;
+}
+
 void PassiveStream::processMarker(SnapshotMarker* marker) {
     VBucketPtr vb = engine->getVBucket(vb_);
 
@@ -27,8 +27,10 @@
 #include "response.h"
 #include "vbucket.h"
 
+#include <algorithm>
 #include <atomic>
 #include <climits>
+#include <deque>
 #include <queue>
 
 class EventuallyPersistentEngine;
@@ -301,11 +303,29 @@ public:
                (includeXattributes == IncludeXattrs::No);
     }
 
+    /// @return true if the disk backfill for this stream runs in key order
+    /// over the by-ID index rather than in seqno order.
+    bool isKeyOrderBackfill() const {
+        return keyOrderBackfill;
+    }
+
     /// @returns a copy of the current collections separator.
     std::string getCurrentSeparator() const {
         return currentSeparator;
     }
 
+    /**
+     * Does the stream's collections filter allow the key? Used by the disk
+     * backfill's cache-lookup phase to drop filtered items before paying
+     * for the read of their value. Must not be called with keys in the
+     * System namespace (system events have their own rules, see
+     * queueResponse).
+     *
+     * Takes the streamMutex (except for passthrough filters); calls into
+     * the filter must be serialised.
+     */
+    bool filterAllowsKey(::DocKey key);
+
 protected:
     // Returns the outstanding items for the stream's checkpoint cursor.
     void getOutstandingItems(VBucketPtr &vb, std::vector<queued_item> &items);
@@ -322,7 +342,13 @@ protected:
      * @return a DcpResponse to represent the item. This will be either a
      *         MutationResponse or SystemEventProducerMessage.
      */
-    std::unique_ptr<DcpResponse> makeResponseFromItem(queued_item& item);
+    /**
+     * Create a DcpResponse message to send to the replica from the given
+     * item. Takes the item by value so that callers which have finished
+     * with their reference can move it into the response, avoiding any
+     * refcount churn on the handoff from checkpoint to stream.
+     */
+    std::unique_ptr<DcpResponse> makeResponseFromItem(queued_item item);
 
     /* The transitionState function is protected (as opposed to private) for
      * testing purposes.
@@ -483,6 +509,12 @@ private:
     // (if any exist)
     IncludeXattrs includeXattributes;
 
+    /* True if the disk backfill should run in key order over the by-ID
+       index instead of seqno order. Set only when the client opted in via
+       the backfill_order control and the stream is disk-only from seqno 0,
+       so no in-memory phase or cursor ever depends on seqno ordering. */
+    const bool keyOrderBackfill;
+
     /**
      * A copy of the collections separator so we can generate MutationResponse
      * instances that embed the collection/document-name data so we can
@@ -535,7 +567,7 @@ private:
         LockHolder lh(workQueueLock);
         if (!queue.empty()) {
             rval = queue.front();
-            queue.pop();
+            queue.pop_front();
             queuedVbuckets.erase(rval->getVBucket());
         }
         return rval;
@@ -548,9 +580,31 @@ private:
 
     void pushUnique(const stream_t& stream) {
         LockHolder lh(workQueueLock);
+        /* Streams draining the tail of a takeover jump the queue: every
+           batch they wait for extends the window in which the vbucket is
+           unavailable during rebalance, while steady-state streams merely
+           see added latency. */
+        const bool urgent = stream->isTakeoverSend();
         if (queuedVbuckets.count(stream->getVBucket()) == 0) {
-            queue.push(stream);
+            if (urgent) {
+                queue.push_front(stream);
+            } else {
+                queue.push_back(stream);
+            }
             queuedVbuckets.insert(stream->getVBucket());
+        } else if (urgent) {
+            /* Already queued (possibly before entering takeover); move it
+               to the front so it is processed next. */
+            auto itr = std::find_if(queue.begin(),
+                                    queue.end(),
+                                    [&stream](const stream_t& s) {
+                                        return s->getVBucket() ==
+                                               stream->getVBucket();
+                                    });
+            if (itr != queue.end() && itr != queue.begin()) {
+                queue.erase(itr);
+                queue.push_front(stream);
+            }
         }
     }
 
@@ -558,9 +612,10 @@ private:
 
     /**
      * Maintain a queue of unique stream_t
-     * There's no need to have the same stream in the queue more than once
+     * There's no need to have the same stream in the queue more than once.
+     * Takeover streams are pushed to the front, all others to the back.
      */
-    std::queue<stream_t> queue;
+    std::deque<stream_t> queue;
     std::set<uint16_t> queuedVbuckets;
 
     std::atomic<bool> notified;
@@ -695,6 +750,22 @@ protected:
 
     void processMarker(SnapshotMarker* marker);
 
+    /**
+     * Coalesce runs of memory snapshot markers within a drained batch.
+     *
+     * A follow-on marker carrying none of the CHK/DISK/ACK flags would
+     * only extend the open checkpoint's snapshot range, so it is folded
+     * into the preceding marker of its run and dropped from the batch.
+     * The snapshot bookkeeping (and any vbucket state persisted from it)
+     * is then updated once per run rather than once per small snapshot.
+     *
+     * @param batch the drained messages, modified in place.
+     * @return the message bytes of any dropped markers (the caller must
+     *         still account them as processed for flow control).
+     */
+    uint32_t coalesceSnapshotMarkers(
+            std::deque<std::unique_ptr<DcpResponse>>& batch);
+
     void processSetVBucketState(SetVBucketState* state);
 
     uint32_t clearBuffer_UNLOCKED();
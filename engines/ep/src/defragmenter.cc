@@ -33,6 +33,21 @@ DefragmenterTask::DefragmenterTask(EventuallyPersistentEngine* e,
 bool DefragmenterTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "DefragmenterTask");
     if (engine->getConfiguration().isDefragmenterEnabled()) {
+        // Ask the latency pacer how much of our nominal chunk budget the
+        // front-end can currently afford; skip the chunk entirely if
+        // operation latency is badly degraded.
+        auto& pacer = engine->getKVBucket()->getLatencyPacer();
+        const auto chunkDuration =
+                pacer.paceChunkDuration(getChunkDuration());
+        if (chunkDuration == std::chrono::milliseconds::zero()) {
+            LOG(EXTENSION_LOG_INFO,
+                "%s backing off - front-end latency pressure %.2f",
+                to_string(getDescription()).c_str(),
+                pacer.getPressure());
+            snooze(LatencyPacer::backoffSleep);
+            return !engine->getEpStats().isShutdown;
+        }
+
         ALLOCATOR_HOOKS_API* alloc_hooks = engine->getServerApi()->alloc_hooks;
         // Get our pause/resume visitor. If we didn't finish the previous pass,
         // then resume from where we last were, otherwise create a new visitor
@@ -40,7 +55,9 @@ bool DefragmenterTask::run(void) {
         if (!prAdapter) {
             prAdapter = std::make_unique<PauseResumeVBAdapter>(
                     std::make_unique<DefragmentVisitor>(
-                            getAgeThreshold(), getMaxValueSize(alloc_hooks)));
+                            getAgeThreshold(),
+                            getMaxValueSize(alloc_hooks),
+                            getSizeClassEligibility(alloc_hooks)));
             epstore_position = engine->getKVBucket()->startPosition();
         }
 
@@ -54,7 +71,7 @@ bool DefragmenterTask::run(void) {
             ss << " resuming from " << epstore_position << ", ";
             ss << prAdapter->getHashtablePosition() << ".";
         }
-        ss << " Using chunk_duration=" << getChunkDuration().count() << " ms."
+        ss << " Using chunk_duration=" << chunkDuration.count() << " ms."
            << " mem_used=" << stats.getTotalMemoryUsed()
            << ", mapped_bytes=" << getMappedBytes();
         LOG(EXTENSION_LOG_INFO, "%s", ss.str().c_str());
@@ -66,7 +83,7 @@ bool DefragmenterTask::run(void) {
         // Prepare the underlying visitor.
         auto& visitor = getDefragVisitor();
         const auto start = ProcessClock::now();
-        const auto deadline = start + getChunkDuration();
+        const auto deadline = start + chunkDuration;
         visitor.setDeadline(deadline);
         visitor.clearStats();
 
@@ -167,6 +184,71 @@ size_t DefragmenterTask::getMaxValueSize(ALLOCATOR_HOOKS_API* alloc_hooks) {
     return largest_bin_size;
 }
 
+size_t DefragmenterTask::getUtilizationFloor() const {
+    return engine->getConfiguration().getDefragmenterUtilizationFloor();
+}
+
+std::vector<std::pair<size_t, bool>> DefragmenterTask::getSizeClassEligibility(
+        ALLOCATOR_HOOKS_API* alloc_hooks) const {
+    std::vector<std::pair<size_t, bool>> bins;
+    const size_t floor = getUtilizationFloor();
+    if (floor == 0) {
+        return bins;
+    }
+
+    // The allocator caches its statistics; get_allocator_stats forces a
+    // refresh so the per-bin reads below see the current occupancy.
+    allocator_stats astats = {0};
+    astats.ext_stats.resize(alloc_hooks->get_extra_stats_size());
+    alloc_hooks->get_allocator_stats(&astats);
+
+    size_t nbins{0};
+    alloc_hooks->get_allocator_property("arenas.nbins", &nbins);
+
+    for (size_t bin = 0; bin < nbins; bin++) {
+        char buff[64];
+
+        // Note: the daemon configures jemalloc with a single arena
+        // (narenas:1) so arena 0's statistics cover the whole heap.
+        size_t bin_size{0};
+        size_t run_size{0};
+        size_t curregs{0};
+        size_t curruns{0};
+        snprintf(buff, sizeof(buff),
+                 "arenas.bin.%" PRIu64 ".size", static_cast<uint64_t>(bin));
+        alloc_hooks->get_allocator_property(buff, &bin_size);
+        snprintf(buff, sizeof(buff),
+                 "arenas.bin.%" PRIu64 ".run_size",
+                 static_cast<uint64_t>(bin));
+        alloc_hooks->get_allocator_property(buff, &run_size);
+        snprintf(buff, sizeof(buff),
+                 "stats.arenas.0.bins.%" PRIu64 ".curregs",
+                 static_cast<uint64_t>(bin));
+        alloc_hooks->get_allocator_property(buff, &curregs);
+        snprintf(buff, sizeof(buff),
+                 "stats.arenas.0.bins.%" PRIu64 ".curruns",
+                 static_cast<uint64_t>(bin));
+        alloc_hooks->get_allocator_property(buff, &curruns);
+
+        if (bin_size == 0 || run_size == 0) {
+            // Statistics unavailable (e.g. non-jemalloc allocator, or stats
+            // disabled) - fall back to defragmenting all size classes.
+            bins.clear();
+            return bins;
+        }
+
+        // A bin with no runs holds no memory, so there is nothing to
+        // recover by reallocating into it.
+        // Otherwise the bin is worth defragmenting when the bytes in live
+        // regions are below `floor` percent of the bytes backing its runs.
+        const bool eligible = (curruns > 0) &&
+                              (curregs * bin_size * 100 <
+                               floor * curruns * run_size);
+        bins.emplace_back(bin_size, eligible);
+    }
+    return bins;
+}
+
 std::chrono::milliseconds DefragmenterTask::getChunkDuration() const {
     return std::chrono::milliseconds(
             engine->getConfiguration().getDefragmenterChunkDuration());
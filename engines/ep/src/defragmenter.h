@@ -23,6 +23,9 @@
 #include "globaltask.h"
 #include "kv_bucket_iface.h"
 
+#include <utility>
+#include <vector>
+
 class DefragmentVisitor;
 class EPStats;
 class PauseResumeVBAdapter;
@@ -88,6 +91,12 @@ class PauseResumeVBAdapter;
  * 2. Document size - Skip documents which are larger than the largest
  *    size class, or are zero-sized.
  *
+ * 3. Size class utilization - at the start of each pass, query the
+ *    allocator's per-size-class statistics and skip documents belonging to
+ *    size classes whose slab utilization is at or above
+ *    defragmenter_utilization_floor; their pages are well packed and
+ *    reallocating values within them cannot recover memory.
+ *
  * An additional policy consideration is how to locate
  * candidate documents. In a large instance, the simple act of
  * visiting each element in the HashTable is a expensive operation -
@@ -127,6 +136,21 @@ private:
     // being paused.
     std::chrono::milliseconds getChunkDuration() const;
 
+    // Slab utilization (percent) below which a size class is considered
+    // fragmented. 0 means defragment all size classes.
+    size_t getUtilizationFloor() const;
+
+    /**
+     * Query the allocator's per-size-class (bin) statistics and return,
+     * ordered by ascending bin size, whether each bin's slab utilization is
+     * below the configured floor (and hence worth spending reallocations
+     * on). Returns an empty vector - meaning all size classes are eligible -
+     * if the floor is 0 or the statistics are unavailable (e.g. non-jemalloc
+     * build).
+     */
+    std::vector<std::pair<size_t, bool>> getSizeClassEligibility(
+            ALLOCATOR_HOOKS_API* alloc_hooks) const;
+
     /// Return the current number of mapped bytes from the allocator.
     size_t getMappedBytes();
 
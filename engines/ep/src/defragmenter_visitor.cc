@@ -17,12 +17,17 @@
 
 #include "defragmenter_visitor.h"
 
+#include <algorithm>
+
 // DegragmentVisitor implementation ///////////////////////////////////////////
 
-DefragmentVisitor::DefragmentVisitor(uint8_t age_threshold_,
-                                     size_t max_size_class)
+DefragmentVisitor::DefragmentVisitor(
+        uint8_t age_threshold_,
+        size_t max_size_class,
+        std::vector<std::pair<size_t, bool>> size_class_eligible_)
     : max_size_class(max_size_class),
       age_threshold(age_threshold_),
+      size_class_eligible(std::move(size_class_eligible_)),
       defrag_count(0),
       visited_count(0) {
 }
@@ -42,7 +47,8 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     // and no larger than the biggest size class the allocator
     // supports, so it can be successfully reallocated to a run with other
     // objects of the same size.
-    if (value_len > 0 && value_len <= max_size_class) {
+    if (value_len > 0 && value_len <= max_size_class &&
+        isSizeClassEligible(value_len)) {
         // If sufficiently old and if it looks like nothing else holds a
         // reference to the blob reallocate, otherwise increment it's age.
         // It may be possible to add a reference to the blob without holding
@@ -63,6 +69,23 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     return progressTracker.shouldContinueVisiting(visited_count);
 }
 
+bool DefragmentVisitor::isSizeClassEligible(size_t size) const {
+    if (size_class_eligible.empty()) {
+        return true;
+    }
+    // The value's size class is the smallest bin whose size is >= size.
+    auto it = std::lower_bound(size_class_eligible.begin(),
+                               size_class_eligible.end(),
+                               size,
+                               [](const std::pair<size_t, bool>& bin,
+                                  size_t sz) { return bin.first < sz; });
+    if (it == size_class_eligible.end()) {
+        // Larger than any bin we have statistics for - don't skip it.
+        return true;
+    }
+    return it->second;
+}
+
 void DefragmentVisitor::clearStats() {
     defrag_count = 0;
     visited_count = 0;
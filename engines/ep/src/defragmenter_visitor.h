@@ -23,13 +23,30 @@
 #include "progress_tracker.h"
 #include "vb_visitors.h"
 
+#include <utility>
+#include <vector>
+
 /**
  * Defragmentation visitor - visit all objects in a VBucket, and defragment
  * any which have reached the specified age.
  */
 class DefragmentVisitor : public VBucketAwareHTVisitor {
 public:
-    DefragmentVisitor(uint8_t age_threshold_, size_t max_size_class);
+    /**
+     * @param age_threshold_ how old (in defragmenter passes) a blob must be
+     *        to be considered for defragmentation.
+     * @param max_size_class size of the largest size class from the
+     *        allocator; larger values cannot usefully be moved.
+     * @param size_class_eligible_ per-size-class defragment decisions -
+     *        (bin size, defragment?) pairs ordered by ascending bin size.
+     *        Values are only reallocated if their size class's flag is set.
+     *        An empty vector (the default) means defragment all size
+     *        classes.
+     */
+    DefragmentVisitor(uint8_t age_threshold_,
+                      size_t max_size_class,
+                      std::vector<std::pair<size_t, bool>> size_class_eligible_ =
+                              {});
 
     ~DefragmentVisitor();
 
@@ -49,6 +66,10 @@ public:
     size_t getVisitedCount() const;
 
 private:
+    // Returns true if a value of the given size belongs to a size class
+    // which should be defragmented.
+    bool isSizeClassEligible(size_t size) const;
+
     /* Configuration parameters */
 
     // Size of the largest size class from the allocator.
@@ -57,6 +78,9 @@ private:
     // How old a blob must be to consider it for defragmentation.
     const uint8_t age_threshold;
 
+    // Per-size-class defragment decisions (see constructor).
+    const std::vector<std::pair<size_t, bool>> size_class_eligible;
+
     /* Runtime state */
 
     // Estimates how far we have got, and when we should pause.
@@ -24,6 +24,7 @@
 #include "failover-table.h"
 #include "flusher.h"
 #include "replicationthrottle.h"
+#include "shutdown_snapshot.h"
 #include "tasks.h"
 
 /**
@@ -154,13 +155,36 @@ public:
     }
 
     void callback(Item& it, time_t& startTime) {
-        if (epstore.compactionCanExpireItems()) {
-            epstore.deleteExpiredItem(it, startTime, ExpireBy::Compactor);
+        if (!epstore.compactionCanExpireItems()) {
+            return;
+        }
+        // Accumulate expired documents and hand them to the engine in
+        // batches; processing them one at a time pays the vbucket lookup
+        // and state lock per key, which stalls the front-end when
+        // compacting TTL-heavy vbuckets.
+        batch.push_back(it);
+        if (batch.size() >= expiryBatchSize) {
+            flush();
+        }
+    }
+
+    /// Expire any accumulated documents. Must be called once compaction
+    /// has visited the last document to drain the final partial batch.
+    void flush() {
+        if (!batch.empty()) {
+            epstore.deleteExpiredItems(batch, ExpireBy::Compactor);
+            batch.clear();
         }
     }
 
 private:
+    /// Number of expired documents handed to the engine per call. Large
+    /// enough to amortize the per-batch locking, small enough that the
+    /// copies held here stay a negligible fraction of the quota.
+    static const size_t expiryBatchSize = 50;
+
     KVBucket& epstore;
+    std::list<Item> batch;
 };
 
 EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
@@ -196,6 +220,40 @@ void EPBucket::deinitialize() {
     stopBgFetcher();
 
     KVBucket::deinitialize();
+
+    // All writers are now quiesced; snapshot each vbucket's bloom filter
+    // so the next warmup can restore it instead of rebuilding from a key
+    // scan (only trusted after a clean shutdown - see
+    // Warmup::createVBuckets).
+    persistVBucketFilters();
+
+    // Likewise serialise the HashTable metadata of each fully-persisted
+    // vbucket so the next warmup can restore it directly instead of
+    // re-scanning every data file (see ShutdownSnapshot).
+    if (!stats.forceShutdown &&
+        engine.getConfiguration().isWarmupShutdownSnapshot() &&
+        getItemEvictionPolicy() == VALUE_ONLY) {
+        ShutdownSnapshot snapshot(engine.getConfiguration().getDbname());
+        snapshot.write(*this);
+    } else {
+        ShutdownSnapshot::remove(engine.getConfiguration().getDbname());
+    }
+}
+
+void EPBucket::persistVBucketFilters() {
+    if (!engine.getConfiguration().isBfilterEnabled()) {
+        return;
+    }
+    for (VBucketMap::id_type vbid = 0; vbid < vbMap.getSize(); ++vbid) {
+        VBucketPtr vb = vbMap.getBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+        const std::string filterData = vb->serializeFilter();
+        if (!filterData.empty()) {
+            getRWUnderlying(vbid)->saveBloomFilter(vbid, filterData);
+        }
+    }
 }
 
 void EPBucket::reset() {
@@ -349,7 +407,7 @@ void EPBucket::compactInternal(compaction_ctx* ctx) {
     BloomFilterCBPtr filter(new BloomFilterCallback(*this));
     ctx->bloomFilterCallback = filter;
 
-    ExpiredItemsCBPtr expiry(new ExpiredItemsCallback(*this));
+    auto expiry = std::make_shared<ExpiredItemsCallback>(*this);
     ctx->expiryCallback = expiry;
 
     ctx->collectionsEraser = std::bind(&KVBucket::collectionsEraseKey,
@@ -362,6 +420,9 @@ void EPBucket::compactInternal(compaction_ctx* ctx) {
     KVStore* store = shard->getRWUnderlying();
     bool result = store->compactDB(ctx);
 
+    // Expire any final partial batch accumulated by the callback.
+    expiry->flush();
+
     Configuration& config = getEPEngine().getConfiguration();
     /* Iterate over all the vbucket ids set in max_purged_seq map. If there is
      * an entry
@@ -378,6 +439,13 @@ void EPBucket::compactInternal(compaction_ctx* ctx) {
 
         if (config.isBfilterEnabled() && result) {
             vb->swapFilter();
+            // Persist the rebuilt filter alongside the compacted file so a
+            // subsequent warmup can restore it rather than serving
+            // filterless until the next compaction.
+            const std::string filterData = vb->serializeFilter();
+            if (!filterData.empty()) {
+                store->saveBloomFilter(vbid, filterData);
+            }
         } else {
             vb->clearFilter();
         }
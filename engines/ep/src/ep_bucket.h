@@ -131,6 +131,13 @@ protected:
      */
     void compactInternal(compaction_ctx* ctx);
 
+    /**
+     * Persist every vbucket's bloom filter into its data file, so the
+     * next warmup can restore them. Called at shutdown once all writers
+     * have been stopped.
+     */
+    void persistVBucketFilters();
+
     /**
      * Remove completed compaction tasks or wake snoozed tasks
      *
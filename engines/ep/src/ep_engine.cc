@@ -33,6 +33,7 @@
 #include "failover-table.h"
 #include "flusher.h"
 #include "htresizer.h"
+#include "hugepage_allocator.h"
 #include "logger.h"
 #include "memory_tracker.h"
 #include "replicationthrottle.h"
@@ -54,14 +55,17 @@
 #include <platform/make_unique.h>
 #include <platform/platform.h>
 #include <platform/processclock.h>
+#include <platform/sysinfo.h>
 #include <xattr/utils.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <mutex>
 #include <stdarg.h>
 #include <string>
@@ -592,6 +596,8 @@ protocol_binary_response_status EventuallyPersistentEngine::setFlushParam(
         } else if (strcmp(keyz, "fsync_after_every_n_bytes_written") == 0) {
             getConfiguration().setFsyncAfterEveryNBytesWritten(
                     std::stoull(valz));
+        } else if (strcmp(keyz, "compression_mode") == 0) {
+            getConfiguration().setCompressionMode(valz);
         } else if (strcmp(keyz, "xattr_enabled") == 0) {
             getConfiguration().setXattrEnabled(cb_stob(valz));
         } else {
@@ -935,40 +941,93 @@ static ENGINE_ERROR_CODE delVBucket(EventuallyPersistentEngine* e,
                         cookie);
 }
 
+/**
+ * Read a key from a replica vbucket.
+ *
+ * The request may carry a single byte of extras holding request flags;
+ * the only flag defined is 0x01 ("include failover token"). When set,
+ * the response extras grow from the usual 4 byte item flags to:
+ *
+ *   4 byte item flags
+ *   8 byte vbucket UUID (network order)
+ *   8 byte vbucket high seqno (network order)
+ *
+ * The UUID / seqno pair names the point in history the replica had
+ * applied when the read was served; comparing it against the failover
+ * log of the active copy lets the client detect a read from a branch of
+ * history which was (or is about to be) rolled back. Both fields are
+ * published atomically by their owners (the failover table its latest
+ * UUID, the checkpoint manager the high seqno), so the token is built
+ * from plain loads after the value fetch - no extra locking over a
+ * plain get. A failover racing with the read can only make the token
+ * newer than the value, which errs on the side of flagging the read as
+ * stale.
+ */
 static ENGINE_ERROR_CODE getReplicaCmd(EventuallyPersistentEngine* e,
                                        protocol_binary_request_header* request,
                                        const void* cookie,
-                                       Item** it,
-                                       const char** msg,
-                                       protocol_binary_response_status* res,
+                                       ADD_RESPONSE response,
                                        DocNamespace docNamespace) {
     KVBucketIface* kvb = e->getKVBucket();
     protocol_binary_request_no_extras* req =
         (protocol_binary_request_no_extras*)request;
     int keylen = ntohs(req->message.header.request.keylen);
+    uint8_t extlen = req->message.header.request.extlen;
     uint16_t vbucket = ntohs(req->message.header.request.vbucket);
-    ENGINE_ERROR_CODE error_code;
-    DocKey key(reinterpret_cast<const uint8_t*>(request) + sizeof(*request),
+
+    bool wantToken = false;
+    if (extlen == 1) {
+        const uint8_t reqFlags =
+                *(reinterpret_cast<const uint8_t*>(request) + sizeof(*request));
+        wantToken = (reqFlags & 0x01) != 0;
+    } else if (extlen != 0) {
+        e->setErrorContext(cookie, "Extras must be a single flag byte");
+        return sendResponse(response, NULL, 0, NULL, 0, NULL, 0,
+                            PROTOCOL_BINARY_RAW_BYTES,
+                            PROTOCOL_BINARY_RESPONSE_EINVAL, 0, cookie);
+    }
+
+    DocKey key(reinterpret_cast<const uint8_t*>(request) + sizeof(*request) +
+                       extlen,
                keylen, docNamespace);
 
     GetValue rv(kvb->getReplica(key, vbucket, cookie));
+    ENGINE_ERROR_CODE error_code = rv.getStatus();
 
-    if ((error_code = rv.getStatus()) != ENGINE_SUCCESS) {
-        if (error_code == ENGINE_NOT_MY_VBUCKET) {
-            *res = PROTOCOL_BINARY_RESPONSE_NOT_MY_VBUCKET;
-            return error_code;
-        } else if (error_code == ENGINE_TMPFAIL) {
-            *msg = "NOT_FOUND";
-            *res = PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
-        } else {
-            return error_code;
+    if (error_code == ENGINE_TMPFAIL) {
+        ++(e->getEpStats().numOpsGet);
+        const char* msg = "NOT_FOUND";
+        return sendResponse(response, NULL, 0, NULL, 0, msg,
+                            static_cast<uint16_t>(strlen(msg)),
+                            PROTOCOL_BINARY_RAW_BYTES,
+                            PROTOCOL_BINARY_RESPONSE_KEY_ENOENT, 0, cookie);
+    } else if (error_code != ENGINE_SUCCESS) {
+        return error_code;
+    }
+
+    uint32_t flags = rv.item->getFlags();
+    std::string extras(reinterpret_cast<const char*>(&flags), sizeof(flags));
+    if (wantToken) {
+        VBucketPtr vb = kvb->getVBucket(vbucket);
+        if (!vb) {
+            return ENGINE_NOT_MY_VBUCKET;
         }
-    } else {
-        *it = rv.item.release();
-        *res = PROTOCOL_BINARY_RESPONSE_SUCCESS;
+        uint64_t uuid = htonll(vb->failovers->getLatestUUID());
+        uint64_t seqno = htonll(static_cast<uint64_t>(vb->getHighSeqno()));
+        extras.append(reinterpret_cast<const char*>(&uuid), sizeof(uuid));
+        extras.append(reinterpret_cast<const char*>(&seqno), sizeof(seqno));
     }
+
     ++(e->getEpStats().numOpsGet);
-    return ENGINE_SUCCESS;
+    return sendResponse(response,
+                        static_cast<const void*>(rv.item->getKey().data()),
+                        rv.item->getKey().size(),
+                        extras.data(),
+                        static_cast<uint8_t>(extras.size()),
+                        static_cast<const void*>(rv.item->getData()),
+                        rv.item->getNBytes(), rv.item->getDataType(),
+                        PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                        rv.item->getCas(), cookie);
 }
 
 static ENGINE_ERROR_CODE compactDB(EventuallyPersistentEngine* e,
@@ -1078,7 +1137,6 @@ static ENGINE_ERROR_CODE processUnknownCommand(
     std::string dynamic_msg;
     const char* msg = NULL;
     size_t msg_size = 0;
-    Item* itm = NULL;
 
     EPStats& stats = h->getEpStats();
     ENGINE_ERROR_CODE rv = ENGINE_SUCCESS;
@@ -1152,6 +1210,10 @@ static ENGINE_ERROR_CODE processUnknownCommand(
         break;
     case PROTOCOL_BINARY_CMD_OBSERVE:
         return h->observe(cookie, request, response, docNamespace);
+    case PROTOCOL_BINARY_CMD_MULTI_GET:
+        return h->multiGet(cookie, request, response, docNamespace);
+    case PROTOCOL_BINARY_CMD_MULTI_SET_WITH_META:
+        return h->multiSetWithMeta(cookie, request, response, docNamespace);
     case PROTOCOL_BINARY_CMD_OBSERVE_SEQNO:
         return h->observe_seqno(cookie, request, response);
     case PROTOCOL_BINARY_CMD_LAST_CLOSED_CHECKPOINT:
@@ -1189,11 +1251,7 @@ static ENGINE_ERROR_CODE processUnknownCommand(
                              docNamespace);
     }
     case PROTOCOL_BINARY_CMD_GET_REPLICA:
-        rv = getReplicaCmd(h, request, cookie, &itm, &msg, &res, docNamespace);
-        if (rv != ENGINE_SUCCESS && rv != ENGINE_NOT_MY_VBUCKET) {
-            return rv;
-        }
-        break;
+        return getReplicaCmd(h, request, cookie, response, docNamespace);
     case PROTOCOL_BINARY_CMD_ENABLE_TRAFFIC:
     case PROTOCOL_BINARY_CMD_DISABLE_TRAFFIC: {
         rv = h->handleTrafficControlCmd(cookie, request, response);
@@ -1233,27 +1291,12 @@ static ENGINE_ERROR_CODE processUnknownCommand(
     }
     }
 
-    if (itm) {
-        uint32_t flags = itm->getFlags();
-        rv = sendResponse(response,
-                          static_cast<const void*>(itm->getKey().data()),
-                          itm->getKey().size(),
-                          (const void*)&flags, sizeof(uint32_t),
-                          static_cast<const void*>(itm->getData()),
-                          itm->getNBytes(), itm->getDataType(),
-                          static_cast<uint16_t>(res), itm->getCas(),
-                          cookie);
-        delete itm;
-    } else if (rv == ENGINE_NOT_MY_VBUCKET) {
-        return rv;
-    } else {
-        msg_size = (msg_size > 0 || msg == NULL) ? msg_size : strlen(msg);
-        rv = sendResponse(response, NULL, 0, NULL, 0,
-                          msg, static_cast<uint16_t>(msg_size),
-                          PROTOCOL_BINARY_RAW_BYTES,
-                          static_cast<uint16_t>(res), 0, cookie);
+    msg_size = (msg_size > 0 || msg == NULL) ? msg_size : strlen(msg);
+    rv = sendResponse(response, NULL, 0, NULL, 0,
+                      msg, static_cast<uint16_t>(msg_size),
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      static_cast<uint16_t>(res), 0, cookie);
 
-    }
     return rv;
 }
 
@@ -1834,6 +1877,12 @@ public:
             engine.setDeleteAll(value);
         }
     }
+
+    virtual void stringValueChanged(const std::string& key, const char* value) {
+        if (key.compare("compression_mode") == 0) {
+            engine.setCompressionMode(value);
+        }
+    }
 private:
     EventuallyPersistentEngine &engine;
 };
@@ -1910,8 +1959,28 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
     configuration.addValueChangedListener("flushall_enabled",
                                        new EpEngineValueChangeListener(*this));
 
+    setCompressionMode(configuration.getCompressionMode());
+    configuration.addValueChangedListener("compression_mode",
+                                       new EpEngineValueChangeListener(*this));
+
+    size_t numShards = configuration.getMaxNumShards();
+    if (numShards == 0) {
+        // Auto-select the shard count from the core count - one shard per
+        // two logical cores, bounded below by the old fixed default of 4
+        // and above by 64. Larger machines get more (hence smaller) shards,
+        // which shrinks the set of vbuckets (and their memory) each
+        // Flusher / BgFetcher pass walks, without creating an excessive
+        // number of per-shard tasks on small machines.
+        const size_t numCPU = Couchbase::get_available_cpu_count();
+        numShards = std::min(size_t{64}, std::max(size_t{4}, numCPU / 2));
+        // Write the resolved value back; KVStoreConfig, KVBucket and
+        // Warmup read the shard count directly from the configuration.
+        configuration.setMaxNumShards(numShards);
+    }
+
     workload = new WorkLoadPolicy(configuration.getMaxNumWorkers(),
-                                  configuration.getMaxNumShards());
+                                  numShards,
+                                  configuration.getExecutorShares());
     if ((unsigned int)workload->getNumShards() >
                                               configuration.getMaxVbuckets()) {
         LOG(EXTENSION_LOG_WARNING, "Invalid configuration: Shards must be "
@@ -2221,6 +2290,19 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::store_if(
         ENGINE_STORE_OPERATION operation,
         cb::StoreIfPredicate predicate) {
     BlockTimer timer(&stats.storeCmdHisto);
+
+    if (isCompressionActive() && item.getNBytes() > 0 &&
+        !mcbp::datatype::is_snappy(item.getDataType())) {
+        // Active compression mode: keep the value compressed in memory
+        // even though the client sent it uncompressed. Every read path
+        // already copes with snappy values in the HashTable (the
+        // daemon's get/gat/subdoc contexts and DCP inflate on demand,
+        // and only for consumers which can't take compressed bytes).
+        // On failure (or a useless compression ratio) the value is
+        // simply stored as received.
+        item.compressValue();
+    }
+
     ENGINE_ERROR_CODE status;
     switch (operation) {
     case OPERATION_CAS:
@@ -2402,6 +2484,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
 
     add_casted_stat("ep_persist_vbstate_total",
                     epstats.totalPersistVBState, add_stat, cookie);
+    add_casted_stat("ep_persist_vbstate_deferred",
+                    epstats.totalDeferredVBStatePersist, add_stat, cookie);
 
     size_t memUsed =  stats.getTotalMemoryUsed();
     add_casted_stat("mem_used", memUsed, add_stat, cookie);
@@ -2451,6 +2535,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_items_rm_from_checkpoints",
                     epstats.itemsRemovedFromCheckpoints,
                     add_stat, cookie);
+    add_casted_stat("ep_items_expelled_from_checkpoints",
+                    epstats.itemsExpelledFromCheckpoints,
+                    add_stat, cookie);
     add_casted_stat("ep_num_value_ejects", epstats.numValueEjects,
                     add_stat, cookie);
     add_casted_stat("ep_num_eject_failures", epstats.numFailedEjects,
@@ -2458,6 +2545,13 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_num_not_my_vbuckets", epstats.numNotMyVBuckets,
                     add_stat, cookie);
 
+    add_casted_stat("ep_replication_throttle_apply_ratio",
+                    getReplicationThrottle().getApplyRatio(),
+                    add_stat, cookie);
+    add_casted_stat("ep_replication_throttled",
+                    getReplicationThrottle().getNumThrottled(),
+                    add_stat, cookie);
+
     add_casted_stat("ep_pending_ops", epstats.pendingOps, add_stat, cookie);
     add_casted_stat("ep_pending_ops_total", epstats.pendingOpsTotal,
                     add_stat, cookie);
@@ -2706,6 +2800,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(const void *cookie,
     add_casted_stat("ep_storedval_num", stats.numStoredVal, add_stat, cookie);
     add_casted_stat("ep_item_num", stats.numItem, add_stat, cookie);
 
+    add_casted_stat("ep_hugepage_bytes_requested",
+                    HugePageAllocatorBase::getBytesRequested(),
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_hugepage_bytes_advised",
+                    HugePageAllocatorBase::getBytesAdvised(),
+                    add_stat,
+                    cookie);
+
     std::map<std::string, size_t> alloc_stats;
     MemoryTracker::getInstance(*getServerApiFunc()->alloc_hooks)->
         getAllocatorStats(alloc_stats);
@@ -2814,8 +2917,20 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doHashStats(const void *cookie,
                     error.what());
             }
 
-            HashTableDepthStatVisitor depthVisitor;
-            vb->ht.visitDepth(depthVisitor);
+            // Read the incrementally-maintained depth statistics - a
+            // constant-time operation, where this previously visited
+            // every item in the table.
+            const auto depthStats = vb->ht.getDepthStats();
+
+            Histogram<unsigned int> depthHisto(
+                    GrowingWidthGenerator<unsigned int>(1, 1, 1.3), 10);
+            size_t counted = 0;
+            for (size_t d = 0; d < depthStats.bucketsAtDepth.size(); ++d) {
+                if (depthStats.bucketsAtDepth[d] > 0) {
+                    depthHisto.add(d, depthStats.bucketsAtDepth[d]);
+                    counted += d * depthStats.bucketsAtDepth[d];
+                }
+            }
 
             try {
                 checked_snprintf(buf, sizeof(buf), "vb_%d:size", vbid);
@@ -2823,25 +2938,23 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doHashStats(const void *cookie,
                 checked_snprintf(buf, sizeof(buf), "vb_%d:locks", vbid);
                 add_casted_stat(buf, vb->ht.getNumLocks(), add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:min_depth", vbid);
-                add_casted_stat(buf,
-                                depthVisitor.min == -1 ? 0 : depthVisitor.min,
-                                add_stat, cookie);
+                add_casted_stat(buf, depthStats.minDepth, add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:max_depth", vbid);
-                add_casted_stat(buf, depthVisitor.max, add_stat, cookie);
+                add_casted_stat(buf, depthStats.maxDepth, add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:histo", vbid);
-                add_casted_stat(buf, depthVisitor.depthHisto, add_stat, cookie);
+                add_casted_stat(buf, depthHisto, add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:reported", vbid);
                 add_casted_stat(buf, vb->ht.getNumInMemoryItems(), add_stat,
                                 cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:counted", vbid);
-                add_casted_stat(buf, depthVisitor.size, add_stat, cookie);
+                add_casted_stat(buf, counted, add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:resized", vbid);
                 add_casted_stat(buf, vb->ht.getNumResizes(), add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:mem_size", vbid);
                 add_casted_stat(buf, vb->ht.getItemMemory(), add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:mem_size_counted",
                                  vbid);
-                add_casted_stat(buf, depthVisitor.memUsed, add_stat, cookie);
+                add_casted_stat(buf, vb->ht.getItemMemory(), add_stat, cookie);
             } catch (std::exception& error) {
                 LOG(EXTENSION_LOG_WARNING,
                     "StatVBucketVisitor::visitBucket: Failed to build stat: %s",
@@ -3293,6 +3406,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
                     add_stat, cookie);
     add_casted_stat("bg_batch_size", stats.getMultiBatchSizeHisto, add_stat,
                     cookie);
+    add_casted_stat("bg_herd_size", stats.bgHerdSizeHisto, add_stat, cookie);
 
     // Checkpoint cursor stats
     add_casted_stat("persistence_cursor_get_all_items",
@@ -3331,6 +3445,76 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doRunTimeStats(const void
     return ENGINE_SUCCESS;
 }
 
+/**
+ * Approximate the value at a given percentile of a histogram by walking
+ * its bins; returns the upper bound of the bin the quantile falls in (or
+ * the bin's lower bound for the open-ended final bin).
+ */
+static std::chrono::microseconds::rep histoValueAtPercentile(
+        const MicrosecondHistogram& histo, double pcnt) {
+    uint64_t total = 0;
+    for (auto it = histo.begin(); it != histo.end(); ++it) {
+        total += (*it)->count();
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t target =
+            std::max(uint64_t(1), uint64_t((pcnt / 100.0) * total));
+    uint64_t seen = 0;
+    std::chrono::microseconds::rep value = 0;
+    for (auto it = histo.begin(); it != histo.end(); ++it) {
+        if ((*it)->count() == 0) {
+            continue;
+        }
+        seen += (*it)->count();
+        if ((*it)->end() == std::chrono::microseconds::max()) {
+            value = (*it)->start().count();
+        } else {
+            value = (*it)->end().count();
+        }
+        if (seen >= target) {
+            break;
+        }
+    }
+    return value;
+}
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doSchedulerProfileStats(
+        const void* cookie, ADD_STAT add_stat) {
+    const std::pair<const char*, double> percentiles[] = {{"p50", 50.0},
+                                                          {"p90", 90.0},
+                                                          {"p99", 99.0},
+                                                          {"p999", 99.9},
+                                                          {"max", 100.0}};
+    try {
+        char statname[80] = {0};
+        for (TaskId id : GlobalTask::allTaskIds) {
+            const char* name = GlobalTask::getTaskName(id);
+            const auto& wait = stats.schedulingHisto[static_cast<int>(id)];
+            const auto& run = stats.taskRuntimeHisto[static_cast<int>(id)];
+            for (const auto& pcnt : percentiles) {
+                checked_snprintf(statname, sizeof(statname), "%s:wait:%s",
+                                 name, pcnt.first);
+                add_casted_stat(statname,
+                                histoValueAtPercentile(wait, pcnt.second),
+                                add_stat, cookie);
+                checked_snprintf(statname, sizeof(statname), "%s:run:%s",
+                                 name, pcnt.first);
+                add_casted_stat(statname,
+                                histoValueAtPercentile(run, pcnt.second),
+                                add_stat, cookie);
+            }
+        }
+    } catch (std::exception& error) {
+        LOG(EXTENSION_LOG_WARNING,
+            "doSchedulerProfileStats: Error building stats: %s", error.what());
+    }
+
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doDispatcherStats(const void
                                                                 *cookie,
                                                                 ADD_STAT
@@ -3400,6 +3584,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(const void
                          "ep_workload:num_sleepers");
         add_casted_stat(statname, numSleepers, add_stat, cookie);
 
+        checked_snprintf(statname, sizeof(statname), "ep_workload:shares");
+        add_casted_stat(statname, workload->getShares(), add_stat, cookie);
+
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:charged_run_time");
+        add_casted_stat(statname, workload->getChargedRunTime(), add_stat,
+                        cookie);
+
         expool->doTaskQStat(ObjectRegistry::getCurrentEngine(),
                             cookie, add_stat);
 
@@ -3581,6 +3773,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         rv = doSchedulerStats(cookie, add_stat);
     } else if (statKey == "runtimes") {
         rv = doRunTimeStats(cookie, add_stat);
+    } else if (statKey == "scheduler-profile") {
+        rv = doSchedulerProfileStats(cookie, add_stat);
     } else if (statKey == "memory") {
         rv = doMemoryStats(cookie, add_stat);
     } else if (statKey == "uuid") {
@@ -3618,6 +3812,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
     } else if (statKey == "kvstore") {
         getKVBucket()->addKVStoreStats(add_stat, cookie);
         rv = ENGINE_SUCCESS;
+    } else if (statKey == "kvstore-detail") {
+        getKVBucket()->addKVStoreDetailStats(add_stat, cookie);
+        rv = ENGINE_SUCCESS;
     } else if (statKey == "warmup") {
         const auto* warmup = getKVBucket()->getWarmup();
         if (warmup != nullptr) {
@@ -3679,6 +3876,11 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         // @todo MB-24546 For development, just log everything.
         kvBucket->getCollectionsManager().logAll(*kvBucket.get());
         rv = ENGINE_SUCCESS;
+    } else if (statKey == "collections-details" &&
+               configuration.isCollectionsPrototypeEnabled()) {
+        kvBucket->getCollectionsManager().addStats(
+                *kvBucket.get(), cookie, add_stat);
+        rv = ENGINE_SUCCESS;
     }
 
     return rv;
@@ -3785,6 +3987,131 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::observe(
                         cookie);
 }
 
+/**
+ * Map the engine code of an individual batched get onto the status
+ * returned for its response entry. EWOULDBLOCK becomes ETMPFAIL as the
+ * batch never blocks; the caller re-fetches such keys with a regular
+ * get (which may then schedule a background fetch).
+ */
+static protocol_binary_response_status getMultiStatus(ENGINE_ERROR_CODE rv) {
+    switch (rv) {
+    case ENGINE_SUCCESS:
+        return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    case ENGINE_KEY_ENOENT:
+        return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+    case ENGINE_NOT_MY_VBUCKET:
+        return PROTOCOL_BINARY_RESPONSE_NOT_MY_VBUCKET;
+    case ENGINE_EWOULDBLOCK:
+        return PROTOCOL_BINARY_RESPONSE_ETMPFAIL;
+    case ENGINE_UNKNOWN_COLLECTION:
+        return PROTOCOL_BINARY_RESPONSE_UNKNOWN_COLLECTION;
+    default:
+        return PROTOCOL_BINARY_RESPONSE_EINTERNAL;
+    }
+}
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::multiGet(
+                                       const void* cookie,
+                                       protocol_binary_request_header *request,
+                                       ADD_RESPONSE response,
+                                       DocNamespace docNamespace) {
+    protocol_binary_request_no_extras *req =
+        (protocol_binary_request_no_extras*)request;
+
+    size_t offset = 0;
+    const uint8_t* data = req->bytes + sizeof(req->bytes);
+    uint32_t data_len = ntohl(req->message.header.request.bodylen);
+
+    // Group the requested keys by vbucket so that KVBucket::getMulti can
+    // amortize the per-vbucket costs across each group, remembering the
+    // request order so the response can be emitted in the same order.
+    std::map<uint16_t, std::vector<std::pair<StoredDocKey, GetValue>>> groups;
+    std::vector<std::pair<uint16_t, size_t>> order;
+
+    while (offset < data_len) {
+        uint16_t vb_id;
+        uint16_t keylen;
+
+        // Parse a key
+        if (data_len - offset < 4) {
+            setErrorContext(cookie, "Requires vbid and keylen.");
+            return sendResponse(response, NULL, 0, 0, 0, NULL, 0,
+                                PROTOCOL_BINARY_RAW_BYTES,
+                                PROTOCOL_BINARY_RESPONSE_EINVAL, 0,
+                                cookie);
+        }
+
+        memcpy(&vb_id, data + offset, sizeof(uint16_t));
+        vb_id = ntohs(vb_id);
+        offset += sizeof(uint16_t);
+
+        memcpy(&keylen, data + offset, sizeof(uint16_t));
+        keylen = ntohs(keylen);
+        offset += sizeof(uint16_t);
+
+        if (keylen == 0 || data_len - offset < keylen) {
+            setErrorContext(cookie, "Incorrect keylen");
+            return sendResponse(response, NULL, 0, 0, 0, NULL, 0,
+                                PROTOCOL_BINARY_RAW_BYTES,
+                                PROTOCOL_BINARY_RESPONSE_EINVAL, 0,
+                                cookie);
+        }
+
+        auto& group = groups[vb_id];
+        group.emplace_back(StoredDocKey(data + offset, keylen, docNamespace),
+                           GetValue());
+        order.emplace_back(vb_id, group.size() - 1);
+        offset += keylen;
+    }
+
+    for (auto& group : groups) {
+        kvBucket->getMulti(group.first, cookie, group.second);
+    }
+
+    // Build the response in request order. Each entry carries:
+    //   vbucket id (2 bytes), keylen (2 bytes), status (2 bytes),
+    //   datatype (1 byte), flags (4 bytes), cas (8 bytes),
+    //   value length (4 bytes), the key and then the value.
+    std::stringstream result;
+    for (const auto& entry : order) {
+        auto& fetch = groups[entry.first][entry.second];
+        const StoredDocKey& key = fetch.first;
+        const GetValue& gv = fetch.second;
+
+        uint16_t vb_id = htons(entry.first);
+        uint16_t keylen = htons(uint16_t(key.size()));
+        uint16_t status = htons(getMultiStatus(gv.getStatus()));
+        uint8_t datatype = PROTOCOL_BINARY_RAW_BYTES;
+        uint32_t flags = 0;
+        uint64_t cas = 0;
+        uint32_t vallen = 0;
+        if (gv.getStatus() == ENGINE_SUCCESS) {
+            datatype = gv.item->getDataType();
+            flags = gv.item->getFlags();
+            cas = htonll(gv.item->getCas());
+            vallen = htonl(gv.item->getNBytes());
+        }
+
+        result.write((char*) &vb_id, sizeof(uint16_t));
+        result.write((char*) &keylen, sizeof(uint16_t));
+        result.write((char*) &status, sizeof(uint16_t));
+        result.write((char*) &datatype, sizeof(uint8_t));
+        result.write((char*) &flags, sizeof(uint32_t));
+        result.write((char*) &cas, sizeof(uint64_t));
+        result.write((char*) &vallen, sizeof(uint32_t));
+        result.write(reinterpret_cast<const char*>(key.data()), key.size());
+        if (gv.getStatus() == ENGINE_SUCCESS) {
+            result.write(gv.item->getData(), gv.item->getNBytes());
+        }
+    }
+
+    return sendResponse(response, NULL, 0, 0, 0, result.str().data(),
+                        result.str().length(),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
+                        cookie);
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::observe_seqno(
                                        const void* cookie,
                                        protocol_binary_request_header *request,
@@ -3814,7 +4141,38 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::observe_seqno(
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    if (vb_uuid == vb->failovers->getLatestUUID()) {
+        // Fast path: the client is polling on the current branch of
+        // history - the overwhelmingly common case for durability checks.
+        // Every field of the response is published atomically (the flusher
+        // advances the persistence seqno, the checkpoint manager the high
+        // seqno and the failover table its latest UUID), so the response
+        // can be built from plain loads without taking the vbucket state
+        // lock or the failover table lock.
+        if (vb->getState() == vbucket_state_dead) {
+            return ENGINE_NOT_MY_VBUCKET;
+        }
+
+        format_type = 0;
+        last_persisted_seqno = htonll(vb->getPublicPersistenceSeqno());
+        current_seqno = htonll(vb->getHighSeqno());
+        vb_id = htons(vb_id);
+        vb_uuid = htonll(vb_uuid);
+
+        result.write((char*) &format_type, sizeof(uint8_t));
+        result.write((char*) &vb_id, sizeof(uint16_t));
+        result.write((char*) &vb_uuid, sizeof(uint64_t));
+        result.write((char*) &last_persisted_seqno, sizeof(uint64_t));
+        result.write((char*) &current_seqno, sizeof(uint64_t));
+
+        return sendResponse(response, NULL, 0, 0, 0, result.str().data(),
+                            result.str().length(),
+                            PROTOCOL_BINARY_RAW_BYTES,
+                            PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
+                            cookie);
+    }
+
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         return ENGINE_NOT_MY_VBUCKET;
     }
@@ -4403,6 +4761,170 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
     return ret;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::multiSetWithMeta(
+                                       const void* cookie,
+                                       protocol_binary_request_header *request,
+                                       ADD_RESPONSE response,
+                                       DocNamespace docNamespace) {
+    if (isDegradedMode()) {
+        return sendErrorResponse(response,
+                                 PROTOCOL_BINARY_RESPONSE_ETMPFAIL,
+                                 0,
+                                 cookie);
+    }
+
+    protocol_binary_request_no_extras *req =
+        (protocol_binary_request_no_extras*)request;
+
+    const uint16_t vbucket = ntohs(req->message.header.request.vbucket);
+    size_t offset = 0;
+    const uint8_t* data = req->bytes + sizeof(req->bytes);
+    uint32_t data_len = ntohl(req->message.header.request.bodylen);
+
+    // Each entry carries keylen (2 bytes), vallen (4 bytes), datatype
+    // (1 byte), flags (4 bytes), exptime (4 bytes), revSeqno (8 bytes)
+    // and cas (8 bytes), followed by the key and then the value.
+    const size_t entryHeader = 31;
+
+    std::vector<std::pair<std::unique_ptr<Item>, ENGINE_ERROR_CODE>> mutations;
+
+    const auto startTime = ProcessClock::now();
+
+    while (offset < data_len) {
+        uint16_t keylen;
+        uint32_t vallen;
+        uint8_t datatype;
+        uint32_t flags;
+        uint32_t exptime;
+        uint64_t revSeqno;
+        uint64_t cas;
+
+        // Parse an entry
+        if (data_len - offset < entryHeader) {
+            setErrorContext(cookie, "Truncated mutation entry.");
+            return sendErrorResponse(response,
+                                     PROTOCOL_BINARY_RESPONSE_EINVAL,
+                                     0,
+                                     cookie);
+        }
+
+        memcpy(&keylen, data + offset, sizeof(uint16_t));
+        keylen = ntohs(keylen);
+        offset += sizeof(uint16_t);
+
+        memcpy(&vallen, data + offset, sizeof(uint32_t));
+        vallen = ntohl(vallen);
+        offset += sizeof(uint32_t);
+
+        datatype = data[offset];
+        offset += sizeof(uint8_t);
+
+        // Flags are stored as-is from the wire, as for setWithMeta
+        memcpy(&flags, data + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+
+        memcpy(&exptime, data + offset, sizeof(uint32_t));
+        exptime = ntohl(exptime);
+        offset += sizeof(uint32_t);
+
+        memcpy(&revSeqno, data + offset, sizeof(uint64_t));
+        revSeqno = ntohll(revSeqno);
+        offset += sizeof(uint64_t);
+
+        memcpy(&cas, data + offset, sizeof(uint64_t));
+        cas = ntohll(cas);
+        offset += sizeof(uint64_t);
+
+        if (keylen == 0 || data_len - offset < size_t(keylen) + vallen) {
+            setErrorContext(cookie, "Incorrect keylen or vallen");
+            return sendErrorResponse(response,
+                                     PROTOCOL_BINARY_RESPONSE_EINVAL,
+                                     0,
+                                     cookie);
+        }
+
+        if (vallen > maxItemSize) {
+            LOG(EXTENSION_LOG_WARNING,
+                "Item value size %u for multiSetWithMeta is bigger "
+                "than the max size %" PRIu64 " allowed!!!\n",
+                vallen, uint64_t(maxItemSize));
+            mutations.emplace_back(nullptr, ENGINE_E2BIG);
+            offset += size_t(keylen) + vallen;
+            continue;
+        }
+
+        DocKey docKey(data + offset, keylen, docNamespace);
+        const uint8_t* value = data + offset + keylen;
+        datatype = checkForDatatypeJson(
+                cookie,
+                datatype,
+                {reinterpret_cast<const char*>(value), vallen});
+
+        try {
+            auto item = std::make_unique<Item>(docKey,
+                                               flags,
+                                               time_t(exptime),
+                                               value,
+                                               vallen,
+                                               datatype,
+                                               cas,
+                                               -1,
+                                               vbucket);
+            item->setRevSeqno(revSeqno);
+            mutations.emplace_back(std::move(item), ENGINE_FAILED);
+        } catch (const std::bad_alloc&) {
+            return sendErrorResponse(response,
+                                     PROTOCOL_BINARY_RESPONSE_ENOMEM,
+                                     0,
+                                     cookie);
+        }
+        offset += size_t(keylen) + vallen;
+    }
+
+    // Apply the batch with the XDCR defaults: conflict resolution on,
+    // updates of existing documents permitted, CAS carried through
+    // unchanged.
+    ENGINE_ERROR_CODE ret = kvBucket->setWithMetaBatch(
+            vbucket,
+            mutations,
+            cookie,
+            {vbucket_state_active},
+            CheckConflicts::Yes,
+            true /*allowExisting*/);
+
+    if (ret == ENGINE_EWOULDBLOCK || ret == ENGINE_NOT_MY_VBUCKET) {
+        return ret;
+    } else if (ret != ENGINE_SUCCESS) {
+        return sendErrorResponse(
+                response,
+                serverApi->cookie->engine_error2mcbp(cookie, ret),
+                0,
+                cookie);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            ProcessClock::now() - startTime);
+    stats.setWithMetaHisto.add(elapsed);
+
+    // One status (2 bytes) per entry, in request order.
+    std::stringstream result;
+    for (const auto& mutation : mutations) {
+        if (mutation.second == ENGINE_SUCCESS) {
+            ++stats.numOpsSetMeta;
+        }
+        uint16_t status = htons(
+                serverApi->cookie->engine_error2mcbp(cookie,
+                                                     mutation.second));
+        result.write((char*) &status, sizeof(uint16_t));
+    }
+
+    return sendResponse(response, NULL, 0, 0, 0, result.str().data(),
+                        result.str().length(),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
+                        cookie);
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
                              const void* cookie,
                              protocol_binary_request_delete_with_meta *request,
@@ -4804,11 +5326,25 @@ EventuallyPersistentEngine::returnMeta(const void* cookie,
  */
 class AllKeysCallback : public Callback<const DocKey&> {
 public:
-    AllKeysCallback() {
+    /**
+     * @param filterPrefix if non-empty only keys beginning with this prefix
+     *        (i.e. keys of one collection, prefix includes the separator)
+     *        are returned.
+     */
+    AllKeysCallback(std::string filterPrefix)
+        : filterPrefix(std::move(filterPrefix)) {
         buffer.reserve((avgKeySize + sizeof(uint16_t)) * expNumKeys);
     }
 
     void callback(const DocKey& key) {
+        if (!filterPrefix.empty() &&
+            (key.size() < filterPrefix.size() ||
+             std::memcmp(key.data(),
+                         filterPrefix.data(),
+                         filterPrefix.size()) != 0)) {
+            // Key is not part of the requested collection
+            return;
+        }
         if (buffer.size() + key.size() + sizeof(uint16_t) >
             buffer.size()) {
             // Reserve the 2x space for the copy-to buffer.
@@ -4827,6 +5363,7 @@ public:
 
 private:
     std::vector<char> buffer;
+    std::string filterPrefix;
 
     static const int avgKeySize = 32;
     static const int expNumKeys = 1000;
@@ -4843,8 +5380,10 @@ public:
                      const void* c,
                      ADD_RESPONSE resp,
                      const DocKey start_key_,
+                     const DocKey end_key_,
                      uint16_t vbucket,
-                     uint32_t count_)
+                     uint32_t count_,
+                     std::string filterPrefix_)
         : GlobalTask(e, TaskId::FetchAllKeysTask, 0, false),
           engine(e),
           cookie(c),
@@ -4852,8 +5391,10 @@ public:
                       std::to_string(vbucket)),
           response(resp),
           start_key(start_key_),
+          end_key(end_key_),
           vbid(vbucket),
-          count(count_) {
+          count(count_),
+          filterPrefix(std::move(filterPrefix_)) {
     }
 
     cb::const_char_buffer getDescription() {
@@ -4878,9 +5419,9 @@ public:
                                PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
                                cookie);
         } else {
-            auto cb = std::make_shared<AllKeysCallback>();
+            auto cb = std::make_shared<AllKeysCallback>(filterPrefix);
             err = engine->getKVBucket()->getROUnderlying(vbid)->getAllKeys(
-                                                    vbid, start_key, count, cb);
+                                           vbid, start_key, end_key, count, cb);
             if (err == ENGINE_SUCCESS) {
                 err =  sendResponse(response, NULL, 0, NULL, 0,
                                     ((AllKeysCallback*)cb.get())->getAllKeysPtr(),
@@ -4901,8 +5442,11 @@ private:
     const std::string description;
     ADD_RESPONSE response;
     StoredDocKey start_key;
+    // End of the requested key range (inclusive); empty means unbounded.
+    StoredDocKey end_key;
     uint16_t vbid;
     uint32_t count;
+    std::string filterPrefix;
 };
 
 ENGINE_ERROR_CODE
@@ -4931,7 +5475,7 @@ EventuallyPersistentEngine::getAllKeys(const void* cookie,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() != vbucket_state_active) {
         return ENGINE_NOT_MY_VBUCKET;
     }
@@ -4957,8 +5501,41 @@ EventuallyPersistentEngine::getAllKeys(const void* cookie,
     const uint8_t* keyPtr = (request->bytes + sizeof(request->bytes) + extlen);
     DocKey start_key(keyPtr, keylen, docNamespace);
 
-    ExTask task = std::make_shared<FetchAllKeysTask>(
-            this, cookie, response, start_key, vbucket, count);
+    // An optional value carries the (inclusive) end of the key range; the
+    // bound is pushed down into the KVStore's index walk so that a
+    // ranged enumeration only ever touches the requested range.
+    const uint32_t bodylen = ntohl(request->message.header.request.bodylen);
+    if (bodylen < uint32_t(keylen) + extlen) {
+        return ENGINE_EINVAL;
+    }
+    const uint32_t vallen = bodylen - keylen - extlen;
+    DocKey end_key(keyPtr + keylen, vallen, docNamespace);
+
+    // For a collections-aware request restrict the returned keys to the
+    // start key's collection; the prefix (collection name and separator) is
+    // matched against each key read from disk.
+    std::string filterPrefix;
+    if (docNamespace == DocNamespace::Collections) {
+        const auto separator = vb->lockCollections().getSeparator();
+        const std::string keyStr(reinterpret_cast<const char*>(keyPtr),
+                                 keylen);
+        auto pos = keyStr.find(separator);
+        if (pos == std::string::npos) {
+            LOG(EXTENSION_LOG_WARNING,
+                "getAllKeys: start key has no collection separator");
+            return ENGINE_EINVAL;
+        }
+        filterPrefix = keyStr.substr(0, pos + separator.size());
+    }
+
+    ExTask task = std::make_shared<FetchAllKeysTask>(this,
+                                                     cookie,
+                                                     response,
+                                                     start_key,
+                                                     end_key,
+                                                     vbucket,
+                                                     count,
+                                                     filterPrefix);
     ExecutorPool::get()->schedule(task);
     return ENGINE_EWOULDBLOCK;
 }
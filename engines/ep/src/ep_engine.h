@@ -428,6 +428,16 @@ public:
                                     protocol_binary_request_header *request,
                                     ADD_RESPONSE response);
 
+    ENGINE_ERROR_CODE multiGet(const void* cookie,
+                               protocol_binary_request_header* request,
+                               ADD_RESPONSE response,
+                               DocNamespace docNamespace);
+
+    ENGINE_ERROR_CODE multiSetWithMeta(const void* cookie,
+                                       protocol_binary_request_header* request,
+                                       ADD_RESPONSE response,
+                                       DocNamespace docNamespace);
+
     VBucketPtr getVBucket(uint16_t vbucket) {
         return kvBucket->getVBucket(vbucket);
     }
@@ -619,6 +629,20 @@ protected:
         getlDefaultTimeout = value;
     }
 
+    /**
+     * Update the in-memory compression mode; see compression_mode in
+     * the configuration. In "active" mode values stored uncompressed
+     * by the client are snappy-compressed on their way into the
+     * HashTable (see store_if).
+     */
+    void setCompressionMode(const std::string& mode) {
+        compressionActive.store(mode == "active");
+    }
+
+    bool isCompressionActive() const {
+        return compressionActive.load();
+    }
+
     void setGetlMaxTimeout(size_t value) {
         getlMaxTimeout = value;
     }
@@ -674,6 +698,15 @@ protected:
     ENGINE_ERROR_CODE doTimingStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doSchedulerStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doRunTimeStats(const void *cookie, ADD_STAT add_stat);
+
+    /**
+     * Per-task-type percentile summary (p50/p90/p99/p999/max, in
+     * microseconds) of
+     * the scheduler queue-wait and runtime histograms, for alerting
+     * without having to parse raw histogram bins.
+     */
+    ENGINE_ERROR_CODE doSchedulerProfileStats(const void* cookie,
+                                              ADD_STAT add_stat);
     ENGINE_ERROR_CODE doDispatcherStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doTasksStats(const void* cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doKeyStats(const void *cookie, ADD_STAT add_stat,
@@ -866,6 +899,9 @@ protected:
     size_t getlDefaultTimeout;
     size_t getlMaxTimeout;
     size_t maxFailoverEntries;
+    /// True if the bucket's compression_mode is "active" (see
+    /// setCompressionMode())
+    std::atomic<bool> compressionActive{false};
     EPStats stats;
     Configuration configuration;
     std::atomic<bool> trafficEnabled;
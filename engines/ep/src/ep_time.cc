@@ -49,6 +49,10 @@ void initialize_time_functions(const SERVER_CORE_API* core_api) {
     }
 }
 
+bool ep_time_functions_initialized(void) {
+    return ep_current_time != uninitialized_current_time;
+}
+
 rel_time_t (*ep_current_time)(void) = uninitialized_current_time;
 time_t (*ep_abs_time)(rel_time_t) = default_abs_time;
 rel_time_t (*ep_reltime)(time_t) = default_reltime;
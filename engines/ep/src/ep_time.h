@@ -42,6 +42,11 @@ extern time_t (*ep_abs_time)(rel_time_t);
 extern rel_time_t (*ep_reltime)(time_t);
 extern time_t ep_real_time(void);
 
+/* Returns true once initialize_time_functions has been called, i.e. the
+ * above function pointers are backed by the server API.
+ */
+bool ep_time_functions_initialized(void);
+
 #ifdef __cplusplus
 }
 #endif
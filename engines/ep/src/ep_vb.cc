@@ -89,7 +89,7 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
     ENGINE_ERROR_CODE status = fetched_item.value->getStatus();
     Item* fetchedValue = fetched_item.value->item.get();
     { // locking scope
-        ReaderLockHolder rlh(getStateLock());
+        StripedRWLock::ReadHolder rlh(getStateLock());
         auto hbl = ht.getLockedBucket(key);
         StoredValue* v = fetchValidValue(hbl,
                                          key,
@@ -153,6 +153,12 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
                                 ") should be resident after calling "
                                 "restoreValue()");
                     }
+                    // Mark the restored value as just-referenced so the
+                    // pager has to age it through every NRU state before
+                    // it becomes evictable again; without this hold-down
+                    // a hot key can be re-evicted straight after the
+                    // fetch and the herd of misses re-forms.
+                    v->setNRUValue(MIN_NRU_VALUE);
                 } else if (status == ENGINE_KEY_ENOENT) {
                     v->setNonExistent();
                     if (eviction == FULL_EVICTION) {
@@ -219,8 +225,13 @@ void EPVBucket::notifyHighPriorityRequests(EventuallyPersistentEngine& engine,
         shard->highPriorityCount.fetch_sub(toNotify.size());
     }
 
-    for (auto& notify : toNotify) {
-        engine.notifyIOComplete(notify.first, notify.second);
+    // Wake each group of cookies with a single batched call rather than
+    // paying a thread switch per cookie.
+    if (!toNotify.satisfied.empty()) {
+        engine.notifyIOComplete(toNotify.satisfied, ENGINE_SUCCESS);
+    }
+    if (!toNotify.timedOut.empty()) {
+        engine.notifyIOComplete(toNotify.timedOut, ENGINE_TMPFAIL);
     }
 }
 
@@ -402,6 +413,16 @@ protocol_binary_response_status EPVBucket::evictKey(const DocKey& key,
 }
 
 bool EPVBucket::pageOut(const HashTable::HashBucketLock& lh, StoredValue*& v) {
+    if (eviction == FULL_EVICTION && v->isResident()) {
+        // Evict in two stages - initially just the value (as value
+        // eviction does), leaving the metadata resident so a subsequent
+        // access is an in-memory hit followed by a background fetch of
+        // the value. The whole StoredValue is only removed if the pager
+        // finds the document cold again on a later sweep - i.e. it has
+        // stayed non-resident and unreferenced - at which point the
+        // bloom filter takes over negative lookups for the key.
+        return ht.unlocked_ejectItem(v, VALUE_ONLY);
+    }
     return ht.unlocked_ejectItem(v, eviction);
 }
 
@@ -335,21 +335,36 @@ EphemeralBucket::NotifyHighPriorityReqTask::NotifyHighPriorityReqTask(
 }
 
 bool EphemeralBucket::NotifyHighPriorityReqTask::run() {
-    std::map<const void*, ENGINE_ERROR_CODE> notifyQ;
+    HighPriorityNotifications notifyQ;
     {
         /* It is necessary that the toNotifyLock is not held while
            actually notifying. */
         std::lock_guard<std::mutex> lg(toNotifyLock);
         notifyQ = std::move(toNotify);
+        toNotify = HighPriorityNotifications();
     }
 
-    for (auto& notify : notifyQ) {
-        LOG(EXTENSION_LOG_NOTICE,
+    for (const void* cookie : notifyQ.satisfied) {
+        LOG(EXTENSION_LOG_INFO,
             "%s for cookie :%p and status %d",
             to_string(getDescription()).c_str(),
-            notify.first,
-            notify.second);
-        engine->notifyIOComplete(notify.first, notify.second);
+            cookie,
+            ENGINE_SUCCESS);
+    }
+    for (const void* cookie : notifyQ.timedOut) {
+        LOG(EXTENSION_LOG_INFO,
+            "%s for cookie :%p and status %d",
+            to_string(getDescription()).c_str(),
+            cookie,
+            ENGINE_TMPFAIL);
+    }
+
+    /* Wake each group of cookies with a single batched call */
+    if (!notifyQ.satisfied.empty()) {
+        engine->notifyIOComplete(notifyQ.satisfied, ENGINE_SUCCESS);
+    }
+    if (!notifyQ.timedOut.empty()) {
+        engine->notifyIOComplete(notifyQ.timedOut, ENGINE_TMPFAIL);
     }
 
     /* Lets assume that the task will be explicitly woken */
@@ -387,12 +402,16 @@ EphemeralBucket::NotifyHighPriorityReqTask::maxExpectedDuration() {
 }
 
 void EphemeralBucket::NotifyHighPriorityReqTask::wakeup(
-        std::map<const void*, ENGINE_ERROR_CODE> notifies) {
+        HighPriorityNotifications notifies) {
     {
         /* Add the connections to be notified */
         std::lock_guard<std::mutex> lg(toNotifyLock);
-        toNotify.insert(make_move_iterator(begin(notifies)),
-                        make_move_iterator(end(notifies)));
+        toNotify.satisfied.insert(toNotify.satisfied.end(),
+                                  notifies.satisfied.begin(),
+                                  notifies.satisfied.end());
+        toNotify.timedOut.insert(toNotify.timedOut.end(),
+                                 notifies.timedOut.begin(),
+                                 notifies.timedOut.end());
     }
 
     /* wake up the task */
@@ -164,13 +164,13 @@ private:
          * Adds the connections to be notified by the task and then wakes up
          * the task.
          *
-         * @param notifies Map of connections to be notified
+         * @param notifies Connections to be notified, grouped by status
          */
-        void wakeup(std::map<const void*, ENGINE_ERROR_CODE> notifies);
+        void wakeup(HighPriorityNotifications notifies);
 
     private:
         /* All the notifications to be called by the task */
-        std::map<const void*, ENGINE_ERROR_CODE> toNotify;
+        HighPriorityNotifications toNotify;
 
         /* Serialize access to write/read of toNotify */
         std::mutex toNotifyLock;
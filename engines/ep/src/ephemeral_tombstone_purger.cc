@@ -76,10 +76,18 @@ EphTombstoneHTCleaner::EphTombstoneHTCleaner(EventuallyPersistentEngine* e,
                  e->getConfiguration().getEphemeralMetadataPurgeInterval(),
                  false),
       bucket(bucket),
-      bucketPosition(bucket.endPosition()),
-      staleItemDeleterTask(
-              std::make_shared<EphTombstoneStaleItemDeleter>(e, bucket)) {
-    ExecutorPool::get()->schedule(staleItemDeleterTask);
+      bucketPosition(bucket.endPosition()) {
+    // Create the paired stale item deleter task(s). With a concurrency
+    // greater than one, each task owns a disjoint stripe of vBuckets so
+    // they can run in parallel on different NonIO threads.
+    const size_t numDeleters =
+            e->getConfiguration().getEphemeralMetadataPurgeConcurrency();
+    for (size_t stripe = 0; stripe < numDeleters; ++stripe) {
+        auto task = std::make_shared<EphTombstoneStaleItemDeleter>(
+                e, bucket, stripe, numDeleters);
+        ExecutorPool::get()->schedule(task);
+        staleItemDeleterTasks.push_back(task);
+    }
 }
 
 bool EphTombstoneHTCleaner::run() {
@@ -98,9 +106,23 @@ bool EphTombstoneHTCleaner::run() {
             uint64_t(getDeletedPurgeAge()));
     }
 
+    // Ask the latency pacer how much of our nominal chunk budget the
+    // front-end can currently afford; skip the chunk entirely if operation
+    // latency is badly degraded.
+    const auto chunkDuration =
+            bucket.getLatencyPacer().paceChunkDuration(getChunkDuration());
+    if (chunkDuration == std::chrono::milliseconds::zero()) {
+        LOG(EXTENSION_LOG_INFO,
+            "%s backing off - front-end latency pressure %.2f",
+            getDescription().data(),
+            bucket.getLatencyPacer().getPressure());
+        snooze(LatencyPacer::backoffSleep);
+        return true;
+    }
+
     // Prepare the underlying visitor.
     auto& visitor = getPurgerVisitor();
-    visitor.setDeadline(ProcessClock::now() + getChunkDuration());
+    visitor.setDeadline(ProcessClock::now() + chunkDuration);
     visitor.clearStats();
 
     // (re)start visiting.
@@ -133,7 +155,9 @@ bool EphTombstoneHTCleaner::run() {
         uint64_t(getSleepTime()));
 
     snooze(getSleepTime());
-    staleItemDeleterTask->wakeUp();
+    for (auto& task : staleItemDeleterTasks) {
+        task->wakeUp();
+    }
     return true;
 }
 
@@ -178,7 +202,18 @@ EphTombstoneHTCleaner::getPurgerVisitor() {
  */
 class EphemeralVBucket::StaleItemDeleter : public PauseResumeVBVisitor {
 public:
-    StaleItemDeleter() {
+    /**
+     * @param stripe Which stripe of vBuckets this deleter handles; vBuckets
+     *        belonging to other stripes are skipped (vbid % numStripes).
+     * @param numStripes Total number of stripes (i.e. concurrent deleter
+     *        tasks) across the bucket.
+     * @param purgeBatchSize Maximum number of elements unlinked from a
+     *        sequence list per write lock acquisition.
+     */
+    StaleItemDeleter(size_t stripe, size_t numStripes, size_t purgeBatchSize)
+        : stripe(stripe),
+          numStripes(numStripes),
+          purgeBatchSize(purgeBatchSize) {
     }
 
     bool visit(VBucket& vb) override {
@@ -189,14 +224,22 @@ public:
                     "non-Ephemeral bucket");
         }
 
+        if (vb.getId() % numStripes != stripe) {
+            // vBucket belongs to another deleter task's stripe.
+            return shouldContinueVisiting;
+        }
+
         /// The lambda function passed indicates if the "StaleItemDeleter"
         /// should be paused. It can be called by the module(s) implementing the
         /// purge at the desired granularity
-        numItemsDeleted += vbucket->purgeStaleItems([this]() {
-            shouldContinueVisiting =
-                    progressTracker.shouldContinueVisiting(numVisitedItems++);
-            return !(shouldContinueVisiting);
-        });
+        numItemsDeleted += vbucket->purgeStaleItems(
+                [this]() {
+                    shouldContinueVisiting =
+                            progressTracker.shouldContinueVisiting(
+                                    numVisitedItems++);
+                    return !(shouldContinueVisiting);
+                },
+                purgeBatchSize);
         return shouldContinueVisiting;
     }
 
@@ -227,13 +270,27 @@ protected:
     /// Indicates if the VB visitor should continue visiting other vbuckets in
     /// the current run
     bool shouldContinueVisiting = true;
+
+    /// Which stripe of vBuckets this deleter handles.
+    const size_t stripe;
+
+    /// Total number of stripes across the bucket.
+    const size_t numStripes;
+
+    /// Maximum elements unlinked per sequence list write lock acquisition.
+    const size_t purgeBatchSize;
 };
 
 EphTombstoneStaleItemDeleter::EphTombstoneStaleItemDeleter(
-        EventuallyPersistentEngine* e, EphemeralBucket& bucket)
+        EventuallyPersistentEngine* e,
+        EphemeralBucket& bucket,
+        size_t stripe,
+        size_t numStripes)
     : GlobalTask(e, TaskId::EphTombstoneStaleItemDeleter, INT_MAX, false),
       bucket(bucket),
-      bucketPosition(bucket.endPosition()) {
+      bucketPosition(bucket.endPosition()),
+      stripe(stripe),
+      numStripes(numStripes) {
 }
 
 bool EphTombstoneStaleItemDeleter::run() {
@@ -242,15 +299,30 @@ bool EphTombstoneStaleItemDeleter::run() {
     // starting from the beginning.
     if (bucketPosition == bucket.endPosition()) {
         staleItemDeleteVbVisitor =
-                std::make_unique<EphemeralVBucket::StaleItemDeleter>();
+                std::make_unique<EphemeralVBucket::StaleItemDeleter>(
+                        stripe, numStripes, getPurgeBatchSize());
         bucketPosition = bucket.startPosition();
 
         LOG(EXTENSION_LOG_INFO, "%s starting", getDescription().data());
     }
 
+    // Ask the latency pacer how much of our nominal chunk budget the
+    // front-end can currently afford; skip the chunk entirely if operation
+    // latency is badly degraded.
+    const auto chunkDuration =
+            bucket.getLatencyPacer().paceChunkDuration(getChunkDuration());
+    if (chunkDuration == std::chrono::milliseconds::zero()) {
+        LOG(EXTENSION_LOG_INFO,
+            "%s backing off - front-end latency pressure %.2f",
+            getDescription().data(),
+            bucket.getLatencyPacer().getPressure());
+        snooze(LatencyPacer::backoffSleep);
+        return true;
+    }
+
     // Create a StaleItemDeleter, and run across all VBuckets.
     staleItemDeleteVbVisitor->setDeadline(ProcessClock::now() +
-                                          getChunkDuration());
+                                          chunkDuration);
     staleItemDeleteVbVisitor->clearStats();
 
     auto start = ProcessClock::now();
@@ -302,3 +374,7 @@ std::chrono::milliseconds EphTombstoneStaleItemDeleter::getChunkDuration()
             engine->getConfiguration()
                     .getEphemeralMetadataPurgeStaleChunkDuration());
 }
+
+size_t EphTombstoneStaleItemDeleter::getPurgeBatchSize() const {
+    return engine->getConfiguration().getEphemeralMetadataPurgeStaleBatchSize();
+}
@@ -52,7 +52,12 @@
  *
  * 2. EphTombstoneStaleItemDeleter - iterate the SequenceList in order
  *    looking for stale OSVs. For such items unlink from the SequenceList and
- *    delete the OSV.
+ *    delete the OSV. To keep up with high delete churn this phase can be
+ *    parallelized (ephemeral_metadata_purge_concurrency) - each deleter task
+ *    owns a disjoint stripe of vBuckets - and unlinking is batched under
+ *    short seqList write lock acquisitions bounded by
+ *    ephemeral_metadata_purge_stale_batch_size, so reclamation does not
+ *    contend with front-end writes on every element.
  *
  * Note that items can also become stale if they have been replaced with a newer
  * revision - this occurs when an item needs to be modified but the existing
@@ -169,8 +174,10 @@ private:
      */
     std::unique_ptr<PauseResumeVBAdapter> prAdapter;
 
-    /// Second paired task which deletes stale items from the sequenceList.
-    std::shared_ptr<EphTombstoneStaleItemDeleter> staleItemDeleterTask;
+    /// Paired task(s) which delete stale items from the sequenceLists; one
+    /// per stripe of vBuckets (see ephemeral_metadata_purge_concurrency).
+    std::vector<std::shared_ptr<EphTombstoneStaleItemDeleter>>
+            staleItemDeleterTasks;
 };
 
 /**
@@ -181,8 +188,16 @@ private:
  */
 class EphTombstoneStaleItemDeleter : public GlobalTask {
 public:
+    /**
+     * @param stripe Which stripe of vBuckets this task deletes stale items
+     *        from (vbid % numStripes == stripe).
+     * @param numStripes Total number of concurrent deleter tasks across the
+     *        bucket.
+     */
     EphTombstoneStaleItemDeleter(EventuallyPersistentEngine* e,
-                                 EphemeralBucket& bucket);
+                                 EphemeralBucket& bucket,
+                                 size_t stripe = 0,
+                                 size_t numStripes = 1);
 
     bool run() override;
 
@@ -194,12 +209,21 @@ private:
     /// How long should each chunk of stale item deleter run for?
     std::chrono::milliseconds getChunkDuration() const;
 
+    /// Maximum elements unlinked per sequence list write lock acquisition.
+    size_t getPurgeBatchSize() const;
+
     /// The bucket we are associated with.
     EphemeralBucket& bucket;
 
     /// Opaque marker indicating how far through the KVBucket we have visited.
     KVBucketIface::Position bucketPosition;
 
+    /// Stripe of vBuckets this task handles.
+    const size_t stripe;
+
+    /// Total number of stripes across the bucket.
+    const size_t numStripes;
+
     /// Vb visitor instance that deletes the stale items by visiting all
     /// vbuckets one by one
     std::unique_ptr<EphemeralVBucket::StaleItemDeleter>
@@ -123,6 +123,70 @@ bool EphemeralVBucket::areDeletedItemsAlwaysResident() const {
     return true;
 }
 
+size_t EphemeralVBucket::evictProbationaryItems(size_t maxToEvict) {
+    size_t evicted = 0;
+    seqno_t fromSeqno = 0;
+
+    // Candidates are collected in batches; the batch size bounds how long
+    // the seqList write lock is held while walking the list.
+    const size_t batchSize = 256;
+
+    while (evicted < maxToEvict) {
+        std::vector<StoredDocKey> candidates;
+        std::tie(candidates, fromSeqno) = seqList->pickEvictionCandidates(
+                std::min(batchSize, maxToEvict - evicted), fromSeqno);
+        if (candidates.empty()) {
+            // Walked off the hot end of the list.
+            break;
+        }
+
+        size_t evictedThisBatch = 0;
+        for (const auto& key : candidates) {
+            // Re-validate the candidate under its HashTable lock; it may
+            // have been updated, deleted or purged since the keys were
+            // collected.
+            auto hbl = ht.getLockedBucket(key);
+            StoredValue* v = ht.unlocked_find(key,
+                                              hbl.getBucketNum(),
+                                              WantsDeleted::No,
+                                              TrackReference::No);
+            if (!v || v->isTempItem()) {
+                continue;
+            }
+            if (v->getNRUValue() < INITIAL_NRU_VALUE) {
+                // Protected (referenced since last mutation) - skip, but
+                // age one step so a once-hot item which has gone idle
+                // eventually becomes evictable again. Items still being
+                // accessed have their NRU re-lowered on each reference.
+                v->incrNRUValue();
+                continue;
+            }
+            if (pageOut(hbl, v)) {
+                ++evicted;
+                ++evictedThisBatch;
+            }
+        }
+
+        if (evictedThisBatch == 0) {
+            // Everything at the cold end of the list is protected; defer
+            // to the caller's HashTable scan rather than spinning here.
+            break;
+        }
+        if (stats.getTotalMemoryUsed() < stats.mem_low_wat.load()) {
+            break;
+        }
+    }
+
+    if (evicted > 0) {
+        LOG(EXTENSION_LOG_INFO,
+            "EphemeralVBucket::evictProbationaryItems: (vb %d) auto-deleted"
+            " %" PRIu64 " items from the cold end of the seqList",
+            getId(),
+            uint64_t(evicted));
+    }
+    return evicted;
+}
+
 void EphemeralVBucket::addStats(bool details,
                                 ADD_STAT add_stat,
                                 const void* c) {
@@ -161,7 +225,7 @@ void EphemeralVBucket::addStats(bool details,
                 add_stat,
                 c);
         addStat("seqlist_stale_metadata_bytes",
-                seqList->getStaleValueBytes(),
+                seqList->getStaleMetadataBytes(),
                 add_stat,
                 c);
     }
@@ -304,7 +368,8 @@ void EphemeralVBucket::queueBackfillItem(
     stats.memOverhead->fetch_add(sizeof(queued_item));
 }
 
-size_t EphemeralVBucket::purgeStaleItems(std::function<bool()> shouldPauseCbk) {
+size_t EphemeralVBucket::purgeStaleItems(std::function<bool()> shouldPauseCbk,
+                                         size_t purgeBatchSize) {
     // Iterate over the sequence list and delete any stale items. But we do
     // not want to delete the last element in the vbucket, hence we pass
     // 'seqList->getHighSeqno() - 1'.
@@ -316,8 +381,11 @@ size_t EphemeralVBucket::purgeStaleItems(std::function<bool()> shouldPauseCbk) {
         /* not enough items to purge */
         return 0;
     }
-    auto seqListPurged = seqList->purgeTombstones(
-            static_cast<seqno_t>(seqList->getHighSeqno()) - 1, shouldPauseCbk);
+    auto seqListPurged =
+            seqList->purgeTombstones(
+                    static_cast<seqno_t>(seqList->getHighSeqno()) - 1,
+                    shouldPauseCbk,
+                    purgeBatchSize);
 
     // Update stats and return.
     seqListPurgeCount += seqListPurged;
@@ -167,12 +167,36 @@ public:
      *                    continue or if it should be paused (in case it is
      *                    running for a long time). By default, we assume that
      *                    the tombstone purging need not be paused at all
+     * @param purgeBatchSize Maximum number of elements unlinked from the
+     *                       sequence list per acquisition of its write lock
+     *                       (see SequenceList::purgeTombstones)
      *
      * @return Number of items purged.
      */
-    size_t purgeStaleItems(std::function<bool()> shouldPauseCbk = []() {
-        return false;
-    });
+    size_t purgeStaleItems(
+            std::function<bool()> shouldPauseCbk = []() { return false; },
+            size_t purgeBatchSize = 128);
+
+    /**
+     * Auto-delete up to maxToEvict cold items, taking candidates in order
+     * from the cold (lowest seqno) end of the sequence list instead of
+     * scanning the HashTable.
+     *
+     * This gives segmented-LRU like behaviour using the existing NRU state
+     * as the segment marker: items which have been referenced since their
+     * last mutation (NRU below the initial value) are "protected" - they
+     * are not deleted by this path, just aged one NRU step so that
+     * persistently idle items eventually become evictable again. Items
+     * never referenced since insertion are "probationary" and are deleted
+     * oldest-first. If this path cannot free enough memory (the cold end
+     * of the list is hot in terms of reads) the caller falls back to the
+     * HashTable scan.
+     *
+     * @param maxToEvict Maximum number of items to delete
+     *
+     * @return Number of items deleted.
+     */
+    size_t evictProbationaryItems(size_t maxToEvict) override;
 
     void setupDeferredDeletion(const void* cookie) override;
 
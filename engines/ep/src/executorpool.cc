@@ -161,7 +161,8 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
                   numTaskSets(nTaskSets), totReadyTasks(0),
                   isHiPrioQset(false), isLowPrioQset(false), numBuckets(0),
                   numSleepers(0), curWorkers(nTaskSets), numWorkers(nTaskSets),
-                  numReadyTasks(nTaskSets) {
+                  numReadyTasks(nTaskSets), completedTasks(nTaskSets),
+                  completedTaskTime(nTaskSets), prevTaskTime(nTaskSets) {
     size_t numCPU = Couchbase::get_available_cpu_count();
     size_t numThreads = (size_t)((numCPU * 3)/4);
     numThreads = (numThreads < EP_MIN_NUM_THREADS) ?
@@ -170,6 +171,8 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
     for (size_t i = 0; i < nTaskSets; i++) {
         curWorkers[i] = 0;
         numReadyTasks[i] = 0;
+        completedTasks[i] = 0;
+        completedTaskTime[i] = 0;
     }
     numWorkers[WRITER_TASK_IDX] = maxWriters;
     numWorkers[READER_TASK_IDX] = maxReaders;
@@ -291,15 +294,14 @@ void ExecutorPool::doneWork(task_type_t taskType) {
 }
 
 bool ExecutorPool::_cancel(size_t taskId, bool eraseTask) {
-    LockHolder lh(tMutex);
-    std::map<size_t, TaskQpair>::iterator itr = taskLocator.find(taskId);
-    if (itr == taskLocator.end()) {
+    TaskQpair tqp = taskLocator.find(taskId);
+    if (!tqp.first) {
         LOG(EXTENSION_LOG_DEBUG, "Task id %" PRIu64 " not found",
             uint64_t(taskId));
         return false;
     }
 
-    ExTask task = itr->second.first;
+    ExTask task = tqp.first;
     LOG(EXTENSION_LOG_DEBUG,
         "Cancel task %.*s id %" PRIu64 " on bucket %s %s",
         int(task->getDescription().size()),
@@ -317,12 +319,15 @@ bool ExecutorPool::_cancel(size_t taskId, bool eraseTask) {
                                    "' is not dead after calling "
                                    "cancel() on it");
         }
-        taskLocator.erase(itr);
+        taskLocator.erase(taskId);
+        // Take tMutex purely to notify - unregisterTaskable/stopTaskGroup
+        // wait on it for outstanding tasks to finish cancelling.
+        LockHolder lh(tMutex);
         tMutex.notify_all();
     } else { // wake up the task from the TaskQ so a thread can safely erase it
              // otherwise we may race with unregisterTaskable where a unlocated
              // task runs in spite of its bucket getting unregistered
-        itr->second.second->wake(task);
+        tqp.second->wake(task);
     }
     return true;
 }
@@ -335,10 +340,9 @@ bool ExecutorPool::cancel(size_t taskId, bool eraseTask) {
 }
 
 bool ExecutorPool::_wake(size_t taskId) {
-    LockHolder lh(tMutex);
-    std::map<size_t, TaskQpair>::iterator itr = taskLocator.find(taskId);
-    if (itr != taskLocator.end()) {
-        itr->second.second->wake(itr->second.first);
+    TaskQpair tqp = taskLocator.find(taskId);
+    if (tqp.first) {
+        tqp.second->wake(tqp.first);
         return true;
     }
     return false;
@@ -352,10 +356,9 @@ bool ExecutorPool::wake(size_t taskId) {
 }
 
 bool ExecutorPool::_snooze(size_t taskId, double toSleep) {
-    LockHolder lh(tMutex);
-    std::map<size_t, TaskQpair>::iterator itr = taskLocator.find(taskId);
-    if (itr != taskLocator.end()) {
-        itr->second.second->snooze(itr->second.first, toSleep);
+    TaskQpair tqp = taskLocator.find(taskId);
+    if (tqp.first) {
+        tqp.second->snooze(tqp.first, toSleep);
         return true;
     }
     return false;
@@ -433,9 +436,7 @@ size_t ExecutorPool::_schedule(ExTask task) {
                                  GlobalTask::getTaskType(task->getTypeId()));
     TaskQpair tqp(task, q);
 
-    auto result = taskLocator.insert(std::make_pair(taskId, tqp));
-
-    if (result.second) {
+    if (taskLocator.insert(taskId, tqp)) {
         // tqp was inserted; it was not already present. Prevents multiple
         // copies of a task being present in the task queues.
         q->schedule(task);
@@ -595,6 +596,94 @@ void ExecutorPool::adjustWorkers(task_type_t type, size_t newCount) {
     ObjectRegistry::onSwitchThread(epe);
 }
 
+void ExecutorPool::recordTaskRuntime(task_type_t type,
+                                     ProcessClock::duration runtime) {
+    completedTasks[type]++;
+    completedTaskTime[type] += std::chrono::duration_cast<
+            std::chrono::microseconds>(runtime).count();
+}
+
+size_t ExecutorPool::_sizeForLoad(size_t curThreads, size_t minThreads,
+                                  size_t maxThreads, size_t queueDepth,
+                                  double demand) {
+    if (queueDepth > curThreads && demand > curThreads * 0.75 &&
+        curThreads < maxThreads) {
+        // Backlogged with the existing threads near-saturated; the device
+        // appears to have headroom, so grow by one and re-measure. If it
+        // doesn't (latency merely inflates with no extra throughput),
+        // demand stops growing with the thread count and we stop here.
+        return curThreads + 1;
+    }
+    if (queueDepth == 0 && curThreads > minThreads &&
+        demand < (curThreads - 1) * 0.5) {
+        // No backlog and over half the pool idle; one fewer thread still
+        // comfortably covers the measured concurrency demand.
+        return curThreads - 1;
+    }
+    return curThreads;
+}
+
+void ExecutorPool::adjustWorkersForLoad(bool adjustReaders,
+                                        bool adjustWriters) {
+    std::lock_guard<std::mutex> lh(sizingMutex);
+
+    const ProcessClock::time_point now = ProcessClock::now();
+    if (lastSizingEval == ProcessClock::time_point()) {
+        // First call; just baseline the counters.
+        prevTaskTime[READER_TASK_IDX] = completedTaskTime[READER_TASK_IDX];
+        prevTaskTime[WRITER_TASK_IDX] = completedTaskTime[WRITER_TASK_IDX];
+        lastSizingEval = now;
+        return;
+    }
+
+    const auto windowUsec = std::chrono::duration_cast<
+            std::chrono::microseconds>(now - lastSizingEval).count();
+    if (windowUsec < 1000000) {
+        // Another bucket's monitor already evaluated this window.
+        return;
+    }
+    lastSizingEval = now;
+
+    struct {
+        task_type_t type;
+        bool adjust;
+        size_t cur;
+        size_t min;
+        size_t max;
+    } pools[] = {{READER_TASK_IDX, adjustReaders, getNumReaders(),
+                  EP_MIN_READER_THREADS, EP_MAX_READER_THREADS},
+                 {WRITER_TASK_IDX, adjustWriters, getNumWriters(),
+                  EP_MIN_WRITER_THREADS, EP_MAX_WRITER_THREADS}};
+
+    for (auto& pool : pools) {
+        const uint64_t busy = completedTaskTime[pool.type];
+        const double demand = double(busy - prevTaskTime[pool.type]) /
+                              windowUsec;
+        prevTaskTime[pool.type] = busy;
+
+        if (!pool.adjust) {
+            continue;
+        }
+
+        // A pool created smaller than the platform minimum (e.g. in unit
+        // tests) is never shrunk below its configured size.
+        const size_t target = _sizeForLoad(pool.cur,
+                                           std::min(pool.min, pool.cur),
+                                           pool.max,
+                                           numReadyTasks[pool.type],
+                                           demand);
+        if (target != pool.cur) {
+            LOG(EXTENSION_LOG_NOTICE,
+                "Adaptive sizing: adjusting %s threads from:%" PRIu64
+                " to:%" PRIu64 " (demand:%.2f queued:%" PRIu64 ")",
+                (pool.type == READER_TASK_IDX) ? "reader" : "writer",
+                uint64_t(pool.cur), uint64_t(target), demand,
+                uint64_t(numReadyTasks[pool.type].load()));
+            adjustWorkers(pool.type, target);
+        }
+    }
+}
+
 bool ExecutorPool::_startWorkers(void) {
     size_t numReaders = getNumReaders();
     size_t numWriters = getNumWriters();
@@ -619,15 +708,13 @@ bool ExecutorPool::_stopTaskGroup(task_gid_t taskGID,
                                   bool force) {
     bool unfinishedTask;
     bool retVal = false;
-    std::map<size_t, TaskQpair>::iterator itr;
 
     std::unique_lock<std::mutex> lh(tMutex);
     do {
-        ExTask task;
         unfinishedTask = false;
-        for (itr = taskLocator.begin(); itr != taskLocator.end(); itr++) {
-            task = itr->second.first;
-            TaskQueue *q = itr->second.second;
+        for (auto& pair : taskLocator.copy()) {
+            ExTask& task = pair.second.first;
+            TaskQueue* q = pair.second.second;
             if (task->getTaskable().getGID() == taskGID &&
                 (taskType == NO_TASK_TYPE || q->queueType == taskType)) {
                 LOG(EXTENSION_LOG_NOTICE,
@@ -884,16 +971,9 @@ void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
     EventuallyPersistentEngine* epe =
             ObjectRegistry::onSwitchThread(NULL, true);
 
-    std::map<size_t, TaskQpair> taskLocatorCopy;
-
-    {
-        // Holding this lock will block scheduling new tasks and cancelling
-        // tasks, but threads can still take up work other than this
-        LockHolder lh(tMutex);
-
-        // Copy taskLocator
-        taskLocatorCopy = taskLocator;
-    }
+    // Snapshot the registry; tasks may be scheduled / cancelled while the
+    // stats are formatted.
+    std::map<size_t, TaskQpair> taskLocatorCopy = taskLocator.copy();
 
     char statname[80] = {0};
     char prefix[] = "ep_tasks";
@@ -72,8 +72,11 @@
 #include "task_type.h"
 #include "taskable.h"
 
+#include <array>
 #include <map>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 
 // Forward decl
 class TaskQueue;
@@ -84,6 +87,98 @@ typedef std::vector<ExecutorThread *> ThreadQ;
 typedef std::pair<ExTask, TaskQueue *> TaskQpair;
 typedef std::vector<TaskQueue *> TaskQ;
 
+/**
+ * Sharded registry of all tasks currently scheduled on the ExecutorPool.
+ *
+ * Replaces a single std::map guarded by the pool-wide tMutex. wake() and
+ * snooze() are called from hot paths (flusher notification, DCP stream
+ * processing) and only need to translate a task id into its TaskQpair;
+ * guarding that lookup with tMutex serialised it against task registration
+ * and thread management across every bucket. Task ids are dense monotonic
+ * integers, so striping the registry by (id % numShards) spreads concurrent
+ * lookups over independent locks - two threads contend only if their task
+ * ids collide on a shard, and never with operations on other shards.
+ *
+ * A fully lock-free open-addressing table was considered here; safe memory
+ * reclamation of erased entries would need epoch / hazard-pointer machinery
+ * this codebase doesn't otherwise have, and per-shard mutexes held for a
+ * handful of instructions get within noise of it on the wake/snooze paths.
+ */
+class TaskLocator {
+public:
+    /**
+     * Find the task with the given id.
+     * @return the located TaskQpair, or {nullptr, nullptr} if the id is
+     *         not registered. The returned ExTask keeps the task alive;
+     *         note the task may be concurrently cancelled - TaskQueues
+     *         tolerate waking dead tasks (they just get reaped).
+     */
+    TaskQpair find(size_t taskId) const {
+        const Shard& shard = getShard(taskId);
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        auto itr = shard.tasks.find(taskId);
+        if (itr == shard.tasks.end()) {
+            return {nullptr, nullptr};
+        }
+        return itr->second;
+    }
+
+    /// Register a task. @return false if the id was already present.
+    bool insert(size_t taskId, TaskQpair tqp) {
+        Shard& shard = getShard(taskId);
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        return shard.tasks.emplace(taskId, std::move(tqp)).second;
+    }
+
+    /// Remove the task with the given id. @return false if not present.
+    bool erase(size_t taskId) {
+        Shard& shard = getShard(taskId);
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        return shard.tasks.erase(taskId) != 0;
+    }
+
+    /// Count of registered tasks.
+    size_t size() const {
+        size_t count = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lh(shard.mutex);
+            count += shard.tasks.size();
+        }
+        return count;
+    }
+
+    /**
+     * Take an ordered snapshot of the registry, for iteration (stats,
+     * shutdown). Tasks may be registered / removed while the snapshot is
+     * being processed.
+     */
+    std::map<size_t, TaskQpair> copy() const {
+        std::map<size_t, TaskQpair> result;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lh(shard.mutex);
+            result.insert(shard.tasks.begin(), shard.tasks.end());
+        }
+        return result;
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<size_t, TaskQpair> tasks;
+    };
+
+    Shard& getShard(size_t taskId) {
+        return shards[taskId % numShards];
+    }
+
+    const Shard& getShard(size_t taskId) const {
+        return shards[taskId % numShards];
+    }
+
+    static const size_t numShards = 16;
+    std::array<Shard, numShards> shards;
+};
+
 class ExecutorPool {
 public:
 
@@ -103,6 +198,11 @@ public:
         return false;
     }
 
+    /** Does the given task set currently have ready work queued? */
+    bool hasReadyWork(task_type_t task_type) {
+        return numReadyTasks[task_type] != 0;
+    }
+
     void woke(void) {
         numSleepers--;
     }
@@ -128,6 +228,27 @@ public:
      */
     void adjustWorkers(task_type_t type, size_t newCount);
 
+    /**
+     * Account the wall-clock time an executor thread just spent running a
+     * task of the given type. Feeds the closed-loop pool sizing performed
+     * by adjustWorkersForLoad().
+     */
+    void recordTaskRuntime(task_type_t type, ProcessClock::duration runtime);
+
+    /**
+     * Closed-loop sizing of the reader and writer pools. Compares each
+     * pool's measured busy-time and ready-queue depth over the window since
+     * the previous call against its current thread count, and grows or
+     * shrinks the pool - within the platform bounds - by at most one thread
+     * at a time. Invoked periodically by PoolSizeMonitor; calls arriving
+     * less than a second after the previous evaluation are ignored, so
+     * multiple buckets may each run a monitor without fighting.
+     *
+     * @param adjustReaders true if the reader pool may be resized
+     * @param adjustWriters true if the writer pool may be resized
+     */
+    void adjustWorkersForLoad(bool adjustReaders, bool adjustWriters);
+
     bool snooze(size_t taskId, double tosleep);
 
     void registerTaskable(Taskable& taskable);
@@ -223,6 +344,23 @@ protected:
      */
     ssize_t _adjustWorkers(task_type_t type, size_t desiredNumItems);
 
+    /**
+     * Recommend a thread count for a pool given its measured load, moving
+     * at most one thread from the current count (grow and re-measure
+     * rather than jumping, so a slow device is never flooded).
+     *
+     * @param curThreads current number of threads in the pool
+     * @param minThreads lower bound on the result
+     * @param maxThreads upper bound on the result
+     * @param queueDepth number of ready tasks currently awaiting a thread
+     * @param demand mean number of concurrently busy threads over the last
+     *        window; by Little's law this is the task arrival rate
+     *        multiplied by the mean per-task latency.
+     * @return recommended thread count
+     */
+    size_t _sizeForLoad(size_t curThreads, size_t minThreads,
+                        size_t maxThreads, size_t queueDepth, double demand);
+
     bool _snooze(size_t taskId, double tosleep);
     size_t _schedule(ExTask task);
     void _registerTaskable(Taskable& taskable);
@@ -237,8 +375,9 @@ protected:
     std::atomic<size_t> totReadyTasks;
     SyncObject mutex; // Thread management condition var + mutex
 
-    //! A mapping of task ids to Task, TaskQ in the thread pool
-    std::map<size_t, TaskQpair> taskLocator;
+    //! A mapping of task ids to Task, TaskQ in the thread pool; has its
+    //! own (sharded) locking so wake/snooze lookups bypass tMutex.
+    TaskLocator taskLocator;
 
     //A list of threads
     ThreadQ threadQ;
@@ -252,13 +391,23 @@ protected:
 
     size_t numBuckets;
 
-    SyncObject tMutex; // to serialize taskLocator, threadQ, numBuckets access
+    SyncObject tMutex; // to serialize threadQ, numBuckets access; also the
+                       // condvar waited on for task cancellation
 
     std::atomic<uint16_t> numSleepers; // total number of sleeping threads
     std::vector<std::atomic<uint16_t>> curWorkers; // track # of active workers per TaskSet
     std::vector<std::atomic<uint16_t>> numWorkers; // and limit it to the value set here
     std::vector<std::atomic<size_t>> numReadyTasks; // number of ready tasks per task set
 
+    // Cumulative count and busy-time (usec) of completed tasks per task set;
+    // fed by recordTaskRuntime, consumed by adjustWorkersForLoad.
+    std::vector<std::atomic<uint64_t>> completedTasks;
+    std::vector<std::atomic<uint64_t>> completedTaskTime;
+
+    std::mutex sizingMutex; // serializes the adaptive sizing state below
+    ProcessClock::time_point lastSizingEval; // epoch => not yet baselined
+    std::vector<uint64_t> prevTaskTime; // completedTaskTime at last eval
+
     // Set of all known task owners
     std::set<void *> taskOwners;
 
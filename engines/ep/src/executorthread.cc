@@ -126,6 +126,9 @@ void ExecutorThread::run() {
                                                  getTaskStart());
             currentTask->getTaskable().logRunTime(currentTask->getTypeId(),
                                                   runtime);
+            currentTask->getTaskable().getWorkLoadPolicy().chargeRunTime(
+                    runtime);
+            manager->recordTaskRuntime(taskType, runtime);
             currentTask->updateRuntime(runtime);
 
             // Check if exceeded expected duration; and if so log.
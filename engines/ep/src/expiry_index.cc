@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "expiry_index.h"
+
+void ExpiryIndex::add(time_t exptime, const DocKey& key) {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (numKeys >= capacity) {
+        ++numDropped;
+        return;
+    }
+    index[exptime].emplace_back(key);
+    ++numKeys;
+}
+
+std::vector<StoredDocKey> ExpiryIndex::harvest(time_t now, size_t limit) {
+    std::vector<StoredDocKey> ret;
+    std::lock_guard<std::mutex> lh(mutex);
+
+    auto it = index.begin();
+    while (it != index.end() && it->first <= now && ret.size() < limit) {
+        auto& keys = it->second;
+        if (keys.size() <= limit - ret.size()) {
+            // The entire bucket fits within the limit
+            numKeys -= keys.size();
+            if (ret.empty()) {
+                ret = std::move(keys);
+            } else {
+                std::move(keys.begin(), keys.end(), std::back_inserter(ret));
+            }
+            it = index.erase(it);
+        } else {
+            // Partial bucket; pop keys off the back until the limit is
+            // reached and leave the rest for the next harvest.
+            while (ret.size() < limit) {
+                ret.emplace_back(std::move(keys.back()));
+                keys.pop_back();
+                --numKeys;
+            }
+        }
+    }
+
+    return ret;
+}
+
+time_t ExpiryIndex::getNextDeadline() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (index.empty()) {
+        return 0;
+    }
+    return index.begin()->first;
+}
+
+size_t ExpiryIndex::getNumKeys() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return numKeys;
+}
+
+size_t ExpiryIndex::getNumDropped() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return numDropped;
+}
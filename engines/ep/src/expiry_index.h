@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include "storeddockey.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * A time-ordered index over the keys of the items stored in a VBucket
+ * which carry an expiry time.
+ *
+ * The index is populated from the update paths (see VBucket::queueDirty)
+ * and consumed by the ExpiryIndexPager, which pops exactly the keys which
+ * have reached their deadline instead of scanning every item in the
+ * HashTable looking for the (typically few) expired ones.
+ *
+ * The index is advisory: an entry is not removed when the item it was
+ * added for is deleted, or touched with a new expiry time, so a key
+ * popped from the index must be validated against the HashTable before
+ * the item is expired. New entries are dropped (and counted) once the
+ * index reaches its capacity. Items missed because their entry was
+ * dropped (or stale) are picked up by the scan based ExpiredItemPager,
+ * which is retained as a repair path.
+ */
+class ExpiryIndex {
+public:
+    /**
+     * The default maximum number of keys held by the index. Bounds the
+     * memory the index may pin on a vbucket which sees a burst of
+     * mutations with an expiry time.
+     */
+    static const size_t defaultCapacity = 65536;
+
+    explicit ExpiryIndex(size_t capacity = defaultCapacity)
+        : capacity(capacity), numKeys(0), numDropped(0) {
+    }
+
+    /**
+     * Add a key to the index with the given deadline. If the index is
+     * full the key is dropped (and accounted for in getNumDropped()).
+     *
+     * @param exptime the time at which the item expires
+     * @param key the key of the item
+     */
+    void add(time_t exptime, const DocKey& key);
+
+    /**
+     * Pop (up to limit) keys whose deadline has passed.
+     *
+     * @param now the current time
+     * @param limit the maximum number of keys to pop
+     * @return the keys which have reached their deadline
+     */
+    std::vector<StoredDocKey> harvest(time_t now, size_t limit);
+
+    /**
+     * Get the earliest deadline held by the index
+     *
+     * @return the deadline, or 0 if the index is empty
+     */
+    time_t getNextDeadline() const;
+
+    /** Get the current number of keys held by the index */
+    size_t getNumKeys() const;
+
+    /** Get the total number of keys dropped because the index was full */
+    size_t getNumDropped() const;
+
+private:
+    /** The maximum number of keys the index may hold */
+    const size_t capacity;
+
+    /** The current number of keys held in the index */
+    size_t numKeys;
+
+    /** Total number of keys dropped because the index was full */
+    size_t numDropped;
+
+    /**
+     * The keys with a pending deadline, bucketed by their expiry time
+     * (at the natural one second granularity of exptime)
+     */
+    std::map<time_t, std::vector<StoredDocKey>> index;
+
+    /** Mutex protecting all of the members above */
+    mutable std::mutex mutex;
+};
@@ -188,7 +188,7 @@ bool Flusher::step(GlobalTask *task) {
         return true;
 
     case State::Running:
-        flushVB();
+        flushGroup();
         if (_state == State::Running) {
             double tosleep = computeMinSleepTime();
             if (tosleep > 0) {
@@ -230,12 +230,29 @@ double Flusher::computeMinSleepTime() {
     return std::min(minSleepTime, DEFAULT_MAX_SLEEP_TIME);
 }
 
-void Flusher::flushVB(void) {
+void Flusher::flushGroup() {
+    size_t itemsFlushed = 0;
+    size_t groupSize = 0;
+    do {
+        int flushed = flushVB();
+        if (flushed == RETRY_FLUSH_VBUCKET) {
+            // vbucket was locked and has been re-queued; yield to the
+            // scheduler rather than spinning on it.
+            return;
+        }
+        itemsFlushed += flushed;
+        ++groupSize;
+    } while (!canSnooze() && _state == State::Running &&
+             itemsFlushed < FLUSHER_GROUP_ITEM_BUDGET &&
+             groupSize < FLUSHER_GROUP_MAX_VBUCKETS);
+}
+
+int Flusher::flushVB(void) {
     if (store->isDeleteAllScheduled() && shard->getId() != EP_PRIMARY_SHARD) {
         // another shard is doing disk flush
         bool inverse = false;
         pendingMutation.compare_exchange_strong(inverse, true);
-        return;
+        return 0;
     }
 
     if (lpVbs.empty()) {
@@ -266,21 +283,25 @@ void Flusher::flushVB(void) {
     if (hpVbs.empty() && lpVbs.empty()) {
         LOG(EXTENSION_LOG_INFO,
             "Flusher::flushVB: Trying to flush but no vbuckets exist");
-        return;
+        return 0;
     } else if (!hpVbs.empty()) {
         uint16_t vbid = hpVbs.front();
         hpVbs.pop();
-        if (store->flushVBucket(vbid) == RETRY_FLUSH_VBUCKET) {
+        int flushed = store->flushVBucket(vbid);
+        if (flushed == RETRY_FLUSH_VBUCKET) {
             hpVbs.push(vbid);
         }
+        return flushed;
     } else {
         if (doHighPriority && --numHighPriority == 0) {
             doHighPriority = false;
         }
         uint16_t vbid = lpVbs.front();
         lpVbs.pop();
-        if (store->flushVBucket(vbid) == RETRY_FLUSH_VBUCKET) {
+        int flushed = store->flushVBucket(vbid);
+        if (flushed == RETRY_FLUSH_VBUCKET) {
             lpVbs.push(vbid);
         }
+        return flushed;
     }
 }
@@ -35,6 +35,18 @@
 const double DEFAULT_MIN_SLEEP_TIME = MIN_SLEEP_TIME;
 const double DEFAULT_MAX_SLEEP_TIME = 10.0;
 
+/**
+ * Budget of items a single flusher scheduling quantum may write before
+ * yielding back to the scheduler - see Flusher::flushGroup().
+ */
+const size_t FLUSHER_GROUP_ITEM_BUDGET = 10000;
+
+/**
+ * Upper bound on the number of vbuckets flushed in a single scheduling
+ * quantum, regardless of how few items each contributes.
+ */
+const size_t FLUSHER_GROUP_MAX_VBUCKETS = 16;
+
 class KVShard;
 
 /**
@@ -96,7 +108,30 @@ private:
 
     bool transitionState(State to);
     bool validTransition(State to) const;
-    void flushVB();
+
+    /**
+     * Flush a group of vbuckets in one scheduling quantum.
+     *
+     * Flushing one vbucket per quantum means each small per-vbucket batch
+     * pays a full write + commit round-trip to disk on its own; with many
+     * lightly-loaded vbuckets per shard the disk is bound by commit count,
+     * not bandwidth. Instead keep flushing vbuckets back-to-back until
+     * FLUSHER_GROUP_ITEM_BUDGET items have been written (or
+     * FLUSHER_GROUP_MAX_VBUCKETS vbuckets visited, or the queues drain), so
+     * the group size adapts to the outstanding write volume: small batches
+     * are coalesced into one disk-busy period, while a single deep batch
+     * consumes the whole budget on its own.
+     */
+    void flushGroup();
+
+    /**
+     * Flush the next pending vbucket (high priority first).
+     *
+     * @return number of items flushed, or RETRY_FLUSH_VBUCKET if the vbucket
+     *         was locked and has been re-queued.
+     */
+    int flushVB();
+
     void completeFlush();
     void initialize();
     void schedule_UNLOCKED();
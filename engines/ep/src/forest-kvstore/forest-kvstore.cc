@@ -1226,6 +1226,7 @@ void ForestKVStore::get(const DocKey& key, uint16_t vb,
 ENGINE_ERROR_CODE
 ForestKVStore::getAllKeys(uint16_t vbid,
                           const DocKey start_key,
+                          const DocKey end_key,
                           uint32_t count,
                           std::shared_ptr<Callback<const DocKey&>> cb) {
 
@@ -1238,10 +1239,12 @@ ForestKVStore::getAllKeys(uint16_t vbid,
         return ENGINE_FAILED;
     }
 
+    // ForestDB iterators support an (inclusive) end key natively.
     fdb_iterator* fdb_iter = NULL;
     fdb_status status = fdb_iterator_init(fkvsHandle->getKvsHandle(), &fdb_iter,
                                           start_key.data(), start_key.size(),
-                                          NULL, 0, FDB_ITR_NO_DELETES);
+                                          end_key.size() ? end_key.data() : NULL,
+                                          end_key.size(), FDB_ITR_NO_DELETES);
     if (status != FDB_RESULT_SUCCESS) {
         throw std::runtime_error("ForestKVStore::getAllKeys: iterator "
                    "initalization failed for vbucket id " + std::to_string(vbid) +
@@ -1471,7 +1474,10 @@ ScanContext* ForestKVStore::initScanContext(std::shared_ptr<Callback<GetValue> >
                                            std::shared_ptr<Callback<CacheLookup> > cl,
                                            uint16_t vbid, uint64_t startSeqno,
                                            DocumentFilter options,
-                                           ValueFilter valOptions) {
+                                           ValueFilter valOptions,
+                                           ScanOrder scanOrder) {
+    // ForestDB scans only by sequence; a BY_ID request falls back to
+    // sequence order (the order is advisory only).
     std::unique_ptr<ForestKvsHandle> fkvsHandle;
     try {
         fkvsHandle = createKvsHandle(vbid);
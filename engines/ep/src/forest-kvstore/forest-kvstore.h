@@ -388,14 +388,17 @@ class ForestKVStore : public KVStore
 
     ENGINE_ERROR_CODE getAllKeys(uint16_t vbid,
                                  const DocKey start_key,
+                                 const DocKey end_key,
                                  uint32_t count,
                                  std::shared_ptr<Callback<const DocKey&>> cb) override;
 
-    ScanContext *initScanContext(std::shared_ptr<Callback<GetValue> > cb,
-                                 std::shared_ptr<Callback<CacheLookup> > cl,
-                                 uint16_t vbid, uint64_t startSeqno,
-                                 DocumentFilter options,
-                                 ValueFilter valOptions) override;
+    ScanContext *initScanContext(
+            std::shared_ptr<Callback<GetValue> > cb,
+            std::shared_ptr<Callback<CacheLookup> > cl,
+            uint16_t vbid, uint64_t startSeqno,
+            DocumentFilter options,
+            ValueFilter valOptions,
+            ScanOrder scanOrder = ScanOrder::BY_SEQNO) override;
 
     scan_error_t scan(ScanContext* sctx) override;
 
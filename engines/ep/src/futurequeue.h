@@ -22,6 +22,15 @@
  *
  * FutureQueue provides methods that allow a task's wakeTime to be mutated
  * whilst maintaining the priority ordering.
+ *
+ * Internally the queue is a binary heap of {wakeTime, task} entries using
+ * lazy deletion: snooze/updateWaketime invalidate the task's existing
+ * entries in O(1) (by bumping a per-task generation) and push a fresh
+ * entry in O(log n), rather than linearly searching for the task and
+ * rebuilding the whole heap in O(n). Stale entries are discarded when
+ * they surface at top() and the heap is compacted once they dominate it,
+ * so re-arming cost is amortised O(log n) regardless of how many tasks
+ * are scheduled or how often they adjust their wake times.
  */
 
 #pragma once
@@ -30,108 +39,179 @@
 #include <mutex>
 #include <platform/processclock.h>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 #include "globaltask.h"
 
-template <class C = std::deque<ExTask>,
-          class Compare = CompareByDueDate>
 class FutureQueue {
 public:
 
     void push(ExTask task) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        queue.push(task);
+        TaskEntryState& state = tasks[task->getId()];
+        if (state.liveEntries == 0) {
+            state.generation = ++lastGeneration;
+        }
+        state.liveEntries++;
+        queue.push({task->getWaketime(), state.generation, task});
     }
 
     void pop() {
         std::lock_guard<std::mutex> lock(queueMutex);
+        discardStaleTop();
+        if (queue.empty()) {
+            return;
+        }
+        auto it = tasks.find(queue.top().task->getId());
+        if (it != tasks.end() && --it->second.liveEntries == 0) {
+            tasks.erase(it);
+        }
         queue.pop();
     }
 
     ExTask top() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.top();
+        discardStaleTop();
+        return queue.top().task;
     }
 
     size_t size() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.size();
+        return queue.size() - staleEntries;
     }
 
     bool empty() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.empty();
+        return (queue.size() - staleEntries) == 0;
     }
 
     /*
-     * Update the wakeTime of task and ensure the heap property is
-     * maintained.
+     * Update the wakeTime of task and re-arm it so the priority ordering
+     * is maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
     bool updateWaketime(const ExTask& task, ProcessClock::time_point newTime) {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->updateWaketime(newTime);
-        // After modifiying the task's wakeTime, rebuild the heap
-        return queue.heapify(task);
+        return rearm(task);
     }
 
     /*
-     * snooze the task (by altering its wakeTime) and ensure the
-     * heap property is maintained.
+     * snooze the task (by altering its wakeTime) and re-arm it so the
+     * priority ordering is maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
     bool snooze(const ExTask& task, const double secs) {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->snooze(secs);
-        // After modifiying the task's wakeTime, rebuild the heap
-        return queue.heapify(task);
+        return rearm(task);
     }
 
 protected:
 
+    struct Entry {
+        // The task's wakeTime when this entry was (re)armed; the task's
+        // live wakeTime may have moved on since, in which case the entry
+        // is stale (its generation no longer matches) and is discarded
+        // when it reaches the top of the heap.
+        ProcessClock::time_point wakeTime;
+        uint64_t generation;
+        ExTask task;
+    };
+
+    struct CompareEntryByDueDate {
+        bool operator()(const Entry& e1, const Entry& e2) const {
+            return e2.wakeTime < e1.wakeTime;
+        }
+    };
+
+    /*
+     * Per-task arming state, keyed by task id. A heap entry is valid iff
+     * its generation matches the task's current generation; bumping the
+     * generation invalidates all of a task's entries in O(1). Generations
+     * are allocated from a single monotonic counter so an id which leaves
+     * and later re-enters the queue can never revalidate an old entry.
+     */
+    struct TaskEntryState {
+        uint64_t generation = 0;
+        size_t liveEntries = 0;
+    };
+
+    bool isStale(const Entry& entry) const {
+        auto it = tasks.find(entry.task->getId());
+        return it == tasks.end() || it->second.generation != entry.generation;
+    }
+
+    void discardStaleTop() {
+        while (!queue.empty() && isStale(queue.top())) {
+            queue.pop();
+            --staleEntries;
+        }
+    }
+
+    /*
+     * Invalidate any existing entries for task and push a fresh one
+     * carrying its current wakeTime.
+     * @returns true if 'task' is in the FutureQueue.
+     */
+    bool rearm(const ExTask& task) {
+        auto it = tasks.find(task->getId());
+        if (it == tasks.end()) {
+            return false;
+        }
+        staleEntries += it->second.liveEntries;
+        it->second.generation = ++lastGeneration;
+        it->second.liveEntries = 1;
+        queue.push({task->getWaketime(), it->second.generation, task});
+        maybeCompact();
+        return true;
+    }
+
+    /*
+     * Reclaim invalidated entries once they dominate the heap, so tasks
+     * which re-arm frequently (e.g. item pager, checkpoint remover)
+     * cannot grow it without bound. The O(n) rebuild reclaims at least
+     * half of the heap, making it amortised O(1) per re-arm.
+     */
+    void maybeCompact() {
+        if (staleEntries > minCompactionSize &&
+            staleEntries > queue.size() / 2) {
+            queue.removeIf(
+                    [this](const Entry& entry) { return isStale(entry); });
+            staleEntries = 0;
+        }
+    }
+
     /*
-     * HeapifiableQueue exposes a method to maintain the heap ordering
-     * of the underlying queue.
+     * CompactableQueue exposes a method to bulk-remove stale entries from
+     * the underlying container.
      *
      * This class is deliberately hidden inside FutureQueue so that any
      * extensions made to priority_queue can't be accessed without work.
-     * I.e. correct locking and any need to 'heapify'.
+     * I.e. correct locking and the stale-entry accounting.
      */
-    class HeapifiableQueue : public std::priority_queue<ExTask, C, Compare> {
+    class CompactableQueue : public std::priority_queue<Entry,
+                                                        std::vector<Entry>,
+                                                        CompareEntryByDueDate> {
     public:
-        /*
-         * Ensure the heap property is maintained
-         * @returns true if 'task' is in the queue and heapify() did something.
-         */
-        bool heapify(const ExTask& task) {
-            // if the task exists, rebuild
-            if (exists(task)) {
-                if (this->c.back()->getId() == task->getId()) {
-                    std::push_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
-                } else {
-                    std::make_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
-                }
-                return true;
-            } else {
-                return false;
-            }
-        }
-
-    protected:
-        bool exists(const ExTask& task) {
-            return std::find_if(this->c.begin(),
-                                this->c.end(),
-                                [&task](const ExTask& qTask) {
-                                    return task->getId() == qTask->getId();
-                                }) != this->c.end();
+        template <class Predicate>
+        void removeIf(Predicate pred) {
+            this->c.erase(
+                    std::remove_if(this->c.begin(), this->c.end(), pred),
+                    this->c.end());
+            std::make_heap(this->c.begin(), this->c.end(), this->comp);
         }
 
     } queue;
 
+    // Don't bother compacting trivially small heaps.
+    static const size_t minCompactionSize = 32;
+
+    std::unordered_map<size_t, TaskEntryState> tasks;
+    uint64_t lastGeneration = 0;
+    size_t staleEntries = 0;
+
     // All access to queue must be done with the queueMutex
     std::mutex queueMutex;
 };
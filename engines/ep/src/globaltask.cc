@@ -80,6 +80,10 @@ void GlobalTask::wakeUp() {
     updateWaketime(ProcessClock::now());
 }
 
+uint64_t GlobalTask::getChargedRunTime() const {
+    return taskable.getWorkLoadPolicy().getChargedRunTime();
+}
+
 /*
  * Generate a switch statement from tasks.def.h that maps TaskId to a
  * stringified value of the task's name.
@@ -177,6 +177,15 @@ public:
         return taskable;
     }
 
+    /**
+     * Weighted CPU time charged so far against this task's owning bucket
+     * (see WorkLoadPolicy::chargeRunTime); used by CompareByPriority to
+     * order equal-priority tasks of different buckets fairly.
+     *
+     * Defined out-of-line as Taskable is only forward declared here.
+     */
+    uint64_t getChargedRunTime() const;
+
     ProcessClock::time_point getWaketime() const {
         const auto waketime_chrono = std::chrono::nanoseconds(waketime);
         return ProcessClock::time_point(waketime_chrono);
@@ -281,9 +290,18 @@ typedef std::shared_ptr<GlobalTask> ExTask;
 class CompareByPriority {
 public:
     bool operator()(ExTask &t1, ExTask &t2) {
-        return (t1->getQueuePriority() == t2->getQueuePriority()) ?
-               (t1->uid > t2->uid) :
-               (t1->getQueuePriority() > t2->getQueuePriority());
+        if (t1->getQueuePriority() != t2->getQueuePriority()) {
+            return t1->getQueuePriority() > t2->getQueuePriority();
+        }
+        // Equal task priority: prefer the task whose bucket has consumed
+        // the least weighted executor CPU time, so one bucket's backlog
+        // cannot starve a neighbouring bucket's equal-priority work.
+        const uint64_t c1 = t1->getChargedRunTime();
+        const uint64_t c2 = t2->getChargedRunTime();
+        if (c1 != c2) {
+            return c1 > c2;
+        }
+        return t1->uid > t2->uid;
     }
 };
 
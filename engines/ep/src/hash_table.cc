@@ -22,7 +22,9 @@
 #include "stored_value_factories.h"
 
 #include <phosphor/phosphor.h>
+#include <platform/sysinfo.h>
 
+#include <algorithm>
 #include <cstring>
 
 static const ssize_t prime_size_table[] = {
@@ -38,6 +40,30 @@ std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
     return os;
 }
 
+size_t HashTable::getNumBuckets(size_t s) {
+    // Default matches the ht_size configuration default.
+    return s == 0 ? 47 : s;
+}
+
+size_t HashTable::getNumLocks(size_t s) {
+    if (s != 0) {
+        return s;
+    }
+    // Size the lock stripe count relative to the machine - the more cores,
+    // the more front-end and background threads can contend on a single
+    // vbucket. Aim for four stripes per core (keeping the probability of
+    // two hot keys sharing a stripe low), rounded up to a prime, with the
+    // old fixed default (47) as a floor.
+    const ssize_t target = std::max(
+            ssize_t(47), ssize_t(4 * Couchbase::get_available_cpu_count()));
+    for (int i = 0; prime_size_table[i] != -1; ++i) {
+        if (prime_size_table[i] >= target) {
+            return prime_size_table[i];
+        }
+    }
+    return target;
+}
+
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
@@ -45,9 +71,12 @@ HashTable::HashTable(EPStats& st,
     : datatypeCounts(),
       cacheSize(0),
       metaDataMemory(0),
-      initialSize(initialSize),
-      size(initialSize),
-      mutexes(locks),
+      initialSize(getNumBuckets(initialSize)),
+      size(this->initialSize),
+      resizeOldSize(0),
+      resizeSplitPos(0),
+      mutexes(getNumLocks(locks)),
+      depthCounts(getNumLocks(locks)),
       stats(st),
       valFact(std::move(svFactory)),
       visitors(0),
@@ -61,9 +90,46 @@ HashTable::HashTable(EPStats& st,
       memSize(0),
       maxDeletedRevSeqno(0) {
     values.resize(size);
+    resetDepthCounts(size);
     activeState = true;
 }
 
+const size_t HashTable::maxTrackedDepth;
+
+void HashTable::resetDepthCounts(size_t newSize) {
+    const size_t numStripes = mutexes.size();
+    for (size_t s = 0; s < numStripes; ++s) {
+        for (auto& count : depthCounts[s]) {
+            count.store(0);
+        }
+        // Buckets are striped round-robin over the mutexes; stripes below
+        // the remainder guard one extra bucket.
+        depthCounts[s][0].store((newSize / numStripes) +
+                                (s < (newSize % numStripes) ? 1 : 0));
+    }
+}
+
+HashTable::DepthStats HashTable::getDepthStats() const {
+    DepthStats ds;
+    ds.bucketsAtDepth.resize(maxTrackedDepth + 1, 0);
+    for (const auto& stripe : depthCounts) {
+        for (size_t d = 0; d <= maxTrackedDepth; ++d) {
+            ds.bucketsAtDepth[d] += stripe[d].load();
+        }
+    }
+    bool any = false;
+    for (size_t d = 0; d <= maxTrackedDepth; ++d) {
+        if (ds.bucketsAtDepth[d] > 0) {
+            if (!any) {
+                ds.minDepth = d;
+                any = true;
+            }
+            ds.maxDepth = d;
+        }
+    }
+    return ds;
+}
+
 HashTable::~HashTable() {
     // Use unlocked clear for the destructor, avoids lock inversions on VBucket
     // delete
@@ -116,6 +182,7 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
 
     stats.currentSize.fetch_sub(clearedMemSize - clearedValSize);
 
+    resetDepthCounts(size);
     datatypeCounts.fill(0);
     numTotalItems.store(0);
     numItems.store(0);
@@ -125,6 +192,52 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
     cacheSize.store(0);
 }
 
+size_t HashTable::clearBudgeted(size_t budget) {
+    MultiLockHolder mlh(mutexes);
+    if (isActive()) {
+        setActiveState(false);
+    }
+
+    size_t clearedMemSize = 0;
+    size_t clearedValSize = 0;
+    size_t released = 0;
+    // Buckets emptied by a previous call are left as null pointers, so
+    // re-scanning from the start costs one pointer check per bucket.
+    for (size_t i = 0; i < size && released < budget; ++i) {
+        size_t releasedFromBucket = 0;
+        while (values[i] && released < budget) {
+            // Take ownership of the StoredValue from the vector, update
+            // statistics and release it.
+            auto v = std::move(values[i]);
+            clearedMemSize += v->size();
+            clearedValSize += v->valuelen();
+            values[i] = std::move(v->getNext());
+            ++released;
+            ++releasedFromBucket;
+        }
+        if (releasedFromBucket > 0) {
+            const size_t remaining = chainLength(i);
+            depthChanged(i, releasedFromBucket + remaining, remaining);
+        }
+    }
+
+    stats.currentSize.fetch_sub(clearedMemSize - clearedValSize);
+
+    if (released < budget) {
+        // Scanned the whole table without exhausting the budget - it is
+        // now empty, so reset the aggregate counters.
+        datatypeCounts.fill(0);
+        numTotalItems.store(0);
+        numItems.store(0);
+        numTempItems.store(0);
+        numNonResidentItems.store(0);
+        memSize.store(0);
+        cacheSize.store(0);
+    }
+
+    return released;
+}
+
 static size_t distance(size_t a, size_t b) {
     return std::max(a, b) - std::min(a, b);
 }
@@ -139,6 +252,14 @@ static bool isCurrently(size_t size, ssize_t a, ssize_t b) {
 }
 
 void HashTable::resize() {
+    if (resizeOldSize.load() != 0) {
+        // A previous incremental resize still has buckets to migrate
+        // (it pauses while any visitor is registered); resume it rather
+        // than considering a new size.
+        continueIncrementalResize();
+        return;
+    }
+
     size_t ni = getNumInMemoryItems();
     int i(0);
     size_t new_size(0);
@@ -166,6 +287,23 @@ void HashTable::resize() {
         new_size = nearest(ni, prime_size_table[i-1], prime_size_table[i]);
     }
 
+    const size_t numLocks = mutexes.size();
+    if (new_size > size && (size % numLocks) == 0) {
+        // The current size permits resizing incrementally (see
+        // resizeIncremental); grow by the smallest doubling of the
+        // current size which reaches the chosen target so the new size
+        // is an integer multiple of the old one.
+        size_t doubled = size;
+        while (doubled < new_size) {
+            doubled *= 2;
+        }
+        new_size = doubled;
+    } else if (new_size != size && (new_size % numLocks) != 0) {
+        // Round the target up to a multiple of the lock count so that
+        // the *next* resize can be performed incrementally.
+        new_size += numLocks - (new_size % numLocks);
+    }
+
     resize(new_size);
 }
 
@@ -186,6 +324,20 @@ void HashTable::resize(size_t newSize) {
         return;
     }
 
+    // A previous incremental resize may still be migrating buckets;
+    // don't start another resize until it has completed.
+    if (resizeOldSize.load() != 0) {
+        return;
+    }
+
+    if (newSize > size && (newSize % size) == 0 &&
+        (size % mutexes.size()) == 0) {
+        // We can grow without holding every lock for the duration of the
+        // rehash - see resizeIncremental for the constraints.
+        resizeIncremental(newSize);
+        return;
+    }
+
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
@@ -225,9 +377,131 @@ void HashTable::resize(size_t newSize) {
     // Finally assign the new table to values.
     values = std::move(newValues);
 
+    // Rebuild the depth counters for the new bucket layout (we hold every
+    // lock here; the table was just rehashed anyway so this doesn't alter
+    // the complexity of resizing).
+    resetDepthCounts(size);
+    for (size_t i = 0; i < size; ++i) {
+        const size_t depth = chainLength(i);
+        if (depth > 0) {
+            depthChanged(i, 0, depth);
+        }
+    }
+
     stats.memOverhead->fetch_add(memorySize());
 }
 
+void HashTable::resizeIncremental(size_t newSize) {
+    TRACE_EVENT2("HashTable",
+                 "resizeIncremental",
+                 "size",
+                 size.load(),
+                 "newSize",
+                 newSize);
+
+    const size_t oldSize = size;
+    {
+        MultiLockHolder mlh(mutexes);
+        if (visitors.load() > 0) {
+            // Do not allow a resize while any visitors are actually
+            // processing. The next attempt will have to pick it up.
+            return;
+        }
+
+        stats.memOverhead->fetch_sub(memorySize());
+        ++numResizes;
+
+        // Grow the bucket array; the additional buckets are initially
+        // empty. Publishing resizeOldSize (while holding every lock)
+        // makes getBucketForHash() consult the split position - all old
+        // buckets still use the old mapping at this point.
+        values.resize(newSize);
+        resizeSplitPos.store(0);
+        resizeOldSize.store(oldSize);
+        size.store(newSize);
+
+        // Account the newly-added (empty) buckets; both sizes are
+        // multiples of the lock count so they spread evenly over stripes.
+        const size_t emptyPerStripe = (newSize - oldSize) / mutexes.size();
+        for (auto& stripe : depthCounts) {
+            stripe[0].store(stripe[0].load() + emptyPerStripe);
+        }
+
+        stats.memOverhead->fetch_add(memorySize());
+    }
+
+    continueIncrementalResize();
+}
+
+void HashTable::continueIncrementalResize() {
+    const size_t oldSize = resizeOldSize.load();
+    if (oldSize == 0) {
+        return;
+    }
+
+    // Migrate one old bucket at a time, holding just that bucket's lock.
+    // As the new size is a multiple of oldSize, the elements of bucket i
+    // can only rehash to buckets i + j * oldSize; and as the lock count
+    // divides oldSize, all of those buckets are guarded by the same
+    // mutex as bucket i. Hence both the split and any concurrent access
+    // to the affected keys serialise on that one mutex, and frontend
+    // operations wait for (at most) a single bucket to be rehashed.
+    const size_t newSize = size;
+    for (size_t i = resizeSplitPos.load(); isActive() && i < oldSize; ++i) {
+        // Visitors expect to encounter each element exactly once, so
+        // never move one while a visitor is registered. Registration is
+        // performed while holding mutexes[0] (see visit()); acquiring it
+        // here makes the check race-free. On pause we simply return with
+        // both mappings still alive; a later resize() call resumes the
+        // migration from the split position.
+        std::lock_guard<std::mutex> vh(mutexes[0]);
+        if (visitors.load() > 0) {
+            return;
+        }
+
+        const size_t lockNum = mutexForBucket(i);
+        std::unique_lock<std::mutex> lh;
+        if (lockNum != 0) {
+            lh = std::unique_lock<std::mutex>(mutexes[lockNum]);
+        }
+
+        StoredValue::UniquePtr chain = std::move(values[i]);
+        size_t oldDepth = 0;
+        while (chain) {
+            // unlink the front element from the chain.
+            auto v = std::move(chain);
+            chain = std::move(v->getNext());
+            ++oldDepth;
+
+            // And re-link it into its new bucket.
+            int newBucket = abs(static_cast<int>(v->getKey().hash()) %
+                                static_cast<int>(newSize));
+            v->setNext(std::move(values[newBucket]));
+            values[newBucket] = std::move(v);
+        }
+        if (oldDepth > 0) {
+            // Re-account bucket i's chain against the buckets it split
+            // into; all of them (i + j * oldSize) live on this stripe.
+            depthChanged(i, oldDepth, 0);
+            for (size_t b = i; b < newSize; b += oldSize) {
+                const size_t depth = chainLength(b);
+                if (depth > 0) {
+                    depthChanged(b, 0, depth);
+                }
+            }
+        }
+        resizeSplitPos.store(i + 1);
+    }
+
+    // Migration complete; revert to the plain (single) mapping. Note
+    // resizeSplitPos is deliberately left at oldSize (it is reset by the
+    // next incremental resize while holding every lock): a reader racing
+    // with this store which still observes the old resizeOldSize then
+    // finds every bucket below the split position and correctly uses the
+    // new mapping.
+    resizeOldSize.store(0);
+}
+
 StoredValue* HashTable::find(const DocKey& key,
                              TrackReference trackReference,
                              WantsDeleted wantsDeleted) {
@@ -239,8 +513,63 @@ StoredValue* HashTable::find(const DocKey& key,
     return unlocked_find(key, hbl.getBucketNum(), wantsDeleted, trackReference);
 }
 
+// Chain-length rejection bound for random sampling. A probed bucket is
+// accepted with probability chainLength / this value, which makes every
+// item equally likely to be selected irrespective of how long its chain
+// is. Chains deeper than this are marginally under-sampled; at the load
+// factors the resizer maintains such chains are vanishingly rare.
+static const size_t RANDOM_SAMPLE_MAX_CHAIN = 8;
+
+// Upper bound on rejection-sampling probes per requested sample before
+// getRandomKey falls back to a linear scan (and getRandomKeys gives up).
+static const size_t RANDOM_SAMPLE_MAX_ATTEMPTS = 64;
+
+std::unique_ptr<Item> HashTable::randomSampleAttempt(std::minstd_rand& rng) {
+    const size_t bucket = rng() % size;
+    auto lh = getLockedBucket(bucket);
+    if (bucket >= size) {
+        // Lost a race with a concurrent shrink; just reject this probe.
+        return nullptr;
+    }
+
+    size_t chainLen = 0;
+    for (StoredValue* v = values[bucket].get(); v; v = v->getNext().get()) {
+        ++chainLen;
+    }
+    if (chainLen == 0) {
+        return nullptr;
+    }
+
+    // Accept the bucket with probability chainLen / MAX_CHAIN (see above).
+    if (rng() % RANDOM_SAMPLE_MAX_CHAIN >= chainLen) {
+        return nullptr;
+    }
+
+    // Select a uniform position within the chain.
+    StoredValue* v = values[bucket].get();
+    for (size_t pos = rng() % chainLen; pos > 0; --pos) {
+        v = v->getNext().get();
+    }
+
+    if (!v->isTempItem() && !v->isDeleted() && v->isResident()) {
+        return v->toItem(false, 0);
+    }
+    return nullptr;
+}
+
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
-    /* Try to locate a partition */
+    std::minstd_rand rng(static_cast<uint32_t>(rnd));
+
+    for (size_t attempt = 0; attempt < RANDOM_SAMPLE_MAX_ATTEMPTS;
+         ++attempt) {
+        auto ret = randomSampleAttempt(rng);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    // Degenerate table (near-empty, or mostly deleted / non-resident) -
+    // fall back to a linear scan so an item is still found if one exists.
     size_t start = rnd % size;
     size_t curr = start;
     std::unique_ptr<Item> ret;
@@ -255,6 +584,22 @@ std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
     return ret;
 }
 
+std::vector<std::unique_ptr<Item>> HashTable::getRandomKeys(size_t count,
+                                                            long rnd) {
+    std::vector<std::unique_ptr<Item>> items;
+    std::minstd_rand rng(static_cast<uint32_t>(rnd));
+
+    const size_t maxAttempts = count * RANDOM_SAMPLE_MAX_ATTEMPTS;
+    for (size_t attempt = 0; items.size() < count && attempt < maxAttempts;
+         ++attempt) {
+        auto itm = randomSampleAttempt(rng);
+        if (itm) {
+            items.push_back(std::move(itm));
+        }
+    }
+    return items;
+}
+
 MutationStatus HashTable::set(Item& val) {
     HashBucketLock hbl = getLockedBucket(val.getKey());
     StoredValue* v = unlocked_find(val.getKey(),
@@ -351,6 +696,9 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
     }
     values[hbl.getBucketNum()] = std::move(v);
 
+    const size_t depth = chainLength(hbl.getBucketNum());
+    depthChanged(hbl.getBucketNum(), depth - 1, depth);
+
     return values[hbl.getBucketNum()].get();
 }
 
@@ -391,6 +739,9 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
     }
     values[hbl.getBucketNum()] = std::move(newSv);
 
+    const size_t depth = chainLength(hbl.getBucketNum());
+    depthChanged(hbl.getBucketNum(), depth - 1, depth);
+
     return {values[hbl.getBucketNum()].get(), std::move(releasedSv)};
 }
 
@@ -428,7 +779,23 @@ StoredValue* HashTable::unlocked_find(const DocKey& key,
                                       int bucket_num,
                                       WantsDeleted wantsDeleted,
                                       TrackReference trackReference) {
-    for (StoredValue* v = values[bucket_num].get(); v; v = v->getNext().get()) {
+    StoredValue* v = values[bucket_num].get();
+
+    // When multiple values hash to this bucket, comparing the full key of
+    // every element in the chain requires fetching the key bytes at the
+    // tail of each StoredValue - typically in a different cache line to
+    // the chain pointer. Pre-filter on the 8-bit key fingerprint (held in
+    // the fixed part of the StoredValue) so non-matching elements are
+    // skipped without touching their keys. Skipped for single-element
+    // chains where there is nothing to filter.
+    const bool chained = (v != nullptr) && v->getNext();
+    const uint8_t fingerprint =
+            chained ? StoredValue::getKeyFingerprint(key) : 0;
+
+    for (; v; v = v->getNext().get()) {
+        if (chained && v->getKeyFingerprint() != fingerprint) {
+            continue;
+        }
         if (v->hasKey(key)) {
             if (trackReference == TrackReference::Yes && !v->isDeleted()) {
                 v->referenced();
@@ -474,6 +841,9 @@ StoredValue::UniquePtr HashTable::unlocked_release(
                 "not found in HashTable; possibly HashTable leak");
     }
 
+    const size_t depth = chainLength(hbl.getBucketNum());
+    depthChanged(hbl.getBucketNum(), depth + 1, depth);
+
     // Update statistics now the item has been removed.
     reduceCacheSize(released->size());
     reduceMetaDataSize(stats, released->metaDataSize());
@@ -583,7 +953,11 @@ void HashTable::visit(HashTableVisitor &visitor) {
             }
             while (v) {
                 StoredValue* tmp = v->getNext().get();
-                visitor.visit(lh, *v);
+                if (!visitor.visit(lh, *v)) {
+                    // Visitor requested termination (VisitorTracker
+                    // unregisters us on return).
+                    return;
+                }
                 v = tmp;
             }
             ++visited;
@@ -596,11 +970,19 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
         return;
     }
     size_t visited = 0;
+
+    // Acquire one (any) of the mutexes before incrementing {visitors}, this
+    // prevents any race between this visitor and the HashTable resizer.
+    // See comments in pauseResumeVisit() for further details.
+    std::unique_lock<std::mutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
+    lh.unlock();
 
     for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
-        LockHolder lh(mutexes[l]);
         for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+            // (re)acquire mutex on each HashBucket, to minimise any impact
+            // on front-end threads.
+            LockHolder lh(mutexes[l]);
             size_t depth = 0;
             StoredValue* p = values[i].get();
             if (p) {
@@ -729,6 +1111,9 @@ bool HashTable::unlocked_ejectItem(StoredValue*& vptr,
                     values[bucket_num],
                     [vptr](const StoredValue* v) { return v == vptr; });
 
+            const size_t depth = chainLength(bucket_num);
+            depthChanged(bucket_num, depth + 1, depth);
+
             if (removed->isResident()) {
                 ++stats.numValueEjects;
             }
@@ -845,6 +1230,34 @@ void HashTable::setValue(const Item& itm, StoredValue& v) {
     increaseCacheSize(v.size());
 }
 
+void CompositeHashTableVisitor::addVisitor(HashTableVisitor& visitor) {
+    visitors.push_back({&visitor, true});
+}
+
+bool CompositeHashTableVisitor::visit(const HashTable::HashBucketLock& lh,
+                                      StoredValue& v) {
+    bool anyActive = false;
+    for (auto& entry : visitors) {
+        if (!entry.active) {
+            continue;
+        }
+        if (entry.visitor->wantsVisit(v) && !entry.visitor->visit(lh, v)) {
+            // This visitor has seen enough; drop it from the rest of
+            // the scan without terminating the others.
+            entry.active = false;
+            continue;
+        }
+        anyActive = true;
+    }
+    return anyActive;
+}
+
+void CompositeHashTableVisitor::reset() {
+    for (auto& entry : visitors) {
+        entry.active = true;
+    }
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
     os << "HashTable[" << &ht << "] with"
        << " numItems:" << ht.getNumItems()
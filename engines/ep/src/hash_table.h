@@ -18,11 +18,16 @@
 #pragma once
 
 #include "config.h"
+#include "hugepage_allocator.h"
 #include "storeddockey.h"
 #include "stored-value.h"
 
 #include <platform/histogram.h>
 #include <platform/non_negative_counter.h>
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <random>
 
 class AbstractStoredValueFactory;
 class HashTableStatVisitor;
@@ -177,8 +182,10 @@ public:
      *
      * @param st the global stats reference
      * @param svFactory Factory to use for constructing stored values
-     * @param initialSize the number of hash table buckets to initially create.
-     * @param locks the number of locks in the hash table
+     * @param initialSize the number of hash table buckets to initially
+     *        create; 0 means use the default (see getNumBuckets()).
+     * @param locks the number of locks in the hash table; 0 means size
+     *        relative to the number of CPU cores (see getNumLocks()).
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
@@ -280,6 +287,22 @@ public:
      */
     void clear(bool deactivate = false);
 
+    /**
+     * Release up to `budget` values from the hash table, deactivating it
+     * on the first call.
+     *
+     * Used by vbucket deletion to reclaim a large hash table in bounded
+     * batches instead of freeing millions of StoredValues in one go,
+     * which would monopolise the allocator and bleed into front-end
+     * latency. Memory accounting is updated per batch; the aggregate
+     * counters are reset once the table is empty.
+     *
+     * @param budget maximum number of values to release in this call
+     * @return the number of values released; a value less than the budget
+     *         means the table is now empty.
+     */
+    size_t clearBudgeted(size_t budget);
+
     /**
      * Get the number of times this hash table has been resized.
      */
@@ -293,12 +316,15 @@ public:
     }
 
     /**
-     * Automatically resize to fit the current data.
+     * Automatically resize to fit the current data. Resumes any paused
+     * incremental resize before considering a new size.
      */
     void resize();
 
     /**
-     * Resize to the specified size.
+     * Resize to the specified size. Growing is performed incrementally
+     * where the constraints of resizeIncremental() allow, otherwise the
+     * whole table is rehashed in one shot while holding every lock.
      */
     void resize(size_t to);
 
@@ -316,13 +342,33 @@ public:
                       WantsDeleted wantsDeleted);
 
     /**
-     * Find a resident item
+     * Sample a random resident item, uniformly across the items in the
+     * table.
+     *
+     * Implemented by rejection sampling - probe a random bucket, accept
+     * it with probability proportional to its chain length, then select a
+     * uniform position in the chain - so each probe is O(1) and the
+     * result is not skewed towards the heads of long chains. Expected
+     * number of probes is inversely proportional to the load factor,
+     * which the resizer keeps around 1; if a (bounded) number of probes
+     * all miss, falls back to a linear scan.
      *
      * @param rnd a randomization input
-     * @return an item -- NULL if not fount
+     * @return an item -- NULL if not found
      */
     std::unique_ptr<Item> getRandomKey(long rnd);
 
+    /**
+     * Sample up to `count` random resident items (see getRandomKey).
+     * Samples are independent, i.e. drawn with replacement - the same
+     * item can appear more than once. May return fewer than `count`
+     * items if the table is (nearly) empty or mostly non-resident.
+     *
+     * @param count maximum number of items to return
+     * @param rnd a randomization input
+     */
+    std::vector<std::unique_ptr<Item>> getRandomKeys(size_t count, long rnd);
+
     /**
      * Set an Item into the this hashtable
      *
@@ -473,6 +519,29 @@ public:
      */
     void visitDepth(HashTableDepthVisitor &visitor);
 
+    /**
+     * Chain-depth statistics. Maintained incrementally as chains are
+     * linked / unlinked (see depthChanged()), so reading them is a
+     * constant-time operation rather than an O(n) scan of the table.
+     */
+    struct DepthStats {
+        /// bucketsAtDepth[d] is the number of buckets whose chain holds
+        /// exactly d items; depths are clamped to maxTrackedDepth.
+        std::vector<size_t> bucketsAtDepth;
+        size_t minDepth = 0;
+        size_t maxDepth = 0;
+    };
+
+    /// Depths at or above this are all accounted to the final bin.
+    static const size_t maxTrackedDepth = 63;
+
+    /**
+     * Read the incrementally-maintained chain-depth statistics. Lock-free;
+     * counters mutated concurrently with the read may be transiently off
+     * by one, which is acceptable for monitoring.
+     */
+    DepthStats getDepthStats() const;
+
     /**
      * Visit the items in this hashtable, starting the iteration from the
      * given startPosition and allowing the visit to be paused at any point.
@@ -512,7 +581,8 @@ public:
     /**
      * Get the number of locks that should be used for initialization.
      *
-     * @param s if 0, return the default number of locks, else return s
+     * @param s if 0, return a lock count sized relative to the number of
+     *          CPU cores, else return s
      */
     static size_t getNumLocks(size_t s);
 
@@ -646,7 +716,10 @@ private:
     void setValue(const Item& itm, StoredValue& v);
 
     // The container for actually holding the StoredValues.
-    using table_type = std::vector<StoredValue::UniquePtr>;
+    // The bucket array spans gigabytes on a loaded node; back it with
+    // huge pages to keep the TLB cost of the chain walks down.
+    using table_type = std::vector<StoredValue::UniquePtr,
+                                   HugePageAllocator<StoredValue::UniquePtr>>;
 
     friend class StoredValue;
     friend std::ostream& operator<<(std::ostream& os, const HashTable& ht);
@@ -661,7 +734,35 @@ private:
     // in `values`
     std::atomic<size_t> size;
     table_type values;
+
+    /**
+     * The previous number of buckets while an incremental resize is in
+     * progress (see resizeIncremental()), or zero when no resize is
+     * migrating. While non-zero, `values` has already been grown to the
+     * new size; old buckets below resizeSplitPos have been rehashed to
+     * the new mapping and the remainder still use the old one.
+     */
+    std::atomic<size_t> resizeOldSize;
+
+    /**
+     * The next old bucket to be migrated by an in-progress incremental
+     * resize. Only meaningful while resizeOldSize is non-zero.
+     */
+    std::atomic<size_t> resizeSplitPos;
+
     std::vector<std::mutex> mutexes;
+
+    /**
+     * Per-stripe bucket-depth counters; outer index is the lock stripe
+     * (bucket % mutexes.size()), inner index the (clamped) chain depth.
+     * Each slot counts the buckets currently at that depth. Writers hold
+     * the owning stripe's mutex; relaxed atomics let stats read the
+     * counters without taking any lock.
+     */
+    std::vector<std::array<Couchbase::RelaxedAtomic<size_t>,
+                           maxTrackedDepth + 1>>
+            depthCounts;
+
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
@@ -686,9 +787,44 @@ private:
     bool                 activeState;
 
     int getBucketForHash(int h) {
+        const size_t oldSize = resizeOldSize.load(std::memory_order_acquire);
+        if (oldSize != 0) {
+            // An incremental resize is in progress. Old buckets below the
+            // split position have been rehashed to the new (current)
+            // size; the rest still use the old mapping. Note the answer
+            // is only stable once the caller holds the bucket's mutex
+            // (which is the same under either mapping - see
+            // resizeIncremental) - getLockedBucketForHash re-checks after
+            // acquiring it.
+            const int oldBucket = abs(h % static_cast<int>(oldSize));
+            if (static_cast<size_t>(oldBucket) >=
+                resizeSplitPos.load(std::memory_order_acquire)) {
+                return oldBucket;
+            }
+        }
         return abs(h % static_cast<int>(size));
     }
 
+    /**
+     * Incrementally grow the table to newSize; requires that newSize is
+     * an integer multiple of the current size and that the lock count
+     * divides the current size. Under those constraints a bucket's chain
+     * only ever splits into buckets guarded by the same mutex, so after
+     * a brief initial phase (growing `values` under every lock) the old
+     * buckets are rehashed one at a time, each under just that bucket's
+     * lock - frontend operations are never blocked for more than one
+     * bucket's worth of work.
+     */
+    void resizeIncremental(size_t newSize);
+
+    /**
+     * Migrate the remaining old buckets of an in-progress incremental
+     * resize (a no-op if none is in progress). Pauses (leaving both
+     * mappings alive) while any visitor is registered; resize() resumes
+     * it on a subsequent invocation.
+     */
+    void continueIncrementalResize();
+
     inline size_t mutexForBucket(size_t bucket_num) {
         if (!isActive()) {
             throw std::logic_error("HashTable::mutexForBucket: Cannot call on a "
@@ -697,8 +833,48 @@ private:
         return bucket_num % mutexes.size();
     }
 
+    /**
+     * Record the chain of `bucket` changing depth from `from` to `to`.
+     * Must be called (under the bucket's lock) wherever a StoredValue is
+     * linked into or unlinked from a chain. Both depths clamp to
+     * maxTrackedDepth, so transitions within the final bin cancel out and
+     * the accounting stays consistent.
+     */
+    void depthChanged(size_t bucket, size_t from, size_t to) {
+        // Note: deliberately not via mutexForBucket() - depths are also
+        // maintained by the clear paths, which run deactivated.
+        auto& counts = depthCounts[bucket % mutexes.size()];
+        --counts[std::min(from, maxTrackedDepth)];
+        ++counts[std::min(to, maxTrackedDepth)];
+    }
+
+    /// Chain length of the given bucket (caller must hold its lock).
+    size_t chainLength(size_t bucket) {
+        size_t len = 0;
+        for (StoredValue* v = values[bucket].get(); v;
+             v = v->getNext().get()) {
+            ++len;
+        }
+        return len;
+    }
+
+    /**
+     * Reset the per-stripe depth counters to those of an empty table of
+     * `newSize` buckets (requires all locks, or exclusive access).
+     */
+    void resetDepthCounts(size_t newSize);
+
     std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
 
+    /**
+     * A single rejection-sampling probe for getRandomKey / getRandomKeys
+     * (see the public doc comments).
+     *
+     * @return the sampled item, or NULL if this probe was rejected (empty
+     *         bucket, chain-length rejection, or ineligible item).
+     */
+    std::unique_ptr<Item> randomSampleAttempt(std::minstd_rand& rng);
+
     /** Searches for the first element in the specified hashChain which matches
      * predicate p, and unlinks it from the chain.
      *
@@ -777,6 +953,61 @@ public:
      * @return true if visiting should continue, false if it should terminate.
      */
     virtual bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) = 0;
+
+    /**
+     * Filter hook consulted (by scans which support it, e.g.
+     * CompositeHashTableVisitor) before visit() is called for a value.
+     * A visitor which only cares about a subset of the values can
+     * override this so the scan skips the callback for the rest.
+     *
+     * @param v the value the scan is positioned at
+     * @return true if visit() should be called for this value
+     */
+    virtual bool wantsVisit(const StoredValue& v) {
+        return true;
+    }
+};
+
+/**
+ * A visitor which lets several HashTableVisitors share one physical
+ * scan of a HashTable. The periodic memory visitors (pagers,
+ * defragmenter, ...) each walk all of memory; when their schedules
+ * coincide, registering them with a composite means the values are
+ * pulled through the cache once instead of once per visitor.
+ *
+ * Each value is offered to every registered visitor in turn (subject
+ * to the visitor's wantsVisit() filter). A visitor returning false
+ * from visit() is dropped from the remainder of the scan without
+ * terminating the others; the scan ends when no visitors remain
+ * active (so a composite with no registered visitors terminates the
+ * scan immediately).
+ */
+class CompositeHashTableVisitor : public HashTableVisitor {
+public:
+    /**
+     * Register a visitor to take part in the scan. The caller retains
+     * ownership and must keep the visitor alive for the duration of
+     * the scan.
+     */
+    void addVisitor(HashTableVisitor& visitor);
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override;
+
+    /**
+     * Prepare for another scan by marking all registered visitors
+     * active again.
+     */
+    void reset();
+
+protected:
+    struct Entry {
+        HashTableVisitor* visitor;
+        /* Cleared when the visitor asks to stop (it is then no longer
+         * offered values for the rest of the scan) */
+        bool active;
+    };
+
+    std::vector<Entry> visitors;
 };
 
 /**
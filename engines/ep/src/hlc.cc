@@ -17,8 +17,35 @@
 
 #include "hlc.h"
 
+#include "ep_time.h"
 #include "statwriter.h"
 
+int64_t HLC::getTime() {
+    static std::atomic<int64_t> cachedTime(0);
+    static std::atomic<rel_time_t> cachedTick(0);
+
+    if (!ep_time_functions_initialized()) {
+        // No clock tick to piggy-back on (e.g. a test driving the HLC
+        // directly) - read the system clock every time.
+        return readSystemClock();
+    }
+
+    const rel_time_t tick = ep_current_time();
+    if (cachedTick.load(std::memory_order_acquire) != tick ||
+        cachedTime.load(std::memory_order_relaxed) == 0) {
+        // The tick has moved on (or we've never read the clock);
+        // refresh the cached timestamp. Concurrent refreshes are benign,
+        // both threads store fresh values. Storing the time before the
+        // tick (release) means a reader which observes the new tick also
+        // observes a timestamp from that tick (or newer).
+        const int64_t now = readSystemClock();
+        cachedTime.store(now, std::memory_order_relaxed);
+        cachedTick.store(tick, std::memory_order_release);
+        return now;
+    }
+    return cachedTime.load(std::memory_order_relaxed);
+}
+
 void HLC::addStats(const std::string& prefix, ADD_STAT add_stat, const void *c) const {
     auto maxCas = getMaxHLC();
     add_prefixed_stat(prefix.data(), "max_cas", maxCas, add_stat, c);
@@ -22,6 +22,7 @@
 #include "atomic.h"
 
 #include <platform/checked_snprintf.h>
+#include <relaxed_atomic.h>
 
 /*
  * HLC manages a hybrid logical clock for 'time' stamping events.
@@ -74,26 +75,32 @@ public:
 
     uint64_t nextHLC() {
         // Create a monotonic timestamp using part of the HLC algorithm by.
-        // a) Reading system time
-        // b) dropping 16-bits (done by nowHLC)
+        // a) Reading the (cached) system time
+        // b) dropping 16-bits (done by getMasked48)
         // c) comparing it with the last known time (max_cas)
         // d) returning either now or max_cas + 1
-        uint64_t timeNow = getMasked48(getTime());
+        const uint64_t timeNow = getMasked48(getTime());
         uint64_t l = maxHLC.load();
-
-        if (timeNow > l) {
-            atomic_setIfBigger(maxHLC, timeNow);
-            return timeNow;
-        }
-        logicalClockTicks++;
-        atomic_setIfBigger(maxHLC, l + 1);
-        return l + 1;
+        do {
+            const uint64_t desired = timeNow > l ? timeNow : l + 1;
+            if (maxHLC.compare_exchange_weak(l, desired)) {
+                if (desired != timeNow) {
+                    logicalClockTicks++;
+                }
+                return desired;
+            }
+            // l has been reloaded with the winner's value; retry the
+            // single fetch-max.
+        } while (true);
     }
 
     void setMaxHLCAndTrackDrift(uint64_t hlc) {
         auto timeNow = getMasked48(getTime());
 
-        // Track the +/- difference between our time and their time
+        // Track the +/- difference between our time and their time.
+        // This is measured against the cached physical clock, so has the
+        // granularity of a clock tick; the thresholds are multiple
+        // seconds so this doesn't affect exception counting.
         int64_t difference = getMasked48(hlc) - timeNow;
 
         // Accumulate the absolute drift in microseconds not nanoseconds.
@@ -177,7 +184,18 @@ private:
         return t & ~((1<<16)-1);
     }
 
-    static int64_t getTime() {
+    /*
+     * Returns the physical clock value (ns since epoch) to stamp with.
+     * Normally a process-wide cached timestamp which is only re-read
+     * from the system clock when the coarse memcached clock (advanced
+     * once a second by the server's clock tick) has moved on, keeping
+     * the system call off the op path. Timestamps handed out within a
+     * tick collide and are disambiguated by the logical (+1) part of
+     * nextHLC.
+     */
+    static int64_t getTime();
+
+    static int64_t readSystemClock() {
         auto now = std::chrono::system_clock::now();
         return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
     }
@@ -191,14 +209,15 @@ private:
 
     /*
      * The following are used for stats/drift tracking.
-     * many threads could be setting cas so they need to be atomically
-     * updated for consisent totals.
+     * many threads could be setting cas so they are updated atomically,
+     * but with relaxed ordering - they are monitoring counters and need
+     * no synchronisation with the surrounding operations.
      */
-    std::atomic<uint64_t> cummulativeDrift;
-    std::atomic<uint64_t> cummulativeDriftIncrements;
-    std::atomic<uint64_t> logicalClockTicks;
-    std::atomic<uint32_t> driftAheadExceeded;
-    std::atomic<uint32_t> driftBehindExceeded;
+    Couchbase::RelaxedAtomic<uint64_t> cummulativeDrift;
+    Couchbase::RelaxedAtomic<uint64_t> cummulativeDriftIncrements;
+    Couchbase::RelaxedAtomic<uint64_t> logicalClockTicks;
+    Couchbase::RelaxedAtomic<uint32_t> driftAheadExceeded;
+    Couchbase::RelaxedAtomic<uint32_t> driftBehindExceeded;
     std::atomic<uint64_t> driftAheadThreshold;
     std::atomic<uint64_t> driftBehindThreshold;
 
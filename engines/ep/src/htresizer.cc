@@ -50,12 +50,15 @@ bool HashtableResizerTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "HashtableResizerTask");
     auto pv = std::make_unique<ResizingVisitor>();
 
-    // [per-VBucket Task] While a Hashtable is resizing no user
-    // requests can be performed (the resizing process needs to
-    // acquire all HT locks). As such we are sensitive to the duration
-    // of this task - we want to log anything which has a
-    // non-negligible impact on frontend operations.
-    const auto maxExpectedDuration = std::chrono::milliseconds(50);
+    // [per-VBucket Task] Growing a Hashtable is done incrementally
+    // where possible - only one HT lock is held at a time while buckets
+    // are migrated, so frontend operations are blocked for at most a
+    // single bucket's rehash. The fallback (one-shot) resize, and the
+    // initial phase of an incremental one, still acquire all HT locks;
+    // as such we remain sensitive to the duration of this task - we
+    // want to log anything which has a non-negligible impact on
+    // frontend operations.
+    const auto maxExpectedDuration = std::chrono::milliseconds(100);
 
     store->visit(std::move(pv),
                  "Hashtable resizer",
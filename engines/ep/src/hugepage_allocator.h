@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <platform/cb_malloc.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * An allocator for large, long-lived arrays (such as the HashTable
+ * bucket array) which asks the kernel to back the allocation with
+ * (transparent) huge pages.
+ *
+ * With hundreds of millions of StoredValues per node the bucket arrays
+ * span gigabytes, and walking them with 4KB pages makes TLB misses a
+ * measurable fraction of front-end cycles. Advising MADV_HUGEPAGE lets
+ * the kernel use 2MB mappings for the array, cutting the page-walk cost.
+ *
+ * The memory still comes from cb_malloc so allocation tracking (and
+ * hence mem_used accounting) is unaffected; the madvise() is purely a
+ * hint and allocations smaller than a huge page - or platforms without
+ * MADV_HUGEPAGE - fall back to the plain allocation. Cumulative
+ * counters of the bytes we asked huge pages for (and the bytes the
+ * kernel accepted the hint on) are exposed via the memory stats group
+ * so the coverage can be verified in production.
+ */
+class HugePageAllocatorBase {
+public:
+    // The size the kernel uses for a transparent huge page on the
+    // platforms we care about
+    static const size_t HugePageSize = size_t(2) * 1024 * 1024;
+
+    /// Total bytes (over the process lifetime) in allocations large
+    /// enough to be eligible for huge pages.
+    static size_t getBytesRequested() {
+        return bytesRequested().load(std::memory_order_relaxed);
+    }
+
+    /// The subset of getBytesRequested() the kernel accepted the
+    /// MADV_HUGEPAGE hint for.
+    static size_t getBytesAdvised() {
+        return bytesAdvised().load(std::memory_order_relaxed);
+    }
+
+protected:
+    static void adviseHugePages(void* ptr, size_t bytes) {
+        bytesRequested().fetch_add(bytes, std::memory_order_relaxed);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        // madvise operates on whole pages; the kernel then promotes any
+        // huge-page-aligned spans inside the advised range.
+        const size_t page = sysconf(_SC_PAGESIZE);
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        const uintptr_t start = (addr + page - 1) & ~(page - 1);
+        const uintptr_t end = (addr + bytes) & ~(page - 1);
+        if (end > start &&
+            madvise(reinterpret_cast<void*>(start), end - start,
+                    MADV_HUGEPAGE) == 0) {
+            bytesAdvised().fetch_add(bytes, std::memory_order_relaxed);
+        }
+#endif
+    }
+
+private:
+    static std::atomic<size_t>& bytesRequested() {
+        static std::atomic<size_t> value{0};
+        return value;
+    }
+
+    static std::atomic<size_t>& bytesAdvised() {
+        static std::atomic<size_t> value{0};
+        return value;
+    }
+};
+
+template <class T>
+class HugePageAllocator : public HugePageAllocatorBase {
+public:
+    using value_type = T;
+
+    HugePageAllocator() = default;
+
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        auto* ptr = cb_malloc(bytes);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        if (bytes >= HugePageSize) {
+            adviseHugePages(ptr, bytes);
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) {
+        cb_free(ptr);
+    }
+
+    bool operator==(const HugePageAllocator&) const {
+        return true;
+    }
+
+    bool operator!=(const HugePageAllocator&) const {
+        return false;
+    }
+};
@@ -22,14 +22,66 @@
 #include "objectregistry.h"
 
 #include <cJSON.h>
+#include <cJSON_utils.h>
+#include <platform/cb_malloc.h>
 #include <platform/compress.h>
 #include <xattr/utils.h>
 
 #include  <iomanip>
+#include  <vector>
 
 std::atomic<uint64_t> Item::casCounter(1);
 const uint32_t Item::metaDataSize(2*sizeof(uint32_t) + 2*sizeof(uint64_t) + 2);
 
+/**
+ * The per-thread freelist of Item shells backing Item::operator
+ * new / delete. The list holds raw chunks of sizeof(Item) bytes, so a
+ * shell allocated for one bucket may be reused by another; that only
+ * affects which bucket the (bounded) idle memory is accounted to.
+ */
+struct ItemShellPool {
+    /* The maximum number of idle shells to keep per thread */
+    static const size_t MAX_SHELLS = 64;
+
+    ~ItemShellPool() {
+        for (auto* shell : shells) {
+            cb_free(shell);
+        }
+    }
+
+    std::vector<void*> shells;
+};
+
+static thread_local ItemShellPool item_shell_pool;
+
+void* Item::operator new(size_t size) {
+    if (size == sizeof(Item) && !item_shell_pool.shells.empty()) {
+        auto* shell = item_shell_pool.shells.back();
+        item_shell_pool.shells.pop_back();
+        return shell;
+    }
+
+    void* shell = cb_malloc(size);
+    if (shell == nullptr) {
+        throw std::bad_alloc();
+    }
+    return shell;
+}
+
+void Item::operator delete(void* ptr, size_t size) {
+    if (size == sizeof(Item) &&
+        item_shell_pool.shells.size() < ItemShellPool::MAX_SHELLS) {
+        try {
+            item_shell_pool.shells.push_back(ptr);
+            return;
+        } catch (const std::bad_alloc&) {
+            // fall through and free the shell
+        }
+    }
+
+    cb_free(ptr);
+}
+
 Item::Item(const DocKey& k,
            const uint32_t fl,
            const time_t exp,
@@ -221,7 +273,7 @@ std::ostream& operator<<(std::ostream& os, const Blob& b) {
     return os;
 }
 
-bool Item::compressValue() {
+bool Item::compressValue(float maxUsefulRatio) {
     auto datatype = getDataType();
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
@@ -229,9 +281,9 @@ bool Item::compressValue() {
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      getData(), getNBytes(), deflated)) {
-            if (deflated.len > getNBytes()) {
-                //No point doing the compression if the deflated length
-                //is greater than the original length 
+            if (deflated.len > getNBytes() * maxUsefulRatio) {
+                //No point keeping the compressed form if the deflated
+                //length does not achieve the required ratio
                 return true;
             }
             setData(deflated.data.get(), deflated.len);
@@ -337,6 +389,77 @@ void Item::pruneValueAndOrXattrs(IncludeValue includeVal,
     }
 }
 
+bool Item::projectValue(const std::vector<std::string>& paths) {
+    if (!value || mcbp::datatype::is_snappy(getDataType()) ||
+        !mcbp::datatype::is_json(getDataType())) {
+        return false;
+    }
+
+    // Any xattr section is carried over as-is; only the body is projected.
+    size_t bodyOffset = 0;
+    if (mcbp::datatype::is_xattr(getDataType())) {
+        const cb::const_char_buffer buffer{value->getData(),
+                                           value->valueSize()};
+        bodyOffset = cb::xattr::get_body_offset(buffer);
+    }
+
+    // cJSON requires a NUL-terminated buffer
+    const std::string body(value->getData() + bodyOffset,
+                           value->valueSize() - bodyOffset);
+    unique_cJSON_ptr root(cJSON_Parse(body.c_str()));
+    if (!root || root->type != cJSON_Object) {
+        return false;
+    }
+
+    unique_cJSON_ptr projection(cJSON_CreateObject());
+    for (const auto& path : paths) {
+        cJSON* src = root.get();
+        cJSON* dst = projection.get();
+        size_t begin = 0;
+        while (src) {
+            const auto dot = path.find('.', begin);
+            const std::string component =
+                    path.substr(begin,
+                                dot == std::string::npos ? std::string::npos
+                                                         : dot - begin);
+            src = cJSON_GetObjectItem(src, component.c_str());
+            if (src == nullptr) {
+                // Path not present in this document; nothing to copy
+                break;
+            }
+            if (dot == std::string::npos) {
+                // Leaf component; deep-copy it unless an earlier
+                // (overlapping) path already established this member
+                if (cJSON_GetObjectItem(dst, component.c_str()) == nullptr) {
+                    cJSON_AddItemToObject(dst, component.c_str(),
+                                          cJSON_Duplicate(src, 1));
+                }
+                break;
+            }
+            auto* next = cJSON_GetObjectItem(dst, component.c_str());
+            if (next == nullptr) {
+                next = cJSON_CreateObject();
+                cJSON_AddItemToObject(dst, component.c_str(), next);
+            } else if (next->type != cJSON_Object) {
+                // An earlier path already copied this whole subtree
+                break;
+            }
+            dst = next;
+            begin = dot + 1;
+        }
+    }
+
+    char* ptr = cJSON_PrintUnformatted(projection.get());
+    if (ptr == nullptr) {
+        return false;
+    }
+    std::string projected(value->getData(), bodyOffset);
+    projected.append(ptr);
+    cJSON_Free(ptr);
+    setData(projected.data(), projected.size());
+    return true;
+}
+
 item_info to_item_info(const ItemMetaData& itemMeta,
                        uint8_t datatype,
                        uint32_t deleted) {
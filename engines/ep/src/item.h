@@ -27,6 +27,7 @@
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "atomic.h"
 #include "blob.h"
@@ -184,8 +185,27 @@ public:
 
     ~Item();
 
-    /* Snappy compress value and update datatype */
-    bool compressValue();
+    /**
+     * Item shells are allocated and freed exactly once per front-end
+     * mutation, so they're recycled through a small per-thread
+     * freelist instead of going to the allocator every time. Only the
+     * fixed-size shell is pooled; the value Blob and any heap space
+     * held by the key are allocated as before.
+     *
+     * An Item may be freed by a different thread than the one which
+     * allocated it (e.g. released by the flusher); the shell simply
+     * joins the freeing thread's list.
+     */
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
+    /**
+     * Snappy compress value and update datatype. The compressed form is
+     * kept only if it is no larger than maxUsefulRatio times the original
+     * size; marginal wins would just burden the consumer with an inflate
+     * for next to no transfer saving.
+     */
+    bool compressValue(float maxUsefulRatio = 1.0f);
 
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
@@ -418,6 +438,21 @@ public:
     void pruneValueAndOrXattrs(IncludeValue includeVal,
                                IncludeXattrs includeXattrs);
 
+    /**
+     * Replace a JSON value with a projection containing just the given
+     * dotted paths, discarding everything the consumer did not ask for.
+     * Paths which do not exist in the document are simply absent from
+     * the projection; a document matching none of the paths becomes an
+     * empty JSON object. Any xattr section is carried over untouched.
+     *
+     * The value is left as-is (and false returned) if there is no value,
+     * the body is not JSON, or the value is snappy-compressed.
+     *
+     * @param paths the dotted JSON paths to retain
+     * @return true if the value was replaced with the projection
+     */
+    bool projectValue(const std::vector<std::string>& paths);
+
 private:
     /**
      * Set the item's data. This is only used by constructors, so we
@@ -474,9 +509,12 @@ using UniqueItemPtr = std::unique_ptr<Item>;
 // bit-fields to reduce the size?
 // If you've reduced Item size, thanks! Please update the assert with the new
 // size.
-// Note the assert is written as we see std::string (member of the StoredDocKey)
-// differing. This totals 96 or 104 (string being 24 or 32).
-static_assert(sizeof(Item) == sizeof(std::string) + 72,
+// Note the assert is written against sizeof(StoredDocKey), which differs
+// between platforms (its inline key buffer deliberately makes it larger
+// than a std::string - a heap allocation and pointer chase per key cost
+// more than the extra bytes). The remaining 72 bytes are Item's other
+// members.
+static_assert(sizeof(Item) == sizeof(StoredDocKey) + 72,
               "sizeof Item may have an effect on run-time memory consumption, "
               "please avoid increasing it");
 
@@ -25,6 +25,7 @@
 #include "item.h"
 #include "kv_bucket_iface.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -38,6 +39,10 @@
 
 static const size_t MAX_PERSISTENCE_QUEUE_SIZE = 1000000;
 
+// How many values the PagingVisitor visits between checks of the memory
+// usage (to stop the scan early once below the low watermark).
+static const size_t MEMORY_CHECK_INTERVAL = 256;
+
 enum pager_type_t {
     ITEM_PAGER,
     EXPIRY_PAGER
@@ -84,7 +89,8 @@ public:
           completePhase(true),
           wasHighMemoryUsage(s.isMemoryUsageTooHigh()),
           taskStart(ProcessClock::now()),
-          pager_phase(phase) {
+          pager_phase(phase),
+          visitedSinceMemCheck(0) {
     }
 
     bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
@@ -102,17 +108,43 @@ public:
             return true;
         }
 
-        // always evict unreferenced items, or randomly evict referenced item
-        double r = *pager_phase == PAGING_UNREFERENCED ?
-            1 :
-            static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
-
         if (*pager_phase == PAGING_UNREFERENCED &&
             v.getNRUValue() == MAX_NRU_VALUE) {
+            // Evict anything not referenced since the last sweep.
             doEviction(lh, &v);
-        } else if (*pager_phase == PAGING_RANDOM &&
-                   v.incrNRUValue() == MAX_NRU_VALUE && r <= percent) {
-            doEviction(lh, &v);
+        } else if (*pager_phase == PAGING_RANDOM) {
+            // This pass acts as the clock hand - age the value, then (if now
+            // fully aged) evict with a probability graded by how cold it
+            // already was. A value which only just aged into the evictable
+            // state - e.g. one touched a single time by a scan, or newly
+            // resident - gets half the probability of one which was already
+            // fully aged, so genuinely cold values are paged out
+            // preferentially and a one-off scan of the data doesn't displace
+            // the working set.
+            const uint8_t prevNru = v.getNRUValue();
+            if (v.incrNRUValue() == MAX_NRU_VALUE) {
+                double p = percent;
+                if (prevNru < MAX_NRU_VALUE) {
+                    p = percent / 2;
+                }
+                double r = static_cast<double>(std::rand()) /
+                           static_cast<double>(RAND_MAX);
+                if (r <= p) {
+                    doEviction(lh, &v);
+                }
+            }
+        }
+
+        // Periodically check whether this run has already brought the memory
+        // usage back below the low watermark. If so, stop scanning - the
+        // remaining (warmer) values need not be aged or evicted to meet the
+        // target, and the miss cost of evicting them is paid for nothing.
+        if (++visitedSinceMemCheck >= MEMORY_CHECK_INTERVAL) {
+            visitedSinceMemCheck = 0;
+            if (stats.getTotalMemoryUsed() < stats.mem_low_wat.load()) {
+                completePhase = false;
+                return false;
+            }
         }
 
         return true;
@@ -157,6 +189,20 @@ public:
             adjustPercent(p, vb->getState());
             if (vBucketFilter(vb->getId())) {
                 currentBucket = vb;
+
+                // Quick path: bucket types which track items in mutation
+                // order (Ephemeral) can page out cold items directly from
+                // the cold end of that order in O(1) per item, rather than
+                // scanning the whole HashTable. No-op for persistent
+                // buckets. If this freed enough memory the scan (and any
+                // remaining vbuckets) can be skipped entirely.
+                ejected += vb->evictProbationaryItems(static_cast<size_t>(
+                        percent * vb->ht.getNumInMemoryItems()));
+                if (stats.getTotalMemoryUsed() < stats.mem_low_wat.load()) {
+                    completePhase = false;
+                    return;
+                }
+
                 vb->ht.visit(*this);
             }
 
@@ -238,15 +284,21 @@ private:
     void doEviction(const HashTable::HashBucketLock& lh, StoredValue* v) {
         item_eviction_policy_t policy = store.getItemEvictionPolicy();
         StoredDocKey key(v->getKey());
+        const bool wasResident = v->isResident();
 
         if (currentBucket->pageOut(lh, v)) {
             ++ejected;
 
             /**
-             * For FULL EVICTION MODE, add all items that are being
-             * evicted to the corresponding bloomfilter.
+             * For FULL EVICTION MODE, add items being evicted to the
+             * corresponding bloomfilter. pageOut() is two-stage in this
+             * mode - a resident value is just ejected (metadata remains
+             * in the HashTable) and only a value which was already
+             * non-resident has its whole StoredValue removed, at which
+             * point the bloomfilter becomes responsible for negative
+             * lookups of the key.
              */
-            if (policy == FULL_EVICTION) {
+            if (policy == FULL_EVICTION && !wasResident) {
                 currentBucket->addToFilter(key);
             }
         }
@@ -268,6 +320,9 @@ private:
     ProcessClock::time_point taskStart;
     std::atomic<item_pager_phase>* pager_phase;
     VBucketPtr currentBucket;
+
+    // Number of values visited since the memory usage was last checked.
+    size_t visitedSinceMemCheck;
 };
 
 ItemPager::ItemPager(EventuallyPersistentEngine *e, EPStats &st) :
@@ -416,3 +471,50 @@ void ExpiredItemPager::updateExpPagerTime(double sleepSecs) {
     _waketime.tv_sec += sleepSecs;
     stats.expPagerTime.store(_waketime.tv_sec);
 }
+
+const size_t ExpiryIndexPager::harvestLimit;
+const size_t ExpiryIndexPager::maxSleepTime;
+
+ExpiryIndexPager::ExpiryIndexPager(EventuallyPersistentEngine* e, EPStats& st)
+    : GlobalTask(e, TaskId::ExpiryIndexPager, 1, false),
+      engine(e),
+      stats(st) {
+}
+
+bool ExpiryIndexPager::run(void) {
+    TRACE_EVENT0("ep-engine/task", "ExpiryIndexPager");
+    KVBucketIface* kvBucket = engine->getKVBucket();
+    const time_t startTime = ep_real_time();
+    time_t nextDeadline = 0;
+
+    for (auto vbid : kvBucket->getVBuckets().getBuckets()) {
+        VBucketPtr vb = kvBucket->getVBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+
+        std::list<Item> expired;
+        time_t deadline =
+                vb->harvestExpiredItems(startTime, harvestLimit, expired);
+        if (!expired.empty()) {
+            kvBucket->deleteExpiredItems(expired, ExpireBy::Pager);
+        }
+        if (deadline != 0 &&
+            (nextDeadline == 0 || deadline < nextDeadline)) {
+            nextDeadline = deadline;
+        }
+    }
+
+    // Sleep until the earliest pending deadline (with a floor of one
+    // second - the granularity of exptime - so a burst of deadlines
+    // doesn't turn into a busy loop).
+    double sleepTime = maxSleepTime;
+    if (nextDeadline != 0) {
+        sleepTime = std::min(
+                std::max(difftime(nextDeadline, startTime), 1.0),
+                static_cast<double>(maxSleepTime));
+    }
+    snooze(sleepTime);
+
+    return true;
+}
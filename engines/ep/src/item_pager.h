@@ -125,4 +125,43 @@ private:
     std::shared_ptr<std::atomic<bool>>   available;
 };
 
+/**
+ * Dispatcher job which pops the keys that have reached their expiry
+ * deadline from each vbucket's expiry index (see ExpiryIndex) and
+ * expires the matching items.
+ *
+ * This handles the common case of expiry without ever scanning the
+ * HashTables; the scan based ExpiredItemPager is retained (at its
+ * configured cadence) as a repair path for the entries the index may
+ * have dropped. The task snoozes until the earliest deadline held by
+ * any of the indexes.
+ */
+class ExpiryIndexPager : public GlobalTask {
+public:
+    ExpiryIndexPager(EventuallyPersistentEngine* e, EPStats& st);
+
+    bool run(void);
+
+    cb::const_char_buffer getDescription() {
+        return "Expiring items at their deadline.";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // The harvest is bounded per vbucket and only touches the hash
+        // buckets of the keys which are due; use the same "fair"
+        // timeslice as the other pagers.
+        return std::chrono::milliseconds(25);
+    }
+
+private:
+    /// Maximum number of keys to pop from a vbucket's index per run
+    static const size_t harvestLimit = 4096;
+
+    /// Maximum number of seconds to snooze when no deadline is pending
+    static const size_t maxSleepTime = 10;
+
+    EventuallyPersistentEngine* engine;
+    EPStats& stats;
+};
+
 #endif  // SRC_ITEM_PAGER_H_
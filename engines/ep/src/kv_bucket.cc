@@ -20,12 +20,14 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -51,6 +53,7 @@
 #include "kvstore.h"
 #include "locks.h"
 #include "mutation_log.h"
+#include "quota_arbiter.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
 #include "tasks.h"
@@ -222,6 +225,7 @@ private:
 KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
     : engine(theEngine),
       stats(engine.getEpStats()),
+      latencyPacer(stats),
       vbMap(theEngine.getConfiguration(), *this),
       defragmenterTask(NULL),
       vb_mutexes(engine.getConfiguration().getMaxVbuckets()),
@@ -356,6 +360,12 @@ bool KVBucket::initialize() {
 
     initializeExpiryPager(config);
 
+    // The expiry index pager expires items at their deadline; the scan
+    // based expiry pager (above) is kept as a repair path for the
+    // entries the per-vbucket indexes may have dropped.
+    ExTask expIdxTask = std::make_shared<ExpiryIndexPager>(&engine, stats);
+    ExecutorPool::get()->schedule(expIdxTask);
+
     ExTask htrTask = std::make_shared<HashtableResizerTask>(this, 10);
     ExecutorPool::get()->schedule(htrTask);
 
@@ -368,6 +378,12 @@ bool KVBucket::initialize() {
             std::make_shared<WorkLoadMonitor>(&engine, false);
     ExecutorPool::get()->schedule(workloadMonitorTask);
 
+    if (config.isExecutorAdaptiveSizing()) {
+        ExTask poolSizeMonitorTask =
+                std::make_shared<PoolSizeMonitor>(&engine, false);
+        ExecutorPool::get()->schedule(poolSizeMonitorTask);
+    }
+
 #if HAVE_JEMALLOC
     /* Only create the defragmenter task if we have an underlying memory
      * allocator which can facilitate defragmenting memory.
@@ -376,6 +392,12 @@ bool KVBucket::initialize() {
     ExecutorPool::get()->schedule(defragmenterTask);
 #endif
 
+    if (config.isQuotaSharing()) {
+        QuotaArbiter::instance().registerEngine(engine);
+        quotaArbiterTask = std::make_shared<QuotaArbiterTask>(&engine);
+        ExecutorPool::get()->schedule(quotaArbiterTask);
+    }
+
     return true;
 }
 
@@ -395,6 +417,9 @@ void KVBucket::startWarmupTask() {
 }
 
 void KVBucket::deinitialize() {
+    if (engine.getConfiguration().isQuotaSharing()) {
+        QuotaArbiter::instance().unregisterEngine(engine);
+    }
     stopWarmup();
     ExecutorPool::get()->stopTaskGroup(engine.getTaskable().getGID(),
                                        NONIO_TASK_IDX, stats.forceShutdown);
@@ -414,6 +439,7 @@ KVBucket::~KVBucket() {
     LOG(EXTENSION_LOG_NOTICE, "Deleting vb_mutexes");
     LOG(EXTENSION_LOG_NOTICE, "Deleting defragmenterTask");
     defragmenterTask.reset();
+    quotaArbiterTask.reset();
 }
 
 const Flusher* KVBucket::getFlusher(uint16_t shardId) {
@@ -468,36 +494,40 @@ void KVBucket::getValue(Item& it) {
     }
 }
 
+void KVBucket::prepareExpiredItem(Item& it, VBucket& vb) {
+    // MB-25931: Empty XATTR items need their value before we can call
+    // pre_expiry. These occur because the value has been evicted.
+    if (mcbp::datatype::is_xattr(it.getDataType()) && it.getNBytes() == 0) {
+        getValue(it);
+    }
+
+    // Process positive seqnos (ignoring special *temp* items) and only
+    // those items with a value
+    if (it.getBySeqno() >= 0 && it.getNBytes()) {
+        auto info = it.toItemInfo(vb.failovers->getLatestUUID(),
+                                  vb.getHLCEpochSeqno());
+        if (engine.getServerApi()->document->pre_expiry(info)) {
+            // The payload is modified and contains data we should use
+            value_t value(
+                    Blob::New(static_cast<char*>(info.value[0].iov_base),
+                              info.value[0].iov_len));
+            it.setValue(value);
+            it.setDataType(info.datatype);
+        }
+    }
+}
+
 void KVBucket::deleteExpiredItem(Item& it,
                                  time_t startTime,
                                  ExpireBy source) {
     VBucketPtr vb = getVBucket(it.getVBucketId());
 
     if (vb) {
-        // MB-25931: Empty XATTR items need their value before we can call
-        // pre_expiry. These occur because the value has been evicted.
-        if (mcbp::datatype::is_xattr(it.getDataType()) && it.getNBytes() == 0) {
-            getValue(it);
-        }
-
-        // Process positive seqnos (ignoring special *temp* items) and only
-        // those items with a value
-        if (it.getBySeqno() >= 0 && it.getNBytes()) {
-            auto info = it.toItemInfo(vb->failovers->getLatestUUID(),
-                                      vb->getHLCEpochSeqno());
-            if (engine.getServerApi()->document->pre_expiry(info)) {
-                // The payload is modified and contains data we should use
-                value_t value(
-                        Blob::New(static_cast<char*>(info.value[0].iov_base),
-                                  info.value[0].iov_len));
-                it.setValue(value);
-                it.setDataType(info.datatype);
-            }
-        }
+        prepareExpiredItem(it, *vb);
 
         // Obtain reader access to the VB state change lock so that
         // the VB can't switch state whilst we're processing
-        ReaderLockHolder rlh(vb->getStateLock());
+        StripedRWLock::ReadHolder rlh(vb->getStateLock());
         if (vb->getState() == vbucket_state_active) {
             vb->deleteExpiredItem(it, startTime, source);
         }
@@ -506,10 +536,34 @@ void KVBucket::deleteExpiredItem(Item& it,
 
 void KVBucket::deleteExpiredItems(
         std::list<Item>& itms, ExpireBy source) {
-    std::list<std::pair<uint16_t, std::string> >::iterator it;
     time_t startTime = ep_real_time();
+
+    // Group the batch by vbucket so the vbucket lookup and the state
+    // change lock are paid once per group rather than once per key.
+    std::unordered_map<uint16_t, std::vector<Item*>> groups;
     for (auto& it : itms) {
-        deleteExpiredItem(it, startTime, source);
+        groups[it.getVBucketId()].push_back(&it);
+    }
+
+    for (auto& group : groups) {
+        VBucketPtr vb = getVBucket(group.first);
+        if (!vb) {
+            continue;
+        }
+
+        // Value restoration and the pre-expiry hook run before taking the
+        // state lock so the lock hold covers only the deletes themselves.
+        for (Item* it : group.second) {
+            prepareExpiredItem(*it, *vb);
+        }
+
+        StripedRWLock::ReadHolder rlh(vb->getStateLock());
+        if (vb->getState() != vbucket_state_active) {
+            continue;
+        }
+        for (Item* it : group.second) {
+            vb->deleteExpiredItem(*it, startTime, source);
+        }
     }
 }
 
@@ -552,7 +606,7 @@ ENGINE_ERROR_CODE KVBucket::set(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this set
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -589,7 +643,7 @@ ENGINE_ERROR_CODE KVBucket::add(Item &itm, const void *cookie)
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this add
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -630,7 +684,7 @@ ENGINE_ERROR_CODE KVBucket::replace(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this replace
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -662,7 +716,7 @@ ENGINE_ERROR_CODE KVBucket::addBackfillItem(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this addBackfillItem
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_active) {
         ++stats.numNotMyVBuckets;
@@ -705,7 +759,7 @@ ENGINE_ERROR_CODE KVBucket::setVBucketState_UNLOCKED(
         bool transfer,
         bool notify_dcp,
         std::unique_lock<std::mutex>& vbset,
-        WriterLockHolder* vbStateLock) {
+        StripedRWLock::WriteHolder* vbStateLock) {
     VBucketPtr vb = vbMap.getBucket(vbid);
     if (vb && to == vb->getState()) {
         return ENGINE_SUCCESS;
@@ -963,29 +1017,47 @@ void KVBucket::snapshotStats() {
 
 void KVBucket::getAggregatedVBucketStats(const void* cookie,
                                          ADD_STAT add_stat) {
-    // Create visitors for each of the four vBucket states, and collect
-    // stats for each.
-    auto active = makeVBCountVisitor(vbucket_state_active);
-    auto replica = makeVBCountVisitor(vbucket_state_replica);
-    auto pending = makeVBCountVisitor(vbucket_state_pending);
-    auto dead = makeVBCountVisitor(vbucket_state_dead);
-
-    VBucketCountAggregator aggregator;
-    aggregator.addVisitor(active.get());
-    aggregator.addVisitor(replica.get());
-    aggregator.addVisitor(pending.get());
-    aggregator.addVisitor(dead.get());
-    visit(aggregator);
-
-    updateCachedResidentRatio(active->getMemResidentPer(),
-                              replica->getMemResidentPer());
-    engine.getReplicationThrottle().adjustWriteQueueCap(active->getNumItems() +
-                                                        replica->getNumItems() +
-                                                        pending->getNumItems());
+    const auto maxAge = std::chrono::seconds(
+            engine.getConfiguration().getAggStatSnapshotMaxAge());
+
+    std::lock_guard<std::mutex> lh(vbStatsSnapshot.mutex);
+    const auto now = ProcessClock::now();
+    if (!vbStatsSnapshot.active || maxAge.count() == 0 ||
+        (now - vbStatsSnapshot.lastRefresh) > maxAge) {
+        // Create visitors for each of the four vBucket states, and collect
+        // stats for each.
+        auto active = makeVBCountVisitor(vbucket_state_active);
+        auto replica = makeVBCountVisitor(vbucket_state_replica);
+        auto pending = makeVBCountVisitor(vbucket_state_pending);
+        auto dead = makeVBCountVisitor(vbucket_state_dead);
+
+        VBucketCountAggregator aggregator;
+        aggregator.addVisitor(active.get());
+        aggregator.addVisitor(replica.get());
+        aggregator.addVisitor(pending.get());
+        aggregator.addVisitor(dead.get());
+        visit(aggregator);
+
+        updateCachedResidentRatio(active->getMemResidentPer(),
+                                  replica->getMemResidentPer());
+        engine.getReplicationThrottle().adjustWriteQueueCap(
+                active->getNumItems() + replica->getNumItems() +
+                pending->getNumItems());
+
+        vbStatsSnapshot.active = std::move(active);
+        vbStatsSnapshot.replica = std::move(replica);
+        vbStatsSnapshot.pending = std::move(pending);
+        vbStatsSnapshot.dead = std::move(dead);
+        vbStatsSnapshot.lastRefresh = now;
+    }
 
     // And finally actually return the stats using the ADD_STAT callback.
-    appendAggregatedVBucketStats(
-            *active, *replica, *pending, *dead, cookie, add_stat);
+    appendAggregatedVBucketStats(*vbStatsSnapshot.active,
+                                 *vbStatsSnapshot.replica,
+                                 *vbStatsSnapshot.pending,
+                                 *vbStatsSnapshot.dead,
+                                 cookie,
+                                 add_stat);
 }
 
 std::unique_ptr<VBucketCountVisitor> KVBucket::makeVBCountVisitor(
@@ -1205,12 +1277,19 @@ void KVBucket::completeBGFetchMulti(uint16_t vbId,
                                     ProcessClock::time_point startTime) {
     VBucketPtr vb = getVBucket(vbId);
     if (vb) {
+        // Group the cookies by completion status and wake each group
+        // with a single batched call; with a herd of waiters on one key
+        // this saves a notification round trip per cookie.
+        std::map<ENGINE_ERROR_CODE, std::vector<const void*>> toNotify;
         for (const auto& item : fetchedItems) {
             auto& key = item.first;
             auto* fetched_item = item.second;
             ENGINE_ERROR_CODE status = vb->completeBGFetchForSingleItem(
                     key, *fetched_item, startTime);
-            engine.notifyIOComplete(fetched_item->cookie, status);
+            toNotify[status].push_back(fetched_item->cookie);
+        }
+        for (const auto& notify : toNotify) {
+            engine.notifyIOComplete(notify.second, notify.first);
         }
         LOG(EXTENSION_LOG_DEBUG,
             "EP Store completes %" PRIu64
@@ -1251,7 +1330,21 @@ GetValue KVBucket::getInternal(const DocKey& key,
 
     const bool honorStates = (options & HONOR_STATES);
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    if (honorStates) {
+        // Lock-free fast rejection: state is a plain atomic, so a
+        // misrouted request (the common case when clients spread reads
+        // across the replicas while a rebalance is moving vbuckets) can
+        // be bounced without touching the state lock. The check is
+        // repeated below under the lock to interlock the successful
+        // path with state transitions.
+        const vbucket_state_t vbState = vb->getState();
+        if (vbState == vbucket_state_dead || vbState == disallowedState) {
+            ++stats.numNotMyVBuckets;
+            return GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
+        }
+    }
+
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (honorStates) {
         vbucket_state_t vbState = vb->getState();
         if (vbState == vbucket_state_dead) {
@@ -1283,6 +1376,61 @@ GetValue KVBucket::getInternal(const DocKey& key,
     }
 }
 
+void KVBucket::getMulti(
+        uint16_t vbucket,
+        const void* cookie,
+        std::vector<std::pair<StoredDocKey, GetValue>>& fetches) {
+    // Never queue a background fetch for a batched get; a non-resident
+    // key is reported as EWOULDBLOCK and the caller falls back to an
+    // individual get for it.
+    const get_options_t options = static_cast<get_options_t>(
+            TRACK_REFERENCE | DELETE_TEMP | HIDE_LOCKED_CAS |
+            TRACK_STATISTICS);
+
+    VBucketPtr vb = getVBucket(vbucket);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        for (auto& fetch : fetches) {
+            fetch.second = GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
+        }
+        return;
+    }
+
+    // Check the vbucket state once for the whole batch.
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
+    vbucket_state_t vbState = vb->getState();
+    if (vbState == vbucket_state_dead || vbState == vbucket_state_replica) {
+        ++stats.numNotMyVBuckets;
+        for (auto& fetch : fetches) {
+            fetch.second = GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
+        }
+        return;
+    } else if (vbState == vbucket_state_pending) {
+        // Don't block the whole batch behind a pending vbucket; the
+        // caller retries these keys individually (and may then block).
+        for (auto& fetch : fetches) {
+            fetch.second = GetValue(NULL, ENGINE_EWOULDBLOCK);
+        }
+        return;
+    }
+
+    // Hold the collections handle once for the whole batch.
+    auto collectionsRHandle = vb->lockCollections();
+    for (auto& fetch : fetches) {
+        if (!collectionsRHandle.doesKeyContainValidCollection(fetch.first)) {
+            fetch.second = GetValue(NULL, ENGINE_UNKNOWN_COLLECTION);
+        } else {
+            fetch.second = vb->getInternal(fetch.first,
+                                           cookie,
+                                           engine,
+                                           bgFetchDelay,
+                                           options,
+                                           diskDeleteAll,
+                                           VBucket::GetKeyOnly::No);
+        }
+    }
+}
+
 GetValue KVBucket::getRandomKey() {
     VBucketMap::id_type max = vbMap.getSize();
 
@@ -1321,6 +1469,45 @@ GetValue KVBucket::getRandomKey() {
     return GetValue(NULL, ENGINE_KEY_ENOENT);
 }
 
+std::vector<std::unique_ptr<Item>> KVBucket::getRandomKeys(size_t count) {
+    std::vector<std::unique_ptr<Item>> items;
+    if (count == 0) {
+        return items;
+    }
+
+    // Collect the active vbuckets and their in-memory item counts, so
+    // samples can be apportioned by item count - a uniform choice of
+    // vbucket would skew the sample towards items in small vbuckets.
+    std::vector<std::pair<VBucketPtr, size_t>> vbuckets;
+    size_t totalItems = 0;
+    for (VBucketMap::id_type vbid = 0; vbid < vbMap.getSize(); ++vbid) {
+        VBucketPtr vb = getVBucket(vbid);
+        if (!vb || vb->getState() != vbucket_state_active) {
+            continue;
+        }
+        const size_t numItems = vb->ht.getNumInMemoryItems();
+        if (numItems > 0) {
+            vbuckets.push_back(std::make_pair(vb, numItems));
+            totalItems += numItems;
+        }
+    }
+
+    for (const auto& entry : vbuckets) {
+        if (items.size() >= count) {
+            break;
+        }
+        // Round the quota up; the overall result is trimmed to `count`.
+        const size_t quota =
+                ((count * entry.second) + totalItems - 1) / totalItems;
+        auto sampled = entry.first->ht.getRandomKeys(
+                std::min(quota, count - items.size()), random());
+        for (auto& itm : sampled) {
+            items.push_back(std::move(itm));
+        }
+    }
+    return items;
+}
+
 ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
                                         uint16_t vbucket,
                                         const void* cookie,
@@ -1335,7 +1522,7 @@ ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -1370,7 +1557,7 @@ ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (!permittedVBStates.test(vb->getState())) {
         if (vb->getState() == vbucket_state_pending) {
             if (vb->addPendingOp(cookie)) {
@@ -1411,6 +1598,81 @@ ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
     }
 }
 
+ENGINE_ERROR_CODE KVBucket::setWithMetaBatch(
+        uint16_t vbucket,
+        std::vector<std::pair<std::unique_ptr<Item>, ENGINE_ERROR_CODE>>&
+                mutations,
+        const void* cookie,
+        PermittedVBStates permittedVBStates,
+        CheckConflicts checkConflicts,
+        bool allowExisting) {
+    VBucketPtr vb = getVBucket(vbucket);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    // Perform the state and takeover checks once for the whole batch.
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
+    if (!permittedVBStates.test(vb->getState())) {
+        if (vb->getState() == vbucket_state_pending) {
+            if (vb->addPendingOp(cookie)) {
+                return ENGINE_EWOULDBLOCK;
+            }
+        } else {
+            ++stats.numNotMyVBuckets;
+            return ENGINE_NOT_MY_VBUCKET;
+        }
+    } else if (vb->isTakeoverBackedUp()) {
+        LOG(EXTENSION_LOG_DEBUG,
+            "(vb %u) Returned TMPFAIL to a setWithMetaBatch op"
+            ", becuase takeover is lagging", vb->getId());
+        return ENGINE_TMPFAIL;
+    }
+
+    // Hold the collections handle once for the whole batch.
+    auto collectionsRHandle = vb->lockCollections();
+    for (auto& mutation : mutations) {
+        if (!mutation.first) {
+            // Rejected by the caller during parsing; status already set.
+            continue;
+        }
+        Item& itm = *mutation.first;
+
+        //check for the incoming item's CAS validity
+        if (!Item::isValidCas(itm.getCas())) {
+            mutation.second = ENGINE_KEY_EEXISTS;
+            continue;
+        }
+
+        if (!collectionsRHandle.doesKeyContainValidCollection(itm.getKey())) {
+            mutation.second = ENGINE_UNKNOWN_COLLECTION;
+            continue;
+        }
+
+        mutation.second = vb->setWithMeta(itm,
+                                          0 /*cas*/,
+                                          nullptr /*seqno*/,
+                                          cookie,
+                                          engine,
+                                          bgFetchDelay,
+                                          checkConflicts,
+                                          allowExisting,
+                                          GenerateBySeqno::Yes,
+                                          GenerateCas::No,
+                                          false /*isReplication*/);
+        if (mutation.second == ENGINE_EWOULDBLOCK) {
+            // The existing item's metadata has to be fetched from disk
+            // before this entry can be conflict resolved; the bgfetch is
+            // scheduled so fail the whole command and reprocess it once
+            // the fetch completes. Entries already applied are rejected
+            // as duplicates by conflict resolution on the retry.
+            return ENGINE_EWOULDBLOCK;
+        }
+    }
+    return ENGINE_SUCCESS;
+}
+
 GetValue KVBucket::getAndUpdateTtl(const DocKey& key, uint16_t vbucket,
                                    const void *cookie, time_t exptime)
 {
@@ -1420,7 +1682,7 @@ GetValue KVBucket::getAndUpdateTtl(const DocKey& key, uint16_t vbucket,
         return GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         ++stats.numNotMyVBuckets;
         return GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
@@ -1618,7 +1880,7 @@ ENGINE_ERROR_CODE KVBucket::deleteWithMeta(const DocKey& key,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if (!permittedVBStates.test(vb->getState())) {
         if (vb->getState() == vbucket_state_pending) {
             if (vb->addPendingOp(cookie)) {
@@ -1719,6 +1981,8 @@ public:
                         // Insert in value-only or full eviction mode.
                         ++vbucket->opsCreate;
                         vbucket->incrMetaDataDisk(*queuedItem);
+                        vbucket->lockCollections().incrementDiskCount(
+                                queuedItem->getKey());
                     } else { // Update in full eviction mode.
                         vbucket->ht.decrNumTotalItems();
                         ++vbucket->opsUpdate;
@@ -1781,6 +2045,12 @@ public:
         // 1 means we deleted one row
         // 0 means we did not delete a row, but did not fail (did not exist)
         if (value >= 0) {
+            if (value > 0) {
+                // A document was removed, the collection has one fewer item
+                // on disk.
+                vbucket->lockCollections().decrementDiskCount(
+                        queuedItem->getKey());
+            }
             // We have successfully removed an item from the disk, we
             // may now remove it from the hash table.
             vbucket->deletedOnDiskCbk(*queuedItem, (value > 0));
@@ -1900,6 +2170,48 @@ int KVBucket::flushVBucket(uint16_t vbid) {
                     "Retry in 1 sec ...");
                 sleep(1);
             }
+
+            // A batch spanning several closed checkpoints may carry many
+            // versions of the same hot key, of which only the most recent
+            // is written (see the duplicate check in the flush loop
+            // below). Drop the superseded versions up-front with a
+            // key->latest map so they don't inflate the sort in
+            // optimizeWrites() - on hot-key-update workloads the batch is
+            // dominated by such duplicates.
+            if (items.size() > 1) {
+                std::unordered_map<StoredDocKey, size_t> latest;
+                latest.reserve(items.size());
+                for (size_t i = 0; i < items.size(); ++i) {
+                    const auto& qi = items[i];
+                    if (qi->getOperation() != queue_op::mutation) {
+                        continue;
+                    }
+                    auto res = latest.emplace(qi->getKey(), i);
+                    if (!res.second) {
+                        // Keep whichever version has the higher seqno, and
+                        // account the superseded one as flushed without a
+                        // write, exactly as the flush loop does for
+                        // duplicates it skips.
+                        size_t drop = i;
+                        if (items[res.first->second]->getBySeqno() <
+                            qi->getBySeqno()) {
+                            drop = res.first->second;
+                            res.first->second = i;
+                        }
+                        --stats.diskQueueSize;
+                        vb->doStatsForFlushing(*items[drop],
+                                               items[drop]->size());
+                        items[drop].reset();
+                    }
+                }
+                items.erase(std::remove_if(items.begin(),
+                                           items.end(),
+                                           [](const queued_item& qi) {
+                                               return !qi;
+                                           }),
+                            items.end());
+            }
+
             rwUnderlying->optimizeWrites(items);
 
             Item *prev = NULL;
@@ -1975,7 +2287,7 @@ int KVBucket::flushVBucket(uint16_t vbid) {
 
 
             {
-                ReaderLockHolder rlh(vb->getStateLock());
+                StripedRWLock::ReadHolder rlh(vb->getStateLock());
                 if (vb->getState() == vbucket_state_active) {
                     if (maxSeqno) {
                         range.start = maxSeqno;
@@ -2007,6 +2319,26 @@ int KVBucket::flushVBucket(uint16_t vbid) {
                 auto options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
                 if ((items_flushed == 0) && mustCheckpointVBState) {
                     options = VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT;
+
+                    // State-only flushes are common in bursts during
+                    // rebalance, and each one pays a full couchstore
+                    // commit (fsync). If real (non-meta) items are
+                    // already waiting on the persistence cursor then
+                    // this vbucket is guaranteed another flush which
+                    // will commit, and every commit re-writes the
+                    // cached vbucket state (see saveDocs), so the
+                    // state change rides that commit for free - just
+                    // update the cache now. Don't defer if a
+                    // high-priority request is waiting on this
+                    // vbucket; the waiter is notified at the end of
+                    // this flush and requires the commit to have
+                    // happened.
+                    if (vb->checkpointManager->getNumItemsForCursor(
+                                CheckpointManager::pCursorName) > 0 &&
+                        vb->getHighPriorityChkSize() == 0) {
+                        options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
+                        ++stats.totalDeferredVBStatePersist;
+                    }
                 }
 
                 if (rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
@@ -2209,6 +2541,12 @@ bool KVBucket::maybeEnableTraffic()
                 ": memoryUsed (%f) > (maxSize(%f) * warmupMemUsedCap(%f))",
                  memoryUsed, maxSize, stats.warmupMemUsedCap.load());
         return true;
+    } else if (engine.getConfiguration().isWarmupBackgroundFill()) {
+        // Background fill: traffic was enabled right after the metadata
+        // load (see Warmup::checkForAccessLog), so the item-count
+        // thresholds below no longer gate availability; keep loading
+        // until done or until the memory checks above fire.
+        return false;
     } else if (eviction_policy == VALUE_ONLY &&
                stats.warmedUpValues >=
                                (stats.warmedUpKeys * stats.warmupNumReadCap)) {
@@ -2239,7 +2577,11 @@ bool KVBucket::maybeEnableTraffic()
 }
 
 bool KVBucket::isWarmingUp() {
-    return warmupTask && !warmupTask->isComplete();
+    // The bucket stops being "warming up" (and hence degraded mode) once
+    // enough has been loaded to serve front-end traffic; with
+    // warmup_background_fill that point is reached before the load phases
+    // have finished (see Warmup::checkForAccessLog).
+    return warmupTask && !warmupTask->isTrafficEnabled();
 }
 
 bool KVBucket::shouldSetVBStateBlock(const void* cookie) {
@@ -2255,8 +2597,10 @@ bool KVBucket::isWarmupOOMFailure() {
 
 void KVBucket::stopWarmup(void)
 {
-    // forcefully stop current warmup task
-    if (isWarmingUp()) {
+    // forcefully stop current warmup task; checked against isComplete()
+    // (not isWarmingUp()) so that a background fill which has already
+    // enabled traffic is still cancelled.
+    if (warmupTask && !warmupTask->isComplete()) {
         LOG(EXTENSION_LOG_NOTICE, "Stopping warmup while engine is loading "
             "data from underlying storage, shutdown = %s\n",
             stats.isShutdown ? "yes" : "no");
@@ -2567,6 +2911,20 @@ void KVBucket::addKVStoreStats(ADD_STAT add_stat, const void* cookie) {
     }
 }
 
+void KVBucket::addKVStoreDetailStats(ADD_STAT add_stat, const void* cookie) {
+    for (size_t i = 0; i < vbMap.shards.size(); i++) {
+        // As in addKVStoreStats, collect the distinct KVStore instances
+        // of the shard and query each one once.
+        std::set<KVStore*> underlyingSet;
+        underlyingSet.insert(vbMap.shards[i]->getRWUnderlying());
+        underlyingSet.insert(vbMap.shards[i]->getROUnderlying());
+
+        for (auto* store : underlyingSet) {
+            store->addDetailStats(add_stat, cookie);
+        }
+    }
+}
+
 void KVBucket::addKVStoreTimingStats(ADD_STAT add_stat, const void* cookie) {
     for (size_t i = 0; i < vbMap.shards.size(); i++) {
         std::set<KVStore*> underlyingSet;
@@ -2623,7 +2981,7 @@ TaskStatus KVBucket::rollback(uint16_t vbid, uint64_t rollbackSeqno) {
         return TaskStatus::Abort;
     }
 
-    ReaderLockHolder rlh(vb->getStateLock());
+    StripedRWLock::ReadHolder rlh(vb->getStateLock());
     if ((vb->getState() == vbucket_state_replica) ||
         (vb->getState() == vbucket_state_pending)) {
         uint64_t prevHighSeqno =
@@ -18,6 +18,7 @@
 
 #include "ep_types.h"
 #include "executorpool.h"
+#include "latency_pacer.h"
 #include "mutation_log.h"
 #include "storeddockey.h"
 #include "stored-value.h"
@@ -186,8 +187,28 @@ public:
                            options);
     }
 
+    /**
+     * Retrieve a batch of values from a single vbucket.
+     *
+     * The fixed per-get costs (vbucket lookup, state check and
+     * collections handle) are paid once for the whole batch rather than
+     * once per key. Background fetches are never scheduled for the
+     * batch; keys which are not resident come back as ENGINE_EWOULDBLOCK
+     * and should be re-fetched individually by the caller.
+     *
+     * @param vbucket the vbucket from which to retrieve the keys
+     * @param cookie the connection cookie
+     * @param fetches the keys to fetch; the GetValue of each entry is
+     *                filled in with the result for that key
+     */
+    void getMulti(uint16_t vbucket,
+                  const void* cookie,
+                  std::vector<std::pair<StoredDocKey, GetValue>>& fetches);
+
     GetValue getRandomKey(void);
 
+    std::vector<std::unique_ptr<Item>> getRandomKeys(size_t count);
+
     /**
      * Retrieve a value from a vbucket in replica state.
      *
@@ -241,6 +262,37 @@ public:
             ExtendedMetaData* emd = NULL,
             bool isReplication = false);
 
+    /**
+     * Apply a batch of mutations with their metadata to a single vbucket.
+     *
+     * The fixed per-op costs (vbucket lookup, state/takeover checks and
+     * collections handle) are paid once for the whole batch. Each
+     * entry's outcome is written to its paired status; entries with a
+     * null Item were rejected by the caller during parsing and are
+     * skipped.
+     *
+     * @param vbucket the vbucket to apply the mutations to
+     * @param mutations the items to apply, each paired with its status
+     * @param cookie the connection cookie
+     * @param permittedVBStates set of states that the vbucket may be in
+     * @param checkConflicts set to Yes if conflict resolution should be done
+     * @param allowExisting true if updates of existing documents are
+     *        permitted
+     * @return ENGINE_SUCCESS if the batch was processed (individual
+     *         entries may still have failed); ENGINE_EWOULDBLOCK if an
+     *         entry has to bgfetch metadata for conflict resolution and
+     *         the command must be retried; otherwise the error which
+     *         stopped the batch
+     */
+    ENGINE_ERROR_CODE setWithMetaBatch(
+            uint16_t vbucket,
+            std::vector<std::pair<std::unique_ptr<Item>, ENGINE_ERROR_CODE>>&
+                    mutations,
+            const void* cookie,
+            PermittedVBStates permittedVBStates,
+            CheckConflicts checkConflicts,
+            bool allowExisting);
+
     /**
      * Retrieve a value, but update its TTL first
      *
@@ -410,7 +462,7 @@ public:
      *                    associated with the vbucket
      * @param vbset LockHolder acquiring the 'vbsetMutex' lock in the
      *              EventuallyPersistentStore class
-     * @param vbStateLock ptr to WriterLockHolder of 'stateLock' in the vbucket
+     * @param vbStateLock ptr to a write holder of 'stateLock' in the vbucket
      *                    class. if passed as null, the function acquires the
      *                    vbucket 'stateLock'
      *
@@ -422,7 +474,8 @@ public:
                                     bool transfer,
                                     bool notify_dcp,
                                     std::unique_lock<std::mutex>& vbset,
-                                    WriterLockHolder* vbStateLock = nullptr);
+                                    StripedRWLock::WriteHolder* vbStateLock =
+                                            nullptr);
 
     /**
      * Returns the 'vbsetMutex'
@@ -588,6 +641,14 @@ public:
         return engine;
     }
 
+    /**
+     * Pacing signal for budgeted background visitor tasks - see
+     * LatencyPacer.
+     */
+    LatencyPacer& getLatencyPacer() {
+        return latencyPacer;
+    }
+
     size_t getExpiryPagerSleeptime(void) {
         LockHolder lh(expiryPager.mutex);
         return expiryPager.sleeptime;
@@ -684,6 +745,8 @@ public:
 
     void addKVStoreStats(ADD_STAT add_stat, const void* cookie);
 
+    void addKVStoreDetailStats(ADD_STAT add_stat, const void* cookie);
+
     void addKVStoreTimingStats(ADD_STAT add_stat, const void* cookie);
 
     /* Given a named KVStore statistic, return the value of that statistic,
@@ -875,6 +938,13 @@ protected:
     /// Helper method from initialize() to setup the expiry pager
     void initializeExpiryPager(Configuration& config);
 
+    /**
+     * Ready an expired item for deletion - restore an evicted XATTR value
+     * and run the pre-expiry hook over it. Performed outside the vbucket
+     * state lock so that batched expiries do not extend the lock hold.
+     */
+    void prepareExpiredItem(Item& it, VBucket& vb);
+
     /// Factory method to create a VBucket count visitor of the correct type.
     virtual std::unique_ptr<VBucketCountVisitor> makeVBCountVisitor(
             vbucket_state_t state);
@@ -895,12 +965,14 @@ protected:
 
     EventuallyPersistentEngine     &engine;
     EPStats                        &stats;
+    LatencyPacer                    latencyPacer;
     std::unique_ptr<Warmup> warmupTask;
     VBucketMap                      vbMap;
     ExTask itemPagerTask;
     ExTask                          chkTask;
     float                           bfilterResidencyThreshold;
     ExTask                          defragmenterTask;
+    ExTask                          quotaArbiterTask;
 
     size_t                          compactionWriteQueueCap;
     float                           compactionExpMemThreshold;
@@ -945,6 +1017,21 @@ protected:
         std::atomic<size_t> activeRatio;
         std::atomic<size_t> replicaRatio;
     } cachedResidentRatio;
+    /**
+     * Cached copy of the aggregated vBucket stats. Collecting them
+     * requires visiting every vBucket, which is too expensive to repeat
+     * for each of the (frequent, concurrent) monitoring scrapes, so the
+     * visitors from the most recent collection are kept and served to
+     * stat requests while younger than agg_stat_snapshot_max_age.
+     */
+    struct AggregatedVBucketStatsSnapshot {
+        std::mutex mutex;
+        std::unique_ptr<VBucketCountVisitor> active;
+        std::unique_ptr<VBucketCountVisitor> replica;
+        std::unique_ptr<VBucketCountVisitor> pending;
+        std::unique_ptr<VBucketCountVisitor> dead;
+        ProcessClock::time_point lastRefresh;
+    } vbStatsSnapshot;
     size_t statsSnapshotTaskId;
     std::atomic<size_t> lastTransTimePerItem;
     item_eviction_policy_t eviction_policy;
@@ -146,6 +146,15 @@ public:
 
     virtual GetValue getRandomKey(void) = 0;
 
+    /**
+     * Sample up to `count` random resident items, uniformly across the
+     * bucket (active vbuckets, weighted by their item counts). Samples
+     * are drawn with replacement so duplicates are possible; fewer than
+     * `count` items may be returned from a (nearly) empty bucket.
+     */
+    virtual std::vector<std::unique_ptr<Item>> getRandomKeys(
+            size_t count) = 0;
+
     /**
      * Retrieve a value from a vbucket in replica state.
      *
@@ -653,6 +662,9 @@ public:
 
     virtual void addKVStoreStats(ADD_STAT add_stat, const void* cookie) = 0;
 
+    virtual void addKVStoreDetailStats(ADD_STAT add_stat,
+                                       const void* cookie) = 0;
+
     virtual void addKVStoreTimingStats(ADD_STAT add_stat,
                                        const void* cookie) = 0;
 
@@ -72,22 +72,23 @@ BgFetcher *KVShard::getBgFetcher() {
 
 VBucketPtr KVShard::getBucket(uint16_t id) const {
     if (id < vbuckets.size()) {
-        return vbuckets[id].lock().get();
+        return vbuckets[id].get();
     } else {
         return NULL;
     }
 }
 
 void KVShard::setBucket(VBucketPtr vb) {
-    vbuckets[vb->getId()].lock().set(vb);
+    vbuckets[vb->getId()].set(std::move(vb));
 }
 
 void KVShard::dropVBucketAndSetupDeferredDeletion(VBucket::id_type id,
                                                   const void* cookie) {
-    auto vb = vbuckets[id].lock();
-    auto vbPtr = vb.get();
+    // Swap the vbucket out of the map first so no new readers can obtain a
+    // reference, then mark it up for deferred deletion; the VBucket is
+    // deleted once the last outstanding VBucketPtr is released.
+    auto vbPtr = vbuckets[id].take();
     vbPtr->setupDeferredDeletion(cookie);
-    vb.reset();
 }
 
 std::vector<VBucket::id_type> KVShard::getVBucketsSortedByState() {
@@ -96,8 +97,7 @@ std::vector<VBucket::id_type> KVShard::getVBucketsSortedByState() {
          state <= vbucket_state_dead;
          ++state) {
         for (const auto& b : vbuckets) {
-            auto vb = b.lock();
-            auto vbPtr = vb.get();
+            auto vbPtr = b.get();
             if (vbPtr && vbPtr->getState() == state) {
                 rv.push_back(vbPtr->getId());
             }
@@ -109,8 +109,7 @@ std::vector<VBucket::id_type> KVShard::getVBucketsSortedByState() {
 std::vector<VBucket::id_type> KVShard::getVBuckets() {
     std::vector<VBucket::id_type> rv;
     for (const auto& b : vbuckets) {
-        auto vb = b.lock();
-        auto vbPtr = vb.get();
+        auto vbPtr = b.get();
         if (vbPtr) {
             rv.push_back(vbPtr->getId());
         }
@@ -106,85 +106,41 @@ private:
     KVStoreConfig kvConfig;
 
     /**
-     * VBMapElement comprises the VBucket smart pointer and a mutex.
-     * Access to the smart pointer must be performed through the ::Access object
-     * which will perform RAII locking of the mutex.
+     * Element of the shard's vbucket array. The VBucketPtr is read on every
+     * front-end operation, so readers take a reference via the std::atomic_*
+     * shared_ptr overloads (a plain indexed load plus the unavoidable
+     * refcount acquisition) rather than locking a per-element mutex; writers
+     * (vbucket create/delete) atomically publish or swap out the pointer.
+     * Existing holders of the VBucketPtr keep the object - and its deferred
+     * deletion behaviour - alive as before.
      */
     class VBMapElement {
     public:
         /**
-         * Access for const/non-const VBMapElement (using enable_if to hide
-         * const methods for non-const users and vice-versa)
-         *
-         * This class did have an -> operator for directly reading the VBucket*
-         * but MSVC could not cope with it, so now you must use:
-         *    access.get()-><Vbucket-method>
+         * @return the VBucketPtr (which may have no real pointer)
          */
-        template <class T>
-        class Access {
-        public:
-            Access(std::mutex& m, T e) : lock(m), element(e) {
-            }
-
-            /**
-             * @return a const VBBucketPtr& (which may have no real pointer)
-             */
-            template <typename U = T>
-            typename std::enable_if<
-                    std::is_const<
-                            typename std::remove_reference<U>::type>::value,
-                    const VBucketPtr&>::type
-            get() const {
-                return element.vbPtr;
-            }
-
-            /**
-             * @return the VBBucketPtr (which may have no real pointer)
-             */
-            template <typename U = T>
-            typename std::enable_if<
-                    !std::is_const<
-                            typename std::remove_reference<U>::type>::value,
-                    VBucketPtr>::type
-            get() const {
-                return element.vbPtr;
-            }
-
-            /**
-             * @param set a new VBBucketPtr for the VB
-             */
-            template <typename U = T>
-            typename std::enable_if<!std::is_const<
-                    typename std::remove_reference<U>::type>::value>::type
-            set(VBucketPtr vb) {
-                element.vbPtr = vb;
-            }
-
-            /**
-             * @param reset VBBucketPtr for the VB
-             */
-            template <typename U = T>
-            typename std::enable_if<!std::is_const<
-                    typename std::remove_reference<U>::type>::value>::type
-            reset() {
-                element.vbPtr.reset();
-            }
-
-        private:
-            std::unique_lock<std::mutex> lock;
-            T& element;
-        };
-
-        Access<VBMapElement&> lock() {
-            return {mutex, *this};
+        VBucketPtr get() const {
+            return std::atomic_load_explicit(&vbPtr,
+                                             std::memory_order_acquire);
         }
 
-        Access<const VBMapElement&> lock() const {
-            return {mutex, *this};
+        /**
+         * @param vb a new VBucketPtr for the VB
+         */
+        void set(VBucketPtr vb) {
+            std::atomic_store_explicit(
+                    &vbPtr, std::move(vb), std::memory_order_release);
+        }
+
+        /**
+         * Atomically swap out and return the current VBucketPtr, leaving
+         * the element empty (used when dropping a vbucket).
+         */
+        VBucketPtr take() {
+            return std::atomic_exchange(&vbPtr, VBucketPtr{});
         }
 
     private:
-        mutable std::mutex mutex;
         VBucketPtr vbPtr;
     };
 
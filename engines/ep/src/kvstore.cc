@@ -46,7 +46,8 @@ ScanContext::ScanContext(std::shared_ptr<Callback<GetValue>> cb,
                          DocumentFilter _docFilter,
                          ValueFilter _valFilter,
                          uint64_t _documentCount,
-                         const KVStoreConfig& _config)
+                         const KVStoreConfig& _config,
+                         ScanOrder _scanOrder)
     : callback(cb),
       lookup(cl),
       lastReadSeqno(0),
@@ -56,6 +57,7 @@ ScanContext::ScanContext(std::shared_ptr<Callback<GetValue>> cb,
       vbid(vb),
       docFilter(_docFilter),
       valFilter(_valFilter),
+      scanOrder(_scanOrder),
       documentCount(_documentCount),
       logger(&global_logger),
       config(_config) {
@@ -132,6 +134,7 @@ bool KVStore::updateCachedVBState(uint16_t vbid, const vbucket_state& newState)
         vbState->maxCas = std::max(vbState->maxCas, newState.maxCas);
         vbState->hlcCasEpochSeqno = newState.hlcCasEpochSeqno;
         vbState->mightContainXattrs = newState.mightContainXattrs;
+        vbState->streamCursors = newState.streamCursors;
     } else {
         cachedVBStates[vbid] = std::make_unique<vbucket_state>(newState);
         if (cachedVBStates[vbid]->state != vbucket_state_dead) {
@@ -240,6 +243,8 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
     addStat(prefix, "readTime",       st.readTimeHisto,   add_stat, c);
     addStat(prefix, "readSize",       st.readSizeHisto,   add_stat, c);
     addStat(prefix, "numLoadedVb",    st.numLoadedVb,     add_stat, c);
+    addStat(prefix, "handle_cache_hit",  st.numHandleCacheHits,   add_stat, c);
+    addStat(prefix, "handle_cache_miss", st.numHandleCacheMisses, add_stat, c);
 
     // failure stats
     addStat(prefix, "failure_open",   st.numOpenFailure, add_stat, c);
@@ -250,6 +255,14 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
         addStat(prefix, "failure_del",   st.numDelFailure,   add_stat, c);
         addStat(prefix, "failure_vbset", st.numVbSetFailure, add_stat, c);
         addStat(prefix, "lastCommDocs",  st.docsCommitted,   add_stat, c);
+
+        addStat(prefix, "commit_log_syncs", st.commitLogSyncs, add_stat, c);
+        addStat(prefix, "commit_log_bytes", st.commitLogBytes, add_stat, c);
+        addStat(prefix,
+                "commit_log_checkpoints",
+                st.commitLogCheckpoints,
+                add_stat,
+                c);
     }
 
     addStat(prefix,
@@ -279,6 +292,36 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
             st.fsStatsCompaction.totalBytesWritten, add_stat, c);
 }
 
+void KVStore::addDetailStats(ADD_STAT add_stat, const void* c) {
+    uint16_t shardId = configuration.getShardId();
+    std::stringstream prefixStream;
+
+    if (isReadOnly()) {
+        prefixStream << "ro_" << shardId;
+    } else {
+        prefixStream << "rw_" << shardId;
+    }
+
+    const std::string& prefix = prefixStream.str();
+
+    // Logical bytes are what the engine asked to be stored (key + meta +
+    // value); physical bytes are what actually reached the filesystem.
+    // Their ratio is the measured write amplification of this shard.
+    addStat(prefix, "io_logical_write_bytes", st.io_write_bytes, add_stat, c);
+    addStat(prefix,
+            "io_physical_write_bytes",
+            st.fsStats.totalBytesWritten,
+            add_stat,
+            c);
+    addStat(prefix, "io_stale_write_bytes", st.staleWriteBytes, add_stat, c);
+    addStat(prefix,
+            "flusherWriteAmplificationPct",
+            st.flusherWriteAmpHisto,
+            add_stat,
+            c);
+    addStat(prefix, "fsyncTime", st.fsStats.syncTimeHisto, add_stat, c);
+}
+
 void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
     uint16_t shardId = configuration.getShardId();
     std::stringstream prefixStream;
@@ -372,8 +415,11 @@ std::string vbucket_state::toJSON() const {
               << ",\"failover_table\": " << failovers
               << ",\"snap_start\": \"" << lastSnapStart << "\""
               << ",\"snap_end\": \"" << lastSnapEnd << "\""
-              << ",\"max_cas\": \"" << maxCas << "\""
-              << "}";
+              << ",\"max_cas\": \"" << maxCas << "\"";
+    if (!streamCursors.empty()) {
+        jsonState << ",\"stream_cursors\": " << streamCursors;
+    }
+    jsonState << "}";
 
     return jsonState.str();
 }
@@ -401,6 +447,7 @@ void vbucket_state::reset() {
     hlcCasEpochSeqno = HlcCasSeqnoUninitialised;
     mightContainXattrs = false;
     failovers.clear();
+    streamCursors.clear();
 }
 
 IORequest::IORequest(uint16_t vbId, MutationRequestCallback &cb , bool del,
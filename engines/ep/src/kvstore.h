@@ -69,6 +69,13 @@ typedef struct {
     BloomFilterCBPtr bloomFilterCallback;
     ExpiredItemsCBPtr expiryCallback;
     std::function<bool(const DocKey, int64_t)> collectionsEraser;
+
+    /* Throttle bookkeeping, maintained by the storage layer while the
+       compaction runs: document bytes copied since the last yield, and
+       when the current accounting chunk started. See
+       compaction_throttle_bytes_per_sec. */
+    uint64_t throttle_bytes = 0;
+    ProcessClock::time_point throttle_chunk_start;
 } compaction_ctx;
 
 /**
@@ -125,6 +132,16 @@ struct vbucket_state {
     int64_t hlcCasEpochSeqno;
     bool mightContainXattrs;
     std::string failovers;
+
+    /**
+     * JSON object mapping the name of each connection (DCP/TAP) checkpoint
+     * cursor to the seqno it had reached when this state was persisted.
+     * Used at warmup to rebuild an open checkpoint covering the recent
+     * seqno window so that reconnecting clients can resume from memory
+     * rather than triggering a disk backfill. Empty if no connection
+     * cursors were registered.
+     */
+    std::string streamCursors;
 };
 
 struct DBFileInfo {
@@ -155,6 +172,19 @@ enum class ValueFilter {
     VALUES_DECOMPRESSED
 };
 
+/**
+ * Order in which a scan visits documents.
+ *
+ * BY_ID walks the by-ID index in ascending key order and always covers the
+ * whole keyspace - startSeqno is ignored (callers should pass 0) - so it is
+ * only suitable for full scans whose consumer does not require mutation
+ * order.
+ */
+enum class ScanOrder {
+    BY_SEQNO,
+    BY_ID
+};
+
 enum class VBStatePersist {
     VBSTATE_CACHE_UPDATE_ONLY,       //Update only cached state in-memory
     VBSTATE_PERSIST_WITHOUT_COMMIT,  //Persist without committing to disk
@@ -172,18 +202,24 @@ public:
                 DocumentFilter _docFilter,
                 ValueFilter _valFilter,
                 uint64_t _documentCount,
-                const KVStoreConfig& _config);
+                const KVStoreConfig& _config,
+                ScanOrder _scanOrder = ScanOrder::BY_SEQNO);
 
     const std::shared_ptr<Callback<GetValue> > callback;
     const std::shared_ptr<Callback<CacheLookup> > lookup;
 
     uint64_t lastReadSeqno;
+
+    /* Key of the last document delivered; used to resume a paused
+       ScanOrder::BY_ID scan from where it left off. */
+    std::string lastReadKey;
     const uint64_t startSeqno;
     const uint64_t maxSeqno;
     const size_t scanId;
     const uint16_t vbid;
     const DocumentFilter docFilter;
     const ValueFilter valFilter;
+    const ScanOrder scanOrder;
     const uint64_t documentCount;
 
     Logger* logger;
@@ -241,6 +277,8 @@ public:
       numDelFailure(0),
       numOpenFailure(0),
       numVbSetFailure(0),
+      numHandleCacheHits(0),
+      numHandleCacheMisses(0),
       io_bg_fetch_docs_read(0),
       io_num_write(0),
       io_bgfetch_doc_bytes(0),
@@ -249,7 +287,12 @@ public:
       writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
       getMultiFsReadCount(0),
       getMultiFsReadHisto(ExponentialGenerator<uint32_t>(6, 1.2), 50),
-      getMultiFsReadPerDocHisto(ExponentialGenerator<uint32_t>(6, 1.2),50) {
+      getMultiFsReadPerDocHisto(ExponentialGenerator<uint32_t>(6, 1.2),50),
+      staleWriteBytes(0),
+      flusherWriteAmpHisto(ExponentialGenerator<size_t>(10, 1.4), 25),
+      commitLogSyncs(0),
+      commitLogBytes(0),
+      commitLogCheckpoints(0) {
     }
 
     KVStoreStats(const KVStoreStats &copyFrom) {}
@@ -264,6 +307,8 @@ public:
         numDelFailure = 0;
         numOpenFailure = 0;
         numVbSetFailure = 0;
+        numHandleCacheHits = 0;
+        numHandleCacheMisses = 0;
 
         readTimeHisto.reset();
         readSizeHisto.reset();
@@ -278,6 +323,11 @@ public:
         getMultiFsReadCount = 0;
         getMultiFsReadHisto.reset();
         getMultiFsReadPerDocHisto.reset();
+        staleWriteBytes = 0;
+        flusherWriteAmpHisto.reset();
+        commitLogSyncs = 0;
+        commitLogBytes = 0;
+        commitLogCheckpoints = 0;
         fsStats.reset();
     }
 
@@ -297,6 +347,11 @@ public:
     Couchbase::RelaxedAtomic<size_t> numOpenFailure;
     Couchbase::RelaxedAtomic<size_t> numVbSetFailure;
 
+    /* Read-handle cache hit/miss counters (couchstore backend; see
+       CouchKVStore::openDBCached) */
+    Couchbase::RelaxedAtomic<size_t> numHandleCacheHits;
+    Couchbase::RelaxedAtomic<size_t> numHandleCacheMisses;
+
     /**
      * Number of documents read (full and meta-only) from disk for background
      * fetch operations.
@@ -342,6 +397,26 @@ public:
     // per fetched document.
     Histogram<uint32_t> getMultiFsReadPerDocHisto;
 
+    // Bytes appended by flushes which are not live data (superseded old
+    // versions of documents, plus index pages made stale by the append),
+    // i.e. the rate at which flushes generate work for compaction.
+    Couchbase::RelaxedAtomic<size_t> staleWriteBytes;
+
+    // Per-flush write amplification as a percentage: filesystem bytes
+    // written during the flush * 100 / document bytes (key+meta+value)
+    // in the flush. 100 = no amplification; values below 100 are
+    // possible when document bodies compress well.
+    Histogram<size_t> flusherWriteAmpHisto;
+
+    /* Commit log counters (couchstore backend, when
+       couchstore_commit_log_enabled; see CommitLog) */
+    //! Number of commit log sync() calls (one per flush batch).
+    Couchbase::RelaxedAtomic<size_t> commitLogSyncs;
+    //! Bytes of records appended to the commit log.
+    Couchbase::RelaxedAtomic<size_t> commitLogBytes;
+    //! Number of checkpoints: deferred file fsyncs performed + log reset.
+    Couchbase::RelaxedAtomic<size_t> commitLogCheckpoints;
+
     // Stats from the underlying OS file operations
     FileStats fsStats;
 
@@ -454,6 +529,18 @@ public:
      */
     void addStats(ADD_STAT add_stat, const void *c);
 
+    /**
+     * Add the write-amplification / fragmentation instrumentation for
+     * this shard (served by 'stats kvstore-detail'): logical vs physical
+     * bytes written, stale bytes generated by flushes and fsync latency,
+     * so compaction can be scheduled by measured amplification rather
+     * than the fragmentation percentage alone.
+     *
+     * @param add_stat the callback function to add statistics
+     * @param c the cookie to pass to the callback function
+     */
+    void addDetailStats(ADD_STAT add_stat, const void* c);
+
     /**
      * Request the specified statistic name from the kvstore.
      *
@@ -676,8 +763,19 @@ public:
         return st;
     }
 
+    /**
+     * Return up to `count` keys from the by-ID index, in key order,
+     * starting at `start_key`.
+     *
+     * @param end_key If non-empty, the walk of the index stops at the
+     *        first key greater than this (inclusive bound), rather than
+     *        continuing until `count` keys have been seen. This is
+     *        evaluated inside the index walk, so a narrow range costs
+     *        only the range, not the rest of the file.
+     */
     virtual ENGINE_ERROR_CODE getAllKeys(uint16_t vbid,
-                            const DocKey start_key, uint32_t count,
+                            const DocKey start_key, const DocKey end_key,
+                            uint32_t count,
                             std::shared_ptr<Callback<const DocKey&>> cb) = 0;
 
     /**
@@ -687,6 +785,11 @@ public:
      * destroyScanContext() when finished with.
      *
      * If the ScanContext cannot be created, returns null.
+     *
+     * Stores without a usable by-ID index may silently run a
+     * ScanOrder::BY_ID request in sequence order; the order is an
+     * optimization, not a correctness requirement, and callers must not
+     * depend on it.
      */
     virtual ScanContext* initScanContext(
             std::shared_ptr<Callback<GetValue> > cb,
@@ -694,7 +797,8 @@ public:
             uint16_t vbid,
             uint64_t startSeqno,
             DocumentFilter options,
-            ValueFilter valOptions) = 0;
+            ValueFilter valOptions,
+            ScanOrder scanOrder = ScanOrder::BY_SEQNO) = 0;
 
     virtual scan_error_t scan(ScanContext* sctx) = 0;
 
@@ -715,6 +819,25 @@ public:
      */
     virtual std::string getCollectionsManifest(uint16_t vbid) = 0;
 
+    /**
+     * Persist a vbucket's serialized bloom filter alongside its data so it
+     * can be restored at warmup instead of being rebuilt from a key scan.
+     * Default is a no-op for stores with no side location for it.
+     *
+     * @param vbid ID of the vbucket the filter belongs to
+     * @param data serialized filter (see BloomFilter::serialize())
+     */
+    virtual void saveBloomFilter(uint16_t vbid, const std::string& data) {
+    }
+
+    /**
+     * Read back the serialized bloom filter written by saveBloomFilter();
+     * returns an empty string if none has been persisted.
+     */
+    virtual std::string loadBloomFilter(uint16_t vbid) {
+        return {};
+    }
+
     /**
      * Increment the revision number of the vbucket.
      * @param vbid ID of the vbucket to change.
@@ -26,6 +26,16 @@ public:
     void sizeValueChanged(const std::string& key, size_t value) override {
         if (key == "fsync_after_every_n_bytes_written") {
             config.setPeriodicSyncBytes(value);
+        } else if (key == "compaction_throttle_bytes_per_sec") {
+            config.setCompactionThrottleBytesPerSec(value);
+        }
+    }
+
+    void booleanValueChanged(const std::string& key, bool value) override {
+        if (key == "couchstore_drop_write_cache") {
+            config.setDropWriteCache(value);
+        } else if (key == "couchstore_at_rest_compression") {
+            config.setAtRestCompression(value);
         }
     }
 
@@ -46,6 +56,26 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
     setPeriodicSyncBytes(config.getFsyncAfterEveryNBytesWritten());
     config.addValueChangedListener("fsync_after_every_n_bytes_written",
                                    new ConfigChangeListener(*this));
+    setDropWriteCache(config.isCouchstoreDropWriteCache());
+    config.addValueChangedListener("couchstore_drop_write_cache",
+                                   new ConfigChangeListener(*this));
+    setAtRestCompression(config.isCouchstoreAtRestCompression());
+    config.addValueChangedListener("couchstore_at_rest_compression",
+                                   new ConfigChangeListener(*this));
+    setCompactionThrottleBytesPerSec(
+            config.getCompactionThrottleBytesPerSec());
+    config.addValueChangedListener("compaction_throttle_bytes_per_sec",
+                                   new ConfigChangeListener(*this));
+    // Not dynamic: the cache is created once when the KVStore is
+    // instantiated.
+    setRocksdbBlockCacheSize(config.getRocksdbBlockCacheSize());
+    // Not dynamic: the FileOps chain is built once when the KVStore is
+    // instantiated.
+    setMmapReads(config.isCouchstoreMmapReads());
+    // Not dynamic: the FileOps chain and the log are built once when the
+    // KVStore is instantiated.
+    setCommitLogEnabled(config.isCouchstoreCommitLogEnabled());
+    setCommitLogSyncBytes(config.getCouchstoreCommitLogSyncBytes());
 }
 
 KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
@@ -65,9 +95,17 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       logger(&global_logger),
       buffered(true),
       persistDocNamespace(_persistDocNamespace),
+      periodicSyncBytes(0),
+      compactionThrottleBytesPerSec(0),
+      dropWriteCache(false),
+      mmapReads(false),
+      atRestCompression(true),
+      commitLogEnabled(false),
+      commitLogSyncBytes(8 * 1024 * 1024),
       rocksDBOptions(rocksDBOptions_),
       rocksDBCFOptions(rocksDBCFOptions_),
-      rocksDbBBTOptions(rocksDbBBTOptions_) {
+      rocksDbBBTOptions(rocksDbBBTOptions_),
+      rocksdbBlockCacheSize(0) {
     // We pass RocksDB Options (through `configuration.json` and the
     // `-e "<config>"` command line argument for tests) as comma-separated
     // <option>=<value> pairs, but RocksDB can parse only semicolon-separated
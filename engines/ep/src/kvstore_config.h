@@ -111,6 +111,95 @@ public:
         periodicSyncBytes = bytes;
     }
 
+    /**
+     * If non-zero, bound the rate (bytes/sec of document data) at which a
+     * compaction copies the source file, yielding the disk between bounded
+     * chunks so reads and backfills are not starved.
+     *
+     * Only recognised by CouchKVStore
+     */
+    uint64_t getCompactionThrottleBytesPerSec() const {
+        return compactionThrottleBytesPerSec;
+    }
+
+    void setCompactionThrottleBytesPerSec(uint64_t bytes) {
+        compactionThrottleBytesPerSec = bytes;
+    }
+
+    /**
+     * If true, evict flusher and compaction writes from the OS page cache
+     * once they have been committed, so write traffic does not fight hot
+     * read data for cache space.
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool shouldDropWriteCache() const {
+        return dropWriteCache;
+    }
+
+    void setDropWriteCache(bool value) {
+        dropWriteCache = value;
+    }
+
+    /**
+     * If true, serve couch file reads from a read-only memory mapping
+     * (with pread fallback) instead of a syscall per read.
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool shouldUseMmapReads() const {
+        return mmapReads;
+    }
+
+    void setMmapReads(bool value) {
+        mmapReads = value;
+    }
+
+    /**
+     * If true, values which the client didn't already send compressed
+     * are snappy-compressed when they are persisted, so the on-disk
+     * footprint doesn't depend on whether the client negotiated the
+     * snappy datatype.
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool shouldCompressAtRest() const {
+        return atRestCompression;
+    }
+
+    void setAtRestCompression(bool value) {
+        atRestCompression = value;
+    }
+
+    /**
+     * If true, flush batches are made durable via a single sequential
+     * fsync of a per-shard commit log, and the per-file fsyncs of
+     * couchstore commits are deferred (see getCommitLogSyncBytes()).
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool isCommitLogEnabled() const {
+        return commitLogEnabled;
+    }
+
+    void setCommitLogEnabled(bool value) {
+        commitLogEnabled = value;
+    }
+
+    /**
+     * Size the commit log may reach before the deferred couch file
+     * fsyncs are performed and the log is reset.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getCommitLogSyncBytes() const {
+        return commitLogSyncBytes;
+    }
+
+    void setCommitLogSyncBytes(size_t bytes) {
+        commitLogSyncBytes = bytes;
+    }
+
     /*
      * Return the RocksDB Database level options.
      */
@@ -132,6 +221,21 @@ public:
         return rocksDbBBTOptions;
     }
 
+    /**
+     * Bucket-level budget (in bytes) for the RocksDB block cache; each
+     * shard creates one cache of an equal share of this, used by all its
+     * vbucket DBs. Zero leaves RocksDB's default per-DB cache.
+     *
+     * Only recognised by RocksDBKVStore
+     */
+    size_t getRocksdbBlockCacheSize() const {
+        return rocksdbBlockCacheSize;
+    }
+
+    void setRocksdbBlockCacheSize(size_t bytes) {
+        rocksdbBlockCacheSize = bytes;
+    }
+
 private:
     class ConfigChangeListener;
 
@@ -150,6 +254,42 @@ private:
      */
     uint64_t periodicSyncBytes;
 
+    /**
+     * If non-zero, rate bound (bytes/sec) on compaction's copy phase (see
+     * getCompactionThrottleBytesPerSec()).
+     */
+    uint64_t compactionThrottleBytesPerSec;
+
+    /**
+     * If true, committed writes are dropped from the OS page cache (see
+     * shouldDropWriteCache()).
+     */
+    bool dropWriteCache;
+
+    /**
+     * If true, couch file reads are served from a memory mapping (see
+     * shouldUseMmapReads()).
+     */
+    bool mmapReads;
+
+    /**
+     * If true, values are compressed when written to disk (see
+     * shouldCompressAtRest()).
+     */
+    bool atRestCompression;
+
+    /**
+     * If true, flush durability comes from a per-shard commit log (see
+     * isCommitLogEnabled()).
+     */
+    bool commitLogEnabled;
+
+    /**
+     * Commit log size at which the deferred file fsyncs are performed
+     * (see getCommitLogSyncBytes()).
+     */
+    size_t commitLogSyncBytes;
+
     // RocksDB Database level options. Semicolon-separated `<option>=<value>`
     // pairs.
     std::string rocksDBOptions;
@@ -159,4 +299,8 @@ private:
     // RocksDB Block Based Table options. Semicolon-separated
     // `<option>=<value>` pairs.
     std::string rocksDbBBTOptions;
+
+    // Bucket-level RocksDB block cache budget in bytes (see
+    // getRocksdbBlockCacheSize()).
+    size_t rocksdbBlockCacheSize;
 };
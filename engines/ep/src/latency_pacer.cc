@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "latency_pacer.h"
+
+#include "stats.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+constexpr double LatencyPacer::backoffSleep;
+constexpr double LatencyPacer::fullChunkThreshold;
+constexpr double LatencyPacer::backoffThreshold;
+constexpr double LatencyPacer::minChunkFraction;
+constexpr uint64_t LatencyPacer::minWindowOps;
+const std::chrono::seconds LatencyPacer::samplePeriod{1};
+
+LatencyPacer::LatencyPacer(EPStats& stats)
+    : stats(stats),
+      lastSample(ProcessClock::now() - samplePeriod),
+      baselineP99(0),
+      pressure(1.0) {
+}
+
+std::chrono::milliseconds LatencyPacer::paceChunkDuration(
+        std::chrono::milliseconds nominal) {
+    sample();
+
+    const double p = getPressure();
+    if (p <= fullChunkThreshold) {
+        return nominal;
+    }
+    if (p >= backoffThreshold) {
+        return std::chrono::milliseconds::zero();
+    }
+    // Scale linearly from the full chunk at fullChunkThreshold down to
+    // minChunkFraction of it just below backoffThreshold.
+    const double span = backoffThreshold - fullChunkThreshold;
+    const double fraction =
+            1.0 - ((p - fullChunkThreshold) / span) * (1.0 - minChunkFraction);
+    return std::chrono::milliseconds(
+            std::max(int64_t(1), int64_t(nominal.count() * fraction)));
+}
+
+void LatencyPacer::sample(bool force) {
+    std::lock_guard<std::mutex> lh(lock);
+
+    const auto now = ProcessClock::now();
+    if (!force && (now - lastSample) < samplePeriod) {
+        return;
+    }
+    lastSample = now;
+
+    uint64_t windowOps = 0;
+    const hrtime_t getP99 =
+            windowedP99(stats.getCmdHisto, prevGetCounts, windowOps);
+    const hrtime_t storeP99 =
+            windowedP99(stats.storeCmdHisto, prevStoreCounts, windowOps);
+    const hrtime_t p99 = std::max(getP99, storeP99);
+
+    if (windowOps < minWindowOps) {
+        // Too few front-end operations in this window to judge latency;
+        // treat the node as quiet so background tasks can catch up.
+        pressure.store(1.0, std::memory_order_relaxed);
+        return;
+    }
+
+    if (baselineP99 == 0 || p99 < baselineP99) {
+        // Follow improvements immediately.
+        baselineP99 = p99;
+    } else {
+        // Drift the baseline upwards slowly, so a sustained workload
+        // change eventually becomes the new normal instead of suppressing
+        // background hygiene indefinitely.
+        baselineP99 += (p99 - baselineP99) / 64;
+    }
+
+    pressure.store((baselineP99 != 0) ? double(p99) / double(baselineP99)
+                                      : 1.0,
+                   std::memory_order_relaxed);
+}
+
+hrtime_t LatencyPacer::windowedP99(const Histogram<hrtime_t>& histo,
+                                   std::vector<uint64_t>& prevCounts,
+                                   uint64_t& windowOps) {
+    // Capture the current per-bin counts and the deltas against the
+    // previous sample. Bin layout is fixed at histogram construction, so
+    // comparing by index is safe; the counts themselves may race with
+    // front-end threads adding samples, which only perturbs which window
+    // an operation is attributed to.
+    std::vector<uint64_t> current;
+    std::vector<uint64_t> delta;
+    std::vector<hrtime_t> upperBound;
+    for (auto it = histo.begin(); it != histo.end(); ++it) {
+        const uint64_t count = (*it)->count();
+        const size_t idx = current.size();
+        const uint64_t prev = (idx < prevCounts.size()) ? prevCounts[idx] : 0;
+        current.push_back(count);
+        // A histogram reset would make count < prev; fall back to the
+        // absolute count in that case.
+        delta.push_back((count >= prev) ? count - prev : count);
+        // The final bin is open-ended; use its lower bound as the
+        // representative value (as the stats percentile reporting does).
+        upperBound.push_back(
+                ((*it)->end() == std::numeric_limits<hrtime_t>::max())
+                        ? (*it)->start()
+                        : (*it)->end());
+    }
+    prevCounts = std::move(current);
+
+    const uint64_t total =
+            std::accumulate(delta.begin(), delta.end(), uint64_t(0));
+    windowOps += total;
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t target = std::max(uint64_t(1), uint64_t(0.99 * total));
+    uint64_t seen = 0;
+    hrtime_t value = 0;
+    for (size_t ii = 0; ii < delta.size(); ++ii) {
+        if (delta[ii] == 0) {
+            continue;
+        }
+        seen += delta[ii];
+        value = upperBound[ii];
+        if (seen >= target) {
+            break;
+        }
+    }
+    return value;
+}
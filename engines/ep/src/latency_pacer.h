@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <platform/histogram.h>
+#include <platform/platform.h>
+#include <platform/processclock.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+class EPStats;
+
+/**
+ * Closed-loop pacing signal for budgeted background visitor tasks.
+ *
+ * Visitor tasks (defragmenter, ephemeral tombstone purgers) run in fixed
+ * time-slice chunks via ProgressTracker. A fixed slice is oblivious to what
+ * the front-end is experiencing - background hygiene keeps consuming CPU and
+ * cache even while operation latency is already degraded. LatencyPacer
+ * closes the loop: it periodically samples the engine's front-end command
+ * latency histograms (get / store), computes the p99 of just the operations
+ * observed since the previous sample, and compares that against a
+ * slowly-adapting baseline of "quiet" latency. Before each chunk a task asks
+ * the pacer to scale its nominal chunk duration:
+ *
+ *  - latency at / near the baseline -> full chunk (catch up while quiet),
+ *  - moderately degraded            -> a proportionally smaller chunk,
+ *  - severely degraded              -> zero; the task should skip the chunk
+ *                                      entirely and back off.
+ *
+ * The baseline follows the windowed p99 downwards immediately but drifts
+ * upwards only slowly, so a sustained shift in the workload eventually
+ * becomes the new "normal" rather than suppressing hygiene indefinitely.
+ */
+class LatencyPacer {
+public:
+    explicit LatencyPacer(EPStats& stats);
+
+    /**
+     * Scale a visitor task's nominal chunk duration by the current
+     * front-end latency pressure.
+     *
+     * @return the duration the task should use as its chunk budget; zero
+     *         means the task should skip the chunk and back off.
+     */
+    std::chrono::milliseconds paceChunkDuration(
+            std::chrono::milliseconds nominal);
+
+    /**
+     * Take a latency sample now if the sample period has elapsed since the
+     * last one (or unconditionally if force is set). Called implicitly by
+     * paceChunkDuration(); public to allow tests to drive sampling.
+     */
+    void sample(bool force = false);
+
+    /**
+     * Current latency pressure - ratio of the most recent sample window's
+     * p99 to the baseline p99. 1.0 means the node is quiet.
+     */
+    double getPressure() const {
+        return pressure.load(std::memory_order_relaxed);
+    }
+
+    /// How long (seconds) a task should snooze after being paced to zero.
+    static constexpr double backoffSleep = 1.0;
+
+    /// Pressure at/below which tasks are given their full chunk.
+    static constexpr double fullChunkThreshold = 1.5;
+
+    /// Pressure at/above which tasks are asked to back off entirely.
+    static constexpr double backoffThreshold = 4.0;
+
+    /// Smallest fraction of the nominal chunk handed out before backoff.
+    static constexpr double minChunkFraction = 0.25;
+
+    /// Minimum front-end ops in a window for its p99 to be trusted.
+    static constexpr uint64_t minWindowOps = 100;
+
+private:
+    /**
+     * Compute the p99 (in histogram units) of just the operations added to
+     * histo since the counts in prevCounts were captured. Updates prevCounts
+     * to the current per-bin counts and adds the number of new operations
+     * to windowOps. Returns 0 if the window is empty.
+     */
+    static hrtime_t windowedP99(const Histogram<hrtime_t>& histo,
+                                std::vector<uint64_t>& prevCounts,
+                                uint64_t& windowOps);
+
+    EPStats& stats;
+
+    /// Serialises sampling (tasks on different threads share one pacer).
+    std::mutex lock;
+
+    /// Per-bin counts of the get/store histograms at the last sample.
+    std::vector<uint64_t> prevGetCounts;
+    std::vector<uint64_t> prevStoreCounts;
+
+    ProcessClock::time_point lastSample;
+
+    /// Adaptive estimate of the quiet-node p99; 0 until the first
+    /// sufficiently-populated window has been seen.
+    hrtime_t baselineP99;
+
+    /// p99 of the most recent sample window divided by baselineP99.
+    std::atomic<double> pressure;
+
+    /// How often the histograms are (re)read; sampling more frequently
+    /// than this is wasted work as the windows become too sparse.
+    static const std::chrono::seconds samplePeriod;
+};
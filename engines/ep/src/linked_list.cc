@@ -64,9 +64,10 @@ SequenceList::UpdateStatus BasicLinkedList::updateListElem(
         std::lock_guard<std::mutex>& seqLock,
         std::lock_guard<std::mutex>& writeLock,
         OrderedStoredValue& v) {
-    /* Lock that needed for consistent read of SeqRange 'readRange' */
-    std::lock_guard<SpinLock> lh(rangeLock);
-
+    /* Lock-free check of 'readRange'; a racing advance of the range begin
+       by the in-flight range read can at worst make us see a stale (larger)
+       range and take the conservative Append path. Range set up cannot race
+       with us as it is done under the writeLock which we hold. */
     if (readRange.fallsInRange(v.getBySeqno())) {
         /* Range read is in middle of a point-in-time snapshot, hence we cannot
            move the element to the end of the list. Return a temp failure */
@@ -105,7 +106,6 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
 
     {
         std::lock_guard<std::mutex> listWriteLg(getListWriteLock());
-        std::lock_guard<SpinLock> lh(rangeLock);
         if (start > highSeqno) {
             LOG(EXTENSION_LOG_WARNING,
                 "BasicLinkedList::rangeRead(): "
@@ -137,12 +137,10 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
             break;
         }
 
-        {
-            std::lock_guard<SpinLock> lh(rangeLock);
-            readRange.setBegin(currSeqno); /* [EPHE TODO]: should we
-                                                     update the min every time ?
-                                                   */
-        }
+        /* As we move past the items in the list, advance the begin of
+           'readRange' (lock-free) to reduce the window in which front-end
+           updates are forced to append rather than de-duplicate */
+        readRange.setBegin(currSeqno);
 
         if (currSeqno < start) {
             /* skip this item */
@@ -151,9 +149,13 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
 
         /* Check if this OSV has been made stale and has been superseded by a
          * newer version. If it has, and the replacement is /also/ in the range
-         * we are reading, we should skip this item to avoid duplicates */
-        StoredValue* replacement;
-        {
+         * we are reading, we should skip this item to avoid duplicates.
+         * The check is lock-free for the (common) non-stale case; only once
+         * an item is seen to be stale do we need the writeLock to safely
+         * read the replacement pointer. This keeps a long range read from
+         * contending with front-end writes on every element. */
+        StoredValue* replacement = nullptr;
+        if (osv.isStaleNoLock()) {
             std::lock_guard<std::mutex> writeGuard(getListWriteLock());
             replacement = osv.getReplacementIfStale(writeGuard);
         }
@@ -182,10 +184,7 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
     }
 
     /* Done with range read, reset the range */
-    {
-        std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
-    }
+    readRange.reset();
 
     /* Return all the range read items */
     return std::make_tuple(ENGINE_SUCCESS, std::move(items), end);
@@ -232,7 +231,8 @@ void BasicLinkedList::markItemStale(std::lock_guard<std::mutex>& listWriteLg,
 }
 
 size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
-                                        std::function<bool()> shouldPause) {
+                                        std::function<bool()> shouldPause,
+                                        size_t purgeBatchSize) {
     // Purge items marked as stale from the seqList.
     //
     // Strategy - we try to ensure that this function does not block
@@ -247,11 +247,10 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
     // However, we do need to be careful about what members of OSVs we access
     // here - the only OSVs we can safely access are ones marked stale as they
     // are no longer in the HashTable (and hence subject to HashTable locks).
-    // To check if an item is stale we need to acquire the writeLock
-    // (OSV::stale is guarded by it) for each list item. While this isn't
-    // ideal (that's the same lock needed by front-end operations), we can
-    // release the lock between each element so front-end operations can
-    // have the opportunity to acquire it.
+    // The stale flag itself transitions false -> true exactly once so it can
+    // be checked lock-free (isStaleNoLock); only the actual removal of an
+    // element needs the writeLock, keeping the purge from contending with
+    // front-end operations on every element it merely walks past.
     //
     // Attempt to acquire the readRangeLock, to block anyone else concurrently
     // reading from the list while we remove elements from it.
@@ -286,38 +285,37 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
         }
 
         // Update readRange
-        std::lock_guard<SpinLock> rangeGuard(rangeLock);
         readRange = SeqRange(startIt->getBySeqno(), purgeUpToSeqno);
     }
 
     // Iterate across all but the last item in the seqList, looking
-    // for stale items.
+    // for stale items. Stale elements are collected up and unlinked in
+    // batches - up to purgeBatchSize at a time under a single writeLock
+    // acquisition - so a heavy purge does not force front-end writes to
+    // take turns with us on every element.
     size_t purgedCount = 0;
-    bool stale;
+    std::vector<OrderedStoredValue*> pendingPurge;
+    pendingPurge.reserve(std::min(purgeBatchSize, size_t(128)));
     for (auto it = startIt; it != seqList.end();) {
         if (it->getBySeqno() > purgeUpToSeqno) {
             break;
         }
 
-        {
-            // As we move past the items in the list, increment the begin of
-            // 'readRange' to reduce the window of creating stale items during
-            // updates
-            std::lock_guard<SpinLock> rangeGuard(rangeLock);
-            readRange.setBegin(it->getBySeqno());
-        }
+        // As we move past the items in the list, increment the begin of
+        // 'readRange' (lock-free) to reduce the window of creating stale
+        // items during updates
+        readRange.setBegin(it->getBySeqno());
 
-        {
-            std::lock_guard<std::mutex> writeGuard(getListWriteLock());
-            stale = it->isStale(writeGuard);
+        // Only stale items are purged. Deferring the unlink is safe - stale
+        // elements are owned by the list (no longer in the HashTable) so
+        // nothing else will access or move them in the meantime.
+        if (it->isStaleNoLock()) {
+            pendingPurge.push_back(&*it);
         }
-        // Only stale items are purged.
-        if (!stale) {
-            ++it;
-        } else {
-            // Checks pass, remove from list and delete.
-            it = purgeListElem(it);
-            ++purgedCount;
+        ++it;
+
+        if (pendingPurge.size() >= purgeBatchSize) {
+            purgedCount += purgeBatch(pendingPurge);
         }
 
         if (shouldPause()) {
@@ -326,14 +324,40 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
         }
     }
 
+    // Unlink any remaining batched elements.
+    purgedCount += purgeBatch(pendingPurge);
+
     // Complete; reset the readRange.
-    {
-        std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
-    }
+    readRange.reset();
     return purgedCount;
 }
 
+std::pair<std::vector<StoredDocKey>, seqno_t>
+BasicLinkedList::pickEvictionCandidates(size_t maxItems, seqno_t fromSeqno) {
+    std::vector<StoredDocKey> candidates;
+    candidates.reserve(maxItems);
+    seqno_t lastExamined = fromSeqno;
+
+    std::lock_guard<std::mutex> lckGd(getListWriteLock());
+    for (const auto& osv : seqList) {
+        if (osv.getBySeqno() <= fromSeqno) {
+            continue;
+        }
+        if (candidates.size() >= maxItems) {
+            break;
+        }
+        lastExamined = osv.getBySeqno();
+        if (osv.isStaleNoLock() || osv.isDeleted()) {
+            // Stale values are owned by the list (no longer in the
+            // HashTable), and tombstones cannot be paged out any further;
+            // both are reclaimed by the tombstone purger instead.
+            continue;
+        }
+        candidates.push_back(StoredDocKey(osv.getKey()));
+    }
+    return {std::move(candidates), lastExamined};
+}
+
 void BasicLinkedList::updateNumDeletedItems(bool oldDeleted, bool newDeleted) {
     if (oldDeleted && !newDeleted) {
         --numDeletedItems;
@@ -379,12 +403,10 @@ seqno_t BasicLinkedList::getHighestPurgedDeletedSeqno() const {
 }
 
 uint64_t BasicLinkedList::getRangeReadBegin() const {
-    std::lock_guard<SpinLock> lh(rangeLock);
     return readRange.getBegin();
 }
 
 uint64_t BasicLinkedList::getRangeReadEnd() const {
-    std::lock_guard<SpinLock> lh(rangeLock);
     return readRange.getEnd();
 }
 std::mutex& BasicLinkedList::getListWriteLock() const {
@@ -417,29 +439,40 @@ std::ostream& operator <<(std::ostream& os, const BasicLinkedList& ll) {
     return os;
 }
 
-OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it) {
-    StoredValue::UniquePtr purged(&*it);
-    {
-        std::lock_guard<std::mutex> lckGd(getListWriteLock());
-        it = seqList.erase(it);
+size_t BasicLinkedList::purgeBatch(std::vector<OrderedStoredValue*>& batch) {
+    if (batch.empty()) {
+        return 0;
     }
 
-    /* Update the stats tracking the memory owned by the list */
-    staleSize.fetch_sub(purged->size());
-    staleMetaDataSize.fetch_sub(purged->metaDataSize());
-    st.currentSize.fetch_sub(purged->metaDataSize());
-
-    // Similary for the item counts:
-    --numStaleItems;
-    if (purged->isDeleted()) {
-        --numDeletedItems;
+    /* Unlink the whole batch under a single writeLock acquisition */
+    {
+        std::lock_guard<std::mutex> lckGd(getListWriteLock());
+        for (auto* v : batch) {
+            seqList.erase(seqList.iterator_to(*v));
+        }
     }
 
-    if (purged->isDeleted()) {
-        highestPurgedDeletedSeqno = std::max(seqno_t(highestPurgedDeletedSeqno),
-                                             purged->getBySeqno());
+    /* Destroy the values and update the stats outside the lock */
+    const size_t purged = batch.size();
+    for (auto* v : batch) {
+        StoredValue::UniquePtr purgedSv(v);
+
+        /* Update the stats tracking the memory owned by the list */
+        staleSize.fetch_sub(purgedSv->size());
+        staleMetaDataSize.fetch_sub(purgedSv->metaDataSize());
+        st.currentSize.fetch_sub(purgedSv->metaDataSize());
+
+        // Similary for the item counts:
+        --numStaleItems;
+        if (purgedSv->isDeleted()) {
+            --numDeletedItems;
+            highestPurgedDeletedSeqno = std::max(
+                    seqno_t(highestPurgedDeletedSeqno),
+                    purgedSv->getBySeqno());
+        }
     }
-    return it;
+    batch.clear();
+    return purged;
 }
 
 std::unique_ptr<BasicLinkedList::RangeIteratorLL>
@@ -466,7 +499,6 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
     }
 
     std::lock_guard<std::mutex> listWriteLg(list.getListWriteLock());
-    std::lock_guard<SpinLock> lh(list.rangeLock);
     if (list.highSeqno < 1) {
         /* No need of holding a lock for the snapshot as there are no items;
            Also iterator range is at default (0, 0) */
@@ -510,7 +542,6 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
 }
 
 BasicLinkedList::RangeIteratorLL::~RangeIteratorLL() {
-    std::lock_guard<SpinLock> lh(list.rangeLock);
     if (readLockHolder.owns_lock()) {
         /* we must reset the list readRange only if the list iterator still owns
            the read lock on the list */
@@ -560,7 +591,6 @@ void BasicLinkedList::RangeIteratorLL::incrOperatorHelper() {
     /* Check if the iterator is pointing to the last element. Increment beyond
        the last element indicates the end of the iteration */
     if (curr() == itrRange.getEnd() - 1) {
-        std::lock_guard<SpinLock> lh(list.rangeLock);
         /* We reset the range and release the readRange lock here so that any
            iterator client that does not delete the iterator obj will not end up
            holding the list readRange lock forever */
@@ -577,13 +607,11 @@ void BasicLinkedList::RangeIteratorLL::incrOperatorHelper() {
     }
 
     ++currIt;
-    {
-        /* As the iterator moves we reduce the snapshot range being read on the
-           linked list. This helps reduce the stale items in the list during
-           heavy update load from the front end */
-        std::lock_guard<SpinLock> lh(list.rangeLock);
-        list.readRange.setBegin(currIt->getBySeqno());
-    }
+
+    /* As the iterator moves we reduce the snapshot range being read on the
+       linked list (lock-free; see SeqRange). This helps reduce the stale
+       items in the list during heavy update load from the front end */
+    list.readRange.setBegin(currIt->getBySeqno());
 
     /* Also update the current range stored in the iterator obj */
     itrRange.setBegin(currIt->getBySeqno());
@@ -593,12 +621,12 @@ bool BasicLinkedList::RangeIteratorLL::itrRangeContainsAnUpdatedVersion() {
     /* Check if this OSV has been made stale and has been superseded by a
        newer version. If it has, and the replacement is /also/ in the range
        we are reading, we should skip this item to avoid duplicates */
-    StoredValue* replacement;
-    {
-        /* Writer and tombstone purger hold the 'list.writeLock' when they
-           change the pointer to the replacement OSV, and hence it would not be
-           safe to read the uniquePtr without preventing concurrent changes to
-           it */
+    /* The stale flag is checked lock-free; only once an item is seen to be
+       stale do we take 'list.writeLock' to safely read the replacement
+       pointer (writers hold it when they change the pointer). This keeps the
+       iterator from contending with front-end writes on every element. */
+    StoredValue* replacement = nullptr;
+    if ((*(*this)).isStaleNoLock()) {
         std::lock_guard<std::mutex> writeGuard(list.getListWriteLock());
         replacement = (*(*this)).getReplacementIfStale(writeGuard);
     }
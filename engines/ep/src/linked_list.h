@@ -46,6 +46,16 @@ using OrderedLL = boost::intrusive::list<OrderedStoredValue, MemberHookOption>;
  * Class that represents a range of sequence numbers.
  * SeqRange is closed, that is, both begin and end are inclusive.
  *
+ * The range is modified by at most one writer at a time (writers are
+ * serialized by the list's rangeReadLock), but may be checked lock-free by
+ * concurrent readers (e.g. front-end updates deciding whether an in-place
+ * de-duplication is allowed); hence begin and end are atomic. Once set, a
+ * range only ever shrinks - begin monotonically advances as the range read
+ * proceeds and reset() empties it - so a lock-free reader observing
+ * slightly stale values can only over-estimate the range. That is safe:
+ * it merely forces the conservative action (append a new version instead
+ * of de-duplicating in place).
+ *
  * Note: begin <= 0 is considered an default/inactive range and can be set
  *       only by ctor or by reset.
  */
@@ -53,16 +63,23 @@ class SeqRange {
 public:
     SeqRange(const seqno_t beginVal, const seqno_t endVal)
         : end(endVal), begin(beginVal) {
-        if ((end < begin) || (begin < 0)) {
+        if ((endVal < beginVal) || (beginVal < 0)) {
             throw std::invalid_argument("Trying to create invalid SeqRange: [" +
-                                        std::to_string(begin) + ", " +
-                                        std::to_string(end) + "]");
+                                        std::to_string(beginVal) + ", " +
+                                        std::to_string(endVal) + "]");
         }
     }
 
     SeqRange& operator=(const SeqRange& other) {
-        begin = other.begin;
-        end = other.end;
+        /* Publish the new end before the new begin; lock-free readers load
+           begin first (acquire), so the range only becomes visible once
+           both fields are in place. A reader catching the transition may
+           see the old begin with the new end - a superset of both ranges -
+           which errs on the conservative (safe) side. */
+        end.store(other.end.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+        begin.store(other.begin.load(std::memory_order_relaxed),
+                    std::memory_order_release);
         return *this;
     }
 
@@ -70,42 +87,49 @@ public:
      * Returns true if the range overlaps with another.
      */
     bool overlaps(const SeqRange& other) const {
-        return std::max(begin, other.begin) <= std::min(end, other.end);
+        return std::max(getBegin(), other.getBegin()) <=
+               std::min(getEnd(), other.getEnd());
     }
 
     /**
-     *  Returns true if the seqno falls in the range
+     *  Returns true if the seqno falls in the range.
+     *  Safe to call without any lock held; see class comment.
      */
     bool fallsInRange(const seqno_t seqno) const {
-        return (seqno >= begin) && (seqno <= end);
+        /* The acquire load of begin pairs with the release store in
+           operator=/setBegin and orders the subsequent load of end */
+        return (seqno >= begin.load(std::memory_order_acquire)) &&
+               (seqno <= end.load(std::memory_order_relaxed));
     }
 
     void reset() {
-        begin = 0;
-        end = 0;
+        /* begin is cleared first so a lock-free reader never observes a
+           partially-cleared but still-active range */
+        begin.store(0, std::memory_order_relaxed);
+        end.store(0, std::memory_order_relaxed);
     }
 
     seqno_t getBegin() const {
-        return begin;
+        return begin.load(std::memory_order_relaxed);
     }
 
     void setBegin(const seqno_t start) {
-        if ((start <= 0) || (start > end)) {
+        if ((start <= 0) || (start > end.load(std::memory_order_relaxed))) {
             throw std::invalid_argument(
                     "Trying to set incorrect begin " + std::to_string(start) +
-                    " on SeqRange: [" + std::to_string(begin) + ", " +
-                    std::to_string(end) + "]");
+                    " on SeqRange: [" + std::to_string(getBegin()) + ", " +
+                    std::to_string(getEnd()) + "]");
         }
-        begin = start;
+        begin.store(start, std::memory_order_release);
     }
 
     seqno_t getEnd() const {
-        return end;
+        return end.load(std::memory_order_relaxed);
     }
 
 private:
-    seqno_t end;
-    seqno_t begin;
+    std::atomic<seqno_t> end;
+    std::atomic<seqno_t> begin;
 };
 
 /**
@@ -133,17 +157,22 @@ private:
  *
  * Ordering/Hierarchy of Locks:
  * ===========================
- * BasicLinkedList has 3 locks namely:
- * (i) writeLock (ii) rangeLock (iii) rangeReadLock
+ * BasicLinkedList has 2 locks namely:
+ * (i) writeLock (ii) rangeReadLock
  * Description of each lock can be found below in the class declaration, here
  * we describe in what order the locks should be grabbed
  *
- * rangeReadLock ==> writeLock ==> rangeLock is the valid lock hierarchy.
+ * rangeReadLock ==> writeLock is the valid lock hierarchy.
+ *
+ * The 'readRange' itself is not lock protected: it is modified only by the
+ * single in-flight range read / purge (serialized by rangeReadLock, with
+ * initial set up additionally under writeLock) and is checked lock-free by
+ * front-end writers - see SeqRange above.
  *
  * Preferred/Expected Lock Duration:
  * ================================
- * 'writeLock' and 'rangeLock' are held for short durations, typically for
- * single list element writes and reads.
+ * 'writeLock' is held for short durations, typically for single list
+ * element writes and reads.
  * 'rangeReadLock' is held for longer duration on the list (for entire range).
  */
 class BasicLinkedList : public SequenceList {
@@ -174,10 +203,13 @@ public:
                        StoredValue::UniquePtr ownedSv,
                        StoredValue* newSv) override;
 
-    size_t purgeTombstones(seqno_t purgeUpToSeqno,
-                           std::function<bool()> shouldPause = []() {
-                               return false;
-                           }) override;
+    size_t purgeTombstones(
+            seqno_t purgeUpToSeqno,
+            std::function<bool()> shouldPause = []() { return false; },
+            size_t purgeBatchSize = 128) override;
+
+    std::pair<std::vector<StoredDocKey>, seqno_t> pickEvictionCandidates(
+            size_t maxItems, seqno_t fromSeqno) override;
 
     void updateNumDeletedItems(bool oldDeleted, bool newDeleted) override;
 
@@ -223,16 +255,15 @@ protected:
      * Used to mark of the range where point-in-time snapshot is happening.
      * To get a valid point-in-time snapshot and for correct list iteration we
      * must not de-duplicate an item in the list in this range.
+     *
+     * Written only by the single in-flight range read or tombstone purge
+     * (serialized by rangeReadLock; the initial set up of a range is
+     * additionally done under the writeLock so it cannot interleave with a
+     * front-end update). Checked lock-free by front-end writers
+     * (updateListElem); SeqRange's atomic members make that safe.
      */
     SeqRange readRange;
 
-    /**
-     * Lock that protects readRange.
-     * We use spinlock here since the lock is held only for very small time
-     * periods.
-     */
-    mutable SpinLock rangeLock;
-
     /**
      * Lock that serializes range reads on the 'seqList' - i.e. serializes
      * the addition / removal of range reads from the set in-flight.
@@ -257,7 +288,14 @@ protected:
     Couchbase::RelaxedAtomic<size_t> staleMetaDataSize;
 
 private:
-    OrderedLL::iterator purgeListElem(OrderedLL::iterator it);
+    /**
+     * Unlink all elements in 'batch' from the list under a single
+     * acquisition of the writeLock, then destroy them (and update the
+     * stats) outside the lock. Clears 'batch'.
+     *
+     * @return the number of elements purged.
+     */
+    size_t purgeBatch(std::vector<OrderedStoredValue*>& batch);
 
     /**
      * We need to keep track of the highest seqno separately because there is a
@@ -267,7 +305,7 @@ private:
      * highseqno is monotonically increasing and is reset to a lower value
      * only in case of a rollback.
      *
-     * Guarded by rangeLock.
+     * Guarded by the list's writeLock.
      */
     Monotonic<seqno_t> highSeqno;
 
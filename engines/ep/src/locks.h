@@ -22,11 +22,13 @@
 
 #include <platform/processclock.h>
 #include <platform/rwlock.h>
+#include <array>
 #include <functional>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 #include "utility.h"
 
@@ -114,6 +116,87 @@ private:
 #define WriterLockHolder(x) \
     static_assert(false, "WriterLockHolder: missing variable name for scoped lock.")
 
+/**
+ * A "big-reader" reader-writer lock, for read-mostly data where the reader
+ * side is acquired on the per-operation fast path (e.g. the per-VBucket state
+ * lock). The lock is split into a number of stripes, each padded to its own
+ * cacheline; a reader acquires only the stripe selected by its thread
+ * identity, so concurrent readers on different threads no longer serialize on
+ * a single lock word. A writer must acquire every stripe (always in stripe
+ * order, so writers cannot deadlock against each other), making the write
+ * side proportionally more expensive - acceptable when writes are rare
+ * compared to the per-operation read acquisitions.
+ */
+class StripedRWLock {
+public:
+    static const size_t NUM_STRIPES = 8;
+
+    /**
+     * RAII holder of the read side; acquires just the calling thread's
+     * stripe.
+     */
+    class ReadHolder {
+    public:
+        ReadHolder(StripedRWLock& striped)
+            : lh(striped.stripes[getThreadStripe()].rwLock) {
+        }
+
+    private:
+        std::lock_guard<cb::ReaderLock> lh;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadHolder);
+    };
+
+    /**
+     * RAII holder of the write side; acquires the writer lock of every
+     * stripe, excluding all readers.
+     */
+    class WriteHolder {
+    public:
+        WriteHolder(StripedRWLock& striped) : lock(striped) {
+            for (auto& stripe : lock.stripes) {
+                cb::WriterLock& writer = stripe.rwLock;
+                writer.lock();
+            }
+        }
+
+        ~WriteHolder() {
+            for (auto it = lock.stripes.rbegin(); it != lock.stripes.rend();
+                 ++it) {
+                cb::WriterLock& writer = it->rwLock;
+                writer.unlock();
+            }
+        }
+
+    private:
+        StripedRWLock& lock;
+
+        DISALLOW_COPY_AND_ASSIGN(WriteHolder);
+    };
+
+private:
+    /**
+     * Stripe index of the calling thread; fixed for the thread's lifetime so
+     * a thread always locks and unlocks the same stripe.
+     */
+    static size_t getThreadStripe() {
+        static thread_local const size_t stripe =
+                std::hash<std::thread::id>()(std::this_thread::get_id()) %
+                NUM_STRIPES;
+        return stripe;
+    }
+
+    /**
+     * Each stripe is padded to a cacheline so readers on different stripes
+     * do not false-share.
+     */
+    struct alignas(64) Stripe {
+        cb::RWLock rwLock;
+    };
+
+    std::array<Stripe, NUM_STRIPES> stripes;
+};
+
 /**
  * Lock holder wrapper to assist to debugging locking issues - Logs when the
  * time taken to acquire a lock, or the duration a lock is held exceeds the
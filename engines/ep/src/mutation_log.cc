@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <fcntl.h>
+#include <platform/compress.h>
 #include <platform/strerror.h>
 #include <string>
 #include <sys/stat.h>
@@ -398,10 +399,12 @@ void MutationLog::readInitialBlock() {
 
     headerBlock.set(buf);
 
-    // Check the version is one we can handle, V1 and V2.
+    // Check the version is one we can handle, V1 to V4.
     switch (headerBlock.version()) {
     case MutationLogVersion::V1:
     case MutationLogVersion::V2:
+    case MutationLogVersion::V3:
+    case MutationLogVersion::V4:
         break;
     default: {
         std::stringstream ss;
@@ -454,20 +457,26 @@ bool MutationLog::prepareWrites() {
         if (seek_result < 0) {
             return false;
         }
-        int64_t unaligned_bytes = seek_result % blockSize;
-        if (unaligned_bytes != 0) {
-            LOG(EXTENSION_LOG_WARNING,
-                "WARNING: filesize %" PRId64 " not block aligned '%s': %s",
-                seek_result, getLogFile().c_str(), strerror(errno));
-            if (blockSize < (size_t)seek_result) {
-                if (SeekFile(file, getLogFile(),
-                    seek_result - unaligned_bytes, false) < 0) {
-                    LOG(EXTENSION_LOG_WARNING, "FATAL: lseek failed '%s': %s",
+        // V4 blocks are variable length on disk so there is no alignment
+        // to validate or restore; appends simply continue from the end of
+        // the file.
+        if (headerBlock.version() < MutationLogVersion::V4) {
+            int64_t unaligned_bytes = seek_result % blockSize;
+            if (unaligned_bytes != 0) {
+                LOG(EXTENSION_LOG_WARNING,
+                    "WARNING: filesize %" PRId64 " not block aligned '%s': %s",
+                    seek_result, getLogFile().c_str(), strerror(errno));
+                if (blockSize < (size_t)seek_result) {
+                    if (SeekFile(file, getLogFile(),
+                        seek_result - unaligned_bytes, false) < 0) {
+                        LOG(EXTENSION_LOG_WARNING,
+                            "FATAL: lseek failed '%s': %s",
                             getLogFile().c_str(), strerror(errno));
-                    return false;
+                        return false;
+                    }
+                } else {
+                    throw ShortReadException();
                 }
-            } else {
-                throw ShortReadException();
             }
         }
         logSize = static_cast<size_t>(seek_result);
@@ -654,6 +663,16 @@ bool MutationLog::replaceWith(MutationLog &mlog) {
     return true;
 }
 
+uint32_t MutationLog::calculateCrc(const uint8_t* data, size_t len) const {
+    // V1/V2 files carry the original software CRC-32; V3 switched to
+    // CRC-32C which can use the CPU's CRC instructions. The two
+    // polynomials produce different values, hence the format bump.
+    if (headerBlock.version() < MutationLogVersion::V3) {
+        return crc32buf(const_cast<uint8_t*>(data), len);
+    }
+    return crc32cbuf(const_cast<uint8_t*>(data), len);
+}
+
 bool MutationLog::flush() {
     if (isEnabled() && blockPos > HEADER_RESERVED) {
         if (!isOpen()) {
@@ -663,21 +682,64 @@ bool MutationLog::flush() {
         needWriteAccess();
         BlockTimer timer(&flushTimeHisto);
 
-        if (blockPos < blockSize) {
-            size_t padding(blockSize - blockPos);
-            memset(blockBuffer.get() + blockPos, 0x00, padding);
-            paddingHisto.add(padding);
-        }
+        const uint8_t* writeBuf = blockBuffer.get();
+        size_t writeLen = blockSize;
+        std::vector<uint8_t> compressed;
 
         entries = htons(entries);
-        memcpy(blockBuffer.get() + 2, &entries, sizeof(entries));
 
-        uint32_t crc32(crc32buf(blockBuffer.get() + 2, blockSize - 2));
-        uint16_t crc16(htons(crc32 & 0xffff));
-        memcpy(blockBuffer.get(), &crc16, sizeof(crc16));
+        if (headerBlock.version() >= MutationLogVersion::V4) {
+            // V4 writes variable length blocks; the accumulated entries
+            // are snappy-compressed and framed by a small header (see
+            // V4_BLOCK_HEADER). No zero padding is written.
+            cb::compression::Buffer deflated;
+            if (!cb::compression::deflate(
+                        cb::compression::Algorithm::Snappy,
+                        reinterpret_cast<const char*>(blockBuffer.get() +
+                                                      HEADER_RESERVED),
+                        blockPos - HEADER_RESERVED,
+                        deflated)) {
+                disabled = true;
+                LOG(EXTENSION_LOG_WARNING,
+                    "Disabling access log due to compression failure");
+                return false;
+            }
+            compressed.resize(V4_BLOCK_HEADER + deflated.len);
+            memcpy(compressed.data() + sizeof(uint16_t),
+                   &entries,
+                   sizeof(entries));
+            uint32_t payloadLen(htonl(uint32_t(deflated.len)));
+            memcpy(compressed.data() + 2 * sizeof(uint16_t),
+                   &payloadLen,
+                   sizeof(payloadLen));
+            memcpy(compressed.data() + V4_BLOCK_HEADER,
+                   deflated.data.get(),
+                   deflated.len);
+
+            // The checksum covers everything after the crc field itself.
+            uint32_t crc32(calculateCrc(compressed.data() + sizeof(uint16_t),
+                                        compressed.size() - sizeof(uint16_t)));
+            uint16_t crc16(htons(crc32 & 0xffff));
+            memcpy(compressed.data(), &crc16, sizeof(crc16));
+
+            writeBuf = compressed.data();
+            writeLen = compressed.size();
+        } else {
+            if (blockPos < blockSize) {
+                size_t padding(blockSize - blockPos);
+                memset(blockBuffer.get() + blockPos, 0x00, padding);
+                paddingHisto.add(padding);
+            }
+
+            memcpy(blockBuffer.get() + 2, &entries, sizeof(entries));
+
+            uint32_t crc32(calculateCrc(blockBuffer.get() + 2, blockSize - 2));
+            uint16_t crc16(htons(crc32 & 0xffff));
+            memcpy(blockBuffer.get(), &crc16, sizeof(crc16));
+        }
 
-        if (writeFully(file, blockBuffer.get(), blockSize)) {
-            logSize.fetch_add(blockSize);
+        if (writeFully(file, writeBuf, writeLen)) {
+            logSize.fetch_add(writeLen);
             blockPos = HEADER_RESERVED;
             entries = 0;
         } else {
@@ -772,7 +834,11 @@ void MutationLog::iterator::prepItem() {
                 MutationLogEntryV1::newEntry(p, bufferBytesRemaining())->len();
         break;
     }
-    case MutationLogVersion::V2: {
+    // V3 changed only the block checksum and V4 only the block framing;
+    // entries still use the V2 layout.
+    case MutationLogVersion::V2:
+    case MutationLogVersion::V3:
+    case MutationLogVersion::V4: {
         copyLen =
                 MutationLogEntryV2::newEntry(p, bufferBytesRemaining())->len();
         break;
@@ -788,7 +854,9 @@ size_t MutationLog::iterator::getCurrentEntryLen() const {
         return MutationLogEntryV1::newEntry(entryBuf.begin(), entryBuf.size())
                 ->len();
     }
-    case MutationLogVersion::V2: {
+    case MutationLogVersion::V2:
+    case MutationLogVersion::V3:
+    case MutationLogVersion::V4: {
         return MutationLogEntryV2::newEntry(entryBuf.begin(), entryBuf.size())
                 ->len();
     }
@@ -831,22 +899,22 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
     // The addition of more source versions would mean adding more const
     // pointers here.
     const MutationLogEntryV1* mleV1 = nullptr;
+    const MutationLogEntryV2* mleV2 = nullptr;
     std::unique_ptr<uint8_t[]> allocated;
 
-    // With only two versions this code is a little unnecessary but will
-    // cause the addition of V3 to fail compile. The aim is that the addition of
-    // V3 should now be obvious. I.e. we can step V1->V2->V3 or V2->V3
+    // The aim is that the addition of V4 should now be obvious. I.e. we can
+    // step V1->V2->V3->V4 or V3->V4
     switch (log->headerBlock.version()) {
     case MutationLogVersion::V1: {
         mleV1 = MutationLogEntryV1::newEntry(entryBuf.begin(), entryBuf.size());
         break;
     }
-    /* If V3 exists then add a case for V2, for example:
-    case MutationLogVersion::V2: {
+    // V3 kept the V2 entry layout; only the block checksum changed.
+    case MutationLogVersion::V2:
+    case MutationLogVersion::V3: {
         mleV2 = MutationLogEntryV2::newEntry(entryBuf.begin(), entryBuf.size());
         break;
     }
-    */
     case MutationLogVersion::Current: {
         throw std::invalid_argument(
                 "MutationLog::iterator::upgradeEntry cannot"
@@ -869,25 +937,30 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
         allocated = std::make_unique<uint8_t[]>(
                 MutationLogEntryV2::len(mleV1->getKeylen()));
 
-        // Now in-place construct into the buffer
-        (void) new (allocated.get()) MutationLogEntryV2(*mleV1);
-        // If adding more cases, we should assign the above "new" pointer to a
-        // mleV2 and allow the next case to read it.
+        // Now in-place construct into the buffer and assign to mleV2 so the
+        // next case can read it.
+        mleV2 = new (allocated.get()) MutationLogEntryV2(*mleV1);
 
         // fall through
     }
-    /* If V3 exists then add a case (which is hit by V2 falling through)
     case MutationLogVersion::V3: {
-        // Upgrade V2 to V3
-        // Alloc a buffer using the length read from V2 as input to V3::len
-        allocated = std::make_unique<uint8_t[]>(
-                MutationLogEntryV3::len(mleV2->getKeylen()));
-
-        // Now in-place construct into the new buffer and assign to mleV3
-        mleV3 = new (allocated.get()) MutationLogEntryV3(*mleV3);
+        // V3 uses the V2 entry layout (only the block checksum changed), so
+        // upgrading from V2 is a plain copy; a V1 source was already
+        // rewritten as V2 by the case above.
+        if (!allocated) {
+            allocated = std::make_unique<uint8_t[]>(mleV2->len());
+            memcpy(allocated.get(), mleV2, mleV2->len());
+        }
         // fall through
     }
-    */
+    case MutationLogVersion::V4: {
+        // V4 compresses whole blocks; the entry layout is still V2, so a
+        // V3 source needs only the same plain copy.
+        if (!allocated) {
+            allocated = std::make_unique<uint8_t[]>(mleV2->len());
+            memcpy(allocated.get(), mleV2, mleV2->len());
+        }
+    }
     }
 
     // transfer ownership to the MutationLogEntryHolder and mark that it's
@@ -914,6 +987,81 @@ void MutationLog::iterator::nextBlock() {
                 "log is enabled and not open");
     }
 
+    if (log->headerBlock.version() >= MutationLogVersion::V4) {
+        std::array<uint8_t, V4_BLOCK_HEADER> header;
+        ssize_t bytesread =
+                pread(log->fd(), header.data(), header.size(), offset);
+        if (bytesread < 1) {
+            isEnd = true;
+            return;
+        }
+        if (bytesread != (ssize_t)header.size()) {
+            LOG(EXTENSION_LOG_WARNING, "FATAL: too few bytes read in access "
+                    "log'%s': %s", log->getLogFile().c_str(), strerror(errno));
+            throw ShortReadException();
+        }
+
+        uint32_t payloadLen;
+        memcpy(&payloadLen,
+               header.data() + 2 * sizeof(uint16_t),
+               sizeof(payloadLen));
+        payloadLen = ntohl(payloadLen);
+        // An impossible payload length means we are reading garbage (e.g.
+        // a torn final block); treat it like a checksum failure.
+        if (payloadLen == 0 || payloadLen > ML_BUFLEN) {
+            throw CRCReadException();
+        }
+
+        std::vector<uint8_t> block(header.size() + payloadLen);
+        std::copy(header.begin(), header.end(), block.begin());
+        bytesread = pread(log->fd(),
+                          block.data() + header.size(),
+                          payloadLen,
+                          offset + header.size());
+        if (bytesread != (ssize_t)payloadLen) {
+            LOG(EXTENSION_LOG_WARNING, "FATAL: too few bytes read in access "
+                    "log'%s': %s", log->getLogFile().c_str(), strerror(errno));
+            throw ShortReadException();
+        }
+
+        // The checksum covers everything after the crc field itself.
+        uint32_t crc32(log->calculateCrc(block.data() + sizeof(uint16_t),
+                                         block.size() - sizeof(uint16_t)));
+        uint16_t computed_crc16(crc32 & 0xffff);
+        uint16_t retrieved_crc16;
+        memcpy(&retrieved_crc16, block.data(), sizeof(retrieved_crc16));
+        retrieved_crc16 = ntohs(retrieved_crc16);
+        if (computed_crc16 != retrieved_crc16) {
+            throw CRCReadException();
+        }
+
+        cb::compression::Buffer inflated;
+        if (!cb::compression::inflate(
+                    cb::compression::Algorithm::Snappy,
+                    reinterpret_cast<const char*>(block.data() +
+                                                  header.size()),
+                    payloadLen,
+                    inflated)) {
+            throw ReadException("Failed to inflate access log block");
+        }
+
+        offset += block.size();
+
+        std::copy_n(block.data() + sizeof(uint16_t),
+                    sizeof(uint16_t),
+                    reinterpret_cast<uint8_t*>(&items));
+        items = ntohs(items);
+
+        // Present the block to the entry parsing code in the same shape as
+        // the fixed-size formats use: 4 header bytes then the entries.
+        buf.resize(HEADER_RESERVED + inflated.len);
+        memcpy(buf.data() + HEADER_RESERVED, inflated.data.get(), inflated.len);
+        p = buf.begin() + HEADER_RESERVED;
+
+        prepItem();
+        return;
+    }
+
     ssize_t bytesread = pread(log->fd(), buf.data(), buf.size(), offset);
     if (bytesread < 1) {
         isEnd = true;
@@ -927,7 +1075,8 @@ void MutationLog::iterator::nextBlock() {
     offset += bytesread;
 
     // block starts with 2 byte crc and 2 byte item count
-    uint32_t crc32(crc32buf(buf.data() + sizeof(uint16_t), buf.size() - sizeof(uint16_t)));
+    uint32_t crc32(log->calculateCrc(buf.data() + sizeof(uint16_t),
+                                     buf.size() - sizeof(uint16_t)));
     uint16_t computed_crc16(crc32 & 0xffff);
     uint16_t retrieved_crc16;
     memcpy(&retrieved_crc16, buf.data(), sizeof(retrieved_crc16));
@@ -73,7 +73,21 @@ const int MUTATION_LOG_COMPACTOR_FREQ(3600);
 const size_t MIN_LOG_HEADER_SIZE(4096);
 const size_t HEADER_RESERVED(4);
 
-enum class MutationLogVersion { V1 = 1, V2 = 2, Current = V2 };
+/**
+ * On-disk header of a V4 block: 16 bit (truncated) CRC-32C, 16 bit entry
+ * count and 32 bit compressed payload length. V4 blocks are variable
+ * length on disk; earlier versions wrote fixed blockSize-sized blocks.
+ */
+const size_t V4_BLOCK_HEADER(2 * sizeof(uint16_t) + sizeof(uint32_t));
+
+/*
+ * V1 - initial format.
+ * V2 - entries gained a document namespace; the unused rowid was removed.
+ * V3 - block checksum changed from CRC-32 to CRC-32C.
+ * V4 - blocks are snappy-compressed and variable length on disk; the
+ *      entry layout is unchanged from V2.
+ */
+enum class MutationLogVersion { V1 = 1, V2 = 2, V3 = 3, V4 = 4, Current = V4 };
 
 const size_t LOG_ENTRY_BUF_SIZE(512);
 
@@ -458,6 +472,14 @@ private:
 
     bool prepareWrites();
 
+    /**
+     * Compute the block checksum appropriate to the version of the open
+     * file. V3 onwards uses hardware accelerated CRC-32C; earlier
+     * versions keep the original software CRC-32 so down-level files
+     * remain readable.
+     */
+    uint32_t calculateCrc(const uint8_t* data, size_t len) const;
+
     file_handle_t fd() const { return file; }
 
     LogHeaderBlock     headerBlock;
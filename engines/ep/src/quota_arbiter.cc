@@ -0,0 +1,181 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "quota_arbiter.h"
+
+#include "ep_engine.h"
+
+#include <phosphor/phosphor.h>
+
+#include <algorithm>
+
+/// Fraction of its quota a bucket must be using, while ejecting values,
+/// to be classed as under pressure.
+static const double pressureUsageRatio = 0.90;
+
+/// Fraction of its quota a bucket must be below, with no ejections, to be
+/// classed as idle (a potential donor).
+static const double idleUsageRatio = 0.70;
+
+/// Largest slice of the donor's current quota moved in one pass.
+static const double maxStepRatio = 0.05;
+
+/// Number of consecutive passes a classification must hold before any
+/// quota moves (hysteresis against transient load spikes).
+static const int minStreak = 2;
+
+QuotaArbiter& QuotaArbiter::instance() {
+    static QuotaArbiter arbiter;
+    return arbiter;
+}
+
+void QuotaArbiter::registerEngine(EventuallyPersistentEngine& engine) {
+    std::lock_guard<std::mutex> lh(mutex);
+    Member member;
+    member.engine = &engine;
+    member.baseQuota = engine.getEpStats().getMaxDataSize();
+    member.lastEjects = engine.getEpStats().numValueEjects;
+    members.push_back(member);
+}
+
+void QuotaArbiter::unregisterEngine(EventuallyPersistentEngine& engine) {
+    std::lock_guard<std::mutex> lh(mutex);
+    members.erase(std::remove_if(members.begin(),
+                                 members.end(),
+                                 [&engine](const Member& m) {
+                                     return m.engine == &engine;
+                                 }),
+                  members.end());
+}
+
+void QuotaArbiter::runArbitration(std::chrono::seconds interval) {
+    std::lock_guard<std::mutex> lh(mutex);
+
+    const auto now = ProcessClock::now();
+    if (now - lastRun < interval) {
+        // Another member's task already ran a pass recently.
+        return;
+    }
+    lastRun = now;
+
+    if (members.size() < 2) {
+        return;
+    }
+
+    // Classify every member from its EPStats signals.
+    Member* recipient = nullptr;
+    Member* donor = nullptr;
+    uint64_t worstEjects = 0;
+    size_t bestHeadroom = 0;
+
+    for (auto& m : members) {
+        EPStats& stats = m.engine->getEpStats();
+        const size_t quota = stats.getMaxDataSize();
+        const size_t used = stats.getTotalMemoryUsed();
+        const uint64_t ejects = stats.numValueEjects;
+        const uint64_t ejectDelta = ejects - m.lastEjects;
+        m.lastEjects = ejects;
+
+        if (ejectDelta > 0 && used > size_t(quota * pressureUsageRatio)) {
+            m.pressureStreak++;
+            m.idleStreak = 0;
+        } else if (ejectDelta == 0 &&
+                   used < size_t(quota * idleUsageRatio)) {
+            m.idleStreak++;
+            m.pressureStreak = 0;
+        } else {
+            m.pressureStreak = 0;
+            m.idleStreak = 0;
+        }
+
+        if (m.pressureStreak >= minStreak && ejectDelta > worstEjects) {
+            worstEjects = ejectDelta;
+            recipient = &m;
+        }
+        if (m.idleStreak >= minStreak && quota - used > bestHeadroom) {
+            bestHeadroom = quota - used;
+            donor = &m;
+        }
+    }
+
+    if (recipient == nullptr || donor == nullptr) {
+        return;
+    }
+
+    const size_t donorQuota = donor->engine->getEpStats().getMaxDataSize();
+    const size_t donorUsed = donor->engine->getEpStats().getTotalMemoryUsed();
+    const size_t recipientQuota =
+            recipient->engine->getEpStats().getMaxDataSize();
+
+    // A donor is never pushed below half its configured quota or so close
+    // to its own usage that it becomes the next bucket under pressure.
+    const size_t donorFloor = std::max(size_t(donorUsed * 1.25),
+                                       donor->baseQuota / 2);
+    // A recipient never holds more than twice its configured quota.
+    const size_t recipientCeil = recipient->baseQuota * 2;
+
+    size_t step = size_t(donorQuota * maxStepRatio);
+    if (donorQuota > donorFloor) {
+        step = std::min(step, donorQuota - donorFloor);
+    } else {
+        step = 0;
+    }
+    if (recipientCeil > recipientQuota) {
+        step = std::min(step, recipientCeil - recipientQuota);
+    } else {
+        step = 0;
+    }
+
+    // Dead band: don't bother with moves too small to change behaviour.
+    if (step < donorQuota / 100) {
+        return;
+    }
+
+    // Apply through the ordinary dynamic max_size path so watermarks,
+    // pagers and backfill limits all follow.
+    donor->engine->getConfiguration().setMaxSize(donorQuota - step);
+    recipient->engine->getConfiguration().setMaxSize(recipientQuota + step);
+
+    // Start both streaks from scratch so the same pair can't ping-pong
+    // quota back and forth on consecutive passes.
+    donor->idleStreak = 0;
+    recipient->pressureStreak = 0;
+
+    LOG(EXTENSION_LOG_NOTICE,
+        "Quota arbiter moved %" PRIu64 " bytes of quota from bucket '%s' "
+        "(now %" PRIu64 ") to bucket '%s' (now %" PRIu64 ")",
+        uint64_t(step),
+        donor->engine->getName().c_str(),
+        uint64_t(donorQuota - step),
+        recipient->engine->getName().c_str(),
+        uint64_t(recipientQuota + step));
+}
+
+QuotaArbiterTask::QuotaArbiterTask(EventuallyPersistentEngine* e)
+    : GlobalTask(e, TaskId::QuotaArbiterTask, 0, false) {
+}
+
+bool QuotaArbiterTask::run(void) {
+    TRACE_EVENT0("ep-engine/task", "QuotaArbiterTask");
+    QuotaArbiter::instance().runArbitration(
+            std::chrono::seconds(getSleepTime()));
+    snooze(getSleepTime());
+    return !engine->getEpStats().isShutdown;
+}
+
+size_t QuotaArbiterTask::getSleepTime() const {
+    return engine->getConfiguration().getQuotaArbiterInterval();
+}
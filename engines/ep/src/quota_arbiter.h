@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include "globaltask.h"
+
+#include <platform/processclock.h>
+
+#include <mutex>
+#include <vector>
+
+class EventuallyPersistentEngine;
+
+/**
+ * The quota arbiter shifts memory quota between the buckets on this node
+ * which have opted in (quota_sharing=true).
+ *
+ * Each enrolled bucket contributes its configured max_size to a shared
+ * envelope. An arbitration pass classifies every bucket from signals
+ * already maintained in EPStats: a bucket is under pressure if it has
+ * ejected values since the last pass while running close to its quota, and
+ * it is idle if it has plenty of unused quota and ejected nothing. When
+ * the same classification holds for two consecutive passes (hysteresis
+ * against transient spikes), a bounded slice of quota is moved from the
+ * most idle bucket to the most pressured one through the ordinary dynamic
+ * max_size configuration path, so the watermarks, pagers and backfill
+ * limits all adjust exactly as if ns_server had resized the bucket.
+ *
+ * Moves are zero-sum, so the envelope never grows; a donor is never pushed
+ * below half its configured quota (or into immediate pressure), and a
+ * recipient never holds more than twice its configured quota.
+ */
+class QuotaArbiter {
+public:
+    static QuotaArbiter& instance();
+
+    /**
+     * Enroll a bucket. Its currently configured max_size becomes its
+     * contribution to the shared envelope.
+     */
+    void registerEngine(EventuallyPersistentEngine& engine);
+
+    /**
+     * Withdraw a bucket (at shutdown). The quota it currently holds leaves
+     * with it; remaining members keep whatever they hold, and future moves
+     * remain zero-sum.
+     */
+    void unregisterEngine(EventuallyPersistentEngine& engine);
+
+    /**
+     * Run one arbitration pass. Rate-limited internally to the given
+     * interval, so every member's task may call this on its own schedule
+     * and only one of them does the work.
+     */
+    void runArbitration(std::chrono::seconds interval);
+
+private:
+    struct Member {
+        EventuallyPersistentEngine* engine;
+
+        /// Configured max_size at registration; the bucket's contribution
+        /// to the shared envelope.
+        size_t baseQuota;
+
+        /// Value of numValueEjects at the previous pass.
+        uint64_t lastEjects = 0;
+
+        /// Consecutive passes this bucket was under eviction pressure.
+        int pressureStreak = 0;
+
+        /// Consecutive passes this bucket had idle headroom.
+        int idleStreak = 0;
+    };
+
+    /// All members and lastRun are protected by this mutex.
+    std::mutex mutex;
+    std::vector<Member> members;
+    ProcessClock::time_point lastRun;
+};
+
+/**
+ * Per-bucket task which periodically pokes the process-wide quota arbiter.
+ * Every opted-in bucket schedules one; the arbiter itself makes sure only
+ * one pass runs per interval.
+ */
+class QuotaArbiterTask : public GlobalTask {
+public:
+    QuotaArbiterTask(EventuallyPersistentEngine* e);
+
+    bool run(void);
+
+    cb::const_char_buffer getDescription() {
+        return "Bucket quota arbiter";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // A pass reads a handful of counters per bucket and possibly
+        // updates two configuration values; it should be quick.
+        return std::chrono::milliseconds(10);
+    }
+
+private:
+    /// Seconds between arbitration passes.
+    size_t getSleepTime() const;
+};
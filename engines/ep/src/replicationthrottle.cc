@@ -17,13 +17,25 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "configuration.h"
+#include "ep_time.h"
 #include "replicationthrottle.h"
 
+constexpr double ReplicationThrottle::softStartRatio;
+const size_t ReplicationThrottle::minApplyRatio;
+const size_t ReplicationThrottle::applyRatioStep;
+
 ReplicationThrottle::ReplicationThrottle(const Configuration& config,
                                          EPStats& s)
     : queueCap(config.getReplicationThrottleQueueCap()),
       capPercent(config.getReplicationThrottleCapPcnt()),
+      applyRatio(100),
+      lastAdjustTime(0),
+      lastDiskQueueSize(0),
+      gateTick(0),
+      numThrottled(0),
       stats(s) {
 }
 
@@ -42,9 +54,78 @@ bool ReplicationThrottle::hasSomeMemory() const {
     return memoryUsed <= (maxSize * stats.replicationThrottleThreshold);
 }
 
+void ReplicationThrottle::maybeAdjustApplyRatio() const {
+    // The tests construct the throttle without the server API; there
+    // every call may adjust, in production we adjust once per second.
+    const rel_time_t now = ep_time_functions_initialized()
+                                   ? ep_current_time()
+                                   : lastAdjustTime.load() + 1;
+    if (now == lastAdjustTime.load()) {
+        return;
+    }
+    lastAdjustTime.store(now);
+
+    const double memoryUsed = static_cast<double>(stats.getTotalMemoryUsed());
+    const double gate = static_cast<double>(stats.getMaxDataSize()) *
+                        stats.replicationThrottleThreshold;
+    const double pressure = gate > 0 ? memoryUsed / gate : 0;
+
+    // Linear ramp of the target ratio from 100% at the soft-start point
+    // down to the floor at the hard memory gate.
+    size_t target;
+    if (pressure <= softStartRatio) {
+        target = 100;
+    } else if (pressure >= 1.0) {
+        target = minApplyRatio;
+    } else {
+        target = 100 -
+                 static_cast<size_t>((100 - minApplyRatio) *
+                                     (pressure - softStartRatio) /
+                                     (1.0 - softStartRatio));
+    }
+
+    // Bias by the flusher drain trend: while shaping, widen the gate if
+    // the write queue is draining and narrow it if it is still growing.
+    const size_t queueSize = stats.diskQueueSize.load();
+    const size_t prevQueueSize = lastDiskQueueSize.load();
+    lastDiskQueueSize.store(queueSize);
+    if (target < 100) {
+        if (queueSize < prevQueueSize) {
+            target = std::min(target + applyRatioStep, size_t(100));
+        } else if (queueSize > prevQueueSize &&
+                   target > minApplyRatio + applyRatioStep) {
+            target -= applyRatioStep;
+        }
+    }
+
+    // Move towards the target one step at a time so the rate changes
+    // smoothly in both directions.
+    const size_t current = applyRatio.load();
+    if (target > current) {
+        applyRatio.store(std::min(current + applyRatioStep, target));
+    } else if (target < current) {
+        applyRatio.store(
+                std::max(current - std::min(applyRatioStep, current), target));
+    }
+}
+
 ReplicationThrottle::Status ReplicationThrottle::getStatus() const {
-    return (persistenceQueueSmallEnough() && hasSomeMemory()) ? Status::Process
-                                                              : Status::Pause;
+    maybeAdjustApplyRatio();
+
+    if (!(persistenceQueueSmallEnough() && hasSomeMemory())) {
+        ++numThrottled;
+        return Status::Pause;
+    }
+
+    // Duty-cycle gate: below the hard gates, process applyRatio% of the
+    // calls and pause the remainder.
+    const size_t ratio = applyRatio.load();
+    if (ratio < 100 && (gateTick++ % 100) >= ratio) {
+        ++numThrottled;
+        return Status::Pause;
+    }
+
+    return Status::Process;
 }
 
 void ReplicationThrottle::adjustWriteQueueCap(size_t totalItems) {
@@ -68,7 +149,9 @@ ReplicationThrottleEphe::ReplicationThrottleEphe(const Configuration& config,
 
 ReplicationThrottle::Status ReplicationThrottleEphe::getStatus() const {
     ReplicationThrottle::Status status = ReplicationThrottle::getStatus();
-    if (status == Status::Pause) {
+    if (status == Status::Pause && !hasSomeMemory()) {
+        // Only a hard out-of-memory pause escalates to a disconnect;
+        // rate-shaping pauses are just a back off.
         if (config.getEphemeralFullPolicy() == "fail_new_data") {
             return Status::Disconnect;
         }
@@ -29,6 +29,15 @@ class Configuration;
 /**
  * Monitors various internal state to report whether we should
  * throttle incoming tap and DCP items.
+ *
+ * In addition to the hard gates (write queue cap and memory threshold),
+ * the throttle shapes the consumer apply rate continuously: as memory
+ * usage climbs towards the threshold an "apply ratio" ramps down, and a
+ * matching share of getStatus() calls report Pause. The ratio moves
+ * gradually (at most one step per second) and is biased by whether the
+ * flusher is draining the write queue, so replication slows smoothly
+ * before the cliff and speeds up as memory recovers rather than
+ * oscillating between full-rate and stopped.
  */
 class ReplicationThrottle {
 public:
@@ -37,6 +46,8 @@ public:
 
     ReplicationThrottle(const Configuration& config, EPStats& s);
 
+    virtual ~ReplicationThrottle() {}
+
     /**
      * @ return status of the replication throttle
      */
@@ -58,12 +69,57 @@ public:
 
     void adjustWriteQueueCap(size_t totalItems);
 
+    /**
+     * @return the current apply ratio as a percentage; the share of
+     *         getStatus() calls which report Process while below the
+     *         hard gates.
+     */
+    size_t getApplyRatio() const {
+        return applyRatio.load();
+    }
+
+    /**
+     * @return how many times getStatus() has reported Pause (for either
+     *         a hard gate or rate shaping).
+     */
+    uint64_t getNumThrottled() const {
+        return numThrottled.load();
+    }
+
+protected:
+    bool hasSomeMemory() const;
+
 private:
     bool persistenceQueueSmallEnough() const;
-    bool hasSomeMemory() const;
+
+    /**
+     * Recompute the apply ratio, at most once per second, from the
+     * current memory pressure and the write queue drain trend.
+     */
+    void maybeAdjustApplyRatio() const;
+
+    //! Fraction of the memory gate at which rate shaping begins.
+    static constexpr double softStartRatio = 0.9;
+    //! Floor for the apply ratio; we never shape below this while the
+    //! hard gates still permit processing.
+    static const size_t minApplyRatio = 10;
+    //! Largest per-second movement of the apply ratio.
+    static const size_t applyRatioStep = 10;
 
     Couchbase::RelaxedAtomic<ssize_t> queueCap;
     Couchbase::RelaxedAtomic<size_t> capPercent;
+
+    //! Percentage (0-100) of getStatus() calls allowed to Process.
+    mutable Couchbase::RelaxedAtomic<size_t> applyRatio;
+    //! Last time (ep_current_time) the apply ratio was adjusted.
+    mutable Couchbase::RelaxedAtomic<rel_time_t> lastAdjustTime;
+    //! diskQueueSize at the last adjustment; used for the drain trend.
+    mutable Couchbase::RelaxedAtomic<size_t> lastDiskQueueSize;
+    //! Monotonic tick used to duty-cycle Pause decisions.
+    mutable Couchbase::RelaxedAtomic<uint64_t> gateTick;
+    //! Count of Pause decisions handed out.
+    mutable Couchbase::RelaxedAtomic<uint64_t> numThrottled;
+
     EPStats &stats;
 };
 
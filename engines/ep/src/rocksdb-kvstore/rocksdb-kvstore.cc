@@ -24,6 +24,7 @@
 #include "kvstore_config.h"
 #include "kvstore_priv.h"
 
+#include <rocksdb/cache.h>
 #include <rocksdb/convenience.h>
 
 #include <stdio.h>
@@ -223,6 +224,16 @@ RocksDBKVStore::RocksDBKVStore(KVStoreConfig& config)
                             "GetBlockBasedTableOptionsFromString error: ") +
                 status.getState());
     }
+    // Share one block cache between all the vbucket DBs of this shard, so
+    // that the configured budget holds for the bucket regardless of the
+    // number of vbuckets. Without this every DB creates its own small
+    // private cache, which collectively ignores the bucket quota.
+    if (configuration.getRocksdbBlockCacheSize() > 0) {
+        table_options.block_cache = rocksdb::NewLRUCache(
+                configuration.getRocksdbBlockCacheSize() /
+                configuration.getMaxShards());
+    }
+
     rdbOptions.table_factory.reset(
             rocksdb::NewBlockBasedTableFactory(table_options));
 
@@ -524,7 +535,31 @@ void RocksDBKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t& itms) {
 }
 
 void RocksDBKVStore::reset(uint16_t vbucketId) {
-    // TODO RDB:  Implement.
+    vbucket_state* state = getVBucketState(vbucketId);
+    if (!state) {
+        throw std::invalid_argument(
+                "RocksDBKVStore::reset: No entry in cached states for vbucket " +
+                std::to_string(vbucketId));
+    }
+    state->reset();
+
+    // Destroying the DB is the only way RocksDB reclaims the space. As
+    // with CouchKVStore::reset, the expectation is that a higher level
+    // per-VB lock (KVBucket::vb_mutexes) prevents data races here.
+    {
+        std::lock_guard<std::mutex> lg(writeLock);
+        vbDB[vbucketId].reset();
+        auto dbname = getVBDBSubdir(vbucketId);
+        auto status = rocksdb::DestroyDB(dbname, rdbOptions);
+        if (!status.ok()) {
+            throw std::runtime_error("RocksDBKVStore::reset: DestroyDB '" +
+                                     dbname +
+                                     "' failed: " + status.getState());
+        }
+    }
+
+    snapshotVBucket(
+            vbucketId, *state, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT);
 }
 
 void RocksDBKVStore::del(const Item& item, Callback<int>& cb) {
@@ -962,13 +997,125 @@ std::string RocksDBKVStore::getVbstateKey() {
     return "vbstate";
 }
 
+size_t RocksDBKVStore::getItemCount(uint16_t vbid) {
+    auto& db = openDB(vbid);
+    uint64_t count = 0;
+    // The number of keys in the default Column Family. This is an
+    // estimate (RocksDB cannot count exactly without a full scan) and it
+    // includes our metadata-only deletes.
+    db.rdb->GetIntProperty(rocksdb::DB::Properties::kEstimateNumKeys, &count);
+    return count;
+}
+
+DBFileInfo RocksDBKVStore::getDBFileInfo(const KVRocksDB& db) {
+    DBFileInfo info;
+    uint64_t fileSize = 0;
+    uint64_t liveData = 0;
+    db.rdb->GetAggregatedIntProperty(
+            rocksdb::DB::Properties::kTotalSstFilesSize, &fileSize);
+    db.rdb->GetAggregatedIntProperty(
+            rocksdb::DB::Properties::kEstimateLiveDataSize, &liveData);
+    info.fileSize = fileSize;
+    info.spaceUsed = liveData;
+    return info;
+}
+
+DBFileInfo RocksDBKVStore::getDbFileInfo(uint16_t vbid) {
+    return getDBFileInfo(openDB(vbid));
+}
+
+DBFileInfo RocksDBKVStore::getAggrDbFileInfo() {
+    DBFileInfo aggrInfo;
+    // Only sum over the DBs already open; opening closed ones here would
+    // be both expensive and pointless (they have no vbucket on this
+    // shard). Hold `openDBMutex` so `openDB` cannot mutate `vbDB` under
+    // us.
+    std::lock_guard<std::mutex> lg(openDBMutex);
+    for (const auto& db : vbDB) {
+        if (db) {
+            auto info = getDBFileInfo(*db);
+            aggrInfo.fileSize += info.fileSize;
+            aggrInfo.spaceUsed += info.spaceUsed;
+        }
+    }
+    return aggrInfo;
+}
+
+RollbackResult RocksDBKVStore::rollback(uint16_t vbid,
+                                        uint64_t rollbackSeqno,
+                                        std::shared_ptr<RollbackCB> cb) {
+    // RocksDB keeps no usable history: compaction discards overwritten
+    // versions, so unlike couchstore (which rewinds to an old header) the
+    // store cannot be wound back to an arbitrary seqno. If the requested
+    // point is at or beyond everything persisted there is nothing to
+    // undo; any other request reports failure, upon which the caller
+    // discards the vbucket and resyncs it in full from the active.
+    auto* vbstate = cachedVBStates[vbid].get();
+    if (vbstate &&
+        rollbackSeqno >= static_cast<uint64_t>(vbstate->highSeqno)) {
+        return RollbackResult(true,
+                              vbstate->highSeqno,
+                              vbstate->lastSnapStart,
+                              vbstate->lastSnapEnd);
+    }
+    return RollbackResult(false, 0, 0, 0);
+}
+
+ENGINE_ERROR_CODE RocksDBKVStore::getAllKeys(
+        uint16_t vbid,
+        const DocKey start_key,
+        const DocKey end_key,
+        uint32_t count,
+        std::shared_ptr<Callback<const DocKey&>> cb) {
+    auto& db = openDB(vbid);
+    std::unique_ptr<rocksdb::Iterator> it(
+            db.rdb->NewIterator(rocksdb::ReadOptions()));
+    const rocksdb::Slice endSlice = getKeySlice(end_key);
+    uint32_t found = 0;
+    for (it->Seek(getKeySlice(start_key)); it->Valid() && found < count;
+         it->Next()) {
+        // Stop at the first key past the (inclusive) end of the range;
+        // RocksDB's iterate_upper_bound is exclusive so cannot express
+        // this bound directly.
+        if (end_key.size() > 0 && it->key().compare(endSlice) > 0) {
+            break;
+        }
+        // Skip deleted documents; they are stored as metadata-only
+        // values, not as RocksDB tombstones, so the iterator returns
+        // them.
+        if (it->value().size() >= sizeof(rockskv::MetaData)) {
+            rockskv::MetaData meta;
+            std::memcpy(&meta, it->value().data(), sizeof(meta));
+            if (meta.deleted) {
+                continue;
+            }
+        }
+        // TODO RDB: Deal with collections
+        DocKey key(reinterpret_cast<const uint8_t*>(it->key().data()),
+                   it->key().size(),
+                   DocNamespace::DefaultCollection);
+        cb->callback(key);
+        ++found;
+    }
+    if (!it->status().ok()) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "RocksDBKVStore::getAllKeys: iterator error, vb:%" PRIu16,
+                   vbid);
+        return ENGINE_FAILED;
+    }
+    return ENGINE_SUCCESS;
+}
+
 ScanContext* RocksDBKVStore::initScanContext(
         std::shared_ptr<Callback<GetValue> > cb,
         std::shared_ptr<Callback<CacheLookup> > cl,
         uint16_t vbid,
         uint64_t startSeqno,
         DocumentFilter options,
-        ValueFilter valOptions) {
+        ValueFilter valOptions,
+        ScanOrder scanOrder) {
+    // RocksDB's by-seqno column family is the only scan index; a BY_ID
+    // request falls back to sequence order (the order is advisory only).
     size_t scanId = scanCounter++;
     auto& db = openDB(vbid);
     scanSnapshots.emplace(scanId, SnapshotPtr(db.rdb->GetSnapshot(), *db.rdb));
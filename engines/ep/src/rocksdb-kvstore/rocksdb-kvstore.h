@@ -202,36 +202,22 @@ public:
     }
 
     size_t getNumPersistedDeletes(uint16_t vbid) override {
-        // TODO vmx 2016-10-29: implement
+        // Deletions are stored as metadata-only documents (not RocksDB
+        // tombstones), so there is no DB property which can count them
+        // without a full scan. Return 0; this only makes the compactor
+        // less eager, it does not affect correctness.
         return 0;
     }
 
-    DBFileInfo getDbFileInfo(uint16_t vbid) override {
-        // TODO vmx 2016-10-29: implement
-        DBFileInfo vbinfo;
-        return vbinfo;
-    }
+    DBFileInfo getDbFileInfo(uint16_t vbid) override;
 
-    DBFileInfo getAggrDbFileInfo() override {
-        // TODO vmx 2016-10-29: implement
-        DBFileInfo vbinfo;
-        return vbinfo;
-    }
+    DBFileInfo getAggrDbFileInfo() override;
 
-    size_t getItemCount(uint16_t vbid) override {
-        // TODO vmx 2016-10-29: implement
-        return 0;
-    }
+    size_t getItemCount(uint16_t vbid) override;
 
     RollbackResult rollback(uint16_t vbid,
                             uint64_t rollbackSeqno,
-                            std::shared_ptr<RollbackCB> cb) override {
-        // TODO vmx 2016-10-29: implement
-        // NOTE vmx 2016-10-29: For LevelDB/RocksDB it will probably
-        // always be a full rollback as it doesn't support Couchstore
-        // like rollback semantics
-        return RollbackResult(false, 0, 0, 0);
-    }
+                            std::shared_ptr<RollbackCB> cb) override;
 
     void pendingTasks() override {
         // NOTE vmx 2016-10-29: Intentionally left empty;
@@ -240,18 +226,18 @@ public:
     ENGINE_ERROR_CODE getAllKeys(
             uint16_t vbid,
             const DocKey start_key,
+            const DocKey end_key,
             uint32_t count,
-            std::shared_ptr<Callback<const DocKey&>> cb) override {
-        // TODO vmx 2016-10-29: implement
-        return ENGINE_SUCCESS;
-    }
+            std::shared_ptr<Callback<const DocKey&>> cb) override;
 
-    ScanContext* initScanContext(std::shared_ptr<Callback<GetValue>> cb,
-                                 std::shared_ptr<Callback<CacheLookup>> cl,
-                                 uint16_t vbid,
-                                 uint64_t startSeqno,
-                                 DocumentFilter options,
-                                 ValueFilter valOptions) override;
+    ScanContext* initScanContext(
+            std::shared_ptr<Callback<GetValue>> cb,
+            std::shared_ptr<Callback<CacheLookup>> cl,
+            uint16_t vbid,
+            uint64_t startSeqno,
+            DocumentFilter options,
+            ValueFilter valOptions,
+            ScanOrder scanOrder = ScanOrder::BY_SEQNO) override;
 
     scan_error_t scan(ScanContext* sctx) override;
 
@@ -331,6 +317,12 @@ private:
      */
     std::vector<uint16_t> discoverVBuckets();
 
+    /*
+     * Returns the file size / space used of the given DB, summed across
+     * all its Column Families.
+     */
+    DBFileInfo getDBFileInfo(const KVRocksDB& db);
+
     rocksdb::Slice getKeySlice(const DocKey& key);
     rocksdb::Slice getSeqnoSlice(const int64_t& seqno);
     int64_t getNumericSeqno(const rocksdb::Slice& seqnoSlice);
@@ -334,14 +334,42 @@ public:
      *                    continue or if it should be paused (in case it is
      *                    running for a long time). By default, we assume that
      *                    the tombstone purging need not be paused at all
+     * @param purgeBatchSize Maximum number of elements unlinked from the
+     *                       list per acquisition of the list's write lock;
+     *                       bounds how long a purge can block front-end
+     *                       writes in one go
      *
      * @return The number of items purged from the sequence list (and hence
      *         deleted).
      */
-    virtual size_t purgeTombstones(seqno_t purgeUpToSeqno,
-                                   std::function<bool()> shouldPause = []() {
-                                       return false;
-                                   }) = 0;
+    virtual size_t purgeTombstones(
+            seqno_t purgeUpToSeqno,
+            std::function<bool()> shouldPause = []() { return false; },
+            size_t purgeBatchSize = 128) = 0;
+
+    /**
+     * Pick keys of up to maxItems auto-delete eviction candidates from the
+     * cold end (lowest seqnos) of the list, starting after the given seqno.
+     *
+     * As the list is ordered by mutation, the items with the lowest seqnos
+     * are those which have gone longest without being written - the
+     * "probationary" end of the list. Stale and deleted items are skipped
+     * (they are reclaimed by the tombstone purger, not the pager).
+     *
+     * Keys are returned as copies; the caller must re-validate each
+     * candidate under its HashTable lock before acting on it, as the item
+     * may be concurrently updated or removed once the list's write lock is
+     * released.
+     *
+     * @param maxItems Maximum number of candidate keys to return; bounds
+     *                 how long the list's write lock is held
+     * @param fromSeqno Only consider items with a seqno greater than this
+     *
+     * @return Candidate keys, and the seqno of the last list element
+     *         examined (pass back as fromSeqno to resume the walk)
+     */
+    virtual std::pair<std::vector<StoredDocKey>, seqno_t>
+    pickEvictionCandidates(size_t maxItems, seqno_t fromSeqno) = 0;
 
     /**
      * Updates the number of deleted items in the sequence list whenever
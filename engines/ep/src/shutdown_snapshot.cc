@@ -0,0 +1,283 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "shutdown_snapshot.h"
+
+#include "item.h"
+#include "kv_bucket.h"
+#include "stored-value.h"
+#include "vbucket.h"
+
+#include <platform/make_unique.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+ * On-disk layout (host byte order, single-use, see header):
+ *
+ *   FileHeader
+ *   repeated numVBuckets times:
+ *       SectionHeader
+ *       repeated itemCount times:
+ *           DocRecord + keyLen key bytes
+ */
+
+static const uint32_t SnapshotMagic = 0x45505353; /* 'EPSS' */
+static const uint32_t SnapshotVersion = 1;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numVBuckets;
+    uint32_t unused;
+};
+
+struct SectionHeader {
+    uint64_t highSeqno;
+    uint64_t sectionBytes; //!< bytes of document records following
+    uint32_t itemCount;
+    uint16_t vbid;
+    uint16_t unused;
+};
+
+struct DocRecord {
+    uint64_t cas;
+    uint64_t bySeqno;
+    uint64_t revSeqno;
+    uint32_t flags;
+    uint32_t exptime;
+    uint32_t valueSize;
+    uint16_t keyLen;
+    uint8_t docNamespace;
+    uint8_t datatype;
+};
+
+/**
+ * HashTable visitor which appends a DocRecord (plus key bytes) for every
+ * committed, non-deleted document to the section buffer.
+ */
+class SnapshotVisitor : public HashTableVisitor {
+public:
+    SnapshotVisitor(std::vector<char>& buffer) : buf(buffer), count(0) {
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh,
+               StoredValue& v) override {
+        if (v.isDeleted() || v.isTempItem()) {
+            return true;
+        }
+
+        const auto& key = v.getKey();
+        DocRecord rec;
+        rec.cas = v.getCas();
+        rec.bySeqno = uint64_t(v.getBySeqno());
+        rec.revSeqno = v.getRevSeqno();
+        rec.flags = v.getFlags();
+        rec.exptime = uint32_t(v.getExptime());
+        rec.valueSize = uint32_t(v.valuelen());
+        rec.keyLen = uint16_t(key.size());
+        rec.docNamespace = uint8_t(key.getDocNamespace());
+        rec.datatype = v.getDatatype();
+
+        const char* p = reinterpret_cast<const char*>(&rec);
+        buf.insert(buf.end(), p, p + sizeof(rec));
+        const char* k = reinterpret_cast<const char*>(key.data());
+        buf.insert(buf.end(), k, k + key.size());
+        ++count;
+        return true;
+    }
+
+    uint32_t getCount() const {
+        return count;
+    }
+
+private:
+    std::vector<char>& buf;
+    uint32_t count;
+};
+
+ShutdownSnapshot::ShutdownSnapshot(const std::string& dbname)
+    : path(getPath(dbname)) {
+}
+
+std::string ShutdownSnapshot::getPath(const std::string& dbname) {
+    return dbname + "/shutdown.snapshot";
+}
+
+void ShutdownSnapshot::remove(const std::string& dbname) {
+    std::remove(getPath(dbname).c_str());
+}
+
+void ShutdownSnapshot::write(KVBucket& store) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        LOG(EXTENSION_LOG_WARNING,
+            "ShutdownSnapshot::write: failed to open '%s'", path.c_str());
+        return;
+    }
+
+    FileHeader header;
+    header.magic = SnapshotMagic;
+    header.version = SnapshotVersion;
+    header.numVBuckets = 0;
+    header.unused = 0;
+    // Placeholder; rewritten with the final vbucket count below.
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<char> buffer;
+    for (auto vbid : store.getVBuckets().getBuckets()) {
+        VBucketPtr vb = store.getVBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+
+        /*
+         * Only snapshot a vbucket whose HashTable content has been fully
+         * persisted; otherwise the section would disagree with the file
+         * and warmup would (correctly) reject it anyway.
+         */
+        uint64_t highSeqno = uint64_t(vb->getHighSeqno());
+        if (highSeqno != vb->getPersistenceSeqno()) {
+            continue;
+        }
+
+        buffer.clear();
+        SnapshotVisitor visitor(buffer);
+        vb->ht.visit(visitor);
+
+        SectionHeader section;
+        section.highSeqno = highSeqno;
+        section.sectionBytes = buffer.size();
+        section.itemCount = visitor.getCount();
+        section.vbid = vbid;
+        section.unused = 0;
+        out.write(reinterpret_cast<const char*>(&section), sizeof(section));
+        out.write(buffer.data(), buffer.size());
+        ++header.numVBuckets;
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+
+    if (!out || header.numVBuckets == 0) {
+        std::remove(path.c_str());
+        return;
+    }
+
+    LOG(EXTENSION_LOG_NOTICE,
+        "ShutdownSnapshot::write: wrote state of %" PRIu32
+        " vbuckets to '%s'", header.numVBuckets, path.c_str());
+}
+
+size_t ShutdownSnapshot::open(
+        const std::map<uint16_t, uint64_t>& persistedHighSeqnos) {
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    // Single-use: a crash from here on falls back to full warmup. The open
+    // stream keeps the unlinked file readable.
+    std::remove(path.c_str());
+
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != SnapshotMagic ||
+        header.version != SnapshotVersion) {
+        LOG(EXTENSION_LOG_WARNING,
+            "ShutdownSnapshot::open: '%s' has an invalid header; ignoring",
+            path.c_str());
+        return 0;
+    }
+
+    for (uint32_t ii = 0; ii < header.numVBuckets; ++ii) {
+        SectionHeader section;
+        file.read(reinterpret_cast<char*>(&section), sizeof(section));
+        if (!file) {
+            LOG(EXTENSION_LOG_WARNING,
+                "ShutdownSnapshot::open: '%s' is truncated; ignoring",
+                path.c_str());
+            sections.clear();
+            return 0;
+        }
+
+        auto it = persistedHighSeqnos.find(section.vbid);
+        if (it != persistedHighSeqnos.end() &&
+            it->second == section.highSeqno) {
+            sections[section.vbid] = {file.tellg(), section.itemCount};
+        }
+        file.seekg(section.sectionBytes, std::ios::cur);
+    }
+
+    return sections.size();
+}
+
+bool ShutdownSnapshot::hasVBucket(uint16_t vbid) {
+    std::lock_guard<std::mutex> lh(lock);
+    return sections.find(vbid) != sections.end();
+}
+
+bool ShutdownSnapshot::restoreVBucket(uint16_t vbid, Callback<GetValue>& cb) {
+    std::lock_guard<std::mutex> lh(lock);
+    auto it = sections.find(vbid);
+    if (it == sections.end()) {
+        return false;
+    }
+
+    file.clear();
+    file.seekg(it->second.offset);
+
+    std::vector<uint8_t> keybuf(UINT16_MAX);
+    for (uint32_t ii = 0; ii < it->second.count; ++ii) {
+        DocRecord rec;
+        file.read(reinterpret_cast<char*>(&rec), sizeof(rec));
+        if (!file) {
+            return false;
+        }
+        file.read(reinterpret_cast<char*>(keybuf.data()), rec.keyLen);
+        if (!file) {
+            return false;
+        }
+
+        auto item = std::make_unique<Item>(
+                DocKey(keybuf.data(),
+                       rec.keyLen,
+                       DocNamespace(rec.docNamespace)),
+                rec.flags,
+                time_t(rec.exptime),
+                nullptr,
+                rec.valueSize,
+                rec.datatype,
+                rec.cas,
+                int64_t(rec.bySeqno),
+                vbid);
+        item->setRevSeqno(rec.revSeqno);
+
+        GetValue val(std::move(item));
+        val.setPartial();
+        cb.callback(val);
+        if (cb.getStatus() == ENGINE_ENOMEM) {
+            // Warmup has declared itself complete; stop feeding it.
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "callbacks.h"
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+class KVBucket;
+
+/**
+ * ShutdownSnapshot persists the in-memory state which warmup would
+ * otherwise have to reconstruct by scanning every couchstore file - the
+ * per-document metadata held in each vbucket's HashTable (key, cas, seqnos,
+ * flags, expiry, datatype and value size).
+ *
+ * A clean shutdown serialises one section per vbucket into a single
+ * `shutdown.snapshot` file in the data directory, tagged with the vbucket's
+ * high seqno. A vbucket is only included if everything in its HashTable has
+ * been persisted (high seqno == persistence seqno), so a section is by
+ * construction an exact image of what a KeyDump scan of the file would
+ * produce.
+ *
+ * At warmup the snapshot is only considered after a clean shutdown, and
+ * each section is validated against the high seqno recorded in the
+ * vbucket's persisted state; any mismatch (or any parse error) demotes that
+ * vbucket to the regular KeyDump disk scan. The file is single-use: it is
+ * unlinked as soon as it has been opened, so a crash always falls back to
+ * full warmup.
+ *
+ * The file is read back by the same node that wrote it moments earlier, so
+ * records are stored in host byte order and the layout is guarded only by
+ * the magic/version header.
+ */
+class ShutdownSnapshot {
+public:
+    ShutdownSnapshot(const std::string& dbname);
+
+    /**
+     * Serialise the HashTable metadata of every fully-persisted vbucket in
+     * the given bucket. Any error discards the file; warmup then simply
+     * takes the scan path.
+     */
+    void write(KVBucket& store);
+
+    /**
+     * Open the snapshot and build the section index, validating each
+     * vbucket section against the given persisted high seqnos. Unlinks the
+     * file (it remains readable through the open stream).
+     *
+     * @param persistedHighSeqnos high seqno from each vbucket's persisted
+     *        state, keyed by vbucket id
+     * @return the number of vbucket sections which validated
+     */
+    size_t open(const std::map<uint16_t, uint64_t>& persistedHighSeqnos);
+
+    /// Does the snapshot hold a validated section for the given vbucket?
+    bool hasVBucket(uint16_t vbid);
+
+    /**
+     * Feed every document of the given vbucket's section to the callback
+     * as a metadata-only (partial) GetValue, mirroring a KEYS_ONLY scan.
+     * Stops early if the callback reports ENGINE_ENOMEM (warmup declared
+     * itself complete).
+     *
+     * @return true if the section was consumed without error; false on a
+     *         parse error, in which case the caller should fall back to
+     *         scanning the couchstore file
+     */
+    bool restoreVBucket(uint16_t vbid, Callback<GetValue>& cb);
+
+    /// Delete any snapshot left in the given data directory.
+    static void remove(const std::string& dbname);
+
+private:
+    /// Byte offset and document count of one validated vbucket section.
+    struct Section {
+        std::streamoff offset;
+        uint32_t count;
+    };
+
+    static std::string getPath(const std::string& dbname);
+
+    const std::string path;
+
+    /**
+     * Serialises restoreVBucket() calls from concurrent WarmupKeyDump
+     * tasks; restoration is memory-bound so this does not cost noticeable
+     * wall time.
+     */
+    std::mutex lock;
+    std::ifstream file;
+    std::map<uint16_t, Section> sections;
+};
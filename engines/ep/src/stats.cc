@@ -62,9 +62,10 @@ void EPStats::memDeallocated(size_t sz) {
 void EPStats::mergeMemCounter(bool force) {
     auto& counter = *(localMemCounter.get());
     counter.count++;
-    if (force || counter.count % mem_merge_count_threshold == 0 ||
-        std::abs(counter.used) > (long)mem_merge_bytes_threshold) {
+    if (force || counter.count >= mem_merge_count_threshold.load() ||
+        std::abs(counter.used) > (long)mem_merge_bytes_threshold.load()) {
         totalMemory->fetch_add(counter.used);
         counter.used = 0;
+        counter.count = 0;
     }
 }
\ No newline at end of file
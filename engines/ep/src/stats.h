@@ -32,6 +32,7 @@
 #include <atomic>
 #include "memory_tracker.h"
 #include "objectregistry.h"
+#include "striped_counter.h"
 #include "threadlocal.h"
 #include "utility.h"
 
@@ -50,6 +51,15 @@ public:
     // Thread-safe type for counting occurances of discrete,
     // non-negative entities (# events, sizes).  Relaxed memory
     // ordering (no ordeing or synchronization).
+    //
+    // Pick the counter tier to match the write rate:
+    //  - Counter: occasional updates, or updates from a single thread.
+    //  - cb::CachelinePadded<Counter>: hot but written mostly by one
+    //    thread at a time; padding stops it false-sharing with its
+    //    neighbours (e.g. memOverhead).
+    //  - StripedCounter: written on per-item paths from many threads
+    //    concurrently; each thread updates its own padded stripe and
+    //    reads aggregate (e.g. diskQueueSize).
     using Counter = Couchbase::RelaxedAtomic<size_t>;
 
     EPStats() :
@@ -70,6 +80,7 @@ public:
         tooOld(0),
         totalPersisted(0),
         totalPersistVBState(0),
+        totalDeferredVBStatePersist(0),
         totalEnqueued(0),
         flushFailed(0),
         flushExpired(0),
@@ -93,6 +104,7 @@ public:
         pagerRuns(0),
         expiryPagerRuns(0),
         itemsRemovedFromCheckpoints(0),
+        itemsExpelledFromCheckpoints(0),
         numValueEjects(0),
         numFailedEjects(0),
         numNotMyVBuckets(0),
@@ -222,9 +234,9 @@ public:
     std::atomic<ssize_t> replicationThrottleWriteQueueCap;
 
     //! Amount of items waiting for persistence
-    cb::NonNegativeCounter<size_t> diskQueueSize;
+    StripedCounter diskQueueSize;
     //! Number of items in vbucket backfill queue
-    cb::NonNegativeCounter<size_t> vbBackfillQueueSize;
+    StripedCounter vbBackfillQueueSize;
     //! Size of the in-process (output) queue.
     Counter flusher_todo;
     //! Number of transaction commits.
@@ -238,11 +250,14 @@ public:
     //! Objects that were forced into persistence for being too old.
     Counter tooOld;
     //! Number of items persisted.
-    Counter totalPersisted;
+    StripedCounter totalPersisted;
     //! Number of times VBucket state persisted.
     Counter totalPersistVBState;
+    //! Number of state-only flushes whose commit was deferred to the
+    //! next flush of the same vbucket (saving a couchstore fsync).
+    Counter totalDeferredVBStatePersist;
     //! Cumulative number of items added to the queue.
-    Counter totalEnqueued;
+    StripedCounter totalEnqueued;
     //! Number of times an item flush failed.
     Counter flushFailed;
     //! Number of times an item is not flushed due to the item's expiry
@@ -297,6 +312,8 @@ public:
     Counter expiryPagerRuns;
     //! Number of items removed from closed unreferenced checkpoints.
     Counter itemsRemovedFromCheckpoints;
+    //! Number of individual items expelled from referenced checkpoints.
+    Counter itemsExpelledFromCheckpoints;
     //! Number of times a value is ejected
     Counter numValueEjects;
     //! Number of times a value could not be ejected
@@ -350,9 +367,9 @@ public:
     Counter pendingCompactions;
 
     //! Number of times background fetches occurred.
-    Counter bg_fetched;
+    StripedCounter bg_fetched;
     //! Number of times meta background fetches occurred.
-    Counter bg_meta_fetched;
+    StripedCounter bg_meta_fetched;
     //! Number of remaining bg fetch items
     Counter numRemainingBgItems;
     //! Number of remaining bg fetch jobs.
@@ -471,6 +488,13 @@ public:
      */
     Histogram<size_t> getMultiBatchSizeHisto;
 
+    /**
+     * Histogram of the number of cookies waiting on the same key when
+     * its background fetch completed ("herd size"); a tail here means
+     * concurrent misses on hot non-resident keys
+     */
+    Histogram<size_t> bgHerdSizeHisto;
+
     //
     // Command timers
     //
@@ -542,12 +566,14 @@ public:
         tooYoung.store(0);
         tooOld.store(0);
         totalPersistVBState.store(0);
+        totalDeferredVBStatePersist.store(0);
         dirtyAge.store(0);
         dirtyAgeHighWat.store(0);
         commit_time.store(0);
         cursorsDropped.store(0);
         pagerRuns.store(0);
         itemsRemovedFromCheckpoints.store(0);
+        itemsExpelledFromCheckpoints.store(0);
         numValueEjects.store(0);
         numFailedEjects.store(0);
         numNotMyVBuckets.store(0);
@@ -598,6 +624,7 @@ public:
         diskCommitHisto.reset();
         itemAllocSizeHisto.reset();
         getMultiBatchSizeHisto.reset();
+        bgHerdSizeHisto.reset();
         dirtyAgeHisto.reset();
         mlogCompactorHisto.reset();
         getMultiHisto.reset();
@@ -609,9 +636,11 @@ public:
     std::ostream *timingLog;
 
     //! These 2 thresholds define when the thread local
-    //  mem counters are merged to the bucket counter
-    size_t mem_merge_count_threshold;
-    size_t mem_merge_bytes_threshold;
+    //  mem counters are merged to the bucket counter.
+    //  Relaxed atomics as they can be changed at runtime (set_flush_param)
+    //  while every allocating thread reads them.
+    Counter mem_merge_count_threshold;
+    Counter mem_merge_bytes_threshold;
 
 private:
     struct TLMemCounter {
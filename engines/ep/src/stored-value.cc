@@ -49,7 +49,8 @@ StoredValue::StoredValue(const Item& itm,
       isOrdered(isOrdered),
       nru(itm.getNRUValue()),
       resident(!isTempItem()),
-      stale(false) {
+      stale(false),
+      keyFingerprint(getKeyFingerprint(itm.getKey())) {
     // Placement-new the key which lives in memory directly after this
     // object.
     new (key()) SerialisedDocKey(itm.getKey());
@@ -89,7 +90,8 @@ StoredValue::StoredValue(const StoredValue& other,
       isOrdered(other.isOrdered),
       nru(other.nru),
       resident(other.resident),
-      stale(false) {
+      stale(false),
+      keyFingerprint(other.keyFingerprint) {
     // Placement-new the key which lives in memory directly after this
     // object.
     StoredDocKey sKey(other.getKey());
@@ -53,6 +53,19 @@ class OrderedStoredValue;
  * factory method (StoredValueFactory) and must be heap-allocated, managed
  * using a unique_ptr (StoredValue::UniquePtr).
  *
+ * Note that the value deliberately is *not* stored contiguously: it lives in
+ * a separate, reference-counted Blob which can be shared with Item objects
+ * (and hence the frontend / DCP read paths) without copying, can be replaced
+ * in-place by setValue() even when the new value is a different size, and
+ * can be released independently of the metadata when the value is ejected.
+ * Storing small values inline after the key would eliminate the Blob
+ * allocation, but would also turn every read into a copy and break the
+ * defragmenter (which relocates Blobs based on their age and refcount) - a
+ * poor trade for anything but write-only data.
+ *
+ * The fixed part of StoredValue is fully packed (no padding); when adding
+ * members check the object size assertions in stored_value_test.cc.
+ *
  * Graphically the looks like:
  *
  *              StoredValue::UniquePtr
@@ -101,6 +114,17 @@ class OrderedStoredValue;
  *   length  {   | ...                |
  *               +--------------------+
  *
+ * The OrderedStoredValue layout is kept as compact as possible - at large
+ * (100M+) item counts a few extra bytes per item can push the allocation
+ * into the next allocator size-class. The seqno hook is the only per-item
+ * cost over StoredValue: the deletion time of a tombstone is overlaid on
+ * the base class's lock_expiry_or_delete_time field, as deleted items can
+ * never be locked so the two uses are mutually exclusive. The hook must
+ * remain doubly-linked - when an item is updated outside of a range read it
+ * is unlinked from the middle of the SequenceList and relinked at the tail
+ * (see BasicLinkedList::updateListElem), which requires O(1) access to the
+ * predecessor.
+ *
  * To support dynamic dispatch (for example to lookup the key, whose location
  * varies depending if it's StoredValue or OrderedStoredValue), we choose to
  * use a manual flag-based dispatching (as opposed to a normal vTable based
@@ -197,6 +221,29 @@ public:
         return getKey() == k;
     }
 
+    /**
+     * The 8-bit fingerprint of this item's key - see getKeyFingerprint(key).
+     */
+    uint8_t getKeyFingerprint() const {
+        return keyFingerprint;
+    }
+
+    /**
+     * Generate the 8-bit fingerprint stored for a given key.
+     *
+     * The top byte of the key's hash is used; HashTable buckets are
+     * selected with a modulus of the full hash, so keys which collide on
+     * the same bucket still differ in the fingerprint with high
+     * probability. This allows HashTable::unlocked_find to skip
+     * non-matching elements in a hash chain without having to compare
+     * (and hence fetch) their key bytes, which reside at the tail of each
+     * StoredValue - typically in a different cache line to the chain
+     * pointer.
+     */
+    static uint8_t getKeyFingerprint(const DocKey& key) {
+        return uint8_t(key.hash() >> 24);
+    }
+
     /**
      * Get this item's key.
      */
@@ -694,6 +741,10 @@ protected:
     // Note (2): Only 1 bit of this is currently used; rest is "spare".
     std::atomic<bool> stale;
 
+    // Fingerprint of the item's key (see getKeyFingerprint(key)); occupies
+    // what was previously a padding byte so doesn't grow the object.
+    uint8_t keyFingerprint;
+
     friend std::ostream& operator<<(std::ostream& os, const StoredValue& sv);
 };
 
@@ -730,6 +781,18 @@ public:
         return stale;
     }
 
+    /**
+     * Lock-free check of whether a newer version of the same key exists.
+     * 'stale' transitions false -> true exactly once in the value's
+     * lifetime (in markStale(), under the SequenceList's writeLock), so a
+     * reader observing false may safely treat the item as current for its
+     * snapshot; a reader observing true must then acquire the writeLock to
+     * read the replacement pointer (getReplacementIfStale()).
+     */
+    bool isStaleNoLock() const {
+        return stale.load(std::memory_order_acquire);
+    }
+
     /**
      * Marks that newer instance of this item is added in the HashTable
      * @param writeLock The SeqList writeLock which guards the stale param.
@@ -742,7 +805,10 @@ public:
         // own the new SV. At destruction, we must release this ptr if
         // we are stale.
         chain_next_or_replacement.reset(newSv);
-        stale = true;
+        // Release ordering pairs with the acquire load in isStaleNoLock();
+        // ensures the replacement pointer above is visible to any reader
+        // which observes stale == true.
+        stale.store(true, std::memory_order_release);
     }
 
     StoredValue* getReplacementIfStale(
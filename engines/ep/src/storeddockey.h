@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <string>
@@ -30,13 +32,22 @@ class SerialisedDocKey;
 /**
  * StoredDocKey is a container for key data
  *
- * Internally an n byte key is stored in a n + 1 std::string.
+ * Internally an n byte key is stored in an n + 1 byte buffer.
  *  a) We zero terminate so that data() is safe for printing as a c-string.
  *  b) We store the DocNamespace in byte 0 (duplicated in parent class DocKey).
  *    This is because StoredDocKey typically ends up being written to disk and
  *    the DocNamespace forms part of the on-disk key. Pre-allocating space
  *    for the DocNamespace means storage components don't have to create a
  *    new buffer into which we layout DocNamespace and key data.
+ *
+ * The buffer is stored inline in the object when it fits (keys up to
+ * inlineCapacity - 2 bytes, which covers every key the protocol limit of
+ * 250 bytes commonly produces), only falling back to a heap allocation for
+ * longer keys. StoredDocKey is held by value in every Item, checkpoint
+ * index entry and bgfetch map, so the inline representation removes a heap
+ * allocation per key and a pointer chase from every key compare. (A
+ * std::string member would heap-allocate for anything beyond its small
+ * string optimisation limit, which typical keys exceed.)
  */
 class StoredDocKey : public DocKeyInterface<StoredDocKey> {
 public:
@@ -47,11 +58,10 @@ public:
      * @docNamespace the namespace the key applies to
      */
     StoredDocKey(const uint8_t* key, size_t nkey, DocNamespace docNamespace) {
-        keydata.resize(nkey + namespaceBytes);
-        keydata.replace(
-                namespaceBytes, nkey, reinterpret_cast<const char*>(key), nkey);
-        keydata.at(0) = static_cast<std::underlying_type<DocNamespace>::type>(
+        init(nkey + namespaceBytes);
+        buffer()[0] = static_cast<std::underlying_type<DocNamespace>::type>(
                 docNamespace);
+        std::memcpy(buffer() + namespaceBytes, key, nkey);
     }
 
     /**
@@ -81,25 +91,56 @@ public:
      * @param key pointer to data to be copied in
      * @param nkey the number of bytes to be copied
      */
-    StoredDocKey(const uint8_t* key, size_t nkey)
-        : keydata(reinterpret_cast<const char*>(key), nkey) {
+    StoredDocKey(const uint8_t* key, size_t nkey) {
+        init(nkey);
+        std::memcpy(buffer(), key, nkey);
+    }
+
+    StoredDocKey(const StoredDocKey& other) {
+        init(other.nsSize);
+        std::memcpy(buffer(), other.buffer(), nsSize);
+    }
+
+    StoredDocKey(StoredDocKey&& other) : nsSize(other.nsSize) {
+        std::memcpy(inlineData, other.inlineData, sizeof(inlineData));
+        // Leave other as a valid (empty, inline) key.
+        other.nsSize = 0;
+        other.inlineData[0] = 0;
+    }
+
+    StoredDocKey& operator=(StoredDocKey other) {
+        swap(other);
+        return *this;
+    }
+
+    ~StoredDocKey() {
+        if (!isInline()) {
+            delete[] heapData;
+        }
+    }
+
+    void swap(StoredDocKey& other) {
+        std::swap(nsSize, other.nsSize);
+        // Swapping the full inline buffer also swaps the heap pointer
+        // (which occupies the start of the union) when either key is
+        // heap allocated.
+        std::swap(inlineData, other.inlineData);
     }
 
     const uint8_t* data() const {
-        return reinterpret_cast<const uint8_t*>(
-                &keydata.data()[namespaceBytes]);
+        return buffer() + namespaceBytes;
     }
 
     size_t size() const {
-        return keydata.size() - namespaceBytes;
+        return nsSize - namespaceBytes;
     }
 
     DocNamespace getDocNamespace() const {
-        return DocNamespace(keydata.at(0));
+        return DocNamespace(buffer()[0]);
     }
 
     const char* c_str() const {
-        return &keydata.c_str()[namespaceBytes];
+        return reinterpret_cast<const char*>(buffer() + namespaceBytes);
     }
 
     /**
@@ -107,18 +148,19 @@ public:
      * Thus the "beer::bud" in the Collections namespace becomes "\1beer::bud"
      */
     const uint8_t* getDocNameSpacedData() const {
-        return reinterpret_cast<const uint8_t*>(keydata.data());
+        return buffer();
     }
 
     /**
      * Return the size of the buffer returned by getDocNameSpacedData()
      */
     size_t getDocNameSpacedSize() const {
-        return keydata.size();
+        return nsSize;
     }
 
     bool operator==(const StoredDocKey& rhs) const {
-        return keydata == rhs.keydata;
+        return nsSize == rhs.nsSize &&
+               std::memcmp(buffer(), rhs.buffer(), nsSize) == 0;
     }
 
     bool operator!=(const StoredDocKey& rhs) const {
@@ -126,12 +168,50 @@ public:
     }
 
     bool operator<(const StoredDocKey& rhs) const {
-        return keydata < rhs.keydata;
+        const int cmp = std::memcmp(
+                buffer(), rhs.buffer(), std::min(nsSize, rhs.nsSize));
+        return cmp < 0 || (cmp == 0 && nsSize < rhs.nsSize);
     }
 
 protected:
     static const size_t namespaceBytes = sizeof(DocNamespace);
-    std::string keydata;
+
+    /// Size of the inline buffer (including the nul terminator).
+    static const size_t inlineCapacity = 48;
+
+    bool isInline() const {
+        // The nul terminator must also fit.
+        return nsSize < inlineCapacity;
+    }
+
+    /**
+     * Set the (namespaced) size of the key, allocate the buffer on the
+     * heap if it doesn't fit inline and zero terminate it. The caller
+     * fills in the key bytes.
+     */
+    void init(size_t size) {
+        nsSize = size;
+        if (!isInline()) {
+            heapData = new uint8_t[size + 1];
+        }
+        buffer()[size] = 0;
+    }
+
+    uint8_t* buffer() {
+        return isInline() ? inlineData : heapData;
+    }
+
+    const uint8_t* buffer() const {
+        return isInline() ? inlineData : heapData;
+    }
+
+    /// Size of the namespace prefix plus the key bytes.
+    size_t nsSize;
+
+    union {
+        uint8_t inlineData[inlineCapacity];
+        uint8_t* heapData;
+    };
 };
 
 std::ostream& operator<<(std::ostream& os, const StoredDocKey& key);
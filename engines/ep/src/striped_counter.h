@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <thread>
+
+/**
+ * A counter striped over cacheline-padded slots.
+ *
+ * A plain (Relaxed)Atomic counter updated from every thread bounces its
+ * cacheline between cores on each update, and counters packed next to
+ * each other in a stats structure additionally false-share. Here each
+ * thread updates a fixed stripe of its own (picked by hashing the
+ * thread id, as the lock stripes in locks.h do) and the stripes are
+ * summed on read.
+ *
+ * Because a decrement may run on a different thread than the matching
+ * increment, an individual stripe may legitimately go negative; only
+ * the aggregated sum is meaningful. load() therefore sums signed
+ * stripes and clamps the result at zero. Like the relaxed counters
+ * this replaces, a read concurrent with updates may see a slightly
+ * stale total.
+ *
+ * Intended for write-mostly counters updated on per-item paths and read
+ * only for stats or coarse threshold checks.
+ */
+class StripedCounter {
+public:
+    StripedCounter() {
+    }
+
+    StripedCounter(size_t v) {
+        stripes[0].value = int64_t(v);
+    }
+
+    /// Sum the stripes; clamped at zero (see class comment)
+    size_t load() const {
+        int64_t sum = 0;
+        for (const auto& stripe : stripes) {
+            sum += stripe.value.load();
+        }
+        return sum < 0 ? 0 : size_t(sum);
+    }
+
+    operator size_t() const {
+        return load();
+    }
+
+    void operator++() {
+        localStripe().value += 1;
+    }
+
+    void operator++(int) {
+        localStripe().value += 1;
+    }
+
+    void operator--() {
+        localStripe().value -= 1;
+    }
+
+    void operator--(int) {
+        localStripe().value -= 1;
+    }
+
+    void fetch_add(size_t v) {
+        localStripe().value += int64_t(v);
+    }
+
+    void fetch_sub(size_t v) {
+        localStripe().value -= int64_t(v);
+    }
+
+    void operator+=(size_t v) {
+        fetch_add(v);
+    }
+
+    void operator-=(size_t v) {
+        fetch_sub(v);
+    }
+
+    /// Replace the aggregated value (not atomic with respect to
+    /// concurrent updates; intended for reset / initialization)
+    void store(size_t v) {
+        for (auto& stripe : stripes) {
+            stripe.value.store(0);
+        }
+        stripes[0].value.store(int64_t(v));
+    }
+
+    void reset() {
+        store(0);
+    }
+
+private:
+    static const size_t NUM_STRIPES = 16;
+
+    struct alignas(64) Stripe {
+        Couchbase::RelaxedAtomic<int64_t> value;
+    };
+
+    Stripe& localStripe() {
+        static thread_local const size_t stripe =
+                std::hash<std::thread::id>()(std::this_thread::get_id()) %
+                NUM_STRIPES;
+        return stripes[stripe];
+    }
+
+    std::array<Stripe, NUM_STRIPES> stripes;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StripedCounter& c) {
+    return os << c.load();
+}
@@ -20,10 +20,16 @@
 #include "executorpool.h"
 #include "executorthread.h"
 
+#include <algorithm>
 #include <cmath>
 
+// Bounds for the adaptive pre-sleep spin (see _spinForWork)
+static const uint32_t SPIN_BUDGET_MIN = 64;
+static const uint32_t SPIN_BUDGET_MAX = 65536;
+
 TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm) :
-    name(nm), queueType(t), manager(m), sleepers(0)
+    name(nm), queueType(t), manager(m), sleepers(0),
+    spinBudget(SPIN_BUDGET_MIN)
 {
     // EMPTY
 }
@@ -59,20 +65,30 @@ ExTask TaskQueue::_popReadyTask(void) {
 }
 
 void TaskQueue::doWake(size_t &numToWake) {
+    if (!numToWake || !sleepers.load(std::memory_order_acquire)) {
+        // Fast path - no-one is blocked on this queue's condvar so there
+        // is nothing to signal; don't touch the mutex. This is the common
+        // case under heavy load (e.g. flush storms) where every thread is
+        // already running and each schedule()/wake() would otherwise
+        // serialize on the sleep queue's mutex just to find zero sleepers.
+        // A thread which is concurrently going to sleep re-checks for
+        // ready work under the mutex first and only sleeps with a bounded
+        // timeout, so a wake-up lost to this race is at worst delayed,
+        // never dropped.
+        return;
+    }
     LockHolder lh(mutex);
     _doWake_UNLOCKED(numToWake);
 }
 
 void TaskQueue::_doWake_UNLOCKED(size_t &numToWake) {
-    if (sleepers && numToWake)  {
-        if (numToWake < sleepers) {
-            for (; numToWake; --numToWake) {
-                mutex.notify_one(); // cond_signal 1
-            }
-        } else {
-            mutex.notify_all(); // cond_broadcast
-            numToWake -= sleepers;
-        }
+    // Signal at most one sleeper per ready task rather than broadcasting;
+    // a cond_broadcast wakes every sleeper only for all but numToWake of
+    // them to re-take the mutex, find the readyQueue already drained and
+    // go back to sleep.
+    size_t curSleepers = sleepers.load();
+    for (; numToWake && curSleepers; --numToWake, --curSleepers) {
+        mutex.notify_one(); // cond_signal 1
     }
 }
 
@@ -150,8 +166,37 @@ bool TaskQueue::_fetchNextTask(ExecutorThread &t, bool toSleep) {
     return ret;
 }
 
+bool TaskQueue::_spinForWork(ExecutorThread &t) {
+    // Briefly poll for new work before committing to a condvar sleep: a
+    // task scheduled right after the thread found the queues empty
+    // (common under load, e.g. the flusher being re-woken by the next
+    // batch of dirty items) is then picked up without paying a full
+    // sleep/signal/wake round trip through the scheduler. The budget
+    // adapts - it doubles when a spin pays off and halves when it does
+    // not - so queues on an idle node decay to a near-zero spin while
+    // busy queues spin just long enough to catch back-to-back work.
+    const uint32_t budget = spinBudget.load(std::memory_order_relaxed);
+    for (uint32_t ii = 0; ii < budget; ++ii) {
+        if (t.state != EXECUTOR_RUNNING) {
+            return false;
+        }
+        if (manager->hasReadyWork(queueType)) {
+            spinBudget.store(std::min(budget * 2, SPIN_BUDGET_MAX),
+                             std::memory_order_relaxed);
+            return true;
+        }
+    }
+    spinBudget.store(std::max(budget / 2, SPIN_BUDGET_MIN),
+                     std::memory_order_relaxed);
+    return false;
+}
+
 bool TaskQueue::fetchNextTask(ExecutorThread &thread, bool toSleep) {
     EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
+    if (toSleep && _spinForWork(thread)) {
+        // Work appeared while spinning; go grab it instead of sleeping
+        toSleep = false;
+    }
     bool rv = _fetchNextTask(thread, toSleep);
     ObjectRegistry::onSwitchThread(epe);
     return rv;
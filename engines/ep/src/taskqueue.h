@@ -25,6 +25,7 @@
 
 #include <platform/processclock.h>
 
+#include <atomic>
 #include <list>
 #include <queue>
 
@@ -72,6 +73,7 @@ private:
     bool _fetchNextTask(ExecutorThread &thread, bool toSleep);
     void _wake(ExTask &task);
     bool _doSleep(ExecutorThread &thread, std::unique_lock<std::mutex>& lock);
+    bool _spinForWork(ExecutorThread &thread);
     void _doWake_UNLOCKED(size_t &numToWake);
     size_t _moveReadyTasks(const ProcessClock::time_point tv);
     ExTask _popReadyTask(void);
@@ -80,14 +82,23 @@ private:
     const std::string name;
     task_type_t queueType;
     ExecutorPool *manager;
-    size_t sleepers; // number of threads sleeping in this taskQueue
+
+    // Number of threads sleeping in this taskQueue. Modified while holding
+    // `mutex`, but atomic so that doWake() can skip acquiring the mutex
+    // entirely when there is no-one to signal.
+    std::atomic<size_t> sleepers;
+
+    // Number of iterations an idle thread polls for new work before
+    // blocking on the condvar; adapted by _spinForWork() based on
+    // whether recent spins paid off.
+    std::atomic<uint32_t> spinBudget;
 
     // sorted by task priority.
     std::priority_queue<ExTask, std::deque<ExTask>,
                         CompareByPriority> readyQueue;
 
     // sorted by waketime.
-    FutureQueue<> futureQueue;
+    FutureQueue futureQueue;
 
     std::list<ExTask> pendingQueue;
 };
@@ -19,6 +19,7 @@
 #include "bgfetcher.h"
 #include "ep_bucket.h"
 #include "ep_engine.h"
+#include "executorpool.h"
 #include "flusher.h"
 #include "kvstore.h"
 #include "tasks.h"
@@ -160,3 +161,25 @@ bool WorkLoadMonitor::run() {
     }
     return true;
 }
+
+PoolSizeMonitor::PoolSizeMonitor(EventuallyPersistentEngine* e,
+                                 bool completeBeforeShutdown)
+    : GlobalTask(e, TaskId::PoolSizeMonitor,
+                 e->getConfiguration().getExecutorAdaptiveSizingInterval(),
+                 completeBeforeShutdown) {
+}
+
+bool PoolSizeMonitor::run() {
+    Configuration& config = engine->getConfiguration();
+    // An explicit num_reader_threads / num_writer_threads setting pins that
+    // pool at the operator's choice; only auto-sized pools are adjusted.
+    ExecutorPool::get()->adjustWorkersForLoad(
+            config.getNumReaderThreads() == 0,
+            config.getNumWriterThreads() == 0);
+
+    snooze(config.getExecutorAdaptiveSizingInterval());
+    if (engine->getEpStats().isShutdown) {
+        return false;
+    }
+    return true;
+}
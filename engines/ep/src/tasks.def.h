@@ -70,6 +70,7 @@ TASK(VBucketMemoryDeletionTask, NONIO_TASK_IDX, 6)
 TASK(StatCheckpointTask, NONIO_TASK_IDX, 7)
 TASK(ItemPager, NONIO_TASK_IDX, 7)
 TASK(ExpiredItemPager, NONIO_TASK_IDX, 7)
+TASK(ExpiryIndexPager, NONIO_TASK_IDX, 7)
 TASK(ItemPagerVisitor, NONIO_TASK_IDX, 7)
 TASK(ExpiredItemPagerVisitor, NONIO_TASK_IDX, 7)
 TASK(DefragmenterTask, NONIO_TASK_IDX, 7)
@@ -77,5 +78,7 @@ TASK(EphTombstoneHTCleaner, NONIO_TASK_IDX, 7)
 TASK(EphTombstoneStaleItemDeleter, NONIO_TASK_IDX, 7)
 TASK(ConnManager, NONIO_TASK_IDX, 8)
 TASK(WorkLoadMonitor, NONIO_TASK_IDX, 10)
+TASK(PoolSizeMonitor, NONIO_TASK_IDX, 10)
+TASK(QuotaArbiterTask, NONIO_TASK_IDX, 10)
 TASK(HashtableResizerTask, NONIO_TASK_IDX, 211)
 TASK(HashtableResizerVisitorTask, NONIO_TASK_IDX, 7)
@@ -302,3 +302,27 @@ private:
     size_t prevNumMutations;
     size_t prevNumGets;
 };
+
+/**
+ * Periodically re-evaluates the executor pool's reader/writer thread counts
+ * against the measured task latency and queue depth (see
+ * ExecutorPool::adjustWorkersForLoad). Only scheduled when
+ * executor_adaptive_sizing is enabled.
+ */
+class PoolSizeMonitor : public GlobalTask {
+public:
+    PoolSizeMonitor(EventuallyPersistentEngine* e,
+                    bool completeBeforeShutdown = false);
+
+    bool run();
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Reads a handful of counters; may also start or stop (and join)
+        // one worker thread.
+        return std::chrono::milliseconds(100);
+    }
+
+    cb::const_char_buffer getDescription() {
+        return "Adjusting executor pool size for load";
+    }
+};
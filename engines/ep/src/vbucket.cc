@@ -316,12 +316,12 @@ void VBucket::getBackfillItems(std::vector<queued_item>& items) {
 }
 
 void VBucket::setState(vbucket_state_t to) {
-    WriterLockHolder wlh(stateLock);
+    StripedRWLock::WriteHolder wlh(stateLock);
     setState_UNLOCKED(to, wlh);
 }
 
 void VBucket::setState_UNLOCKED(vbucket_state_t to,
-                                WriterLockHolder &vbStateLock) {
+                                StripedRWLock::WriteHolder& vbStateLock) {
     vbucket_state_t oldstate = state;
 
     if (to == vbucket_state_active &&
@@ -341,17 +341,22 @@ void VBucket::setState_UNLOCKED(vbucket_state_t to,
 vbucket_state VBucket::getVBucketState() const {
      auto persisted_range = getPersistedSnapshot();
 
-     return vbucket_state{getState(),
-                          getPersistenceCheckpointId(),
-                          0,
-                          getHighSeqno(),
-                          getPurgeSeqno(),
-                          persisted_range.start,
-                          persisted_range.end,
-                          getMaxCas(),
-                          hlc.getEpochSeqno(),
-                          mightContainXattrs(),
-                          failovers->toJSON()};
+     vbucket_state vbs{getState(),
+                       getPersistenceCheckpointId(),
+                       0,
+                       getHighSeqno(),
+                       getPurgeSeqno(),
+                       persisted_range.start,
+                       persisted_range.end,
+                       getMaxCas(),
+                       hlc.getEpochSeqno(),
+                       mightContainXattrs(),
+                       failovers->toJSON()};
+     // Record where any DCP/TAP cursors have reached so that after a
+     // restart the recent seqno window can be rebuilt in memory and
+     // reconnecting clients resume without a disk backfill.
+     vbs.streamCursors = checkpointManager->getConnCursorSeqnosJSON();
+     return vbs;
 }
 
 
@@ -617,6 +622,32 @@ void VBucket::swapFilter() {
     }
 }
 
+std::string VBucket::serializeFilter() {
+    LockHolder lh(bfMutex);
+    if (bFilter && bFilter->getStatus() == BFILTER_ENABLED) {
+        return bFilter->serialize();
+    }
+    return {};
+}
+
+bool VBucket::restoreFilter(const std::string& serialized) {
+    LockHolder lh(bfMutex);
+    if (bFilter != nullptr || tempFilter != nullptr) {
+        LOG(EXTENSION_LOG_WARNING, "(vb %" PRIu16 ") Bloom filter / Temp filter"
+            " already exist!", id);
+        return false;
+    }
+    try {
+        bFilter = std::make_unique<BloomFilter>(serialized);
+    } catch (const std::invalid_argument& e) {
+        LOG(EXTENSION_LOG_WARNING,
+            "(vb %" PRIu16 ") Discarding persisted bloom filter: %s",
+            id, e.what());
+        return false;
+    }
+    return true;
+}
+
 void VBucket::clearFilter() {
     LockHolder lh(bfMutex);
     bFilter.reset();
@@ -702,9 +733,36 @@ VBNotifyCtx VBucket::queueDirty(
     v.setBySeqno(qi->getBySeqno());
     notifyCtx.bySeqno = qi->getBySeqno();
 
+    if (qi->getExptime() != 0 && !qi->isDeleted()) {
+        expiryIndex.add(qi->getExptime(), qi->getKey());
+    }
+
     return notifyCtx;
 }
 
+time_t VBucket::harvestExpiredItems(time_t now,
+                                    size_t limit,
+                                    std::list<Item>& expired) {
+    auto keys = expiryIndex.harvest(now, limit);
+
+    if (getState() == vbucket_state_active) {
+        for (const auto& key : keys) {
+            auto hbl = ht.getLockedBucket(key);
+            StoredValue* v = ht.unlocked_find(key,
+                                              hbl.getBucketNum(),
+                                              WantsDeleted::No,
+                                              TrackReference::No);
+            if (v && !v->isTempItem() && !v->isDeleted() &&
+                v->isExpired(now)) {
+                std::unique_ptr<Item> it = v->toItem(false, getId());
+                expired.push_back(*it.get());
+            }
+        }
+    }
+
+    return expiryIndex.getNextDeadline();
+}
+
 StoredValue* VBucket::fetchValidValue(HashTable::HashBucketLock& hbl,
                                       const DocKey& key,
                                       WantsDeleted wantsDeleted,
@@ -2474,10 +2532,20 @@ void VBucket::addHighPriorityVBEntry(uint64_t seqnoOrChkId,
                                      const void* cookie,
                                      HighPriorityVBNotify reqType) {
     std::unique_lock<std::mutex> lh(hpVBReqsMutex);
-    hpVBReqs.push_back(HighPriorityVBEntry(cookie, seqnoOrChkId, reqType));
+    // Keep the list ordered by id so the requests satisfied by a flush
+    // form a prefix of the list. New requests almost always wait on the
+    // highest seqno so far, so this is normally a plain append.
+    auto pos = hpVBReqs.rbegin();
+    while (pos != hpVBReqs.rend() && pos->id > seqnoOrChkId) {
+        ++pos;
+    }
+    hpVBReqs.insert(pos.base(),
+                    HighPriorityVBEntry(cookie, seqnoOrChkId, reqType));
     numHpVBReqs.store(hpVBReqs.size());
 
-    LOG(EXTENSION_LOG_NOTICE,
+    // Logged at INFO: seqno persistence requests may be issued for every
+    // write, which is far too frequent for NOTICE.
+    LOG(EXTENSION_LOG_INFO,
         "Added high priority async request %s "
         "for vb:%" PRIu16 ", Check for:%" PRIu64 ", "
         "Persisted upto:%" PRIu64 ", cookie:%p",
@@ -2488,63 +2556,81 @@ void VBucket::addHighPriorityVBEntry(uint64_t seqnoOrChkId,
         cookie);
 }
 
-std::map<const void*, ENGINE_ERROR_CODE> VBucket::getHighPriorityNotifications(
+HighPriorityNotifications VBucket::getHighPriorityNotifications(
         EventuallyPersistentEngine& engine,
         uint64_t idNum,
         HighPriorityVBNotify notifyType) {
-    std::unique_lock<std::mutex> lh(hpVBReqsMutex);
-    std::map<const void*, ENGINE_ERROR_CODE> toNotify;
-
-    auto entry = hpVBReqs.begin();
-
-    while (entry != hpVBReqs.end()) {
-        if (notifyType != entry->reqType) {
-            ++entry;
-            continue;
-        }
-
-        std::string logStr(to_string(notifyType));
-
-        auto wall_time = ProcessClock::now() - entry->start;
-        auto spent =
-                std::chrono::duration_cast<std::chrono::seconds>(wall_time);
-        if (entry->id <= idNum) {
-            toNotify[entry->cookie] = ENGINE_SUCCESS;
-            stats.chkPersistenceHisto.add(
-                    std::chrono::duration_cast<std::chrono::microseconds>(
-                            wall_time));
-            adjustCheckpointFlushTimeout(spent);
-            LOG(EXTENSION_LOG_NOTICE,
-                "Notified the completion of %s "
-                "for vbucket %" PRIu16 ", Check for: %" PRIu64
-                ", "
-                "Persisted upto: %" PRIu64 ", cookie %p",
-                logStr.c_str(),
-                getId(),
-                entry->id,
-                idNum,
-                entry->cookie);
-            entry = hpVBReqs.erase(entry);
-        } else if (spent > getCheckpointFlushTimeout()) {
-            adjustCheckpointFlushTimeout(spent);
-            engine.storeEngineSpecific(entry->cookie, NULL);
-            toNotify[entry->cookie] = ENGINE_TMPFAIL;
-            LOG(EXTENSION_LOG_WARNING,
-                "Notified the timeout on %s "
-                "for vbucket %" PRIu16 ", Check for: %" PRIu64
-                ", "
-                "Persisted upto: %" PRIu64 ", cookie %p",
-                logStr.c_str(),
-                getId(),
-                entry->id,
-                idNum,
-                entry->cookie);
-            entry = hpVBReqs.erase(entry);
-        } else {
-            ++entry;
-        }
+    HighPriorityNotifications toNotify;
+
+    // Sweep the entries out of the list under the lock; the per-entry
+    // work (stats, logging, storeEngineSpecific) is done after it has
+    // been released so that front-end threads registering new waits are
+    // not serialized behind it.
+    std::list<HighPriorityVBEntry> satisfied;
+    std::list<HighPriorityVBEntry> timedOut;
+    {
+        std::unique_lock<std::mutex> lh(hpVBReqsMutex);
+        auto entry = hpVBReqs.begin();
+        while (entry != hpVBReqs.end()) {
+            auto next = std::next(entry);
+            if (notifyType == entry->reqType) {
+                if (entry->id <= idNum) {
+                    satisfied.splice(satisfied.end(), hpVBReqs, entry);
+                } else if (std::chrono::duration_cast<std::chrono::seconds>(
+                                   ProcessClock::now() - entry->start) >
+                           getCheckpointFlushTimeout()) {
+                    timedOut.splice(timedOut.end(), hpVBReqs, entry);
+                }
+            }
+            entry = next;
+        }
+        numHpVBReqs.store(hpVBReqs.size());
+    }
+
+    const std::string logStr(to_string(notifyType));
+
+    toNotify.satisfied.reserve(satisfied.size());
+    for (const auto& entry : satisfied) {
+        auto wall_time = ProcessClock::now() - entry.start;
+        stats.chkPersistenceHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        wall_time));
+        adjustCheckpointFlushTimeout(
+                std::chrono::duration_cast<std::chrono::seconds>(wall_time));
+        toNotify.satisfied.push_back(entry.cookie);
+        // Logged at INFO: seqno persistence requests may be issued for
+        // every write, which is far too frequent for NOTICE.
+        LOG(EXTENSION_LOG_INFO,
+            "Notified the completion of %s "
+            "for vbucket %" PRIu16 ", Check for: %" PRIu64
+            ", "
+            "Persisted upto: %" PRIu64 ", cookie %p",
+            logStr.c_str(),
+            getId(),
+            entry.id,
+            idNum,
+            entry.cookie);
+    }
+
+    toNotify.timedOut.reserve(timedOut.size());
+    for (const auto& entry : timedOut) {
+        auto spent = std::chrono::duration_cast<std::chrono::seconds>(
+                ProcessClock::now() - entry.start);
+        adjustCheckpointFlushTimeout(spent);
+        engine.storeEngineSpecific(entry.cookie, NULL);
+        toNotify.timedOut.push_back(entry.cookie);
+        LOG(EXTENSION_LOG_WARNING,
+            "Notified the timeout on %s "
+            "for vbucket %" PRIu16 ", Check for: %" PRIu64
+            ", "
+            "Persisted upto: %" PRIu64 ", cookie %p",
+            logStr.c_str(),
+            getId(),
+            entry.id,
+            idNum,
+            entry.cookie);
     }
-    numHpVBReqs.store(hpVBReqs.size());
+
     return toNotify;
 }
 
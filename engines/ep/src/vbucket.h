@@ -23,10 +23,12 @@
 #include "checkpoint_config.h"
 #include "collections/vbucket_manifest.h"
 #include "dcp/dcp-types.h"
+#include "expiry_index.h"
 #include "hash_table.h"
 #include "hlc.h"
 #include "item_pager.h"
 #include "kvstore.h"
+#include "locks.h"
 #include "monotonic.h"
 
 #include <memcached/engine.h>
@@ -107,6 +109,24 @@ struct HighPriorityVBEntry {
     ProcessClock::time_point start;
 };
 
+/**
+ * Outcome of a sweep of the high priority request list: the cookies to be
+ * woken, grouped by the status they must be notified with so that each
+ * group can be handed to the batched notification path in a single call.
+ */
+struct HighPriorityNotifications {
+    /// Requests whose seqno (or checkpoint id) has been satisfied;
+    /// notified with ENGINE_SUCCESS.
+    std::vector<const void*> satisfied;
+    /// Requests which have waited longer than the flush timeout;
+    /// notified with ENGINE_TMPFAIL.
+    std::vector<const void*> timedOut;
+
+    size_t size() const {
+        return satisfied.size() + timedOut.size();
+    }
+};
+
 typedef std::unique_ptr<Callback<const uint16_t, const VBNotifyCtx&>>
         NewSeqnoCallback;
 
@@ -335,9 +355,10 @@ public:
      * @param to desired vbucket state
      * @param vbStateLock write lock holder on 'stateLock'
      */
-    void setState_UNLOCKED(vbucket_state_t to, WriterLockHolder& vbStateLock);
+    void setState_UNLOCKED(vbucket_state_t to,
+                           StripedRWLock::WriteHolder& vbStateLock);
 
-    cb::RWLock& getStateLock() {return stateLock;}
+    StripedRWLock& getStateLock() {return stateLock;}
 
     vbucket_state_t getInitialState(void) { return initialState; }
 
@@ -481,10 +502,10 @@ public:
      * @param id seqno or checkpoint id for which notifies are to be found
      * @param notifyType indicating notify for seqno or chk persistence
      *
-     * @return map of notifications with conn cookie as the key and notify
-     *         status as the value
+     * @return cookies of the connections to be woken, grouped by the
+     *         status to notify them with
      */
-    std::map<const void*, ENGINE_ERROR_CODE> getHighPriorityNotifications(
+    HighPriorityNotifications getHighPriorityNotifications(
             EventuallyPersistentEngine& engine,
             uint64_t idNum,
             HighPriorityVBNotify notifyType);
@@ -503,6 +524,22 @@ public:
     bool isTempFilterAvailable();
     void addToTempFilter(const DocKey& key);
     void swapFilter();
+
+    /**
+     * Serialize the current bloom filter for persistence; returns an
+     * empty string if no enabled filter exists.
+     */
+    std::string serializeFilter();
+
+    /**
+     * Create the bloom filter from the serialized form produced by
+     * serializeFilter(), in place of a fresh (empty) one. Only valid
+     * while no filter exists yet. Returns false - leaving the vbucket
+     * filterless, as after any restart today - if the data cannot be
+     * parsed.
+     */
+    bool restoreFilter(const std::string& serialized);
+
     void clearFilter();
     void setFilterStatus(bfilter_status_t to);
     std::string getFilterStatusString();
@@ -876,6 +913,24 @@ public:
                            time_t startTime,
                            ExpireBy source);
 
+    /**
+     * Pop the keys which have reached their expiry deadline from the
+     * vbucket's expiry index and (for an active vbucket) copy the items
+     * which really are expired into the given list. The index is
+     * advisory (see ExpiryIndex) so every key popped is validated
+     * against the HashTable; keys for non-active vbuckets are popped
+     * (so that the index can't grow without bound on a replica) but
+     * their items are left alone.
+     *
+     * @param now the current time
+     * @param limit the maximum number of keys to pop from the index
+     * @param[out] expired the expired items are appended to this list
+     * @return the next deadline held by the index (0 if it is empty)
+     */
+    time_t harvestExpiredItems(time_t now,
+                               size_t limit,
+                               std::list<Item>& expired);
+
     /**
      * Evict a key from memory.
      *
@@ -895,8 +950,10 @@ public:
      *
      * The definition of "page out" is up to the underlying VBucket
      * implementation - this may mean simply ejecting the value from memory
-     * (Value Eviction), removing the entire document from memory (Full Eviction),
-     * or actually deleting the document (Ephemeral Buckets).
+     * (Value Eviction), removing the entire document from memory (Full
+     * Eviction - which pages out in two stages, only removing the whole
+     * document once its value is already non-resident), or actually
+     * deleting the document (Ephemeral Buckets).
      *
      * @param lh Bucket lock associated with the StoredValue.
      * @param v[in, out] Ref to the StoredValue to be ejected. Based on the
@@ -908,6 +965,23 @@ public:
     virtual bool pageOut(const HashTable::HashBucketLock& lh,
                          StoredValue*& v) = 0;
 
+    /**
+     * Attempt to quickly page out up to maxToEvict cold items, if the
+     * VBucket implementation can identify them without a HashTable scan.
+     *
+     * Default implementation does nothing - persistent buckets select
+     * items to evict by scanning the HashTable (see PagingVisitor).
+     * Ephemeral buckets override this to delete items from the cold end
+     * of their sequence list.
+     *
+     * @param maxToEvict Maximum number of items to page out
+     *
+     * @return Number of items paged out.
+     */
+    virtual size_t evictProbationaryItems(size_t maxToEvict) {
+        return 0;
+    }
+
     /**
      * Add an item in the store
      *
@@ -1634,7 +1708,7 @@ private:
 
     id_type                         id;
     std::atomic<vbucket_state_t>    state;
-    cb::RWLock                      stateLock;
+    StripedRWLock                   stateLock;
     vbucket_state_t                 initialState;
     std::mutex                           pendingOpLock;
     std::vector<const void*>        pendingOps;
@@ -1652,6 +1726,13 @@ private:
     std::unique_ptr<BloomFilter> bFilter;
     std::unique_ptr<BloomFilter> tempFilter;    // Used during compaction.
 
+    /**
+     * Time-ordered index over the keys of the items which carry an
+     * expiry time; populated by queueDirty and drained by
+     * harvestExpiredItems.
+     */
+    ExpiryIndex expiryIndex;
+
     std::atomic<uint64_t> rollbackItemCount;
 
     HLC hlc;
@@ -24,9 +24,13 @@
 #include <phosphor/phosphor.h>
 #include <platform/processclock.h>
 
+const size_t VBucketMemoryDeletionTask::reclaimBudget = 65536;
+
 VBucketMemoryDeletionTask::VBucketMemoryDeletionTask(
         EventuallyPersistentEngine& eng, VBucket* vb, TaskId tid)
-    : GlobalTask(&eng, tid, 0.0, true), vbucket(vb) {
+    : GlobalTask(&eng, tid, 0.0, true),
+      vbucket(vb),
+      pendingConnsNotified(false) {
     if (!vbucket) {
         throw std::logic_error(
                 "VBucketMemoryDeletionTask::VBucketMemoryDeletionTask no "
@@ -51,7 +55,18 @@ bool VBucketMemoryDeletionTask::run() {
                  "vb",
                  vbucket->getId());
 
-    notifyAllPendingConnsFailed(true);
+    if (!pendingConnsNotified) {
+        notifyAllPendingConnsFailed(true);
+        pendingConnsNotified = true;
+    }
+
+    // Reclaim the hash table in budgeted batches, re-scheduling ourselves
+    // while work remains; the final run leaves an empty table so the
+    // VBucket destruction (when this task is deleted) is cheap.
+    if (vbucket->ht.clearBudgeted(reclaimBudget) == reclaimBudget) {
+        snooze(0);
+        return true;
+    }
 
     return false;
 }
@@ -72,7 +87,8 @@ VBucketMemoryAndDiskDeletionTask::VBucketMemoryAndDiskDeletionTask(
                                 static_cast<VBucket*>(vb),
                                 TaskId::VBucketMemoryAndDiskDeletionTask),
       shard(shard),
-      vbDeleteRevision(vb->getDeferredDeletionFileRevision()) {
+      vbDeleteRevision(vb->getDeferredDeletionFileRevision()),
+      diskDeletionComplete(false) {
     description += " and disk";
 }
 
@@ -81,24 +97,36 @@ bool VBucketMemoryAndDiskDeletionTask::run() {
                  "VBucketMemoryAndDiskDeletionTask",
                  "vb",
                  vbucket->getId());
-    notifyAllPendingConnsFailed(false);
-
-    auto start = ProcessClock::now();
-    shard.getRWUnderlying()->delVBucket(vbucket->getId(), vbDeleteRevision);
-    auto elapsed = ProcessClock::now() - start;
-    auto wallTime =
-            std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
-
-    engine->getEpStats().vbucketDeletions++;
-    BlockTimer::log(elapsed, "disk_vb_del", engine->getEpStats().timingLog);
-    engine->getEpStats().diskVBDelHisto.add(wallTime);
-    atomic_setIfBigger(engine->getEpStats().vbucketDelMaxWalltime,
-                       hrtime_t(wallTime.count()));
-    engine->getEpStats().vbucketDelTotWalltime.fetch_add(wallTime.count());
-
-    if (vbucket->getDeferredDeletionCookie()) {
-        engine->notifyIOComplete(vbucket->getDeferredDeletionCookie(),
-                                 ENGINE_SUCCESS);
+
+    if (!diskDeletionComplete) {
+        notifyAllPendingConnsFailed(false);
+
+        auto start = ProcessClock::now();
+        shard.getRWUnderlying()->delVBucket(vbucket->getId(),
+                                            vbDeleteRevision);
+        auto elapsed = ProcessClock::now() - start;
+        auto wallTime =
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+
+        engine->getEpStats().vbucketDeletions++;
+        BlockTimer::log(elapsed, "disk_vb_del", engine->getEpStats().timingLog);
+        engine->getEpStats().diskVBDelHisto.add(wallTime);
+        atomic_setIfBigger(engine->getEpStats().vbucketDelMaxWalltime,
+                           hrtime_t(wallTime.count()));
+        engine->getEpStats().vbucketDelTotWalltime.fetch_add(wallTime.count());
+
+        if (vbucket->getDeferredDeletionCookie()) {
+            engine->notifyIOComplete(vbucket->getDeferredDeletionCookie(),
+                                     ENGINE_SUCCESS);
+        }
+        diskDeletionComplete = true;
+    }
+
+    // As for the memory-only variant, reclaim the hash table in budgeted
+    // batches rather than in one go.
+    if (vbucket->ht.clearBudgeted(reclaimBudget) == reclaimBudget) {
+        snooze(0);
+        return true;
     }
 
     return false;
@@ -27,6 +27,11 @@ class EPVBucket;
  * for clearing all the VBucket's pending operations and for deleting the
  * VBucket (via a smart pointer).
  *
+ * The VBucket's hash table is reclaimed in budgeted batches, with the task
+ * re-scheduling itself until the table is empty, so that tearing down a
+ * multi-million item vbucket (e.g. during rebalance-out) doesn't hog the
+ * thread and the allocator in a single long run.
+ *
  * This task is designed to be invoked only when the VBucket has no owners.
  */
 class VBucketMemoryDeletionTask : public GlobalTask {
@@ -55,6 +60,12 @@ protected:
      */
     void notifyAllPendingConnsFailed(bool notifyIfCookieSet);
 
+    /**
+     * Maximum number of StoredValues to free from the hash table per run of
+     * the task; when the budget is exhausted the task re-schedules itself.
+     */
+    static const size_t reclaimBudget;
+
     /**
      * The vbucket we are deleting is stored in a unique_ptr for RAII deletion
      * once this task is finished and itself deleted, the VBucket will be
@@ -62,6 +73,10 @@ protected:
      */
     std::unique_ptr<VBucket> vbucket;
     std::string description;
+
+    /// Set once the pending operations/cookie have been notified, so that
+    /// subsequent (budgeted reclamation) runs don't notify again.
+    bool pendingConnsNotified;
 };
 
 /*
@@ -91,4 +106,8 @@ public:
 protected:
     KVShard& shard;
     uint64_t vbDeleteRevision;
+
+    /// Set once the disk file has been removed, so that subsequent (budgeted
+    /// reclamation) runs skip the disk phase.
+    bool diskDeletionComplete;
 };
@@ -18,6 +18,7 @@
 #include "warmup.h"
 
 #include "checkpoint.h"
+#include "checkpoint_config.h"
 #include "common.h"
 #include "connmap.h"
 #include "ep_engine.h"
@@ -27,9 +28,12 @@
 #include "statwriter.h"
 #include "vbucket_bgfetch_item.h"
 
+#include <cJSON_utils.h>
 #include <platform/make_unique.h>
 #include <platform/timeutils.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <limits>
 #include <string>
 #include <utility>
@@ -150,11 +154,13 @@ private:
 
 class WarmupKeyDump : public GlobalTask {
 public:
-    WarmupKeyDump(KVBucket& st, uint16_t sh, Warmup* w)
+    WarmupKeyDump(KVBucket& st, uint16_t sh, uint16_t vb, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupKeyDump, 0, false),
           _shardId(sh),
+          _vbid(vb),
           _warmup(w),
-          _description("Warmup - key dump: shard " + std::to_string(_shardId)) {
+          _description("Warmup - key dump: vb:" + std::to_string(_vbid) +
+                       " (shard " + std::to_string(_shardId) + ")") {
         _warmup->addToTaskSet(uid);
     }
 
@@ -163,7 +169,7 @@ public:
     }
 
     std::chrono::microseconds maxExpectedDuration() {
-        // Runtime is a function of the number of keys in the database; can be
+        // Runtime is a function of the number of keys in the vBucket; can be
         // many minutes in large datasets.
         // Given this large variation; set max duration to a "way out" value
         // which we don't expect to see.
@@ -171,14 +177,15 @@ public:
     }
 
     bool run() {
-        TRACE_EVENT1("ep-engine/task", "WarmupKeyDump", "shard", _shardId);
-        _warmup->keyDumpforShard(_shardId);
+        TRACE_EVENT1("ep-engine/task", "WarmupKeyDump", "vb", _vbid);
+        _warmup->keyDumpForVBucket(_shardId, _vbid);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    uint16_t _vbid;
     Warmup* _warmup;
     const std::string _description;
 };
@@ -252,12 +259,14 @@ private:
 
 class WarmupLoadingKVPairs : public GlobalTask {
 public:
-    WarmupLoadingKVPairs(KVBucket& st, uint16_t sh, Warmup* w)
+    WarmupLoadingKVPairs(KVBucket& st, uint16_t sh, uint16_t vb, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingKVPairs, 0, false),
           _shardId(sh),
+          _vbid(vb),
           _warmup(w),
-          _description("Warmup - loading KV Pairs: shard " +
-                       std::to_string(_shardId)) {
+          _description("Warmup - loading KV Pairs: vb:" +
+                       std::to_string(_vbid) + " (shard " +
+                       std::to_string(_shardId) + ")") {
         _warmup->addToTaskSet(uid);
     }
 
@@ -275,26 +284,28 @@ public:
     }
 
     bool run() {
-        TRACE_EVENT0("ep-engine/task", "WarmupLoadingKVPairs");
-        _warmup->loadKVPairsforShard(_shardId);
+        TRACE_EVENT1("ep-engine/task", "WarmupLoadingKVPairs", "vb", _vbid);
+        _warmup->loadKVPairsForVBucket(_shardId, _vbid);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    uint16_t _vbid;
     Warmup* _warmup;
     const std::string _description;
 };
 
 class WarmupLoadingData : public GlobalTask {
 public:
-    WarmupLoadingData(KVBucket& st, uint16_t sh, Warmup* w) :
+    WarmupLoadingData(KVBucket& st, uint16_t sh, uint16_t vb, Warmup* w) :
         GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingData, 0, false),
         _shardId(sh),
+        _vbid(vb),
         _warmup(w),
-        _description("Warmup - loading data: shard " +
-                     std::to_string(_shardId)) {
+        _description("Warmup - loading data: vb:" + std::to_string(_vbid) +
+                     " (shard " + std::to_string(_shardId) + ")") {
         _warmup->addToTaskSet(uid);
     }
 
@@ -312,14 +323,15 @@ public:
     }
 
     bool run() {
-        TRACE_EVENT0("ep-engine/task", "WarmupLoadingData");
-        _warmup->loadDataforShard(_shardId);
+        TRACE_EVENT1("ep-engine/task", "WarmupLoadingData", "vb", _vbid);
+        _warmup->loadDataForVBucket(_shardId, _vbid);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    uint16_t _vbid;
     Warmup* _warmup;
     const std::string _description;
 };
@@ -644,7 +656,7 @@ void LoadStorageKVPairCallback::callback(GetValue &val) {
         // cancel remaining data dumps from couchstore
         if (epstore.getWarmup()->setComplete()) {
             epstore.getWarmup()->setWarmupTime();
-            epstore.warmupCompleted();
+            epstore.getWarmup()->enableTraffic();
             LOG(EXTENSION_LOG_NOTICE, "Warmup completed in %s",
                 cb::time2text(std::chrono::nanoseconds(
                         epstore.getWarmup()->getTime())).c_str());
@@ -735,12 +747,15 @@ Warmup::Warmup(KVBucket& st, Configuration& config_)
       config(config_),
       shardVbStates(store.vbMap.getNumShards()),
       threadtask_count(0),
+      threadtask_total(0),
       shardKeyDumpStatus(store.vbMap.getNumShards()),
       shardVbIds(store.vbMap.getNumShards()),
       estimatedItemCount(std::numeric_limits<size_t>::max()),
+      snapshotRestoredVbs(0),
       cleanShutdown(true),
       corruptAccessLog(false),
       warmupComplete(false),
+      trafficEnabled(false),
       warmupOOMFailure(false),
       estimatedWarmupCount(std::numeric_limits<size_t>::max()),
       createVBucketsComplete(false) {
@@ -812,12 +827,33 @@ void Warmup::initialize()
     }
 
     populateShardVbStates();
+
+    if (cleanShutdown && config.isWarmupShutdownSnapshot() &&
+        store.getItemEvictionPolicy() == VALUE_ONLY) {
+        std::map<uint16_t, uint64_t> highSeqnos;
+        for (const auto& shard : shardVbStates) {
+            for (const auto& entry : shard) {
+                highSeqnos[entry.first] = uint64_t(entry.second.highSeqno);
+            }
+        }
+        auto snapshot = std::make_unique<ShutdownSnapshot>(config.getDbname());
+        size_t restorable = snapshot->open(highSeqnos);
+        if (restorable > 0) {
+            LOG(EXTENSION_LOG_NOTICE,
+                "Warmup::initialize: shutdown snapshot validated for %zu "
+                "vbuckets; their metadata will be restored without "
+                "re-scanning the data files", restorable);
+            stateSnapshot = std::move(snapshot);
+        }
+    }
+
     transition(WarmupState::CreateVBuckets);
 }
 
 void Warmup::scheduleCreateVBuckets()
 {
     threadtask_count = 0;
+    threadtask_total = store.vbMap.shards.size();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = std::make_shared<WarmupCreateVBuckets>(store, i, this);
         ExecutorPool::get()->schedule(task);
@@ -871,6 +907,22 @@ void Warmup::createVBuckets(uint16_t shardId) {
                 }
             }
 
+            if (config.isBfilterEnabled() && cleanShutdown) {
+                // A filter persisted at the previous clean shutdown covers
+                // everything in the file, so restore it and serve cheap
+                // negative lookups from the first request. After an unclean
+                // shutdown the persisted copy may predate later mutations
+                // (which would give dangerous false negatives), so it is
+                // ignored and the filter rebuilt by the next compaction as
+                // before.
+                std::string filterData =
+                        store.getROUnderlyingByShard(shardId)->loadBloomFilter(
+                                vbid);
+                if (!filterData.empty()) {
+                    vb->restoreFilter(filterData);
+                }
+            }
+
             store.vbMap.addBucket(vb);
         }
 
@@ -885,7 +937,7 @@ void Warmup::createVBuckets(uint16_t shardId) {
         vb->setPersistenceSeqno(vbs.highSeqno);
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == threadtask_total) {
         processCreateVBucketsComplete();
         transition(WarmupState::EstimateDatabaseItemCount);
     }
@@ -921,6 +973,7 @@ bool Warmup::shouldSetVBStateBlock(const void* cookie) {
 void Warmup::scheduleEstimateDatabaseItemCount()
 {
     threadtask_count = 0;
+    threadtask_total = store.vbMap.shards.size();
     estimateTime.store(ProcessClock::duration::zero());
     estimatedItemCount = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
@@ -948,7 +1001,7 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
     estimatedItemCount.fetch_add(item_count);
     estimateTime.fetch_add(ProcessClock::now() - st);
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == threadtask_total) {
         if (store.getItemEvictionPolicy() == VALUE_ONLY) {
             transition(WarmupState::KeyDump);
         } else {
@@ -959,38 +1012,58 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
 
 void Warmup::scheduleKeyDump()
 {
+    // One task per vBucket rather than one per shard: the scans are then
+    // spread across the whole reader pool, so the phase is bounded by
+    // aggregate disk bandwidth rather than by the slowest shard's serial
+    // scan of its vBuckets.
     threadtask_count = 0;
+    threadtask_total = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupKeyDump>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        threadtask_total += shardVbIds[i].size();
+        // A shard with no vBuckets has trivially dumped all of its keys.
+        if (shardVbIds[i].empty()) {
+            shardKeyDumpStatus[i] = true;
+        }
+    }
+    if (threadtask_total == 0) {
+        transition(WarmupState::CheckForAccessLog);
+        return;
+    }
+    for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
+        for (const auto vbid : shardVbIds[i]) {
+            ExTask task = std::make_shared<WarmupKeyDump>(store, i, vbid, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
-
 }
 
-void Warmup::keyDumpforShard(uint16_t shardId)
+void Warmup::keyDumpForVBucket(uint16_t shardId, uint16_t vbid)
 {
     KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, false, state.getState());
     auto cl = std::make_shared<NoLookupCallback>();
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    if (stateSnapshot && stateSnapshot->restoreVBucket(vbid, *cb)) {
+        // Metadata replayed from the clean-shutdown snapshot; the disk
+        // scan is not needed for this vbucket.
+        ++snapshotRestoredVbs;
+    } else {
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     ValueFilter::KEYS_ONLY);
         if (ctx) {
-            auto errorCode = kvstore->scan(ctx);
+            // A scan_again (ENGINE_ENOMEM) result is not a failure here; the
+            // memory limit was reached, the remaining vBucket scans will
+            // observe the same and abort equally quickly.
+            kvstore->scan(ctx);
             kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
         }
     }
 
     shardKeyDumpStatus[shardId] = true;
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == threadtask_total) {
         bool success = false;
         for (size_t i = 0; i < store.vbMap.getNumShards(); i++) {
             if (shardKeyDumpStatus[i]) {
@@ -1026,7 +1099,18 @@ void Warmup::checkForAccessLog()
     LOG(EXTENSION_LOG_NOTICE, "metadata loaded in %s",
         cb::time2text(std::chrono::nanoseconds(metadata.load())).c_str());
 
-    if (store.maybeEnableTraffic()) {
+    if (config.isWarmupBackgroundFill()) {
+        // Availability-first mode: open up for front-end traffic as soon
+        // as the metadata is loaded. The load phases below carry on
+        // filling the cache in the background; any key which live traffic
+        // has faulted in before the loader reaches it is skipped by
+        // HashTable::insertFromWarmup (counted in ep_warmup_dups).
+        if (enableTraffic()) {
+            LOG(EXTENSION_LOG_NOTICE,
+                "warmup: traffic enabled after metadata load; continuing "
+                "to load items in the background");
+        }
+    } else if (store.maybeEnableTraffic()) {
         transition(WarmupState::Done);
     }
 
@@ -1055,6 +1139,7 @@ void Warmup::checkForAccessLog()
 void Warmup::scheduleLoadingAccessLog()
 {
     threadtask_count = 0;
+    threadtask_total = store.vbMap.shards.size();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = std::make_shared<WarmupLoadAccessLog>(store, i, this);
         ExecutorPool::get()->schedule(task);
@@ -1112,7 +1197,7 @@ void Warmup::loadingAccessLog(uint16_t shardId)
         setEstimatedWarmupCount(estimatedCount);
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == threadtask_total) {
         if (!store.maybeEnableTraffic()) {
             transition(WarmupState::LoadingData);
         } else {
@@ -1177,17 +1262,26 @@ void Warmup::scheduleLoadingKVPairs()
     setEstimatedWarmupCount(estimatedItemCount);
 
     threadtask_count = 0;
+    threadtask_total = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingKVPairs>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        threadtask_total += shardVbIds[i].size();
+    }
+    if (threadtask_total == 0) {
+        transition(WarmupState::Done);
+        return;
+    }
+    for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
+        for (const auto vbid : shardVbIds[i]) {
+            ExTask task =
+                    std::make_shared<WarmupLoadingKVPairs>(store, i, vbid, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
-
 }
 
-void Warmup::loadKVPairsforShard(uint16_t shardId)
+void Warmup::loadKVPairsForVBucket(uint16_t shardId, uint16_t vbid)
 {
     bool maybe_enable_traffic = false;
-    scan_error_t errorCode = scan_success;
 
     if (store.getItemEvictionPolicy() == FULL_EVICTION) {
         maybe_enable_traffic = true;
@@ -1199,20 +1293,17 @@ void Warmup::loadKVPairsforShard(uint16_t shardId)
     auto cl =
             std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    ValueFilter::VALUES_DECOMPRESSED);
-        if (ctx) {
-            errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
-        }
-    }
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
+                                                DocumentFilter::NO_DELETES,
+                                                ValueFilter::VALUES_DECOMPRESSED);
+    if (ctx) {
+        // A scan_again (ENGINE_ENOMEM) result simply means the memory
+        // limit was reached; the remaining vBucket scans will observe the
+        // same and abort equally quickly.
+        kvstore->scan(ctx);
+        kvstore->destroyScanContext(ctx);
+    }
+    if (++threadtask_count == threadtask_total) {
         transition(WarmupState::Done);
     }
 }
@@ -1223,37 +1314,43 @@ void Warmup::scheduleLoadingData()
     setEstimatedWarmupCount(estimatedCount);
 
     threadtask_count = 0;
+    threadtask_total = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingData>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        threadtask_total += shardVbIds[i].size();
+    }
+    if (threadtask_total == 0) {
+        transition(WarmupState::Done);
+        return;
+    }
+    for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
+        for (const auto vbid : shardVbIds[i]) {
+            ExTask task =
+                    std::make_shared<WarmupLoadingData>(store, i, vbid, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
-void Warmup::loadDataforShard(uint16_t shardId)
+void Warmup::loadDataForVBucket(uint16_t shardId, uint16_t vbid)
 {
-    scan_error_t errorCode = scan_success;
-
     KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, true, state.getState());
     auto cl =
             std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    ValueFilter::VALUES_DECOMPRESSED);
-        if (ctx) {
-            errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
-        }
+    ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
+                                                DocumentFilter::NO_DELETES,
+                                                ValueFilter::VALUES_DECOMPRESSED);
+    if (ctx) {
+        // A scan_again (ENGINE_ENOMEM) result simply means the memory
+        // limit was reached; the remaining vBucket scans will observe the
+        // same and abort equally quickly.
+        kvstore->scan(ctx);
+        kvstore->destroyScanContext(ctx);
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == threadtask_total) {
         transition(WarmupState::Done);
     }
 }
@@ -1263,16 +1360,135 @@ void Warmup::scheduleCompletion() {
     ExecutorPool::get()->schedule(task);
 }
 
+/**
+ * Visitor which collects the items with seqnos after a given start seqno
+ * from a fully-loaded HashTable, so that the open checkpoint can be rebuilt
+ * at the end of warmup. If an item in the window cannot be restored
+ * faithfully (it is deleted, or its value is not resident) the collection
+ * is marked invalid and the scan stops.
+ */
+class StreamWindowCollector : public HashTableVisitor {
+public:
+    StreamWindowCollector(int64_t startSeqno, uint16_t vbid)
+        : startSeqno(startSeqno), vbid(vbid), valid(true) {
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        if (v.isTempItem() || v.getBySeqno() <= startSeqno) {
+            return true;
+        }
+        if (v.isDeleted() || !v.isResident()) {
+            valid = false;
+            return false;
+        }
+        items.push_back(queued_item(v.toItem(false, vbid).release()));
+        return true;
+    }
+
+    std::vector<queued_item> items;
+    const int64_t startSeqno;
+    const uint16_t vbid;
+    bool valid;
+};
+
+void Warmup::restoreStreamCheckpoints() {
+    const size_t maxWindow =
+            store.getEPEngine().getCheckpointConfig().getCheckpointMaxItems();
+    size_t restoredVbs = 0;
+    size_t restoredItems = 0;
+
+    for (size_t shardId = 0; shardId < shardVbStates.size(); ++shardId) {
+        for (const auto& entry : shardVbStates[shardId]) {
+            const uint16_t vbid = entry.first;
+            const vbucket_state& vbs = entry.second;
+            if (vbs.streamCursors.empty()) {
+                continue;
+            }
+            VBucketPtr vb = store.vbMap.getBucket(vbid);
+            if (!vb) {
+                continue;
+            }
+
+            // The window starts at the lowest persisted cursor position.
+            unique_cJSON_ptr json(cJSON_Parse(vbs.streamCursors.c_str()));
+            if (!json) {
+                continue;
+            }
+            int64_t start = std::numeric_limits<int64_t>::max();
+            for (cJSON* c = json->child; c != nullptr; c = c->next) {
+                if (c->type != cJSON_String) {
+                    start = std::numeric_limits<int64_t>::max();
+                    break;
+                }
+                start = std::min(start,
+                                 int64_t(strtoull(c->valuestring,
+                                                  nullptr, 10)));
+            }
+
+            const int64_t high = vb->getHighSeqno();
+            if (start >= high || high - start > int64_t(maxWindow)) {
+                // Nothing to restore, or every reconnecting client is far
+                // enough behind that a backfill is the better trade-off.
+                continue;
+            }
+
+            StreamWindowCollector collector(start, vbid);
+            vb->ht.visit(collector);
+            if (!collector.valid ||
+                collector.items.size() != size_t(high - start)) {
+                // The window contains deletions, de-duplicated or
+                // non-resident items and cannot be reproduced from the
+                // HashTable; streams will backfill from disk as before.
+                continue;
+            }
+            std::sort(collector.items.begin(),
+                      collector.items.end(),
+                      [](const queued_item& a, const queued_item& b) {
+                          return a->getBySeqno() < b->getBySeqno();
+                      });
+
+            size_t restored = vb->checkpointManager->restoreItemsFromWarmup(
+                    collector.items);
+            if (restored) {
+                ++restoredVbs;
+                restoredItems += restored;
+            }
+        }
+    }
+
+    if (restoredVbs) {
+        LOG(EXTENSION_LOG_NOTICE,
+            "Warmup restored %" PRIu64 " checkpoint item(s) across %" PRIu64
+            " vbucket(s) for stream resumption",
+            uint64_t(restoredItems), uint64_t(restoredVbs));
+    }
+}
+
 void Warmup::done()
 {
     if (setComplete()) {
         setWarmupTime();
-        store.warmupCompleted();
+        // Rebuild the recent seqno window in the open checkpoints before
+        // traffic (and hence DCP reconnections) is enabled.
+        restoreStreamCheckpoints();
+        // No-op if traffic was already enabled after the metadata load
+        // (warmup_background_fill).
+        enableTraffic();
         LOG(EXTENSION_LOG_NOTICE, "warmup completed in %s",
             cb::time2text(std::chrono::nanoseconds(warmup.load())).c_str());
     }
 }
 
+bool Warmup::enableTraffic()
+{
+    bool inverse = false;
+    if (trafficEnabled.compare_exchange_strong(inverse, true)) {
+        store.warmupCompleted();
+        return true;
+    }
+    return false;
+}
+
 void Warmup::step() {
     switch (state.getState()) {
         case WarmupState::Initialize:
@@ -1344,6 +1560,12 @@ void Warmup::addStats(ADD_STAT add_stat, const void *c) const
         addStat("thread", "running", add_stat, c);
     }
     addStat("key_count", stats.warmedUpKeys, add_stat, c);
+    if (snapshotRestoredVbs > 0) {
+        addStat("snapshot_restored_vbuckets",
+                snapshotRestoredVbs.load(),
+                add_stat,
+                c);
+    }
     addStat("value_count", stats.warmedUpValues, add_stat, c);
     addStat("dups", stats.warmDups, add_stat, c);
     addStat("oom", stats.warmOOM, add_stat, c);
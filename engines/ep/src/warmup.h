@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "callbacks.h"
+#include "shutdown_snapshot.h"
 #include "utility.h"
 
 #include <atomic>
@@ -156,6 +157,26 @@ public:
         return warmupComplete.compare_exchange_strong(inverse, true);
     }
 
+    /**
+     * Has the backfill portion of warmup progressed far enough that the
+     * bucket may accept front-end traffic? Normally this coincides with
+     * isComplete(); with warmup_background_fill it is reached as soon as
+     * the vbucket metadata has been loaded, while the load phases carry
+     * on filling the cache in the background.
+     */
+    bool isTrafficEnabled() const {
+        return trafficEnabled.load();
+    }
+
+    /**
+     * Mark the traffic-enable point as reached and perform the one-off
+     * post-warmup work (see KVBucket::warmupCompleted).
+     *
+     * @return true if this call moved warmup past the traffic-enable
+     *         point, false if it had already been passed.
+     */
+    bool enableTraffic();
+
     /**
      * Method checks with if a setVBState should block. setVBState should be
      * blocked until warmup has processed any existing vb state and completed
@@ -182,11 +203,11 @@ public:
     void initialize();
     void createVBuckets(uint16_t shardId);
     void estimateDatabaseItemCount(uint16_t shardId);
-    void keyDumpforShard(uint16_t shardId);
+    void keyDumpForVBucket(uint16_t shardId, uint16_t vbid);
     void checkForAccessLog();
     void loadingAccessLog(uint16_t shardId);
-    void loadKVPairsforShard(uint16_t shardId);
-    void loadDataforShard(uint16_t shardId);
+    void loadKVPairsForVBucket(uint16_t shardId, uint16_t vbid);
+    void loadDataForVBucket(uint16_t shardId, uint16_t vbid);
     void done();
 
 private:
@@ -210,6 +231,18 @@ private:
     void scheduleLoadingData();
     void scheduleCompletion();
 
+    /**
+     * Rebuild the open checkpoint of each vbucket from the loaded
+     * HashTable, covering the window between the lowest stream cursor
+     * position persisted in the vbucket state and the high seqno, so
+     * DCP clients which reconnect after the restart can resume from
+     * memory instead of triggering a disk backfill. Skipped for any
+     * vbucket where the window cannot be reproduced faithfully (e.g.
+     * it contains deletions or non-resident items) or exceeds the
+     * configured checkpoint size.
+     */
+    void restoreStreamCheckpoints();
+
     void transition(int to, bool force=false);
 
     WarmupState state;
@@ -235,6 +268,10 @@ private:
 
     std::vector<std::map<uint16_t, vbucket_state>> shardVbStates;
     std::atomic<size_t> threadtask_count;
+    /// Number of tasks scheduled for the current parallel phase; the last
+    /// task to complete (threadtask_count == threadtask_total) drives the
+    /// transition to the next state.
+    std::atomic<size_t> threadtask_total;
     std::vector<std::atomic<bool>> shardKeyDumpStatus;
 
     /// vector of vectors of VBucket IDs (one vector per shard). Each vector
@@ -243,9 +280,18 @@ private:
 
     cb::AtomicDuration estimateTime;
     std::atomic<size_t> estimatedItemCount;
+    /// Metadata snapshot written by the previous clean shutdown; only set
+    /// when one exists and validated (see ShutdownSnapshot).
+    std::unique_ptr<ShutdownSnapshot> stateSnapshot;
+    /// Number of vbuckets whose metadata was restored from the snapshot
+    /// rather than scanned from disk.
+    std::atomic<size_t> snapshotRestoredVbs;
     bool cleanShutdown;
     bool corruptAccessLog;
     std::atomic<bool> warmupComplete;
+    /// Set once the bucket may accept front-end traffic; precedes
+    /// warmupComplete when warmup_background_fill is enabled.
+    std::atomic<bool> trafficEnabled;
     std::atomic<bool> warmupOOMFailure;
     std::atomic<size_t> estimatedWarmupCount;
 
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <platform/processclock.h>
+
 #include <atomic>
 
 #include <string>
@@ -41,8 +43,13 @@ enum workload_pattern_t {
  */
 class WorkLoadPolicy {
 public:
-    WorkLoadPolicy(int m, int s)
-        : maxNumWorkers(m), maxNumShards(s), workloadPattern(READ_HEAVY) { }
+    WorkLoadPolicy(int m, int s, size_t sh = 100)
+        : maxNumWorkers(m),
+          maxNumShards(s),
+          shares(sh),
+          chargedTime(0),
+          workloadPattern(READ_HEAVY) {
+    }
 
     size_t getNumShards(void) {
         return maxNumShards;
@@ -78,10 +85,33 @@ public:
         workloadPattern.store(pattern);
     }
 
+    size_t getShares(void) const {
+        return shares;
+    }
+
+    /**
+     * Charge CPU time consumed by one of this bucket's tasks. The charge
+     * is scaled inversely to the bucket's configured shares
+     * (executor_shares), so high-share buckets accumulate weighted time
+     * more slowly and hence get to run sooner when competing with other
+     * buckets' tasks of equal priority.
+     */
+    void chargeRunTime(ProcessClock::duration runTime) {
+        chargedTime.fetch_add((uint64_t(runTime.count()) * 100) / shares,
+                              std::memory_order_relaxed);
+    }
+
+    /// Weighted CPU time consumed by this bucket's tasks so far.
+    uint64_t getChargedRunTime(void) const {
+        return chargedTime.load(std::memory_order_relaxed);
+    }
+
 private:
 
     int maxNumWorkers;
     int maxNumShards;
+    size_t shares;
+    std::atomic<uint64_t> chargedTime;
     std::atomic<workload_pattern_t> workloadPattern;
 };
 
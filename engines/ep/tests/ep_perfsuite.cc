@@ -110,6 +110,8 @@ struct Stats {
     double pct5;
     double pct95;
     double pct99;
+    double pct999;
+    double pct9999;
     std::vector<T>* values;
 };
 
@@ -198,17 +200,17 @@ void renderToText(const std::string& name,
     }
 
     printf("\n\n                                Percentile           \n");
-    printf("  %-22s Median     95th     99th  Std Dev  Histogram of samples\n\n", "");
+    printf("  %-22s Median     95th     99th   99.9th  Std Dev  Histogram of samples\n\n", "");
     // Finally, print out each set.
     for (const auto& stats : value_stats) {
         if (stats.median/1e6 < 1) {
-            printf("%-22s %8.03f %8.03f %8.03f %8.03f  ",
+            printf("%-22s %8.03f %8.03f %8.03f %8.03f %8.03f  ",
                     stats.name.c_str(), stats.median/1e3, stats.pct95/1e3,
-                    stats.pct99/1e3, stats.stddev/1e3);
+                    stats.pct99/1e3, stats.pct999/1e3, stats.stddev/1e3);
         } else {
-            printf("%-15s (x1e3) %8.03f %8.03f %8.03f %8.03f  ",
+            printf("%-15s (x1e3) %8.03f %8.03f %8.03f %8.03f %8.03f  ",
                     stats.name.c_str(), stats.median/1e6, stats.pct95/1e6,
-                    stats.pct99/1e6, stats.stddev/1e6);
+                    stats.pct99/1e6, stats.pct999/1e6, stats.stddev/1e6);
         }
 
         // Calculate and render Sparkline (requires UTF-8 terminal).
@@ -263,12 +265,63 @@ void renderToXML(const std::string& name, const std::string& description,
         << "    <testcase name=\"" << name << "." << stats.name
         << ".pct95\" time=\"" << stats.pct95/1e3 << "\" classname=\"ep-perfsuite\"/>\n"
         << "    <testcase name=\"" << name << "." << stats.name
-        << ".pct99\" time=\"" << stats.pct99/1e3 << "\" classname=\"ep-perfsuite\"/>\n";
+        << ".pct99\" time=\"" << stats.pct99/1e3 << "\" classname=\"ep-perfsuite\"/>\n"
+        << "    <testcase name=\"" << name << "." << stats.name
+        << ".pct999\" time=\"" << stats.pct999/1e3 << "\" classname=\"ep-perfsuite\"/>\n"
+        << "    <testcase name=\"" << name << "." << stats.name
+        << ".pct9999\" time=\"" << stats.pct9999/1e3 << "\" classname=\"ep-perfsuite\"/>\n";
     }
     file << "  </testsuite>\n";
     file << "</testsuites>\n";
 }
 
+// Render the specified value stats in JSON, to a file named after the test.
+// Unlike the XML output (which only carries what the CBNT harness consumes)
+// this includes the full set of computed metrics plus the sample count, for
+// consumption by external trending / analysis tools.
+template<typename T>
+void renderToJSON(const std::string& name, const std::string& description,
+                  const std::vector<Stats<T> >& value_stats,
+                  const std::string& unit) {
+    std::string test_name = testHarness.output_file_prefix;
+    test_name += name;
+    std::ofstream file(test_name + ".json");
+
+    time_t now;
+    time(&now);
+    char timebuf[256];
+    // Ideally would use 'put_time' here, but it is not supported until GCC 5
+    strftime(timebuf, sizeof timebuf, "%FT%T%z\0", gmtime(&now));
+
+    file << "{\n"
+         << "  \"testsuite\": \"ep-perfsuite\",\n"
+         << "  \"name\": \"" << name << "\",\n"
+         << "  \"description\": \"" << description << "\",\n"
+         << "  \"unit\": \"" << unit << "\",\n"
+         << "  \"timestamp\": \"" << timebuf << "\",\n"
+         << "  \"stats\": [";
+
+    bool first = true;
+    for (const auto& stats : value_stats) {
+        if (!first) {
+            file << ",";
+        }
+        first = false;
+        file << "\n    {\"name\": \"" << stats.name << "\", "
+             << "\"samples\": " << stats.values->size() << ", "
+             << "\"mean\": " << stats.mean/1e3 << ", "
+             << "\"median\": " << stats.median/1e3 << ", "
+             << "\"stddev\": " << stats.stddev/1e3 << ", "
+             << "\"pct5\": " << stats.pct5/1e3 << ", "
+             << "\"pct95\": " << stats.pct95/1e3 << ", "
+             << "\"pct99\": " << stats.pct99/1e3 << ", "
+             << "\"pct99_9\": " << stats.pct999/1e3 << ", "
+             << "\"pct99_99\": " << stats.pct9999/1e3 << "}";
+    }
+    file << "\n  ]\n"
+         << "}\n";
+}
+
 // Given a vector of values (each a vector<T>) calculate metrics on them
 // and print in the format specified by {testharness.output_format}.
 template<typename T>
@@ -294,6 +347,8 @@ void output_result(const std::string& name,
         stats.pct5 = vec[(vec.size() * 5) / 100];
         stats.pct95 = vec[(vec.size() * 95) / 100];
         stats.pct99 = vec[(vec.size() * 99) / 100];
+        stats.pct999 = vec[(vec.size() * 999) / 1000];
+        stats.pct9999 = vec[(vec.size() * 9999) / 10000];
 
         const double sum = std::accumulate(vec.begin(), vec.end(), 0.0);
         stats.mean = sum / vec.size();
@@ -315,6 +370,10 @@ void output_result(const std::string& name,
     case OutputFormat::XML:
         renderToXML(new_name, description, value_stats, unit);
         break;
+
+    case OutputFormat::JSON:
+        renderToJSON(new_name, description, value_stats, unit);
+        break;
     }
 }
 /* Add a sentinel document (one with a the key SENTINEL_KEY).
@@ -1112,6 +1171,94 @@ static enum test_result perf_latency_dcp_impact(ENGINE_HANDLE *h,
     return result;
 }
 
+/* Benchmark the sustained rate at which a DCP client can drain the bucket -
+ * i.e. streaming throughput, as opposed to the per-mutation latency measured
+ * by the DCP latency tests above. The bucket is populated once, then fully
+ * streamed a number of times, reporting the drain time and item throughput
+ * of each pass.
+ */
+static enum test_result perf_dcp_throughput(ENGINE_HANDLE *h,
+                                            ENGINE_HANDLE_V1 *h1) {
+    const size_t item_count = ITERATIONS / 10;
+    const int num_runs = 5;
+
+    std::vector<hrtime_t> insert_times;
+    perf_load_client(h, h1, /*vbid*/0, item_count, Doc_format::JSON_PADDED,
+                     insert_times);
+
+    std::vector<hrtime_t> drain_times;
+    std::vector<hrtime_t> throughputs;
+    for (int run = 0; run < num_runs; run++) {
+        std::vector<hrtime_t> recv_times;
+        std::vector<size_t> bytes_received;
+        const auto start = ProcessClock::now();
+        perf_dcp_client(h, h1, item_count,
+                        "dcp_throughput_" + std::to_string(run),
+                        /*opaque*/0xEFFFFF00 + run, /*vb*/0,
+                        /*compressed*/false, recv_times, bytes_received);
+        const auto end = ProcessClock::now();
+        const hrtime_t duration = (end - start).count();
+        drain_times.push_back(duration);
+        // Scaled by 1000 as output_result renders values divided by 1e3.
+        throughputs.push_back((item_count * 1000000000ull * 1000ull) /
+                              duration);
+    }
+
+    std::string description("DCP Throughput - " + std::to_string(item_count) +
+                            " items");
+    std::vector<std::pair<std::string, std::vector<hrtime_t>*> > all_timings;
+    all_timings.push_back(std::make_pair("Drain", &drain_times));
+    output_result("DCP Throughput drain", description, all_timings, "µs");
+
+    std::vector<std::pair<std::string, std::vector<hrtime_t>*> > all_rates;
+    all_rates.push_back(std::make_pair("Throughput", &throughputs));
+    output_result("DCP Throughput rate", description, all_rates, "items/s");
+
+    return SUCCESS;
+}
+
+/* Benchmark how long the bucket takes to warm up - the time from engine
+ * restart until the in-memory state has been repopulated from disk and the
+ * bucket reports warmup complete. Reported via the engine's own
+ * ep_warmup_time stat (measured in µs), taken over a number of restarts of
+ * the same on-disk data set.
+ */
+static enum test_result perf_warmup(ENGINE_HANDLE *h,
+                                    ENGINE_HANDLE_V1 *h1) {
+    if (!isWarmupEnabled(h, h1)) {
+        return SKIPPED;
+    }
+
+    const size_t item_count = ITERATIONS / 10;
+    const int num_runs = 5;
+
+    std::vector<hrtime_t> insert_times;
+    perf_load_client(h, h1, /*vbid*/0, item_count, Doc_format::JSON_PADDED,
+                     insert_times);
+
+    std::vector<hrtime_t> warmup_times;
+    for (int run = 0; run < num_runs; run++) {
+        testHarness.reload_engine(&h, &h1,
+                                  testHarness.engine_path,
+                                  testHarness.get_current_testcase()->cfg,
+                                  true, false);
+        wait_for_warmup_complete(h, h1);
+        // ep_warmup_time is in µs; scale to ns for consistency with the
+        // other tests in this suite (output_result renders values /1e3).
+        warmup_times.push_back(
+                hrtime_t(get_int_stat(h, h1, "ep_warmup_time", "warmup")) *
+                1000);
+    }
+
+    std::string description("Warmup - " + std::to_string(item_count) +
+                            " items (µs)");
+    std::vector<std::pair<std::string, std::vector<hrtime_t>*> > all_timings;
+    all_timings.push_back(std::make_pair("Warmup", &warmup_times));
+    output_result("Warmup", description, all_timings, "µs");
+
+    return SUCCESS;
+}
+
 static void perf_stat_latency_core(ENGINE_HANDLE *h,
                                    ENGINE_HANDLE_V1 *h1,
                                    int key_prefix,
@@ -1360,6 +1507,16 @@ BaseTestCase testsuite_testcases[] = {
                  "backend=couchdb;ht_size=393209",
                  prepare, cleanup),
 
+        TestCase("DCP throughput", perf_dcp_throughput,
+                 test_setup, teardown,
+                 "backend=couchdb;ht_size=393209",
+                 prepare, cleanup),
+
+        TestCase("Warmup time", perf_warmup,
+                 test_setup, teardown,
+                 "backend=couchdb;ht_size=393209",
+                 prepare, cleanup),
+
         TestCase("Baseline Stat latency", perf_stat_latency_baseline,
                  test_setup, teardown,
                  "backend=couchdb;ht_size=393209",
@@ -1325,6 +1325,46 @@ static enum test_result test_get_replica_non_resident(ENGINE_HANDLE *h,
     return SUCCESS;
 }
 
+static enum test_result test_get_replica_with_token(ENGINE_HANDLE *h,
+                                                    ENGINE_HANDLE_V1 *h1) {
+    item *i = NULL;
+    checkeq(ENGINE_SUCCESS,
+            store(h, h1, NULL, OPERATION_SET, "k0", "replicadata", &i, 0, 0),
+            "Store Failed");
+    h1->release(h, NULL, i);
+    check(set_vbucket_state(h, h1, 0, vbucket_state_replica),
+          "Failed to set vbucket to replica");
+
+    // Request flag 0x01 asks for the failover token in the response
+    // extras.
+    char ext = 0x01;
+    protocol_binary_request_header *pkt =
+        createPacket(PROTOCOL_BINARY_CMD_GET_REPLICA, 0, 0, &ext, 1, "k0", 2);
+    checkeq(ENGINE_SUCCESS,
+            h1->unknown_command(
+                    h, NULL, pkt, add_response, testHarness.doc_namespace),
+            "Get Replica Failed");
+    cb_free(pkt);
+    checkeq(PROTOCOL_BINARY_RESPONSE_SUCCESS, last_status.load(),
+            "Expected PROTOCOL_BINARY_RESPONSE_SUCCESS response.");
+    checkeq(std::string("replicadata"), last_body,
+            "Should have returned identical value");
+
+    // Extras: 4 byte item flags followed by the failover UUID and the
+    // high seqno.
+    checkeq(size_t{20}, last_ext.size(), "Unexpected extras length");
+    uint64_t uuid;
+    uint64_t seqno;
+    memcpy(&uuid, last_ext.data() + 4, sizeof(uuid));
+    memcpy(&seqno, last_ext.data() + 12, sizeof(seqno));
+    checkeq(get_ull_stat(h, h1, "vb_0:0:id", "failovers"), ntohll(uuid),
+            "Token UUID should match the vbucket's latest failover UUID");
+    checkeq(uint64_t{1}, ntohll(seqno),
+            "Token seqno should match the vbucket's high seqno");
+
+    return SUCCESS;
+}
+
 static enum test_result test_get_replica_invalid_key(ENGINE_HANDLE *h,
                                                      ENGINE_HANDLE_V1 *h1) {
     protocol_binary_request_header *pkt;
@@ -2103,6 +2143,18 @@ static enum test_result test_io_stats(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
             get_int_stat(h, h1, "rw_0:io_write_bytes", "kvstore"),
             "Expected reading the value back in to not update the write bytes");
 
+    // The detail group should see the same logical write volume, and a
+    // non-zero physical volume at least as large (the flush also wrote
+    // index nodes and a header).
+    checkeq(exp_write_bytes,
+            get_int_stat(h, h1, "rw_0:io_logical_write_bytes",
+                         "kvstore-detail"),
+            "Expected the logical write bytes to match io_write_bytes");
+    checkge(get_int_stat(h, h1, "rw_0:io_physical_write_bytes",
+                         "kvstore-detail"),
+            exp_write_bytes,
+            "Expected the physical write bytes to cover the logical bytes");
+
     return SUCCESS;
 }
 
@@ -6471,6 +6523,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_defragmenter_chunk_duration",
                 "ep_defragmenter_enabled",
                 "ep_defragmenter_interval",
+                "ep_defragmenter_utilization_floor",
                 "ep_enable_chk_merge",
                 "ep_enable_dcp_consumer_snappy_compression",
                 "ep_exp_pager_enabled",
@@ -6650,6 +6703,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_defragmenter_chunk_duration",
                 "ep_defragmenter_enabled",
                 "ep_defragmenter_interval",
+                "ep_defragmenter_utilization_floor",
                 "ep_defragmenter_num_moved",
                 "ep_defragmenter_num_visited",
                 "ep_degraded_mode",
@@ -7510,6 +7564,9 @@ BaseTestCase testsuite_testcases[] = {
         TestCase("replica read: invalid state - dead",
                  test_get_replica_dead_state,
                  test_setup, teardown, NULL, prepare, cleanup),
+        TestCase("replica read: with failover token",
+                 test_get_replica_with_token,
+                 test_setup, teardown, NULL, prepare, cleanup),
         TestCase("replica read: invalid key", test_get_replica_invalid_key,
                  test_setup, teardown, NULL, prepare, cleanup),
         TestCase("test getr with evicted key",
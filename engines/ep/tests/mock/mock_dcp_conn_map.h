@@ -32,7 +32,7 @@ public:
         return deadConnections.size();
     }
 
-    AtomicQueue<connection_t>& getPendingNotifications() {
+    std::vector<connection_t>& getPendingNotifications() {
         return pendingNotifications;
     }
 
@@ -264,5 +264,10 @@ public:
         return buffer.messages.size();
     }
 
+    uint32_t public_coalesceSnapshotMarkers(
+            std::deque<std::unique_ptr<DcpResponse>>& batch) {
+        return coalesceSnapshotMarkers(batch);
+    }
+
     uint32_t responseMessageSize;
 };
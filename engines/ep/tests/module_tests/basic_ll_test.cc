@@ -498,6 +498,10 @@ TEST_F(BasicLinkedListTest, MarkStale) {
         EXPECT_TRUE(nonOwnedSvPtr->isStale(writeGuard));
     }
 
+    /* The stale flag must also be visible via the lock-free check used by
+       the range read path */
+    EXPECT_TRUE(nonOwnedSvPtr->isStaleNoLock());
+
     /* Check if the stale count incremented to 1 */
     EXPECT_EQ(1, basicLL->getNumStaleItems());
 
@@ -859,6 +863,69 @@ TEST_F(BasicLinkedListTest, PurgeBeyondLast) {
     EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
 }
 
+/* Purge a run of stale items with a batch size smaller than the number of
+   stale items; all of them must still be unlinked, over multiple batches */
+TEST_F(BasicLinkedListTest, PurgeWithSmallBatchSize) {
+    const int numItems = 2;
+    const std::string keyPrefix("key");
+
+    /* Add 2 new items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    /* Add 5 stale items */
+    const int numPurgeItems = 5;
+    for (int i = 1; i <= numPurgeItems; ++i) {
+        addStaleItem("stale" + std::to_string(i), numItems + i);
+    }
+    ASSERT_EQ(numItems + numPurgeItems, basicLL->getNumItems());
+    ASSERT_EQ(numPurgeItems, basicLL->getNumStaleItems());
+
+    /* Purge with a batch size of 2; needs multiple lock acquisitions */
+    EXPECT_EQ(numPurgeItems,
+              basicLL->purgeTombstones(
+                      numItems + numPurgeItems,
+                      []() { return false; },
+                      2 /*purgeBatchSize*/));
+    EXPECT_EQ(numItems, basicLL->getNumItems());
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+
+    /* Should be able to add elements to the list after the purger has run */
+    addNewItemsToList(numItems + numPurgeItems + 1 /*startseqno*/,
+                      keyPrefix,
+                      1 /*add one element*/);
+    std::vector<seqno_t> expectedSeqno = {1, 2, 8};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+}
+
+/* Eviction candidates must be picked in order from the front (lowest seqno)
+   of the list, skipping stale and deleted items, and the walk must be
+   resumable from the last examined seqno */
+TEST_F(BasicLinkedListTest, PickEvictionCandidates) {
+    const int numItems = 4;
+    addNewItemsToList(1, "key", numItems);
+    addStaleItem("stale", numItems + 1);
+
+    /* Pick a first batch of candidates from the front of the list */
+    std::vector<StoredDocKey> candidates;
+    seqno_t lastExamined;
+    std::tie(candidates, lastExamined) = basicLL->pickEvictionCandidates(2, 0);
+    ASSERT_EQ(2, candidates.size());
+    EXPECT_EQ(makeStoredDocKey("key1"), candidates[0]);
+    EXPECT_EQ(makeStoredDocKey("key2"), candidates[1]);
+    EXPECT_EQ(2, lastExamined);
+
+    /* Delete key3; deleted items must not be offered as candidates */
+    ht.find(makeStoredDocKey("key3"), TrackReference::No, WantsDeleted::No)
+            ->markDeleted();
+
+    /* Resume the walk; the deleted and stale items are skipped */
+    std::tie(candidates, lastExamined) =
+            basicLL->pickEvictionCandidates(10, lastExamined);
+    ASSERT_EQ(1, candidates.size());
+    EXPECT_EQ(makeStoredDocKey("key4"), candidates[0]);
+    EXPECT_EQ(numItems + 1, lastExamined);
+}
+
 TEST_F(BasicLinkedListTest, UpdateDuringPurge) {
     const int numItems = 2;
     const std::string keyPrefix("key");
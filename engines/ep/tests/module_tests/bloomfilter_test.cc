@@ -80,6 +80,28 @@ TEST_P(BloomFilterDocKeyTest, check_maybeKeyExist) {
     }
 }
 
+TEST_P(BloomFilterDocKeyTest, check_serialize_roundtrip) {
+    auto key1 = StoredDocKey("key", std::get<0>(GetParam()));
+    auto key2 = StoredDocKey("other", std::get<1>(GetParam()));
+    addKey(key1);
+
+    BloomFilter restored(serialize());
+    EXPECT_EQ(BFILTER_ENABLED, restored.getStatus());
+    EXPECT_EQ(getNumOfKeysInFilter(), restored.getNumOfKeysInFilter());
+    EXPECT_EQ(getFilterSize(), restored.getFilterSize());
+    EXPECT_TRUE(restored.maybeKeyExists(key1));
+    EXPECT_EQ(maybeKeyExists(key2), restored.maybeKeyExists(key2));
+}
+
+TEST_P(BloomFilterDocKeyTest, check_serialize_malformed) {
+    EXPECT_THROW(BloomFilter(std::string()), std::invalid_argument);
+    EXPECT_THROW(BloomFilter(std::string("bogus")), std::invalid_argument);
+    // Truncating a valid serialization must also be rejected.
+    std::string data = serialize();
+    data.resize(data.size() - 1);
+    EXPECT_THROW(BloomFilter(data), std::invalid_argument);
+}
+
 static std::vector<DocNamespace> allDocNamespaces = {{DocNamespace::DefaultCollection,
                                                       DocNamespace::Collections,
                                                       DocNamespace::System}};
@@ -779,6 +779,107 @@ TYPED_TEST(CheckpointTest, ItemsForCheckpointCursor) {
     EXPECT_EQ(2 * MIN_CHECKPOINT_ITEMS + 3, items.size());
 }
 
+// Test expelling of already-processed items from a closed checkpoint which
+// still has a (slow) cursor within it.
+TYPED_TEST(CheckpointTest, ExpelCheckpointItems) {
+    /* We want to have items across 2 checkpoints. Size down the default number
+       of items to create a new checkpoint and recreate the manager */
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               MIN_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*enableMerge*/ false,
+                                               /*persistenceEnabled*/ true);
+    this->createManager();
+
+    /* Add items such that we have 2 checkpoints; the first one closed */
+    for (unsigned int ii = 0; ii < 2 * MIN_CHECKPOINT_ITEMS; ii++) {
+        EXPECT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    ASSERT_EQ(2, this->manager->getNumCheckpoints());
+
+    /* Register a DCP cursor at the start of the first (closed) checkpoint */
+    std::string dcp_cursor(DCP_CURSOR_PREFIX + std::to_string(1));
+    this->manager->registerCursorBySeqno(
+            dcp_cursor.c_str(), 1000, MustSendCheckpointEnd::NO);
+
+    /* Nothing can be expelled while the slowest cursor has processed nothing
+       in the checkpoint */
+    EXPECT_EQ(0, this->manager->expelUnreferencedCheckpointItems());
+
+    /* Advance the persistence cursor into the open checkpoint, and the DCP
+       cursor over checkpoint_start plus the first 3 mutations
+       (seqnos 1001-1003) */
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    bool isLastMutationItem;
+    for (unsigned int ii = 0; ii < 4; ii++) {
+        this->manager->nextItem(dcp_cursor.c_str(), isLastMutationItem);
+    }
+
+    /* The mutations before the one the DCP cursor rests on (seqnos 1001 and
+       1002) can now be expelled */
+    const size_t numItemsBefore = this->manager->getNumItems();
+    EXPECT_EQ(2, this->manager->expelUnreferencedCheckpointItems());
+    EXPECT_EQ(numItemsBefore - 2, this->manager->getNumItems());
+
+    /* A second invocation finds nothing further to expel */
+    EXPECT_EQ(0, this->manager->expelUnreferencedCheckpointItems());
+
+    /* The DCP cursor is unaffected - it reads the remaining items of the
+       closed checkpoint and the open checkpoint as normal:
+       (MIN_CHECKPOINT_ITEMS - 3) remaining mutations + checkpoint_end +
+       checkpoint_start + MIN_CHECKPOINT_ITEMS mutations */
+    items.clear();
+    this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    EXPECT_EQ(2 * MIN_CHECKPOINT_ITEMS - 3 + 2, items.size());
+
+    /* A cursor re-registered at a seqno covered by the expelled items must be
+       told to backfill the gap */
+    std::string dcp_cursor2(DCP_CURSOR_PREFIX + std::to_string(2));
+    CursorRegResult result = this->manager->registerCursorBySeqno(
+            dcp_cursor2.c_str(), 1001, MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1003, result.first);
+    EXPECT_TRUE(result.second) << "Backfill expected over the expelled items";
+}
+
+// Test that the open checkpoint item limit adapts to the observed fill and
+// drain rates.
+TYPED_TEST(CheckpointTest, AdaptiveCheckpointMaxItems) {
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               MIN_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*enableMerge*/ false,
+                                               /*persistenceEnabled*/ true);
+    this->createManager();
+    EXPECT_EQ(MIN_CHECKPOINT_ITEMS, this->manager->getOpenCheckpointMaxItems());
+
+    /* Fill the first checkpoint well within the checkpoint period, with the
+       persistence cursor keeping pace (no closed checkpoints outstanding
+       when it closes): the limit should double */
+    unsigned int ii = 0;
+    for (; ii < MIN_CHECKPOINT_ITEMS + 1; ii++) {
+        EXPECT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    EXPECT_EQ(2, this->manager->getNumCheckpoints());
+    EXPECT_EQ(2 * MIN_CHECKPOINT_ITEMS,
+              this->manager->getOpenCheckpointMaxItems());
+
+    /* Move the persistence cursor up to date, then fill the (now larger)
+       open checkpoint. The closed checkpoint left behind means cursors are
+       deemed to be lagging when the next close happens, so the limit decays
+       back to the configured base */
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    for (; ii < 3 * MIN_CHECKPOINT_ITEMS + 1; ii++) {
+        EXPECT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    EXPECT_EQ(MIN_CHECKPOINT_ITEMS, this->manager->getOpenCheckpointMaxItems());
+}
+
 // Test the checkpoint cursor movement
 TYPED_TEST(CheckpointTest, CursorMovement) {
     /* We want to have items across 2 checkpoints. Size down the default number
@@ -1094,6 +1195,65 @@ TYPED_TEST(CheckpointTest, SeqnoAndHLCOrdering) {
     }
 }
 
+//
+// Seqno reservation is decoupled from checkpoint insertion (see
+// CheckpointManager::reserveBySeqno), so mutations may be linked into the
+// open checkpoint out of their reserved order. Verify that after a
+// concurrent scatter over multiple threads a cursor still observes a
+// strictly increasing, gap-free seqno stream.
+//
+TYPED_TEST(CheckpointTest, ConcurrentQueueSeqnoOrdering) {
+    const int n_threads = 8;
+    const int n_items = 1000;
+
+    // One large checkpoint so the data checks aren't muddied by rotation.
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               n_threads * n_items,
+                                               /*numCheckpoints*/ 1,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*enableMerge*/ false,
+                                               /*persistenceEnabled*/ true);
+    this->createManager();
+    const int64_t firstSeqno = this->manager->getHighSeqno() + 1;
+
+    std::vector<std::thread> threads;
+    for (int ii = 0; ii < n_threads; ii++) {
+        threads.push_back(std::thread([this, ii, n_items]() {
+            std::string key = "key" + std::to_string(ii) + "_";
+            for (int item = 0; item < n_items; item++) {
+                queued_item qi(
+                        new Item(makeStoredDocKey(key + std::to_string(item)),
+                                 this->vbucket->getId(),
+                                 queue_op::mutation,
+                                 /*revSeq*/ 0,
+                                 /*bySeq*/ 0));
+                EXPECT_TRUE(
+                        this->manager->queueDirty(*this->vbucket,
+                                                  qi,
+                                                  GenerateBySeqno::Yes,
+                                                  GenerateCas::Yes,
+                                                  /*preLinkDocCtx*/ nullptr));
+            }
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+
+    // (n_threads * n_items mutations) + op_ckpt_start.
+    ASSERT_EQ(n_threads * n_items + 1, items.size());
+
+    // Mutations (element 1 onwards) must be contiguous and in seqno order.
+    for (size_t ii = 1; ii < items.size(); ii++) {
+        EXPECT_EQ(firstSeqno + static_cast<int64_t>(ii) - 1,
+                  items[ii]->getBySeqno());
+    }
+}
+
 // Test cursor is correctly updated when enqueuing a key which already exists
 // in the checkpoint (and needs de-duping), where the cursor points at a
 // meta-item at the head of the checkpoint:
@@ -1206,3 +1366,49 @@ TYPED_TEST(CheckpointTest,
     // Test - second item (duplicate key) should return false.
     EXPECT_FALSE(this->queueNewItem("key"));
 }
+
+// Test that a freshly-created manager can be re-populated with the recent
+// seqno window at warmup, that the persistence cursor does not re-persist
+// the restored items, and that a cursor registered inside the window (i.e.
+// a reconnecting DCP client) is served from memory.
+TYPED_TEST(CheckpointTest, RestoreItemsFromWarmup) {
+    // Manager was created at seqno 1000; restore the window (995, 1000].
+    std::vector<queued_item> items;
+    for (int64_t seqno = 996; seqno <= 1000; seqno++) {
+        queued_item qi{new Item(makeStoredDocKey(std::to_string(seqno)),
+                                this->vbucket->getId(),
+                                queue_op::mutation,
+                                /*revSeq*/ 0,
+                                seqno)};
+        items.push_back(qi);
+    }
+    EXPECT_EQ(5, this->manager->restoreItemsFromWarmup(items));
+    EXPECT_EQ(5, this->manager->getNumOpenChkItems());
+    EXPECT_EQ(1000, this->manager->getHighSeqno());
+
+    // Restored items are already on disk - nothing for the flusher.
+    EXPECT_EQ(0,
+              this->manager->getNumItemsForCursor(
+                      CheckpointManager::pCursorName));
+
+    // A second restore must be refused (the checkpoint is not empty).
+    EXPECT_EQ(0, this->manager->restoreItemsFromWarmup(items));
+
+    // A client which had reached seqno 997 resumes from memory at 998.
+    auto result = this->manager->registerCursorBySeqno(
+            "warm_client", 997, MustSendCheckpointEnd::NO);
+    EXPECT_EQ(998, result.first);
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(3, this->manager->getNumItemsForCursor("warm_client"));
+
+    // The position of the re-registered client is persisted in turn.
+    EXPECT_EQ("{\"warm_client\":\"997\"}",
+              this->manager->getConnCursorSeqnosJSON());
+
+    // New mutations follow on from the restored window as usual.
+    EXPECT_TRUE(this->queueNewItem("key"));
+    EXPECT_EQ(1001, this->manager->getHighSeqno());
+    EXPECT_EQ(1,
+              this->manager->getNumItemsForCursor(
+                      CheckpointManager::pCursorName));
+}
@@ -325,6 +325,7 @@ TEST_F(CollectionsVBFilterTest, passthrough) {
 
     // Everything is allowed (even junk, which isn't the filter's job to police)
     Collections::VB::Filter vbf(f, vbm);
+    EXPECT_TRUE(vbf.isPassthrough());
     EXPECT_TRUE(vbf.allow({"anykey", DocNamespace::DefaultCollection}));
     EXPECT_TRUE(vbf.allow({"fruit$apple", DocNamespace::Collections}));
     EXPECT_TRUE(vbf.allow({"meat$steak", DocNamespace::Collections}));
@@ -352,6 +353,7 @@ TEST_F(CollectionsVBFilterTest, no_default) {
 
     // Now filter!
     Collections::VB::Filter vbf(f, vbm);
+    EXPECT_FALSE(vbf.isPassthrough());
     EXPECT_FALSE(vbf.allow({"anykey", DocNamespace::DefaultCollection}));
     EXPECT_TRUE(vbf.allow({"fruit$apple", DocNamespace::Collections}));
     EXPECT_TRUE(vbf.allow({"meat$steak", DocNamespace::Collections}));
@@ -416,6 +418,44 @@ TEST_F(CollectionsVBFilterTest, remove2) {
     EXPECT_FALSE(vbf.allow({"meat$apple", DocNamespace::Collections}));
 }
 
+/**
+ * ::allow memoises the verdict of the last collection checked (streams send
+ * runs of keys from one collection). Check the memo returns the correct
+ * verdict for repeated and interleaved collections, and is invalidated when
+ * the memoised collection is removed.
+ */
+TEST_F(CollectionsVBFilterTest, allow_memoisation) {
+    Collections::Manifest m(
+            R"({"separator":"$",)"
+            R"("collections":[{"name":"vegetable","uid":"1"},
+                              {"name":"meat","uid":"3"},
+                              {"name":"fruit", "uid":"4"},
+                              {"name":"dairy","uid":"5"}]})");
+    Collections::VB::Manifest vbm({});
+    vbm.wlock().update(vb, m);
+
+    std::string jsonFilter = R"({"collections":["fruit", "meat"]})";
+    boost::optional<const std::string&> json(jsonFilter);
+
+    Collections::Filter f(json, m);
+    Collections::VB::Filter vbf(f, vbm);
+
+    // Runs of keys from one collection, then a switch to another
+    EXPECT_TRUE(vbf.allow({"fruit$apple", DocNamespace::Collections}));
+    EXPECT_TRUE(vbf.allow({"fruit$pear", DocNamespace::Collections}));
+    EXPECT_TRUE(vbf.allow({"fruit$orange", DocNamespace::Collections}));
+    EXPECT_FALSE(vbf.allow({"dairy$milk", DocNamespace::Collections}));
+    EXPECT_FALSE(vbf.allow({"dairy$cheese", DocNamespace::Collections}));
+    EXPECT_TRUE(vbf.allow({"meat$steak", DocNamespace::Collections}));
+    EXPECT_TRUE(vbf.allow({"fruit$banana", DocNamespace::Collections}));
+
+    // Removing the memoised collection must invalidate the memo
+    EXPECT_FALSE(vbf.remove("fruit"));
+    EXPECT_FALSE(vbf.allow({"fruit$apple", DocNamespace::Collections}));
+    EXPECT_FALSE(vbf.allow({"fruit$pear", DocNamespace::Collections}));
+    EXPECT_TRUE(vbf.allow({"meat$bacon", DocNamespace::Collections}));
+}
+
 std::unique_ptr<SystemEventConsumerMessage> makeTestMessage(
         const std::string name, mcbp::systemevent::id ev, const int* rev) {
     cb::const_byte_buffer n{reinterpret_cast<const uint8_t*>(name.data()),
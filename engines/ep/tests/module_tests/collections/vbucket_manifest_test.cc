@@ -920,6 +920,82 @@ TEST_F(VBucketManifestTest, replica_add_remove_completeDelete) {
     EXPECT_TRUE(manifest.completeDeletion({"vegetable", 1}));
 }
 
+// Check the lock-free snapshot tracks membership/separator changes, and that
+// a snapshot taken before a change keeps answering with its old state.
+TEST_F(VBucketManifestTest, snapshot) {
+    std::string vegetable("vegetable");
+    auto& active = manifest.getActiveManifest();
+
+    auto s1 = active.snapshot();
+    ASSERT_NE(nullptr, s1);
+    EXPECT_TRUE(s1->doesDefaultCollectionExist());
+    EXPECT_EQ("::", s1->getSeparator());
+    EXPECT_FALSE(s1->isCollectionOpen({vegetable.data(), vegetable.size()}));
+    EXPECT_FALSE(s1->doesKeyContainValidCollection(
+            {"vegetable::carrot", DocNamespace::Collections}));
+
+    // add vegetable
+    EXPECT_TRUE(manifest.update(
+            R"({"separator":"::","collections":[{"name":"$default","uid":"0"},)"
+            R"(                                 {"name":"vegetable","uid":"1"}]})"));
+
+    auto s2 = active.snapshot();
+    EXPECT_TRUE(s2->isCollectionOpen({vegetable.data(), vegetable.size()}));
+    EXPECT_TRUE(s2->doesKeyContainValidCollection(
+            {"vegetable::carrot", DocNamespace::Collections}));
+
+    // The old snapshot is immutable; it still reports the old state
+    EXPECT_FALSE(s1->isCollectionOpen({vegetable.data(), vegetable.size()}));
+
+    // remove vegetable and $default
+    EXPECT_TRUE(manifest.update(R"({"separator":"::","collections":[]})"));
+
+    auto s3 = active.snapshot();
+    EXPECT_FALSE(s3->doesDefaultCollectionExist());
+    EXPECT_FALSE(s3->isCollectionOpen({vegetable.data(), vegetable.size()}));
+    EXPECT_FALSE(s3->doesKeyContainValidCollection(
+            {"vegetable::carrot", DocNamespace::Collections}));
+    EXPECT_TRUE(s2->doesKeyContainValidCollection(
+            {"vegetable::carrot", DocNamespace::Collections}));
+
+    // Separator changes are also published
+    EXPECT_TRUE(manifest.completeDeletion({"vegetable", 1}));
+    EXPECT_TRUE(manifest.completeDeletion({"$default", 0}));
+    EXPECT_TRUE(manifest.update(R"({"separator":"@@","collections":[]})"));
+    EXPECT_EQ("@@", active.snapshot()->getSeparator());
+    EXPECT_EQ("::", s1->getSeparator());
+}
+
+// Check the incrementally maintained per-collection disk count. The counters
+// are bumped through the ReadHandle as the flusher's callbacks would.
+TEST_F(VBucketManifestTest, diskCount) {
+    EXPECT_TRUE(manifest.update(
+            R"({"separator":"::","collections":[{"name":"$default","uid":"0"},)"
+            R"(                                 {"name":"vegetable","uid":"1"}]})"));
+
+    auto& active = manifest.getActiveManifest();
+    DocKey carrot{"vegetable::carrot", DocNamespace::Collections};
+    DocKey anykey{"anykey", DocNamespace::DefaultCollection};
+
+    EXPECT_EQ(0, active.lock().getDiskCount(carrot));
+    active.lock().incrementDiskCount(carrot);
+    active.lock().incrementDiskCount(carrot);
+    EXPECT_EQ(2, active.lock().getDiskCount(carrot));
+    active.lock().decrementDiskCount(carrot);
+    EXPECT_EQ(1, active.lock().getDiskCount(carrot));
+
+    // The default collection is counted separately
+    active.lock().incrementDiskCount(anykey);
+    EXPECT_EQ(1, active.lock().getDiskCount(anykey));
+    EXPECT_EQ(1, active.lock().getDiskCount(carrot));
+
+    // Unknown collections are a no-op (the collection may have been
+    // completely deleted whilst an item was in-flight to disk)
+    DocKey milk{"dairy::milk", DocNamespace::Collections};
+    active.lock().incrementDiskCount(milk);
+    EXPECT_EQ(0, active.lock().getDiskCount(milk));
+}
+
 class VBucketManifestTestEndSeqno : public VBucketManifestTest {};
 
 TEST_F(VBucketManifestTestEndSeqno, singleAdd) {
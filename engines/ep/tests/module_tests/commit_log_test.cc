@@ -0,0 +1,241 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include <platform/strerror.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "commit_log.h"
+#include "tests/module_tests/test_helpers.h"
+
+/// Truncate the file at `path` to `length` bytes (cross-platform).
+static void truncate_file(const std::string& path, off_t length) {
+#if defined(WIN32)
+    LARGE_INTEGER distance;
+    distance.u.HighPart = 0;
+    distance.u.LowPart = length;
+
+    HANDLE fh = CreateFile(
+            path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ASSERT_NE(INVALID_HANDLE_VALUE, fh) << cb_strerror();
+    cb_assert(SetFilePointerEx(fh, distance, NULL, FILE_BEGIN) != 0);
+    cb_assert(SetEndOfFile(fh) != 0);
+    CloseHandle(fh);
+#else
+    ASSERT_EQ(0, truncate(path.c_str(), length)) << cb_strerror();
+#endif
+}
+
+class CommitLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // Generate a temporary log filename.
+        tmp_log_filename = "clt_test.XXXXXX";
+        ASSERT_NE(nullptr, cb_mktemp(&tmp_log_filename[0]));
+    }
+
+    void TearDown() override {
+        remove(tmp_log_filename.c_str());
+    }
+
+    /// Make an Item carrying every field the log serializes.
+    static queued_item makeItem(uint16_t vbid,
+                                const std::string& key,
+                                const std::string& value,
+                                int64_t bySeqno,
+                                bool deleted = false) {
+        queued_item itm(new Item(makeStoredDocKey(key),
+                                 /*flags*/ 0xcafef00d,
+                                 /*exptime*/ 1234,
+                                 value.data(),
+                                 value.size(),
+                                 PROTOCOL_BINARY_DATATYPE_JSON,
+                                 /*cas*/ 0xbeef0000 + bySeqno,
+                                 bySeqno,
+                                 vbid,
+                                 /*revSeqno*/ 100 + bySeqno));
+        if (deleted) {
+            itm->setDeleted();
+        }
+        return itm;
+    }
+
+    /// Replay the log at tmp_log_filename into `out`; returns the
+    /// replay()'s clean/torn result.
+    bool replayLog(std::vector<std::pair<uint16_t, queued_item>>& out) {
+        CommitLog log(tmp_log_filename);
+        log.open(true /*readOnly*/);
+        return log.replay([&out](uint16_t vbid, queued_item itm) {
+            out.emplace_back(vbid, itm);
+        });
+    }
+
+    // Storage for temporary log filename
+    std::string tmp_log_filename;
+};
+
+TEST_F(CommitLogTest, RoundTrip) {
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key1", "value1", 1));
+        log.newMutation(*makeItem(1, "key2", "value2", 1));
+        log.newMutation(*makeItem(0, "key3", "", 2, /*deleted*/ true));
+        EXPECT_EQ(0u, log.getLogSize()) << "Nothing on disk before sync()";
+        log.sync();
+        EXPECT_GT(log.getLogSize(), 0u);
+        log.close();
+    }
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_TRUE(replayLog(items));
+    ASSERT_EQ(3u, items.size());
+
+    // Delivered in append order, with every field intact.
+    EXPECT_EQ(0, items[0].first);
+    EXPECT_EQ(makeStoredDocKey("key1"), items[0].second->getKey());
+    EXPECT_EQ(1, items[0].second->getBySeqno());
+    EXPECT_EQ(101u, items[0].second->getRevSeqno());
+    EXPECT_EQ(0xbeef0001u, items[0].second->getCas());
+    EXPECT_EQ(0xcafef00du, items[0].second->getFlags());
+    EXPECT_EQ(1234, items[0].second->getExptime());
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, items[0].second->getDataType());
+    EXPECT_FALSE(items[0].second->isDeleted());
+    ASSERT_EQ(6u, items[0].second->getNBytes());
+    EXPECT_EQ(0, memcmp("value1", items[0].second->getData(), 6));
+
+    EXPECT_EQ(1, items[1].first);
+    EXPECT_EQ(makeStoredDocKey("key2"), items[1].second->getKey());
+
+    EXPECT_EQ(0, items[2].first);
+    EXPECT_EQ(makeStoredDocKey("key3"), items[2].second->getKey());
+    EXPECT_EQ(2, items[2].second->getBySeqno());
+    EXPECT_TRUE(items[2].second->isDeleted());
+    EXPECT_EQ(0u, items[2].second->getNBytes());
+}
+
+TEST_F(CommitLogTest, TornTailTerminatesReplay) {
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key1", "value1", 1));
+        log.sync();
+        log.newMutation(*makeItem(0, "key2", "value2", 2));
+        log.sync();
+        log.close();
+    }
+
+    struct stat st;
+    ASSERT_EQ(0, stat(tmp_log_filename.c_str(), &st));
+    // Tear the middle of the second record, as an interrupted sync()
+    // would.
+    truncate_file(tmp_log_filename, st.st_size - 3);
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_FALSE(replayLog(items)) << "Torn tail should report unclean";
+    ASSERT_EQ(1u, items.size()) << "Records before the tear are usable";
+    EXPECT_EQ(makeStoredDocKey("key1"), items[0].second->getKey());
+}
+
+TEST_F(CommitLogTest, CorruptRecordTerminatesReplay) {
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key1", "value1", 1));
+        log.sync();
+        log.close();
+    }
+
+    // Flip a byte inside the record's payload; the CRC must catch it.
+    FILE* f = fopen(tmp_log_filename.c_str(), "r+b");
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(0, fseek(f, -1, SEEK_END));
+    fputc('X', f);
+    fclose(f);
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_FALSE(replayLog(items));
+    EXPECT_EQ(0u, items.size());
+}
+
+TEST_F(CommitLogTest, DiscardDropsUnsyncedRecords) {
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key1", "value1", 1));
+        log.sync();
+        log.newMutation(*makeItem(0, "key2", "value2", 2));
+        log.discard();
+        log.sync();
+        log.close();
+    }
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_TRUE(replayLog(items));
+    ASSERT_EQ(1u, items.size());
+    EXPECT_EQ(makeStoredDocKey("key1"), items[0].second->getKey());
+}
+
+TEST_F(CommitLogTest, ResetEmptiesLog) {
+    CommitLog log(tmp_log_filename);
+    log.open();
+    log.newMutation(*makeItem(0, "key1", "value1", 1));
+    log.sync();
+    EXPECT_GT(log.getLogSize(), 0u);
+
+    EXPECT_TRUE(log.reset());
+    EXPECT_EQ(0u, log.getLogSize());
+    EXPECT_TRUE(log.isOpen()) << "reset() leaves the log open for append";
+
+    // Still usable for new records afterwards.
+    log.newMutation(*makeItem(0, "key2", "value2", 2));
+    log.sync();
+    log.close();
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_TRUE(replayLog(items));
+    ASSERT_EQ(1u, items.size());
+    EXPECT_EQ(makeStoredDocKey("key2"), items[0].second->getKey());
+}
+
+TEST_F(CommitLogTest, ReopenAppends) {
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key1", "value1", 1));
+        log.sync();
+        log.close();
+    }
+    {
+        CommitLog log(tmp_log_filename);
+        log.open();
+        log.newMutation(*makeItem(0, "key2", "value2", 2));
+        log.sync();
+        log.close();
+    }
+
+    std::vector<std::pair<uint16_t, queued_item>> items;
+    EXPECT_TRUE(replayLog(items));
+    ASSERT_EQ(2u, items.size());
+    EXPECT_EQ(1, items[0].second->getBySeqno());
+    EXPECT_EQ(2, items[1].second->getBySeqno());
+}
@@ -2090,6 +2090,63 @@ TEST_F(NotifyTest, test_mb19503_connmap_notify_paused) {
     EXPECT_EQ(1, notifyTest.getCallbacks());
 }
 
+// Verify that runs of small memory snapshot markers within one drained
+// batch are folded into a single marker covering the whole range, and
+// that markers carrying CHK/DISK/ACK flags bound the runs.
+TEST_P(ConnectionTest, test_passiveStreamCoalesceSnapshotMarkers) {
+    const void* cookie = create_mock_cookie();
+    uint16_t vbid = 0;
+
+    connection_t conn = new MockDcpConsumer(*engine, cookie, "test_consumer");
+    MockDcpConsumer* consumer = dynamic_cast<MockDcpConsumer*>(conn.get());
+
+    ASSERT_EQ(ENGINE_SUCCESS, set_vb_state(vbid, vbucket_state_replica));
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->addStream(/*opaque*/0, vbid,
+                                                  /*flags*/0));
+
+    MockPassiveStream* stream = static_cast<MockPassiveStream*>(
+            (consumer->getVbucketStream(vbid)).get());
+    ASSERT_TRUE(stream->isActive());
+
+    std::deque<std::unique_ptr<DcpResponse>> batch;
+    batch.push_back(std::make_unique<SnapshotMarker>(
+            /*opaque*/1, vbid, 1, 2, MARKER_FLAG_CHK));
+    batch.push_back(std::make_unique<SnapshotMarker>(
+            /*opaque*/1, vbid, 3, 3, /*flags*/0));
+    batch.push_back(std::make_unique<SnapshotMarker>(
+            /*opaque*/1, vbid, 4, 6, /*flags*/0));
+    batch.push_back(std::make_unique<SnapshotMarker>(
+            /*opaque*/1, vbid, 7, 8, MARKER_FLAG_ACK));
+    batch.push_back(std::make_unique<SnapshotMarker>(
+            /*opaque*/1, vbid, 9, 9, /*flags*/0));
+
+    const uint32_t dropped = stream->public_coalesceSnapshotMarkers(batch);
+
+    // The two flag-less markers following the CHK one should have been
+    // folded into it; the ACK marker bounds the run and (as it must not
+    // have its acknowledgement delayed) doesn't absorb its successor.
+    EXPECT_EQ(2 * SnapshotMarker::baseMsgBytes, dropped);
+    ASSERT_EQ(3, batch.size());
+
+    auto* merged = static_cast<SnapshotMarker*>(batch[0].get());
+    EXPECT_EQ(1, merged->getStartSeqno());
+    EXPECT_EQ(6, merged->getEndSeqno());
+    EXPECT_EQ(MARKER_FLAG_CHK, merged->getFlags());
+
+    auto* ack = static_cast<SnapshotMarker*>(batch[1].get());
+    EXPECT_EQ(7, ack->getStartSeqno());
+    EXPECT_EQ(8, ack->getEndSeqno());
+
+    auto* last = static_cast<SnapshotMarker*>(batch[2].get());
+    EXPECT_EQ(9, last->getStartSeqno());
+    EXPECT_EQ(9, last->getEndSeqno());
+
+    /* Close stream before deleting the connection */
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->closeStream(/*opaque*/0, vbid));
+
+    destroy_mock_cookie(cookie);
+}
+
 // Tests that the MutationResponse created for the deletion response is of the
 // correct size.
 TEST_P(ConnectionTest, test_mb24424_deleteResponse) {
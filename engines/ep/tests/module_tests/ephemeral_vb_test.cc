@@ -142,6 +142,34 @@ TEST_F(EphemeralVBucketTest, CreatePageoutCreate) {
     EXPECT_EQ(1, mockEpheVB->getLL()->getNumDeletedItems());
 }
 
+// Auto-delete quick path: items never referenced since insertion are deleted
+// oldest-first from the seqList, whilst items referenced since insertion are
+// protected - only aged - so the working set survives hitting the quota.
+TEST_F(EphemeralVBucketTest, EvictProbationaryItems) {
+    const int numItems = 5;
+    auto keys = generateKeys(numItems);
+    setMany(keys, MutationStatus::WasClean);
+    ASSERT_EQ(numItems, vbucket->getNumItems());
+
+    // Reference the two oldest keys; they become "protected".
+    for (int i = 0; i < 2; ++i) {
+        lockAndFind(keys[i]).second->referenced();
+    }
+
+    // Allow up to numItems to be evicted; only the three unreferenced
+    // (probationary) items should be deleted.
+    EXPECT_EQ(numItems - 2, vbucket->evictProbationaryItems(numItems));
+    EXPECT_EQ(2, vbucket->getNumItems());
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_FALSE(lockAndFind(keys[i]).second->isDeleted());
+    }
+
+    // The survivors were aged one NRU step by the above pass; with no
+    // further references a second pass now deletes them too.
+    EXPECT_EQ(2, vbucket->evictProbationaryItems(numItems));
+    EXPECT_EQ(0, vbucket->getNumItems());
+}
+
 TEST_F(EphemeralVBucketTest, SetItems) {
     const int numItems = 3;
 
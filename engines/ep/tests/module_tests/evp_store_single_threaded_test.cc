@@ -1463,8 +1463,11 @@ public:
     /**
      * Destroy engine and replace it with a new engine that can be warmed up.
      * Finally, run warmup.
+     *
+     * @param new_config extra configuration (semicolon separated) to apply
+     *        to the new engine.
      */
-    void resetEngineAndEnableWarmup() {
+    void resetEngineAndEnableWarmup(const std::string& new_config = "") {
         shutdownAndPurgeTasks();
         std::string config = config_string;
 
@@ -1478,6 +1481,11 @@ public:
             config += warmupT;
         }
 
+        if (!new_config.empty()) {
+            config += ";";
+            config += new_config;
+        }
+
         reinitialise(config);
 
         engine->getKVBucket()->initializeWarmupTask();
@@ -1604,6 +1612,46 @@ TEST_F(WarmupTest, MB_25197) {
     }
 }
 
+// With warmup_background_fill the bucket leaves degraded mode as soon as
+// the vbucket metadata has been loaded; the remaining load phases then run
+// in the background alongside front-end traffic.
+TEST_F(WarmupTest, backgroundFill) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    flush_vbucket_to_disk(vbid);
+
+    resetEngineAndEnableWarmup("warmup_background_fill=true");
+
+    // Run reader tasks until the traffic-enable point is reached - i.e.
+    // the metadata has been loaded.
+    auto& readerQueue = *task_executor->getLpTaskQ()[READER_TASK_IDX];
+    while (engine->getKVBucket()->isWarmingUp()) {
+        CheckedExecutor executor(task_executor, readerQueue);
+        executor.runCurrentTask();
+    }
+
+    // The load phases have not yet finished...
+    auto* warmup = engine->getKVBucket()->getWarmup();
+    ASSERT_NE(nullptr, warmup);
+    EXPECT_FALSE(warmup->isComplete());
+
+    // ... but front-end operations are already accepted.
+    store_item(vbid, makeStoredDocKey("key2"), "value2");
+
+    // Let the background fill run to completion.
+    while (!warmup->isComplete()) {
+        CheckedExecutor executor(task_executor, readerQueue);
+        executor.runCurrentTask();
+    }
+
+    // Both the warmed-up item and the one stored mid-fill are readable.
+    auto fetched1 = store->get(makeStoredDocKey("key1"), vbid, nullptr, {});
+    EXPECT_EQ(ENGINE_SUCCESS, fetched1.getStatus());
+    auto fetched2 = store->get(makeStoredDocKey("key2"), vbid, nullptr, {});
+    EXPECT_EQ(ENGINE_SUCCESS, fetched2.getStatus());
+}
+
 // Test that we can push a DCP_DELETION which pretends to be from a delete
 // with xattrs, i.e. the delete has a value containing only system xattrs
 // The MB was created because this code would actually trigger an exception
@@ -82,6 +82,29 @@ TEST_F(EPBucketTest, test_mb20751_deadlock_on_disconnect_delete) {
     frontend_thread_handling_disconnect.join();
 }
 
+// Verify that a flush batch spanning multiple closed checkpoints writes at
+// most one version per key - versions from earlier checkpoints superseded
+// within the same batch are dropped, not written.
+TEST_F(EPBucketTest, FlushBatchDedupedAcrossCheckpoints) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    auto vb = store->getVBucket(vbid);
+
+    store_item(vbid, makeStoredDocKey("hot"), "v1");
+    store_item(vbid, makeStoredDocKey("other"), "value");
+
+    // Close the current checkpoint and update the hot key again in the new
+    // one; both versions are now queued for the persistence cursor.
+    vb->checkpointManager->createNewCheckpoint();
+    store_item(vbid, makeStoredDocKey("hot"), "v2");
+
+    // Only the latest version of "hot" (plus "other") should be written.
+    flush_vbucket_to_disk(vbid, 2);
+
+    auto gv = store->get(makeStoredDocKey("hot"), vbid, cookie, {});
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("v2", std::string(gv.item->getData(), gv.item->getNBytes()));
+}
+
 class EPStoreEvictionTest : public EPBucketTest,
                              public ::testing::WithParamInterface<std::string> {
     void SetUp() override {
@@ -92,6 +92,58 @@ public:
                    uint32_t(itemMeta.exptime));
     }
 
+    /// One mutation of a MULTI_SET_WITH_META packet
+    struct MultiEntry {
+        std::string key;
+        std::string value;
+        ItemMetaData meta;
+    };
+
+    /**
+     * Build a MULTI_SET_WITH_META packet carrying the given mutations
+     * for one vbucket.
+     */
+    static std::vector<char> buildMultiSetWithMetaPacket(
+            uint16_t vbucket, const std::vector<MultiEntry>& entries) {
+        std::vector<char> packet(sizeof(protocol_binary_request_no_extras));
+
+        auto append = [&packet](const void* data, size_t len) {
+            std::copy_n(reinterpret_cast<const char*>(data),
+                        len,
+                        std::back_inserter(packet));
+        };
+
+        for (const auto& entry : entries) {
+            uint16_t keylen = htons(uint16_t(entry.key.size()));
+            uint32_t vallen = htonl(uint32_t(entry.value.size()));
+            uint8_t datatype = PROTOCOL_BINARY_RAW_BYTES;
+            uint32_t flags = entry.meta.flags;
+            uint32_t exptime = htonl(uint32_t(entry.meta.exptime));
+            uint64_t revSeqno = htonll(entry.meta.revSeqno);
+            uint64_t cas = htonll(entry.meta.cas);
+            append(&keylen, sizeof(keylen));
+            append(&vallen, sizeof(vallen));
+            append(&datatype, sizeof(datatype));
+            append(&flags, sizeof(flags));
+            append(&exptime, sizeof(exptime));
+            append(&revSeqno, sizeof(revSeqno));
+            append(&cas, sizeof(cas));
+            append(entry.key.data(), entry.key.size());
+            append(entry.value.data(), entry.value.size());
+        }
+
+        // Fill in the header last; packet may have reallocated
+        auto* req = reinterpret_cast<protocol_binary_request_no_extras*>(
+                packet.data());
+        req->message.header.request.magic = PROTOCOL_BINARY_REQ;
+        req->message.header.request.opcode =
+                PROTOCOL_BINARY_CMD_MULTI_SET_WITH_META;
+        req->message.header.request.vbucket = htons(vbucket);
+        req->message.header.request.bodylen = htonl(
+                packet.size() - sizeof(protocol_binary_request_no_extras));
+        return packet;
+    }
+
     /**
      * Call the correct engine function for the op (set vs delete)
      */
@@ -1269,6 +1321,51 @@ TEST_P(AllWithMetaTest, skipConflicts) {
                   ENGINE_KEY_ENOENT);
 }
 
+TEST_F(WithMetaTest, multiSetWithMeta) {
+    ItemMetaData meta1{100 /*cas*/, 10 /*revSeqno*/, 0xf00dcafe, expiry};
+    ItemMetaData meta2{200, 20, 0xfacefeed, expiry};
+    // Re-mutates key1 with older metadata; conflict resolution must
+    // reject it even though the winner arrived in the same batch.
+    ItemMetaData stale{50, 5, 0xdeadbeef, expiry};
+
+    auto packet = buildMultiSetWithMetaPacket(vbid,
+                                              {{"key1", "value1", meta1},
+                                               {"key2", "value2", meta2},
+                                               {"key1", "stale", stale}});
+
+    EXPECT_EQ(ENGINE_SUCCESS,
+              engine->multiSetWithMeta(
+                      cookie,
+                      reinterpret_cast<protocol_binary_request_header*>(
+                              packet.data()),
+                      this->addResponse,
+                      DocNamespace::DefaultCollection));
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, getAddResponseStatus());
+
+    checkGetItem("key1", "value1", meta1);
+    checkGetItem("key2", "value2", meta2);
+}
+
+TEST_F(WithMetaTest, multiSetWithMetaInvalid) {
+    // A truncated entry (claims a bigger key than the body carries) must
+    // fail the request
+    ItemMetaData meta{100, 10, 0, expiry};
+    auto packet = buildMultiSetWithMetaPacket(vbid, {{"key", "value", meta}});
+    auto* req = reinterpret_cast<protocol_binary_request_no_extras*>(
+            packet.data());
+    req->message.header.request.bodylen =
+            htonl(ntohl(req->message.header.request.bodylen) - 2);
+
+    EXPECT_EQ(ENGINE_SUCCESS,
+              engine->multiSetWithMeta(
+                      cookie,
+                      reinterpret_cast<protocol_binary_request_header*>(
+                              packet.data()),
+                      this->addResponse,
+                      DocNamespace::DefaultCollection));
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, getAddResponseStatus());
+}
+
 auto opcodeValues = ::testing::Values(PROTOCOL_BINARY_CMD_SET_WITH_META,
                                       PROTOCOL_BINARY_CMD_SETQ_WITH_META,
                                       PROTOCOL_BINARY_CMD_ADD_WITH_META,
@@ -94,6 +94,67 @@ TEST_F(ExecutorPoolTest, register_taskable_test) {
     ASSERT_EQ(0, pool.getNumBuckets());
 }
 
+/* Equal-priority tasks from different buckets must be ordered by the
+ * weighted CPU time already charged against each bucket, so that one
+ * bucket's backlog cannot starve a neighbour's equal-priority work.
+ */
+TEST_F(ExecutorPoolTest, charged_runtime_orders_equal_priority) {
+    MockTaskable bucketA;
+    MockTaskable bucketB;
+
+    auto noop = []() -> bool { return false; };
+    ExTask taskA = std::make_shared<LambdaTask>(
+            bucketA, TaskId::StatSnap, 0, true, noop);
+    ExTask taskB = std::make_shared<LambdaTask>(
+            bucketB, TaskId::StatSnap, 0, true, noop);
+
+    CompareByPriority cmp;
+    // Neither bucket has been charged yet; the older task (A) sorts first.
+    EXPECT_FALSE(cmp(taskA, taskB));
+
+    // Charge bucketA; its task must now sort after bucketB's.
+    bucketA.getWorkLoadPolicy().chargeRunTime(std::chrono::milliseconds(10));
+    EXPECT_TRUE(cmp(taskA, taskB));
+    EXPECT_FALSE(cmp(taskB, taskA));
+
+    // A bucket with twice the shares is charged half the weighted time
+    // for the same runtime.
+    WorkLoadPolicy defaultShares(HIGH_BUCKET_PRIORITY, 1);
+    WorkLoadPolicy doubleShares(HIGH_BUCKET_PRIORITY, 1, 200);
+    defaultShares.chargeRunTime(std::chrono::milliseconds(10));
+    doubleShares.chargeRunTime(std::chrono::milliseconds(10));
+    EXPECT_EQ(defaultShares.getChargedRunTime(),
+              2 * doubleShares.getChargedRunTime());
+}
+
+/* The closed-loop sizing must only grow a pool which is both backlogged and
+ * saturated, shrink it once the backlog drains and threads sit idle, and
+ * respect the min/max bounds in either direction.
+ */
+TEST_F(ExecutorPoolTest, size_for_load) {
+    TestExecutorPool pool(10, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          2, // MaxNumReaders
+                          2, // MaxNumWriters
+                          2, // MaxNumAuxio
+                          2 // MaxNumNonio
+                          );
+
+    // Backlogged and near-saturated: grow by one.
+    EXPECT_EQ(5, pool.sizeForLoad(4, 4, 12, /*depth*/ 8, /*demand*/ 4.0));
+    // Backlogged but threads mostly idle (tasks blocked elsewhere, not on
+    // the device): hold.
+    EXPECT_EQ(4, pool.sizeForLoad(4, 4, 12, 8, 1.0));
+    // Saturated but no queue: the pool is keeping up - hold.
+    EXPECT_EQ(4, pool.sizeForLoad(4, 4, 12, 0, 4.0));
+    // At the ceiling: hold regardless of backlog.
+    EXPECT_EQ(12, pool.sizeForLoad(12, 4, 12, 20, 12.0));
+    // No backlog and mostly idle: shrink by one...
+    EXPECT_EQ(7, pool.sizeForLoad(8, 4, 12, 0, 0.5));
+    // ...but never below the floor.
+    EXPECT_EQ(4, pool.sizeForLoad(4, 4, 12, 0, 0.0));
+}
+
 /* This test creates an ExecutorPool, and attempts to verify that calls to
  * setNumWriters are able to dynamically create more workers than were present
  * at initialisation. A ThreadGate is used to confirm that two tasks
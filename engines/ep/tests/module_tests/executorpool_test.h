@@ -91,6 +91,15 @@ public:
         return std::find(names.begin(), names.end(), name) != names.end();
     }
 
+    size_t sizeForLoad(size_t curThreads,
+                       size_t minThreads,
+                       size_t maxThreads,
+                       size_t queueDepth,
+                       double demand) {
+        return _sizeForLoad(
+                curThreads, minThreads, maxThreads, queueDepth, demand);
+    }
+
     /** Waits indefinitely for the taskLocator to become empty, indicating all
      * tasks have been cancelled and cleaned up.
      */
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "expiry_index.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+TEST(ExpiryIndexTest, Empty) {
+    ExpiryIndex index;
+    EXPECT_EQ(0, index.getNumKeys());
+    EXPECT_EQ(0, index.getNextDeadline());
+    EXPECT_TRUE(index.harvest(100, 10).empty());
+}
+
+TEST(ExpiryIndexTest, HarvestOnlyDueKeys) {
+    ExpiryIndex index;
+    index.add(10, makeStoredDocKey("early"));
+    index.add(20, makeStoredDocKey("late"));
+    EXPECT_EQ(2, index.getNumKeys());
+    EXPECT_EQ(10, index.getNextDeadline());
+
+    auto keys = index.harvest(15, 10);
+    ASSERT_EQ(1, keys.size());
+    EXPECT_EQ(makeStoredDocKey("early"), keys[0]);
+    EXPECT_EQ(1, index.getNumKeys());
+    EXPECT_EQ(20, index.getNextDeadline());
+
+    // Nothing else is due yet
+    EXPECT_TRUE(index.harvest(15, 10).empty());
+
+    keys = index.harvest(20, 10);
+    ASSERT_EQ(1, keys.size());
+    EXPECT_EQ(makeStoredDocKey("late"), keys[0]);
+    EXPECT_EQ(0, index.getNumKeys());
+    EXPECT_EQ(0, index.getNextDeadline());
+}
+
+TEST(ExpiryIndexTest, HarvestHonoursLimit) {
+    ExpiryIndex index;
+    for (int ii = 0; ii < 10; ii++) {
+        index.add(5, makeStoredDocKey("key_" + std::to_string(ii)));
+    }
+
+    auto keys = index.harvest(5, 4);
+    EXPECT_EQ(4, keys.size());
+    EXPECT_EQ(6, index.getNumKeys());
+
+    // The remainder is still due and reported as such
+    EXPECT_EQ(5, index.getNextDeadline());
+    keys = index.harvest(5, 100);
+    EXPECT_EQ(6, keys.size());
+    EXPECT_EQ(0, index.getNumKeys());
+}
+
+TEST(ExpiryIndexTest, DropsKeysAtCapacity) {
+    ExpiryIndex index(2);
+    index.add(10, makeStoredDocKey("one"));
+    index.add(10, makeStoredDocKey("two"));
+    index.add(10, makeStoredDocKey("three"));
+    EXPECT_EQ(2, index.getNumKeys());
+    EXPECT_EQ(1, index.getNumDropped());
+
+    // Harvesting frees up room for new keys
+    EXPECT_EQ(2, index.harvest(10, 10).size());
+    index.add(20, makeStoredDocKey("four"));
+    EXPECT_EQ(1, index.getNumKeys());
+    EXPECT_EQ(1, index.getNumDropped());
+}
@@ -22,7 +22,7 @@
 
 class FutureQueueTest : public ::testing::TestWithParam<std::string> {
 public:
-    FutureQueue<> queue;
+    FutureQueue queue;
 };
 
 TEST_F(FutureQueueTest, initAssumptions) {
@@ -153,6 +153,57 @@ TEST_F(FutureQueueTest, snooze) {
     EXPECT_EQ(top, static_cast<TestTask*>(lastTask.get())->order);
 }
 
+/*
+ * Repeatedly re-arm one task; the queue's size must not grow with the
+ * number of re-arms and the ordering must be maintained throughout.
+ */
+TEST_F(FutureQueueTest, repeatedSnooze) {
+    const int n = 10;
+    ExTask middleTask;
+    for (int i = 0; i <= n; i++) {
+        ExTask hpTask;
+        hpTask = std::make_shared<TestTask>(
+                nullptr, TaskId::PendingOpsNotification, i);
+        const auto newtime = std::chrono::nanoseconds((n * 2) - i);
+        hpTask->updateWaketime(ProcessClock::time_point(newtime));
+        queue.push(hpTask);
+
+        if (i == n/2) {
+            middleTask = hpTask;
+        }
+    }
+
+    ASSERT_NE(nullptr, middleTask.get());
+
+    // Re-arm the middle task many more times than there are tasks queued
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(queue.snooze(middleTask, i));
+    }
+
+    // Each queued task is still represented exactly once
+    EXPECT_EQ(size_t(n + 1), queue.size());
+
+    // The snoozed task is now due last; bring it forward and it must
+    // become the front task again.
+    EXPECT_TRUE(queue.updateWaketime(middleTask,
+                                     ProcessClock::time_point::min()));
+    EXPECT_EQ(static_cast<TestTask*>(middleTask.get())->order,
+              static_cast<TestTask*>(queue.top().get())->order);
+
+    // Popping everything yields each task once, in wakeTime order.
+    size_t popped = 0;
+    ExTask lastTask;
+    while (!queue.empty()) {
+        if (lastTask) {
+            EXPECT_LE(lastTask->getWaketime(), queue.top()->getWaketime());
+        }
+        lastTask = queue.top();
+        queue.pop();
+        popped++;
+    }
+    EXPECT_EQ(size_t(n + 1), popped);
+}
+
 /*
  * snooze/wake a task not in the queue, the queue is also empty.
  */
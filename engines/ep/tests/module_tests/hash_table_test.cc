@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <set>
 #include <signal.h>
 
 EPStats global_stats;
@@ -163,6 +164,19 @@ TEST_F(HashTableTest, SizeTwo) {
     EXPECT_EQ(0, count(h));
 }
 
+// Passing zero for size/locks should pick the defaults; the lock count is
+// sized relative to the core count with the old fixed default as a floor.
+TEST_F(HashTableTest, MachineSizedDefaults) {
+    HashTable h(global_stats, makeFactory(), 0, 0);
+    EXPECT_EQ(47, h.getSize());
+    EXPECT_GE(h.getNumLocks(), 47);
+    EXPECT_EQ(HashTable::getNumLocks(0), h.getNumLocks());
+
+    // Sanity check the table is usable.
+    store(h, makeStoredDocKey("a-key"));
+    EXPECT_EQ(1, count(h));
+}
+
 TEST_F(HashTableTest, ReverseDeletions) {
     size_t initialSize = global_stats.currentSize.load();
     HashTable h(global_stats, makeFactory(), 5, 1);
@@ -203,6 +217,33 @@ TEST_F(HashTableTest, ForwardDeletions) {
     EXPECT_EQ(initialSize, global_stats.currentSize.load());
 }
 
+// Budgeted clearing should release everything across multiple calls and
+// keep the memory accounting straight.
+TEST_F(HashTableTest, ClearBudgeted) {
+    size_t initialSize = global_stats.currentSize.load();
+    HashTable h(global_stats, makeFactory(), 5, 1);
+    const int nkeys = 1000;
+
+    auto keys = generateKeys(nkeys);
+    storeMany(h, keys);
+    EXPECT_EQ(nkeys, count(h));
+
+    const size_t budget = 300;
+    size_t released = 0;
+    size_t batches = 0;
+    size_t rv;
+    while ((rv = h.clearBudgeted(budget)) == budget) {
+        released += rv;
+        ++batches;
+    }
+    released += rv;
+
+    EXPECT_EQ(size_t(nkeys), released);
+    EXPECT_EQ(size_t(nkeys) / budget, batches);
+    EXPECT_EQ(0, h.getNumItems());
+    EXPECT_EQ(initialSize, global_stats.currentSize.load());
+}
+
 static void verifyFound(HashTable &h, const std::vector<StoredDocKey> &keys) {
     EXPECT_FALSE(h.find(makeStoredDocKey("aMissingKey"),
                         TrackReference::Yes,
@@ -306,10 +347,81 @@ TEST_F(HashTableTest, AutoResize) {
     verifyFound(h, keys);
 
     h.resize();
+    // The chosen prime (769) is rounded up to a multiple of the lock
+    // count (3) so that subsequent resizes can be performed
+    // incrementally.
+    EXPECT_EQ(771, h.getSize());
+    verifyFound(h, keys);
+}
+
+TEST_F(HashTableTest, ResizeIncremental) {
+    // With the lock count (5) dividing the size, growth to a multiple of
+    // the current size takes the incremental (bucket-at-a-time) path.
+    HashTable h(global_stats, makeFactory(), 10, 5);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    h.resize(20);
+    EXPECT_EQ(20, h.getSize());
+    verifyFound(h, keys);
+
+    // Automatic resize doubles from the current size until it reaches
+    // the target the prime table would have chosen (769 -> 1280).
+    h.resize();
+    EXPECT_EQ(1280, h.getSize());
+    verifyFound(h, keys);
+
+    // Shrinking still takes the one-shot path.
+    h.resize(769);
     EXPECT_EQ(769, h.getSize());
     verifyFound(h, keys);
 }
 
+TEST_F(HashTableTest, RandomKeySampling) {
+    HashTable h(global_stats, makeFactory(), 97, 3);
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+
+    // Every sample must be a stored, resident item.
+    for (long seed = 0; seed < 20; ++seed) {
+        auto itm = h.getRandomKey(seed);
+        ASSERT_TRUE(itm);
+        EXPECT_TRUE(
+                h.find(itm->getKey(), TrackReference::No, WantsDeleted::No));
+    }
+
+    // Over a modest number of draws every item should be seen at least
+    // once - the previous implementation could never return an item
+    // sitting behind another eligible one in the same hash chain.
+    std::set<std::string> seen;
+    for (long seed = 0; seen.size() < keys.size() && seed < 10000; ++seed) {
+        auto itm = h.getRandomKey(seed);
+        ASSERT_TRUE(itm);
+        seen.insert(std::string(
+                reinterpret_cast<const char*>(itm->getKey().data()),
+                itm->getKey().size()));
+    }
+    EXPECT_EQ(keys.size(), seen.size());
+}
+
+TEST_F(HashTableTest, RandomKeyBatched) {
+    HashTable h(global_stats, makeFactory(), 97, 3);
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+
+    auto items = h.getRandomKeys(50, /*rnd*/ 1234);
+    EXPECT_EQ(50, items.size());
+    for (const auto& itm : items) {
+        EXPECT_TRUE(
+                h.find(itm->getKey(), TrackReference::No, WantsDeleted::No));
+    }
+
+    // An empty table yields an empty batch.
+    HashTable empty(global_stats, makeFactory(), 97, 3);
+    EXPECT_TRUE(empty.getRandomKeys(10, /*rnd*/ 1234).empty());
+}
+
 TEST_F(HashTableTest, DepthCounting) {
     HashTable h(global_stats, makeFactory(), 5, 1);
     const int nkeys = 5000;
@@ -323,6 +435,55 @@ TEST_F(HashTableTest, DepthCounting) {
     EXPECT_GT(depthCounter.max, 1000);
 }
 
+// Verify that the incrementally-maintained depth statistics agree with the
+// actual table contents across insert, delete, clear and resize.
+TEST_F(HashTableTest, DepthStatsTracking) {
+    HashTable h(global_stats, makeFactory(), 97, 3);
+
+    // An empty table has every bucket at depth zero.
+    auto ds = h.getDepthStats();
+    ASSERT_LT(0, ds.bucketsAtDepth.size());
+    EXPECT_EQ(h.getSize(), ds.bucketsAtDepth[0]);
+    EXPECT_EQ(0, ds.minDepth);
+    EXPECT_EQ(0, ds.maxDepth);
+
+    // Check that the per-depth bucket counts sum to the number of buckets,
+    // and that the implied item count matches expectations.
+    auto verify = [&h](size_t expectedItems) {
+        const auto ds = h.getDepthStats();
+        size_t buckets = 0;
+        size_t items = 0;
+        for (size_t d = 0; d < ds.bucketsAtDepth.size(); ++d) {
+            buckets += ds.bucketsAtDepth[d];
+            items += d * ds.bucketsAtDepth[d];
+        }
+        EXPECT_EQ(h.getSize(), buckets);
+        EXPECT_EQ(expectedItems, items);
+        EXPECT_LE(ds.minDepth, ds.maxDepth);
+    };
+
+    const size_t nkeys = 500;
+    auto keys = generateKeys(nkeys);
+    storeMany(h, keys);
+    verify(nkeys);
+
+    // Remove half of the keys.
+    for (size_t i = 0; i < nkeys / 2; i++) {
+        EXPECT_TRUE(del(h, keys[i]));
+    }
+    verify(nkeys - nkeys / 2);
+
+    // Growing the table must rebuild the counters for the new bucket count.
+    h.resize(769);
+    EXPECT_EQ(769, h.getSize());
+    verify(nkeys - nkeys / 2);
+
+    // Clearing resets every bucket back to depth zero.
+    h.clear();
+    verify(0);
+    EXPECT_EQ(0, h.getDepthStats().maxDepth);
+}
+
 TEST_F(HashTableTest, PoisonKey) {
     HashTable h(global_stats, makeFactory(), 5, 1);
 
@@ -845,3 +1006,75 @@ TEST_F(HashTableTest, PauseResumeHashBucket) {
     HashTable::Position start;
     ht.pauseResumeVisit(mockVisitor, start);
 }
+
+// Check that a CompositeHashTableVisitor drives several visitors from
+// a single scan, honouring per-visitor filters and early termination.
+TEST_F(HashTableTest, CompositeVisitor) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    auto keys = generateKeys(10);
+    storeMany(ht, keys);
+
+    // Two counters sharing one scan should each see every value.
+    Counter c1(false);
+    Counter c2(false);
+    CompositeHashTableVisitor composite;
+    composite.addVisitor(c1);
+    composite.addVisitor(c2);
+    ht.visit(composite);
+    EXPECT_EQ(10, c1.count);
+    EXPECT_EQ(10, c2.count);
+
+    // A visitor which stops after three values is dropped from the
+    // rest of the scan without terminating the other visitor.
+    class LimitedCounter : public HashTableVisitor {
+    public:
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            return ++count < 3;
+        }
+        size_t count = 0;
+    } limited;
+
+    Counter c3(false);
+    CompositeHashTableVisitor limitedComposite;
+    limitedComposite.addVisitor(limited);
+    limitedComposite.addVisitor(c3);
+    ht.visit(limitedComposite);
+    EXPECT_EQ(3, limited.count);
+    EXPECT_EQ(10, c3.count);
+
+    // A wantsVisit() filter keeps a visitor from being called for
+    // values it doesn't care about, without hiding them from the rest.
+    class FilteredCounter : public HashTableVisitor {
+    public:
+        explicit FilteredCounter(const StoredDocKey& only) : only(only) {
+        }
+        bool wantsVisit(const StoredValue& v) override {
+            return v.getKey() == only;
+        }
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            ++count;
+            return true;
+        }
+        const StoredDocKey only;
+        size_t count = 0;
+    } filtered(keys[0]);
+
+    Counter c4(false);
+    CompositeHashTableVisitor filteredComposite;
+    filteredComposite.addVisitor(filtered);
+    filteredComposite.addVisitor(c4);
+    ht.visit(filteredComposite);
+    EXPECT_EQ(1, filtered.count);
+    EXPECT_EQ(10, c4.count);
+
+    // reset() arms all visitors for another scan.
+    limitedComposite.reset();
+    limited.count = 0;
+    c3.count = 0;
+    c3.deleted = 0;
+    ht.visit(limitedComposite);
+    EXPECT_EQ(3, limited.count);
+    EXPECT_EQ(10, c3.count);
+}
@@ -201,3 +201,67 @@ TEST_F(ItemPruneTest, testPruneValueWithNoXattrs) {
     // should not have value
     EXPECT_EQ(0, item->getNBytes());
 }
+
+TEST_F(ItemTest, testProjectValue) {
+    std::string valueData =
+            R"({"name":"a","meta":{"rev":1,"stale":true},"big":"unwanted"})";
+
+    item = std::make_unique<Item>(
+            makeStoredDocKey("key"),
+            0,
+            0,
+            valueData.data(),
+            valueData.size(),
+            PROTOCOL_BINARY_DATATYPE_JSON);
+
+    EXPECT_TRUE(item->projectValue({"name", "meta.rev", "missing"}));
+
+    // projection should retain the requested paths (absent ones simply
+    // don't appear) and drop everything else
+    std::string expected = R"({"name":"a","meta":{"rev":1}})";
+    EXPECT_EQ(expected.size(), item->getNBytes());
+    EXPECT_EQ(0, memcmp(item->getData(), expected.data(), item->getNBytes()));
+    EXPECT_TRUE(mcbp::datatype::is_json(item->getDataType()));
+}
+
+TEST_F(ItemTest, testProjectValueNonJson) {
+    std::string valueData = R"(raw data)";
+
+    item = std::make_unique<Item>(
+            makeStoredDocKey("key"),
+            0,
+            0,
+            valueData.data(),
+            valueData.size());
+
+    // non-JSON values must be left untouched
+    EXPECT_FALSE(item->projectValue({"name"}));
+    EXPECT_EQ(valueData.size(), item->getNBytes());
+    EXPECT_EQ(0,
+              memcmp(item->getData(), valueData.data(), item->getNBytes()));
+}
+
+TEST_F(ItemTest, testProjectValuePreservesXattrs) {
+    std::string valueData = R"({"name":"a","big":"unwanted"})";
+    std::string data = createXattrValue(valueData);
+    protocol_binary_datatype_t datatype = (PROTOCOL_BINARY_DATATYPE_JSON |
+                                           PROTOCOL_BINARY_DATATYPE_XATTR);
+
+    item = std::make_unique<Item>(
+            makeStoredDocKey("key"),
+            0,
+            0,
+            data.data(),
+            data.size(),
+            datatype);
+
+    EXPECT_TRUE(item->projectValue({"name"}));
+
+    // the xattr section should be carried over untouched, followed by
+    // the projected body
+    std::string expected = createXattrValue("");
+    expected.append(R"({"name":"a"})");
+    EXPECT_EQ(expected.size(), item->getNBytes());
+    EXPECT_EQ(0, memcmp(item->getData(), expected.data(), item->getNBytes()));
+    EXPECT_TRUE(mcbp::datatype::is_xattr(item->getDataType()));
+}
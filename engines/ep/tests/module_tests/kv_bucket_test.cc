@@ -397,6 +397,50 @@ TEST_P(KVBucketParamTest, GetKeyStatsNMVB) {
                                    WantsDeleted::No));
 }
 
+// MultiGet tests /////////////////////////////////////////////////////////////
+
+// Fetch a mix of resident and missing keys in a single batch.
+TEST_P(KVBucketParamTest, MultiGetMixed) {
+    store_item(vbid, makeStoredDocKey("key1"), "value1");
+    store_item(vbid, makeStoredDocKey("key2"), "value2");
+
+    std::vector<std::pair<StoredDocKey, GetValue>> fetches;
+    fetches.emplace_back(makeStoredDocKey("key1"), GetValue());
+    fetches.emplace_back(makeStoredDocKey("missing"), GetValue());
+    fetches.emplace_back(makeStoredDocKey("key2"), GetValue());
+
+    store->getMulti(vbid, cookie, fetches);
+
+    EXPECT_EQ(ENGINE_SUCCESS, fetches[0].second.getStatus());
+    EXPECT_EQ("value1",
+              std::string(fetches[0].second.item->getData(),
+                          fetches[0].second.item->getNBytes()));
+    EXPECT_EQ(ENGINE_KEY_ENOENT, fetches[1].second.getStatus());
+    EXPECT_EQ(ENGINE_SUCCESS, fetches[2].second.getStatus());
+}
+
+// Check incorrect vbucket returns not-my-vbucket for every key.
+TEST_P(KVBucketParamTest, MultiGetNMVB) {
+    std::vector<std::pair<StoredDocKey, GetValue>> fetches;
+    fetches.emplace_back(makeStoredDocKey("key"), GetValue());
+
+    store->getMulti(vbid + 1, cookie, fetches);
+
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET, fetches[0].second.getStatus());
+}
+
+// Check pending vbucket returns EWOULDBLOCK without blocking the batch.
+TEST_P(KVBucketParamTest, MultiGetPendingVB) {
+    store->setVBucketState(vbid, vbucket_state_pending, false);
+
+    std::vector<std::pair<StoredDocKey, GetValue>> fetches;
+    fetches.emplace_back(makeStoredDocKey("key"), GetValue());
+
+    store->getMulti(vbid, cookie, fetches);
+
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, fetches[0].second.getStatus());
+}
+
 // Replace tests //////////////////////////////////////////////////////////////
 
 // Test replace against a non-existent key.
@@ -1079,6 +1123,34 @@ TEST_F(StoreIfTest, store_if_basic) {
     EXPECT_EQ(cb::engine_errc::predicate_failed, rv.status);
 }
 
+class CompressionModeTest : public KVBucketTest {
+public:
+    void SetUp() override {
+        config_string += "compression_mode=active";
+        KVBucketTest::SetUp();
+        store->setVBucketState(vbid, vbucket_state_active, false);
+    }
+};
+
+// In active compression mode a value the client sent uncompressed should
+// be snappy-compressed on its way into the HashTable.
+TEST_F(CompressionModeTest, ActiveModeCompressesOnStore) {
+    // Repetitive data; guaranteed to compress well.
+    const std::string value(1024, 'x');
+    auto item = make_item(
+            vbid, {"key", DocNamespace::DefaultCollection}, value, 0, 0);
+    auto rv = engine->store_if(cookie, item, 0, OPERATION_SET, {});
+    EXPECT_EQ(cb::engine_errc::success, rv.status);
+
+    auto result = store->get({"key", DocNamespace::DefaultCollection},
+                             vbid,
+                             cookie,
+                             get_options_t());
+    ASSERT_EQ(ENGINE_SUCCESS, result.getStatus());
+    EXPECT_TRUE(mcbp::datatype::is_snappy(result.item->getDataType()));
+    EXPECT_LT(result.item->getNBytes(), value.size());
+}
+
 // Test cases which run for EP (Full and Value eviction) and Ephemeral
 INSTANTIATE_TEST_CASE_P(EphemeralOrPersistent,
                         KVBucketParamTest,
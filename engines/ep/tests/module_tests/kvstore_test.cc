@@ -31,6 +31,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <kvstore.h>
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 
@@ -264,6 +265,56 @@ TEST_F(CouchKVStoreTest, CompressedTest) {
     kvstore->destroyScanContext(scanCtx);
 }
 
+// Verify that a ScanOrder::BY_ID scan visits every document in ascending
+// key order, regardless of the order the mutations were made in.
+TEST_F(CouchKVStoreTest, ScanByIdOrderTest) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    kvstore->begin();
+
+    // Store keys in reverse key order so seqno order != key order.
+    WriteCallback wc;
+    int64_t seqno = 1;
+    for (int i = 5; i >= 1; i--) {
+        std::string key("key" + std::to_string(i));
+        Item item(makeStoredDocKey(key),
+                  0,
+                  0,
+                  "value",
+                  5,
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  seqno++);
+        kvstore->set(item, wc);
+    }
+    kvstore->commit(nullptr /*no collections manifest*/);
+
+    std::vector<std::string> keys;
+    auto cb = std::make_shared<CustomCallback<GetValue>>([&keys](GetValue gv) {
+        keys.push_back(std::string(
+                reinterpret_cast<const char*>(gv.item->getKey().data()),
+                gv.item->getKey().size()));
+    });
+    std::shared_ptr<Callback<CacheLookup> > cl(
+            new KVStoreTestCacheCallback(1, 5, 0));
+    ScanContext* scanCtx = kvstore->initScanContext(cb,
+                                                    cl,
+                                                    0,
+                                                    0,
+                                                    DocumentFilter::ALL_ITEMS,
+                                                    ValueFilter::VALUES_DECOMPRESSED,
+                                                    ScanOrder::BY_ID);
+
+    ASSERT_NE(nullptr, scanCtx);
+    EXPECT_EQ(scan_success, kvstore->scan(scanCtx));
+    kvstore->destroyScanContext(scanCtx);
+
+    ASSERT_EQ(5, keys.size());
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
 // Verify the stats returned from operations are accurate.
 TEST_F(CouchKVStoreTest, StatsTest) {
     KVStoreConfig config(
@@ -1059,7 +1110,7 @@ TEST_F(CouchKVStoreErrorInjectionTest, getAllKeys_all_docs) {
         EXPECT_CALL(ops, pread(_, _, _, _, _)).Times(3).RetiresOnSaturation();
 
 
-        kvstore->getAllKeys(0, start, 1, adcb);
+        kvstore->getAllKeys(0, start, makeStoredDocKey(""), 1, adcb);
     }
 }
 
@@ -1115,7 +1166,12 @@ public:
                      uint64_t rev,
                      MutationRequestCallback& cb,
                      bool del)
-        : CouchRequest(it, rev, cb, del, false /*persist namespace*/) {
+        : CouchRequest(it,
+                       rev,
+                       cb,
+                       del,
+                       false /*persist namespace*/,
+                       true /*compress at rest*/) {
     }
 
     ~MockCouchRequest() {}
@@ -1866,6 +1922,34 @@ TEST_P(KVStoreParamTest, BasicTest) {
     checkGetValue(gv);
 }
 
+// Test that getAllKeys stops at the (inclusive) end key, and only walks
+// the requested range.
+TEST_P(KVStoreParamTest, GetAllKeysRange) {
+    kvstore->begin();
+    WriteCallback wc;
+    for (int ii = 0; ii < 5; ii++) {
+        Item item(makeStoredDocKey("key" + std::to_string(ii)),
+                  0, 0, "value", 5);
+        kvstore->set(item, wc);
+    }
+    EXPECT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    std::vector<std::string> keys;
+    auto cb = std::make_shared<CustomCallback<const DocKey&>>(
+            [&keys](const DocKey& key) {
+                keys.push_back(std::string(
+                        reinterpret_cast<const char*>(key.data()),
+                        key.size()));
+            });
+    EXPECT_EQ(ENGINE_SUCCESS,
+              kvstore->getAllKeys(0,
+                                  makeStoredDocKey("key1"),
+                                  makeStoredDocKey("key3"),
+                                  100,
+                                  cb));
+    EXPECT_EQ((std::vector<std::string>{"key1", "key2", "key3"}), keys);
+}
+
 TEST_P(KVStoreParamTest, TestPersistenceCallbacksForSet) {
     kvstore->begin();
 
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Unit tests for the LatencyPacer - the closed-loop pacing signal which
+ * background visitor tasks use to scale their chunk budgets against
+ * front-end latency.
+ */
+
+#include "latency_pacer.h"
+
+#include "stats.h"
+
+#include <gtest/gtest.h>
+
+class LatencyPacerTest : public ::testing::Test {
+protected:
+    /// Record `count` front-end get operations taking `latency`.
+    void addGets(hrtime_t latency, size_t count) {
+        stats.getCmdHisto.add(latency, count);
+    }
+
+    EPStats stats;
+    LatencyPacer pacer{stats};
+    const std::chrono::milliseconds nominal{20};
+};
+
+// With no front-end traffic at all tasks should get their full chunk -
+// an idle node is the best time for background hygiene.
+TEST_F(LatencyPacerTest, IdleNodeGetsFullChunk) {
+    pacer.sample(/*force*/ true);
+    EXPECT_EQ(1.0, pacer.getPressure());
+    EXPECT_EQ(nominal, pacer.paceChunkDuration(nominal));
+}
+
+// Steady latency across windows keeps pressure at the baseline.
+TEST_F(LatencyPacerTest, SteadyLatencyGetsFullChunk) {
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+
+    EXPECT_EQ(1.0, pacer.getPressure());
+    EXPECT_EQ(nominal, pacer.paceChunkDuration(nominal));
+}
+
+// A severely degraded window should push pressure past the backoff
+// threshold and pace the chunk to zero.
+TEST_F(LatencyPacerTest, DegradedLatencyBacksOff) {
+    // Establish a quiet baseline...
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+    // ... then a window which is orders of magnitude slower.
+    addGets(1000000000, 1000);
+    pacer.sample(/*force*/ true);
+
+    EXPECT_GE(pacer.getPressure(), LatencyPacer::backoffThreshold);
+    EXPECT_EQ(std::chrono::milliseconds::zero(),
+              pacer.paceChunkDuration(nominal));
+}
+
+// Once latency returns to the baseline the pacer should hand back the
+// full chunk (catch-up after the incident).
+TEST_F(LatencyPacerTest, RecoveryRestoresFullChunk) {
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+    addGets(1000000000, 1000);
+    pacer.sample(/*force*/ true);
+    ASSERT_GE(pacer.getPressure(), LatencyPacer::backoffThreshold);
+
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+
+    EXPECT_EQ(1.0, pacer.getPressure());
+    EXPECT_EQ(nominal, pacer.paceChunkDuration(nominal));
+}
+
+// A window with too few operations cannot produce a trustworthy p99 -
+// treat the node as quiet rather than reacting to a handful of slow ops.
+TEST_F(LatencyPacerTest, SparseWindowTreatedAsQuiet) {
+    addGets(1000, 1000);
+    pacer.sample(/*force*/ true);
+    addGets(1000000000, LatencyPacer::minWindowOps - 1);
+    pacer.sample(/*force*/ true);
+
+    EXPECT_EQ(1.0, pacer.getPressure());
+    EXPECT_EQ(nominal, pacer.paceChunkDuration(nominal));
+}
@@ -323,12 +323,15 @@ TEST_F(MutationLogTest, LoggingBadCRC) {
         EXPECT_EQ(2, ml.itemsLogged[int(MutationLogType::Commit2)]);
     }
 
-    // Break the log
+    // Break the log - flip a byte inside the first block's compressed
+    // payload (the header region occupies the first MIN_LOG_HEADER_SIZE
+    // bytes).
+    const off_t corruptPos = MIN_LOG_HEADER_SIZE + V4_BLOCK_HEADER;
     int file = open(tmp_log_filename.c_str(), O_RDWR, FilePerms::Read | FilePerms::Write);
-    EXPECT_EQ(5000, lseek(file, 5000, SEEK_SET));
+    EXPECT_EQ(corruptPos, lseek(file, corruptPos, SEEK_SET));
     uint8_t b;
     EXPECT_EQ(1, read(file, &b, sizeof(b)));
-    EXPECT_EQ(5000, lseek(file, 5000, SEEK_SET));
+    EXPECT_EQ(corruptPos, lseek(file, corruptPos, SEEK_SET));
     b = ~b;
     EXPECT_EQ(1, write(file, &b, sizeof(b)));
     close(file);
@@ -387,8 +390,10 @@ TEST_F(MutationLogTest, LoggingShortRead) {
         EXPECT_EQ(2, ml.itemsLogged[int(MutationLogType::Commit2)]);
     }
 
-    // Break the log
-    EXPECT_EQ(0, truncate(tmp_log_filename.c_str(), 5000));
+    // Break the log - cut the final byte off the last block's payload.
+    struct stat st;
+    EXPECT_EQ(0, stat(tmp_log_filename.c_str(), &st));
+    EXPECT_EQ(0, truncate(tmp_log_filename.c_str(), st.st_size - 1));
 
     {
         MutationLog ml(tmp_log_filename.c_str());
@@ -506,6 +511,42 @@ TEST_F(MutationLogTest, BatchLoad) {
     }
 }
 
+// V4 logs compress each block; check that a multi-block log round-trips
+// and actually takes less space on disk than the raw entries it holds.
+TEST_F(MutationLogTest, CompressedBlocks) {
+    const size_t items = 1000;
+    size_t rawBytes = 0;
+
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        EXPECT_EQ(int(MutationLogVersion::Current), int(ml.header().version()));
+
+        for (size_t ii = 0; ii < items; ii++) {
+            std::string key = "mykey" + std::to_string(ii);
+            rawBytes += MutationLogEntry::len(key.size());
+            ml.newItem(ii % 2, makeStoredDocKey(key));
+        }
+        ml.commit1();
+        ml.commit2();
+    }
+
+    struct stat st;
+    ASSERT_EQ(0, stat(tmp_log_filename.c_str(), &st));
+    EXPECT_LT(st.st_size, off_t(MIN_LOG_HEADER_SIZE + rawBytes));
+
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        MutationLogHarvester h(ml);
+        h.setVBucket(0);
+        h.setVBucket(1);
+
+        EXPECT_TRUE(h.load());
+        EXPECT_EQ(items, h.getItemsSeen()[int(MutationLogType::New)]);
+    }
+}
+
 // @todo
 //   Test Read Only log
 //   Test close / open / close / open
@@ -646,3 +687,15 @@ TEST_F(MutationLogTest, upgrade) {
         }
     }
 }
+
+// Known-answer check for the CRC-32C used by V3 log blocks; must agree
+// between the hardware and table implementations, whichever this host runs.
+TEST(MutationLogCRC32C, knownAnswer) {
+    uint8_t check[] = "123456789";
+    EXPECT_EQ(0xe3069283, crc32cbuf(check, sizeof(check) - 1));
+
+    // And differs from the original CRC-32 (a V3 block checksum is not
+    // interchangeable with a V2 one).
+    EXPECT_NE(crc32buf(check, sizeof(check) - 1),
+              crc32cbuf(check, sizeof(check) - 1));
+}
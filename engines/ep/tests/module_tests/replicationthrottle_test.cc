@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the ReplicationThrottle.
+ */
+
+#include "configuration.h"
+#include "replicationthrottle.h"
+#include "stats.h"
+
+#include <gtest/gtest.h>
+
+class ReplicationThrottleTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        stats.setMaxDataSize(100 * 1024 * 1024);
+        stats.replicationThrottleThreshold.store(1.0);
+        // Disable the write queue gate; these tests only exercise the
+        // memory based shaping.
+        stats.replicationThrottleWriteQueueCap.store(-1);
+        throttle = std::make_unique<ReplicationThrottle>(config, stats);
+    }
+
+    /// Set memory used to the given fraction of the hard memory gate.
+    void setMemoryPressure(double fraction) {
+        const double gate = stats.getMaxDataSize() *
+                            stats.replicationThrottleThreshold;
+        stats.currentSize.store(static_cast<size_t>(gate * fraction) -
+                                stats.memOverhead->load());
+    }
+
+    /// Count Process decisions from `calls` invocations of getStatus().
+    size_t countProcessed(size_t calls) {
+        size_t processed = 0;
+        for (size_t ii = 0; ii < calls; ii++) {
+            if (throttle->getStatus() ==
+                ReplicationThrottle::Status::Process) {
+                processed++;
+            }
+        }
+        return processed;
+    }
+
+    EPStats stats;
+    Configuration config;
+    std::unique_ptr<ReplicationThrottle> throttle;
+};
+
+// With no memory pressure every call should be allowed through and the
+// apply ratio should stay at 100%.
+TEST_F(ReplicationThrottleTest, FullRateWhenIdle) {
+    setMemoryPressure(0.5);
+    EXPECT_EQ(100, countProcessed(100));
+    EXPECT_EQ(100, throttle->getApplyRatio());
+}
+
+// Above the hard memory gate every call must pause.
+TEST_F(ReplicationThrottleTest, HardGatePauses) {
+    setMemoryPressure(1.1);
+    EXPECT_EQ(0, countProcessed(100));
+    EXPECT_GE(throttle->getNumThrottled(), 100u);
+}
+
+// Between the soft-start point and the hard gate the ratio should ramp
+// down and a mix of Process and Pause should be handed out.
+TEST_F(ReplicationThrottleTest, ShapesBeforeCliff) {
+    setMemoryPressure(0.95);
+    // Let the ratio step down to its target for this pressure.
+    countProcessed(10);
+    const size_t ratio = throttle->getApplyRatio();
+    EXPECT_LT(ratio, 100);
+    EXPECT_GE(ratio, 10);
+
+    const size_t processed = countProcessed(200);
+    EXPECT_GT(processed, 0);
+    EXPECT_LT(processed, 200);
+}
+
+// Once memory recovers the ratio should climb back to 100% and calls
+// flow freely again.
+TEST_F(ReplicationThrottleTest, RecoversSmoothly) {
+    setMemoryPressure(0.95);
+    countProcessed(10);
+    ASSERT_LT(throttle->getApplyRatio(), 100);
+
+    setMemoryPressure(0.5);
+    // Each adjustment moves the ratio at most one step, so recovery
+    // takes several calls.
+    countProcessed(20);
+    EXPECT_EQ(100, throttle->getApplyRatio());
+    EXPECT_EQ(100, countProcessed(100));
+}
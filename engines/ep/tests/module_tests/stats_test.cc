@@ -87,6 +87,27 @@ TEST_F(StatTest, vbucket_seqno_stats_test) {
             Pair(vbucket + ":last_persisted_snap_end", "0")));
 }
 
+// Check the "scheduler-profile" percentile summary of the queue-wait and
+// runtime histograms.
+TEST_F(StatTest, SchedulerProfileStats) {
+    // Record a known queue-wait and runtime against one task type.
+    store->logQTime(TaskId::FlusherTask, std::chrono::milliseconds(10));
+    store->logRunTime(TaskId::FlusherTask, std::chrono::milliseconds(20));
+
+    auto vals = get_stat("scheduler-profile");
+
+    ASSERT_NE(0u, vals.count("FlusherTask:wait:p50"));
+    ASSERT_NE(0u, vals.count("FlusherTask:wait:p99"));
+    ASSERT_NE(0u, vals.count("FlusherTask:run:max"));
+
+    // The reported percentiles (in microseconds) must cover the samples.
+    EXPECT_GE(std::stoull(vals["FlusherTask:wait:p99"]), 10000ull);
+    EXPECT_GE(std::stoull(vals["FlusherTask:run:max"]), 20000ull);
+
+    // A task type which has never run reports zero.
+    EXPECT_EQ("0", vals["WarmupInitialize:wait:p50"]);
+}
+
 // Test that if we request takeover stats for stream that does not exist we
 // return does_not_exist.
 TEST_F(StatTest, vbucket_takeover_stats_no_stream) {
@@ -140,6 +161,27 @@ TEST_F(StatTest, vbucket_takeover_stats_stream_not_active) {
 }
 
 
+class AggStatSnapshotTest : public StatTest {
+protected:
+    void SetUp() override {
+        config_string += "agg_stat_snapshot_max_age=600";
+        StatTest::SetUp();
+    }
+};
+
+TEST_F(AggStatSnapshotTest, ServedFromSnapshotWhileFresh) {
+    auto vals = get_stat(nullptr);
+    EXPECT_EQ("0", vals["curr_items"]);
+
+    store_item(vbid, makeStoredDocKey("key"), "value");
+
+    // While the snapshot is younger than agg_stat_snapshot_max_age the
+    // aggregated stats are served from it without re-visiting the
+    // vBuckets, so the new item must not be visible yet.
+    vals = get_stat(nullptr);
+    EXPECT_EQ("0", vals["curr_items"]);
+}
+
 TEST_P(DatatypeStatTest, datatypesInitiallyZero) {
     // Check that the datatype stats initialise to 0
     auto vals = get_stat(nullptr);
@@ -71,6 +71,33 @@ TEST_P(StoredDocKeyTest, copy_constructor) {
     EXPECT_EQ(key1, key2);
 }
 
+// Keys longer than the inline buffer are stored on the heap; check that
+// both representations behave the same (and interchange correctly).
+TEST_P(StoredDocKeyTest, long_key) {
+    std::string longKey(100, 'x');
+    StoredDocKey key1(longKey, GetParam());
+    EXPECT_EQ(longKey.size(), key1.size());
+    EXPECT_EQ(0, std::memcmp(longKey.data(), key1.data(), key1.size()));
+    EXPECT_EQ(GetParam(), key1.getDocNamespace());
+    EXPECT_EQ(0, key1.data()[key1.size()]);
+
+    // Copy a long key.
+    StoredDocKey key2(key1);
+    EXPECT_EQ(key1, key2);
+    EXPECT_NE(key1.data(), key2.data());
+
+    // Assign a long key over a short one, and a short key over a long one.
+    StoredDocKey key3("key", GetParam());
+    key3 = key1;
+    EXPECT_EQ(key1, key3);
+    key2 = StoredDocKey("key", GetParam());
+    EXPECT_EQ(StoredDocKey("key", GetParam()), key2);
+
+    // Move a long key.
+    StoredDocKey key4(std::move(key3));
+    EXPECT_EQ(key1, key4);
+}
+
 TEST_P(StoredDocKeyTest, assignment) {
     StoredDocKey key1("key1", GetParam());
     StoredDocKey key2("anotherkey", GetParam());
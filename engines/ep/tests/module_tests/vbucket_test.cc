@@ -536,6 +536,42 @@ TEST_P(VBucketEvictionTest, EjectionResidentCount) {
     EXPECT_EQ(1, this->vbucket->getNumNonResidentItems());
 }
 
+// In full eviction pageOut() proceeds in two stages: the first call on a
+// resident item only ejects the value (metadata stays in the HashTable, as
+// in value eviction) and only a subsequent call on the now non-resident item
+// removes the whole StoredValue. In value eviction the second call is a
+// no-op.
+TEST_P(VBucketEvictionTest, TwoStagePageOut) {
+    const auto eviction_policy = GetParam();
+    Item item(makeStoredDocKey("key"), /*flags*/0, /*exp*/0,
+              "value", strlen("value"));
+    ASSERT_EQ(MutationStatus::WasClean,
+              this->public_processSet(item, item.getCas()));
+
+    auto lock_sv = lockAndFind(makeStoredDocKey("key"));
+    auto* v = lock_sv.second;
+    ASSERT_NE(nullptr, v);
+    // Need to clear the dirty flag to allow it to be ejected.
+    v->markClean();
+
+    // First pageOut - only the value is ejected; metadata stays resident.
+    EXPECT_TRUE(this->vbucket->pageOut(lock_sv.first, v));
+    EXPECT_EQ(1, this->vbucket->getNumItems());
+    EXPECT_EQ(1, this->vbucket->getNumNonResidentItems());
+
+    if (eviction_policy == VALUE_ONLY) {
+        // Value eviction cannot page out a non-resident item.
+        EXPECT_FALSE(this->vbucket->pageOut(lock_sv.first, v));
+        EXPECT_EQ(1, this->vbucket->getNumItems());
+        EXPECT_EQ(1, this->vbucket->getNumNonResidentItems());
+    } else {
+        // Second pageOut removes the whole StoredValue.
+        EXPECT_TRUE(this->vbucket->pageOut(lock_sv.first, v));
+        EXPECT_EQ(0, this->vbucket->getNumItems());
+        EXPECT_EQ(0, this->vbucket->getNumNonResidentItems());
+    }
+}
+
 // Regression test for MB-21448 - if an attempt is made to perform a CAS
 // operation on a logically deleted item we should return NOT_FOUND
 // (aka KEY_ENOENT) and *not* INVALID_CAS (aka KEY_EEXISTS).
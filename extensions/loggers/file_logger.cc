@@ -8,7 +8,10 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <errno.h>
+#include <atomic>
 #include <mutex>
+#include <new>
+#include <vector>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -72,6 +75,9 @@ static struct logbuffer {
 /* The index in the buffers where we're currently inserting more data */
 static int currbuffer = 0;
 
+/* Is the logger thread still running (and draining the rings)? */
+static volatile int run = 1;
+
 /* Are we running in a unit test (don't print warnings to stderr) */
 static bool unit_test = false;
 
@@ -176,10 +182,11 @@ static void flush_last_log(bool timebased) {
     }
 }
 
-static void add_log_entry(time_t now, const char *msg, int prefixlen, size_t size)
+/* The deduplication and insertion into the shared buffer; must be
+ * called with the mutex held */
+static void add_log_entry_locked(time_t now, const char *msg, int prefixlen,
+                                 size_t size)
 {
-    cb_mutex_enter(&mutex);
-
     if (size < sizeof(lastlog.buffer)) {
         if (memcmp(lastlog.buffer + lastlog.offset, msg + prefixlen, size-prefixlen) == 0) {
             ++lastlog.count;
@@ -194,10 +201,237 @@ static void add_log_entry(time_t now, const char *msg, int prefixlen, size_t siz
         flush_last_log(false);
         do_add_log_entry(msg, size);
     }
+}
 
+static void add_log_entry(time_t now, const char *msg, int prefixlen, size_t size)
+{
+    cb_mutex_enter(&mutex);
+    add_log_entry_locked(now, msg, prefixlen, size);
     cb_mutex_exit(&mutex);
 }
 
+/*
+ * To keep a log call on the frontend threads cheap, each thread which
+ * logs gets its own ring of formatted messages which is drained by the
+ * logger thread, so the data path never touches the mutex guarding the
+ * shared buffers (or waits for the disk). The message still has to be
+ * formatted by the producer; the arguments (%s strings in particular)
+ * typically point at stack data which is long gone by the time the
+ * logger thread gets around to the entry. If a ring fills up (the
+ * logger thread can't keep up) the producer falls back to the old
+ * locked path.
+ */
+struct LogRing {
+    /* The capacity of each ring */
+    static const size_t SIZE = 64 * 1024;
+
+    /* Total number of bytes published to the ring. Only written by the
+     * owning thread; read by the logger thread */
+    std::atomic<uint64_t> write_head{0};
+
+    /* Total number of bytes consumed from the ring. Only written by
+     * the logger thread */
+    std::atomic<uint64_t> read_head{0};
+
+    /* Set by the owning thread when it exits; the logger thread frees
+     * the ring once it has been fully drained */
+    std::atomic<bool> retired{false};
+
+    /* The ring data (SIZE bytes allocated with cb_malloc) */
+    char* data;
+};
+
+/* The fixed header in front of each message stored in a ring */
+struct LogRecordHeader {
+    /* The number of message bytes following the header */
+    uint32_t size;
+    /* The length of the timestamp / severity prefix (for the dedupe) */
+    int32_t prefixlen;
+    /* The time the message was generated */
+    time_t time;
+};
+
+/* Stored instead of a record size when the remainder of the ring is
+ * too small to hold the next record and the producer had to wrap
+ * around to the start */
+static const uint32_t ring_wrap_marker = 0xffffffff;
+
+/* All the rings handed out to threads. Only touched when a thread logs
+ * for the first time (and by the logger thread when draining) */
+static std::mutex ring_registry_mutex;
+static std::vector<LogRing*> ring_registry;
+
+/* Marks the calling thread's ring as retired when the thread exits so
+ * that the logger thread can free it once drained */
+struct LogRingHolder {
+    ~LogRingHolder() {
+        if (ring != nullptr) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+    LogRing* ring = nullptr;
+};
+
+static thread_local LogRingHolder thread_ring;
+
+static LogRing* get_thread_ring(void) {
+    if (thread_ring.ring == nullptr) {
+        auto* ring = new (std::nothrow) LogRing;
+        if (ring == nullptr) {
+            return nullptr;
+        }
+        ring->data = reinterpret_cast<char*>(cb_malloc(LogRing::SIZE));
+        if (ring->data == nullptr) {
+            delete ring;
+            return nullptr;
+        }
+        try {
+            std::lock_guard<std::mutex> guard(ring_registry_mutex);
+            ring_registry.push_back(ring);
+        } catch (const std::bad_alloc&) {
+            cb_free(ring->data);
+            delete ring;
+            return nullptr;
+        }
+        thread_ring.ring = ring;
+    }
+    return thread_ring.ring;
+}
+
+/* Try to copy a formatted message into the ring owned by the calling
+ * thread. Returns false if there isn't room for it */
+static bool ring_publish(LogRing* ring, time_t now, const char* msg,
+                         int prefixlen, size_t size) {
+    LogRecordHeader header;
+    header.size = uint32_t(size);
+    header.prefixlen = prefixlen;
+    header.time = now;
+
+    const uint64_t wr = ring->write_head.load(std::memory_order_relaxed);
+    const uint64_t rd = ring->read_head.load(std::memory_order_acquire);
+    size_t offset = size_t(wr % LogRing::SIZE);
+    const size_t needed = sizeof(header) + size;
+
+    /* If the record won't fit contiguously we have to skip ahead to
+     * the start of the ring (leaving a wrap marker if there's room
+     * for one; if not the consumer knows to skip the tail) */
+    size_t skip = 0;
+    if (needed > LogRing::SIZE - offset) {
+        skip = LogRing::SIZE - offset;
+    }
+
+    if ((wr + skip + needed) - rd > LogRing::SIZE) {
+        /* Not enough free space */
+        return false;
+    }
+
+    if (skip > 0) {
+        if (skip >= sizeof(ring_wrap_marker)) {
+            memcpy(ring->data + offset, &ring_wrap_marker,
+                   sizeof(ring_wrap_marker));
+        }
+        offset = 0;
+    }
+
+    memcpy(ring->data + offset, &header, sizeof(header));
+    memcpy(ring->data + offset + sizeof(header), msg, size);
+    ring->write_head.store(wr + skip + needed, std::memory_order_release);
+    return true;
+}
+
+/* The frontend side of a log call: stash the formatted message in the
+ * calling thread's ring. Returns false if the message couldn't be
+ * queued and the caller has to use the locked path */
+static bool ring_log_entry(time_t now, const char* msg, int prefixlen,
+                           size_t size) {
+    if (!run) {
+        /* The logger thread is no longer draining the rings */
+        return false;
+    }
+
+    LogRing* ring = get_thread_ring();
+    if (ring == nullptr || !ring_publish(ring, now, msg, prefixlen, size)) {
+        return false;
+    }
+
+    const uint64_t used = ring->write_head.load(std::memory_order_relaxed) -
+                          ring->read_head.load(std::memory_order_relaxed);
+    if (used > (LogRing::SIZE * 3) / 4) {
+        /* Ask the logger thread to start draining. Signalling the
+         * condition variable without holding the mutex is legal; the
+         * worst case is a missed wakeup and the messages wait for the
+         * next timed wakeup */
+        cb_cond_signal(&cond);
+    }
+    return true;
+}
+
+/*
+ * Drain the per-thread rings into the shared buffer. Must be called
+ * with the mutex held. Stops early when the shared buffer needs to be
+ * flushed to disk first (waiting for space in do_add_log_entry would
+ * deadlock, given that we're the thread which creates that space).
+ *
+ * @return true if every ring was fully drained
+ */
+static bool drain_log_rings(void) {
+    std::lock_guard<std::mutex> guard(ring_registry_mutex);
+
+    auto iter = ring_registry.begin();
+    while (iter != ring_registry.end()) {
+        LogRing* ring = *iter;
+        uint64_t rd = ring->read_head.load(std::memory_order_relaxed);
+        const uint64_t wr = ring->write_head.load(std::memory_order_acquire);
+
+        while (rd != wr) {
+            const size_t offset = size_t(rd % LogRing::SIZE);
+            uint32_t first;
+            if (LogRing::SIZE - offset < sizeof(first)) {
+                /* Unusable tail (too small for a wrap marker) */
+                rd += LogRing::SIZE - offset;
+                continue;
+            }
+            memcpy(&first, ring->data + offset, sizeof(first));
+            if (first == ring_wrap_marker) {
+                rd += LogRing::SIZE - offset;
+                continue;
+            }
+
+            LogRecordHeader header;
+            memcpy(&header, ring->data + offset, sizeof(header));
+
+            if (buffers[currbuffer].offset > (buffersz * 0.75) ||
+                (buffers[currbuffer].offset > 0 &&
+                 (buffers[currbuffer].offset + header.size + 512) >=
+                         buffersz)) {
+                /* Flush the shared buffer before pulling in more */
+                ring->read_head.store(rd, std::memory_order_release);
+                return false;
+            }
+
+            add_log_entry_locked(header.time,
+                                 ring->data + offset + sizeof(header),
+                                 header.prefixlen,
+                                 header.size);
+            rd += sizeof(header) + header.size;
+        }
+        ring->read_head.store(rd, std::memory_order_release);
+
+        if (ring->retired.load(std::memory_order_acquire) &&
+            rd == ring->write_head.load(std::memory_order_acquire)) {
+            /* The owning thread is gone and everything it logged is
+             * in the shared buffer */
+            cb_free(ring->data);
+            delete ring;
+            iter = ring_registry.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    return true;
+}
+
 static const char *severity2string(EXTENSION_LOG_LEVEL sev) {
     switch (sev) {
     case EXTENSION_LOG_FATAL:
@@ -291,7 +525,12 @@ static void syslog_event_receiver(SyslogEvent *event) {
         }
 
         if (severity >= current_log_level) {
-            add_log_entry(event->time, buffer, prefixlen, strlen(buffer));
+            const size_t size = strlen(buffer);
+            if (!ring_log_entry(event->time, buffer, prefixlen, size)) {
+                /* The ring is full (or unavailable); fall back to the
+                 * shared buffer which may block waiting for space */
+                add_log_entry(event->time, buffer, prefixlen, size);
+            }
         }
     }
 }
@@ -507,7 +746,6 @@ static void flush_all_buffers_to_file(FILE *file) {
     }
 }
 
-static volatile int run = 1;
 static cb_thread_t tid;
 static FILE *fp;
 
@@ -523,6 +761,11 @@ static void logger_thread_main(void* arg)
     while (run) {
         cb_get_timeofday(&tp);
 
+        /* Pull whatever the frontend threads have published in their
+         * rings into the shared buffer (if it fills up the loop below
+         * flushes it to disk and we drain some more) */
+        drain_log_rings();
+
         while ((time_t)tp.tv_sec >= next  ||
                buffers[currbuffer].offset > (buffersz * 0.75)) {
             int curr  = currbuffer;
@@ -561,6 +804,7 @@ static void logger_thread_main(void* arg)
                 currsize = 0;
             }
             cb_mutex_enter(&mutex);
+            drain_log_rings();
         }
 
         // Only run dedupe for ~5 seconds
@@ -578,6 +822,15 @@ static void logger_thread_main(void* arg)
         }
     }
 
+    /* Pull in anything still sitting in the per-thread rings,
+     * flushing the shared buffer whenever it fills up */
+    while (!drain_log_rings()) {
+        if (fp == NULL) {
+            fp = open_logfile(reinterpret_cast<const char*>(arg));
+        }
+        flush_all_buffers_to_file(fp);
+    }
+
     /* The log file might not be open, however we may have
      * an event in the buffer that needs flushing to a file.
      */
@@ -239,6 +239,30 @@ enum class ClientOpcode : uint8_t {
      */
     CollectionsSetManifest = 0xb9,
 
+    /**
+     * Command to fetch a batch of documents in a single request.
+     * The body contains (vbucket id, keylen, key) tuples; the
+     * response carries one entry per requested key.
+     */
+    MultiGet = 0xba,
+
+    /**
+     * Command to apply a batch of mutations with their metadata to a
+     * single vbucket (the one named in the request header). The body
+     * contains one entry per mutation; the response carries one status
+     * per entry.
+     */
+    MultiSetWithMeta = 0xbb,
+
+    /**
+     * Command to fetch an entire stats group as a single response
+     * frame instead of one tiny packet per stat. The request looks
+     * exactly like Stat; the response body is a sequence of
+     * (uint16_t keylen, key, uint32_t vallen, value) records with the
+     * lengths in network byte order.
+     */
+    StatBulk = 0xbc,
+
     /**
      * Commands for GO-XDCR
      */
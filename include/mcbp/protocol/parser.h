@@ -0,0 +1,160 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <mcbp/protocol/magic.h>
+#include <mcbp/protocol/request.h>
+#include <mcbp/protocol/response.h>
+#include <platform/sized_buffer.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace cb {
+namespace mcbp {
+
+/**
+ * A view of one complete frame located within the segments fed to a
+ * Parser. No frame bytes are copied; the body simply references the
+ * caller's segments (in arrival order), so a value which arrived across
+ * many TCP reads can be consumed without first being compacted into a
+ * contiguous allocation.
+ */
+struct FrameView {
+    /**
+     * The fixed 24 byte header. Always contiguous: it points either into
+     * the caller's segment, or (when the header itself straddled a
+     * segment boundary) into scratch space owned by the Parser which is
+     * only valid until the next call to next() / reset().
+     *
+     * Request and Response share the layout of the length fields, so the
+     * header is exposed as a Request; check getMagic() before using the
+     * fields which differ (vbucket / status).
+     */
+    const Request* header = nullptr;
+
+    /**
+     * The frame body (extras + key + value) in arrival order. Empty when
+     * the frame has no body; a single element when the body happened to
+     * arrive contiguously.
+     */
+    std::vector<cb::const_byte_buffer> body;
+
+    Magic getMagic() const {
+        return header->getMagic();
+    }
+
+    size_t getBodylen() const {
+        return header->getBodylen();
+    }
+
+    /// Total encoded size of the frame (header + body).
+    size_t getFrameLength() const {
+        return sizeof(Request) + getBodylen();
+    }
+
+    /// Did the body arrive in (at most) one segment?
+    bool isBodyContiguous() const {
+        return body.size() <= 1;
+    }
+};
+
+/**
+ * An incremental frame parser over a segmented input buffer.
+ *
+ * Raw network input is handed to the parser one segment at a time via
+ * feed(); next() then yields FrameViews for each complete frame without
+ * compacting the input. The only bytes ever copied are the (at most 24)
+ * header bytes of a frame whose header straddles a segment boundary.
+ *
+ * The parser references the fed segments rather than copying them; the
+ * caller must keep each segment alive until every frame overlapping it
+ * has been returned by next() (or the parser is reset()).
+ *
+ * Typical use:
+ *
+ *     Parser parser;
+ *     parser.feed({data, nbytes});    // for each read from the socket
+ *     FrameView frame;
+ *     while (parser.next(frame)) {
+ *         // dispatch frame
+ *     }
+ */
+class Parser {
+public:
+    /**
+     * Append a segment of input to the parser. The bytes are /not/
+     * copied; see the class comment for the lifetime requirements.
+     * Empty segments are ignored.
+     */
+    void feed(cb::const_byte_buffer segment);
+
+    /**
+     * Try to produce the next complete frame.
+     *
+     * @param view (out) filled in with the frame on success. The view is
+     *        valid until the segments backing it are released by the
+     *        caller (the header may additionally be invalidated by the
+     *        next call to next(); see FrameView::header).
+     * @return true if a complete frame was available.
+     * @throws std::runtime_error if the input contains an illegal magic
+     *         byte (the stream is garbage and resynchronisation is not
+     *         possible).
+     */
+    bool next(FrameView& view);
+
+    /// Number of bytes not yet returned as part of a complete frame.
+    size_t getRemaining() const {
+        return remaining;
+    }
+
+    /// Total number of bytes consumed (returned through next()) so far.
+    size_t getConsumed() const {
+        return consumed;
+    }
+
+    /// Drop all pending input (any partial frame is discarded).
+    void reset();
+
+protected:
+    /**
+     * Copy the (at most sizeof(Request)) header bytes which straddle the
+     * segment boundary into the scratch space and return a pointer to it.
+     */
+    const Request* assembleHeader();
+
+    /// Advance past `nbytes` of pending input, appending the spanned
+    /// ranges to `out` (if given) and releasing exhausted segments.
+    void advance(size_t nbytes, std::vector<cb::const_byte_buffer>* out);
+
+    /// Unconsumed input segments, in arrival order.
+    std::deque<cb::const_byte_buffer> segments;
+
+    /// Offset of the first unconsumed byte within segments.front().
+    size_t frontOffset = 0;
+
+    /// Scratch space for a header which straddles segments.
+    std::array<uint8_t, sizeof(Request)> headerScratch;
+
+    size_t remaining = 0;
+    size_t consumed = 0;
+};
+
+} // namespace mcbp
+} // namespace cb
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <cJSON_utils.h>
 #include <memcached/extension.h>
 #include <memcached/visibility.h>
 #include <platform/platform.h>
@@ -113,6 +114,25 @@ AUDIT_ERROR_CODE put_audit_event(Audit* handle,
                                  const void* payload,
                                  const size_t length);
 
+/**
+ * Put an audit event into the audit trail without serializing it to
+ * text on the calling thread. Ownership of the JSON tree is transferred
+ * to the audit daemon, which formats and writes the event from its own
+ * thread (a timestamp is added there if the payload doesn't have one).
+ *
+ * @param handle the audit daemon handle
+ * @param id The identifier for the event to insert
+ * @param event the payload for the event
+ * @return AUDIT_SUCCESS if the event was successfully added to the audit
+ *                       queue (may be dropped at a later time)
+ *         AUDIT_FAILED if an error occured while trying to insert the
+ *                      event to the audit queue.
+ */
+MEMCACHED_PUBLIC_API
+AUDIT_ERROR_CODE put_json_audit_event(Audit* handle,
+                                      uint32_t id,
+                                      unique_cJSON_ptr event);
+
 /**
  * Shut down the audit daemon
  *
@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <cstring>
 
+#include <platform/crc32c.h>
 #include <platform/sized_buffer.h>
 
 /**
@@ -69,16 +70,17 @@ struct DocKeyInterface {
     }
 
 protected:
+    /**
+     * Hash the first `bytes` bytes of the key with CRC32-C, seeded with
+     * the namespace so identical keys in different namespaces hash
+     * differently. crc32c() uses the SSE4.2 CRC32 instruction when the
+     * CPU supports it (selected once at runtime), falling back to a
+     * software implementation otherwise; the hash is only used in
+     * volatile data structures so the value needs no cross-version
+     * stability.
+     */
     uint32_t hash(size_t bytes) const {
-        uint32_t h = 5381;
-
-        h = ((h << 5) + h) ^ uint32_t(getDocNamespace());
-
-        for (size_t i = 0; i < bytes; i++) {
-            h = ((h << 5) + h) ^ uint32_t(data()[i]);
-        }
-
-        return h;
+        return crc32c(data(), bytes, uint32_t(getDocNamespace()));
     }
 };
 
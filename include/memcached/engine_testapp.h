@@ -8,6 +8,7 @@
 enum class OutputFormat {
     Text,
     XML,
+    JSON,
 };
 
 enum test_result {
@@ -391,6 +391,12 @@ const uint8_t PROTOCOL_BINARY_CMD_GET_KEYS =
         uint8_t(cb::mcbp::ClientOpcode::GetKeys);
 const uint8_t PROTOCOL_BINARY_CMD_COLLECTIONS_SET_MANIFEST =
         uint8_t(cb::mcbp::ClientOpcode::CollectionsSetManifest);
+const uint8_t PROTOCOL_BINARY_CMD_MULTI_GET =
+        uint8_t(cb::mcbp::ClientOpcode::MultiGet);
+const uint8_t PROTOCOL_BINARY_CMD_MULTI_SET_WITH_META =
+        uint8_t(cb::mcbp::ClientOpcode::MultiSetWithMeta);
+const uint8_t PROTOCOL_BINARY_CMD_STAT_BULK =
+        uint8_t(cb::mcbp::ClientOpcode::StatBulk);
 const uint8_t PROTOCOL_BINARY_CMD_SET_DRIFT_COUNTER_STATE =
         uint8_t(cb::mcbp::ClientOpcode::SetDriftCounterState);
 const uint8_t PROTOCOL_BINARY_CMD_GET_ADJUSTED_TIME =
@@ -320,7 +320,9 @@ protected:
  * Create a new PrivilegeContext for the specified user in the specified
  * bucket.
  *
- * @todo this might starve the writers?
+ * The lookup is performed on an immutable snapshot of the privilege
+ * database and never blocks (concurrent reloads publish a new snapshot
+ * rather than modifying the one being read).
  *
  * @param user The name of the user
  * @param bucket The name of the bucket (may be "" if you're not
@@ -334,6 +336,16 @@ RBAC_PUBLIC_API
 PrivilegeContext createContext(const std::string& user,
                                const std::string& bucket);
 
+/**
+ * Get the generation of the currently installed privilege database.
+ *
+ * A privilege context (and anything derived from it, such as cached
+ * privilege check verdicts) is only valid as long as its generation
+ * matches this value.
+ */
+RBAC_PUBLIC_API
+uint32_t getGeneration();
+
 /**
  * Create the initial context for a given user
  *
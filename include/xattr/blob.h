@@ -20,6 +20,7 @@
 #include <cstddef>
 #include <memory>
 #include <platform/sized_buffer.h>
+#include <vector>
 #include <xattr/visibility.h>
 
 namespace cb {
@@ -271,11 +272,41 @@ protected:
     void remove_segment(const size_t offset, const size_t size);
 
 private:
+    /**
+     * An entry in the key index: where a kv-pair starts within the
+     * blob, and the length of its key.
+     */
+    struct IndexEntry {
+        uint32_t offset;
+        uint32_t keylen;
+    };
+
+    /**
+     * (Re)build the key index with a single scan of the blob. The
+     * entries are sorted by key so that get() may use a binary search
+     * instead of rescanning the blob for every lookup (documents may
+     * carry 10+ xattrs, and a single subdoc command looks up multiple
+     * keys).
+     */
+    void build_index() const;
+
+    /// Get the key an index entry refers to
+    cb::const_byte_buffer entry_key(const IndexEntry& entry) const {
+        return {blob.buf + entry.offset + 4, entry.keylen};
+    }
+
     cb::byte_buffer blob;
 
     std::unique_ptr<uint8_t[]>& allocator;
     std::unique_ptr<uint8_t[]> default_allocator;
     size_t alloc_size;
+
+    /**
+     * The lazily built key index. Mutations which move data within the
+     * blob invalidate it; it is rebuilt by the next lookup.
+     */
+    mutable std::vector<IndexEntry> index;
+    mutable bool index_valid = false;
 };
 
 inline bool operator==(const Blob::iterator& lhs, const Blob::iterator& rhs) {
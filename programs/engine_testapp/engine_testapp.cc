@@ -3,12 +3,19 @@
 
 #include <memcached/engine_testapp.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
 #include <cstdlib>
 #include <getopt.h>
 #include <map>
 #include <platform/make_unique.h>
+#include <random>
 #include <regex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <functional>
 
@@ -749,6 +756,13 @@ static void usage(void) {
     printf("-v                           verbose output\n");
     printf("-X                           Use stderr logger instead of /dev/zero\n");
     printf("-n                           Regex specifying name(s) of test(s) to run\n");
+    printf("-W <workload_spec>           Run the built-in workload generator\n");
+    printf("                             against the engine instead of a\n");
+    printf("                             testsuite. The specification uses the\n");
+    printf("                             engine config format, e.g.\n");
+    printf("                             \"threads=4;keys=100000;zipf=0.99;\n");
+    printf("                             read_ratio=0.8;value_size=256:2048;\n");
+    printf("                             duration=10;vbuckets=4\"\n");
 }
 
 static int report_test(const char *name,
@@ -1224,6 +1238,379 @@ static void teardown_testsuite(cb_dlhandle_t handle, const char* test_suite) {
     }
 }
 
+/*
+ * Workload generator mode (-W).
+ *
+ * Instead of loading a testsuite, drive the engine interface directly with
+ * a synthetic workload and report throughput plus latency percentiles.
+ * The workload is described with the same "key=value;..." format as the
+ * engine configuration:
+ *
+ *   threads=N        number of client threads (default 4)
+ *   keys=N           number of distinct keys (default 100000)
+ *   value_size=N[:M] value size, picked uniformly from [N, M] (default 256)
+ *   zipf=S           zipfian skew of the key popularity; 0 means uniform
+ *                    (default 0.99)
+ *   read_ratio=R     fraction of operations which are gets (default 0.8)
+ *   duration=N       length of the measured phase in seconds (default 10)
+ *   vbuckets=N       spread the keys over N active vbuckets (default 1)
+ *
+ * All keys are preloaded before the measured phase so that gets don't
+ * just measure the miss path. Note that the engine interface is
+ * synchronous (the mock cookie blocks on EWOULDBLOCK), so there is no
+ * notion of pipelining depth; concurrency comes from the thread count.
+ */
+struct WorkloadConfig {
+    size_t threads = 4;
+    size_t keys = 100000;
+    size_t value_min = 256;
+    size_t value_max = 256;
+    double zipf = 0.99;
+    double read_ratio = 0.8;
+    int duration = 10;
+    uint16_t vbuckets = 1;
+};
+
+static bool parse_workload_config(const char* spec, WorkloadConfig& config) {
+    std::string str(spec);
+    while (!str.empty()) {
+        const auto semi = str.find(';');
+        std::string token = str.substr(0, semi);
+        str.erase(0, semi == std::string::npos ? std::string::npos : semi + 1);
+        if (token.empty()) {
+            continue;
+        }
+
+        const auto eq = token.find('=');
+        if (eq == std::string::npos) {
+            fprintf(stderr, "Malformed workload parameter \"%s\"\n",
+                    token.c_str());
+            return false;
+        }
+        const std::string key = token.substr(0, eq);
+        const std::string value = token.substr(eq + 1);
+
+        try {
+            if (key == "threads") {
+                config.threads = std::stoul(value);
+            } else if (key == "keys") {
+                config.keys = std::stoul(value);
+            } else if (key == "value_size") {
+                const auto colon = value.find(':');
+                config.value_min = std::stoul(value.substr(0, colon));
+                if (colon == std::string::npos) {
+                    config.value_max = config.value_min;
+                } else {
+                    config.value_max = std::stoul(value.substr(colon + 1));
+                }
+            } else if (key == "zipf") {
+                config.zipf = std::stod(value);
+            } else if (key == "read_ratio") {
+                config.read_ratio = std::stod(value);
+            } else if (key == "duration") {
+                config.duration = std::stoi(value);
+            } else if (key == "vbuckets") {
+                config.vbuckets = static_cast<uint16_t>(std::stoul(value));
+            } else {
+                fprintf(stderr, "Unknown workload parameter \"%s\"\n",
+                        key.c_str());
+                return false;
+            }
+        } catch (const std::exception&) {
+            fprintf(stderr, "Invalid value \"%s\" for workload parameter "
+                    "\"%s\"\n", value.c_str(), key.c_str());
+            return false;
+        }
+    }
+
+    if (config.threads == 0 || config.keys == 0 || config.duration <= 0 ||
+        config.vbuckets == 0 || config.value_max < config.value_min ||
+        config.read_ratio < 0.0 || config.read_ratio > 1.0) {
+        fprintf(stderr, "Invalid workload configuration\n");
+        return false;
+    }
+    return true;
+}
+
+/* Picks key indexes with a zipfian popularity distribution by inverting
+ * a precomputed CDF. A skew of 0 degenerates to a uniform pick. */
+class ZipfGenerator {
+public:
+    ZipfGenerator(size_t items, double skew) : cdf(items) {
+        double sum = 0.0;
+        for (size_t ii = 0; ii < items; ++ii) {
+            sum += 1.0 / std::pow(double(ii + 1), skew);
+            cdf[ii] = sum;
+        }
+        for (auto& entry : cdf) {
+            entry /= sum;
+        }
+    }
+
+    template <class Generator>
+    size_t operator()(Generator& generator) {
+        const double point = uniform(generator);
+        return std::lower_bound(cdf.begin(), cdf.end(), point) - cdf.begin();
+    }
+
+private:
+    std::vector<double> cdf;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+};
+
+static bool workload_add_response(const void*, uint16_t, const void*, uint8_t,
+                                  const void*, uint32_t, uint8_t, uint16_t,
+                                  uint64_t, const void*) {
+    return true;
+}
+
+/* Make the vbuckets the generator will use active. Engines without a
+ * vbucket concept (e.g. the default engine) don't implement the command;
+ * they accept operations on any vbucket so failures are ignored. */
+static void workload_set_vbucket_states(const WorkloadConfig& config) {
+    if (handle_v1->unknown_command == NULL) {
+        return;
+    }
+
+    for (uint16_t vb = 0; vb < config.vbuckets; ++vb) {
+        protocol_binary_request_set_vbucket request;
+        memset(&request, 0, sizeof(request));
+        request.message.header.request.magic = PROTOCOL_BINARY_REQ;
+        request.message.header.request.opcode = PROTOCOL_BINARY_CMD_SET_VBUCKET;
+        request.message.header.request.vbucket = htons(vb);
+        request.message.header.request.extlen = sizeof(vbucket_state_t);
+        request.message.header.request.bodylen = htonl(sizeof(vbucket_state_t));
+        request.message.body.state =
+                static_cast<vbucket_state_t>(htonl(vbucket_state_active));
+
+        const void* cookie = create_mock_cookie();
+        handle_v1->unknown_command(handle, cookie,
+                                   &request.message.header,
+                                   workload_add_response,
+                                   DocNamespace::DefaultCollection);
+        destroy_mock_cookie(cookie);
+    }
+}
+
+static std::string workload_key(size_t index) {
+    return "key" + std::to_string(index);
+}
+
+static ENGINE_ERROR_CODE workload_store(const void* cookie,
+                                        const std::string& key,
+                                        uint16_t vbucket,
+                                        const char* value,
+                                        size_t nvalue) {
+    DocKey docKey(reinterpret_cast<const uint8_t*>(key.data()), key.size(),
+                  DocNamespace::DefaultCollection);
+    auto allocated = handle_v1->allocate(handle, cookie, docKey, nvalue,
+                                         0, 0, PROTOCOL_BINARY_RAW_BYTES,
+                                         vbucket);
+    if (allocated.first != cb::engine_errc::success) {
+        return ENGINE_ERROR_CODE(allocated.first);
+    }
+
+    item_info info;
+    if (!handle_v1->get_item_info(handle, cookie, allocated.second.get(),
+                                  &info)) {
+        return ENGINE_FAILED;
+    }
+    memcpy(info.value[0].iov_base, value, nvalue);
+
+    uint64_t cas = 0;
+    return handle_v1->store(handle, cookie, allocated.second.get(), &cas,
+                            OPERATION_SET, DocumentState::Alive);
+}
+
+static void workload_preload(const WorkloadConfig& config, size_t thread_id,
+                             std::atomic<bool>& failed) {
+    const void* cookie = create_mock_cookie();
+    const std::string value(config.value_min, 'x');
+
+    for (size_t ii = thread_id; ii < config.keys && !failed;
+         ii += config.threads) {
+        const auto ret = workload_store(cookie, workload_key(ii),
+                                        uint16_t(ii % config.vbuckets),
+                                        value.data(), value.size());
+        if (ret != ENGINE_SUCCESS) {
+            fprintf(stderr, "Failed to preload key %" PRIu64 ": %d\n",
+                    uint64_t(ii), int(ret));
+            failed = true;
+        }
+    }
+    destroy_mock_cookie(cookie);
+}
+
+struct WorkloadStats {
+    std::vector<uint64_t> get_ns;
+    std::vector<uint64_t> store_ns;
+    uint64_t errors = 0;
+};
+
+static void workload_client(const WorkloadConfig& config, size_t thread_id,
+                            ProcessClock::time_point deadline,
+                            WorkloadStats& stats) {
+    const void* cookie = create_mock_cookie();
+    std::mt19937 rng(uint32_t(thread_id + 1));
+    ZipfGenerator pick(config.keys, config.zipf);
+    std::uniform_real_distribution<double> op_dist(0.0, 1.0);
+    std::uniform_int_distribution<size_t> size_dist(config.value_min,
+                                                    config.value_max);
+    const std::string value(config.value_max, 'x');
+
+    while (true) {
+        const size_t index = pick(rng);
+        const std::string key = workload_key(index);
+        const uint16_t vbucket = uint16_t(index % config.vbuckets);
+
+        const auto start = ProcessClock::now();
+        if (start >= deadline) {
+            break;
+        }
+
+        if (op_dist(rng) < config.read_ratio) {
+            DocKey docKey(reinterpret_cast<const uint8_t*>(key.data()),
+                          key.size(), DocNamespace::DefaultCollection);
+            const auto ret = handle_v1->get(handle, cookie, docKey, vbucket,
+                                            DocStateFilter::Alive);
+            const auto stop = ProcessClock::now();
+            if (ret.first == cb::engine_errc::success) {
+                stats.get_ns.push_back((stop - start).count());
+            } else {
+                stats.errors++;
+            }
+        } else {
+            const auto ret = workload_store(cookie, key, vbucket,
+                                            value.data(), size_dist(rng));
+            const auto stop = ProcessClock::now();
+            if (ret == ENGINE_SUCCESS) {
+                stats.store_ns.push_back((stop - start).count());
+            } else {
+                stats.errors++;
+            }
+        }
+    }
+    destroy_mock_cookie(cookie);
+}
+
+static void workload_report_latency(const char* name,
+                                    std::vector<uint64_t>& values) {
+    if (values.empty()) {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto pct = [&values](size_t num, size_t den) {
+        return double(values[std::min((values.size() * num) / den,
+                                      values.size() - 1)]) / 1e3;
+    };
+    printf("%-8s %12" PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+           name, uint64_t(values.size()), pct(50, 100), pct(95, 100),
+           pct(99, 100), pct(999, 1000), pct(9999, 10000));
+}
+
+static int run_workload_generator(const char* engine, const char* engine_args,
+                                  const char* spec) {
+    WorkloadConfig config;
+    if (!parse_workload_config(spec, config)) {
+        return 1;
+    }
+
+    if (log_to_stderr) {
+        logger_descriptor = get_stderr_logger();
+    } else {
+        logger_descriptor = get_null_logger();
+    }
+    get_mock_server_api()->extension->register_extension(EXTENSION_LOGGER,
+                                                         logger_descriptor);
+
+    init_mock_server(log_to_stderr);
+    if (memcached_initialize_stderr_logger(get_mock_server_api) != EXTENSION_SUCCESS) {
+        fprintf(stderr, "Failed to initialize log system\n");
+        return 1;
+    }
+
+    if (!start_your_engine(engine)) {
+        fprintf(stderr, "Failed to start engine %s\n", engine);
+        return 1;
+    }
+
+    handle_v1 = create_bucket(true, engine_args ? engine_args : "");
+    if (handle_v1 == NULL) {
+        fprintf(stderr, "Failed to create bucket\n");
+        return 1;
+    }
+    handle = (ENGINE_HANDLE*)handle_v1;
+
+    workload_set_vbucket_states(config);
+
+    printf("Preloading %" PRIu64 " keys...\n", uint64_t(config.keys));
+    std::atomic<bool> preload_failed(false);
+    {
+        std::vector<std::thread> loaders;
+        for (size_t ii = 0; ii < config.threads; ++ii) {
+            loaders.emplace_back(workload_preload, std::cref(config), ii,
+                                 std::ref(preload_failed));
+        }
+        for (auto& loader : loaders) {
+            loader.join();
+        }
+    }
+    if (preload_failed) {
+        destroy_bucket(handle, handle_v1, false);
+        destroy_mock_event_callbacks();
+        stop_your_engine();
+        return 1;
+    }
+
+    printf("Running %" PRIu64 " threads for %d seconds "
+           "(keys=%" PRIu64 ", zipf=%.2f, read_ratio=%.2f, "
+           "value_size=%" PRIu64 ":%" PRIu64 ", vbuckets=%u)\n",
+           uint64_t(config.threads), config.duration, uint64_t(config.keys),
+           config.zipf, config.read_ratio, uint64_t(config.value_min),
+           uint64_t(config.value_max), unsigned(config.vbuckets));
+
+    std::vector<WorkloadStats> stats(config.threads);
+    const auto start = ProcessClock::now();
+    const auto deadline = start + std::chrono::seconds(config.duration);
+    {
+        std::vector<std::thread> clients;
+        for (size_t ii = 0; ii < config.threads; ++ii) {
+            clients.emplace_back(workload_client, std::cref(config), ii,
+                                 deadline, std::ref(stats[ii]));
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+    }
+    const auto elapsed =
+            std::chrono::duration_cast<std::chrono::duration<double>>(
+                    ProcessClock::now() - start).count();
+
+    WorkloadStats total;
+    for (auto& entry : stats) {
+        total.get_ns.insert(total.get_ns.end(), entry.get_ns.begin(),
+                            entry.get_ns.end());
+        total.store_ns.insert(total.store_ns.end(), entry.store_ns.begin(),
+                              entry.store_ns.end());
+        total.errors += entry.errors;
+    }
+
+    const uint64_t ops = total.get_ns.size() + total.store_ns.size();
+    printf("\n");
+    printf("Total: %" PRIu64 " ops in %.2f s (%.0f ops/sec), %" PRIu64
+           " errors\n", ops, elapsed, double(ops) / elapsed, total.errors);
+    printf("\n");
+    printf("%-8s %12s %9s %9s %9s %9s %9s  (usec)\n",
+           "Op", "Count", "p50", "p95", "p99", "p99.9", "p99.99");
+    workload_report_latency("Get", total.get_ns);
+    workload_report_latency("Store", total.store_ns);
+
+    destroy_bucket(handle, handle_v1, false);
+    destroy_mock_event_callbacks();
+    stop_your_engine();
+    return 0;
+}
+
 int main(int argc, char **argv) {
     int c, exitcode = 0, num_cases = 0, timeout = 0, loop_count = 0;
     bool verbose = false;
@@ -1234,6 +1621,7 @@ int main(int argc, char **argv) {
     const char *engine = NULL;
     const char *engine_args = NULL;
     const char *test_suite = NULL;
+    const char *workload = NULL;
     std::unique_ptr<std::regex> test_case_regex;
     engine_test_t *testcases = NULL;
     OutputFormat output_format(OutputFormat::Text);
@@ -1304,7 +1692,9 @@ int main(int argc, char **argv) {
                        "C:" /* Test case id */
                        "s" /* spinlock the program */
                        "X" /* Use stderr logger */
-                       "f:" /* output format. Valid values are: 'text' and 'xml' */
+                       "f:" /* output format. Valid values are: 'text', 'xml'
+                               and 'json' */
+                       "W:" /* workload generator mode */
                        )) != -1) {
         switch (c) {
         case 'a':
@@ -1331,9 +1721,11 @@ int main(int argc, char **argv) {
                 output_format = OutputFormat::Text;
             } else if (std::string(optarg) == "xml") {
                 output_format = OutputFormat::XML;
+            } else if (std::string(optarg) == "json") {
+                output_format = OutputFormat::JSON;
             } else {
                 fprintf(stderr, "Invalid option for output format '%s'. Valid "
-                    "options are 'text' and 'xml'.\n", optarg);
+                    "options are 'text', 'xml' and 'json'.\n", optarg);
                 return 1;
             }
             break;
@@ -1367,6 +1759,9 @@ int main(int argc, char **argv) {
         case 'X':
             log_to_stderr = true;
             break;
+        case 'W':
+            workload = optarg;
+            break;
         default:
             fprintf(stderr, "Illegal argument \"%c\"\n", c);
             return 1;
@@ -1379,6 +1774,10 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (workload != NULL) {
+        return run_workload_generator(engine, engine_args, workload);
+    }
+
     if (test_suite == NULL) {
         fprintf(stderr, "You must provide a path to the testsuite library.\n");
         return 1;
@@ -33,9 +33,10 @@
 static void request_stat(MemcachedConnection& connection,
                          const std::string& key,
                          bool json,
-                         bool format) {
+                         bool format,
+                         bool bulk) {
     try {
-        auto stats = connection.stats(key);
+        auto stats = bulk ? connection.statsBulk(key) : connection.stats(key);
         if (json) {
             std::cout << to_string(stats, format) << std::endl;
         } else {
@@ -98,6 +99,10 @@ static void usage() {
               << std::endl
               << "  -J           Print result in JSON (formatted)"
               << std::endl
+              << "  -B           Use the bulk stats opcode (the entire stats"
+              << std::endl
+              << "               group is returned as a single frame)"
+              << std::endl
               << "  -4           Use IPv4 (default)" << std::endl
               << "  -6           Use IPv6" << std::endl
               << "  -C certfile  Use certfile as a client certificate"
@@ -119,11 +124,12 @@ int main(int argc, char** argv) {
     bool secure = false;
     bool json = false;
     bool format = false;
+    bool bulk = false;
 
     /* Initialize the socket subsystem */
     cb_initialize_sockets();
 
-    while ((cmd = getopt(argc, argv, "46h:p:u:b:P:SsjJC:K:")) != EOF) {
+    while ((cmd = getopt(argc, argv, "46h:p:u:b:P:SsjJBC:K:")) != EOF) {
         switch (cmd) {
         case '6' :
             family = AF_INET6;
@@ -158,6 +164,9 @@ int main(int argc, char** argv) {
         case 'j':
             json = true;
             break;
+        case 'B':
+            bulk = true;
+            break;
         case 'C':
             ssl_cert.assign(optarg);
             break;
@@ -210,10 +219,10 @@ int main(int argc, char** argv) {
         }
 
         if (optind == argc) {
-            request_stat(connection, "", json, format);
+            request_stat(connection, "", json, format, bulk);
         } else {
             for (int ii = optind; ii < argc; ++ii) {
-                request_stat(connection, argv[ii], json, format);
+                request_stat(connection, argv[ii], json, format, bulk);
             }
         }
     } catch (const ConnectionError& ex) {
@@ -24,10 +24,16 @@
 #include <memcached/protocol_binary.h>
 #include <protocol/connection/client_connection.h>
 #include <protocol/connection/client_mcbp_commands.h>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cinttypes>
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 static uint32_t getValue(cJSON *root, const char *key) {
     cJSON *obj = cJSON_GetObjectItem(root, key);
@@ -111,8 +117,77 @@ public:
         std::cout << "Total: " << total << " operations" << std::endl;
     }
 
+    /**
+     * Subtract the counts of another (earlier) snapshot of the same timings
+     * from this one, leaving the distribution of just the samples collected
+     * between the two snapshots. Bins are clamped at zero in case the
+     * server's stats were reset in between. Used by watch mode.
+     */
+    void subtract(const Timings& other) {
+        subtractBin(ns, other.ns);
+        for (size_t ii = 0; ii < us.size(); ++ii) {
+            subtractBin(us[ii], other.us[ii]);
+        }
+        for (size_t ii = 0; ii < ms.size(); ++ii) {
+            subtractBin(ms[ii], other.ms[ii]);
+        }
+        for (size_t ii = 0; ii < halfsec.size(); ++ii) {
+            subtractBin(halfsec[ii], other.halfsec[ii]);
+        }
+        for (size_t ii = 0; ii < wayout.size(); ++ii) {
+            subtractBin(wayout[ii], other.wayout[ii]);
+        }
+        recalculate();
+    }
+
+    /**
+     * Approximate the given percentile (0.0 - 100.0) of the samples, in
+     * microseconds. As we only have the histogram bins to work from this
+     * returns the upper bound of the bin the percentile falls within (the
+     * lower bound for the unbounded top bin), or 0 if there are no samples.
+     */
+    uint64_t getPercentile(double pct) const {
+        if (total == 0) {
+            return 0;
+        }
+        const auto goal = std::max(uint64_t((pct / 100.0) * total),
+                                   uint64_t(1));
+        if (ns.cumulative_count >= goal) {
+            return 1;
+        }
+        for (size_t ii = 0; ii < us.size(); ++ii) {
+            if (us[ii].cumulative_count >= goal) {
+                return (ii + 1) * 10;
+            }
+        }
+        for (size_t ii = 1; ii < ms.size(); ++ii) {
+            if (ms[ii].cumulative_count >= goal) {
+                return (ii + 1) * 1000;
+            }
+        }
+        for (size_t ii = 0; ii < halfsec.size(); ++ii) {
+            if (halfsec[ii].cumulative_count >= goal) {
+                return (ii + 1) * 500 * 1000;
+            }
+        }
+        if (oldwayout) {
+            return uint64_t(10) * 500 * 1000;
+        }
+        const std::array<uint64_t, 5> wayout_upper{{10, 20, 40, 80, 80}};
+        for (size_t ii = 0; ii < wayout.size(); ++ii) {
+            if (wayout[ii].cumulative_count >= goal) {
+                return wayout_upper[ii] * 1000000;
+            }
+        }
+        return wayout_upper.back() * 1000000;
+    }
+
 private:
 
+    static void subtractBin(Bin& bin, const Bin& other) {
+        bin.count = (bin.count > other.count) ? bin.count - other.count : 0;
+    }
+
     // Helper function for initialize
     static void update_max_and_total(uint32_t& max, uint64_t& total, Bin& bin) {
         total += bin.count;
@@ -181,7 +256,11 @@ private:
             oldwayout = true;
         }
 
-        // Calculate total and cumulative counts, and find the highest value.
+        recalculate();
+    }
+
+    // Calculate total and cumulative counts, and find the highest value.
+    void recalculate() {
         max = total = 0;
 
         update_max_and_total(max, total, ns);
@@ -264,11 +343,9 @@ std::string opcode2string(uint8_t opcode) {
     return std::string(cmd);
 }
 
-static void request_cmd_timings(MemcachedConnection& connection,
-                                const std::string bucket,
-                                uint8_t opcode,
-                                bool verbose,
-                                bool skip) {
+static Timings get_cmd_timings(MemcachedConnection& connection,
+                               const std::string& bucket,
+                               uint8_t opcode) {
     BinprotGetCmdTimerCommand cmd;
     cmd.setBucket(bucket);
     cmd.setOpcode(opcode);
@@ -303,8 +380,16 @@ static void request_cmd_timings(MemcachedConnection& connection,
         exit(EXIT_FAILURE);
     }
 
+    return Timings(resp.getTimings());
+}
+
+static void request_cmd_timings(MemcachedConnection& connection,
+                                const std::string bucket,
+                                uint8_t opcode,
+                                bool verbose,
+                                bool skip) {
     try {
-        Timings timings(resp.getTimings());
+        Timings timings = get_cmd_timings(connection, bucket, opcode);
 
         auto cmd = opcode2string(opcode);
 
@@ -378,13 +463,133 @@ static void request_stat_timings(MemcachedConnection& connection,
     }
 }
 
+/* Render a simple sparkline of the given (non-negative) values, one
+ * character per value. Requires a UTF-8 capable terminal, just like the
+ * histogram output.
+ */
+static std::string sparkline(const std::vector<double>& values) {
+    double max = 0.0;
+    for (const auto& value : values) {
+        max = std::max(max, value);
+    }
+
+    std::string out;
+    for (const auto& value : values) {
+        int level = (max > 0.0) ? int((value * 7.0) / max) : 0;
+        out += '\xe2';
+        out += '\x96';
+        out += char('\x81' + level);
+    }
+    return out;
+}
+
+/*
+ * Repeatedly poll the command timings for the given opcodes at a fixed
+ * interval, reporting for each opcode the delta since the previous poll:
+ * number of operations, operation rate and approximate latency percentiles
+ * over just that interval. With 'json' each sample is emitted as a single
+ * line of JSON (suitable for piping into external metrics tooling);
+ * otherwise a human readable line including a sparkline of the recent
+ * operation rate is printed. Runs until interrupted.
+ */
+static void watch_cmd_timings(MemcachedConnection& connection,
+                              const std::string& bucket,
+                              const std::vector<uint8_t>& opcodes,
+                              int interval,
+                              bool json) {
+    std::map<uint8_t, Timings> previous;
+    std::map<uint8_t, std::vector<double>> rate_history;
+    const size_t max_history = 30;
+
+    // Take the initial snapshot to delta against.
+    for (const auto& opcode : opcodes) {
+        previous.emplace(opcode, get_cmd_timings(connection, bucket, opcode));
+    }
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(interval));
+
+        time_t now;
+        time(&now);
+        char timebuf[80];
+        strftime(timebuf, sizeof(timebuf), "%FT%T", localtime(&now));
+
+        bool printed_header = false;
+        for (const auto& opcode : opcodes) {
+            Timings timings = get_cmd_timings(connection, bucket, opcode);
+            if (timings.getTotal() == 0) {
+                // Never executed on the server; don't clutter the output.
+                continue;
+            }
+
+            Timings delta = timings;
+            const auto iter = previous.find(opcode);
+            if (iter != previous.end()) {
+                delta.subtract(iter->second);
+                previous.erase(iter);
+            }
+            previous.emplace(opcode, timings);
+
+            const double rate = double(delta.getTotal()) / interval;
+            auto& history = rate_history[opcode];
+            history.push_back(rate);
+            if (history.size() > max_history) {
+                history.erase(history.begin());
+            }
+
+            const auto cmd = opcode2string(opcode);
+            if (json) {
+                unique_cJSON_ptr doc(cJSON_CreateObject());
+                cJSON_AddStringToObject(doc.get(), "timestamp", timebuf);
+                cJSON_AddStringToObject(doc.get(), "bucket", bucket.c_str());
+                cJSON_AddStringToObject(doc.get(), "opcode", cmd.c_str());
+                cJSON_AddNumberToObject(doc.get(), "total",
+                                        double(timings.getTotal()));
+                cJSON_AddNumberToObject(doc.get(), "delta",
+                                        double(delta.getTotal()));
+                cJSON_AddNumberToObject(doc.get(), "rate", rate);
+                cJSON_AddNumberToObject(doc.get(), "p50_us",
+                                        double(delta.getPercentile(50.0)));
+                cJSON_AddNumberToObject(doc.get(), "p99_us",
+                                        double(delta.getPercentile(99.0)));
+                char* ptr = cJSON_PrintUnformatted(doc.get());
+                std::cout << ptr << std::endl;
+                cJSON_Free(ptr);
+            } else {
+                if (!printed_header) {
+                    std::cout << timebuf << " [" << bucket << "]" << std::endl;
+                    printed_header = true;
+                }
+                char buffer[256];
+                snprintf(buffer, sizeof(buffer),
+                         "  %-24s %10" PRIu64 " ops (+%" PRIu64 ", %.1f/s)"
+                         " p50<%" PRIu64 "us p99<%" PRIu64 "us  ",
+                         cmd.c_str(),
+                         timings.getTotal(),
+                         delta.getTotal(),
+                         rate,
+                         delta.getPercentile(50.0),
+                         delta.getPercentile(99.0));
+                std::cout << buffer << sparkline(history) << std::endl;
+            }
+        }
+        std::cout.flush();
+    }
+}
+
 void usage() {
     std::cerr << "Usage mctimings [-h host[:port]] [-p port] [-u user]"
               << " [-P pass] [-S passFromStdin] [-b bucket] [-s]"
-              << "-v [opcode / stat_name]*" << std::endl
+              << " [-w seconds] [-j]"
+              << " -v [opcode / stat_name]*" << std::endl
               << std::endl
               << "Example:" << std::endl
               << "    mctimings -h localhost:11210 -v GET SET"
+              << std::endl
+              << std::endl
+              << "To continuously monitor the rate and latency of the"
+              << " commands, polling every 5 seconds:" << std::endl
+              << "    mctimings -h localhost:11210 --watch 5 GET SET"
               << std::endl;
 }
 
@@ -398,11 +603,18 @@ int main(int argc, char** argv) {
     sa_family_t family = AF_UNSPEC;
     bool verbose = false;
     bool secure = false;
+    int watch = 0;
+    bool json = false;
+
+    struct option long_options[] = {{"watch", required_argument, nullptr, 'w'},
+                                    {"json", no_argument, nullptr, 'j'},
+                                    {nullptr, 0, nullptr, 0}};
 
     /* Initialize the socket subsystem */
     cb_initialize_sockets();
 
-    while ((cmd = getopt(argc, argv, "46h:p:u:b:P:Ssv")) != EOF) {
+    while ((cmd = getopt_long(argc, argv, "46h:p:u:b:P:Ssvw:j", long_options,
+                              nullptr)) != EOF) {
         switch (cmd) {
         case '6' :
             family = AF_INET6;
@@ -434,6 +646,17 @@ int main(int argc, char** argv) {
         case 'v' :
             verbose = true;
             break;
+        case 'w':
+            watch = atoi(optarg);
+            if (watch <= 0) {
+                std::cerr << "Watch interval must be a positive number of "
+                             "seconds" << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'j':
+            json = true;
+            break;
         default:
             usage();
             return EXIT_FAILURE;
@@ -474,7 +697,26 @@ int main(int argc, char** argv) {
             connection.selectBucket(bucket);
         }
 
-        if (optind == argc) {
+        if (watch > 0) {
+            std::vector<uint8_t> opcodes;
+            if (optind == argc) {
+                for (int ii = 0; ii < 256; ++ii) {
+                    opcodes.push_back(uint8_t(ii));
+                }
+            } else {
+                for (; optind < argc; ++optind) {
+                    const uint8_t opcode =
+                            memcached_text_2_opcode(argv[optind]);
+                    if (opcode == PROTOCOL_BINARY_CMD_INVALID) {
+                        std::cerr << "Watch mode only supports opcode "
+                                  << "timings: " << argv[optind] << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                    opcodes.push_back(opcode);
+                }
+            }
+            watch_cmd_timings(connection, bucket, opcodes, watch, json);
+        } else if (optind == argc) {
             for (int ii = 0; ii < 256; ++ii) {
                 request_cmd_timings(connection, bucket, (uint8_t)ii, verbose,
                                     true);
@@ -318,10 +318,11 @@ void MemcachedConnection::read(Frame& frame, size_t bytes) {
     }
 }
 
-unique_cJSON_ptr MemcachedConnection::stats(const std::string& subcommand) {
+static unique_cJSON_ptr stats_map_to_json(
+        const std::map<std::string, std::string>& stats) {
     unique_cJSON_ptr ret(cJSON_CreateObject());
 
-    for (auto& pair : statsMap(subcommand)) {
+    for (auto& pair : stats) {
         const std::string& key = pair.first;
         const std::string& value = pair.second;
         if (value == "false") {
@@ -340,6 +341,14 @@ unique_cJSON_ptr MemcachedConnection::stats(const std::string& subcommand) {
     return ret;
 }
 
+unique_cJSON_ptr MemcachedConnection::stats(const std::string& subcommand) {
+    return stats_map_to_json(statsMap(subcommand));
+}
+
+unique_cJSON_ptr MemcachedConnection::statsBulk(const std::string& subcommand) {
+    return stats_map_to_json(statsBulkMap(subcommand));
+}
+
 void MemcachedConnection::setSslCertFile(const std::string& file)  {
     if (file.empty()) {
         ssl_cert_file.clear();
@@ -762,6 +771,63 @@ std::map<std::string, std::string> MemcachedConnection::statsMap(
     return ret;
 }
 
+std::map<std::string, std::string> MemcachedConnection::statsBulkMap(
+        const std::string& subcommand) {
+    BinprotGenericCommand command(PROTOCOL_BINARY_CMD_STAT_BULK, subcommand);
+    sendCommand(command);
+
+    BinprotResponse response;
+    recvResponse(response);
+
+    if (!response.isSuccess()) {
+        throw ConnectionError("Bulk stats failed", response);
+    }
+
+    // The body is a sequence of (uint16_t keylen, key, uint32_t vallen,
+    // value) records with the lengths in network byte order.
+    std::map<std::string, std::string> ret;
+    int counter = 0;
+    const auto body = response.getData();
+    size_t offset = 0;
+
+    while (offset < body.size()) {
+        if (body.size() - offset < sizeof(uint16_t)) {
+            throw std::runtime_error("statsBulkMap: truncated key length");
+        }
+        uint16_t klen;
+        memcpy(&klen, body.data() + offset, sizeof(klen));
+        klen = ntohs(klen);
+        offset += sizeof(klen);
+        if (body.size() - offset < klen) {
+            throw std::runtime_error("statsBulkMap: truncated key");
+        }
+        std::string key(reinterpret_cast<const char*>(body.data() + offset),
+                        klen);
+        offset += klen;
+
+        if (body.size() - offset < sizeof(uint32_t)) {
+            throw std::runtime_error("statsBulkMap: truncated value length");
+        }
+        uint32_t vlen;
+        memcpy(&vlen, body.data() + offset, sizeof(vlen));
+        vlen = ntohl(vlen);
+        offset += sizeof(vlen);
+        if (body.size() - offset < vlen) {
+            throw std::runtime_error("statsBulkMap: truncated value");
+        }
+        std::string value(reinterpret_cast<const char*>(body.data() + offset),
+                          vlen);
+        offset += vlen;
+
+        if (key.empty()) {
+            key = std::to_string(counter++);
+        }
+        ret.insert(std::make_pair(key, value));
+    }
+
+    return ret;
+}
+
 void MemcachedConnection::configureEwouldBlockEngine(const EWBEngineMode& mode,
                                                      ENGINE_ERROR_CODE err_code,
                                                      uint32_t value,
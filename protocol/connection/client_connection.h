@@ -425,8 +425,23 @@ public:
      */
     std::map<std::string, std::string> statsMap(const std::string& subcommand);
 
+    /**
+     * Get stats as a map by using the bulk stats opcode, which returns
+     * the entire stats group as a single length-prefixed frame instead
+     * of one packet per stat
+     * @param subcommand
+     * @return
+     */
+    std::map<std::string, std::string> statsBulkMap(
+            const std::string& subcommand);
+
     unique_cJSON_ptr stats(const std::string& subcommand);
 
+    /**
+     * Get stats as a JSON object by using the bulk stats opcode
+     */
+    unique_cJSON_ptr statsBulk(const std::string& subcommand);
+
     /**
      * Instruct the audit daemon to reload the configuration
      */
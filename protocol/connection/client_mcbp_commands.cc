@@ -777,3 +777,49 @@ void BinprotSetClusterConfigCommand::encode(std::vector<uint8_t>& buf) const {
     writeHeader(buf, config.size(), 0);
     buf.insert(buf.end(), config.begin(), config.end());
 }
+
+uint32_t BinprotPipeline::queue(const BinprotCommand& command) {
+    const size_t offset = stream.payload.size();
+    command.encode(stream.payload);
+
+    // Assign the opaque by patching the encoded header; the value is
+    // echoed back verbatim by the server so no byte order conversion is
+    // needed (or wanted - see BinprotResponse::getOpaque).
+    const uint32_t opaque = nextOpaque++;
+    auto* header = reinterpret_cast<protocol_binary_request_header*>(
+            stream.payload.data() + offset);
+    header->request.opaque = opaque;
+
+    if (!outstanding.insert(opaque).second) {
+        throw std::logic_error(
+                "BinprotPipeline::queue: opaque already outstanding: " +
+                std::to_string(opaque));
+    }
+    return opaque;
+}
+
+void BinprotPipeline::flush() {
+    if (stream.payload.empty()) {
+        return;
+    }
+    connection.sendFrame(stream);
+    stream.reset();
+}
+
+bool BinprotPipeline::recvNext(BinprotResponse& response) {
+    if (outstanding.empty()) {
+        return false;
+    }
+
+    // Push out anything still sitting in the stream so we don't deadlock
+    // waiting for a response to a command which was never sent.
+    flush();
+
+    connection.recvResponse(response);
+    if (outstanding.erase(response.getOpaque()) == 0) {
+        throw std::runtime_error(
+                "BinprotPipeline::recvNext: unexpected opaque in response: " +
+                std::to_string(response.getOpaque()));
+    }
+    return true;
+}
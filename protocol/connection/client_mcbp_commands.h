@@ -315,6 +315,10 @@ public:
     uint64_t getCas() const {
         return getHeader().response.cas;
     }
+    /** Get the opaque (as it appears on the wire) for the response */
+    uint32_t getOpaque() const {
+        return getHeader().response.opaque;
+    }
     protocol_binary_datatype_t getDatatype() const {
         return getHeader().response.datatype;
     }
@@ -1401,3 +1405,74 @@ public:
 protected:
     const std::string config;
 };
+
+/**
+ * A pipeline of commands over a MemcachedConnection.
+ *
+ * executeCommand() is strictly send-one-recv-one, which can never keep a
+ * deep queue of work on the server. A pipeline lets you queue any number
+ * of command objects, flush them to the server as a single write, and
+ * then drain the responses lazily:
+ *
+ *     BinprotPipeline pipeline(conn);
+ *     for (...) {
+ *         pipeline.queue(cmd);
+ *     }
+ *     pipeline.flush();
+ *
+ *     BinprotResponse rsp;
+ *     while (pipeline.recvNext(rsp)) {
+ *         // inspect rsp; rsp.getOpaque() identifies the command
+ *     }
+ *
+ * Each queued command is assigned a unique opaque (any opaque set by the
+ * caller is overwritten), which queue() returns and which is echoed in
+ * the matching response. You may keep queueing and flushing while
+ * draining to sustain an arbitrarily deep pipeline.
+ *
+ * Quiet command variants (which may not generate a response) are not
+ * supported.
+ */
+class BinprotPipeline {
+public:
+    explicit BinprotPipeline(MemcachedConnection& conn) : connection(conn) {
+    }
+
+    /**
+     * Encode the given command into the pending stream (nothing hits the
+     * network until flush()).
+     *
+     * @return the opaque assigned to the command.
+     */
+    uint32_t queue(const BinprotCommand& command);
+
+    /// Send all queued commands to the server in a single write.
+    void flush();
+
+    /**
+     * Receive the next response for a flushed command.
+     *
+     * @param response the response object to populate
+     * @return true if a response was received; false if no responses
+     *         remain outstanding.
+     * @throws std::runtime_error if the response carries an opaque which
+     *         isn't outstanding.
+     */
+    bool recvNext(BinprotResponse& response);
+
+    /// Number of flushed or queued commands with no response received yet.
+    size_t getOutstanding() const {
+        return outstanding.size();
+    }
+
+protected:
+    MemcachedConnection& connection;
+
+    /// Encoded-but-not-yet-flushed commands.
+    Frame stream;
+
+    /// Opaques of commands for which no response has been received.
+    std::unordered_set<uint32_t> outstanding;
+
+    uint32_t nextOpaque = 0;
+};
@@ -271,6 +271,12 @@ std::string to_string(cb::mcbp::ClientOpcode opcode) {
         return "GET_KEYS";
     case ClientOpcode::CollectionsSetManifest:
         return "COLLECTIONS_SET_MANIFEST";
+    case ClientOpcode::MultiGet:
+        return "MULTI_GET";
+    case ClientOpcode::MultiSetWithMeta:
+        return "MULTI_SET_WITH_META";
+    case ClientOpcode::StatBulk:
+        return "STAT_BULK";
     case ClientOpcode::SetDriftCounterState:
         return "SET_DRIFT_COUNTER_STATE";
     case ClientOpcode::GetAdjustedTime:
@@ -151,6 +151,9 @@ const std::map<cb::mcbp::ClientOpcode, std::string> client_blueprint = {
          {ClientOpcode::SeqnoPersistence, "SEQNO_PERSISTENCE"},
          {ClientOpcode::GetKeys, "GET_KEYS"},
          {ClientOpcode::CollectionsSetManifest, "COLLECTIONS_SET_MANIFEST"},
+         {ClientOpcode::MultiGet, "MULTI_GET"},
+         {ClientOpcode::MultiSetWithMeta, "MULTI_SET_WITH_META"},
+         {ClientOpcode::StatBulk, "STAT_BULK"},
          {ClientOpcode::SetDriftCounterState, "SET_DRIFT_COUNTER_STATE"},
          {ClientOpcode::GetAdjustedTime, "GET_ADJUSTED_TIME"},
          {ClientOpcode::SubdocGet, "SUBDOC_GET"},
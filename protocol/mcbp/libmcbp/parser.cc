@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <mcbp/protocol/parser.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace cb {
+namespace mcbp {
+
+void Parser::feed(cb::const_byte_buffer segment) {
+    if (segment.empty()) {
+        return;
+    }
+    segments.push_back(segment);
+    remaining += segment.size();
+}
+
+const Request* Parser::assembleHeader() {
+    size_t copied = 0;
+    size_t offset = frontOffset;
+    for (const auto& segment : segments) {
+        const size_t chunk =
+                std::min(sizeof(Request) - copied, segment.size() - offset);
+        std::memcpy(headerScratch.data() + copied,
+                    segment.data() + offset,
+                    chunk);
+        copied += chunk;
+        offset = 0;
+        if (copied == sizeof(Request)) {
+            break;
+        }
+    }
+    return reinterpret_cast<const Request*>(headerScratch.data());
+}
+
+void Parser::advance(size_t nbytes, std::vector<cb::const_byte_buffer>* out) {
+    while (nbytes > 0) {
+        auto& front = segments.front();
+        const size_t chunk = std::min(nbytes, front.size() - frontOffset);
+        if (out != nullptr) {
+            out->emplace_back(front.data() + frontOffset, chunk);
+        }
+        frontOffset += chunk;
+        nbytes -= chunk;
+        remaining -= chunk;
+        consumed += chunk;
+        if (frontOffset == front.size()) {
+            segments.pop_front();
+            frontOffset = 0;
+        }
+    }
+}
+
+bool Parser::next(FrameView& view) {
+    if (remaining < sizeof(Request)) {
+        return false;
+    }
+
+    // Locate the header. If the front segment holds all of it we can
+    // point straight into the caller's memory; otherwise reassemble just
+    // the header bytes in the scratch space.
+    const Request* header;
+    if (segments.front().size() - frontOffset >= sizeof(Request)) {
+        header = reinterpret_cast<const Request*>(segments.front().data() +
+                                                  frontOffset);
+    } else {
+        header = assembleHeader();
+    }
+
+    if (!is_legal(Magic(header->magic))) {
+        throw std::runtime_error(
+                "cb::mcbp::Parser::next: Invalid magic received: " +
+                std::to_string(header->magic));
+    }
+
+    const size_t bodylen = header->getBodylen();
+    if (remaining < sizeof(Request) + bodylen) {
+        // The body hasn't fully arrived yet.
+        return false;
+    }
+
+    view.header = header;
+    view.body.clear();
+    advance(sizeof(Request), nullptr);
+    advance(bodylen, &view.body);
+    return true;
+}
+
+void Parser::reset() {
+    segments.clear();
+    frontOffset = 0;
+    remaining = 0;
+}
+
+} // namespace mcbp
+} // namespace cb
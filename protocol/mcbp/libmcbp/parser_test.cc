@@ -0,0 +1,168 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <mcbp/protocol/framebuilder.h>
+#include <mcbp/protocol/parser.h>
+
+#include <numeric>
+#include <vector>
+
+using namespace cb::mcbp;
+
+/// Encode a request frame with the given key / value into a blob.
+static std::vector<uint8_t> encodeFrame(const std::string& key,
+                                        const std::string& value) {
+    std::vector<uint8_t> blob(sizeof(Request) + key.size() + value.size());
+    FrameBuilder<Request> builder({blob.data(), blob.size()});
+    builder.setMagic(Magic::ClientRequest);
+    builder.setOpcode(ClientOpcode::Set);
+    builder.setKey({reinterpret_cast<const uint8_t*>(key.data()), key.size()});
+    builder.setValue({reinterpret_cast<const uint8_t*>(value.data()),
+                      value.size()});
+    return blob;
+}
+
+/// Flatten a FrameView's body segments for comparison.
+static std::vector<uint8_t> flatten(const FrameView& view) {
+    std::vector<uint8_t> ret;
+    for (const auto& segment : view.body) {
+        ret.insert(ret.end(), segment.begin(), segment.end());
+    }
+    return ret;
+}
+
+TEST(McbpParser, EmptyInput) {
+    Parser parser;
+    FrameView view;
+    EXPECT_FALSE(parser.next(view));
+    parser.feed({nullptr, 0});
+    EXPECT_FALSE(parser.next(view));
+    EXPECT_EQ(0u, parser.getRemaining());
+}
+
+TEST(McbpParser, SingleContiguousFrame) {
+    const auto blob = encodeFrame("key", "value");
+    Parser parser;
+    parser.feed({blob.data(), blob.size()});
+
+    FrameView view;
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(Magic::ClientRequest, view.getMagic());
+    EXPECT_EQ(blob.size(), view.getFrameLength());
+    EXPECT_TRUE(view.isBodyContiguous());
+
+    const std::string body{"keyvalue"};
+    EXPECT_EQ(std::vector<uint8_t>(body.begin(), body.end()), flatten(view));
+
+    EXPECT_FALSE(parser.next(view));
+    EXPECT_EQ(0u, parser.getRemaining());
+    EXPECT_EQ(blob.size(), parser.getConsumed());
+}
+
+TEST(McbpParser, HeaderStraddlesSegments) {
+    const auto blob = encodeFrame("key", "value");
+
+    // Split in the middle of the header; the parser must reassemble just
+    // those header bytes (into its scratch space) and still yield the
+    // body as views into our blob.
+    Parser parser;
+    parser.feed({blob.data(), 10});
+
+    FrameView view;
+    EXPECT_FALSE(parser.next(view));
+
+    parser.feed({blob.data() + 10, blob.size() - 10});
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(8u, view.getBodylen());
+    ASSERT_TRUE(view.isBodyContiguous());
+    // The body view must point into the original blob; nothing copied.
+    EXPECT_EQ(blob.data() + sizeof(Request), view.body.front().data());
+}
+
+TEST(McbpParser, BodyAcrossManySegments) {
+    const std::string value(1000, 'v');
+    const auto blob = encodeFrame("key", value);
+
+    // Feed the frame one small chunk at a time (as if the value arrived
+    // over many TCP reads).
+    Parser parser;
+    FrameView view;
+    size_t offset = 0;
+    while (offset < blob.size()) {
+        const size_t chunk = std::min<size_t>(100, blob.size() - offset);
+        EXPECT_FALSE(parser.next(view));
+        parser.feed({blob.data() + offset, chunk});
+        offset += chunk;
+    }
+
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_FALSE(view.isBodyContiguous());
+    EXPECT_EQ(3 + value.size(), flatten(view).size());
+    EXPECT_EQ(std::vector<uint8_t>(blob.begin() + sizeof(Request), blob.end()),
+              flatten(view));
+}
+
+TEST(McbpParser, PipelinedFrames) {
+    // Several frames back-to-back in one segment (a burst of pipelined
+    // requests picked up by a single read).
+    const auto first = encodeFrame("a", "1");
+    const auto second = encodeFrame("bb", "22");
+    const auto third = encodeFrame("ccc", "333");
+
+    std::vector<uint8_t> stream;
+    stream.insert(stream.end(), first.begin(), first.end());
+    stream.insert(stream.end(), second.begin(), second.end());
+    stream.insert(stream.end(), third.begin(), third.end());
+
+    Parser parser;
+    parser.feed({stream.data(), stream.size()});
+
+    FrameView view;
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(2u, view.getBodylen());
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(4u, view.getBodylen());
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(6u, view.getBodylen());
+    EXPECT_FALSE(parser.next(view));
+    EXPECT_EQ(stream.size(), parser.getConsumed());
+}
+
+TEST(McbpParser, InvalidMagic) {
+    std::vector<uint8_t> blob(sizeof(Request), 0);
+    blob[0] = 0xdd; // Not a legal magic
+    Parser parser;
+    parser.feed({blob.data(), blob.size()});
+
+    FrameView view;
+    EXPECT_THROW(parser.next(view), std::runtime_error);
+}
+
+TEST(McbpParser, Reset) {
+    const auto blob = encodeFrame("key", "value");
+    Parser parser;
+    parser.feed({blob.data(), 10});
+    parser.reset();
+    EXPECT_EQ(0u, parser.getRemaining());
+
+    // After a reset the parser starts from scratch.
+    parser.feed({blob.data(), blob.size()});
+    FrameView view;
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_EQ(8u, view.getBodylen());
+}
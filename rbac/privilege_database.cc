@@ -17,9 +17,7 @@
 #include <memcached/rbac.h>
 
 #include <cJSON_utils.h>
-#include <platform/make_unique.h>
 #include <platform/memorymap.h>
-#include <platform/rwlock.h>
 #include <strings.h>
 #include <atomic>
 #include <fstream>
@@ -36,9 +34,18 @@ namespace rbac {
 // from so that we can easily detect if the PrivilegeContext is stale.
 static std::atomic<uint32_t> generation{0};
 
-// The read write lock needed when you want to build a context
-cb::RWLock rwlock;
-std::unique_ptr<PrivilegeDatabase> db;
+// The currently installed privilege database. The database is immutable
+// once published: updates build a complete new instance and atomically
+// swap the pointer, so readers never block (they just pin the snapshot
+// they're looking at via the reference count). Updaters serialize on
+// updateMutex while deciding if their candidate is newer.
+static std::shared_ptr<PrivilegeDatabase> db;
+static std::mutex updateMutex;
+
+/// Grab a reference to the currently installed privilege database
+static std::shared_ptr<PrivilegeDatabase> getDatabase() {
+    return std::atomic_load_explicit(&db, std::memory_order_acquire);
+}
 
 UserEntry::UserEntry(const cJSON& root) {
     if (root.string == nullptr) {
@@ -242,14 +249,16 @@ void PrivilegeContext::setBucketPrivilegeBits(bool value) {
 
 PrivilegeContext createContext(const std::string& user,
                                const std::string& bucket) {
-    std::lock_guard<cb::ReaderLock> guard(rwlock.reader());
-    return db->createContext(user, bucket);
+    return getDatabase()->createContext(user, bucket);
+}
+
+uint32_t getGeneration() {
+    return generation.load();
 }
 
 std::pair<PrivilegeContext, bool> createInitialContext(
         const std::string& user, cb::sasl::Domain domain) {
-    std::lock_guard<cb::ReaderLock> guard(rwlock.reader());
-    return db->createInitialContext(user, domain);
+    return getDatabase()->createInitialContext(user, domain);
 }
 
 void loadPrivilegeDatabase(const std::string& filename) {
@@ -265,23 +274,32 @@ void loadPrivilegeDatabase(const std::string& filename) {
                 "PrivilegeDatabaseManager::load: Failed to parse json");
     }
 
-    auto database = std::make_unique<PrivilegeDatabase>(json.get());
+    auto database = std::make_shared<PrivilegeDatabase>(json.get());
 
-    std::lock_guard<cb::WriterLock> guard(rwlock.writer());
-    // Handle race conditions
-    if (db->generation < database->generation) {
-        db.swap(database);
+    std::lock_guard<std::mutex> guard(updateMutex);
+    // Handle race conditions: only publish the candidate if no
+    // concurrent load managed to install a newer database. Readers
+    // holding a reference to the old snapshot keep it alive until
+    // they're done with it.
+    if (getDatabase()->generation < database->generation) {
+        std::atomic_store_explicit(
+                &db, std::move(database), std::memory_order_release);
     }
 }
 
 void initialize() {
     // Create an empty database to avoid having to add checks
     // if it exists or not...
-    db = std::make_unique<PrivilegeDatabase>(nullptr);
+    std::atomic_store_explicit(
+            &db,
+            std::make_shared<PrivilegeDatabase>(nullptr),
+            std::memory_order_release);
 }
 
 void destroy() {
-    db.reset();
+    std::atomic_store_explicit(&db,
+                               std::shared_ptr<PrivilegeDatabase>{},
+                               std::memory_order_release);
 }
 
 bool mayAccessBucket(const std::string& user, const std::string& bucket) {
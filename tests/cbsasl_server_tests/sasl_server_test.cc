@@ -192,6 +192,44 @@ TEST_F(SaslServerTest, PlainNoNullAtAll) {
     cb_free((void*)output);
 }
 
+#ifdef HAVE_PKCS5_PBKDF2_HMAC_SHA1
+/**
+ * Pick out the salt ("s=") attribute from a server-first-message
+ */
+static std::string getSaltAttribute(const std::string& server_first) {
+    auto idx = server_first.find(",s=");
+    if (idx == std::string::npos) {
+        return "";
+    }
+    idx += 3;
+    return server_first.substr(idx, server_first.find(',', idx) - idx);
+}
+
+TEST_F(SaslServerTest, ScramUnknownUserSaltIsStable) {
+    // Authentication attempts against an unknown user are served by a
+    // cached dummy user, so the salt must not change between attempts
+    // (and the key derivation only happens for the first one)
+    const std::string client_first{"n,,n=no_such_user,r=aaaabbbbccccdddd"};
+    const char* output = nullptr;
+    unsigned outputlen = 0;
+
+    ASSERT_EQ(CBSASL_CONTINUE,
+              cbsasl_server_start(conn, "SCRAM-SHA1", client_first.data(),
+                                  unsigned(client_first.size()), &output,
+                                  &outputlen));
+    const auto first = getSaltAttribute(std::string(output, outputlen));
+    EXPECT_FALSE(first.empty());
+
+    ASSERT_EQ(CBSASL_CONTINUE,
+              cbsasl_server_start(conn, "SCRAM-SHA1", client_first.data(),
+                                  unsigned(client_first.size()), &output,
+                                  &outputlen));
+    const auto second = getSaltAttribute(std::string(output, outputlen));
+
+    EXPECT_EQ(first, second);
+}
+#endif
+
 class SaslLimitMechServerTest : public SaslServerTest {
 protected:
     void SetUp() {
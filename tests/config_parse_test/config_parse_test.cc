@@ -572,6 +572,20 @@ TEST_F(SettingsTest, ConnectionIdleTime) {
     }
 }
 
+TEST_F(SettingsTest, ConnectionParkTime) {
+    nonNumericValuesShouldFail("connection_park_time");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "connection_park_time", 60);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(60, settings.getConnectionParkTime());
+        EXPECT_TRUE(settings.has.connection_park_time);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, BioDrainBufferSize) {
     nonNumericValuesShouldFail("bio_drain_buffer_sz");
 
@@ -1243,6 +1257,23 @@ TEST(SettingsUpdateTest, ConnectionIdleTimeIsDynamic) {
               settings.getConnectionIdleTime());
 }
 
+TEST(SettingsUpdateTest, ConnectionParkTimeIsDynamic) {
+    Settings updated;
+    Settings settings;
+    // setting it to the same value should work
+    auto old = settings.getConnectionParkTime();
+    updated.setConnectionParkTime(old);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // changing it should work
+    updated.setConnectionParkTime(old + 10);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(old, settings.getConnectionParkTime());
+    EXPECT_NO_THROW(settings.updateSettings(updated));
+    EXPECT_EQ(updated.getConnectionParkTime(),
+              settings.getConnectionParkTime());
+}
+
 TEST(SettingsUpdateTest, BioDrainBufferSzIsNotDynamic) {
     Settings updated;
     Settings settings;
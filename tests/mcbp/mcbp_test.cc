@@ -2817,5 +2817,91 @@ TEST_F(UnlockValidatorTest, InvalidBodylen) {
     EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
 }
 
+// Test the batch pre-validation of the fixed header invariants
+class HeaderPrevalidationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset(blob, 0, sizeof(blob));
+    }
+
+    /**
+     * Fill in a (syntactically valid) request header at the given
+     * offset, and return the offset of the next packet
+     */
+    size_t addPacket(size_t offset,
+                     uint8_t extlen,
+                     uint16_t keylen,
+                     uint32_t bodylen) {
+        auto* req = reinterpret_cast<protocol_binary_request_header*>(
+                blob + offset);
+        req->request.magic = PROTOCOL_BINARY_REQ;
+        req->request.opcode = PROTOCOL_BINARY_CMD_GET;
+        req->request.extlen = extlen;
+        req->request.keylen = htons(keylen);
+        req->request.bodylen = htonl(bodylen);
+        return offset + sizeof(*req) + bodylen;
+    }
+
+    uint8_t blob[1024];
+};
+
+TEST_F(HeaderPrevalidationTest, Empty) {
+    bool invalid = true;
+    EXPECT_EQ(0u, mcbp_prevalidate_headers({blob, 0}, invalid));
+    EXPECT_FALSE(invalid);
+}
+
+TEST_F(HeaderPrevalidationTest, Pipeline) {
+    size_t offset = addPacket(0, 0, 3, 3);
+    offset = addPacket(offset, 4, 3, 10);
+    offset = addPacket(offset, 0, 0, 0);
+
+    bool invalid = true;
+    EXPECT_EQ(3u, mcbp_prevalidate_headers({blob, offset}, invalid));
+    EXPECT_FALSE(invalid);
+}
+
+TEST_F(HeaderPrevalidationTest, PartialTrailingPacket) {
+    size_t offset = addPacket(0, 0, 3, 3);
+    offset = addPacket(offset, 0, 3, 100);
+
+    // The trailing body isn't spooled yet, but its header is complete
+    // and should be counted
+    bool invalid = true;
+    EXPECT_EQ(2u,
+              mcbp_prevalidate_headers(
+                      {blob, offset - 50}, invalid));
+    EXPECT_FALSE(invalid);
+}
+
+TEST_F(HeaderPrevalidationTest, InvalidMagic) {
+    const auto offset = addPacket(0, 0, 3, 3);
+    blob[0] = 0xff;
+
+    bool invalid = false;
+    EXPECT_EQ(0u, mcbp_prevalidate_headers({blob, offset}, invalid));
+    EXPECT_TRUE(invalid);
+}
+
+TEST_F(HeaderPrevalidationTest, InvalidLengths) {
+    // keylen + extlen exceeds bodylen
+    const auto offset = addPacket(0, 4, 10, 2);
+
+    bool invalid = false;
+    EXPECT_EQ(0u, mcbp_prevalidate_headers({blob, offset + 2}, invalid));
+    EXPECT_TRUE(invalid);
+}
+
+TEST_F(HeaderPrevalidationTest, InvalidPacketLaterInPipeline) {
+    size_t offset = addPacket(0, 0, 3, 3);
+    const auto broken = offset;
+    offset = addPacket(offset, 0, 3, 3);
+    blob[broken] = 0xff;
+
+    bool invalid = false;
+    EXPECT_EQ(1u, mcbp_prevalidate_headers({blob, offset}, invalid));
+    EXPECT_TRUE(invalid);
+}
+
 } // namespace test
 } // namespace mcbp
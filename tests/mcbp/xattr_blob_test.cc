@@ -222,6 +222,38 @@ TEST(XattrBlob, iterator_simple_checks) {
     }
 }
 
+/**
+ * Lookups are served by a sorted key index which is rebuilt after
+ * mutations which move data within the blob. Verify that a blob with
+ * "many" keys resolves every key correctly both before and after such
+ * a mutation.
+ */
+TEST(XattrBlob, ManyKeysLookup) {
+    cb::xattr::Blob blob;
+    for (int ii = 0; ii < 20; ii++) {
+        const auto name = "key" + std::to_string(ii);
+        blob.set(name, name + ".value");
+    }
+    validate(blob.finalize());
+
+    for (int ii = 0; ii < 20; ii++) {
+        const auto name = "key" + std::to_string(ii);
+        EXPECT_EQ(name + ".value", to_string(blob.get(name)));
+    }
+    EXPECT_TRUE(to_string(blob.get("key")).empty());
+    EXPECT_TRUE(to_string(blob.get("key20")).empty());
+
+    // Remove a key in the middle and verify that the remaining keys
+    // still resolve
+    blob.remove(to_const_byte_buffer("key10"));
+    validate(blob.finalize());
+    EXPECT_TRUE(to_string(blob.get("key10")).empty());
+    for (int ii = 11; ii < 20; ii++) {
+        const auto name = "key" + std::to_string(ii);
+        EXPECT_EQ(name + ".value", to_string(blob.get(name)));
+    }
+}
+
 TEST(XattrBlob, iterator_insert) {
     cb::xattr::Blob blob;
     std::vector<std::string> keys = {"key1", "key2", "key3"};
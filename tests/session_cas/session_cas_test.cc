@@ -0,0 +1,134 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <daemon/session_cas.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(SessionCasTest, InitialValue) {
+    SessionCas cas;
+    EXPECT_EQ(0xdeadbeef, cas.getCasValue());
+}
+
+TEST(SessionCasTest, WildcardCasSetsValue) {
+    SessionCas cas;
+    uint64_t current = 0;
+    EXPECT_EQ(ENGINE_SUCCESS, cas.cas(0xcafe, 0, current));
+    EXPECT_EQ(0xcafe, current);
+    EXPECT_EQ(0xcafe, cas.getCasValue());
+}
+
+TEST(SessionCasTest, MatchingCasSetsValue) {
+    SessionCas cas;
+    uint64_t current = 0;
+    EXPECT_EQ(ENGINE_SUCCESS, cas.cas(0xcafe, 0xdeadbeef, current));
+    EXPECT_EQ(0xcafe, current);
+}
+
+TEST(SessionCasTest, MismatchingCasFails) {
+    SessionCas cas;
+    uint64_t current = 0;
+    EXPECT_EQ(ENGINE_KEY_EEXISTS, cas.cas(0xcafe, 0xbadbad, current));
+    EXPECT_EQ(0xdeadbeef, current);
+    EXPECT_EQ(0xdeadbeef, cas.getCasValue());
+}
+
+TEST(SessionCasTest, CounterBlocksMutation) {
+    SessionCas cas;
+    EXPECT_TRUE(cas.increment_session_counter(0xdeadbeef));
+    uint64_t current = 0;
+    EXPECT_EQ(ENGINE_EBUSY, cas.cas(0xcafe, 0, current));
+    EXPECT_EQ(0xdeadbeef, current);
+    cas.decrement_session_counter();
+    EXPECT_EQ(ENGINE_SUCCESS, cas.cas(0xcafe, 0, current));
+    EXPECT_EQ(0xcafe, current);
+}
+
+TEST(SessionCasTest, WildcardIncrementAllowed) {
+    SessionCas cas;
+    EXPECT_TRUE(cas.increment_session_counter(0));
+    cas.decrement_session_counter();
+}
+
+TEST(SessionCasTest, MismatchingIncrementFails) {
+    SessionCas cas;
+    EXPECT_FALSE(cas.increment_session_counter(0xbadbad));
+}
+
+TEST(SessionCasTest, DecrementOfZeroThrows) {
+    SessionCas cas;
+    EXPECT_THROW(cas.decrement_session_counter(), std::logic_error);
+}
+
+/**
+ * Hammer the lock-free validation path from multiple threads whilst a
+ * mutator repeatedly tries to change the token. Validators must only ever
+ * register against the token they validated; the mutator must never change
+ * the token whilst an operation is registered. The token alternates between
+ * two values, so a validator which got in under one of them re-reading the
+ * current value must see one of the two (never a torn or stale third value).
+ */
+TEST(SessionCasTest, ConcurrentValidationAndMutation) {
+    SessionCas cas;
+    const uint64_t tokenA = 0xdeadbeef;
+    const uint64_t tokenB = 0xcafef00d;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> validated(0);
+
+    std::vector<std::thread> validators;
+    for (int ii = 0; ii < 4; ii++) {
+        validators.emplace_back([&cas, &stop, &validated, tokenA, tokenB]() {
+            while (!stop.load()) {
+                if (cas.increment_session_counter(tokenA)) {
+                    uint64_t current = cas.getCasValue();
+                    EXPECT_TRUE(current == tokenA || current == tokenB);
+                    cas.decrement_session_counter();
+                    validated++;
+                }
+            }
+        });
+    }
+
+    std::thread mutator([&cas, &stop, tokenA, tokenB]() {
+        uint64_t next = tokenB;
+        while (!stop.load()) {
+            uint64_t current;
+            if (cas.cas(next, 0, current) == ENGINE_SUCCESS) {
+                EXPECT_EQ(next, current);
+                next = (next == tokenA) ? tokenB : tokenA;
+            }
+        }
+    });
+
+    // Run until the validators have made some progress (the mutator keeps
+    // flipping the token so many validations will race with mutations).
+    while (validated.load() < 10000) {
+        std::this_thread::yield();
+    }
+    stop.store(true);
+
+    for (auto& thread : validators) {
+        thread.join();
+    }
+    mutator.join();
+
+    uint64_t current = cas.getCasValue();
+    EXPECT_TRUE(current == tokenA || current == tokenB);
+}
@@ -743,3 +743,48 @@ TEST_P(GetSetTest, TestGetMetaExpiry) {
     EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, meta.first);
     EXPECT_EQ(meta.second.expiry, document.info.expiration);
 }
+
+// Store and fetch a batch of documents through a deep pipeline (single
+// write for the whole batch, responses drained lazily), rather than the
+// usual send-one-recv-one pattern.
+TEST_P(GetSetTest, PipelinedSetGet) {
+    MemcachedConnection& conn = getConnection();
+    BinprotPipeline pipeline(conn);
+    const size_t depth = 250;
+
+    std::vector<std::string> keys;
+    for (size_t ii = 0; ii < depth; ii++) {
+        keys.emplace_back(name + "_pipelined_" + std::to_string(ii));
+        BinprotMutationCommand cmd;
+        cmd.setMutationType(MutationType::Set);
+        cmd.setKey(keys.back());
+        cmd.setValue(std::string("value_") + std::to_string(ii));
+        pipeline.queue(cmd);
+    }
+    EXPECT_EQ(depth, pipeline.getOutstanding());
+    pipeline.flush();
+
+    BinprotResponse rsp;
+    size_t received = 0;
+    while (pipeline.recvNext(rsp)) {
+        EXPECT_TRUE(rsp.isSuccess());
+        received++;
+    }
+    EXPECT_EQ(depth, received);
+
+    // Read them all back through a pipeline of gets; recvNext performs
+    // the flush for us.
+    for (const auto& key : keys) {
+        BinprotGetCommand cmd;
+        cmd.setKey(key);
+        pipeline.queue(cmd);
+    }
+
+    received = 0;
+    while (pipeline.recvNext(rsp)) {
+        EXPECT_TRUE(rsp.isSuccess());
+        received++;
+    }
+    EXPECT_EQ(depth, received);
+    EXPECT_EQ(0, pipeline.getOutstanding());
+}
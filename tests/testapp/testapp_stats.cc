@@ -198,6 +198,8 @@ TEST_P(StatsTest, TestSettings) {
               cJSON_GetObjectItem(stats.get(), "reqs_per_event_low_priority"));
     ASSERT_NE(nullptr,
               cJSON_GetObjectItem(stats.get(), "reqs_per_event_def_priority"));
+    ASSERT_NE(nullptr,
+              cJSON_GetObjectItem(stats.get(), "default_bytes_per_event"));
     ASSERT_NE(nullptr, cJSON_GetObjectItem(stats.get(), "auth_enabled_sasl"));
     ASSERT_NE(nullptr, cJSON_GetObjectItem(stats.get(), "auth_sasl_engine"));
 
@@ -44,15 +44,54 @@ TEST_F(TopKeysTest, Basic) {
         keys.emplace_back("topkey_test_" + std::to_string(ii));
     }
 
-    // loop inserting keys
+    // loop inserting keys (all from the same "worker thread")
     for (int jj = 0; jj < 20000; jj++) {
         for (auto& key : keys) {
             topkeys->updateKey(key.c_str(), key.size(), jj);
         }
     }
 
-    // Verify we hit all shards inside TopKeys
+    // A single thread only populates its own summary, which is
+    // limited to the requested number of keys.
     size_t count = 0;
     topkeys->stats(&count, 0, dump_key);
-    EXPECT_EQ(80, count);
+    EXPECT_EQ(10, count);
+}
+
+TEST_F(TopKeysTest, MergeAcrossThreads) {
+    // The same key accessed from different worker threads should be
+    // reported once, not once per per-thread summary.
+    const std::string key{"topkey_test_merged"};
+    for (int thread = 0; thread < 4; thread++) {
+        topkeys->updateKey(key.c_str(), key.size(), 0, thread);
+    }
+
+    size_t count = 0;
+    topkeys->stats(&count, 0, dump_key);
+    EXPECT_EQ(1, count);
+}
+
+TEST_F(TopKeysTest, FrequentKeysRetained) {
+    // A key accessed more frequently than anything else must survive
+    // a flood of one-off keys (the Space-Saving property the old
+    // LRU-based implementation lacked).
+    const std::string hot{"topkey_test_hot"};
+    for (int ii = 0; ii < 1000; ii++) {
+        topkeys->updateKey(hot.c_str(), hot.size(), 0);
+
+        const auto cold = "topkey_test_cold_" + std::to_string(ii);
+        topkeys->updateKey(cold.c_str(), cold.size(), 0);
+    }
+
+    bool found = false;
+    topkeys->stats(&found, 0,
+                   [](const char* key, const uint16_t klen,
+                      const char* val, const uint32_t vlen,
+                      const void* cookie) {
+                       if (std::string(key, klen) == "topkey_test_hot") {
+                           *static_cast<bool*>(const_cast<void*>(cookie)) =
+                                   true;
+                       }
+                   });
+    EXPECT_TRUE(found);
 }
@@ -31,29 +31,61 @@ Blob::Blob(const Blob& other)
     std::copy(other.blob.begin(), other.blob.end(), blob.begin());
 }
 
-cb::byte_buffer Blob::get(const cb::const_byte_buffer& key) const {
+/**
+ * Lexicographic "less than" for the keys referred to by the index
+ */
+static bool key_less(const cb::const_byte_buffer& lhs,
+                     const cb::const_byte_buffer& rhs) {
+    const auto cmp = std::memcmp(lhs.buf, rhs.buf, std::min(lhs.len, rhs.len));
+    if (cmp == 0) {
+        return lhs.len < rhs.len;
+    }
+    return cmp < 0;
+}
+
+void Blob::build_index() const {
+    index.clear();
     try {
         size_t current = 4;
         while (current < blob.len) {
             // Get the length of the next kv-pair
             const auto size = read_length(current);
-            current += 4;
-            if (size > key.len) {
-                // This may be the next key
-                if (blob.buf[current + key.len] == '\0' &&
-                    std::memcmp(blob.buf + current, key.buf, key.len) == 0) {
-                    // Yay this is the key!!!
-                    auto* value = blob.buf + current + key.len + 1;
-                    return {value, strlen(reinterpret_cast<char*>(value))};
-                } else {
-                    // jump to the next key!!
-                    current += size;
-                }
-            } else {
-                current += size;
-            }
+            const auto* key = blob.buf + current + 4;
+            index.push_back(
+                    {uint32_t(current),
+                     uint32_t(strlen(reinterpret_cast<const char*>(key)))});
+            current += 4 + size;
         }
     } catch (const std::out_of_range& ex) {
+        // Ignore the rest of the blob (matching what the old linear
+        // scan in get() used to do)
+    }
+
+    std::sort(index.begin(),
+              index.end(),
+              [this](const IndexEntry& lhs, const IndexEntry& rhs) {
+                  return key_less(entry_key(lhs), entry_key(rhs));
+              });
+    index_valid = true;
+}
+
+cb::byte_buffer Blob::get(const cb::const_byte_buffer& key) const {
+    if (!index_valid) {
+        build_index();
+    }
+
+    auto iter = std::lower_bound(
+            index.begin(),
+            index.end(),
+            key,
+            [this](const IndexEntry& entry, const cb::const_byte_buffer& k) {
+                return key_less(entry_key(entry), k);
+            });
+    if (iter != index.end() && iter->keylen == key.len &&
+        std::memcmp(blob.buf + iter->offset + 4, key.buf, key.len) == 0) {
+        // Yay this is the key!!!
+        auto* value = blob.buf + iter->offset + 4 + key.len + 1;
+        return {value, strlen(reinterpret_cast<char*>(value))};
     }
 
     // Not found!
@@ -161,6 +193,7 @@ void Blob::write_kvpair(size_t offset,
     offset += value.len;
     blob.buf[offset++] = '\0';
     write_length(0, uint32_t(blob.len - 4));
+    index_valid = false;
 }
 
 void Blob::append_kvpair(const cb::const_byte_buffer& key,
@@ -198,6 +231,7 @@ void Blob::remove_segment(const size_t offset, const size_t size) {
     if (blob.len > 0) {
         write_length(0, blob.len - 4);
     }
+    index_valid = false;
 }
 
 void Blob::write_length(size_t offset, uint32_t value) {